@@ -0,0 +1,572 @@
+/**
+ * bench_framework.h - Microbenchmark harness
+ *
+ * Runs each case for a warm-up and a number of timed samples on a pinned
+ * thread, reports p50/p90/p99 and allocations per operation, and compares
+ * the result against a baseline JSON file. A case regresses when its p50 or
+ * p90 is slower than the baseline by more than --max-regression percent
+ * and by more than --min-delta microseconds (the absolute floor keeps
+ * sub-microsecond parsers from failing on timer noise), or when it
+ * allocates more per operation than the baseline did.
+ *
+ * Header-only like test_framework.h. On Linux every bench source must
+ * define _GNU_SOURCE before its first include (sched_setaffinity).
+ *
+ * Allocation counting needs a hook the bench binary installs (bench_main.c):
+ * the debug CRT on Windows, malloc interposition with glibc. Elsewhere
+ * allocations are reported as n/a and not gated.
+ */
+
+#pragma once
+#ifndef BENCH_FRAMEWORK_H
+#define BENCH_FRAMEWORK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
+#define BENCH_MAX_SAMPLES           100000
+#define BENCH_DEFAULT_REGRESSION    10.0    /* percent */
+#define BENCH_DEFAULT_MIN_DELTA_US  0.5
+
+/* Returns a value derived from the work so the compiler cannot drop it */
+typedef unsigned long (*BENCH_FUNC)(const void* context);
+
+typedef struct _BENCH_CASE {
+    const char* name;           /* "Group/Name", the baseline key */
+    BENCH_FUNC func;
+    const void* context;
+    int iterations;             /* Default timed samples */
+    int batch;                  /* Calls per sample, for sub-microsecond cases */
+} BENCH_CASE;
+
+typedef struct _BENCH_OPTIONS {
+    int iterations;             /* 0 = per-case default */
+    int warmup;                 /* -1 = iterations / 10, at least 1 */
+    int cpu;                    /* CPU to pin to, -1 = no pinning */
+    const char* filter;         /* Substring of the case name */
+    const char* baselinePath;
+    const char* writeBaselinePath;
+    double maxRegressionPct;
+    double minDeltaUs;
+    int jsonOutput;
+    int list;
+} BENCH_OPTIONS;
+
+typedef struct _BENCH_STATS {
+    int iterations;
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double minUs;
+    double maxUs;
+    double allocsPerOp;         /* < 0 when not counted */
+} BENCH_STATS;
+
+typedef struct _BENCH_BASELINE_ENTRY {
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double allocsPerOp;         /* < 0 when absent */
+} BENCH_BASELINE_ENTRY;
+
+/* Verdict of one case against the baseline */
+typedef enum _BENCH_VERDICT {
+    BENCH_OK = 0,
+    BENCH_NEW,                  /* No baseline entry */
+    BENCH_REGRESSED
+} BENCH_VERDICT;
+
+/*
+ * Allocation counter, defined by the bench binary. g_benchAllocHooked is set
+ * when a hook is installed; g_benchAllocCount counts while g_benchAllocActive.
+ */
+extern volatile long g_benchAllocCount;
+extern volatile int g_benchAllocActive;
+extern int g_benchAllocHooked;
+
+static __inline const char* BenchPlatform(void)
+{
+#if defined(_WIN32) && (defined(_M_ARM64) || defined(__aarch64__))
+    return "windows-arm64";
+#elif defined(_WIN32) && (defined(_M_X64) || defined(__x86_64__))
+    return "windows-x64";
+#elif defined(_WIN32)
+    return "windows-x86";
+#elif defined(__linux__) && defined(__aarch64__)
+    return "linux-arm64";
+#elif defined(__linux__) && defined(__x86_64__)
+    return "linux-x64";
+#else
+    return "other";
+#endif
+}
+
+static __inline double BenchNowUs(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000000.0 + (double)now.tv_nsec / 1000.0;
+#endif
+}
+
+/*
+ * Pin the calling thread to one CPU. Windows also raises the thread priority
+ * so the scheduler does not preempt the sample for background work.
+ */
+static __inline int BenchPinThread(int cpu)
+{
+#ifdef _WIN32
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+        return -1;
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) == 0) {
+        return -1;
+    }
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+    return 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+static __inline int BenchCompareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static __inline double BenchPercentile(const double* sorted, int count, double percentile)
+{
+    int rank = (int)ceil(percentile / 100.0 * count);
+
+    if (count == 0) {
+        return 0.0;
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+static __inline void BenchComputeStats(double* samples, int count, double allocsPerOp, BENCH_STATS* stats)
+{
+    qsort(samples, (size_t)count, sizeof(double), BenchCompareDouble);
+    stats->iterations = count;
+    stats->p50Us = BenchPercentile(samples, count, 50.0);
+    stats->p90Us = BenchPercentile(samples, count, 90.0);
+    stats->p99Us = BenchPercentile(samples, count, 99.0);
+    stats->minUs = count > 0 ? samples[0] : 0.0;
+    stats->maxUs = count > 0 ? samples[count - 1] : 0.0;
+    stats->allocsPerOp = allocsPerOp;
+}
+
+/*
+ * Run one case: warm-up calls, then timed samples of `batch` calls each.
+ * Allocations are counted over the timed samples only.
+ */
+static __inline int BenchRunCase(const BENCH_CASE* bench, const BENCH_OPTIONS* options, BENCH_STATS* stats)
+{
+    int iterations = options->iterations > 0 ? options->iterations : bench->iterations;
+    int batch = bench->batch > 0 ? bench->batch : 1;
+    int warmup = options->warmup >= 0 ? options->warmup : (iterations / 10 > 0 ? iterations / 10 : 1);
+    volatile unsigned long sink = 0;
+    double* samples;
+    double start;
+    long allocs;
+    int i, j;
+
+    if (iterations > BENCH_MAX_SAMPLES) {
+        iterations = BENCH_MAX_SAMPLES;
+    }
+    samples = (double*)malloc(sizeof(double) * (size_t)iterations);
+    if (samples == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < warmup; i++) {
+        for (j = 0; j < batch; j++) {
+            sink += bench->func(bench->context);
+        }
+    }
+
+    g_benchAllocCount = 0;
+    g_benchAllocActive = 1;
+    for (i = 0; i < iterations; i++) {
+        start = BenchNowUs();
+        for (j = 0; j < batch; j++) {
+            sink += bench->func(bench->context);
+        }
+        samples[i] = (BenchNowUs() - start) / batch;
+    }
+    g_benchAllocActive = 0;
+    allocs = g_benchAllocCount;
+
+    BenchComputeStats(samples, iterations,
+                      g_benchAllocHooked ? (double)allocs / ((double)iterations * batch) : -1.0, stats);
+    free(samples);
+    (void)sink;
+    return 0;
+}
+
+/* ============================================================================
+ * Baseline file
+ *
+ * {"platform": "...", "benchmarks": {"Group/Name": {"p50_us": ..., ...}, ...}}
+ *
+ * The reader only looks up keys; it is not a general JSON parser.
+ * ============================================================================ */
+
+static __inline char* BenchReadFile(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    char* text;
+    long size;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    text = (char*)malloc((size_t)size + 1);
+    if (text != NULL && fread(text, 1, (size_t)size, file) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text != NULL) {
+        text[size] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+/* Start of the value for "key": within [text, end), or NULL */
+static __inline const char* BenchFindKey(const char* text, const char* end, const char* key)
+{
+    size_t keyLength = strlen(key);
+    const char* p = text;
+
+    while ((p = strchr(p, '"')) != NULL && p < end) {
+        if ((size_t)(end - p) > keyLength + 1 && strncmp(p + 1, key, keyLength) == 0 && p[keyLength + 1] == '"') {
+            p += keyLength + 2;
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+                p++;
+            }
+            return (*p == ':') ? p + 1 : NULL;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static __inline double BenchFindNumber(const char* text, const char* end, const char* key, double missing)
+{
+    const char* value = BenchFindKey(text, end, key);
+    return value != NULL ? strtod(value, NULL) : missing;
+}
+
+/* Baseline platform, copied into platform; 0 if present */
+static __inline int BenchBaselinePlatform(const char* text, char* platform, size_t platformSize)
+{
+    const char* value = BenchFindKey(text, text + strlen(text), "platform");
+    const char* close;
+
+    if (value == NULL || (value = strchr(value, '"')) == NULL || (close = strchr(value + 1, '"')) == NULL) {
+        return -1;
+    }
+    snprintf(platform, platformSize, "%.*s", (int)(close - value - 1), value + 1);
+    return 0;
+}
+
+static __inline int BenchBaselineLookup(const char* text, const char* name, BENCH_BASELINE_ENTRY* entry)
+{
+    const char* end = text + strlen(text);
+    const char* value = BenchFindKey(text, end, name);
+    const char* close;
+
+    if (value == NULL || (value = strchr(value, '{')) == NULL || (close = strchr(value, '}')) == NULL) {
+        return -1;
+    }
+    entry->p50Us = BenchFindNumber(value, close, "p50_us", -1.0);
+    entry->p90Us = BenchFindNumber(value, close, "p90_us", -1.0);
+    entry->p99Us = BenchFindNumber(value, close, "p99_us", -1.0);
+    entry->allocsPerOp = BenchFindNumber(value, close, "allocs", -1.0);
+    return (entry->p50Us >= 0.0 && entry->p90Us >= 0.0) ? 0 : -1;
+}
+
+static __inline int BenchSlower(double current, double baseline, const BENCH_OPTIONS* options)
+{
+    return current > baseline * (1.0 + options->maxRegressionPct / 100.0) &&
+           current - baseline > options->minDeltaUs;
+}
+
+static __inline BENCH_VERDICT BenchCompare(const BENCH_STATS* stats, const BENCH_BASELINE_ENTRY* baseline,
+                                           const BENCH_OPTIONS* options, char* reason, size_t reasonSize)
+{
+    double allowedAllocs;
+
+    reason[0] = '\0';
+    if (BenchSlower(stats->p50Us, baseline->p50Us, options)) {
+        snprintf(reason, reasonSize, "p50 %.2f us vs %.2f us", stats->p50Us, baseline->p50Us);
+        return BENCH_REGRESSED;
+    }
+    if (BenchSlower(stats->p90Us, baseline->p90Us, options)) {
+        snprintf(reason, reasonSize, "p90 %.2f us vs %.2f us", stats->p90Us, baseline->p90Us);
+        return BENCH_REGRESSED;
+    }
+    if (stats->allocsPerOp >= 0.0 && baseline->allocsPerOp >= 0.0) {
+        allowedAllocs = baseline->allocsPerOp * (1.0 + options->maxRegressionPct / 100.0);
+        if (stats->allocsPerOp > allowedAllocs && stats->allocsPerOp - baseline->allocsPerOp >= 0.5) {
+            snprintf(reason, reasonSize, "allocs %.1f vs %.1f", stats->allocsPerOp, baseline->allocsPerOp);
+            return BENCH_REGRESSED;
+        }
+    }
+    return BENCH_OK;
+}
+
+static __inline void BenchWriteJson(FILE* out, const BENCH_CASE* cases, const BENCH_STATS* stats,
+                                    const int* ran, int count)
+{
+    int first = 1;
+    int i;
+
+    fprintf(out, "{\n  \"platform\": \"%s\",\n  \"benchmarks\": {", BenchPlatform());
+    for (i = 0; i < count; i++) {
+        if (!ran[i]) {
+            continue;
+        }
+        fprintf(out, "%s\n    \"%s\": {\"iterations\": %d, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f",
+                first ? "" : ",", cases[i].name, stats[i].iterations, stats[i].p50Us, stats[i].p90Us, stats[i].p99Us);
+        if (stats[i].allocsPerOp >= 0.0) {
+            fprintf(out, ", \"allocs\": %.2f", stats[i].allocsPerOp);
+        }
+        fprintf(out, "}");
+        first = 0;
+    }
+    fprintf(out, "\n  }\n}\n");
+}
+
+/* ============================================================================
+ * Runner
+ * ============================================================================ */
+
+static __inline void PrintBenchUsage(void)
+{
+    printf("Benchmark options:\n");
+    printf("  --iterations <n>       Timed samples per case (default: per case)\n");
+    printf("  --warmup <n>           Warm-up calls (default: iterations / 10)\n");
+    printf("  --cpu <n>              Pin to CPU n (default: 0)\n");
+    printf("  --no-pin               Do not pin the benchmark thread\n");
+    printf("  --filter <text>        Only cases whose name contains text\n");
+    printf("  --baseline <file>      Compare against a baseline; exit 1 on regression\n");
+    printf("  --write-baseline <f>   Write the results as a new baseline\n");
+    printf("  --max-regression <%%>   Allowed slowdown (default: %.0f)\n", BENCH_DEFAULT_REGRESSION);
+    printf("  --min-delta <us>       Ignore slowdowns smaller than this (default: %.1f)\n",
+           BENCH_DEFAULT_MIN_DELTA_US);
+    printf("  --json                 Print results as JSON\n");
+    printf("  --list                 List cases and exit\n");
+}
+
+/* 0 on success; unknown arguments are left to the caller */
+static __inline int ParseBenchOptions(int argc, char* argv[], BENCH_OPTIONS* options)
+{
+    int i;
+
+    memset(options, 0, sizeof(*options));
+    options->warmup = -1;
+    options->maxRegressionPct = BENCH_DEFAULT_REGRESSION;
+    options->minDeltaUs = BENCH_DEFAULT_MIN_DELTA_US;
+
+    for (i = 1; i < argc; i++) {
+        const char* next = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--no-pin") == 0) {
+            options->cpu = -1;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            options->jsonOutput = 1;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            options->list = 1;
+        } else if (next == NULL) {
+            continue;
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            options->iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            options->warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0) {
+            options->cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            options->filter = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            options->baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--write-baseline") == 0) {
+            options->writeBaselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--max-regression") == 0) {
+            options->maxRegressionPct = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-delta") == 0) {
+            options->minDeltaUs = atof(argv[++i]);
+        }
+    }
+
+    if (options->iterations < 0 || options->maxRegressionPct < 0.0 || options->minDeltaUs < 0.0) {
+        fprintf(stderr, "Invalid benchmark option\n");
+        return -1;
+    }
+    return 0;
+}
+
+static __inline void PrintBenchLine(const BENCH_CASE* bench, const BENCH_STATS* stats, const char* verdict)
+{
+    char allocs[32];
+
+    if (stats->allocsPerOp >= 0.0) {
+        snprintf(allocs, sizeof(allocs), "%.1f", stats->allocsPerOp);
+    } else {
+        snprintf(allocs, sizeof(allocs), "n/a");
+    }
+    printf("%-40s %7d %12.2f %12.2f %12.2f %8s%s%s\n",
+           bench->name, stats->iterations, stats->p50Us, stats->p90Us, stats->p99Us, allocs,
+           verdict[0] ? "  " : "", verdict);
+}
+
+/*
+ * Run every case matching the filter. Returns the process exit code:
+ * 0 = no regression, 1 = regression, 2 = usage or baseline error.
+ */
+static __inline int RunBenchMain(const BENCH_CASE* cases, int count, const BENCH_OPTIONS* options)
+{
+    BENCH_STATS* stats;
+    int* ran;
+    char* baseline = NULL;
+    char platform[64];
+    char reason[128];
+    BENCH_BASELINE_ENTRY entry;
+    BENCH_VERDICT verdict;
+    int regressions = 0;
+    int i;
+    FILE* out;
+
+    if (options->list) {
+        for (i = 0; i < count; i++) {
+            printf("%s\n", cases[i].name);
+        }
+        return 0;
+    }
+
+    if (options->baselinePath != NULL) {
+        baseline = BenchReadFile(options->baselinePath);
+        if (baseline == NULL) {
+            fprintf(stderr, "Cannot read baseline %s\n", options->baselinePath);
+            return 2;
+        }
+        if (BenchBaselinePlatform(baseline, platform, sizeof(platform)) != 0 ||
+            strcmp(platform, BenchPlatform()) != 0) {
+            fprintf(stderr, "Baseline %s is not for %s\n", options->baselinePath, BenchPlatform());
+            free(baseline);
+            return 2;
+        }
+    }
+
+    stats = (BENCH_STATS*)calloc((size_t)count, sizeof(BENCH_STATS));
+    ran = (int*)calloc((size_t)count, sizeof(int));
+    if (stats == NULL || ran == NULL) {
+        free(stats);
+        free(ran);
+        free(baseline);
+        return 2;
+    }
+
+    if (options->cpu >= 0 && BenchPinThread(options->cpu) != 0) {
+        fprintf(stderr, "Warning: could not pin to CPU %d\n", options->cpu);
+    }
+
+    if (!options->jsonOutput) {
+        printf("%-40s %7s %12s %12s %12s %8s\n", "Benchmark", "Iters", "p50 (us)", "p90 (us)", "p99 (us)", "Allocs");
+    }
+
+    for (i = 0; i < count; i++) {
+        if (options->filter != NULL && strstr(cases[i].name, options->filter) == NULL) {
+            continue;
+        }
+        if (BenchRunCase(&cases[i], options, &stats[i]) != 0) {
+            fprintf(stderr, "%s: out of memory\n", cases[i].name);
+            continue;
+        }
+        ran[i] = 1;
+
+        verdict = BENCH_OK;
+        reason[0] = '\0';
+        if (baseline != NULL) {
+            verdict = BenchBaselineLookup(baseline, cases[i].name, &entry) == 0
+                    ? BenchCompare(&stats[i], &entry, options, reason, sizeof(reason))
+                    : BENCH_NEW;
+        }
+        if (verdict == BENCH_REGRESSED) {
+            regressions++;
+        }
+
+        if (!options->jsonOutput) {
+            PrintBenchLine(&cases[i], &stats[i],
+                           verdict == BENCH_REGRESSED ? reason : (verdict == BENCH_NEW ? "new" : ""));
+        } else if (verdict == BENCH_REGRESSED) {
+            fprintf(stderr, "REGRESSION %s: %s\n", cases[i].name, reason);
+        }
+    }
+
+    if (options->jsonOutput) {
+        BenchWriteJson(stdout, cases, stats, ran, count);
+    }
+    if (options->writeBaselinePath != NULL) {
+        out = fopen(options->writeBaselinePath, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Cannot write %s\n", options->writeBaselinePath);
+            regressions = -1;
+        } else {
+            BenchWriteJson(out, cases, stats, ran, count);
+            fclose(out);
+        }
+    }
+    if (baseline != NULL && !options->jsonOutput) {
+        printf("\n%d regression(s) against %s (max %.0f%%, min delta %.2f us)\n",
+               regressions, options->baselinePath, options->maxRegressionPct, options->minDeltaUs);
+    }
+
+    free(stats);
+    free(ran);
+    free(baseline);
+    return regressions < 0 ? 2 : (regressions > 0 ? 1 : 0);
+}
+
+#endif /* BENCH_FRAMEWORK_H */
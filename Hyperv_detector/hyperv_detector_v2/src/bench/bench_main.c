@@ -0,0 +1,323 @@
+/**
+ * bench_main.c - hyperv_detector_bench entry point
+ *
+ * On Windows every Check*HyperV function is a case, followed by the
+ * portable parser cases. Elsewhere only the parser cases run; build with:
+ *
+ *   gcc -std=c99 -O2 -Wall -o hyperv_detector_bench src/bench/bench_main.c \
+ *       src/bench/portable_bench.c src/tests/fixture.c -lm
+ *
+ * Regression gate (exit code 1 on regression):
+ *
+ *   hyperv_detector_bench --baseline src/bench/baseline_linux-x64.json
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _GNU_SOURCE
+#include "portable_bench.h"
+#include "../tests/fixture.h"
+
+#ifdef _WIN32
+#include "../user_mode/hyperv_detector.h"
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+#endif
+
+volatile long g_benchAllocCount = 0;
+volatile int g_benchAllocActive = 0;
+int g_benchAllocHooked = 0;
+
+/* ============================================================================
+ * Allocation hooks
+ * ============================================================================ */
+
+#if defined(_WIN32) && defined(_DEBUG)
+
+static int __cdecl BenchAllocHook(int allocType, void* userData, size_t size, int blockType,
+                                  long requestNumber, const unsigned char* fileName, int lineNumber)
+{
+    UNREFERENCED_PARAMETER(userData);
+    UNREFERENCED_PARAMETER(size);
+    UNREFERENCED_PARAMETER(blockType);
+    UNREFERENCED_PARAMETER(requestNumber);
+    UNREFERENCED_PARAMETER(fileName);
+    UNREFERENCED_PARAMETER(lineNumber);
+
+    if (g_benchAllocActive && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)) {
+        g_benchAllocCount++;
+    }
+    return TRUE;
+}
+
+static void InstallAllocHook(void)
+{
+    _CrtSetAllocHook(BenchAllocHook);
+    g_benchAllocHooked = 1;
+}
+
+#elif defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+
+/*
+ * glibc exports its allocator under __libc_* names, so the public entry
+ * points can be replaced here to count calls. Not with ASan, which
+ * interposes them itself.
+ */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* block, size_t size);
+
+void* malloc(size_t size)
+{
+    if (g_benchAllocActive) {
+        g_benchAllocCount++;
+    }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    if (g_benchAllocActive) {
+        g_benchAllocCount++;
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* block, size_t size)
+{
+    if (g_benchAllocActive) {
+        g_benchAllocCount++;
+    }
+    return __libc_realloc(block, size);
+}
+
+static void InstallAllocHook(void)
+{
+    g_benchAllocHooked = 1;
+}
+
+#else
+
+static void InstallAllocHook(void)
+{
+    /* Allocations are reported as n/a */
+}
+
+#endif
+
+/* ============================================================================
+ * Detection checks (Windows)
+ * ============================================================================ */
+
+#ifdef _WIN32
+
+typedef DWORD (*CHECK_FUNC)(PDETECTION_RESULT result);
+
+typedef struct _BENCH_CHECK {
+    const char* name;
+    CHECK_FUNC func;
+} BENCH_CHECK;
+
+extern DWORD CheckCpuidHyperV(PDETECTION_RESULT result);
+extern DWORD CheckRegistryHyperV(PDETECTION_RESULT result);
+extern DWORD CheckServicesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckDevicesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckFilesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckProcessesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckBiosHyperV(PDETECTION_RESULT result);
+extern DWORD CheckWMIHyperV(PDETECTION_RESULT result);
+extern DWORD CheckMACAddressHyperV(PDETECTION_RESULT result);
+extern DWORD CheckFirmwareHyperV(PDETECTION_RESULT result);
+extern DWORD CheckUEFIVariablesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckTimingHyperV(PDETECTION_RESULT result);
+extern DWORD CheckPerfCountersHyperV(PDETECTION_RESULT result);
+extern DWORD CheckETWProvidersHyperV(PDETECTION_RESULT result);
+extern DWORD CheckEventLogsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSecurityEventsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSecurityFeaturesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckDescriptorTablesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckEnvHyperV(PDETECTION_RESULT result);
+extern DWORD CheckNetworkHyperV(PDETECTION_RESULT result);
+extern DWORD CheckDLLHyperV(PDETECTION_RESULT result);
+extern DWORD CheckStorageHyperV(PDETECTION_RESULT result);
+extern DWORD CheckWindowsFeaturesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckIntegrationServicesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckMSRHyperV(PDETECTION_RESULT result);
+extern DWORD CheckEnlightenmentsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckGenerationHyperV(PDETECTION_RESULT result);
+extern DWORD CheckAcpiHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSyntheticDevicesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckNtQueryHyperV(PDETECTION_RESULT result);
+extern DWORD CheckWmiNamespaceHyperV(PDETECTION_RESULT result);
+extern DWORD CheckNestedVirtHyperV(PDETECTION_RESULT result);
+extern DWORD CheckVsmHyperV(PDETECTION_RESULT result);
+extern DWORD CheckPartitionHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSyntheticMsrHyperV(PDETECTION_RESULT result);
+extern DWORD CheckRecommendationsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckLimitsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHwFeaturesHyperV(PDETECTION_RESULT result);
+extern DWORD CheckVersionHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHvSocketHyperV(PDETECTION_RESULT result);
+extern DWORD CheckWhpHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHcsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckGpuPvHyperV(PDETECTION_RESULT result);
+extern DWORD CheckEnclaveHyperV(PDETECTION_RESULT result);
+extern DWORD CheckVmwpHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHypercallInterfaceHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSavedStateHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHvciHyperV(PDETECTION_RESULT result);
+extern DWORD CheckVmbusChannelHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHyperGuardHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSystemGuardHyperV(PDETECTION_RESULT result);
+extern DWORD CheckContainerHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHvEmulationHyperV(PDETECTION_RESULT result);
+extern DWORD CheckSecureCallsHyperV(PDETECTION_RESULT result);
+extern DWORD CheckExoPartitionHyperV(PDETECTION_RESULT result);
+extern DWORD CheckHvDebuggingHyperV(PDETECTION_RESULT result);
+extern DWORD CheckVmcsEptHyperV(PDETECTION_RESULT result);
+
+/*
+ * One call of a check into a fresh result, as the detector makes it
+ */
+static unsigned long BenchRunCheck(const void* context)
+{
+    const BENCH_CHECK* check = (const BENCH_CHECK*)context;
+    DETECTION_RESULT result;
+
+    memset(&result, 0, sizeof(result));
+    return check->func(&result);
+}
+
+static const BENCH_CHECK g_benchChecks[] = {
+    { "Check/Cpuid",                   CheckCpuidHyperV },
+    { "Check/Registry",                CheckRegistryHyperV },
+    { "Check/Services",                CheckServicesHyperV },
+    { "Check/Devices",                 CheckDevicesHyperV },
+    { "Check/Files",                   CheckFilesHyperV },
+    { "Check/Processes",               CheckProcessesHyperV },
+    { "Check/Bios",                    CheckBiosHyperV },
+    { "Check/WMI",                     CheckWMIHyperV },
+    { "Check/MACAddress",              CheckMACAddressHyperV },
+    { "Check/Firmware",                CheckFirmwareHyperV },
+    { "Check/UEFIVariables",           CheckUEFIVariablesHyperV },
+    { "Check/Timing",                  CheckTimingHyperV },
+    { "Check/PerfCounters",            CheckPerfCountersHyperV },
+    { "Check/ETWProviders",            CheckETWProvidersHyperV },
+    { "Check/EventLogs",               CheckEventLogsHyperV },
+    { "Check/SecurityEvents",          CheckSecurityEventsHyperV },
+    { "Check/SecurityFeatures",        CheckSecurityFeaturesHyperV },
+    { "Check/DescriptorTables",        CheckDescriptorTablesHyperV },
+    { "Check/Env",                     CheckEnvHyperV },
+    { "Check/Network",                 CheckNetworkHyperV },
+    { "Check/DLL",                     CheckDLLHyperV },
+    { "Check/Storage",                 CheckStorageHyperV },
+    { "Check/WindowsFeatures",         CheckWindowsFeaturesHyperV },
+    { "Check/IntegrationServices",     CheckIntegrationServicesHyperV },
+    { "Check/MSR",                     CheckMSRHyperV },
+    { "Check/Enlightenments",          CheckEnlightenmentsHyperV },
+    { "Check/Generation",              CheckGenerationHyperV },
+    { "Check/Acpi",                    CheckAcpiHyperV },
+    { "Check/SyntheticDevices",        CheckSyntheticDevicesHyperV },
+    { "Check/NtQuery",                 CheckNtQueryHyperV },
+    { "Check/WmiNamespace",            CheckWmiNamespaceHyperV },
+    { "Check/NestedVirt",              CheckNestedVirtHyperV },
+    { "Check/Vsm",                     CheckVsmHyperV },
+    { "Check/Partition",               CheckPartitionHyperV },
+    { "Check/SyntheticMsr",            CheckSyntheticMsrHyperV },
+    { "Check/Recommendations",         CheckRecommendationsHyperV },
+    { "Check/Limits",                  CheckLimitsHyperV },
+    { "Check/HwFeatures",              CheckHwFeaturesHyperV },
+    { "Check/Version",                 CheckVersionHyperV },
+    { "Check/HvSocket",                CheckHvSocketHyperV },
+    { "Check/Whp",                     CheckWhpHyperV },
+    { "Check/Hcs",                     CheckHcsHyperV },
+    { "Check/GpuPv",                   CheckGpuPvHyperV },
+    { "Check/Enclave",                 CheckEnclaveHyperV },
+    { "Check/Vmwp",                    CheckVmwpHyperV },
+    { "Check/HypercallInterface",      CheckHypercallInterfaceHyperV },
+    { "Check/SavedState",              CheckSavedStateHyperV },
+    { "Check/Hvci",                    CheckHvciHyperV },
+    { "Check/VmbusChannel",            CheckVmbusChannelHyperV },
+    { "Check/HyperGuard",              CheckHyperGuardHyperV },
+    { "Check/SystemGuard",             CheckSystemGuardHyperV },
+    { "Check/Container",               CheckContainerHyperV },
+    { "Check/HvEmulation",             CheckHvEmulationHyperV },
+    { "Check/SecureCalls",             CheckSecureCallsHyperV },
+    { "Check/ExoPartition",            CheckExoPartitionHyperV },
+    { "Check/HvDebugging",             CheckHvDebuggingHyperV },
+    { "Check/VmcsEpt",                 CheckVmcsEptHyperV },
+};
+
+#define CHECK_BENCH_COUNT ((int)(sizeof(g_benchChecks) / sizeof(g_benchChecks[0])))
+
+#else
+
+#define CHECK_BENCH_COUNT 0
+
+#endif
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+static void PrintUsage(const char* program)
+{
+    printf("Usage: %s [options]\n\n", program);
+    PrintBenchUsage();
+    printf("  --fixtures <dir>       Fixture root (default: $HV_FIXTURES_DIR or %s)\n", FIXTURE_DEFAULT_DIR);
+}
+
+int main(int argc, char* argv[])
+{
+    BENCH_OPTIONS options;
+    BENCH_CASE* cases;
+    const char* fixtureRoot = FixtureRoot();
+    char msg[256];
+    int count = 0;
+    int exitCode;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        if (strcmp(argv[i], "--fixtures") == 0 && i + 1 < argc) {
+            fixtureRoot = argv[++i];
+        }
+    }
+    if (ParseBenchOptions(argc, argv, &options) != 0) {
+        return 2;
+    }
+
+    if (PortableBenchInit(fixtureRoot, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "%s\n", msg);
+        return 2;
+    }
+
+    cases = (BENCH_CASE*)malloc(sizeof(BENCH_CASE) * (size_t)(CHECK_BENCH_COUNT + g_portableBenchCount));
+    if (cases == NULL) {
+        PortableBenchCleanup();
+        return 2;
+    }
+#ifdef _WIN32
+    /* Checks are slow (registry, WMI, SetupAPI): fewer samples, one call each */
+    for (i = 0; i < CHECK_BENCH_COUNT; i++) {
+        cases[count].name = g_benchChecks[i].name;
+        cases[count].func = BenchRunCheck;
+        cases[count].context = &g_benchChecks[i];
+        cases[count].iterations = 10;
+        cases[count].batch = 1;
+        count++;
+    }
+#endif
+    memcpy(cases + count, g_portableBenchCases, sizeof(BENCH_CASE) * (size_t)g_portableBenchCount);
+    count += g_portableBenchCount;
+
+    InstallAllocHook();
+    exitCode = RunBenchMain(cases, count, &options);
+
+    free(cases);
+    PortableBenchCleanup();
+    return exitCode;
+}
@@ -0,0 +1,194 @@
+/**
+ * portable_bench.c - Parser benchmarks that build on any platform
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _GNU_SOURCE
+#include "portable_bench.h"
+#include "../common/firmware_parse.h"
+#include "../common/cpuid_decode.h"
+#include "../common/result_codec.h"
+#include "../tests/fixture.h"
+
+static HV_FIXTURE g_benchFixture;
+
+/* A thorough-level result with details and per-check timings, encoded once */
+static UINT8 g_benchRecord[2048];
+static size_t g_benchRecordSize;
+
+/* Strings the detectors match against: SMBIOS values from real machines */
+static const char* const g_benchSignatureInputs[] = {
+    "Microsoft Corporation",
+    "Hyper-V UEFI Release v4.1",
+    "Virtual Machine",
+    "American Megatrends Inc.",
+    "Dell Inc.",
+    "PowerEdge R740",
+    "LENOVO",
+    "20XW0055US",
+    "VMware, Inc.",
+    "VMware7,1",
+    "innotek GmbH",
+    "VirtualBox",
+    "QEMU",
+    "Standard PC (Q35 + ICH9, 2009)",
+    "ASUSTeK COMPUTER INC.",
+    "To be filled by O.E.M.",
+};
+
+static unsigned long Bench_SmbiosParse(const void* context)
+{
+    const HV_FIXTURE* fixture = (const HV_FIXTURE*)context;
+    HV_SMBIOS_INFO info;
+
+    if (HvSmbiosParseRaw(fixture->Smbios, fixture->SmbiosSize, &info) != 0) {
+        return 0;
+    }
+    return info.StructureCount + info.Matches;
+}
+
+static unsigned long Bench_AcpiWalk(const void* context)
+{
+    const HV_FIXTURE* fixture = (const HV_FIXTURE*)context;
+    HV_ACPI_TABLE_INFO info;
+    const UINT8* table;
+    size_t offset = 0;
+    unsigned long value = 0;
+    UINT32 flags;
+    int isHyperV;
+
+    while (HvAcpiNextTable(fixture->Acpi, fixture->AcpiSize, &offset, &table, &info)) {
+        value += info.ChecksumValid + (UINT32)HvAcpiIsHyperVSignature(info.Signature);
+        if (HvAcpiOemVmType(info.OemId, &isHyperV) != NULL) {
+            value += (unsigned long)isHyperV;
+        }
+        if (HvAcpiWaetFlags(table, info.Length, &flags) == 0) {
+            value += flags;
+        }
+    }
+    return value;
+}
+
+static unsigned long Bench_CpuidDecode(const void* context)
+{
+    const HV_FIXTURE* fixture = (const HV_FIXTURE*)context;
+    HV_CPUID_TABLE table;
+    HV_CPUID_INFO info;
+
+    table.Leaves = fixture->Cpuid;
+    table.Count = fixture->CpuidCount;
+    HvCpuidDecode(HvCpuidTableSource, &table, &info);
+    return info.BuildNumber + (unsigned long)info.IsMicrosoftHv;
+}
+
+static unsigned long Bench_SignatureMatch(const void* context)
+{
+    const char* const* signatures = HvFirmwareSignatures();
+    unsigned long value = 0;
+    size_t i;
+
+    (void)context;
+    for (i = 0; i < sizeof(g_benchSignatureInputs) / sizeof(g_benchSignatureInputs[0]); i++) {
+        value += (unsigned long)(HvSignatureMatch(g_benchSignatureInputs[i], signatures) + 1);
+    }
+    return value;
+}
+
+static unsigned long Bench_ResultRecord(const void* context)
+{
+    static HV_RESULT_VIEW view;
+    HV_RESULT_CURSOR cursor;
+    HV_RESULT_FIELD field;
+    HV_RESULT_TIMING timing;
+    unsigned long value = 0;
+
+    (void)context;
+    if (HvResultParse(g_benchRecord, g_benchRecordSize, &view) < 0) {
+        return 0;
+    }
+    HvResultFields(&view, &cursor);
+    while (HvResultNextField(&view, &cursor, &field)) {
+        value += field.Key + field.Text.Length;
+    }
+    HvResultTimings(&view, &cursor);
+    while (HvResultNextTiming(&view, &cursor, &timing)) {
+        value += (unsigned long)timing.Microseconds;
+    }
+    return value + view.DetectionFlags;
+}
+
+/* Encode the record Bench_ResultRecord decodes; 0 on success */
+static int BuildBenchRecord(void)
+{
+    static const char* const checks[] = {
+        "cpuid", "registry", "files", "services", "devices", "bios", "processes", "objects",
+        "nested", "sandbox", "docker", "removed", "wmi", "mac", "firmware", "perfcounters",
+        "etw", "eventlog", "security", "features", "storage"
+    };
+    static const char* const details[][2] = {
+        { "CPUID", "Hypervisor present bit set" },
+        { "CPUID", "Hypervisor vendor: Microsoft Hv" },
+        { "Registry", "Found key: SOFTWARE\\Microsoft\\Virtual Machine\\Guest\\Parameters" },
+        { "Registry", "Found key: SYSTEM\\CurrentControlSet\\Services\\vmbus" },
+        { "Service", "Found running service: vmicheartbeat" },
+        { "Service", "Found running service: vmictimesync" },
+        { "Device", "Found device: Microsoft Hyper-V Virtual Machine Bus" },
+        { "Firmware", "SMBIOS manufacturer: Microsoft Corporation" },
+    };
+    static HV_RESULT_WRITER writer;
+    int size;
+    UINT32 i;
+
+    HvResultWriterInit(&writer, 0x0020803F);
+    HvResultAddUint(&writer, HV_RESULT_KEY_TOOL_VERSION, 0x020000);
+    HvResultAddString(&writer, HV_RESULT_KEY_HOST, "WS2022-BUILD-07", 15);
+    HvResultAddUint(&writer, HV_RESULT_KEY_PROCESS_ID, 7412);
+    HvResultAddString(&writer, HV_RESULT_KEY_PROCESS_NAME, "C:\\Tools\\hyperv_detector.exe", 28);
+    HvResultAddUint(&writer, HV_RESULT_KEY_LEVEL, 2);
+    for (i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        HvResultAddTiming(&writer, checks[i], 150 + 37 * i);
+    }
+    for (i = 0; i < sizeof(details) / sizeof(details[0]); i++) {
+        HvResultAddNamed(&writer, details[i][0], strlen(details[i][0]), details[i][1], strlen(details[i][1]));
+    }
+
+    size = HvResultEncode(&writer, g_benchRecord, sizeof(g_benchRecord));
+    if (size < 0) {
+        return -1;
+    }
+    g_benchRecordSize = (size_t)size;
+    return 0;
+}
+
+const BENCH_CASE g_portableBenchCases[] = {
+    { "Parse/SmbiosRaw",        Bench_SmbiosParse,      &g_benchFixture, 2000, 100 },
+    { "Parse/AcpiWalk",         Bench_AcpiWalk,         &g_benchFixture, 2000, 100 },
+    { "Parse/CpuidDecode",      Bench_CpuidDecode,      &g_benchFixture, 2000, 100 },
+    { "Parse/SignatureMatch",   Bench_SignatureMatch,   NULL,            2000, 100 },
+    { "Parse/ResultRecord",     Bench_ResultRecord,     NULL,            2000, 100 },
+};
+
+const int g_portableBenchCount = (int)(sizeof(g_portableBenchCases) / sizeof(g_portableBenchCases[0]));
+
+int PortableBenchInit(const char* fixtureRoot, char* msg, size_t msgSize)
+{
+    if (LoadFixture(fixtureRoot, PORTABLE_BENCH_FIXTURE, &g_benchFixture, msg, msgSize) != 0) {
+        return -1;
+    }
+    if (g_benchFixture.SmbiosSize == 0 || g_benchFixture.AcpiSize == 0 || g_benchFixture.CpuidCount == 0) {
+        snprintf(msg, msgSize, "Fixture %s is missing SMBIOS, ACPI or CPUID data", PORTABLE_BENCH_FIXTURE);
+        FreeFixture(&g_benchFixture);
+        return -1;
+    }
+    if (BuildBenchRecord() != 0) {
+        snprintf(msg, msgSize, "Benchmark result record does not fit");
+        FreeFixture(&g_benchFixture);
+        return -1;
+    }
+    return 0;
+}
+
+void PortableBenchCleanup(void)
+{
+    FreeFixture(&g_benchFixture);
+}
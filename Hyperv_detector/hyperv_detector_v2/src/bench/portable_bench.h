@@ -0,0 +1,25 @@
+/**
+ * portable_bench.h - Parser benchmarks that build on any platform
+ *
+ * The SMBIOS, ACPI, CPUID and signature parsers from src/common run against
+ * a captured fixture (src/tests/fixtures), and the binary result reader
+ * against a typical record, so their cost can be tracked on Linux CI as well
+ * as on Windows.
+ */
+
+#pragma once
+#ifndef PORTABLE_BENCH_H
+#define PORTABLE_BENCH_H
+
+#include "bench_framework.h"
+
+#define PORTABLE_BENCH_FIXTURE  "hyperv_gen2_guest"
+
+extern const BENCH_CASE g_portableBenchCases[];
+extern const int g_portableBenchCount;
+
+/* Load the fixture the cases read; 0 on success */
+int PortableBenchInit(const char* fixtureRoot, char* msg, size_t msgSize);
+void PortableBenchCleanup(void);
+
+#endif /* PORTABLE_BENCH_H */
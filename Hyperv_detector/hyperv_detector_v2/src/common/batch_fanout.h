@@ -0,0 +1,202 @@
+#pragma once
+#ifndef BATCH_FANOUT_H
+#define BATCH_FANOUT_H
+
+#include "shared_structs.h"
+
+//
+// IOCTL_HYPERV_BATCH_ALL_CPUS - run one batch on every active processor
+//
+// The request is an IOCTL_HYPERV_BATCH request restricted to RDMSR, CPUID and
+// VP_INDEX operations. The response is a processor x operation matrix plus a
+// per-operation summary:
+//
+//   header:   u32 magic 'HVBM' | u16 version | u16 opCount | u32 processorCount | u32 reserved
+//   summary:  opCount x { u16 type | u16 flags | u32 okCount | u32 failCount | u32 firstFailed }
+//   cells:    processorCount rows of opCount results (HV_BATCH_RESULT_SIZE each)
+//
+// The driver only supplies the per-processor executor; building the matrix
+// and aggregating it is done here so it can be exercised with simulated
+// processors outside the kernel.
+//
+#define HV_FANOUT_MAGIC             0x4D425648  // "HVBM"
+#define HV_FANOUT_MAX_PROCESSORS    2048
+
+#define HV_FANOUT_HEADER_SIZE       16
+#define HV_FANOUT_SUMMARY_SIZE      16
+
+// Summary flags
+#define HV_FANOUT_UNIFORM           0x0001  // Every processor that succeeded returned the same values
+#define HV_FANOUT_NO_FAILED         0xFFFFFFFF
+
+typedef struct _HV_FANOUT_SUMMARY {
+    UINT16 Type;
+    UINT16 Flags;
+    UINT32 OkCount;
+    UINT32 FailCount;       // Includes processors that never ran (HV_BATCH_STATUS_NOT_RUN)
+    UINT32 FirstFailed;     // Lowest failing processor index, or HV_FANOUT_NO_FAILED
+} HV_FANOUT_SUMMARY, *PHV_FANOUT_SUMMARY;
+
+// Runs one operation on the current processor
+typedef void (*HV_FANOUT_EXECUTE)(void* context, UINT32 processor, const HV_BATCH_OP* op, PHV_BATCH_RESULT result);
+
+static __inline size_t HvFanoutResponseSize(UINT32 opCount, UINT32 processorCount)
+{
+    return HV_FANOUT_HEADER_SIZE + (size_t)opCount * HV_FANOUT_SUMMARY_SIZE +
+           (size_t)processorCount * opCount * HV_BATCH_RESULT_SIZE;
+}
+
+static __inline size_t HvFanoutCellOffset(UINT32 opCount, UINT32 processor, UINT32 opIndex)
+{
+    return HV_FANOUT_HEADER_SIZE + (size_t)opCount * HV_FANOUT_SUMMARY_SIZE +
+           ((size_t)processor * opCount + opIndex) * HV_BATCH_RESULT_SIZE;
+}
+
+// Hypercalls are not allowed in a fan-out batch
+static __inline int HvFanoutValidateOps(const HV_BATCH_OP* ops, UINT32 opCount)
+{
+    UINT32 i;
+
+    if (opCount == 0 || opCount > HV_BATCH_MAX_OPS) {
+        return HV_BATCH_E_COUNT;
+    }
+    for (i = 0; i < opCount; i++) {
+        if (ops[i].Type != HV_BATCH_OP_RDMSR && ops[i].Type != HV_BATCH_OP_CPUID &&
+            ops[i].Type != HV_BATCH_OP_VP_INDEX) {
+            return HV_BATCH_E_OP;
+        }
+    }
+    return 0;
+}
+
+// Write the header and mark every cell HV_BATCH_STATUS_NOT_RUN
+static __inline void HvFanoutBegin(void* buffer, const HV_BATCH_OP* ops, UINT32 opCount, UINT32 processorCount)
+{
+    UINT8* p = (UINT8*)buffer;
+    HV_BATCH_RESULT pending;
+    UINT32 cpu, i;
+
+    HvBatchStore32(p, HV_FANOUT_MAGIC);
+    HvBatchStore16(p + 4, HV_BATCH_VERSION);
+    HvBatchStore16(p + 6, opCount);
+    HvBatchStore32(p + 8, processorCount);
+    HvBatchStore32(p + 12, 0);
+
+    for (i = 0; i < opCount; i++) {
+        pending.Type = ops[i].Type;
+        pending.Status = HV_BATCH_STATUS_NOT_RUN;
+        pending.Detail = 0;
+        pending.Value[0] = pending.Value[1] = pending.Value[2] = pending.Value[3] = 0;
+        for (cpu = 0; cpu < processorCount; cpu++) {
+            HvBatchStoreResult(p + HvFanoutCellOffset(opCount, cpu, i), &pending);
+        }
+    }
+}
+
+// Fill one processor's row. Rows are disjoint, so processors may run this
+// concurrently on the same buffer.
+static __inline void HvFanoutRunProcessor(void* buffer, const HV_BATCH_OP* ops, UINT32 opCount,
+                                          UINT32 processor, HV_FANOUT_EXECUTE execute, void* context)
+{
+    HV_BATCH_RESULT result;
+    UINT32 i;
+
+    for (i = 0; i < opCount; i++) {
+        execute(context, processor, &ops[i], &result);
+        result.Type = ops[i].Type;
+        HvBatchStoreResult((UINT8*)buffer + HvFanoutCellOffset(opCount, processor, i), &result);
+    }
+}
+
+// Aggregate every column into its summary entry once all rows are written
+static __inline void HvFanoutSummarize(void* buffer, UINT32 opCount, UINT32 processorCount)
+{
+    UINT8* p = (UINT8*)buffer;
+    HV_BATCH_RESULT cell, first;
+    UINT32 cpu, i;
+    UINT32 ok, failed, firstFailed;
+    int uniform;
+
+    for (i = 0; i < opCount; i++) {
+        UINT8* summary = p + HV_FANOUT_HEADER_SIZE + (size_t)i * HV_FANOUT_SUMMARY_SIZE;
+
+        ok = failed = 0;
+        firstFailed = HV_FANOUT_NO_FAILED;
+        uniform = 1;
+        first.Type = 0;
+        first.Value[0] = first.Value[1] = first.Value[2] = first.Value[3] = 0;
+        cell.Type = 0;
+
+        for (cpu = 0; cpu < processorCount; cpu++) {
+            HvBatchLoadResult(p + HvFanoutCellOffset(opCount, cpu, i), &cell);
+            if (cell.Status != HV_BATCH_STATUS_OK) {
+                if (failed++ == 0) {
+                    firstFailed = cpu;
+                }
+                continue;
+            }
+            if (ok++ == 0) {
+                first = cell;
+            } else if (cell.Value[0] != first.Value[0] || cell.Value[1] != first.Value[1] ||
+                       cell.Value[2] != first.Value[2] || cell.Value[3] != first.Value[3]) {
+                uniform = 0;
+            }
+        }
+
+        HvBatchStore16(summary, cell.Type);
+        HvBatchStore16(summary + 2, (ok > 0 && uniform) ? HV_FANOUT_UNIFORM : 0);
+        HvBatchStore32(summary + 4, ok);
+        HvBatchStore32(summary + 8, failed);
+        HvBatchStore32(summary + 12, firstFailed);
+    }
+}
+
+// Validate a response and return its dimensions (0), or HV_BATCH_E_*
+static __inline int HvFanoutParse(const void* buffer, size_t size, UINT32* opCount, UINT32* processorCount)
+{
+    const UINT8* p = (const UINT8*)buffer;
+    UINT32 ops, cpus;
+
+    if (size < HV_FANOUT_HEADER_SIZE) {
+        return HV_BATCH_E_SHORT;
+    }
+    if (HvBatchLoad32(p) != HV_FANOUT_MAGIC) {
+        return HV_BATCH_E_MAGIC;
+    }
+    if (HvBatchLoad16(p + 4) != HV_BATCH_VERSION) {
+        return HV_BATCH_E_VERSION;
+    }
+
+    ops = HvBatchLoad16(p + 6);
+    cpus = HvBatchLoad32(p + 8);
+    if (ops == 0 || ops > HV_BATCH_MAX_OPS || cpus == 0 || cpus > HV_FANOUT_MAX_PROCESSORS) {
+        return HV_BATCH_E_COUNT;
+    }
+    if (size < HvFanoutResponseSize(ops, cpus)) {
+        return HV_BATCH_E_SHORT;
+    }
+
+    *opCount = ops;
+    *processorCount = cpus;
+    return 0;
+}
+
+// Accessors for a response that passed HvFanoutParse
+static __inline void HvFanoutGetSummary(const void* buffer, UINT32 opIndex, PHV_FANOUT_SUMMARY summary)
+{
+    const UINT8* p = (const UINT8*)buffer + HV_FANOUT_HEADER_SIZE + (size_t)opIndex * HV_FANOUT_SUMMARY_SIZE;
+
+    summary->Type        = (UINT16)HvBatchLoad16(p);
+    summary->Flags       = (UINT16)HvBatchLoad16(p + 2);
+    summary->OkCount     = HvBatchLoad32(p + 4);
+    summary->FailCount   = HvBatchLoad32(p + 8);
+    summary->FirstFailed = HvBatchLoad32(p + 12);
+}
+
+static __inline int HvFanoutGetCell(const void* buffer, UINT32 opCount, UINT32 processor, UINT32 opIndex,
+                                    PHV_BATCH_RESULT result)
+{
+    return HvBatchLoadResult((const UINT8*)buffer + HvFanoutCellOffset(opCount, processor, opIndex), result);
+}
+
+#endif // BATCH_FANOUT_H
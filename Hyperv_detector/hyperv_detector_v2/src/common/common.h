@@ -40,21 +40,8 @@ static __inline unsigned __int64 __rdtsc(void) { return 0; }
 static __inline unsigned __int64 __rdtscp(unsigned int *aux) { if (aux) *aux = 0; return 0; }
 #endif
 
-// Detection result flags
-#define HYPERV_DETECTED_NONE        0x00000000
-#define HYPERV_DETECTED_CPUID       0x00000001
-#define HYPERV_DETECTED_REGISTRY    0x00000002
-#define HYPERV_DETECTED_FILES       0x00000004
-#define HYPERV_DETECTED_SERVICES    0x00000008
-#define HYPERV_DETECTED_DEVICES     0x00000010
-#define HYPERV_DETECTED_BIOS        0x00000020
-#define HYPERV_DETECTED_PROCESSES   0x00000040
-#define HYPERV_DETECTED_HYPERCALLS  0x00000080
-#define HYPERV_DETECTED_OBJECTS     0x00000100
-#define HYPERV_DETECTED_NESTED      0x00000200
-#define HYPERV_DETECTED_SANDBOX     0x00000400
-#define HYPERV_DETECTED_DOCKER      0x00000800
-#define HYPERV_DETECTED_REMOVED     0x00001000
+// Detection result flags and the rules behind them (portable)
+#include "detection_rules.h"
 
 // CPUID constants
 #define CPUID_HYPERVISOR_PRESENT    0x40000000
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef CPUID_DECODE_H
+#define CPUID_DECODE_H
+
+#include "shared_structs.h"
+#include <string.h>
+
+//
+// Hyper-V CPUID leaf decoding
+//
+// The decoder reads leaves through a callback, so the same code decodes the
+// live processor (ExecuteCpuid) and a captured leaf table (HvCpuidTableSource).
+//
+#define HV_CPUID_FEATURES           0x00000001
+#define HV_CPUID_VENDOR             0x40000000
+#define HV_CPUID_INTERFACE          0x40000001
+#define HV_CPUID_VERSION            0x40000002
+#define HV_CPUID_PARTITION_FEATURES 0x40000003
+#define HV_CPUID_RECOMMENDATIONS    0x40000004
+#define HV_CPUID_LIMITS             0x40000005
+#define HV_CPUID_HW_FEATURES        0x40000006
+#define HV_CPUID_NESTED_FEATURES    0x4000000A
+
+#define HV_CPUID_INTERFACE_HV1      0x31237648  // "Hv#1"
+#define HV_CPUID_PRIV_CREATE_PARTITIONS 0x00000001  // 0x40000003 EBX bit 0: root partition
+#define HV_CPUID_HINT_NESTED        0x00002000  // 0x40000004 EAX bit 13
+
+typedef struct _HV_CPUID_LEAF {
+    UINT32 Leaf;
+    UINT32 Subleaf;
+    UINT32 Eax;
+    UINT32 Ebx;
+    UINT32 Ecx;
+    UINT32 Edx;
+} HV_CPUID_LEAF, *PHV_CPUID_LEAF;
+
+typedef struct _HV_CPUID_INFO {
+    int HypervisorPresent;      // Leaf 1 ECX bit 31
+    char Vendor[13];            // 0x40000000 EBX:ECX:EDX
+    UINT32 MaxLeaf;             // 0x40000000 EAX
+    UINT32 Interface;           // 0x40000001 EAX
+    UINT32 BuildNumber;         // 0x40000002 EAX
+    UINT16 MajorVersion;        // 0x40000002 EBX[31:16]
+    UINT16 MinorVersion;        // 0x40000002 EBX[15:0]
+    UINT32 PartitionPrivileges; // 0x40000003 EAX
+    UINT32 PartitionFlags;      // 0x40000003 EBX
+    UINT32 PowerFeatures;       // 0x40000003 ECX
+    UINT32 MiscFeatures;        // 0x40000003 EDX
+    UINT32 Recommendations;     // 0x40000004 EAX
+    UINT32 SpinlockRetries;     // 0x40000004 EBX
+    UINT32 MaxVirtualProcessors;    // 0x40000005 EAX
+    UINT32 MaxLogicalProcessors;    // 0x40000005 EBX
+    UINT32 HardwareFeatures;    // 0x40000006 EAX
+    UINT32 NestedFeatures;      // 0x4000000A EAX (0 if the leaf is not reported)
+    int IsMicrosoftHv;          // Vendor "Microsoft Hv" and interface "Hv#1"
+    int IsRootPartition;        // CreatePartitions privilege
+    int IsNested;               // Nested hypervisor hint
+} HV_CPUID_INFO, *PHV_CPUID_INFO;
+
+// Fills regs[0..3] = EAX, EBX, ECX, EDX
+typedef void (*HV_CPUID_SOURCE)(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4]);
+
+// Captured leaves for HvCpuidTableSource; missing leaves read as zero
+typedef struct _HV_CPUID_TABLE {
+    const HV_CPUID_LEAF* Leaves;
+    UINT32 Count;
+} HV_CPUID_TABLE, *PHV_CPUID_TABLE;
+
+static __inline void HvCpuidTableSource(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4])
+{
+    const HV_CPUID_TABLE* table = (const HV_CPUID_TABLE*)context;
+    UINT32 i;
+
+    for (i = 0; i < table->Count; i++) {
+        if (table->Leaves[i].Leaf == leaf && table->Leaves[i].Subleaf == subleaf) {
+            regs[0] = table->Leaves[i].Eax;
+            regs[1] = table->Leaves[i].Ebx;
+            regs[2] = table->Leaves[i].Ecx;
+            regs[3] = table->Leaves[i].Edx;
+            return;
+        }
+    }
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+}
+
+static __inline void HvCpuidDecode(HV_CPUID_SOURCE source, void* context, PHV_CPUID_INFO info)
+{
+    UINT32 regs[4];
+
+    memset(info, 0, sizeof(*info));
+
+    source(context, HV_CPUID_FEATURES, 0, regs);
+    info->HypervisorPresent = (regs[2] & 0x80000000) != 0;
+    if (!info->HypervisorPresent) {
+        return;
+    }
+
+    source(context, HV_CPUID_VENDOR, 0, regs);
+    info->MaxLeaf = regs[0];
+    memcpy(info->Vendor, &regs[1], 4);
+    memcpy(info->Vendor + 4, &regs[2], 4);
+    memcpy(info->Vendor + 8, &regs[3], 4);
+    info->Vendor[12] = '\0';
+
+    // Leaves above MaxLeaf are undefined and not read
+    if (info->MaxLeaf >= HV_CPUID_INTERFACE) {
+        source(context, HV_CPUID_INTERFACE, 0, regs);
+        info->Interface = regs[0];
+    }
+    if (info->MaxLeaf >= HV_CPUID_VERSION) {
+        source(context, HV_CPUID_VERSION, 0, regs);
+        info->BuildNumber = regs[0];
+        info->MajorVersion = (UINT16)(regs[1] >> 16);
+        info->MinorVersion = (UINT16)(regs[1] & 0xFFFF);
+    }
+    if (info->MaxLeaf >= HV_CPUID_PARTITION_FEATURES) {
+        source(context, HV_CPUID_PARTITION_FEATURES, 0, regs);
+        info->PartitionPrivileges = regs[0];
+        info->PartitionFlags = regs[1];
+        info->PowerFeatures = regs[2];
+        info->MiscFeatures = regs[3];
+    }
+    if (info->MaxLeaf >= HV_CPUID_RECOMMENDATIONS) {
+        source(context, HV_CPUID_RECOMMENDATIONS, 0, regs);
+        info->Recommendations = regs[0];
+        info->SpinlockRetries = regs[1];
+    }
+    if (info->MaxLeaf >= HV_CPUID_LIMITS) {
+        source(context, HV_CPUID_LIMITS, 0, regs);
+        info->MaxVirtualProcessors = regs[0];
+        info->MaxLogicalProcessors = regs[1];
+    }
+    if (info->MaxLeaf >= HV_CPUID_HW_FEATURES) {
+        source(context, HV_CPUID_HW_FEATURES, 0, regs);
+        info->HardwareFeatures = regs[0];
+    }
+    if (info->MaxLeaf >= HV_CPUID_NESTED_FEATURES) {
+        source(context, HV_CPUID_NESTED_FEATURES, 0, regs);
+        info->NestedFeatures = regs[0];
+    }
+
+    info->IsMicrosoftHv = strcmp(info->Vendor, "Microsoft Hv") == 0 && info->Interface == HV_CPUID_INTERFACE_HV1;
+    info->IsRootPartition = info->IsMicrosoftHv && (info->PartitionFlags & HV_CPUID_PRIV_CREATE_PARTITIONS) != 0;
+    info->IsNested = info->IsMicrosoftHv && (info->Recommendations & HV_CPUID_HINT_NESTED) != 0;
+}
+
+#endif // CPUID_DECODE_H
@@ -0,0 +1,345 @@
+#pragma once
+#ifndef DETECTION_RULES_H
+#define DETECTION_RULES_H
+
+#include "cpuid_decode.h"
+#include <stdio.h>
+#include <string.h>
+
+//
+// Detection rules shared by the live checks and the fixture replay
+//
+// The checks in src/user_mode gather inputs from the OS (registry, SCM,
+// device tree, CPUID); the tables and decisions below say what those inputs
+// mean. src/tests/replay.c applies the same rules to captured inputs, so a
+// change here is checked against every fixture on any platform.
+//
+
+// Detection result flags
+#define HYPERV_DETECTED_NONE        0x00000000
+#define HYPERV_DETECTED_CPUID       0x00000001
+#define HYPERV_DETECTED_REGISTRY    0x00000002
+#define HYPERV_DETECTED_FILES       0x00000004
+#define HYPERV_DETECTED_SERVICES    0x00000008
+#define HYPERV_DETECTED_DEVICES     0x00000010
+#define HYPERV_DETECTED_BIOS        0x00000020
+#define HYPERV_DETECTED_PROCESSES   0x00000040
+#define HYPERV_DETECTED_HYPERCALLS  0x00000080
+#define HYPERV_DETECTED_OBJECTS     0x00000100
+#define HYPERV_DETECTED_NESTED      0x00000200
+#define HYPERV_DETECTED_SANDBOX     0x00000400
+#define HYPERV_DETECTED_DOCKER      0x00000800
+#define HYPERV_DETECTED_REMOVED     0x00001000
+
+// Short name of each HYPERV_DETECTED_* flag, indexed by bit (NULL-terminated)
+static __inline const char* const* HvDetectionFlagNames(void)
+{
+    static const char* const names[] = {
+        "cpuid", "registry", "files", "services", "devices", "bios", "processes",
+        "hypercalls", "objects", "nested", "sandbox", "docker", "removed",
+        NULL
+    };
+    return names;
+}
+
+// Registry locations read by more than one check (HKLM-relative)
+#define HV_REG_KEY_VMMEM            "SYSTEM\\CurrentControlSet\\Services\\Vmmem"
+#define HV_REG_KEY_DOCKER_DESKTOP   "SOFTWARE\\Docker Inc.\\Docker Desktop"
+#define HV_REG_KEY_BIOS             "HARDWARE\\DESCRIPTION\\System\\BIOS"
+#define HV_REG_KEY_ACPI_DSDT        "HARDWARE\\ACPI\\DSDT"
+#define HV_REG_KEY_DEVICEGUARD      "SYSTEM\\CurrentControlSet\\Control\\DeviceGuard"
+#define HV_REG_KEY_VIRTUALIZATION   "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Virtualization"
+#define HV_REG_KEY_SECUREBOOT_STATE "SYSTEM\\CurrentControlSet\\Control\\SecureBoot\\State"
+
+#define HV_REG_VALUE_VBS            "EnableVirtualizationBasedSecurity"
+#define HV_REG_VALUE_HVCI           "HypervisorEnforcedCodeIntegrity"
+#define HV_REG_VALUE_NESTED         "NestedVirtualization"
+#define HV_REG_VALUE_SECUREBOOT     "UEFISecureBootEnabled"
+
+// SMBIOS values Hyper-V reports for every guest
+#define HV_BIOS_MANUFACTURER        "Microsoft Corporation"
+#define HV_BIOS_PRODUCT             "Virtual Machine"
+
+// Keys whose presence alone indicates Hyper-V (NULL-terminated)
+static __inline const char* const* HvRegistryKeys(void)
+{
+    static const char* const keys[] = {
+        "SYSTEM\\CurrentControlSet\\Services\\vmbus",
+        "SYSTEM\\CurrentControlSet\\Services\\VMBusHID",
+        "SYSTEM\\CurrentControlSet\\Services\\hyperkbd",
+        "SYSTEM\\CurrentControlSet\\Services\\hypermouse",
+        "SYSTEM\\CurrentControlSet\\Services\\hvsocket",
+        "SYSTEM\\CurrentControlSet\\Services\\vmickvpexchange",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicheartbeat",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicshutdown",
+        "SYSTEM\\CurrentControlSet\\Services\\vmictimesync",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicvss",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicrdv",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicguestinterface",
+        "SYSTEM\\CurrentControlSet\\Services\\vmicvmsession",
+        "SOFTWARE\\Microsoft\\Virtual Machine\\Guest\\Parameters",
+        "SOFTWARE\\Microsoft\\VirtualMachine\\Guest\\Parameters",
+        "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e97d-e325-11ce-bfc1-08002be10318}\\0000\\DriverDesc",
+        "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e97d-e325-11ce-bfc1-08002be10318}\\0001\\DriverDesc",
+        "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e97d-e325-11ce-bfc1-08002be10318}\\0002\\DriverDesc",
+        "SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e97d-e325-11ce-bfc1-08002be10318}\\0003\\DriverDesc",
+        "SYSTEM\\CurrentControlSet\\Control\\VirtualDeviceDrivers",
+        HV_REG_KEY_VIRTUALIZATION,
+        NULL
+    };
+    return keys;
+}
+
+// Keys whose default value is matched by HvRegistryValueIsHyperV (NULL-terminated)
+static __inline const char* const* HvRegistryValueKeys(void)
+{
+    static const char* const keys[] = {
+        "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\SystemBiosVersion",
+        "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\SystemBiosDate",
+        "HARDWARE\\DESCRIPTION\\System\\SystemBiosVersion",
+        "HARDWARE\\DESCRIPTION\\System\\SystemBiosDate",
+        "HARDWARE\\DESCRIPTION\\System\\VideoBiosVersion",
+        "SYSTEM\\CurrentControlSet\\Control\\SystemInformation\\SystemProductName",
+        "SYSTEM\\CurrentControlSet\\Control\\SystemInformation\\SystemManufacturer",
+        NULL
+    };
+    return keys;
+}
+
+static __inline int HvRegistryValueIsHyperV(const char* data)
+{
+    return strstr(data, "Hyper-V") != NULL || strstr(data, "Microsoft Corporation") != NULL ||
+           strstr(data, "Virtual") != NULL || strstr(data, "VRTUAL") != NULL;
+}
+
+// Service names (NULL-terminated); the SCM matches them case-insensitively
+static __inline const char* const* HvServiceNames(void)
+{
+    static const char* const services[] = {
+        "vmms",               // Hyper-V Virtual Machine Management Service
+        "vmcompute",          // Hyper-V Host Compute Service
+        "vmickvpexchange",    // Hyper-V Data Exchange Service
+        "vmicheartbeat",      // Hyper-V Heartbeat Service
+        "vmicshutdown",       // Hyper-V Guest Shutdown Service
+        "vmictimesync",       // Hyper-V Time Synchronization Service
+        "vmicvss",            // Hyper-V Volume Shadow Copy Requestor
+        "vmicrdv",            // Hyper-V Remote Desktop Virtualization Service
+        "vmicguestinterface", // Hyper-V Guest Service Interface
+        "vmicvmsession",      // Hyper-V PowerShell Direct Service
+        "HvHost",             // HvHost Service
+        "vmbus",              // Hyper-V Virtual Machine Bus Provider
+        "hyperkbd",           // Hyper-V Keyboard Filter Driver
+        "hypermouse",         // Hyper-V Mouse Filter Driver
+        "hvsocket",           // Hyper-V Socket
+        "storvsc",            // Hyper-V Virtual Storage
+        "netvsc",             // Hyper-V Virtual Network
+        "Vmmem",              // Virtual Machine Memory
+        "WslService",         // Windows Subsystem for Linux Service
+        "LxssManager",        // LxssManager
+        "docker",             // Docker Engine
+        "com.docker.service", // Docker Desktop Service
+        NULL
+    };
+    return services;
+}
+
+// Device instance / hardware ID prefixes (NULL-terminated, case-insensitive)
+static __inline const char* const* HvDeviceIdPrefixes(void)
+{
+    static const char* const ids[] = {
+        "ROOT\\VMBUS",
+        "VMBUS\\{da0a7802-e377-4aac-8e77-0558eb1073f8}",  // Synthetic keyboard
+        "VMBUS\\{cfa8b69e-5b4a-4cc0-b98b-8ba1a1f3f95a}",  // Synthetic mouse
+        "VMBUS\\{f8615163-df3e-46c5-913f-f2d2f965ed0e}",  // Synthetic network adapter
+        "VMBUS\\{ba6163d9-04a1-4d29-b605-72e2ffb1dc7f}",  // Synthetic SCSI controller
+        "VMBUS\\{2f9bcc4a-0069-4af3-b76b-6fd0be528cda}",  // Synthetic fiber channel
+        "VMBUS\\{2497f4de-e9fa-4204-80e4-4b75c46419c0}",  // Synthetic RDMA adapter
+        "VMBUS\\{44c4f61d-4444-4400-9d52-802e27ede19f}",  // PCI Express pass-through
+        "VMBUS\\{276aacf4-ac15-426c-98dd-7521ad3f01fe}",  // Synthetic video
+        "VMBUS\\{fd149e91-82e0-4a7d-afa6-2a4166cbd7c0}",  // Synthetic DVD
+        "VMBUS\\{58f75a6d-d949-4320-99e1-a2a2576d581c}",  // Synthetic fiber channel HBA
+        "ROOT\\COMPOSITEBUS",
+        "ROOT\\RDPBUS",
+        "ROOT\\TERMINPT",
+        NULL
+    };
+    return ids;
+}
+
+// Substrings of a device description (NULL-terminated, case-sensitive)
+static __inline const char* const* HvDeviceNames(void)
+{
+    static const char* const names[] = {
+        "Microsoft Hyper-V",
+        "Hyper-V",
+        "Virtual Machine Bus",
+        "VMBus",
+        "Microsoft Virtual",
+        "Synthetic",
+        "VirtIO",
+        NULL
+    };
+    return names;
+}
+
+// Substrings of BIOSVendor / BIOSVersion (NULL-terminated)
+static __inline const char* const* HvBiosStrings(void)
+{
+    static const char* const strings[] = {
+        "Microsoft Corporation",
+        "Hyper-V",
+        "Virtual Machine",
+        "VRTUAL",
+        "A M I",
+        "American Megatrends",
+        NULL
+    };
+    return strings;
+}
+
+// Index of the first entry of list contained in text, or -1
+static __inline int HvRuleMatch(const char* text, const char* const* list)
+{
+    int i;
+
+    for (i = 0; list[i] != NULL; i++) {
+        if (strstr(text, list[i]) != NULL) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Case-insensitive ASCII prefix test, as the device tree and SCM compare names
+static __inline int HvRuleStartsWithNoCase(const char* text, const char* prefix)
+{
+    for (; *prefix != '\0'; text++, prefix++) {
+        char a = *text;
+        char b = *prefix;
+
+        if (a >= 'a' && a <= 'z') a = (char)(a - 'a' + 'A');
+        if (b >= 'a' && b <= 'z') b = (char)(b - 'a' + 'A');
+        if (a != b) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static __inline int HvRuleEqualsNoCase(const char* a, const char* b)
+{
+    return strlen(a) == strlen(b) && HvRuleStartsWithNoCase(a, b);
+}
+
+// Subkey name under HARDWARE\ACPI\DSDT (the DSDT OEM ID) from Hyper-V firmware
+static __inline int HvDsdtKeyIsHyperV(const char* name)
+{
+    return strstr(name, "VRTUAL") != NULL || strstr(name, "MSFT") != NULL;
+}
+
+//
+// VM generation
+//
+// Each indicator is a hint, not a proof (a Gen1 guest can have a TPM
+// service, a Gen2 guest a COM port), so the generation is a weighted vote.
+//
+typedef struct _HV_GENERATION_INDICATORS {
+    int HasUEFI;                // Gen2
+    int HasSecureBoot;          // Gen2
+    int HasTPM;                 // Gen2
+    int HasSCSIBoot;            // Gen2
+    int HasIDEController;       // Gen1
+    int HasFloppyController;    // Gen1
+    int HasCOMPorts;            // Gen1
+    int HasLegacyNIC;           // Gen1
+} HV_GENERATION_INDICATORS, *PHV_GENERATION_INDICATORS;
+
+// Emulated Gen1 devices: hardware ID prefix and the services that bind to them
+typedef struct _HV_GEN1_DEVICE {
+    const char* HardwareId;
+    const char* const* Services;    // NULL-terminated
+} HV_GEN1_DEVICE;
+
+static __inline const HV_GEN1_DEVICE* HvGen1IdeController(void)
+{
+    static const char* const services[] = { "intelide", "pciide", NULL };   // PIIX4 binds to intelide
+    static const HV_GEN1_DEVICE device = { "PCI\\VEN_8086&DEV_7111", services };
+    return &device;
+}
+
+static __inline const HV_GEN1_DEVICE* HvGen1FloppyController(void)
+{
+    static const char* const services[] = { "fdc", NULL };
+    static const HV_GEN1_DEVICE device = { "ACPI\\PNP0700", services };
+    return &device;
+}
+
+static __inline const HV_GEN1_DEVICE* HvGen1LegacyNic(void)
+{
+    static const char* const services[] = { "dc21x4", NULL };   // DEC 21140
+    static const HV_GEN1_DEVICE device = { "PCI\\VEN_1011&DEV_0009", services };
+    return &device;
+}
+
+// Device with this hardware (or instance) ID and service is the emulated device;
+// the ID also matches a device without a driver
+static __inline int HvGen1DeviceMatches(const HV_GEN1_DEVICE* device, const char* id, const char* service)
+{
+    int i;
+
+    if (id != NULL && HvRuleStartsWithNoCase(id, device->HardwareId)) {
+        return 1;
+    }
+    for (i = 0; service != NULL && device->Services[i] != NULL; i++) {
+        if (HvRuleEqualsNoCase(service, device->Services[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 1 or 2, or 0 when the votes tie
+static __inline int HvGenerationFromIndicators(const HV_GENERATION_INDICATORS* indicators)
+{
+    int gen1Score = 0;
+    int gen2Score = 0;
+
+    if (indicators->HasUEFI) gen2Score += 3;
+    if (indicators->HasSecureBoot) gen2Score += 2;
+    if (indicators->HasTPM) gen2Score += 2;
+    if (indicators->HasSCSIBoot) gen2Score += 2;
+
+    if (indicators->HasIDEController) gen1Score += 2;
+    if (indicators->HasFloppyController) gen1Score += 2;
+    if (indicators->HasCOMPorts) gen1Score += 1;
+    if (indicators->HasLegacyNIC) gen1Score += 2;
+    if (!indicators->HasUEFI) gen1Score += 3;
+
+    if (gen2Score > gen1Score) {
+        return 2;
+    } else if (gen1Score > gen2Score) {
+        return 1;
+    }
+    return 0;
+}
+
+//
+// Partition classification
+//
+// "BareMetal", "HyperV-RootPartition", "HyperV-GuestVM" or
+// "OtherHypervisor-<vendor>". Used as the test configuration name and as the
+// verdict the fixtures assert.
+//
+static __inline void HvClassifyPartition(const HV_CPUID_INFO* info, char* name, size_t nameSize)
+{
+    if (!info->HypervisorPresent) {
+        snprintf(name, nameSize, "BareMetal");
+    } else if (strcmp(info->Vendor, "Microsoft Hv") == 0) {
+        snprintf(name, nameSize, "%s",
+                 (info->PartitionFlags & HV_CPUID_PRIV_CREATE_PARTITIONS) ? "HyperV-RootPartition" : "HyperV-GuestVM");
+    } else {
+        snprintf(name, nameSize, "OtherHypervisor-%s", info->Vendor);
+    }
+}
+
+#endif // DETECTION_RULES_H
@@ -0,0 +1,390 @@
+#pragma once
+#ifndef FIRMWARE_PARSE_H
+#define FIRMWARE_PARSE_H
+
+#include "shared_structs.h"
+#include <string.h>
+
+//
+// Firmware table parsing - SMBIOS, ACPI and signature matching
+//
+// Input is the raw bytes the OS hands out:
+//
+//   SMBIOS  GetSystemFirmwareTable('RSMB') output: RawSMBIOSData header
+//           (HV_SMBIOS_RAW_HEADER_SIZE bytes) followed by the structure table.
+//           HvSmbiosParseTable() takes a bare structure table, e.g.
+//           /sys/firmware/dmi/tables/DMI.
+//   ACPI    Complete tables (header + body); HvAcpiNextTable() walks tables
+//           stored back to back.
+//
+// Every offset is checked against the buffer, so a truncated or malformed
+// table ends the walk instead of reading past it. No allocation, no OS
+// calls: the same code runs in the checks, the benchmarks and the fixture
+// tests.
+//
+#define HV_PARSE_E_SHORT            -1
+#define HV_PARSE_E_FORMAT           -2
+
+#define HV_SMBIOS_RAW_HEADER_SIZE   8
+#define HV_SMBIOS_STRING_LEN        64
+
+// SMBIOS structure types
+#define HV_SMBIOS_TYPE_BIOS         0
+#define HV_SMBIOS_TYPE_SYSTEM       1
+#define HV_SMBIOS_TYPE_BASEBOARD    2
+#define HV_SMBIOS_TYPE_OEM_STRINGS  11
+#define HV_SMBIOS_TYPE_END          127
+
+// HV_SMBIOS_INFO.Matches
+#define HV_SMBIOS_MATCH_BIOS        0x0001  // Vendor or version
+#define HV_SMBIOS_MATCH_SYSTEM      0x0002  // Manufacturer, product or version
+#define HV_SMBIOS_MATCH_BASEBOARD   0x0004  // Manufacturer or product
+#define HV_SMBIOS_MATCH_OEM         0x0008  // Any type 11 string
+#define HV_SMBIOS_MATCH_AMI_HYPERV  0x0010  // AMI BIOS with a Hyper-V version (090008)
+
+#define HV_ACPI_HEADER_SIZE         36
+#define HV_ACPI_SIG(a, b, c, d)     ((UINT32)(a) | ((UINT32)(b) << 8) | ((UINT32)(c) << 16) | ((UINT32)(d) << 24))
+
+// One structure of the SMBIOS table
+typedef struct _HV_SMBIOS_STRUCTURE {
+    UINT8 Type;
+    UINT8 Length;
+    UINT16 Handle;
+    const UINT8* Formatted;     // Length bytes, header included
+    const char* Strings;        // String set, double-NUL terminated
+    size_t StringsSize;         // Up to and including the terminator
+} HV_SMBIOS_STRUCTURE, *PHV_SMBIOS_STRUCTURE;
+
+typedef struct _HV_SMBIOS_INFO {
+    UINT8 MajorVersion;         // From the RSMB header (0 for a bare table)
+    UINT8 MinorVersion;
+    UINT32 StructureCount;
+    UINT32 Matches;             // HV_SMBIOS_MATCH_*
+    char BiosVendor[HV_SMBIOS_STRING_LEN];
+    char BiosVersion[HV_SMBIOS_STRING_LEN];
+    char SystemManufacturer[HV_SMBIOS_STRING_LEN];
+    char SystemProduct[HV_SMBIOS_STRING_LEN];
+    char SystemVersion[HV_SMBIOS_STRING_LEN];
+    char BaseboardManufacturer[HV_SMBIOS_STRING_LEN];
+    char BaseboardProduct[HV_SMBIOS_STRING_LEN];
+    char OemMatch[HV_SMBIOS_STRING_LEN];    // First matching OEM string
+    UINT8 SystemUuid[16];
+} HV_SMBIOS_INFO, *PHV_SMBIOS_INFO;
+
+typedef struct _HV_ACPI_TABLE_INFO {
+    UINT32 Signature;
+    UINT32 Length;
+    UINT8 Revision;
+    UINT8 ChecksumValid;
+    char Signature4[5];
+    char OemId[7];
+    char OemTableId[9];
+    char CreatorId[5];
+    UINT32 OemRevision;
+    UINT32 CreatorRevision;
+} HV_ACPI_TABLE_INFO, *PHV_ACPI_TABLE_INFO;
+
+// Strings found in Hyper-V SMBIOS data (NULL-terminated)
+static __inline const char* const* HvFirmwareSignatures(void)
+{
+    static const char* const signatures[] = {
+        "Microsoft Corporation",
+        "Hyper-V",
+        "Virtual Machine",
+        "VRTUAL",
+        "Msft Virtual",
+        "Virtual HD",
+        NULL
+    };
+    return signatures;
+}
+
+// Index of the first signature contained in text, or -1
+static __inline int HvSignatureMatch(const char* text, const char* const* signatures)
+{
+    int i;
+
+    if (text == NULL || text[0] == '\0') {
+        return -1;
+    }
+    for (i = 0; signatures[i] != NULL; i++) {
+        if (strstr(text, signatures[i]) != NULL) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static __inline void HvParseCopyString(char* dst, size_t dstSize, const char* src, size_t srcLength)
+{
+    size_t n = srcLength < dstSize - 1 ? srcLength : dstSize - 1;
+
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+// Next structure at *offset (advanced past it). 1 = structure returned,
+// 0 = end of table, end-of-table structure, or malformed structure.
+static __inline int HvSmbiosNext(const UINT8* table, size_t size, size_t* offset, PHV_SMBIOS_STRUCTURE structure)
+{
+    size_t start = *offset;
+    size_t p;
+
+    if (start + 4 > size) {
+        return 0;
+    }
+
+    structure->Type = table[start];
+    structure->Length = table[start + 1];
+    structure->Handle = (UINT16)(table[start + 2] | (table[start + 3] << 8));
+    if (structure->Length < 4 || start + structure->Length > size || structure->Type == HV_SMBIOS_TYPE_END) {
+        return 0;
+    }
+
+    // The string set ends with two NULs (an empty set is just the two NULs)
+    for (p = start + structure->Length; p + 1 < size; p++) {
+        if (table[p] == 0 && table[p + 1] == 0) {
+            break;
+        }
+    }
+    if (p + 1 >= size) {
+        return 0;
+    }
+
+    structure->Formatted = table + start;
+    structure->Strings = (const char*)table + start + structure->Length;
+    structure->StringsSize = p + 2 - (start + structure->Length);
+    *offset = p + 2;
+    return 1;
+}
+
+// String number index (1-based) of a structure; "" for 0 or a missing string
+static __inline const char* HvSmbiosString(const HV_SMBIOS_STRUCTURE* structure, UINT8 index)
+{
+    const char* s = structure->Strings;
+    const char* end = structure->Strings + structure->StringsSize;
+    UINT8 i;
+
+    if (index == 0) {
+        return "";
+    }
+    for (i = 1; i < index; i++) {
+        s += strlen(s) + 1;
+        if (s >= end || *s == '\0') {
+            return "";
+        }
+    }
+    return s;
+}
+
+// Byte at a formatted-area offset, or 0 if the structure is shorter
+static __inline UINT8 HvSmbiosByte(const HV_SMBIOS_STRUCTURE* structure, UINT8 offset)
+{
+    return offset < structure->Length ? structure->Formatted[offset] : 0;
+}
+
+static __inline void HvSmbiosCopyString(char* dst, const HV_SMBIOS_STRUCTURE* structure, UINT8 offset)
+{
+    const char* s = HvSmbiosString(structure, HvSmbiosByte(structure, offset));
+    HvParseCopyString(dst, HV_SMBIOS_STRING_LEN, s, strlen(s));
+}
+
+// Summarize a bare structure table
+static __inline int HvSmbiosParseTable(const void* table, size_t size, PHV_SMBIOS_INFO info)
+{
+    const char* const* signatures = HvFirmwareSignatures();
+    HV_SMBIOS_STRUCTURE s;
+    size_t offset = 0;
+    const char* oem;
+
+    memset(info, 0, sizeof(*info));
+
+    while (HvSmbiosNext((const UINT8*)table, size, &offset, &s)) {
+        info->StructureCount++;
+
+        switch (s.Type) {
+            case HV_SMBIOS_TYPE_BIOS:
+                HvSmbiosCopyString(info->BiosVendor, &s, 4);
+                HvSmbiosCopyString(info->BiosVersion, &s, 5);
+                if (HvSignatureMatch(info->BiosVendor, signatures) >= 0 ||
+                    HvSignatureMatch(info->BiosVersion, signatures) >= 0) {
+                    info->Matches |= HV_SMBIOS_MATCH_BIOS;
+                }
+                if (strstr(info->BiosVendor, "American Megatrends") && strstr(info->BiosVersion, "090008")) {
+                    info->Matches |= HV_SMBIOS_MATCH_AMI_HYPERV;
+                }
+                break;
+
+            case HV_SMBIOS_TYPE_SYSTEM:
+                HvSmbiosCopyString(info->SystemManufacturer, &s, 4);
+                HvSmbiosCopyString(info->SystemProduct, &s, 5);
+                HvSmbiosCopyString(info->SystemVersion, &s, 6);
+                if (s.Length >= 0x18) {
+                    memcpy(info->SystemUuid, s.Formatted + 8, 16);
+                }
+                if (HvSignatureMatch(info->SystemManufacturer, signatures) >= 0 ||
+                    HvSignatureMatch(info->SystemProduct, signatures) >= 0 ||
+                    HvSignatureMatch(info->SystemVersion, signatures) >= 0) {
+                    info->Matches |= HV_SMBIOS_MATCH_SYSTEM;
+                }
+                break;
+
+            case HV_SMBIOS_TYPE_BASEBOARD:
+                HvSmbiosCopyString(info->BaseboardManufacturer, &s, 4);
+                HvSmbiosCopyString(info->BaseboardProduct, &s, 5);
+                if (HvSignatureMatch(info->BaseboardManufacturer, signatures) >= 0 ||
+                    HvSignatureMatch(info->BaseboardProduct, signatures) >= 0) {
+                    info->Matches |= HV_SMBIOS_MATCH_BASEBOARD;
+                }
+                break;
+
+            case HV_SMBIOS_TYPE_OEM_STRINGS:
+                for (oem = s.Strings; *oem != '\0'; oem += strlen(oem) + 1) {
+                    if (!(info->Matches & HV_SMBIOS_MATCH_OEM) && HvSignatureMatch(oem, signatures) >= 0) {
+                        info->Matches |= HV_SMBIOS_MATCH_OEM;
+                        HvParseCopyString(info->OemMatch, sizeof(info->OemMatch), oem, strlen(oem));
+                    }
+                }
+                break;
+        }
+    }
+    return 0;
+}
+
+// Summarize GetSystemFirmwareTable('RSMB') output
+static __inline int HvSmbiosParseRaw(const void* raw, size_t size, PHV_SMBIOS_INFO info)
+{
+    const UINT8* p = (const UINT8*)raw;
+    UINT32 length;
+
+    if (size < HV_SMBIOS_RAW_HEADER_SIZE) {
+        return HV_PARSE_E_SHORT;
+    }
+    length = HvBatchLoad32(p + 4);
+    if (length > size - HV_SMBIOS_RAW_HEADER_SIZE) {
+        return HV_PARSE_E_SHORT;
+    }
+
+    HvSmbiosParseTable(p + HV_SMBIOS_RAW_HEADER_SIZE, length, info);
+    info->MajorVersion = p[1];
+    info->MinorVersion = p[2];
+    return 0;
+}
+
+// Decode a table header; the declared length must fit in the buffer
+static __inline int HvAcpiParseHeader(const void* table, size_t size, PHV_ACPI_TABLE_INFO info)
+{
+    const UINT8* p = (const UINT8*)table;
+    UINT8 sum = 0;
+    UINT32 i;
+
+    if (size < HV_ACPI_HEADER_SIZE) {
+        return HV_PARSE_E_SHORT;
+    }
+
+    info->Signature = HvBatchLoad32(p);
+    info->Length = HvBatchLoad32(p + 4);
+    if (info->Length < HV_ACPI_HEADER_SIZE) {
+        return HV_PARSE_E_FORMAT;
+    }
+    if (info->Length > size) {
+        return HV_PARSE_E_SHORT;
+    }
+
+    info->Revision = p[8];
+    HvParseCopyString(info->Signature4, sizeof(info->Signature4), (const char*)p, 4);
+    HvParseCopyString(info->OemId, sizeof(info->OemId), (const char*)p + 10, 6);
+    HvParseCopyString(info->OemTableId, sizeof(info->OemTableId), (const char*)p + 16, 8);
+    info->OemRevision = HvBatchLoad32(p + 24);
+    HvParseCopyString(info->CreatorId, sizeof(info->CreatorId), (const char*)p + 28, 4);
+    info->CreatorRevision = HvBatchLoad32(p + 32);
+
+    for (i = 0; i < info->Length; i++) {
+        sum = (UINT8)(sum + p[i]);
+    }
+    info->ChecksumValid = (sum == 0);
+    return 0;
+}
+
+// Next table of a back-to-back table blob (*offset advanced). 1 = table
+// returned, 0 = end or malformed.
+static __inline int HvAcpiNextTable(const UINT8* blob, size_t size, size_t* offset,
+                                    const UINT8** table, PHV_ACPI_TABLE_INFO info)
+{
+    if (*offset >= size || HvAcpiParseHeader(blob + *offset, size - *offset, info) != 0) {
+        return 0;
+    }
+    *table = blob + *offset;
+    *offset += info->Length;
+    return 1;
+}
+
+// Hypervisor named by an ACPI OEM ID (first 6 characters), or NULL
+static __inline const char* HvAcpiOemVmType(const char* oemId, int* isHyperV)
+{
+    static const struct {
+        const char* oemId;
+        const char* vmType;
+        int isHyperV;
+    } known[] = {
+        {"VRTUAL", "Hyper-V", 1},
+        {"MSFT  ", "Hyper-V", 1},
+        {"Msft  ", "Hyper-V", 1},
+        {"MSHYPR", "Hyper-V", 1},
+        {"VMWARE", "VMware", 0},
+        {"VBOX  ", "VirtualBox", 0},
+        {"QEMU  ", "QEMU", 0},
+        {"BOCHS ", "Bochs", 0},
+        {"AMAZON", "AWS", 0},
+        {"Google", "GCP", 0},
+        {"INTEL ", "Intel", 0},     // May appear in various VMs
+        {NULL, NULL, 0}
+    };
+    char normalized[7] = {0};
+    size_t length = strlen(oemId);
+    int i;
+
+    // OEM IDs are space padded to 6 characters
+    memset(normalized, ' ', 6);
+    memcpy(normalized, oemId, length < 6 ? length : 6);
+
+    for (i = 0; known[i].oemId != NULL; i++) {
+        if (memcmp(normalized, known[i].oemId, 6) == 0) {
+            if (isHyperV) {
+                *isHyperV = known[i].isHyperV;
+            }
+            return known[i].vmType;
+        }
+    }
+
+    if (isHyperV) {
+        *isHyperV = 0;
+    }
+    return NULL;
+}
+
+// Tables only Hyper-V firmware publishes
+static __inline int HvAcpiIsHyperVSignature(UINT32 signature)
+{
+    return signature == HV_ACPI_SIG('W', 'A', 'E', 'T') ||   // Windows ACPI Emulated Devices Table
+           signature == HV_ACPI_SIG('V', 'R', 'T', 'L') ||
+           signature == HV_ACPI_SIG('M', 'S', 'F', 'T');
+}
+
+// WAET EmulatedDeviceFlags (0), or HV_PARSE_E_* if the table is too short
+static __inline int HvAcpiWaetFlags(const void* table, size_t size, UINT32* flags)
+{
+    HV_ACPI_TABLE_INFO info;
+    int status = HvAcpiParseHeader(table, size, &info);
+
+    if (status != 0) {
+        return status;
+    }
+    if (info.Signature != HV_ACPI_SIG('W', 'A', 'E', 'T') || info.Length < HV_ACPI_HEADER_SIZE + 4) {
+        return HV_PARSE_E_FORMAT;
+    }
+    *flags = HvBatchLoad32((const UINT8*)table + HV_ACPI_HEADER_SIZE);
+    return 0;
+}
+
+#endif // FIRMWARE_PARSE_H
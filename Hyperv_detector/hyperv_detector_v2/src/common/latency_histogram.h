@@ -0,0 +1,235 @@
+#pragma once
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include "batch_fanout.h"
+
+//
+// IOCTL_HYPERV_EXIT_LATENCY - VM-exit cost histograms measured in the driver
+//
+// The driver runs a fixed battery of exiting instructions on each processor
+// in turn, with interrupts disabled for every chunk of HV_LATENCY_CHUNK
+// samples, and adds each TSC delta to a log2 histogram in the output buffer.
+//
+// Request:   HV_LATENCY_REQUEST
+// Response:  HV_LATENCY_HEADER, then ProcessorCount rows of ProbeCount
+//            HV_LATENCY_HISTOGRAM (row-major by processor)
+//
+// Bucket b counts deltas in [2^b, 2^(b+1)); bucket 0 also counts 0.
+// Both sides are x86/x64, so the structures are used in place; the sizes are
+// pinned below.
+//
+#define HV_LATENCY_MAGIC            0x484C5648  // "HVLH"
+#define HV_LATENCY_BUCKETS          64
+#define HV_LATENCY_CHUNK            64          // Samples per interrupts-off window
+#define HV_LATENCY_DEFAULT_SAMPLES  4096
+#define HV_LATENCY_MAX_SAMPLES      65536
+
+// Probes (HV_LATENCY_HISTOGRAM.Probe)
+#define HV_LATENCY_PROBE_BASELINE       0   // Empty timed region (measurement overhead)
+#define HV_LATENCY_PROBE_CPUID_0        1   // CPUID leaf 0
+#define HV_LATENCY_PROBE_CPUID_VENDOR   2   // CPUID 0x40000000
+#define HV_LATENCY_PROBE_CPUID_FEATURES 3   // CPUID 0x40000003
+#define HV_LATENCY_PROBE_RDMSR_VP_INDEX 4   // rdmsr HV_X64_MSR_VP_INDEX
+#define HV_LATENCY_PROBE_RDMSR_TIME_REF 5   // rdmsr HV_X64_MSR_TIME_REF_COUNT
+#define HV_LATENCY_PROBE_FAST_HYPERCALL 6   // HvCallNotifyLongSpinWait, fast calling convention
+#define HV_LATENCY_PROBE_COUNT          7
+
+#define HV_HYPERCALL_FAST_BIT           0x00010000
+
+typedef struct _HV_LATENCY_REQUEST {
+    UINT32 SamplesPerProbe;     // 0 = HV_LATENCY_DEFAULT_SAMPLES
+    UINT32 Reserved;
+} HV_LATENCY_REQUEST, *PHV_LATENCY_REQUEST;
+
+typedef struct _HV_LATENCY_HEADER {
+    UINT32 Magic;
+    UINT16 Version;
+    UINT16 ProbeCount;
+    UINT32 ProcessorCount;
+    UINT32 SamplesPerProbe;
+} HV_LATENCY_HEADER, *PHV_LATENCY_HEADER;
+
+typedef struct _HV_LATENCY_HISTOGRAM {
+    UINT64 Count;
+    UINT64 Sum;                 // TSC ticks
+    UINT64 Min;
+    UINT64 Max;
+    UINT32 Probe;
+    UINT32 Status;              // HV_BATCH_STATUS_* (NOT_SUPPORTED / FAULT: probe skipped)
+    UINT32 Buckets[HV_LATENCY_BUCKETS];
+} HV_LATENCY_HISTOGRAM, *PHV_LATENCY_HISTOGRAM;
+
+// Layout is part of the IOCTL contract
+typedef char HvLatencyHeaderSizeCheck[(sizeof(HV_LATENCY_HEADER) == 16) ? 1 : -1];
+typedef char HvLatencyHistogramSizeCheck[(sizeof(HV_LATENCY_HISTOGRAM) == 296) ? 1 : -1];
+
+static __inline UINT32 HvHistogramBucket(UINT64 value)
+{
+    UINT32 bucket = 0;
+
+    while (value > 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static __inline void HvHistogramReset(PHV_LATENCY_HISTOGRAM histogram, UINT32 probe)
+{
+    UINT32 i;
+
+    histogram->Count = 0;
+    histogram->Sum = 0;
+    histogram->Min = ~(UINT64)0;
+    histogram->Max = 0;
+    histogram->Probe = probe;
+    histogram->Status = HV_BATCH_STATUS_NOT_RUN;
+    for (i = 0; i < HV_LATENCY_BUCKETS; i++) {
+        histogram->Buckets[i] = 0;
+    }
+}
+
+static __inline void HvHistogramAdd(PHV_LATENCY_HISTOGRAM histogram, UINT64 value)
+{
+    histogram->Count++;
+    histogram->Sum += value;
+    if (value < histogram->Min) {
+        histogram->Min = value;
+    }
+    if (value > histogram->Max) {
+        histogram->Max = value;
+    }
+    histogram->Buckets[HvHistogramBucket(value)]++;
+}
+
+// Merge src into dst (same probe). A probe that ran anywhere counts as OK.
+static __inline void HvHistogramMerge(PHV_LATENCY_HISTOGRAM dst, const HV_LATENCY_HISTOGRAM* src)
+{
+    UINT32 i;
+
+    if (src->Status == HV_BATCH_STATUS_OK || dst->Status == HV_BATCH_STATUS_NOT_RUN) {
+        dst->Status = src->Status;
+    }
+    if (src->Count == 0) {
+        return;
+    }
+
+    dst->Count += src->Count;
+    dst->Sum += src->Sum;
+    if (src->Min < dst->Min) {
+        dst->Min = src->Min;
+    }
+    if (src->Max > dst->Max) {
+        dst->Max = src->Max;
+    }
+    for (i = 0; i < HV_LATENCY_BUCKETS; i++) {
+        dst->Buckets[i] += src->Buckets[i];
+    }
+}
+
+static __inline UINT64 HvHistogramMean(const HV_LATENCY_HISTOGRAM* histogram)
+{
+    return histogram->Count ? histogram->Sum / histogram->Count : 0;
+}
+
+// Upper bound of the bucket holding the given percentile (0-100), capped at Max
+static __inline UINT64 HvHistogramPercentile(const HV_LATENCY_HISTOGRAM* histogram, UINT32 percent)
+{
+    UINT64 rank, seen = 0;
+    UINT64 upper;
+    UINT32 i;
+
+    if (histogram->Count == 0) {
+        return 0;
+    }
+
+    rank = (histogram->Count * (percent > 100 ? 100 : percent) + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (i = 0; i < HV_LATENCY_BUCKETS; i++) {
+        seen += histogram->Buckets[i];
+        if (seen >= rank) {
+            upper = (i >= 63) ? ~(UINT64)0 : (((UINT64)2 << i) - 1);
+            return upper < histogram->Max ? upper : histogram->Max;
+        }
+    }
+    return histogram->Max;
+}
+
+static __inline size_t HvLatencyResponseSize(UINT32 processorCount)
+{
+    return sizeof(HV_LATENCY_HEADER) +
+           (size_t)processorCount * HV_LATENCY_PROBE_COUNT * sizeof(HV_LATENCY_HISTOGRAM);
+}
+
+static __inline PHV_LATENCY_HISTOGRAM HvLatencyGet(void* response, UINT32 processor, UINT32 probe)
+{
+    return (PHV_LATENCY_HISTOGRAM)((UINT8*)response + sizeof(HV_LATENCY_HEADER)) +
+           (size_t)processor * HV_LATENCY_PROBE_COUNT + probe;
+}
+
+// Write the header and reset every histogram
+static __inline void HvLatencyBegin(void* response, UINT32 processorCount, UINT32 samplesPerProbe)
+{
+    PHV_LATENCY_HEADER header = (PHV_LATENCY_HEADER)response;
+    UINT32 cpu, probe;
+
+    header->Magic = HV_LATENCY_MAGIC;
+    header->Version = HV_BATCH_VERSION;
+    header->ProbeCount = HV_LATENCY_PROBE_COUNT;
+    header->ProcessorCount = processorCount;
+    header->SamplesPerProbe = samplesPerProbe;
+
+    for (cpu = 0; cpu < processorCount; cpu++) {
+        for (probe = 0; probe < HV_LATENCY_PROBE_COUNT; probe++) {
+            HvHistogramReset(HvLatencyGet(response, cpu, probe), probe);
+        }
+    }
+}
+
+// Validate a response (0) or return HV_BATCH_E_*. Bucket totals must match
+// Count, so a truncated or corrupted buffer is not mistaken for data.
+static __inline int HvLatencyParse(const void* response, size_t size, UINT32* processorCount)
+{
+    const HV_LATENCY_HEADER* header = (const HV_LATENCY_HEADER*)response;
+    const HV_LATENCY_HISTOGRAM* histogram;
+    UINT64 total;
+    UINT32 n, i;
+
+    if (size < sizeof(HV_LATENCY_HEADER)) {
+        return HV_BATCH_E_SHORT;
+    }
+    if (header->Magic != HV_LATENCY_MAGIC) {
+        return HV_BATCH_E_MAGIC;
+    }
+    if (header->Version != HV_BATCH_VERSION) {
+        return HV_BATCH_E_VERSION;
+    }
+    if (header->ProbeCount != HV_LATENCY_PROBE_COUNT || header->ProcessorCount == 0 ||
+        header->ProcessorCount > HV_FANOUT_MAX_PROCESSORS) {
+        return HV_BATCH_E_COUNT;
+    }
+    if (size < HvLatencyResponseSize(header->ProcessorCount)) {
+        return HV_BATCH_E_SHORT;
+    }
+
+    histogram = (const HV_LATENCY_HISTOGRAM*)(header + 1);
+    for (n = 0; n < header->ProcessorCount * HV_LATENCY_PROBE_COUNT; n++, histogram++) {
+        total = 0;
+        for (i = 0; i < HV_LATENCY_BUCKETS; i++) {
+            total += histogram->Buckets[i];
+        }
+        if (total != histogram->Count || histogram->Probe != n % HV_LATENCY_PROBE_COUNT ||
+            histogram->Status > HV_BATCH_STATUS_NOT_RUN) {
+            return HV_BATCH_E_OP;
+        }
+    }
+
+    *processorCount = header->ProcessorCount;
+    return 0;
+}
+
+#endif // LATENCY_HISTOGRAM_H
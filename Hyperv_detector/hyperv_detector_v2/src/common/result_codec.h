@@ -0,0 +1,540 @@
+#pragma once
+#ifndef RESULT_CODEC_H
+#define RESULT_CODEC_H
+
+#include "shared_structs.h"
+#include <string.h>
+
+//
+// Compact binary detection result - one record per host and run
+//
+// Records can be concatenated into a stream. All integers are LEB128 varints
+// except the 4-byte header:
+//
+//   header   u8 'H', u8 'R', u8 version (HV_RESULT_VERSION),
+//            u8 flags (HV_RESULT_HAS_*), varint bodyLength
+//   body     varint detectionFlags (HYPERV_DETECTED_*)
+//            varint stringCount, stringCount x { varint length, bytes }
+//            varint fieldCount, fieldCount x { varint tag, value }
+//            [HV_RESULT_HAS_TIMINGS] varint count,
+//                                    count x { varint nameString, varint us }
+//
+// A field tag is (key << 3) | type. Keys below HV_RESULT_KEY_NAMED are the
+// well-known HV_RESULT_KEY_* fields; a key of HV_RESULT_KEY_NAMED + n is named
+// by string n (e.g. the method prefix of a detection detail line). Values:
+//
+//   HV_RESULT_TYPE_UINT    varint
+//   HV_RESULT_TYPE_STRING  varint string index
+//   HV_RESULT_TYPE_FALSE / HV_RESULT_TYPE_TRUE   no value
+//
+// Strings are UTF-8 without a terminator and stored once per record, so a
+// method name or path repeated by several details costs one varint each
+// time. Method names are not stored at all: they follow from the flags.
+//
+// The reader is zero-copy: HvResultParse validates a record once and the
+// HV_RESULT_TEXT it hands out point into the caller's buffer. Iterating a
+// parsed record cannot fail. bodyLength lets a reader step over a record it
+// rejects (HvResultRecordSize).
+//
+#define HV_RESULT_MAGIC0            'H'
+#define HV_RESULT_MAGIC1            'R'
+#define HV_RESULT_VERSION           1
+#define HV_RESULT_HEADER_SIZE       4
+
+#define HV_RESULT_HAS_TIMINGS       0x01
+
+#define HV_RESULT_MAX_STRINGS       255
+#define HV_RESULT_MAX_FIELDS        255
+#define HV_RESULT_MAX_TIMINGS       64
+#define HV_RESULT_MAX_VARINT        10
+
+// Field types (low 3 bits of a tag)
+#define HV_RESULT_TYPE_UINT         0
+#define HV_RESULT_TYPE_STRING       1
+#define HV_RESULT_TYPE_FALSE        2
+#define HV_RESULT_TYPE_TRUE         3
+
+// Well-known keys
+#define HV_RESULT_KEY_TOOL_VERSION  1   // UINT, major << 16 | minor << 8 | patch
+#define HV_RESULT_KEY_HOST          2   // STRING
+#define HV_RESULT_KEY_PROCESS_ID    3   // UINT
+#define HV_RESULT_KEY_PROCESS_NAME  4   // STRING
+#define HV_RESULT_KEY_VERDICT       5   // STRING
+#define HV_RESULT_KEY_HV_BUILD      6   // STRING, "major.minor.build"
+#define HV_RESULT_KEY_VBS           7   // TRUE/FALSE
+#define HV_RESULT_KEY_HVCI          8   // TRUE/FALSE
+#define HV_RESULT_KEY_LEVEL         9   // UINT, DETECTION_LEVEL
+#define HV_RESULT_KEY_NAMED         64  // + string index
+
+// Codec errors (negative return values)
+#define HV_RESULT_E_SHORT           (-1)    // Truncated record, or output buffer too small
+#define HV_RESULT_E_MAGIC           (-2)
+#define HV_RESULT_E_VERSION         (-3)
+#define HV_RESULT_E_CORRUPT         (-4)    // Bad varint, index, type or length
+#define HV_RESULT_E_LIMIT           (-5)    // Above an HV_RESULT_MAX_* limit
+
+// Text inside a record (or a writer's caller), not NUL-terminated
+typedef struct _HV_RESULT_TEXT {
+    const char* Data;
+    UINT32 Length;
+} HV_RESULT_TEXT, *PHV_RESULT_TEXT;
+
+typedef struct _HV_RESULT_FIELD {
+    UINT32 Key;
+    UINT32 Type;
+    UINT64 Value;               // UINT value; 0/1 for FALSE/TRUE
+    HV_RESULT_TEXT Name;        // Named keys only
+    HV_RESULT_TEXT Text;        // STRING fields only
+} HV_RESULT_FIELD, *PHV_RESULT_FIELD;
+
+typedef struct _HV_RESULT_TIMING {
+    HV_RESULT_TEXT Name;
+    UINT64 Microseconds;
+} HV_RESULT_TIMING, *PHV_RESULT_TIMING;
+
+// Encoder state. Text is referenced, not copied, until HvResultEncode.
+typedef struct _HV_RESULT_WRITER {
+    UINT32 DetectionFlags;
+    UINT32 StringCount;
+    UINT32 FieldCount;
+    UINT32 TimingCount;
+    int Overflow;               // A limit was hit; HvResultEncode fails
+    int HasTimings;
+    HV_RESULT_TEXT Strings[HV_RESULT_MAX_STRINGS];
+    struct {
+        UINT32 Tag;
+        UINT64 Value;
+    } Fields[HV_RESULT_MAX_FIELDS];
+    struct {
+        UINT32 Name;
+        UINT64 Microseconds;
+    } Timings[HV_RESULT_MAX_TIMINGS];
+} HV_RESULT_WRITER, *PHV_RESULT_WRITER;
+
+// Position in the fields or timings of a parsed record
+typedef struct _HV_RESULT_CURSOR {
+    const UINT8* Position;
+    UINT32 Remaining;
+} HV_RESULT_CURSOR, *PHV_RESULT_CURSOR;
+
+// A parsed record; Strings point into the parsed buffer
+typedef struct _HV_RESULT_VIEW {
+    UINT32 Version;
+    UINT32 HeaderFlags;
+    UINT32 DetectionFlags;
+    UINT32 StringCount;
+    UINT32 FieldCount;
+    UINT32 TimingCount;
+    const UINT8* Fields;
+    const UINT8* Timings;
+    const UINT8* End;
+    HV_RESULT_TEXT Strings[HV_RESULT_MAX_STRINGS];
+} HV_RESULT_VIEW, *PHV_RESULT_VIEW;
+
+// Name of a well-known key, NULL for others
+static __inline const char* HvResultKeyName(UINT32 key)
+{
+    static const char* const names[] = {
+        NULL, "tool_version", "host", "process_id", "process_name",
+        "verdict", "hv_build", "vbs", "hvci", "level"
+    };
+
+    return (key < sizeof(names) / sizeof(names[0])) ? names[key] : NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Varints
+// ----------------------------------------------------------------------------
+
+static __inline UINT32 HvResultVarintSize(UINT64 value)
+{
+    UINT32 size = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static __inline UINT8* HvResultPutVarint(UINT8* p, UINT64 value)
+{
+    while (value >= 0x80) {
+        *p++ = (UINT8)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (UINT8)value;
+    return p;
+}
+
+// 0 on success; rejects truncated and overlong (> 64-bit) varints
+static __inline int HvResultGetVarint(const UINT8** cursor, const UINT8* end, UINT64* value)
+{
+    const UINT8* p = *cursor;
+    UINT64 result = 0;
+    UINT32 shift = 0;
+
+    // One-byte fast path: flags, counts, indices and most lengths
+    if (p < end && *p < 0x80) {
+        *value = *p;
+        *cursor = p + 1;
+        return 0;
+    }
+    while (p < end && shift < 64) {
+        UINT8 byte = *p++;
+
+        result |= (UINT64)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            if (shift == 63 && byte > 1) {
+                return -1;
+            }
+            *value = result;
+            *cursor = p;
+            return 0;
+        }
+        shift += 7;
+    }
+    return -1;
+}
+
+// ----------------------------------------------------------------------------
+// Writer
+// ----------------------------------------------------------------------------
+
+static __inline void HvResultWriterInit(PHV_RESULT_WRITER writer, UINT32 detectionFlags)
+{
+    writer->DetectionFlags = detectionFlags;
+    writer->StringCount = 0;
+    writer->FieldCount = 0;
+    writer->TimingCount = 0;
+    writer->Overflow = 0;
+    writer->HasTimings = 0;
+}
+
+// String table index of text (added once), or -1 when the table is full
+static __inline int HvResultIntern(PHV_RESULT_WRITER writer, const char* data, size_t length)
+{
+    UINT32 i;
+
+    for (i = 0; i < writer->StringCount; i++) {
+        if (writer->Strings[i].Length == length && memcmp(writer->Strings[i].Data, data, length) == 0) {
+            return (int)i;
+        }
+    }
+    if (writer->StringCount == HV_RESULT_MAX_STRINGS) {
+        writer->Overflow = 1;
+        return -1;
+    }
+    writer->Strings[writer->StringCount].Data = data;
+    writer->Strings[writer->StringCount].Length = (UINT32)length;
+    return (int)writer->StringCount++;
+}
+
+static __inline void HvResultAddField(PHV_RESULT_WRITER writer, UINT32 key, UINT32 type, UINT64 value)
+{
+    if (writer->FieldCount == HV_RESULT_MAX_FIELDS) {
+        writer->Overflow = 1;
+        return;
+    }
+    writer->Fields[writer->FieldCount].Tag = (key << 3) | type;
+    writer->Fields[writer->FieldCount].Value = value;
+    writer->FieldCount++;
+}
+
+static __inline void HvResultAddUint(PHV_RESULT_WRITER writer, UINT32 key, UINT64 value)
+{
+    HvResultAddField(writer, key, HV_RESULT_TYPE_UINT, value);
+}
+
+static __inline void HvResultAddBool(PHV_RESULT_WRITER writer, UINT32 key, int value)
+{
+    HvResultAddField(writer, key, value ? HV_RESULT_TYPE_TRUE : HV_RESULT_TYPE_FALSE, 0);
+}
+
+static __inline void HvResultAddString(PHV_RESULT_WRITER writer, UINT32 key, const char* data, size_t length)
+{
+    int index = HvResultIntern(writer, data, length);
+
+    if (index >= 0) {
+        HvResultAddField(writer, key, HV_RESULT_TYPE_STRING, (UINT64)index);
+    }
+}
+
+// A string field under a key named by text, e.g. ("Registry", "Found key ...")
+static __inline void HvResultAddNamed(PHV_RESULT_WRITER writer, const char* name, size_t nameLength,
+                                      const char* data, size_t length)
+{
+    int key = HvResultIntern(writer, name, nameLength);
+
+    if (key >= 0) {
+        HvResultAddString(writer, HV_RESULT_KEY_NAMED + (UINT32)key, data, length);
+    }
+}
+
+static __inline void HvResultAddTiming(PHV_RESULT_WRITER writer, const char* name, UINT64 microseconds)
+{
+    int index = HvResultIntern(writer, name, strlen(name));
+
+    writer->HasTimings = 1;
+    if (index < 0 || writer->TimingCount == HV_RESULT_MAX_TIMINGS) {
+        writer->Overflow = 1;
+        return;
+    }
+    writer->Timings[writer->TimingCount].Name = (UINT32)index;
+    writer->Timings[writer->TimingCount].Microseconds = microseconds;
+    writer->TimingCount++;
+}
+
+// Returns the number of bytes written, or HV_RESULT_E_*
+static __inline int HvResultEncode(const HV_RESULT_WRITER* writer, void* buffer, size_t size)
+{
+    UINT8* p = (UINT8*)buffer;
+    size_t body;
+    size_t total;
+    UINT32 i;
+
+    if (writer->Overflow) {
+        return HV_RESULT_E_LIMIT;
+    }
+
+    body = HvResultVarintSize(writer->DetectionFlags) + HvResultVarintSize(writer->StringCount) +
+           HvResultVarintSize(writer->FieldCount);
+    for (i = 0; i < writer->StringCount; i++) {
+        body += HvResultVarintSize(writer->Strings[i].Length) + writer->Strings[i].Length;
+    }
+    for (i = 0; i < writer->FieldCount; i++) {
+        body += HvResultVarintSize(writer->Fields[i].Tag);
+        if ((writer->Fields[i].Tag & 7) <= HV_RESULT_TYPE_STRING) {
+            body += HvResultVarintSize(writer->Fields[i].Value);
+        }
+    }
+    if (writer->HasTimings) {
+        body += HvResultVarintSize(writer->TimingCount);
+        for (i = 0; i < writer->TimingCount; i++) {
+            body += HvResultVarintSize(writer->Timings[i].Name) +
+                    HvResultVarintSize(writer->Timings[i].Microseconds);
+        }
+    }
+
+    total = HV_RESULT_HEADER_SIZE + HvResultVarintSize(body) + body;
+    if (total > size || total > 0x7FFFFFFF) {
+        return HV_RESULT_E_SHORT;
+    }
+
+    *p++ = HV_RESULT_MAGIC0;
+    *p++ = HV_RESULT_MAGIC1;
+    *p++ = HV_RESULT_VERSION;
+    *p++ = writer->HasTimings ? HV_RESULT_HAS_TIMINGS : 0;
+    p = HvResultPutVarint(p, body);
+    p = HvResultPutVarint(p, writer->DetectionFlags);
+    p = HvResultPutVarint(p, writer->StringCount);
+    for (i = 0; i < writer->StringCount; i++) {
+        p = HvResultPutVarint(p, writer->Strings[i].Length);
+        memcpy(p, writer->Strings[i].Data, writer->Strings[i].Length);
+        p += writer->Strings[i].Length;
+    }
+    p = HvResultPutVarint(p, writer->FieldCount);
+    for (i = 0; i < writer->FieldCount; i++) {
+        p = HvResultPutVarint(p, writer->Fields[i].Tag);
+        if ((writer->Fields[i].Tag & 7) <= HV_RESULT_TYPE_STRING) {
+            p = HvResultPutVarint(p, writer->Fields[i].Value);
+        }
+    }
+    if (writer->HasTimings) {
+        p = HvResultPutVarint(p, writer->TimingCount);
+        for (i = 0; i < writer->TimingCount; i++) {
+            p = HvResultPutVarint(p, writer->Timings[i].Name);
+            p = HvResultPutVarint(p, writer->Timings[i].Microseconds);
+        }
+    }
+    return (int)total;
+}
+
+// ----------------------------------------------------------------------------
+// Reader
+// ----------------------------------------------------------------------------
+
+// Size of the record at buffer (header included), or HV_RESULT_E_*; only the
+// header is checked, so a stream can skip records of another version
+static __inline int HvResultRecordSize(const void* buffer, size_t size)
+{
+    const UINT8* p = (const UINT8*)buffer;
+    const UINT8* end = p + size;
+    UINT64 body;
+
+    if (size < HV_RESULT_HEADER_SIZE + 1) {
+        return HV_RESULT_E_SHORT;
+    }
+    if (p[0] != HV_RESULT_MAGIC0 || p[1] != HV_RESULT_MAGIC1) {
+        return HV_RESULT_E_MAGIC;
+    }
+    p += HV_RESULT_HEADER_SIZE;
+    if (HvResultGetVarint(&p, end, &body) != 0) {
+        return (end - p < HV_RESULT_MAX_VARINT) ? HV_RESULT_E_SHORT : HV_RESULT_E_CORRUPT;
+    }
+    if (body > 0x7FFFFFFF - (UINT64)(p - (const UINT8*)buffer)) {
+        return HV_RESULT_E_CORRUPT;
+    }
+    if (body > (UINT64)(end - p)) {
+        return HV_RESULT_E_SHORT;
+    }
+    return (int)((p - (const UINT8*)buffer) + body);
+}
+
+// Decode the field at *cursor of a validated record (no bounds checks needed)
+static __inline void HvResultDecodeField(const HV_RESULT_VIEW* view, const UINT8** cursor, PHV_RESULT_FIELD field)
+{
+    UINT64 tag = 0;
+    UINT64 value = 0;
+
+    HvResultGetVarint(cursor, view->End, &tag);
+    field->Key = (UINT32)(tag >> 3);
+    field->Type = (UINT32)(tag & 7);
+    if (field->Type <= HV_RESULT_TYPE_STRING) {
+        HvResultGetVarint(cursor, view->End, &value);
+    }
+    field->Value = (field->Type == HV_RESULT_TYPE_TRUE) ? 1 : value;
+    field->Name.Data = NULL;
+    field->Name.Length = 0;
+    field->Text.Data = NULL;
+    field->Text.Length = 0;
+    if (field->Key >= HV_RESULT_KEY_NAMED) {
+        field->Name = view->Strings[field->Key - HV_RESULT_KEY_NAMED];
+    }
+    if (field->Type == HV_RESULT_TYPE_STRING) {
+        field->Text = view->Strings[value];
+    }
+}
+
+// Validate one record; returns its size, or HV_RESULT_E_*
+static __inline int HvResultParse(const void* buffer, size_t size, PHV_RESULT_VIEW view)
+{
+    const UINT8* p = (const UINT8*)buffer;
+    const UINT8* end;
+    UINT64 value;
+    UINT64 count;
+    UINT64 index;
+    UINT32 i;
+    int total = HvResultRecordSize(buffer, size);
+
+    if (total < 0) {
+        return total;
+    }
+    if (p[2] != HV_RESULT_VERSION) {
+        return HV_RESULT_E_VERSION;
+    }
+    view->Version = p[2];
+    view->HeaderFlags = p[3];
+    end = p + total;
+    view->End = end;
+    p += HV_RESULT_HEADER_SIZE;
+    HvResultGetVarint(&p, end, &value);     // Body length, checked above
+
+    if (HvResultGetVarint(&p, end, &value) != 0 || value > 0xFFFFFFFF) {
+        return HV_RESULT_E_CORRUPT;
+    }
+    view->DetectionFlags = (UINT32)value;
+
+    if (HvResultGetVarint(&p, end, &count) != 0) {
+        return HV_RESULT_E_CORRUPT;
+    }
+    if (count > HV_RESULT_MAX_STRINGS) {
+        return HV_RESULT_E_LIMIT;
+    }
+    view->StringCount = (UINT32)count;
+    for (i = 0; i < view->StringCount; i++) {
+        if (HvResultGetVarint(&p, end, &value) != 0 || value > (UINT64)(end - p)) {
+            return HV_RESULT_E_CORRUPT;
+        }
+        view->Strings[i].Data = (const char*)p;
+        view->Strings[i].Length = (UINT32)value;
+        p += value;
+    }
+
+    if (HvResultGetVarint(&p, end, &count) != 0) {
+        return HV_RESULT_E_CORRUPT;
+    }
+    if (count > HV_RESULT_MAX_FIELDS) {
+        return HV_RESULT_E_LIMIT;
+    }
+    view->FieldCount = (UINT32)count;
+    view->Fields = p;
+    for (i = 0; i < view->FieldCount; i++) {
+        if (HvResultGetVarint(&p, end, &value) != 0 || (value & 7) > HV_RESULT_TYPE_TRUE) {
+            return HV_RESULT_E_CORRUPT;
+        }
+        // Unknown well-known keys pass through; named keys must resolve
+        if ((value >> 3) == 0 ||
+            ((value >> 3) >= HV_RESULT_KEY_NAMED && (value >> 3) - HV_RESULT_KEY_NAMED >= view->StringCount)) {
+            return HV_RESULT_E_CORRUPT;
+        }
+        if ((value & 7) <= HV_RESULT_TYPE_STRING) {
+            if (HvResultGetVarint(&p, end, &index) != 0 ||
+                ((value & 7) == HV_RESULT_TYPE_STRING && index >= view->StringCount)) {
+                return HV_RESULT_E_CORRUPT;
+            }
+        }
+    }
+
+    view->TimingCount = 0;
+    view->Timings = NULL;
+    if (view->HeaderFlags & HV_RESULT_HAS_TIMINGS) {
+        if (HvResultGetVarint(&p, end, &count) != 0) {
+            return HV_RESULT_E_CORRUPT;
+        }
+        if (count > HV_RESULT_MAX_TIMINGS) {
+            return HV_RESULT_E_LIMIT;
+        }
+        view->TimingCount = (UINT32)count;
+        view->Timings = p;
+        for (i = 0; i < view->TimingCount; i++) {
+            if (HvResultGetVarint(&p, end, &index) != 0 || index >= view->StringCount ||
+                HvResultGetVarint(&p, end, &value) != 0) {
+                return HV_RESULT_E_CORRUPT;
+            }
+        }
+    }
+    // Bytes left in the body belong to later minor revisions and are ignored
+    return total;
+}
+
+// Iterate the fields or timings of a parsed record: init the cursor, then call
+// Next until it returns 0
+static __inline void HvResultFields(const HV_RESULT_VIEW* view, PHV_RESULT_CURSOR cursor)
+{
+    cursor->Position = view->Fields;
+    cursor->Remaining = view->FieldCount;
+}
+
+static __inline void HvResultTimings(const HV_RESULT_VIEW* view, PHV_RESULT_CURSOR cursor)
+{
+    cursor->Position = view->Timings;
+    cursor->Remaining = view->TimingCount;
+}
+
+static __inline int HvResultNextField(const HV_RESULT_VIEW* view, PHV_RESULT_CURSOR cursor, PHV_RESULT_FIELD field)
+{
+    if (cursor->Remaining == 0) {
+        return 0;
+    }
+    HvResultDecodeField(view, &cursor->Position, field);
+    cursor->Remaining--;
+    return 1;
+}
+
+static __inline int HvResultNextTiming(const HV_RESULT_VIEW* view, PHV_RESULT_CURSOR cursor, PHV_RESULT_TIMING timing)
+{
+    UINT64 name = 0;
+
+    if (cursor->Remaining == 0) {
+        return 0;
+    }
+    timing->Microseconds = 0;
+    HvResultGetVarint(&cursor->Position, view->End, &name);
+    HvResultGetVarint(&cursor->Position, view->End, &timing->Microseconds);
+    timing->Name = view->Strings[name];
+    cursor->Remaining--;
+    return 1;
+}
+
+#endif // RESULT_CODEC_H
@@ -4,10 +4,33 @@
 
 //#include "common.h"
 
+// Non-Windows builds (codec unit tests and fuzzing) get the few Windows
+// types and macros this header needs from the C standard headers.
+#if !defined(_WIN32)
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t  UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef uint32_t DWORD;
+typedef uint64_t ULONGLONG;
+
+#define FILE_DEVICE_UNKNOWN 0x00000022
+#define METHOD_BUFFERED     0
+#define FILE_ANY_ACCESS     0
+#define CTL_CODE(DeviceType, Function, Method, Access) \
+    (((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+#endif
+
 // IOCTL codes for driver communication
 #define IOCTL_HYPERV_CHECK_HYPERCALL CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #define IOCTL_HYPERV_CHECK_MSR       CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #define IOCTL_HYPERV_CHECK_VMBUS     CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_HYPERV_BATCH           CTL_CODE(FILE_DEVICE_UNKNOWN, 0x803, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_HYPERV_BATCH_ALL_CPUS  CTL_CODE(FILE_DEVICE_UNKNOWN, 0x804, METHOD_BUFFERED, FILE_ANY_ACCESS)  // see batch_fanout.h
+#define IOCTL_HYPERV_EXIT_LATENCY    CTL_CODE(FILE_DEVICE_UNKNOWN, 0x805, METHOD_BUFFERED, FILE_ANY_ACCESS)  // see latency_histogram.h
 
 // Hyper-V MSR constants
 #define HV_X64_MSR_GUEST_OS_ID      0x40000000
@@ -15,8 +38,10 @@
 #define HV_X64_MSR_VP_INDEX         0x40000002
 #define HV_X64_MSR_RESET            0x40000003
 #define HV_X64_MSR_VP_RUNTIME       0x40000010
+#define HV_X64_MSR_TIME_REF_COUNT   0x40000020
 
 // Hypercall codes
+#define HVCALL_NOTIFY_LONG_SPIN_WAIT 0x0008
 #define HVCALL_POST_MESSAGE         0x005C
 #define HVCALL_SIGNAL_EVENT         0x005D
 #define HVCALL_GET_PARTITION_ID     0x0046
@@ -42,4 +67,280 @@ typedef struct _MSR_OUTPUT {
     ULONGLONG Value;
 } MSR_OUTPUT, *PMSR_OUTPUT;
 
+//
+// IOCTL_HYPERV_BATCH - several operations in one DeviceIoControl call
+//
+// The buffers are encoded explicitly (little-endian, no struct padding) so the
+// same codec runs in the driver, in user mode and in non-Windows unit tests.
+//
+// Request:   u32 magic 'HVBQ' | u16 version | u16 count | count x op
+//   op:      u16 type | u16 flags (0) | u32 arg[3]                    16 bytes
+// Response:  u32 magic 'HVBR' | u16 version | u16 count | count x result
+//   result:  u16 type | u16 status | u32 detail | u32 value[4]        24 bytes
+//
+// Operation arguments and values:
+//   RDMSR      arg[0] = MSR index                   value[0..1] = low, high
+//   CPUID      arg[0] = leaf, arg[1] = subleaf      value[0..3] = EAX..EDX
+//   HYPERCALL  arg[0] = code, arg[1] = input count, arg[2] = output count
+//                                                   value[0] = output value
+//   VP_INDEX   (no arguments)                       value[0] = HV_X64_MSR_VP_INDEX
+//
+// detail carries the driver's NTSTATUS for operations that did not succeed.
+//
+#define HV_BATCH_REQUEST_MAGIC      0x51425648  // "HVBQ"
+#define HV_BATCH_RESPONSE_MAGIC     0x52425648  // "HVBR"
+#define HV_BATCH_VERSION            1
+#define HV_BATCH_MAX_OPS            256
+
+#define HV_BATCH_HEADER_SIZE        8
+#define HV_BATCH_OP_SIZE            16
+#define HV_BATCH_RESULT_SIZE        24
+
+// Operation types
+#define HV_BATCH_OP_RDMSR           1
+#define HV_BATCH_OP_CPUID           2
+#define HV_BATCH_OP_HYPERCALL       3
+#define HV_BATCH_OP_VP_INDEX        4
+
+// Per-operation status
+#define HV_BATCH_STATUS_OK              0
+#define HV_BATCH_STATUS_FAULT           1   // #GP or other exception (MSR not implemented)
+#define HV_BATCH_STATUS_NOT_SUPPORTED   2   // No hypervisor, no hypercall page, or not x86/x64
+#define HV_BATCH_STATUS_HV_ERROR        3   // Hypercall returned a non-zero HV_STATUS
+#define HV_BATCH_STATUS_NOT_RUN         4   // Processor never ran the batch (fan-out only)
+
+// Codec errors (negative return values)
+#define HV_BATCH_E_SHORT            (-1)    // Buffer too small for the declared count
+#define HV_BATCH_E_MAGIC            (-2)
+#define HV_BATCH_E_VERSION          (-3)
+#define HV_BATCH_E_COUNT            (-4)    // Zero, above HV_BATCH_MAX_OPS, or above the caller's array
+#define HV_BATCH_E_OP               (-5)    // Unknown operation type, non-zero flags, or bad status
+
+typedef struct _HV_BATCH_OP {
+    UINT16 Type;
+    UINT16 Flags;
+    UINT32 Arg[3];
+} HV_BATCH_OP, *PHV_BATCH_OP;
+
+typedef struct _HV_BATCH_RESULT {
+    UINT16 Type;
+    UINT16 Status;
+    UINT32 Detail;
+    UINT32 Value[4];
+} HV_BATCH_RESULT, *PHV_BATCH_RESULT;
+
+static __inline size_t HvBatchRequestSize(UINT32 count)
+{
+    return HV_BATCH_HEADER_SIZE + (size_t)count * HV_BATCH_OP_SIZE;
+}
+
+static __inline size_t HvBatchResponseSize(UINT32 count)
+{
+    return HV_BATCH_HEADER_SIZE + (size_t)count * HV_BATCH_RESULT_SIZE;
+}
+
+static __inline UINT64 HvBatchResultValue64(const HV_BATCH_RESULT* result)
+{
+    return ((UINT64)result->Value[1] << 32) | result->Value[0];
+}
+
+static __inline UINT32 HvBatchLoad16(const UINT8* p)
+{
+    return (UINT32)p[0] | ((UINT32)p[1] << 8);
+}
+
+static __inline UINT32 HvBatchLoad32(const UINT8* p)
+{
+    return (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static __inline void HvBatchStore16(UINT8* p, UINT32 value)
+{
+    p[0] = (UINT8)value;
+    p[1] = (UINT8)(value >> 8);
+}
+
+static __inline void HvBatchStore32(UINT8* p, UINT32 value)
+{
+    p[0] = (UINT8)value;
+    p[1] = (UINT8)(value >> 8);
+    p[2] = (UINT8)(value >> 16);
+    p[3] = (UINT8)(value >> 24);
+}
+
+static __inline int HvBatchIsKnownOp(UINT32 type)
+{
+    return type >= HV_BATCH_OP_RDMSR && type <= HV_BATCH_OP_VP_INDEX;
+}
+
+// Validate a header and return the operation count, or HV_BATCH_E_*.
+// entrySize is HV_BATCH_OP_SIZE for requests, HV_BATCH_RESULT_SIZE for responses.
+static __inline int HvBatchParseHeader(const void* buffer, size_t size, UINT32 magic, size_t entrySize)
+{
+    const UINT8* p = (const UINT8*)buffer;
+    UINT32 count;
+
+    if (size < HV_BATCH_HEADER_SIZE) {
+        return HV_BATCH_E_SHORT;
+    }
+    if (HvBatchLoad32(p) != magic) {
+        return HV_BATCH_E_MAGIC;
+    }
+    if (HvBatchLoad16(p + 4) != HV_BATCH_VERSION) {
+        return HV_BATCH_E_VERSION;
+    }
+
+    count = HvBatchLoad16(p + 6);
+    if (count == 0 || count > HV_BATCH_MAX_OPS) {
+        return HV_BATCH_E_COUNT;
+    }
+    if (size < HV_BATCH_HEADER_SIZE + (size_t)count * entrySize) {
+        return HV_BATCH_E_SHORT;
+    }
+    return (int)count;
+}
+
+static __inline void HvBatchWriteHeader(void* buffer, UINT32 magic, UINT32 count)
+{
+    UINT8* p = (UINT8*)buffer;
+
+    HvBatchStore32(p, magic);
+    HvBatchStore16(p + 4, HV_BATCH_VERSION);
+    HvBatchStore16(p + 6, count);
+}
+
+// Decode operation 'index' of a request whose header was already validated
+static __inline int HvBatchGetOp(const void* buffer, UINT32 index, PHV_BATCH_OP op)
+{
+    const UINT8* p = (const UINT8*)buffer + HvBatchRequestSize(index);
+    int i;
+
+    op->Type  = (UINT16)HvBatchLoad16(p);
+    op->Flags = (UINT16)HvBatchLoad16(p + 2);
+    for (i = 0; i < 3; i++) {
+        op->Arg[i] = HvBatchLoad32(p + 4 + 4 * i);
+    }
+    return (HvBatchIsKnownOp(op->Type) && op->Flags == 0) ? 0 : HV_BATCH_E_OP;
+}
+
+// Encode / decode one HV_BATCH_RESULT_SIZE result entry at p
+static __inline void HvBatchStoreResult(UINT8* p, const HV_BATCH_RESULT* result)
+{
+    int i;
+
+    HvBatchStore16(p, result->Type);
+    HvBatchStore16(p + 2, result->Status);
+    HvBatchStore32(p + 4, result->Detail);
+    for (i = 0; i < 4; i++) {
+        HvBatchStore32(p + 8 + 4 * i, result->Value[i]);
+    }
+}
+
+static __inline int HvBatchLoadResult(const UINT8* p, PHV_BATCH_RESULT result)
+{
+    int i;
+
+    result->Type   = (UINT16)HvBatchLoad16(p);
+    result->Status = (UINT16)HvBatchLoad16(p + 2);
+    result->Detail = HvBatchLoad32(p + 4);
+    for (i = 0; i < 4; i++) {
+        result->Value[i] = HvBatchLoad32(p + 8 + 4 * i);
+    }
+    return (HvBatchIsKnownOp(result->Type) && result->Status <= HV_BATCH_STATUS_NOT_RUN) ? 0 : HV_BATCH_E_OP;
+}
+
+// Encode result 'index' of a response (header written separately)
+static __inline void HvBatchPutResult(void* buffer, UINT32 index, const HV_BATCH_RESULT* result)
+{
+    HvBatchStoreResult((UINT8*)buffer + HvBatchResponseSize(index), result);
+}
+
+// Returns the number of bytes written, or HV_BATCH_E_*
+static __inline int HvBatchEncodeRequest(void* buffer, size_t size, const HV_BATCH_OP* ops, UINT32 count)
+{
+    UINT8* p;
+    UINT32 n;
+    int i;
+
+    if (count == 0 || count > HV_BATCH_MAX_OPS) {
+        return HV_BATCH_E_COUNT;
+    }
+    if (size < HvBatchRequestSize(count)) {
+        return HV_BATCH_E_SHORT;
+    }
+
+    HvBatchWriteHeader(buffer, HV_BATCH_REQUEST_MAGIC, count);
+    for (n = 0; n < count; n++) {
+        if (!HvBatchIsKnownOp(ops[n].Type) || ops[n].Flags != 0) {
+            return HV_BATCH_E_OP;
+        }
+        p = (UINT8*)buffer + HvBatchRequestSize(n);
+        HvBatchStore16(p, ops[n].Type);
+        HvBatchStore16(p + 2, ops[n].Flags);
+        for (i = 0; i < 3; i++) {
+            HvBatchStore32(p + 4 + 4 * i, ops[n].Arg[i]);
+        }
+    }
+    return (int)HvBatchRequestSize(count);
+}
+
+// Returns the operation count, or HV_BATCH_E_*
+static __inline int HvBatchDecodeRequest(const void* buffer, size_t size, PHV_BATCH_OP ops, UINT32 maxOps)
+{
+    int count = HvBatchParseHeader(buffer, size, HV_BATCH_REQUEST_MAGIC, HV_BATCH_OP_SIZE);
+    int n;
+
+    if (count < 0) {
+        return count;
+    }
+    if ((UINT32)count > maxOps) {
+        return HV_BATCH_E_COUNT;
+    }
+    for (n = 0; n < count; n++) {
+        if (HvBatchGetOp(buffer, (UINT32)n, &ops[n]) != 0) {
+            return HV_BATCH_E_OP;
+        }
+    }
+    return count;
+}
+
+// Returns the number of bytes written, or HV_BATCH_E_*
+static __inline int HvBatchEncodeResponse(void* buffer, size_t size, const HV_BATCH_RESULT* results, UINT32 count)
+{
+    UINT32 n;
+
+    if (count == 0 || count > HV_BATCH_MAX_OPS) {
+        return HV_BATCH_E_COUNT;
+    }
+    if (size < HvBatchResponseSize(count)) {
+        return HV_BATCH_E_SHORT;
+    }
+
+    HvBatchWriteHeader(buffer, HV_BATCH_RESPONSE_MAGIC, count);
+    for (n = 0; n < count; n++) {
+        HvBatchPutResult(buffer, n, &results[n]);
+    }
+    return (int)HvBatchResponseSize(count);
+}
+
+// Returns the result count, or HV_BATCH_E_*
+static __inline int HvBatchDecodeResponse(const void* buffer, size_t size, PHV_BATCH_RESULT results, UINT32 maxResults)
+{
+    int count = HvBatchParseHeader(buffer, size, HV_BATCH_RESPONSE_MAGIC, HV_BATCH_RESULT_SIZE);
+    int n;
+
+    if (count < 0) {
+        return count;
+    }
+    if ((UINT32)count > maxResults) {
+        return HV_BATCH_E_COUNT;
+    }
+    for (n = 0; n < count; n++) {
+        if (HvBatchLoadResult((const UINT8*)buffer + HvBatchResponseSize((UINT32)n), &results[n]) != 0) {
+            return HV_BATCH_E_OP;
+        }
+    }
+    return count;
+}
+
 #endif // SHARED_STRUCTS_H
\ No newline at end of file
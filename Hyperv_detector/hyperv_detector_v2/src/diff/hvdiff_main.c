@@ -0,0 +1,417 @@
+/**
+ * hvdiff_main.c - hvdiff: why did a host's verdict change between two runs
+ *
+ * Compares two snapshots (fixture directories, see fixture.h) or two
+ * hyperv_detector --json results and prints one line per differing key
+ * (snapshot_diff.h):
+ *
+ *   hvdiff snapshots/host1-monday snapshots/host1-tuesday
+ *   hvdiff monday.json tuesday.json
+ *   hvdiff --pairs drift.txt --json > drift.ndjson
+ *
+ * A pairs file lists "<before> <after>" per line (tab-separated if the paths
+ * hold spaces; '#' starts a comment). Exit code 0 means no differences, 1
+ * differences, 2 an error, as with diff(1). Builds on Linux with:
+ *
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=200809L -O2 -Wall -o hvdiff \
+ *       src/diff/hvdiff_main.c src/diff/snapshot_diff.c src/tests/fixture.c \
+ *       src/tests/replay.c src/fleet/fleet_store.c
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "snapshot_diff.h"
+#include "../fleet/fleet_store.h"
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#ifndef S_ISDIR
+#define S_ISDIR(mode) (((mode) & S_IFMT) == S_IFDIR)
+#endif
+
+#define HVDIFF_PATH_LEN     512
+
+typedef struct _HVDIFF_OPTIONS {
+    int JsonOutput;
+    int Quiet;
+} HVDIFF_OPTIONS;
+
+/* What the printer needs for one pair */
+typedef struct _HVDIFF_PAIR {
+    const HVDIFF_OPTIONS* Options;
+    const char* Before;
+    const char* After;
+    int Printed;                /* Header line written */
+} HVDIFF_PAIR;
+
+/* One side of a pair, loaded */
+typedef struct _HVDIFF_INPUT {
+    int IsSnapshot;
+    HV_FIXTURE Snapshot;
+    HV_FINDINGS Findings;       /* Result files only */
+} HVDIFF_INPUT;
+
+static double HvdiffNowMs(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+#endif
+}
+
+static void PrintJsonString(const char* s)
+{
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            printf("\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            printf("\\u%04x", (unsigned char)*s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+static void PrintEntry(void* context, const HV_DIFF_ENTRY* entry)
+{
+    HVDIFF_PAIR* pair = (HVDIFF_PAIR*)context;
+
+    if (pair->Options->Quiet) {
+        return;
+    }
+    if (pair->Options->JsonOutput) {
+        printf("{\"before\": ");
+        PrintJsonString(pair->Before);
+        printf(", \"after\": ");
+        PrintJsonString(pair->After);
+        printf(", \"kind\": \"%c\", \"section\": \"%s\", \"key\": ", (char)entry->Kind, entry->Section);
+        PrintJsonString(entry->Key);
+        printf(", \"old\": ");
+        PrintJsonString(entry->Old);
+        printf(", \"new\": ");
+        PrintJsonString(entry->New);
+        printf("}\n");
+        return;
+    }
+
+    if (!pair->Printed) {
+        printf("--- %s\n+++ %s\n", pair->Before, pair->After);
+        pair->Printed = 1;
+    }
+    printf("%c %-8s %s", (char)entry->Kind, entry->Section, entry->Key);
+    if (entry->Old[0] != '\0' && entry->New[0] != '\0') {
+        printf(": %s -> %s\n", entry->Old, entry->New);
+    } else if (entry->Old[0] != '\0' || entry->New[0] != '\0') {
+        printf(": %s\n", entry->Old[0] != '\0' ? entry->Old : entry->New);
+    } else {
+        printf("\n");
+    }
+}
+
+/*
+ * Findings of a hyperv_detector --json result (the first object in the file;
+ * text before it is skipped)
+ */
+static int LoadResultFile(const char* path, PHV_FINDINGS findings, char* msg, size_t msgSize)
+{
+    FILE* file = fopen(path, "rb");
+    FLEET_RECORD record;
+    const char* cursor;
+    char* data;
+    long size;
+    FLEET_SCAN_STATUS status;
+
+    if (file == NULL) {
+        snprintf(msg, msgSize, "Cannot open %s", path);
+        return -1;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        snprintf(msg, msgSize, "Cannot size %s", path);
+        fclose(file);
+        return -1;
+    }
+    data = (char*)malloc((size_t)size + 1);
+    if (data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) {
+        snprintf(msg, msgSize, "Cannot read %s", path);
+        free(data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    cursor = data;
+    do {
+        status = FleetScanRecord(&cursor, data + size, &record);
+    } while (status == FLEET_SCAN_MALFORMED);
+    free(data);
+    if (status != FLEET_SCAN_OK) {
+        snprintf(msg, msgSize, "No detector result in %s", path);
+        return -1;
+    }
+
+    memset(findings, 0, sizeof(*findings));
+    findings->Present = HV_FINDING_FLAGS | HV_FINDING_VBS | HV_FINDING_HVCI | HV_FINDING_BUILD;
+    if (record.Verdict[0] != '\0') {
+        findings->Present |= HV_FINDING_VERDICT;
+    }
+    findings->Flags = record.Flags;
+    findings->Vbs = record.Vbs;
+    findings->Hvci = record.Hvci;
+    snprintf(findings->Verdict, sizeof(findings->Verdict), "%s", record.Verdict);
+    snprintf(findings->Build, sizeof(findings->Build), "%s", record.Build);
+    return 0;
+}
+
+/* A directory is a snapshot, anything else a result file */
+static int LoadInput(const char* path, HVDIFF_INPUT* input, char* msg, size_t msgSize)
+{
+    char root[HVDIFF_PATH_LEN];
+    char name[FIXTURE_NAME_LEN];
+    struct stat info;
+    size_t length;
+    size_t start;
+
+    memset(input, 0, sizeof(*input));
+    if (stat(path, &info) != 0) {
+        snprintf(msg, msgSize, "Cannot open %s", path);
+        return -1;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        return LoadResultFile(path, &input->Findings, msg, msgSize);
+    }
+
+    /* LoadFixture takes the parent directory and the snapshot name apart */
+    snprintf(root, sizeof(root), "%s", path);
+    length = strlen(root);
+    while (length > 1 && (root[length - 1] == '/' || root[length - 1] == '\\')) {
+        root[--length] = '\0';
+    }
+    start = length;
+    while (start > 0 && root[start - 1] != '/' && root[start - 1] != '\\') {
+        start--;
+    }
+    if (length - start >= sizeof(name)) {
+        snprintf(msg, msgSize, "Snapshot name too long: %s", path);
+        return -1;
+    }
+    memcpy(name, root + start, length - start + 1);
+    if (start == 0) {
+        strcpy(root, ".");
+    } else {
+        /* Keep the separator when the parent is the filesystem root */
+        root[(start == 1) ? 1 : start - 1] = '\0';
+    }
+
+    input->IsSnapshot = 1;
+    return LoadFixture(root, name, &input->Snapshot, msg, msgSize);
+}
+
+static void FreeInput(HVDIFF_INPUT* input)
+{
+    if (input->IsSnapshot) {
+        FreeFixture(&input->Snapshot);
+    }
+}
+
+/* Number of differences, -1 on error */
+static int DiffPair(const HVDIFF_OPTIONS* options, const char* before, const char* after)
+{
+    HVDIFF_INPUT left;
+    HVDIFF_INPUT right;
+    HVDIFF_PAIR pair;
+    char msg[256];
+    int count = -1;
+
+    pair.Options = options;
+    pair.Before = before;
+    pair.After = after;
+    pair.Printed = 0;
+
+    if (LoadInput(before, &left, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "%s\n", msg);
+        return -1;
+    }
+    if (LoadInput(after, &right, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "%s\n", msg);
+        FreeInput(&left);
+        return -1;
+    }
+
+    if (left.IsSnapshot && right.IsSnapshot) {
+        count = SnapshotDiff(&left.Snapshot, &right.Snapshot, PrintEntry, &pair);
+    } else {
+        /* A snapshot against a result file: only the findings compare */
+        if (left.IsSnapshot) {
+            SnapshotFindings(&left.Snapshot, &left.Findings);
+        }
+        if (right.IsSnapshot) {
+            SnapshotFindings(&right.Snapshot, &right.Findings);
+        }
+        count = FindingsDiff(&left.Findings, &right.Findings, PrintEntry, &pair);
+    }
+    if (count < 0) {
+        fprintf(stderr, "Out of memory comparing %s and %s\n", before, after);
+    }
+
+    FreeInput(&left);
+    FreeInput(&right);
+    return count;
+}
+
+/* Splits "<before><tab or spaces><after>" in place; 0 on success */
+static int SplitPairLine(char* line, char** before, char** after)
+{
+    char* separator;
+    char* end;
+
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    end = line + strlen(line);
+    while (end > line && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+        *--end = '\0';
+    }
+    if (*line == '\0' || *line == '#') {
+        return 1;
+    }
+
+    separator = strchr(line, '\t');
+    if (separator == NULL) {
+        separator = strchr(line, ' ');
+    }
+    if (separator == NULL) {
+        return -1;
+    }
+    *separator++ = '\0';
+    while (*separator == ' ' || *separator == '\t') {
+        separator++;
+    }
+    if (*separator == '\0') {
+        return -1;
+    }
+    *before = line;
+    *after = separator;
+    return 0;
+}
+
+static int RunPairsFile(const HVDIFF_OPTIONS* options, const char* path)
+{
+    char line[2 * HVDIFF_PATH_LEN + 8];
+    char* before;
+    char* after;
+    FILE* file = fopen(path, "r");
+    unsigned int lineNumber = 0;
+    unsigned int pairs = 0;
+    unsigned int differing = 0;
+    unsigned int errors = 0;
+    double start = HvdiffNowMs();
+    double elapsed;
+    int status;
+    int count;
+
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 2;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        status = SplitPairLine(line, &before, &after);
+        if (status > 0) {
+            continue;
+        }
+        if (status < 0) {
+            fprintf(stderr, "%s:%u: expected \"<before> <after>\"\n", path, lineNumber);
+            errors++;
+            continue;
+        }
+
+        pairs++;
+        count = DiffPair(options, before, after);
+        if (count < 0) {
+            errors++;
+        } else if (count > 0) {
+            differing++;
+        }
+    }
+    fclose(file);
+
+    elapsed = HvdiffNowMs() - start;
+    fprintf(stderr, "%u pair(s), %u differing, %u error(s) in %.1f ms (%.0f pairs/s)\n",
+            pairs, differing, errors, elapsed, elapsed > 0 ? pairs * 1000.0 / elapsed : 0.0);
+    if (errors != 0) {
+        return 2;
+    }
+    return (differing != 0) ? 1 : 0;
+}
+
+static void PrintUsage(const char* program)
+{
+    printf("Usage: %s [options] <before> <after>\n", program);
+    printf("       %s [options] --pairs <file>\n\n", program);
+    printf("  <before>, <after>      Snapshot directories or hyperv_detector --json results\n");
+    printf("  --pairs <file>         \"<before> <after>\" per line\n");
+    printf("  --json                 One JSON object per difference\n");
+    printf("  --quiet                No output; exit code only\n");
+}
+
+int main(int argc, char* argv[])
+{
+    HVDIFF_OPTIONS options;
+    const char* paths[2] = { NULL, NULL };
+    const char* pairsFile = NULL;
+    int pathCount = 0;
+    int count;
+    int i;
+
+    memset(&options, 0, sizeof(options));
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            PrintUsage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            options.JsonOutput = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0 || strcmp(argv[i], "-q") == 0) {
+            options.Quiet = 1;
+        } else if (strcmp(argv[i], "--pairs") == 0 && i + 1 < argc) {
+            pairsFile = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 2;
+        } else if (pathCount < 2) {
+            paths[pathCount++] = argv[i];
+        } else {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (pairsFile != NULL && pathCount == 0) {
+        return RunPairsFile(&options, pairsFile);
+    }
+    if (pairsFile != NULL || pathCount != 2) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    count = DiffPair(&options, paths[0], paths[1]);
+    if (count < 0) {
+        return 2;
+    }
+    return (count != 0) ? 1 : 0;
+}
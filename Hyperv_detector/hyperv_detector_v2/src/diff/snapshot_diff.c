@@ -0,0 +1,635 @@
+/**
+ * snapshot_diff.c - Keyed diff of two detector snapshots (see snapshot_diff.h)
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "snapshot_diff.h"
+#include "../tests/replay.h"
+#include "../common/firmware_parse.h"
+#include "../common/detection_rules.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef struct _DIFF_STATE {
+    HV_DIFF_EMIT Emit;
+    void* Context;
+    int Count;
+    const HV_FIXTURE* Before;   /* NULL for a findings-only diff */
+    const HV_FIXTURE* After;
+} DIFF_STATE, *PDIFF_STATE;
+
+/* Called for every key: before or after is NULL for a key on one side only */
+typedef void (*DIFF_VISIT)(PDIFF_STATE state, const void* before, const void* after);
+
+/* qsort comparator over pointers to items */
+typedef int (*DIFF_COMPARE)(const void* a, const void* b);
+
+typedef struct _DIFF_ACPI_TABLE {
+    char Key[12];               /* Signature, "#n" for the n-th repeat */
+    const UINT8* Data;
+    UINT32 Length;
+    UINT64 Hash;
+} DIFF_ACPI_TABLE, *PDIFF_ACPI_TABLE;
+
+static void Emit(PDIFF_STATE state, HV_DIFF_KIND kind, const char* section,
+                 const char* oldValue, const char* newValue, const char* keyFormat, ...)
+{
+    HV_DIFF_ENTRY entry;
+    va_list args;
+
+    entry.Kind = kind;
+    entry.Section = section;
+    va_start(args, keyFormat);
+    vsnprintf(entry.Key, sizeof(entry.Key), keyFormat, args);
+    va_end(args);
+    snprintf(entry.Old, sizeof(entry.Old), "%s", oldValue ? oldValue : "");
+    snprintf(entry.New, sizeof(entry.New), "%s", newValue ? newValue : "");
+
+    state->Count++;
+    if (state->Emit != NULL) {
+        state->Emit(state->Context, &entry);
+    }
+}
+
+static int CompareNoCase(const char* a, const char* b)
+{
+    int ca;
+    int cb;
+
+    for (;; a++, b++) {
+        ca = (*a >= 'A' && *a <= 'Z') ? *a - 'A' + 'a' : (unsigned char)*a;
+        cb = (*b >= 'A' && *b <= 'Z') ? *b - 'A' + 'a' : (unsigned char)*b;
+        if (ca != cb || ca == 0) {
+            return ca - cb;
+        }
+    }
+}
+
+/*
+ * Sorts both sides by key and walks them together, calling visit once per
+ * key. -1 out of memory.
+ */
+static int DiffSection(PDIFF_STATE state, const void* before, UINT32 beforeCount, const void* after, UINT32 afterCount,
+                       size_t itemSize, DIFF_COMPARE compare, DIFF_VISIT visit)
+{
+    const void** list;
+    const void** left;
+    const void** right;
+    UINT32 i = 0;
+    UINT32 j = 0;
+    int order;
+
+    if (beforeCount + afterCount == 0) {
+        return 0;
+    }
+    list = (const void**)malloc(sizeof(void*) * ((size_t)beforeCount + afterCount));
+    if (list == NULL) {
+        return -1;
+    }
+    left = list;
+    right = list + beforeCount;
+    for (i = 0; i < beforeCount; i++) {
+        left[i] = (const UINT8*)before + i * itemSize;
+    }
+    for (j = 0; j < afterCount; j++) {
+        right[j] = (const UINT8*)after + j * itemSize;
+    }
+    qsort(left, beforeCount, sizeof(void*), compare);
+    qsort(right, afterCount, sizeof(void*), compare);
+
+    i = 0;
+    j = 0;
+    while (i < beforeCount || j < afterCount) {
+        if (j >= afterCount) {
+            order = -1;
+        } else if (i >= beforeCount) {
+            order = 1;
+        } else {
+            order = compare(&left[i], &right[j]);
+        }
+        if (order < 0) {
+            visit(state, left[i++], NULL);
+        } else if (order > 0) {
+            visit(state, NULL, right[j++]);
+        } else {
+            visit(state, left[i++], right[j++]);
+        }
+    }
+    free(list);
+    return 0;
+}
+
+/* ============================================================================
+ * CPUID
+ * ============================================================================ */
+
+static int CompareLeaves(const void* a, const void* b)
+{
+    const HV_CPUID_LEAF* left = *(const HV_CPUID_LEAF* const*)a;
+    const HV_CPUID_LEAF* right = *(const HV_CPUID_LEAF* const*)b;
+
+    if (left->Leaf != right->Leaf) {
+        return (left->Leaf < right->Leaf) ? -1 : 1;
+    }
+    return (left->Subleaf < right->Subleaf) ? -1 : (left->Subleaf > right->Subleaf);
+}
+
+static void FormatLeaf(const HV_CPUID_LEAF* leaf, char* text, size_t textSize)
+{
+    snprintf(text, textSize, "%08X %08X %08X %08X", leaf->Eax, leaf->Ebx, leaf->Ecx, leaf->Edx);
+}
+
+static void VisitLeaf(PDIFF_STATE state, const void* before, const void* after)
+{
+    static const char* const names[4] = { "eax", "ebx", "ecx", "edx" };
+    const HV_CPUID_LEAF* left = (const HV_CPUID_LEAF*)before;
+    const HV_CPUID_LEAF* right = (const HV_CPUID_LEAF*)after;
+    UINT32 oldRegs[4];
+    UINT32 newRegs[4];
+    char oldText[40];
+    char newText[40];
+    int i;
+
+    if (left == NULL) {
+        FormatLeaf(right, newText, sizeof(newText));
+        Emit(state, HV_DIFF_ADDED, "cpuid", NULL, newText, "0x%08X/%u", right->Leaf, right->Subleaf);
+        return;
+    }
+    if (right == NULL) {
+        FormatLeaf(left, oldText, sizeof(oldText));
+        Emit(state, HV_DIFF_REMOVED, "cpuid", oldText, NULL, "0x%08X/%u", left->Leaf, left->Subleaf);
+        return;
+    }
+
+    oldRegs[0] = left->Eax;  oldRegs[1] = left->Ebx;  oldRegs[2] = left->Ecx;  oldRegs[3] = left->Edx;
+    newRegs[0] = right->Eax; newRegs[1] = right->Ebx; newRegs[2] = right->Ecx; newRegs[3] = right->Edx;
+    for (i = 0; i < 4; i++) {
+        if (oldRegs[i] != newRegs[i]) {
+            snprintf(oldText, sizeof(oldText), "0x%08X", oldRegs[i]);
+            snprintf(newText, sizeof(newText), "0x%08X", newRegs[i]);
+            Emit(state, HV_DIFF_CHANGED, "cpuid", oldText, newText,
+                 "0x%08X/%u %s", left->Leaf, left->Subleaf, names[i]);
+        }
+    }
+}
+
+/* ============================================================================
+ * SMBIOS
+ * ============================================================================ */
+
+static void FormatUuid(const UINT8* uuid, char* text, size_t textSize)
+{
+    size_t length = 0;
+    int i;
+
+    text[0] = '\0';
+    for (i = 0; i < 16 && length + 3 < textSize; i++) {
+        length += (size_t)snprintf(text + length, textSize - length, "%02X", uuid[i]);
+    }
+}
+
+static void DiffSmbios(PDIFF_STATE state, const HV_FIXTURE* before, const HV_FIXTURE* after)
+{
+    static const struct {
+        const char* Name;
+        size_t Offset;
+    } fields[] = {
+        { "BiosVendor",            offsetof(HV_SMBIOS_INFO, BiosVendor) },
+        { "BiosVersion",           offsetof(HV_SMBIOS_INFO, BiosVersion) },
+        { "SystemManufacturer",    offsetof(HV_SMBIOS_INFO, SystemManufacturer) },
+        { "SystemProduct",         offsetof(HV_SMBIOS_INFO, SystemProduct) },
+        { "SystemVersion",         offsetof(HV_SMBIOS_INFO, SystemVersion) },
+        { "BaseboardManufacturer", offsetof(HV_SMBIOS_INFO, BaseboardManufacturer) },
+        { "BaseboardProduct",      offsetof(HV_SMBIOS_INFO, BaseboardProduct) },
+        { "OemMatch",              offsetof(HV_SMBIOS_INFO, OemMatch) }
+    };
+    HV_SMBIOS_INFO left;
+    HV_SMBIOS_INFO right;
+    const char* oldText;
+    const char* newText;
+    char oldBuffer[40];
+    char newBuffer[40];
+    int reported = state->Count;
+    size_t offset;
+    size_t i;
+
+    if (before->SmbiosSize == after->SmbiosSize &&
+        (before->SmbiosSize == 0 || memcmp(before->Smbios, after->Smbios, before->SmbiosSize) == 0)) {
+        return;
+    }
+
+    memset(&left, 0, sizeof(left));
+    memset(&right, 0, sizeof(right));
+    if (before->SmbiosSize != 0) {
+        HvSmbiosParseRaw(before->Smbios, before->SmbiosSize, &left);
+    }
+    if (after->SmbiosSize != 0) {
+        HvSmbiosParseRaw(after->Smbios, after->SmbiosSize, &right);
+    }
+
+    for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        oldText = (const char*)&left + fields[i].Offset;
+        newText = (const char*)&right + fields[i].Offset;
+        if (strcmp(oldText, newText) != 0) {
+            Emit(state, HV_DIFF_CHANGED, "smbios", oldText, newText, "%s", fields[i].Name);
+        }
+    }
+    if (left.MajorVersion != right.MajorVersion || left.MinorVersion != right.MinorVersion) {
+        snprintf(oldBuffer, sizeof(oldBuffer), "%u.%u", left.MajorVersion, left.MinorVersion);
+        snprintf(newBuffer, sizeof(newBuffer), "%u.%u", right.MajorVersion, right.MinorVersion);
+        Emit(state, HV_DIFF_CHANGED, "smbios", oldBuffer, newBuffer, "Version");
+    }
+    if (memcmp(left.SystemUuid, right.SystemUuid, sizeof(left.SystemUuid)) != 0) {
+        FormatUuid(left.SystemUuid, oldBuffer, sizeof(oldBuffer));
+        FormatUuid(right.SystemUuid, newBuffer, sizeof(newBuffer));
+        Emit(state, HV_DIFF_CHANGED, "smbios", oldBuffer, newBuffer, "SystemUuid");
+    }
+
+    /* Bytes differ in a field not decoded above */
+    if (state->Count == reported) {
+        for (offset = 0; offset < before->SmbiosSize && offset < after->SmbiosSize; offset++) {
+            if (before->Smbios[offset] != after->Smbios[offset]) {
+                break;
+            }
+        }
+        snprintf(oldBuffer, sizeof(oldBuffer), "%u bytes", (unsigned)before->SmbiosSize);
+        snprintf(newBuffer, sizeof(newBuffer), "%u bytes", (unsigned)after->SmbiosSize);
+        Emit(state, HV_DIFF_CHANGED, "smbios", oldBuffer, newBuffer, "raw @0x%X", (unsigned)offset);
+    }
+}
+
+/* ============================================================================
+ * ACPI
+ * ============================================================================ */
+
+/* 64-bit multiplicative hash, eight bytes per step */
+static UINT64 HashBytes(const UINT8* data, size_t size)
+{
+    UINT64 hash = 0xCBF29CE484222325ULL ^ size;
+    UINT64 word;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/* Tables of a blob keyed by signature and repeat count; *tables is allocated */
+static int CollectAcpiTables(const HV_FIXTURE* snapshot, PDIFF_ACPI_TABLE* tables, UINT32* count)
+{
+    HV_ACPI_TABLE_INFO info;
+    const UINT8* table;
+    PDIFF_ACPI_TABLE list = NULL;
+    PDIFF_ACPI_TABLE grown;
+    UINT32 capacity = 0;
+    UINT32 repeat;
+    UINT32 i;
+    size_t offset = 0;
+
+    *count = 0;
+    while (snapshot->AcpiSize != 0 && HvAcpiNextTable(snapshot->Acpi, snapshot->AcpiSize, &offset, &table, &info)) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            grown = (PDIFF_ACPI_TABLE)realloc(list, sizeof(DIFF_ACPI_TABLE) * capacity);
+            if (grown == NULL) {
+                free(list);
+                return -1;
+            }
+            list = grown;
+        }
+        for (repeat = 0, i = 0; i < *count; i++) {
+            repeat += (memcmp(list[i].Key, info.Signature4, 4) == 0);
+        }
+        if (repeat == 0) {
+            snprintf(list[*count].Key, sizeof(list[*count].Key), "%s", info.Signature4);
+        } else {
+            snprintf(list[*count].Key, sizeof(list[*count].Key), "%s#%u", info.Signature4, repeat + 1);
+        }
+        list[*count].Data = table;
+        list[*count].Length = info.Length;
+        list[*count].Hash = HashBytes(table, info.Length);
+        (*count)++;
+    }
+    *tables = list;
+    return 0;
+}
+
+static int CompareAcpiTables(const void* a, const void* b)
+{
+    return strcmp((*(const DIFF_ACPI_TABLE* const*)a)->Key, (*(const DIFF_ACPI_TABLE* const*)b)->Key);
+}
+
+static void VisitAcpiTable(PDIFF_STATE state, const void* before, const void* after)
+{
+    const DIFF_ACPI_TABLE* left = (const DIFF_ACPI_TABLE*)before;
+    const DIFF_ACPI_TABLE* right = (const DIFF_ACPI_TABLE*)after;
+    const DIFF_ACPI_TABLE* only;
+    HV_ACPI_TABLE_INFO oldInfo;
+    HV_ACPI_TABLE_INFO newInfo;
+    char oldText[64];
+    char newText[64];
+    int reported = state->Count;
+    UINT32 offset;
+
+    memset(&oldInfo, 0, sizeof(oldInfo));
+    memset(&newInfo, 0, sizeof(newInfo));
+    if (left == NULL || right == NULL) {
+        only = left ? left : right;
+        HvAcpiParseHeader(only->Data, only->Length, &oldInfo);
+        snprintf(oldText, sizeof(oldText), "%s %s rev %u, %u bytes",
+                 oldInfo.OemId, oldInfo.OemTableId, oldInfo.OemRevision, only->Length);
+        Emit(state, left ? HV_DIFF_REMOVED : HV_DIFF_ADDED, "acpi",
+             left ? oldText : NULL, left ? NULL : oldText, "%s", only->Key);
+        return;
+    }
+    if (left->Hash == right->Hash && left->Length == right->Length) {
+        return;
+    }
+
+    HvAcpiParseHeader(left->Data, left->Length, &oldInfo);
+    HvAcpiParseHeader(right->Data, right->Length, &newInfo);
+
+#define DIFF_ACPI_TEXT(field)                                                               \
+    if (strcmp(oldInfo.field, newInfo.field) != 0) {                                        \
+        Emit(state, HV_DIFF_CHANGED, "acpi", oldInfo.field, newInfo.field, "%s " #field, left->Key); \
+    }
+#define DIFF_ACPI_NUMBER(field, format)                                                     \
+    if (oldInfo.field != newInfo.field) {                                                   \
+        snprintf(oldText, sizeof(oldText), format, (unsigned)oldInfo.field);                \
+        snprintf(newText, sizeof(newText), format, (unsigned)newInfo.field);                \
+        Emit(state, HV_DIFF_CHANGED, "acpi", oldText, newText, "%s " #field, left->Key);    \
+    }
+
+    DIFF_ACPI_NUMBER(Revision, "%u");
+    DIFF_ACPI_TEXT(OemId);
+    DIFF_ACPI_TEXT(OemTableId);
+    DIFF_ACPI_NUMBER(OemRevision, "0x%08X");
+    DIFF_ACPI_TEXT(CreatorId);
+    DIFF_ACPI_NUMBER(CreatorRevision, "0x%08X");
+    DIFF_ACPI_NUMBER(Length, "%u");
+
+#undef DIFF_ACPI_TEXT
+#undef DIFF_ACPI_NUMBER
+
+    /* Same header, different contents: name the first differing byte */
+    if (state->Count == reported) {
+        for (offset = HV_ACPI_HEADER_SIZE; offset < left->Length; offset++) {
+            if (left->Data[offset] != right->Data[offset]) {
+                break;
+            }
+        }
+        snprintf(oldText, sizeof(oldText), "hash %016llX", (unsigned long long)left->Hash);
+        snprintf(newText, sizeof(newText), "hash %016llX", (unsigned long long)right->Hash);
+        Emit(state, HV_DIFF_CHANGED, "acpi", oldText, newText, "%s body @0x%X", left->Key, offset);
+    }
+}
+
+/* ============================================================================
+ * Registry, services, devices
+ * ============================================================================ */
+
+static int CompareRegValues(const void* a, const void* b)
+{
+    const HV_FIXTURE_REG_VALUE* left = *(const HV_FIXTURE_REG_VALUE* const*)a;
+    const HV_FIXTURE_REG_VALUE* right = *(const HV_FIXTURE_REG_VALUE* const*)b;
+    int order = CompareNoCase(left->Key, right->Key);
+
+    return (order != 0) ? order : CompareNoCase(left->Name, right->Name);
+}
+
+static void FormatRegValue(const HV_FIXTURE_REG_VALUE* value, char* text, size_t textSize)
+{
+    if (value->Name[0] == '\0') {
+        snprintf(text, textSize, "(key)");
+    } else if (value->IsDword) {
+        snprintf(text, textSize, "dword:0x%X", value->Dword);
+    } else {
+        snprintf(text, textSize, "%s", value->Data);
+    }
+}
+
+static void VisitRegValue(PDIFF_STATE state, const void* before, const void* after)
+{
+    const HV_FIXTURE_REG_VALUE* left = (const HV_FIXTURE_REG_VALUE*)before;
+    const HV_FIXTURE_REG_VALUE* right = (const HV_FIXTURE_REG_VALUE*)after;
+    const HV_FIXTURE_REG_VALUE* key = left ? left : right;
+    char oldText[HV_DIFF_VALUE_LEN] = "";
+    char newText[HV_DIFF_VALUE_LEN] = "";
+    HV_DIFF_KIND kind;
+
+    if (left != NULL) {
+        FormatRegValue(left, oldText, sizeof(oldText));
+    }
+    if (right != NULL) {
+        FormatRegValue(right, newText, sizeof(newText));
+    }
+    if (left == NULL) {
+        kind = HV_DIFF_ADDED;
+    } else if (right == NULL) {
+        kind = HV_DIFF_REMOVED;
+    } else if (strcmp(oldText, newText) != 0) {
+        kind = HV_DIFF_CHANGED;
+    } else {
+        return;
+    }
+
+    /* A value or subkey under a key means the key exists (FixtureRegKeyExists) */
+    if (key->Name[0] == '\0' &&
+        FixtureRegKeyExists((left == NULL) ? state->Before : state->After, key->Key)) {
+        return;
+    }
+
+    if (key->Name[0] == '\0') {
+        Emit(state, kind, "registry", oldText, newText, "%s", key->Key);
+    } else {
+        Emit(state, kind, "registry", oldText, newText, "%s : %s", key->Key, key->Name);
+    }
+}
+
+static int CompareServices(const void* a, const void* b)
+{
+    return CompareNoCase(*(const char* const*)a, *(const char* const*)b);
+}
+
+static void VisitService(PDIFF_STATE state, const void* before, const void* after)
+{
+    if (before == NULL) {
+        Emit(state, HV_DIFF_ADDED, "service", NULL, NULL, "%s", (const char*)after);
+    } else if (after == NULL) {
+        Emit(state, HV_DIFF_REMOVED, "service", NULL, NULL, "%s", (const char*)before);
+    }
+}
+
+static int CompareDevices(const void* a, const void* b)
+{
+    return CompareNoCase((*(const HV_FIXTURE_DEVICE* const*)a)->InstanceId,
+                         (*(const HV_FIXTURE_DEVICE* const*)b)->InstanceId);
+}
+
+static void VisitDevice(PDIFF_STATE state, const void* before, const void* after)
+{
+    const HV_FIXTURE_DEVICE* left = (const HV_FIXTURE_DEVICE*)before;
+    const HV_FIXTURE_DEVICE* right = (const HV_FIXTURE_DEVICE*)after;
+
+    if (left == NULL) {
+        Emit(state, HV_DIFF_ADDED, "device", NULL, right->Description, "%s", right->InstanceId);
+    } else if (right == NULL) {
+        Emit(state, HV_DIFF_REMOVED, "device", left->Description, NULL, "%s", left->InstanceId);
+    } else {
+        if (CompareNoCase(left->Service, right->Service) != 0) {
+            Emit(state, HV_DIFF_CHANGED, "device", left->Service, right->Service, "%s service", left->InstanceId);
+        }
+        if (strcmp(left->Description, right->Description) != 0) {
+            Emit(state, HV_DIFF_CHANGED, "device", left->Description, right->Description,
+                 "%s description", left->InstanceId);
+        }
+    }
+}
+
+/* ============================================================================
+ * Findings
+ * ============================================================================ */
+
+static void DiffFindings(PDIFF_STATE state, const HV_FINDINGS* before, const HV_FINDINGS* after)
+{
+    const char* const* flagNames = HvDetectionFlagNames();
+    UINT32 present = before->Present & after->Present;
+    UINT32 changed;
+    char oldText[16];
+    char newText[16];
+    int nameCount = 0;
+    int bit;
+
+    while (flagNames[nameCount] != NULL) {
+        nameCount++;
+    }
+
+    if ((present & HV_FINDING_VERDICT) && strcmp(before->Verdict, after->Verdict) != 0) {
+        Emit(state, HV_DIFF_CHANGED, "finding", before->Verdict, after->Verdict, "verdict");
+    }
+    if (present & HV_FINDING_FLAGS) {
+        changed = before->Flags ^ after->Flags;
+        for (bit = 0; bit < 32; bit++) {
+            if (!(changed & (1u << bit))) {
+                continue;
+            }
+            if (bit < nameCount) {
+                Emit(state, (after->Flags & (1u << bit)) ? HV_DIFF_ADDED : HV_DIFF_REMOVED, "finding",
+                     NULL, NULL, "flag %s", flagNames[bit]);
+            } else {
+                Emit(state, (after->Flags & (1u << bit)) ? HV_DIFF_ADDED : HV_DIFF_REMOVED, "finding",
+                     NULL, NULL, "flag 0x%08X", 1u << bit);
+            }
+        }
+    }
+    if ((present & HV_FINDING_GENERATION) && before->Generation != after->Generation) {
+        snprintf(oldText, sizeof(oldText), "%d", before->Generation);
+        snprintf(newText, sizeof(newText), "%d", after->Generation);
+        Emit(state, HV_DIFF_CHANGED, "finding", oldText, newText, "generation");
+    }
+    if ((present & HV_FINDING_VBS) && before->Vbs != after->Vbs) {
+        Emit(state, HV_DIFF_CHANGED, "finding", before->Vbs ? "on" : "off", after->Vbs ? "on" : "off", "vbs");
+    }
+    if ((present & HV_FINDING_HVCI) && before->Hvci != after->Hvci) {
+        Emit(state, HV_DIFF_CHANGED, "finding", before->Hvci ? "on" : "off", after->Hvci ? "on" : "off", "hvci");
+    }
+    if ((present & HV_FINDING_BUILD) && strcmp(before->Build, after->Build) != 0) {
+        Emit(state, HV_DIFF_CHANGED, "finding", before->Build, after->Build, "hv_build");
+    }
+}
+
+void SnapshotFindings(const HV_FIXTURE* snapshot, PHV_FINDINGS findings)
+{
+    HV_REPLAY_RESULT result;
+    const HV_FIXTURE_REG_VALUE* hvci;
+
+    ReplayFixture(snapshot, &result);
+
+    memset(findings, 0, sizeof(*findings));
+    findings->Present = HV_FINDING_VERDICT | HV_FINDING_FLAGS | HV_FINDING_GENERATION | HV_FINDING_VBS |
+                        HV_FINDING_HVCI | HV_FINDING_BUILD;
+    snprintf(findings->Verdict, sizeof(findings->Verdict), "%s", result.Verdict);
+    findings->Flags = result.Flags;
+    findings->Generation = result.Generation;
+    findings->Vbs = result.Vbs;
+
+    hvci = FixtureRegValue(snapshot, HV_REG_KEY_DEVICEGUARD, HV_REG_VALUE_HVCI);
+    findings->Hvci = (hvci != NULL && hvci->IsDword && hvci->Dword != 0);
+
+    /* Same format as hyperv_detector --json; "" outside Hyper-V */
+    if (result.Cpuid.IsMicrosoftHv) {
+        snprintf(findings->Build, sizeof(findings->Build), "%u.%u.%u",
+                 result.Cpuid.MajorVersion, result.Cpuid.MinorVersion, result.Cpuid.BuildNumber);
+    }
+}
+
+int FindingsDiff(const HV_FINDINGS* before, const HV_FINDINGS* after, HV_DIFF_EMIT emit, void* context)
+{
+    DIFF_STATE state;
+
+    state.Emit = emit;
+    state.Context = context;
+    state.Count = 0;
+    state.Before = NULL;
+    state.After = NULL;
+    DiffFindings(&state, before, after);
+    return state.Count;
+}
+
+int SnapshotDiff(const HV_FIXTURE* before, const HV_FIXTURE* after, HV_DIFF_EMIT emit, void* context)
+{
+    DIFF_STATE state;
+    HV_FINDINGS oldFindings;
+    HV_FINDINGS newFindings;
+    PDIFF_ACPI_TABLE oldTables = NULL;
+    PDIFF_ACPI_TABLE newTables = NULL;
+    UINT32 oldTableCount = 0;
+    UINT32 newTableCount = 0;
+    int status = -1;
+
+    state.Emit = emit;
+    state.Context = context;
+    state.Count = 0;
+    state.Before = before;
+    state.After = after;
+
+    if (DiffSection(&state, before->Cpuid, before->CpuidCount, after->Cpuid, after->CpuidCount,
+                    sizeof(HV_CPUID_LEAF), CompareLeaves, VisitLeaf) != 0) {
+        goto done;
+    }
+
+    DiffSmbios(&state, before, after);
+
+    if (CollectAcpiTables(before, &oldTables, &oldTableCount) != 0 ||
+        CollectAcpiTables(after, &newTables, &newTableCount) != 0 ||
+        DiffSection(&state, oldTables, oldTableCount, newTables, newTableCount,
+                    sizeof(DIFF_ACPI_TABLE), CompareAcpiTables, VisitAcpiTable) != 0) {
+        goto done;
+    }
+
+    if (DiffSection(&state, before->Registry, before->RegistryCount, after->Registry, after->RegistryCount,
+                    sizeof(HV_FIXTURE_REG_VALUE), CompareRegValues, VisitRegValue) != 0 ||
+        DiffSection(&state, before->Services, before->ServiceCount, after->Services, after->ServiceCount,
+                    FIXTURE_NAME_LEN, CompareServices, VisitService) != 0 ||
+        DiffSection(&state, before->Devices, before->DeviceCount, after->Devices, after->DeviceCount,
+                    sizeof(HV_FIXTURE_DEVICE), CompareDevices, VisitDevice) != 0) {
+        goto done;
+    }
+
+    SnapshotFindings(before, &oldFindings);
+    SnapshotFindings(after, &newFindings);
+    DiffFindings(&state, &oldFindings, &newFindings);
+    status = state.Count;
+
+done:
+    free(oldTables);
+    free(newTables);
+    return status;
+}
@@ -0,0 +1,73 @@
+/**
+ * snapshot_diff.h - Keyed diff of two detector snapshots
+ *
+ * Compares two captured snapshots (fixture.h) section by section and reports
+ * one entry per key that was added, removed or changed:
+ *
+ *   cpuid      "<leaf>/<subleaf> <register>"
+ *   smbios     Decoded field, e.g. "SystemProduct"; raw bytes compared first
+ *   acpi       "<signature>[#n]" or "<signature>[#n] <header field>"; tables
+ *              are hashed and only decoded when the hashes differ
+ *   registry   "<key>" or "<key> : <value name>", case-insensitive
+ *   service    Service name, case-insensitive
+ *   device     Instance ID; service and description compared
+ *   finding    verdict, flags (one entry per flag), generation, vbs, hvci
+ *
+ * Each side is sorted once and the two are merged, so a diff costs
+ * O(n log n) in the number of entries and allocates one index array per
+ * section. Entries go to a callback in section order.
+ */
+
+#pragma once
+#ifndef SNAPSHOT_DIFF_H
+#define SNAPSHOT_DIFF_H
+
+#include "../tests/fixture.h"
+
+#define HV_DIFF_KEY_LEN     320
+#define HV_DIFF_VALUE_LEN   FIXTURE_TEXT_LEN
+
+typedef enum _HV_DIFF_KIND {
+    HV_DIFF_ADDED = '+',
+    HV_DIFF_REMOVED = '-',
+    HV_DIFF_CHANGED = '~'
+} HV_DIFF_KIND;
+
+typedef struct _HV_DIFF_ENTRY {
+    HV_DIFF_KIND Kind;
+    const char* Section;
+    char Key[HV_DIFF_KEY_LEN];
+    char Old[HV_DIFF_VALUE_LEN];    /* "" for HV_DIFF_ADDED */
+    char New[HV_DIFF_VALUE_LEN];    /* "" for HV_DIFF_REMOVED */
+} HV_DIFF_ENTRY, *PHV_DIFF_ENTRY;
+
+typedef void (*HV_DIFF_EMIT)(void* context, const HV_DIFF_ENTRY* entry);
+
+/* What the detector concluded; fields outside Present are not compared */
+#define HV_FINDING_VERDICT      0x01
+#define HV_FINDING_FLAGS        0x02
+#define HV_FINDING_GENERATION   0x04
+#define HV_FINDING_VBS          0x08
+#define HV_FINDING_HVCI         0x10
+#define HV_FINDING_BUILD        0x20
+
+typedef struct _HV_FINDINGS {
+    UINT32 Present;             /* HV_FINDING_* */
+    char Verdict[FIXTURE_NAME_LEN];
+    UINT32 Flags;
+    int Generation;
+    int Vbs;
+    int Hvci;
+    char Build[FIXTURE_NAME_LEN];
+} HV_FINDINGS, *PHV_FINDINGS;
+
+/* Findings of a snapshot: its inputs replayed through the detection rules */
+void SnapshotFindings(const HV_FIXTURE* snapshot, PHV_FINDINGS findings);
+
+/* Number of differences, or -1 out of memory */
+int SnapshotDiff(const HV_FIXTURE* before, const HV_FIXTURE* after, HV_DIFF_EMIT emit, void* context);
+
+/* Findings only, e.g. for two hyperv_detector --json results */
+int FindingsDiff(const HV_FINDINGS* before, const HV_FINDINGS* after, HV_DIFF_EMIT emit, void* context);
+
+#endif /* SNAPSHOT_DIFF_H */
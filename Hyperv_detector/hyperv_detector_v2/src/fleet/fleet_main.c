@@ -0,0 +1,591 @@
+/**
+ * fleet_main.c - hyperv_fleet: query detector results from many hosts
+ *
+ * Loads every result file given on the command line (hyperv_detector --json
+ * output, NDJSON or a JSON array), one worker thread per chunk of input, and
+ * answers one query over the combined columnar store (fleet_store.h):
+ *
+ *   hyperv_fleet --where vbs,!hvci --group-by build host1.json host2.json ...
+ *   hyperv_fleet --where verdict=HyperV-GuestVM --histogram checks results.ndjson
+ *
+ * Files are memory-mapped; large files are split at lines that start a new
+ * object ("\n{"), so NDJSON and concatenated detector output spread over all
+ * workers. Ingest and query times go to stderr. Builds on Linux with:
+ *
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=200809L -O2 -Wall -pthread -o hyperv_fleet \
+ *       src/fleet/fleet_main.c src/fleet/fleet_store.c
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "fleet_store.h"
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define FLEET_MAX_THREADS       64
+#define FLEET_MIN_CHUNK         (1024 * 1024)
+
+typedef struct _FLEET_INPUT {
+    const char* Path;
+    const char* Data;
+    size_t Size;
+#ifdef _WIN32
+    HANDLE File;
+    HANDLE Mapping;
+#endif
+} FLEET_INPUT, *PFLEET_INPUT;
+
+typedef struct _FLEET_CHUNK {
+    const char* Data;
+    size_t Size;
+} FLEET_CHUNK, *PFLEET_CHUNK;
+
+typedef struct _FLEET_WORKER {
+    FLEET_STORE Store;
+    const FLEET_CHUNK* Chunks;
+    int ChunkCount;
+    int First;                  /* Chunks First, First + Stride, ... */
+    int Stride;
+    int Failed;
+} FLEET_WORKER, *PFLEET_WORKER;
+
+typedef struct _FLEET_GROUP_ROW {
+    UINT32 Id;
+    UINT32 Count;
+} FLEET_GROUP_ROW;
+
+static double FleetNowMs(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+#endif
+}
+
+static int CpuCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+/* ============================================================================
+ * Input mapping
+ * ============================================================================ */
+
+/* 0 on success; an empty file maps to Data == NULL, Size == 0 */
+static int MapInput(PFLEET_INPUT input)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    input->File = CreateFileA(input->Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (input->File == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    if (!GetFileSizeEx(input->File, &size)) {
+        CloseHandle(input->File);
+        input->File = NULL;
+        return -1;
+    }
+    input->Size = (size_t)size.QuadPart;
+    if (input->Size == 0) {
+        return 0;
+    }
+    input->Mapping = CreateFileMappingA(input->File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (input->Mapping != NULL) {
+        input->Data = (const char*)MapViewOfFile(input->Mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (input->Data == NULL) {
+        if (input->Mapping != NULL) {
+            CloseHandle(input->Mapping);
+        }
+        CloseHandle(input->File);
+        input->File = NULL;
+        return -1;
+    }
+    return 0;
+#else
+    struct stat info;
+    void* data;
+    int fd = open(input->Path, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    input->Size = (size_t)info.st_size;
+    if (input->Size == 0) {
+        close(fd);
+        return 0;
+    }
+    data = mmap(NULL, input->Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    input->Data = (const char*)data;
+    return 0;
+#endif
+}
+
+static void UnmapInput(PFLEET_INPUT input)
+{
+#ifdef _WIN32
+    if (input->Data != NULL) {
+        UnmapViewOfFile(input->Data);
+        CloseHandle(input->Mapping);
+    }
+    if (input->File != NULL && input->File != INVALID_HANDLE_VALUE) {
+        CloseHandle(input->File);
+    }
+#else
+    if (input->Data != NULL) {
+        munmap((void*)input->Data, input->Size);
+    }
+#endif
+    input->Data = NULL;
+}
+
+/*
+ * Cuts every input into chunks of about target bytes, each ending just before
+ * a line that starts with '{'. *chunks is allocated; returns the chunk count
+ * or -1 out of memory.
+ */
+static int SplitChunks(const FLEET_INPUT* inputs, int inputCount, size_t target, PFLEET_CHUNK* chunks)
+{
+    PFLEET_CHUNK list = NULL;
+    PFLEET_CHUNK grown;
+    int count = 0;
+    int capacity = 0;
+    const char* start;
+    const char* end;
+    const char* cut;
+    int i;
+
+    for (i = 0; i < inputCount; i++) {
+        start = inputs[i].Data;
+        end = start + inputs[i].Size;
+        while (start < end) {
+            cut = ((size_t)(end - start) > target) ? start + target : end;
+            while (cut < end && !(cut[-1] == '\n' && cut[0] == '{')) {
+                cut++;
+            }
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                grown = (PFLEET_CHUNK)realloc(list, sizeof(FLEET_CHUNK) * (size_t)capacity);
+                if (grown == NULL) {
+                    free(list);
+                    return -1;
+                }
+                list = grown;
+            }
+            list[count].Data = start;
+            list[count].Size = (size_t)(cut - start);
+            count++;
+            start = cut;
+        }
+    }
+    *chunks = list;
+    return count;
+}
+
+/* ============================================================================
+ * Workers
+ * ============================================================================ */
+
+static void RunWorker(PFLEET_WORKER worker)
+{
+    int i;
+
+    for (i = worker->First; i < worker->ChunkCount; i += worker->Stride) {
+        if (FleetStoreIngest(&worker->Store, worker->Chunks[i].Data, worker->Chunks[i].Size) != 0) {
+            worker->Failed = 1;
+            return;
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI WorkerThread(LPVOID param)
+{
+    RunWorker((PFLEET_WORKER)param);
+    return 0;
+}
+#else
+static void* WorkerThread(void* param)
+{
+    RunWorker((PFLEET_WORKER)param);
+    return NULL;
+}
+#endif
+
+/* Ingests all chunks into store with up to threadCount threads; -1 out of memory */
+static int IngestParallel(PFLEET_STORE store, const FLEET_CHUNK* chunks, int chunkCount, int threadCount)
+{
+    FLEET_WORKER* workers;
+#ifdef _WIN32
+    HANDLE threads[FLEET_MAX_THREADS];
+#else
+    pthread_t threads[FLEET_MAX_THREADS];
+#endif
+    int started[FLEET_MAX_THREADS] = {0};
+    int status = 0;
+    int i;
+
+    if (threadCount > chunkCount) {
+        threadCount = chunkCount;
+    }
+    if (threadCount <= 1) {
+        for (i = 0; i < chunkCount; i++) {
+            if (FleetStoreIngest(store, chunks[i].Data, chunks[i].Size) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    workers = (FLEET_WORKER*)calloc((size_t)threadCount, sizeof(FLEET_WORKER));
+    if (workers == NULL) {
+        return -1;
+    }
+    for (i = 0; i < threadCount; i++) {
+        FleetStoreInit(&workers[i].Store);
+        workers[i].Chunks = chunks;
+        workers[i].ChunkCount = chunkCount;
+        workers[i].First = i;
+        workers[i].Stride = threadCount;
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, WorkerThread, &workers[i], 0, NULL);
+        started[i] = (threads[i] != NULL);
+#else
+        started[i] = (pthread_create(&threads[i], NULL, WorkerThread, &workers[i]) == 0);
+#endif
+        if (!started[i]) {
+            RunWorker(&workers[i]);
+        }
+    }
+
+    /* Merge in worker order so the result does not depend on scheduling */
+    for (i = 0; i < threadCount; i++) {
+        if (started[i]) {
+#ifdef _WIN32
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+#else
+            pthread_join(threads[i], NULL);
+#endif
+        }
+        if (status == 0 && (workers[i].Failed || FleetStoreMerge(store, &workers[i].Store) != 0)) {
+            status = -1;
+        }
+        FleetStoreFree(&workers[i].Store);
+    }
+    free(workers);
+    return status;
+}
+
+/* ============================================================================
+ * Output
+ * ============================================================================ */
+
+static void PrintJsonString(const char* s)
+{
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            printf("\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            printf("\\u%04x", (unsigned char)*s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+static int CompareGroupRows(const void* a, const void* b)
+{
+    const FLEET_GROUP_ROW* left = (const FLEET_GROUP_ROW*)a;
+    const FLEET_GROUP_ROW* right = (const FLEET_GROUP_ROW*)b;
+
+    if (left->Count != right->Count) {
+        return (left->Count > right->Count) ? -1 : 1;
+    }
+    return (left->Id < right->Id) ? -1 : (left->Id > right->Id);
+}
+
+/* Non-empty groups, largest first; returns the row count or -1 out of memory */
+static int CollectGroups(const FLEET_STORE* store, const UINT64* mask, FLEET_GROUP group, FLEET_GROUP_ROW** rows)
+{
+    UINT32 size = FleetGroupSize(store, group);
+    UINT32* counts = (UINT32*)calloc(size, sizeof(UINT32));
+    FLEET_GROUP_ROW* list = (FLEET_GROUP_ROW*)malloc(sizeof(FLEET_GROUP_ROW) * size);
+    int count = 0;
+    UINT32 id;
+
+    if (counts == NULL || list == NULL) {
+        free(counts);
+        free(list);
+        return -1;
+    }
+    FleetGroupCount(store, mask, group, counts);
+    for (id = 0; id < size; id++) {
+        if (counts[id] != 0) {
+            list[count].Id = id;
+            list[count].Count = counts[id];
+            count++;
+        }
+    }
+    free(counts);
+    qsort(list, (size_t)count, sizeof(FLEET_GROUP_ROW), CompareGroupRows);
+    *rows = list;
+    return count;
+}
+
+static void PrintUsage(const char* program)
+{
+    int column;
+
+    printf("Usage: %s [options] <result files...>\n\n", program);
+    printf("  --threads <n>          Worker threads (default: one per CPU)\n");
+    printf("  --where <terms>        Comma-separated filter: <column>, !<column>,\n");
+    printf("                         verdict=<verdict>, build=<major.minor.build>\n");
+    printf("  --group-by <field>     Count matching hosts per build or verdict\n");
+    printf("  --histogram checks     Count matching hosts per column\n");
+    printf("  --json                 Print the answer as JSON\n\n");
+    printf("Columns:");
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        printf(" %s", FleetColumnName(column));
+    }
+    printf("\n");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char* argv[])
+{
+    FLEET_STORE store;
+    FLEET_FILTER filter;
+    PFLEET_INPUT inputs;
+    PFLEET_CHUNK chunks = NULL;
+    FLEET_GROUP_ROW* groups = NULL;
+    UINT64* mask = NULL;
+    UINT32 columnCounts[FLEET_COLUMN_COUNT];
+    const char* where = "";
+    const char* groupName = NULL;
+    FLEET_GROUP group = FLEET_GROUP_BUILD;
+    int histogram = 0;
+    int jsonOutput = 0;
+    int threadCount = CpuCount();
+    int inputCount = 0;
+    int chunkCount;
+    int groupCount = 0;
+    size_t totalSize = 0;
+    size_t target;
+    UINT32 matched;
+    double start;
+    double ingestMs;
+    double queryMs;
+    char msg[256];
+    int exitCode = 0;
+    int i;
+
+    inputs = (PFLEET_INPUT)calloc((size_t)argc, sizeof(FLEET_INPUT));
+    if (inputs == NULL) {
+        return 2;
+    }
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            PrintUsage(argv[0]);
+            free(inputs);
+            return 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+            where = argv[++i];
+        } else if (strcmp(argv[i], "--group-by") == 0 && i + 1 < argc) {
+            groupName = argv[++i];
+        } else if (strcmp(argv[i], "--histogram") == 0 && i + 1 < argc) {
+            if (strcmp(argv[++i], "checks") != 0) {
+                fprintf(stderr, "Unknown histogram: %s\n", argv[i]);
+                free(inputs);
+                return 2;
+            }
+            histogram = 1;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            jsonOutput = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            free(inputs);
+            return 2;
+        } else {
+            inputs[inputCount++].Path = argv[i];
+        }
+    }
+    if (groupName != NULL) {
+        if (strcmp(groupName, "build") == 0) {
+            group = FLEET_GROUP_BUILD;
+        } else if (strcmp(groupName, "verdict") == 0) {
+            group = FLEET_GROUP_VERDICT;
+        } else {
+            fprintf(stderr, "Unknown group-by field: %s (build, verdict)\n", groupName);
+            free(inputs);
+            return 2;
+        }
+    }
+    if (inputCount == 0) {
+        PrintUsage(argv[0]);
+        free(inputs);
+        return 2;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > FLEET_MAX_THREADS) {
+        threadCount = FLEET_MAX_THREADS;
+    }
+
+    FleetStoreInit(&store);
+    start = FleetNowMs();
+
+    for (i = 0; i < inputCount; i++) {
+        if (MapInput(&inputs[i]) != 0) {
+            fprintf(stderr, "Cannot read %s\n", inputs[i].Path);
+            exitCode = 2;
+            goto cleanup;
+        }
+        totalSize += inputs[i].Size;
+    }
+
+    /* A few chunks per thread evens out files of different sizes */
+    target = totalSize / ((size_t)threadCount * 4);
+    if (target < FLEET_MIN_CHUNK) {
+        target = FLEET_MIN_CHUNK;
+    }
+    chunkCount = SplitChunks(inputs, inputCount, target, &chunks);
+    if (chunkCount < 0 || IngestParallel(&store, chunks, chunkCount, threadCount) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        exitCode = 2;
+        goto cleanup;
+    }
+    ingestMs = FleetNowMs() - start;
+
+    if (FleetFilterParse(&store, where, &filter, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "%s\n", msg);
+        exitCode = 2;
+        goto cleanup;
+    }
+
+    start = FleetNowMs();
+    mask = (UINT64*)calloc(FLEET_MASK_WORDS(&store) + 1, sizeof(UINT64));
+    if (mask == NULL) {
+        exitCode = 2;
+        goto cleanup;
+    }
+    matched = FleetSelect(&store, &filter, mask);
+    if (groupName != NULL) {
+        groupCount = CollectGroups(&store, mask, group, &groups);
+        if (groupCount < 0) {
+            exitCode = 2;
+            goto cleanup;
+        }
+    }
+    if (histogram) {
+        FleetColumnCounts(&store, mask, columnCounts);
+    }
+    queryMs = FleetNowMs() - start;
+
+    fprintf(stderr, "Ingested %u rows from %d file(s), %.1f MB in %.1f ms (%d threads, %d chunks); query %.3f ms\n",
+            store.RowCount, inputCount, (double)totalSize / (1024.0 * 1024.0), ingestMs,
+            (threadCount < chunkCount) ? threadCount : chunkCount, chunkCount, queryMs);
+    if (store.Malformed != 0) {
+        fprintf(stderr, "Skipped %u malformed record(s)\n", store.Malformed);
+    }
+    if (store.Overflow != 0) {
+        fprintf(stderr, "%u row(s) exceeded the build or verdict dictionary\n", store.Overflow);
+    }
+
+    if (jsonOutput) {
+        printf("{\"rows\": %u, \"malformed\": %u, \"matched\": %u", store.RowCount, store.Malformed, matched);
+        if (groupName != NULL) {
+            printf(", \"group_by\": \"%s\", \"groups\": [", groupName);
+            for (i = 0; i < groupCount; i++) {
+                printf("%s{\"value\": ", i ? ", " : "");
+                if (groups[i].Id == 0) {
+                    printf("null");
+                } else {
+                    PrintJsonString(FleetGroupValue(&store, group, groups[i].Id));
+                }
+                printf(", \"count\": %u}", groups[i].Count);
+            }
+            printf("]");
+        }
+        if (histogram) {
+            printf(", \"columns\": {");
+            for (i = 0; i < FLEET_COLUMN_COUNT; i++) {
+                printf("%s\"%s\": %u", i ? ", " : "", FleetColumnName(i), columnCounts[i]);
+            }
+            printf("}");
+        }
+        printf("}\n");
+    } else {
+        printf("Hosts: %u, matching: %u\n", store.RowCount, matched);
+        if (groupName != NULL) {
+            printf("\n%-32s %10s %8s\n", groupName, "hosts", "share");
+            for (i = 0; i < groupCount; i++) {
+                printf("%-32s %10u %7.1f%%\n",
+                       groups[i].Id ? FleetGroupValue(&store, group, groups[i].Id) : "(none)",
+                       groups[i].Count, 100.0 * groups[i].Count / (matched ? matched : 1));
+            }
+        }
+        if (histogram) {
+            printf("\n%-32s %10s %8s\n", "column", "hosts", "share");
+            for (i = 0; i < FLEET_COLUMN_COUNT; i++) {
+                printf("%-32s %10u %7.1f%%\n", FleetColumnName(i), columnCounts[i],
+                       100.0 * columnCounts[i] / (matched ? matched : 1));
+            }
+        }
+    }
+
+cleanup:
+    free(groups);
+    free(mask);
+    free(chunks);
+    for (i = 0; i < inputCount; i++) {
+        UnmapInput(&inputs[i]);
+    }
+    free(inputs);
+    FleetStoreFree(&store);
+    return exitCode;
+}
@@ -0,0 +1,889 @@
+/**
+ * fleet_store.c - Result scanner, columnar store and queries (see fleet_store.h)
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "fleet_store.h"
+#include <stdlib.h>
+
+#define FLEET_INITIAL_ROWS      1024
+#define FLEET_KEY_LEN           16
+
+#define FLEET_ONES              0x0101010101010101ULL
+#define FLEET_HIGHS             0x8080808080808080ULL
+
+/* Nonzero if any byte of v is zero */
+#define FLEET_HAS_ZERO(v)       (((v) - FLEET_ONES) & ~(v) & FLEET_HIGHS)
+#define FLEET_HAS_BYTE(v, b)    FLEET_HAS_ZERO((v) ^ (FLEET_ONES * (UINT8)(b)))
+
+/* Names of the columns after the flag columns */
+static const char* const g_fleetExtraColumns[FLEET_COLUMN_COUNT - FLEET_FLAG_COLUMNS] = {
+    "detected", "vbs", "hvci"
+};
+
+static int FleetPopcount64(UINT64 v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * FLEET_ONES) >> 56);
+#endif
+}
+
+/* Index of the lowest set bit; v != 0 */
+static int FleetLowestBit(UINT64 v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#else
+    return FleetPopcount64((v & (0 - v)) - 1);
+#endif
+}
+
+/* ============================================================================
+ * Scanner
+ * ============================================================================ */
+
+static const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * p is just past the opening quote. Returns the position after the closing
+ * quote, or NULL if the string is unterminated or holds a raw line break.
+ */
+static const char* SkipString(const char* p, const char* end)
+{
+    UINT64 word;
+
+    for (;;) {
+        while (end - p >= 8) {
+            memcpy(&word, p, sizeof(word));
+            if (FLEET_HAS_BYTE(word, '"') | FLEET_HAS_BYTE(word, '\\') | FLEET_HAS_BYTE(word, '\n')) {
+                break;
+            }
+            p += 8;
+        }
+        if (p >= end || *p == '\n') {
+            return NULL;
+        }
+        if (*p == '"') {
+            return p + 1;
+        }
+        if (*p == '\\') {
+            if (end - p < 2) {
+                return NULL;
+            }
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+}
+
+static int HexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Copies the string at p (just past the opening quote) into out, unescaped
+ * and truncated to outSize - 1 bytes. \u escapes outside ASCII become '?'.
+ */
+static const char* ScanString(const char* p, const char* end, char* out, size_t outSize)
+{
+    size_t length = 0;
+    char c;
+    int code;
+    int i;
+    int digit;
+
+    while (p < end && *p != '"') {
+        c = *p++;
+        if (c == '\n') {
+            return NULL;
+        }
+        if (c == '\\') {
+            if (p >= end) {
+                return NULL;
+            }
+            c = *p++;
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u':
+                if (end - p < 4) {
+                    return NULL;
+                }
+                code = 0;
+                for (i = 0; i < 4; i++) {
+                    digit = HexDigit(p[i]);
+                    if (digit < 0) {
+                        return NULL;
+                    }
+                    code = (code << 4) | digit;
+                }
+                p += 4;
+                c = (code < 0x80) ? (char)code : '?';
+                break;
+            case '"': case '\\': case '/':
+                break;
+            default:
+                return NULL;
+            }
+        }
+        if (length + 1 < outSize) {
+            out[length++] = c;
+        }
+    }
+    if (p >= end) {
+        return NULL;
+    }
+    out[length] = '\0';
+    return p + 1;
+}
+
+/* Scalar (number, true, false, null): returns its end, NULL if empty */
+static const char* SkipScalar(const char* p, const char* end)
+{
+    const char* start = p;
+
+    while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+           *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        p++;
+    }
+    return (p > start) ? p : NULL;
+}
+
+static const char* SkipValue(const char* p, const char* end)
+{
+    int depth = 0;
+
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        return SkipString(p + 1, end);
+    }
+    if (*p != '{' && *p != '[') {
+        return SkipScalar(p, end);
+    }
+    while (p < end) {
+        switch (*p) {
+        case '"':
+            p = SkipString(p + 1, end);
+            if (p == NULL) {
+                return NULL;
+            }
+            continue;
+        case '{': case '[':
+            depth++;
+            break;
+        case '}': case ']':
+            if (--depth == 0) {
+                return p + 1;
+            }
+            break;
+        default:
+            break;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static int ScalarIs(const char* p, const char* scalarEnd, const char* literal)
+{
+    size_t length = strlen(literal);
+
+    return (size_t)(scalarEnd - p) == length && memcmp(p, literal, length) == 0;
+}
+
+/* true / false / null / number; null and 0 read as false */
+static const char* ScanBool(const char* p, const char* end, int* value)
+{
+    const char* scalarEnd = SkipScalar(p, end);
+
+    if (scalarEnd == NULL) {
+        return NULL;
+    }
+    if (ScalarIs(p, scalarEnd, "true")) {
+        *value = 1;
+    } else if (ScalarIs(p, scalarEnd, "false") || ScalarIs(p, scalarEnd, "null")) {
+        *value = 0;
+    } else if (*p >= '0' && *p <= '9') {
+        *value = !ScalarIs(p, scalarEnd, "0");
+    } else {
+        return NULL;
+    }
+    return scalarEnd;
+}
+
+/* "0x0000003B" or a plain number */
+static const char* ScanFlags(const char* p, const char* end, UINT32* flags)
+{
+    char text[FLEET_KEY_LEN + 4];
+    char* parsedEnd;
+    const char* next;
+    size_t length;
+
+    if (p < end && *p == '"') {
+        next = ScanString(p + 1, end, text, sizeof(text));
+    } else {
+        next = SkipScalar(p, end);
+        if (next != NULL) {
+            length = (size_t)(next - p);
+            if (length >= sizeof(text)) {
+                return NULL;
+            }
+            memcpy(text, p, length);
+            text[length] = '\0';
+        }
+    }
+    if (next == NULL || text[0] == '\0') {
+        return NULL;
+    }
+    *flags = (UINT32)strtoul(text, &parsedEnd, 0);
+    return (*parsedEnd == '\0') ? next : NULL;
+}
+
+/* String or null */
+static const char* ScanText(const char* p, const char* end, char* out, size_t outSize)
+{
+    const char* scalarEnd;
+
+    if (p < end && *p == '"') {
+        return ScanString(p + 1, end, out, outSize);
+    }
+    scalarEnd = SkipScalar(p, end);
+    if (scalarEnd == NULL || !ScalarIs(p, scalarEnd, "null")) {
+        return NULL;
+    }
+    out[0] = '\0';
+    return scalarEnd;
+}
+
+/* p is at '{'; returns the position after the closing brace or NULL */
+static const char* ScanObject(const char* p, const char* end, PFLEET_RECORD record)
+{
+    char key[FLEET_KEY_LEN];
+    int detected = -1;
+
+    memset(record, 0, sizeof(*record));
+
+    p = SkipSpace(p + 1, end);
+    if (p < end && *p == '}') {
+        return p + 1;
+    }
+    for (;;) {
+        if (p >= end || *p != '"') {
+            return NULL;
+        }
+        p = ScanString(p + 1, end, key, sizeof(key));
+        if (p == NULL) {
+            return NULL;
+        }
+        p = SkipSpace(p, end);
+        if (p >= end || *p != ':') {
+            return NULL;
+        }
+        p = SkipSpace(p + 1, end);
+
+        if (strcmp(key, "flags") == 0) {
+            p = ScanFlags(p, end, &record->Flags);
+        } else if (strcmp(key, "detected") == 0) {
+            p = ScanBool(p, end, &detected);
+        } else if (strcmp(key, "vbs") == 0) {
+            p = ScanBool(p, end, &record->Vbs);
+        } else if (strcmp(key, "hvci") == 0) {
+            p = ScanBool(p, end, &record->Hvci);
+        } else if (strcmp(key, "hv_build") == 0) {
+            p = ScanText(p, end, record->Build, sizeof(record->Build));
+        } else if (strcmp(key, "verdict") == 0) {
+            p = ScanText(p, end, record->Verdict, sizeof(record->Verdict));
+        } else {
+            p = SkipValue(p, end);
+        }
+        if (p == NULL) {
+            return NULL;
+        }
+
+        p = SkipSpace(p, end);
+        if (p < end && *p == ',') {
+            p = SkipSpace(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}') {
+            break;
+        }
+        return NULL;
+    }
+
+    record->Detected = (detected >= 0) ? detected : (record->Flags != 0);
+    return p + 1;
+}
+
+FLEET_SCAN_STATUS FleetScanRecord(const char** cursor, const char* end, PFLEET_RECORD record)
+{
+    const char* p = *cursor;
+    const char* next;
+    const char* lineEnd;
+
+    for (;;) {
+        p = (p < end) ? (const char*)memchr(p, '{', (size_t)(end - p)) : NULL;
+        if (p == NULL) {
+            *cursor = end;
+            return FLEET_SCAN_END;
+        }
+        next = SkipSpace(p + 1, end);
+        if (next < end && (*next == '"' || *next == '}')) {
+            break;
+        }
+        p++;
+    }
+
+    next = ScanObject(p, end, record);
+    if (next != NULL) {
+        *cursor = next;
+        return FLEET_SCAN_OK;
+    }
+
+    lineEnd = (const char*)memchr(p, '\n', (size_t)(end - p));
+    *cursor = (lineEnd != NULL) ? lineEnd + 1 : end;
+    return FLEET_SCAN_MALFORMED;
+}
+
+/* ============================================================================
+ * Dictionaries
+ * ============================================================================ */
+
+static UINT32 HashText(const char* text)
+{
+    UINT32 hash = 2166136261u;
+
+    while (*text != '\0') {
+        hash = (hash ^ (UINT8)*text++) * 16777619u;
+    }
+    return hash;
+}
+
+static void DictInit(PFLEET_DICT dict, UINT32 limit)
+{
+    memset(dict, 0, sizeof(*dict));
+    dict->Limit = limit;
+}
+
+static void DictFree(PFLEET_DICT dict)
+{
+    free(dict->Values);
+    free(dict->Slots);
+    memset(dict, 0, sizeof(*dict));
+}
+
+/* Slot holding value, or the empty slot where it would go */
+static UINT32 DictSlot(const FLEET_DICT* dict, const char* value)
+{
+    UINT32 mask = dict->SlotCount - 1;
+    UINT32 slot = HashText(value) & mask;
+
+    while (dict->Slots[slot] != 0 && strcmp(dict->Values[dict->Slots[slot] - 1], value) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static int DictRehash(PFLEET_DICT dict, UINT32 slotCount)
+{
+    UINT32* slots = (UINT32*)calloc(slotCount, sizeof(UINT32));
+    UINT32* old = dict->Slots;
+    UINT32 id;
+
+    if (slots == NULL) {
+        return -1;
+    }
+    dict->Slots = slots;
+    dict->SlotCount = slotCount;
+    free(old);
+
+    /* Id 0 (the absent value) is never hashed */
+    for (id = 1; id < dict->Count; id++) {
+        dict->Slots[DictSlot(dict, dict->Values[id])] = id + 1;
+    }
+    return 0;
+}
+
+/* Id of value, added if new. 0 on success, 1 if the dictionary is full, -1 out of memory */
+static int DictIntern(PFLEET_DICT dict, const char* value, UINT32* id)
+{
+    UINT32 slot;
+    UINT32 capacity;
+    char (*values)[FLEET_FIELD_LEN];
+
+    if (value[0] == '\0') {
+        *id = 0;
+        return 0;
+    }
+    if (dict->Count == 0) {
+        values = calloc(16, FLEET_FIELD_LEN);
+        if (values == NULL) {
+            return -1;
+        }
+        dict->Values = values;
+        dict->Capacity = 16;
+        dict->Count = 1;
+    }
+    if (dict->SlotCount == 0 || dict->Count * 2 >= dict->SlotCount) {
+        if (DictRehash(dict, dict->SlotCount ? dict->SlotCount * 2 : 32) != 0) {
+            return -1;
+        }
+    }
+
+    slot = DictSlot(dict, value);
+    if (dict->Slots[slot] != 0) {
+        *id = dict->Slots[slot] - 1;
+        return 0;
+    }
+    if (dict->Count >= dict->Limit) {
+        return 1;
+    }
+    if (dict->Count == dict->Capacity) {
+        capacity = dict->Capacity * 2;
+        values = realloc(dict->Values, (size_t)capacity * FLEET_FIELD_LEN);
+        if (values == NULL) {
+            return -1;
+        }
+        dict->Values = values;
+        dict->Capacity = capacity;
+    }
+    *id = dict->Count++;
+    strncpy(dict->Values[*id], value, FLEET_FIELD_LEN - 1);
+    dict->Values[*id][FLEET_FIELD_LEN - 1] = '\0';
+    dict->Slots[slot] = *id + 1;
+    return 0;
+}
+
+/* Id of value without adding it; -1 if absent */
+static int DictFind(const FLEET_DICT* dict, const char* value)
+{
+    UINT32 slot;
+
+    if (value[0] == '\0') {
+        return 0;
+    }
+    if (dict->SlotCount == 0) {
+        return -1;
+    }
+    slot = DictSlot(dict, value);
+    return (dict->Slots[slot] != 0) ? (int)(dict->Slots[slot] - 1) : -1;
+}
+
+/* ============================================================================
+ * Store
+ * ============================================================================ */
+
+void FleetStoreInit(PFLEET_STORE store)
+{
+    memset(store, 0, sizeof(*store));
+    DictInit(&store->Builds, FLEET_MAX_BUILDS);
+    DictInit(&store->Verdicts, FLEET_MAX_VERDICTS);
+}
+
+void FleetStoreFree(PFLEET_STORE store)
+{
+    int column;
+
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        free(store->Columns[column]);
+    }
+    free(store->BuildIds);
+    free(store->VerdictIds);
+    DictFree(&store->Builds);
+    DictFree(&store->Verdicts);
+    FleetStoreInit(store);
+}
+
+/* Room for at least rows rows; new bitmap words are zero */
+static int StoreReserve(PFLEET_STORE store, UINT32 rows)
+{
+    UINT32 capacity = store->Capacity ? store->Capacity : FLEET_INITIAL_ROWS;
+    size_t oldWords = store->Capacity / 64;
+    size_t newWords;
+    UINT64* words;
+    void* ids;
+    int column;
+
+    if (rows <= store->Capacity) {
+        return 0;
+    }
+    while (capacity < rows) {
+        capacity *= 2;
+    }
+    newWords = capacity / 64;
+
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        words = (UINT64*)realloc(store->Columns[column], newWords * sizeof(UINT64));
+        if (words == NULL) {
+            return -1;
+        }
+        memset(words + oldWords, 0, (newWords - oldWords) * sizeof(UINT64));
+        store->Columns[column] = words;
+    }
+    ids = realloc(store->BuildIds, (size_t)capacity * sizeof(UINT16));
+    if (ids == NULL) {
+        return -1;
+    }
+    store->BuildIds = (UINT16*)ids;
+    ids = realloc(store->VerdictIds, (size_t)capacity * sizeof(UINT8));
+    if (ids == NULL) {
+        return -1;
+    }
+    store->VerdictIds = (UINT8*)ids;
+    store->Capacity = capacity;
+    return 0;
+}
+
+static void SetBit(UINT64* column, UINT32 row)
+{
+    column[row >> 6] |= 1ULL << (row & 63);
+}
+
+/* Dictionary id for a new row; a full dictionary stores the absent value */
+static int InternForRow(PFLEET_STORE store, PFLEET_DICT dict, const char* value, UINT32* id)
+{
+    int status = DictIntern(dict, value, id);
+
+    if (status > 0) {
+        store->Overflow++;
+        *id = 0;
+        status = 0;
+    }
+    return status;
+}
+
+int FleetStoreAppend(PFLEET_STORE store, const FLEET_RECORD* record)
+{
+    UINT32 row = store->RowCount;
+    UINT32 buildId;
+    UINT32 verdictId;
+    int column;
+
+    if (StoreReserve(store, row + 1) != 0 ||
+        InternForRow(store, &store->Builds, record->Build, &buildId) != 0 ||
+        InternForRow(store, &store->Verdicts, record->Verdict, &verdictId) != 0) {
+        return -1;
+    }
+
+    for (column = 0; column < FLEET_FLAG_COLUMNS; column++) {
+        if (record->Flags & (1u << column)) {
+            SetBit(store->Columns[column], row);
+        }
+    }
+    if (record->Detected) {
+        SetBit(store->Columns[FLEET_COL_DETECTED], row);
+    }
+    if (record->Vbs) {
+        SetBit(store->Columns[FLEET_COL_VBS], row);
+    }
+    if (record->Hvci) {
+        SetBit(store->Columns[FLEET_COL_HVCI], row);
+    }
+    store->BuildIds[row] = (UINT16)buildId;
+    store->VerdictIds[row] = (UINT8)verdictId;
+    store->RowCount++;
+    return 0;
+}
+
+int FleetStoreIngest(PFLEET_STORE store, const char* data, size_t size)
+{
+    const char* cursor = data;
+    const char* end = data + size;
+    FLEET_RECORD record;
+    FLEET_SCAN_STATUS status;
+
+    for (;;) {
+        status = FleetScanRecord(&cursor, end, &record);
+        if (status == FLEET_SCAN_END) {
+            return 0;
+        }
+        if (status == FLEET_SCAN_MALFORMED) {
+            store->Malformed++;
+            continue;
+        }
+        if (FleetStoreAppend(store, &record) != 0) {
+            return -1;
+        }
+    }
+}
+
+/* Maps every id of src into dst; the caller frees *map */
+static int MergeDict(PFLEET_STORE dst, PFLEET_DICT dstDict, const FLEET_DICT* srcDict, UINT32** map)
+{
+    UINT32 id;
+
+    *map = (UINT32*)calloc(srcDict->Count ? srcDict->Count : 1, sizeof(UINT32));
+    if (*map == NULL) {
+        return -1;
+    }
+    for (id = 1; id < srcDict->Count; id++) {
+        if (InternForRow(dst, dstDict, srcDict->Values[id], &(*map)[id]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int FleetStoreMerge(PFLEET_STORE dst, const FLEET_STORE* src)
+{
+    UINT32* buildMap = NULL;
+    UINT32* verdictMap = NULL;
+    UINT32 base = dst->RowCount;
+    UINT32 shift = base & 63;
+    size_t dstWords;
+    size_t srcWords = FLEET_MASK_WORDS(src);
+    size_t target;
+    size_t w;
+    UINT64 word;
+    UINT32 row;
+    int column;
+
+    dst->Malformed += src->Malformed;
+    dst->Overflow += src->Overflow;
+    if (src->RowCount == 0) {
+        return 0;
+    }
+    if (StoreReserve(dst, base + src->RowCount) != 0 ||
+        MergeDict(dst, &dst->Builds, &src->Builds, &buildMap) != 0 ||
+        MergeDict(dst, &dst->Verdicts, &src->Verdicts, &verdictMap) != 0) {
+        free(buildMap);
+        free(verdictMap);
+        return -1;
+    }
+
+    /* Bits past src->RowCount are zero, so whole words can be shifted in */
+    dstWords = dst->Capacity / 64;
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        for (w = 0; w < srcWords; w++) {
+            word = src->Columns[column][w];
+            target = (base >> 6) + w;
+            dst->Columns[column][target] |= word << shift;
+            if (shift != 0 && target + 1 < dstWords) {
+                dst->Columns[column][target + 1] |= word >> (64 - shift);
+            }
+        }
+    }
+    for (row = 0; row < src->RowCount; row++) {
+        dst->BuildIds[base + row] = (UINT16)buildMap[src->BuildIds[row]];
+        dst->VerdictIds[base + row] = (UINT8)verdictMap[src->VerdictIds[row]];
+    }
+    dst->RowCount += src->RowCount;
+    free(buildMap);
+    free(verdictMap);
+    return 0;
+}
+
+/* ============================================================================
+ * Queries
+ * ============================================================================ */
+
+const char* FleetColumnName(int column)
+{
+    if (column < 0 || column >= FLEET_COLUMN_COUNT) {
+        return NULL;
+    }
+    return (column < FLEET_FLAG_COLUMNS) ? HvDetectionFlagNames()[column] : g_fleetExtraColumns[column - FLEET_FLAG_COLUMNS];
+}
+
+int FleetColumnFind(const char* name)
+{
+    int column;
+
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        if (HvRuleEqualsNoCase(name, FleetColumnName(column))) {
+            return column;
+        }
+    }
+    return -1;
+}
+
+int FleetFilterParse(const FLEET_STORE* store, const char* spec, PFLEET_FILTER filter, char* msg, size_t msgSize)
+{
+    char term[FLEET_FIELD_LEN + 16];
+    const char* p = spec;
+    const char* termEnd;
+    const char* name;
+    char* value;
+    size_t length;
+    int negate;
+    int column;
+    int id;
+
+    memset(filter, 0, sizeof(*filter));
+    filter->BuildId = -1;
+    filter->VerdictId = -1;
+
+    while (p != NULL && *p != '\0') {
+        termEnd = strchr(p, ',');
+        length = termEnd ? (size_t)(termEnd - p) : strlen(p);
+        if (length >= sizeof(term)) {
+            snprintf(msg, msgSize, "Filter term too long: %.*s", (int)length, p);
+            return -1;
+        }
+        memcpy(term, p, length);
+        term[length] = '\0';
+        p = termEnd ? termEnd + 1 : NULL;
+        if (term[0] == '\0') {
+            continue;
+        }
+
+        value = strchr(term, '=');
+        if (value != NULL) {
+            *value++ = '\0';
+            if (strcmp(term, "build") == 0) {
+                id = DictFind(&store->Builds, value);
+                filter->BuildId = id;
+            } else if (strcmp(term, "verdict") == 0) {
+                id = DictFind(&store->Verdicts, value);
+                filter->VerdictId = id;
+            } else {
+                snprintf(msg, msgSize, "Unknown filter field: %s", term);
+                return -1;
+            }
+            if (id < 0) {
+                filter->MatchNone = 1;
+            }
+            continue;
+        }
+
+        negate = (term[0] == '!');
+        name = negate ? term + 1 : term;
+        column = FleetColumnFind(name);
+        if (column < 0) {
+            snprintf(msg, msgSize, "Unknown column: %s", name);
+            return -1;
+        }
+        if (negate) {
+            filter->Exclude |= 1u << column;
+        } else {
+            filter->Require |= 1u << column;
+        }
+    }
+    return 0;
+}
+
+UINT32 FleetSelect(const FLEET_STORE* store, const FLEET_FILTER* filter, UINT64* mask)
+{
+    size_t words = FLEET_MASK_WORDS(store);
+    size_t w;
+    const UINT64* bits;
+    UINT64 word;
+    UINT32 count = 0;
+    UINT32 row;
+    int column;
+
+    if (words == 0) {
+        return 0;
+    }
+    if (filter->MatchNone) {
+        memset(mask, 0, words * sizeof(UINT64));
+        return 0;
+    }
+
+    memset(mask, 0xFF, words * sizeof(UINT64));
+    if (store->RowCount & 63) {
+        mask[words - 1] = (1ULL << (store->RowCount & 63)) - 1;
+    }
+
+    /* Column at a time, so each pass is a straight AND over two arrays */
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        bits = store->Columns[column];
+        if (filter->Require & (1u << column)) {
+            for (w = 0; w < words; w++) {
+                mask[w] &= bits[w];
+            }
+        } else if (filter->Exclude & (1u << column)) {
+            for (w = 0; w < words; w++) {
+                mask[w] &= ~bits[w];
+            }
+        }
+    }
+
+    for (w = 0; w < words; w++) {
+        if ((filter->BuildId >= 0 || filter->VerdictId >= 0) && mask[w] != 0) {
+            word = mask[w];
+            while (word != 0) {
+                row = (UINT32)(w * 64) + FleetLowestBit(word);
+                if ((filter->BuildId >= 0 && store->BuildIds[row] != filter->BuildId) ||
+                    (filter->VerdictId >= 0 && store->VerdictIds[row] != filter->VerdictId)) {
+                    mask[w] &= ~(1ULL << (row & 63));
+                }
+                word &= word - 1;
+            }
+        }
+        count += FleetPopcount64(mask[w]);
+    }
+    return count;
+}
+
+void FleetGroupCount(const FLEET_STORE* store, const UINT64* mask, FLEET_GROUP group, UINT32* counts)
+{
+    size_t words = FLEET_MASK_WORDS(store);
+    size_t w;
+    UINT64 word;
+    UINT32 row;
+
+    for (w = 0; w < words; w++) {
+        word = mask[w];
+        while (word != 0) {
+            row = (UINT32)(w * 64) + FleetLowestBit(word);
+            if (group == FLEET_GROUP_BUILD) {
+                counts[store->BuildIds[row]]++;
+            } else {
+                counts[store->VerdictIds[row]]++;
+            }
+            word &= word - 1;
+        }
+    }
+}
+
+void FleetColumnCounts(const FLEET_STORE* store, const UINT64* mask, UINT32 counts[FLEET_COLUMN_COUNT])
+{
+    size_t words = FLEET_MASK_WORDS(store);
+    size_t w;
+    const UINT64* bits;
+    int column;
+
+    for (column = 0; column < FLEET_COLUMN_COUNT; column++) {
+        bits = store->Columns[column];
+        counts[column] = 0;
+        for (w = 0; w < words; w++) {
+            counts[column] += FleetPopcount64(bits[w] & mask[w]);
+        }
+    }
+}
+
+const char* FleetGroupValue(const FLEET_STORE* store, FLEET_GROUP group, UINT32 id)
+{
+    const FLEET_DICT* dict = (group == FLEET_GROUP_BUILD) ? &store->Builds : &store->Verdicts;
+
+    return (id != 0 && id < dict->Count) ? dict->Values[id] : "";
+}
+
+UINT32 FleetGroupSize(const FLEET_STORE* store, FLEET_GROUP group)
+{
+    const FLEET_DICT* dict = (group == FLEET_GROUP_BUILD) ? &store->Builds : &store->Verdicts;
+
+    return dict->Count ? dict->Count : 1;
+}
@@ -0,0 +1,152 @@
+/**
+ * fleet_store.h - Columnar store of detector results from many hosts
+ *
+ * hyperv_detector --json prints one result object per run. The fleet tool
+ * collects those objects (NDJSON, a JSON array, or the raw detector output
+ * with its text before the object) and keeps them column by column:
+ *
+ *   one bitmap per check flag (HYPERV_DETECTED_*), plus detected, vbs, hvci
+ *   hv_build   dictionary-encoded, UINT16 id per row
+ *   verdict    dictionary-encoded, UINT8 id per row
+ *
+ * Filters AND whole 64-row words of the bitmaps, so "vbs but no hvci" over a
+ * million rows touches two 125 KB columns. Dictionary id 0 is the absent
+ * value (missing or null field).
+ *
+ * The scanner only looks at top-level keys and skips everything else,
+ * including nested objects and unknown fields. Strings are skipped eight
+ * bytes at a time (SWAR) until a quote or backslash shows up.
+ *
+ * Portable: builds on Windows and Linux; threads and file mapping live in
+ * fleet_main.c.
+ */
+
+#pragma once
+#ifndef FLEET_STORE_H
+#define FLEET_STORE_H
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "../common/detection_rules.h"
+
+#define FLEET_FIELD_LEN         64
+#define FLEET_MAX_BUILDS        0xFFFF
+#define FLEET_MAX_VERDICTS      0xFF
+
+/* Boolean columns; the first FLEET_FLAG_COLUMNS match HYPERV_DETECTED_* bit by bit */
+typedef enum _FLEET_COLUMN {
+    FLEET_COL_CPUID = 0,
+    FLEET_COL_REGISTRY,
+    FLEET_COL_FILES,
+    FLEET_COL_SERVICES,
+    FLEET_COL_DEVICES,
+    FLEET_COL_BIOS,
+    FLEET_COL_PROCESSES,
+    FLEET_COL_HYPERCALLS,
+    FLEET_COL_OBJECTS,
+    FLEET_COL_NESTED,
+    FLEET_COL_SANDBOX,
+    FLEET_COL_DOCKER,
+    FLEET_COL_REMOVED,
+    FLEET_COL_DETECTED,
+    FLEET_COL_VBS,
+    FLEET_COL_HVCI,
+    FLEET_COLUMN_COUNT
+} FLEET_COLUMN;
+
+#define FLEET_FLAG_COLUMNS      FLEET_COL_DETECTED
+
+/* One result object as the scanner sees it */
+typedef struct _FLEET_RECORD {
+    UINT32 Flags;
+    int Detected;               /* "detected"; Flags != 0 when absent */
+    int Vbs;
+    int Hvci;
+    char Build[FLEET_FIELD_LEN];    /* "" when absent or null */
+    char Verdict[FLEET_FIELD_LEN];
+} FLEET_RECORD, *PFLEET_RECORD;
+
+typedef enum _FLEET_SCAN_STATUS {
+    FLEET_SCAN_OK = 0,
+    FLEET_SCAN_END,             /* No further object in the input */
+    FLEET_SCAN_MALFORMED        /* Bad object; scanning resumes on the next line */
+} FLEET_SCAN_STATUS;
+
+typedef struct _FLEET_DICT {
+    char (*Values)[FLEET_FIELD_LEN];
+    UINT32 Count;
+    UINT32 Capacity;
+    UINT32 Limit;               /* Largest id + 1 the column type can hold */
+    UINT32* Slots;              /* Open addressing, id + 1 (0 = empty) */
+    UINT32 SlotCount;
+} FLEET_DICT, *PFLEET_DICT;
+
+typedef struct _FLEET_STORE {
+    UINT32 RowCount;
+    UINT32 Capacity;            /* Multiple of 64 */
+    UINT64* Columns[FLEET_COLUMN_COUNT];
+    UINT16* BuildIds;
+    UINT8* VerdictIds;
+    FLEET_DICT Builds;
+    FLEET_DICT Verdicts;
+    UINT32 Malformed;           /* Objects the scanner rejected */
+    UINT32 Overflow;            /* Rows whose build or verdict did not fit the dictionary */
+} FLEET_STORE, *PFLEET_STORE;
+
+/* Row filter: all Require columns set, no Exclude column set; id -1 = any */
+typedef struct _FLEET_FILTER {
+    UINT32 Require;             /* 1 << FLEET_COLUMN */
+    UINT32 Exclude;
+    int BuildId;
+    int VerdictId;
+    int MatchNone;              /* A build or verdict that no row has */
+} FLEET_FILTER, *PFLEET_FILTER;
+
+typedef enum _FLEET_GROUP {
+    FLEET_GROUP_BUILD = 0,
+    FLEET_GROUP_VERDICT
+} FLEET_GROUP;
+
+/*
+ * Scans the next result object in [*cursor, end). Text before an object that
+ * does not start like one (a '{' not followed by '"' or '}') is skipped, so
+ * raw detector output and JSON arrays load as well as NDJSON.
+ */
+FLEET_SCAN_STATUS FleetScanRecord(const char** cursor, const char* end, PFLEET_RECORD record);
+
+void FleetStoreInit(PFLEET_STORE store);
+void FleetStoreFree(PFLEET_STORE store);
+
+/* 0 on success, -1 out of memory */
+int FleetStoreAppend(PFLEET_STORE store, const FLEET_RECORD* record);
+
+/* Scans [data, data + size) into the store; -1 out of memory */
+int FleetStoreIngest(PFLEET_STORE store, const char* data, size_t size);
+
+/* Appends src to dst, mapping src's dictionary ids; -1 out of memory */
+int FleetStoreMerge(PFLEET_STORE dst, const FLEET_STORE* src);
+
+const char* FleetColumnName(int column);
+int FleetColumnFind(const char* name);      /* -1 if unknown */
+
+/* "vbs,!hvci,verdict=HyperV-GuestVM,build=10.0.26100"; 0 on success */
+int FleetFilterParse(const FLEET_STORE* store, const char* spec, PFLEET_FILTER filter, char* msg, size_t msgSize);
+
+/* Words in a row mask for the store's current rows */
+#define FLEET_MASK_WORDS(store) (((store)->RowCount + 63) / 64)
+
+/* Fills mask (FLEET_MASK_WORDS words) with the matching rows; returns their count */
+UINT32 FleetSelect(const FLEET_STORE* store, const FLEET_FILTER* filter, UINT64* mask);
+
+/* counts[id] += rows in mask per build or verdict id; counts holds the dictionary's Count */
+void FleetGroupCount(const FLEET_STORE* store, const UINT64* mask, FLEET_GROUP group, UINT32* counts);
+
+/* counts[column] = rows in mask with the column set */
+void FleetColumnCounts(const FLEET_STORE* store, const UINT64* mask, UINT32 counts[FLEET_COLUMN_COUNT]);
+
+/* Dictionary value for a group id ("" for id 0) */
+const char* FleetGroupValue(const FLEET_STORE* store, FLEET_GROUP group, UINT32 id);
+UINT32 FleetGroupSize(const FLEET_STORE* store, FLEET_GROUP group);
+
+#endif /* FLEET_STORE_H */
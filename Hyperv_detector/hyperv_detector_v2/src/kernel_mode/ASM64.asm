@@ -161,6 +161,25 @@ HvCallFastHypercall PROC
     ret
 HvCallFastHypercall ENDP
 
+;
+; Fast hypercall for AMD processors (VMMCALL instead of VMCALL)
+; UINT64 HvCallFastHypercallVmmcall(UINT64 Control, UINT64 Input1, UINT64 Input2)
+;
+HvCallFastHypercallVmmcall PROC
+    push    rbx
+    push    rsi
+    push    rdi
+    
+    ; VMMCALL (0F 01 D9), emitted as bytes for older assemblers
+    db      0Fh, 01h, 0D9h
+    
+    pop     rdi
+    pop     rsi
+    pop     rbx
+    
+    ret
+HvCallFastHypercallVmmcall ENDP
+
 ;
 ; Get processor information using CPUID
 ; VOID HvGetCpuInfo(UINT32 Function, UINT32* Eax, UINT32* Ebx, UINT32* Ecx, UINT32* Edx)
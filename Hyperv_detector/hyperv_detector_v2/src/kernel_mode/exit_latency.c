@@ -0,0 +1,145 @@
+#include "hyperv_driver.h"
+
+/*
+ * VM-exit latency battery for IOCTL_HYPERV_EXIT_LATENCY.
+ *
+ * Each processor is measured in turn (system affinity), and every chunk of
+ * HV_LATENCY_CHUNK samples runs with interrupts disabled, so a sample is
+ * the exit itself and not an interrupt, DPC or reschedule that happened to
+ * land inside the timed region. Chunks keep the interrupts-off windows
+ * short. TSC deltas go straight into the histograms of the output buffer;
+ * the histogram code is shared with user mode (latency_histogram.h).
+ */
+
+#if defined(_M_X64) || defined(_M_AMD64)
+
+typedef UINT64 (*FAST_HYPERCALL_PROC)(UINT64 Control, UINT64 Input1, UINT64 Input2);
+
+/*
+ * Which probes can run on the current processor. Exiting instructions that
+ * fault are skipped rather than measured inside the interrupts-off window.
+ */
+static VOID ProbeAvailability(BOOLEAN available[HV_LATENCY_PROBE_COUNT], FAST_HYPERCALL_PROC* fastHypercall)
+{
+    ULONGLONG value = 0;
+    int cpuInfo[4] = {0};
+    BOOLEAN hyperV = IsHyperVPresent();
+    UINT32 i;
+
+    for (i = 0; i < HV_LATENCY_PROBE_COUNT; i++) {
+        available[i] = TRUE;
+    }
+
+    available[HV_LATENCY_PROBE_RDMSR_VP_INDEX] = hyperV && NT_SUCCESS(ReadMsr(HV_X64_MSR_VP_INDEX, &value));
+    available[HV_LATENCY_PROBE_RDMSR_TIME_REF] = hyperV && NT_SUCCESS(ReadMsr(HV_X64_MSR_TIME_REF_COUNT, &value));
+
+    /* Hypercalls need the OS to have enabled the hypercall interface */
+    available[HV_LATENCY_PROBE_FAST_HYPERCALL] = hyperV && NT_SUCCESS(ReadMsr(HV_X64_MSR_HYPERCALL, &value)) && (value & 1);
+
+    /* "AuthenticAMD" needs VMMCALL; VMCALL would #UD */
+    __cpuid(cpuInfo, 0);
+    *fastHypercall = (cpuInfo[1] == 0x68747541) ? HvCallFastHypercallVmmcall : HvCallFastHypercall;
+}
+
+/*
+ * One timed sample. The fences keep the exiting instruction inside the
+ * rdtsc/rdtscp window.
+ */
+static __forceinline UINT64 MeasureOnce(UINT32 probe, FAST_HYPERCALL_PROC fastHypercall)
+{
+    int cpuInfo[4];
+    unsigned int aux;
+    UINT64 start, end;
+
+    _mm_lfence();
+    start = __rdtsc();
+    _mm_lfence();
+
+    switch (probe) {
+        case HV_LATENCY_PROBE_CPUID_0:          __cpuidex(cpuInfo, 0, 0); break;
+        case HV_LATENCY_PROBE_CPUID_VENDOR:     __cpuidex(cpuInfo, 0x40000000, 0); break;
+        case HV_LATENCY_PROBE_CPUID_FEATURES:   __cpuidex(cpuInfo, 0x40000003, 0); break;
+        case HV_LATENCY_PROBE_RDMSR_VP_INDEX:   (void)__readmsr(HV_X64_MSR_VP_INDEX); break;
+        case HV_LATENCY_PROBE_RDMSR_TIME_REF:   (void)__readmsr(HV_X64_MSR_TIME_REF_COUNT); break;
+        case HV_LATENCY_PROBE_FAST_HYPERCALL:
+            fastHypercall(HVCALL_NOTIFY_LONG_SPIN_WAIT | HV_HYPERCALL_FAST_BIT, 0, 0);
+            break;
+        default:                                break;   /* HV_LATENCY_PROBE_BASELINE */
+    }
+
+    end = __rdtscp(&aux);
+    _mm_lfence();
+    return end - start;
+}
+
+static VOID MeasureCurrentProcessor(PVOID response, UINT32 processor, UINT32 samplesPerProbe)
+{
+    BOOLEAN available[HV_LATENCY_PROBE_COUNT];
+    FAST_HYPERCALL_PROC fastHypercall;
+    PHV_LATENCY_HISTOGRAM histogram;
+    UINT32 probe, done, chunk, i;
+
+    ProbeAvailability(available, &fastHypercall);
+
+    for (probe = 0; probe < HV_LATENCY_PROBE_COUNT; probe++) {
+        histogram = HvLatencyGet(response, processor, probe);
+        if (!available[probe]) {
+            histogram->Status = HV_BATCH_STATUS_NOT_SUPPORTED;
+            continue;
+        }
+
+        for (done = 0; done < samplesPerProbe; done += chunk) {
+            chunk = min(HV_LATENCY_CHUNK, samplesPerProbe - done);
+
+            _disable();
+            for (i = 0; i < chunk; i++) {
+                HvHistogramAdd(histogram, MeasureOnce(probe, fastHypercall));
+            }
+            _enable();
+        }
+        histogram->Status = HV_BATCH_STATUS_OK;
+    }
+}
+
+/*
+ * Fill a complete IOCTL_HYPERV_EXIT_LATENCY response. Must be called at
+ * PASSIVE_LEVEL; processors that cannot be targeted keep NOT_RUN rows.
+ */
+NTSTATUS MeasureExitLatency(PVOID response, UINT32 processorCount, UINT32 samplesPerProbe)
+{
+    PROCESSOR_NUMBER number;
+    GROUP_AFFINITY   affinity;
+    GROUP_AFFINITY   previous;
+    UINT32           i;
+
+    HvLatencyBegin(response, processorCount, samplesPerProbe);
+
+    for (i = 0; i < processorCount; i++) {
+        if (!NT_SUCCESS(KeGetProcessorNumberFromIndex(i, &number))) {
+            continue;
+        }
+
+        RtlZeroMemory(&affinity, sizeof(affinity));
+        affinity.Group = number.Group;
+        affinity.Mask  = (KAFFINITY)1 << number.Number;
+        KeSetSystemGroupAffinityThread(&affinity, &previous);
+
+        MeasureCurrentProcessor(response, i, samplesPerProbe);
+
+        KeRevertToUserGroupAffinityThread(&previous);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+#else
+
+NTSTATUS MeasureExitLatency(PVOID response, UINT32 processorCount, UINT32 samplesPerProbe)
+{
+    UNREFERENCED_PARAMETER(response);
+    UNREFERENCED_PARAMETER(processorCount);
+    UNREFERENCED_PARAMETER(samplesPerProbe);
+    return STATUS_NOT_SUPPORTED;
+}
+
+#endif
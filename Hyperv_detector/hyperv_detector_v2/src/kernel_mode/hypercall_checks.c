@@ -117,6 +117,65 @@ NTSTATUS PerformHypercall(DWORD hypercallCode, DWORD inputParamCount, DWORD outp
     }
 }
 
+/*
+ * Run one IOCTL_HYPERV_BATCH operation. The status of the operation goes into
+ * result->Status (and the NTSTATUS into result->Detail); the batch itself
+ * always continues with the next operation.
+ */
+VOID ExecuteBatchOp(const HV_BATCH_OP* op, PHV_BATCH_RESULT result) {
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONGLONG value = 0;
+    DWORD output = 0;
+
+    RtlZeroMemory(result, sizeof(HV_BATCH_RESULT));
+    result->Type = op->Type;
+
+    switch (op->Type) {
+
+        case HV_BATCH_OP_RDMSR:
+        case HV_BATCH_OP_VP_INDEX:
+            status = ReadMsr(op->Type == HV_BATCH_OP_RDMSR ? op->Arg[0] : HV_X64_MSR_VP_INDEX, &value);
+            result->Value[0] = (UINT32)value;
+            result->Value[1] = (UINT32)(value >> 32);
+            break;
+
+        case HV_BATCH_OP_CPUID: {
+#if defined(_M_IX86) || defined(_M_X64) || defined(_M_AMD64)
+            int cpuInfo[4] = {0};
+
+            __cpuidex(cpuInfo, (int)op->Arg[0], (int)op->Arg[1]);
+            result->Value[0] = (UINT32)cpuInfo[0];
+            result->Value[1] = (UINT32)cpuInfo[1];
+            result->Value[2] = (UINT32)cpuInfo[2];
+            result->Value[3] = (UINT32)cpuInfo[3];
+#else
+            status = STATUS_NOT_SUPPORTED;
+#endif
+            break;
+        }
+
+        case HV_BATCH_OP_HYPERCALL:
+            status = PerformHypercall(op->Arg[0], op->Arg[1], op->Arg[2], &output);
+            result->Value[0] = output;
+            break;
+
+        default:
+            status = STATUS_INVALID_PARAMETER;
+            break;
+    }
+
+    if (NT_SUCCESS(status)) {
+        result->Status = HV_BATCH_STATUS_OK;
+    } else if (status == STATUS_NOT_SUPPORTED) {
+        result->Status = HV_BATCH_STATUS_NOT_SUPPORTED;
+    } else if (status == STATUS_UNSUCCESSFUL) {
+        result->Status = HV_BATCH_STATUS_HV_ERROR;   /* PerformHypercall: non-zero HV_STATUS */
+    } else {
+        result->Status = HV_BATCH_STATUS_FAULT;
+    }
+    result->Detail = (UINT32)status;
+}
+
 NTSTATUS CheckVmBusPresence(PDWORD result) {
     UNICODE_STRING deviceName;
     PDEVICE_OBJECT deviceObject = NULL;
@@ -121,6 +121,143 @@ NTSTATUS HyperVDetectorDeviceControl(PDEVICE_OBJECT DeviceObject, PIRP Irp)
             break;
         }
 
+        case IOCTL_HYPERV_BATCH: {
+            PUCHAR       request;
+            HV_BATCH_OP  op;
+            HV_BATCH_RESULT opResult;
+            KIRQL        oldIrql;
+            int          count;
+            UINT32       i;
+
+            count = HvBatchParseHeader(buf, inLen, HV_BATCH_REQUEST_MAGIC, HV_BATCH_OP_SIZE);
+            if (count < 0) {
+                status = (count == HV_BATCH_E_SHORT) ? STATUS_BUFFER_TOO_SMALL : STATUS_INVALID_PARAMETER;
+                break;
+            }
+            if (outLen < HvBatchResponseSize((UINT32)count)) {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            /* Results are larger than ops, so they would overrun unread ops in place. */
+            request = (PUCHAR)ExAllocatePool2(POOL_FLAG_NON_PAGED, HvBatchRequestSize((UINT32)count), HV_POOL_TAG);
+            if (request == NULL) {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+            RtlCopyMemory(request, buf, HvBatchRequestSize((UINT32)count));
+
+            status = STATUS_SUCCESS;
+            for (i = 0; i < (UINT32)count; i++) {
+                if (HvBatchGetOp(request, i, &op) != 0) {
+                    status = STATUS_INVALID_PARAMETER;
+                    break;
+                }
+            }
+
+            if (NT_SUCCESS(status)) {
+                /* Stay on one processor so every op sees the same VP. */
+                KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+                for (i = 0; i < (UINT32)count; i++) {
+                    HvBatchGetOp(request, i, &op);
+                    ExecuteBatchOp(&op, &opResult);
+                    HvBatchPutResult(buf, i, &opResult);
+                }
+                KeLowerIrql(oldIrql);
+
+                HvBatchWriteHeader(buf, HV_BATCH_RESPONSE_MAGIC, (UINT32)count);
+                bytesOut = HvBatchResponseSize((UINT32)count);
+            }
+
+            ExFreePoolWithTag(request, HV_POOL_TAG);
+            break;
+        }
+
+        case IOCTL_HYPERV_BATCH_ALL_CPUS: {
+            PHV_BATCH_OP ops;
+            UINT32       processorCount;
+            int          count;
+            int          i;
+
+            count = HvBatchParseHeader(buf, inLen, HV_BATCH_REQUEST_MAGIC, HV_BATCH_OP_SIZE);
+            if (count < 0) {
+                status = (count == HV_BATCH_E_SHORT) ? STATUS_BUFFER_TOO_SMALL : STATUS_INVALID_PARAMETER;
+                break;
+            }
+
+            processorCount = GetFanoutProcessorCount();
+            if (processorCount == 0 || processorCount > HV_FANOUT_MAX_PROCESSORS) {
+                status = STATUS_NOT_SUPPORTED;
+                break;
+            }
+            if (outLen < HvFanoutResponseSize((UINT32)count, processorCount)) {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            /* Decode all ops up front; the matrix overwrites the request. */
+            ops = (PHV_BATCH_OP)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(HV_BATCH_OP) * count, HV_POOL_TAG);
+            if (ops == NULL) {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            status = STATUS_SUCCESS;
+            for (i = 0; i < count; i++) {
+                if (HvBatchGetOp(buf, (UINT32)i, &ops[i]) != 0) {
+                    status = STATUS_INVALID_PARAMETER;
+                    break;
+                }
+            }
+            if (NT_SUCCESS(status) && HvFanoutValidateOps(ops, (UINT32)count) != 0) {
+                status = STATUS_INVALID_PARAMETER;
+            }
+
+            if (NT_SUCCESS(status)) {
+                status = RunBatchOnAllProcessors(ops, (UINT32)count, buf, processorCount);
+                if (NT_SUCCESS(status)) {
+                    bytesOut = HvFanoutResponseSize((UINT32)count, processorCount);
+                }
+            }
+
+            ExFreePoolWithTag(ops, HV_POOL_TAG);
+            break;
+        }
+
+        case IOCTL_HYPERV_EXIT_LATENCY: {
+            HV_LATENCY_REQUEST request;
+            UINT32             processorCount;
+            UINT32             samples;
+
+            if (inLen < sizeof(HV_LATENCY_REQUEST)) {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+            RtlCopyMemory(&request, buf, sizeof(HV_LATENCY_REQUEST));
+
+            samples = request.SamplesPerProbe ? request.SamplesPerProbe : HV_LATENCY_DEFAULT_SAMPLES;
+            if (samples > HV_LATENCY_MAX_SAMPLES) {
+                status = STATUS_INVALID_PARAMETER;
+                break;
+            }
+
+            processorCount = GetFanoutProcessorCount();
+            if (processorCount == 0 || processorCount > HV_FANOUT_MAX_PROCESSORS) {
+                status = STATUS_NOT_SUPPORTED;
+                break;
+            }
+            if (outLen < HvLatencyResponseSize(processorCount)) {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            status = MeasureExitLatency(buf, processorCount, samples);
+            if (NT_SUCCESS(status)) {
+                bytesOut = HvLatencyResponseSize(processorCount);
+            }
+            break;
+        }
+
         default:
             status = STATUS_INVALID_DEVICE_REQUEST;
             break;
@@ -5,6 +5,8 @@
 #include <ntddk.h>
 #include "minwindef.h"
 #include "../common/shared_structs.h"
+#include "../common/batch_fanout.h"
+#include "../common/latency_histogram.h"
 
 // Driver function declarations (WDM)
 DRIVER_INITIALIZE DriverEntry;
@@ -30,6 +32,10 @@ NTSTATUS ReadMsr(DWORD msrIndex, PULONGLONG value);
 NTSTATUS CheckVmBusPresence(PDWORD result);
 NTSTATUS CheckVmBusRootPresence(PDWORD result);
 NTSTATUS DetectPartitionType(PDWORD partitionType);
+VOID ExecuteBatchOp(const HV_BATCH_OP* op, PHV_BATCH_RESULT result);
+UINT32 GetFanoutProcessorCount(VOID);
+NTSTATUS RunBatchOnAllProcessors(const HV_BATCH_OP* ops, UINT32 opCount, PVOID response, UINT32 processorCount);
+NTSTATUS MeasureExitLatency(PVOID response, UINT32 processorCount, UINT32 samplesPerProbe);
 
 // Partition type constants
 #define PARTITION_TYPE_BARE_METAL   0
@@ -55,6 +61,8 @@ extern UINT64 HvCallHypercall(
     UINT64 InputParam,
     UINT64 OutputParam
 );
+extern UINT64 HvCallFastHypercall(UINT64 Control, UINT64 Input1, UINT64 Input2);
+extern UINT64 HvCallFastHypercallVmmcall(UINT64 Control, UINT64 Input1, UINT64 Input2);
 #else
 /* ARM64 stubs — no CPUID/MSR/VMCALL available */
 static __inline BOOLEAN IsHyperVPresent(void) { return FALSE; }
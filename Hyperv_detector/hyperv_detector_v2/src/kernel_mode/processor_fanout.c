@@ -0,0 +1,97 @@
+#include "hyperv_driver.h"
+
+/*
+ * Per-processor fan-out for IOCTL_HYPERV_BATCH_ALL_CPUS.
+ *
+ * One DPC is targeted at each active processor and all of them are queued
+ * before waiting, so the rows are filled concurrently. DPCs rather than an
+ * IPI broadcast: ReadMsr reports faults with KdPrint, which is not allowed
+ * above DIRQL. Matrix layout and aggregation are in batch_fanout.h.
+ */
+
+typedef struct _FANOUT_CONTEXT {
+    const HV_BATCH_OP* Ops;
+    UINT32             OpCount;
+    PVOID              Response;
+    volatile LONG      Remaining;
+    KEVENT             Done;
+} FANOUT_CONTEXT, *PFANOUT_CONTEXT;
+
+static void FanoutExecute(void* context, UINT32 processor, const HV_BATCH_OP* op, PHV_BATCH_RESULT result)
+{
+    UNREFERENCED_PARAMETER(context);
+    UNREFERENCED_PARAMETER(processor);
+    ExecuteBatchOp(op, result);
+}
+
+static VOID FanoutRelease(PFANOUT_CONTEXT context)
+{
+    if (InterlockedDecrement(&context->Remaining) == 0) {
+        KeSetEvent(&context->Done, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+static VOID FanoutDpc(PKDPC Dpc, PVOID DeferredContext, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+    PFANOUT_CONTEXT context = (PFANOUT_CONTEXT)DeferredContext;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    HvFanoutRunProcessor(context->Response, context->Ops, context->OpCount,
+                         (UINT32)(ULONG_PTR)SystemArgument1, FanoutExecute, NULL);
+    FanoutRelease(context);
+}
+
+/*
+ * Number of processors a fan-out response has rows for
+ */
+UINT32 GetFanoutProcessorCount(VOID)
+{
+    return (UINT32)KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+}
+
+/*
+ * Run ops on processors 0..processorCount-1 and write the complete matrix
+ * (header, cells, summary) to response. Processors that cannot be targeted
+ * keep HV_BATCH_STATUS_NOT_RUN cells.
+ */
+NTSTATUS RunBatchOnAllProcessors(const HV_BATCH_OP* ops, UINT32 opCount, PVOID response, UINT32 processorCount)
+{
+    FANOUT_CONTEXT   context;
+    PKDPC            dpcs;
+    PROCESSOR_NUMBER number;
+    UINT32           i;
+
+    dpcs = (PKDPC)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(KDPC) * processorCount, HV_POOL_TAG);
+    if (dpcs == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    HvFanoutBegin(response, ops, opCount, processorCount);
+
+    context.Ops      = ops;
+    context.OpCount  = opCount;
+    context.Response = response;
+    /* One extra reference for this thread so the event cannot fire mid-loop. */
+    context.Remaining = (LONG)processorCount + 1;
+    KeInitializeEvent(&context.Done, NotificationEvent, FALSE);
+
+    for (i = 0; i < processorCount; i++) {
+        KeInitializeDpc(&dpcs[i], FanoutDpc, &context);
+        KeSetImportanceDpc(&dpcs[i], HighImportance);
+
+        if (!NT_SUCCESS(KeGetProcessorNumberFromIndex(i, &number)) ||
+            !NT_SUCCESS(KeSetTargetProcessorDpcEx(&dpcs[i], &number)) ||
+            !KeInsertQueueDpc(&dpcs[i], (PVOID)(ULONG_PTR)i, NULL)) {
+            FanoutRelease(&context);
+        }
+    }
+
+    FanoutRelease(&context);
+    KeWaitForSingleObject(&context.Done, Executive, KernelMode, FALSE, NULL);
+
+    HvFanoutSummarize(response, opCount, processorCount);
+    ExFreePoolWithTag(dpcs, HV_POOL_TAG);
+    return STATUS_SUCCESS;
+}
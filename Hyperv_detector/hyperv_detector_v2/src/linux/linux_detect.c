@@ -0,0 +1,483 @@
+/**
+ * linux_detect.c - Hyper-V detection for Linux guests
+ */
+
+#include "linux_detect.h"
+#include "../common/firmware_parse.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#ifndef AF_VSOCK
+#define AF_VSOCK 40
+#endif
+
+/* EFI global variable GUID, as efivarfs names the SecureBoot variable */
+#define LINUX_EFI_SECURE_BOOT       "efivars/SecureBoot-8be4df61-93ca-11d2-aa0d-00e098032b8c"
+
+#define LINUX_CLASS_IDE             "32412632-86cb-44a2-9b5c-50d1417354f5"
+#define LINUX_CLASS_SCSI            "ba6163d9-04a1-4d29-b605-72e2ffb1dc7f"
+
+/* VMBus device classes (include/linux/hyperv.h) */
+static const struct {
+    const char* ClassId;
+    const char* Name;
+} g_vmbusClasses[] = {
+    {"f8615163-df3e-46c5-913f-f2d2f965ed0e", "network"},
+    {LINUX_CLASS_SCSI, "scsi"},
+    {LINUX_CLASS_IDE, "ide"},
+    {"2f9bcc4a-0069-4af3-b76b-6fd0be528cda", "fibre-channel"},
+    {"8c2eaf3d-32a7-4b09-ab99-bd1f1c86b501", "network-direct"},
+    {"44c4f61d-4444-4400-9d52-802e27ede19f", "pci"},
+    {"da0a7802-e377-4aac-8e77-0558eb1073f8", "video"},
+    {"f912ad6d-2b17-48ea-bd65-f927a61c7684", "keyboard"},
+    {"cfa8b69e-5b4a-4cc0-b98b-8ba1a1f3f95a", "mouse"},
+    {"0e0b6031-5213-4934-818b-38d90ced39db", "shutdown"},
+    {"9527e630-d0ae-497b-adce-e80ab0175caf", "timesync"},
+    {"57164f39-9115-4e78-ab55-382f3bd5422d", "heartbeat"},
+    {"a9a0f4e7-5a45-4d96-b827-8a841e8c03e6", "kvp"},
+    {"35fa2e29-ea23-4236-96ae-3a6ebacba440", "vss"},
+    {"34d14be3-dee4-41c8-9ae7-6b174977c192", "fcopy"},
+    {"525074dc-8985-46e2-8057-a307dc18a502", "dynamic-memory"},
+    {"276aacf4-ac15-426c-98dd-7521ad3f01fe", "rdv"},
+    {NULL, NULL}
+};
+
+/* Drivers loaded for VMBus devices and their vsock transports */
+static const char* const g_hypervModules[] = {
+    "hv_vmbus", "hv_netvsc", "hv_storvsc", "hv_utils", "hv_balloon", "hv_sock",
+    "hid_hyperv", "hyperv_keyboard", "hyperv_fb", "hyperv_drm", "pci_hyperv",
+    "uio_hv_generic",
+    NULL
+};
+
+static const struct {
+    const char* Module;
+    const char* Transport;
+} g_vsockTransports[] = {
+    {"hv_sock", "hv_sock"},
+    {"vmw_vsock_virtio_transport", "virtio"},
+    {"vmw_vsock_vmci_transport", "vmci"},
+    {NULL, NULL}
+};
+
+static int OpenDirAt(int dirFd, const char* path)
+{
+    return openat(dirFd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+static int ExistsAt(int dirFd, const char* path)
+{
+    return dirFd >= 0 && faccessat(dirFd, path, F_OK, 0) == 0;
+}
+
+/* Raw bytes of a file, at most size; -1 if it cannot be opened or read */
+static ssize_t ReadRawAt(int dirFd, const char* path, void* buffer, size_t size)
+{
+    ssize_t length;
+    int fd;
+
+    if (dirFd < 0) {
+        return -1;
+    }
+    fd = openat(dirFd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    do {
+        length = read(fd, buffer, size);
+    } while (length < 0 && errno == EINTR);
+    close(fd);
+    return length;
+}
+
+/* A sysfs attribute as a string without the trailing newline; 0 if unreadable */
+static int ReadTextAt(int dirFd, const char* path, char* text, size_t textSize)
+{
+    ssize_t length = ReadRawAt(dirFd, path, text, textSize - 1);
+
+    if (length < 0) {
+        text[0] = '\0';
+        return 0;
+    }
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == ' ')) {
+        length--;
+    }
+    text[length] = '\0';
+    return 1;
+}
+
+static UINT32 ReadUintAt(int dirFd, const char* path)
+{
+    char text[32];
+
+    if (!ReadTextAt(dirFd, path, text, sizeof(text))) {
+        return 0;
+    }
+    return (UINT32)strtoul(text, NULL, 0);
+}
+
+/* "{F8615163-...}" as the bare lower case GUID */
+static void ReadGuidAt(int dirFd, const char* path, char* guid)
+{
+    char text[LINUX_GUID_LEN + 4];
+    const char* p = text;
+    size_t i = 0;
+
+    guid[0] = '\0';
+    if (!ReadTextAt(dirFd, path, text, sizeof(text))) {
+        return;
+    }
+    if (*p == '{') {
+        p++;
+    }
+    for (; *p != '\0' && *p != '}' && i < LINUX_GUID_LEN - 1; p++) {
+        guid[i++] = (*p >= 'A' && *p <= 'Z') ? (char)(*p - 'A' + 'a') : *p;
+    }
+    guid[i] = '\0';
+}
+
+static UINT32 CountEntries(int dirFd, const char* path)
+{
+    struct dirent* entry;
+    UINT32 count = 0;
+    DIR* dir;
+    int fd = OpenDirAt(dirFd, path);
+
+    if (fd < 0) {
+        return 0;
+    }
+    dir = fdopendir(fd);
+    if (dir == NULL) {
+        close(fd);
+        return 0;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static const char* VmbusClassName(const char* classId)
+{
+    int i;
+
+    for (i = 0; g_vmbusClasses[i].ClassId != NULL; i++) {
+        if (strcmp(classId, g_vmbusClasses[i].ClassId) == 0) {
+            return g_vmbusClasses[i].Name;
+        }
+    }
+    return NULL;
+}
+
+/* Class, then instance: readdir order differs between kernels */
+static int CompareVmbusDevices(const void* a, const void* b)
+{
+    const LINUX_VMBUS_DEVICE* left = (const LINUX_VMBUS_DEVICE*)a;
+    const LINUX_VMBUS_DEVICE* right = (const LINUX_VMBUS_DEVICE*)b;
+    int order = strcmp(left->ClassId, right->ClassId);
+
+    return (order != 0) ? order : strcmp(left->DeviceId, right->DeviceId);
+}
+
+static int HasVmbusClass(const LINUX_SCAN* scan, const char* classId)
+{
+    UINT32 i;
+
+    for (i = 0; i < scan->VmbusCount; i++) {
+        if (strcmp(scan->Vmbus[i].ClassId, classId) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * sys/bus/vmbus/devices holds one entry per offered channel. The ring sizes
+ * come from the device's read and write space counters, which add up to the
+ * data size of each ring; older kernels without channels/ have one channel.
+ */
+static void ScanVmbus(int rootFd, PLINUX_SCAN scan)
+{
+    struct dirent* entry;
+    DIR* dir;
+    int busFd = OpenDirAt(rootFd, "sys/bus/vmbus/devices");
+
+    if (busFd < 0) {
+        return;
+    }
+    dir = fdopendir(busFd);
+    if (dir == NULL) {
+        close(busFd);
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL && scan->VmbusCount < LINUX_MAX_VMBUS_DEVICES) {
+        PLINUX_VMBUS_DEVICE device = &scan->Vmbus[scan->VmbusCount];
+        int deviceFd;
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        deviceFd = OpenDirAt(dirfd(dir), entry->d_name);
+        if (deviceFd < 0) {
+            continue;
+        }
+
+        ReadGuidAt(deviceFd, "class_id", device->ClassId);
+        ReadGuidAt(deviceFd, "device_id", device->DeviceId);
+        device->ClassName = VmbusClassName(device->ClassId);
+        device->Channels = CountEntries(deviceFd, "channels");
+        if (device->Channels == 0) {
+            device->Channels = 1;
+        }
+        device->InboundRingSize = ReadUintAt(deviceFd, "in_read_bytes_avail") +
+                                  ReadUintAt(deviceFd, "in_write_bytes_avail");
+        device->OutboundRingSize = ReadUintAt(deviceFd, "out_read_bytes_avail") +
+                                   ReadUintAt(deviceFd, "out_write_bytes_avail");
+        close(deviceFd);
+        scan->VmbusCount++;
+    }
+    closedir(dir);
+
+    if (scan->VmbusCount > 0) {
+        qsort(scan->Vmbus, scan->VmbusCount, sizeof(scan->Vmbus[0]), CompareVmbusDevices);
+        scan->Flags |= HYPERV_DETECTED_DEVICES;
+    }
+}
+
+/*
+ * Built-in drivers with parameters show up in sys/module on any machine the
+ * kernel boots, so only loaded modules (those with an initstate) count.
+ */
+static void ScanModules(int rootFd, PLINUX_SCAN scan)
+{
+    char path[LINUX_NAME_LEN + 16];
+    int moduleFd = OpenDirAt(rootFd, "sys/module");
+    int i;
+
+    if (moduleFd < 0) {
+        return;
+    }
+    for (i = 0; g_hypervModules[i] != NULL && scan->ModuleCount < LINUX_MAX_MODULES; i++) {
+        snprintf(path, sizeof(path), "%s/initstate", g_hypervModules[i]);
+        if (ExistsAt(moduleFd, path)) {
+            snprintf(scan->Modules[scan->ModuleCount++], LINUX_NAME_LEN, "%s", g_hypervModules[i]);
+        }
+    }
+    for (i = 0; g_vsockTransports[i].Module != NULL; i++) {
+        snprintf(path, sizeof(path), "%s/initstate", g_vsockTransports[i].Module);
+        if (ExistsAt(moduleFd, path)) {
+            scan->VsockTransport = g_vsockTransports[i].Transport;
+            break;
+        }
+    }
+    close(moduleFd);
+
+    if (scan->ModuleCount > 0) {
+        scan->Flags |= HYPERV_DETECTED_SERVICES;
+    }
+}
+
+/*
+ * DMI attributes other than the serial numbers and UUIDs are world-readable;
+ * the ACPI tables need root. Only the first 36 bytes (the header) of each
+ * table are read.
+ */
+static void ScanFirmware(int rootFd, PLINUX_SCAN scan)
+{
+    UINT8 header[HV_ACPI_HEADER_SIZE];
+    struct dirent* entry;
+    DIR* dir;
+    int dmiFd = OpenDirAt(rootFd, "sys/class/dmi/id");
+    int acpiFd;
+    int isHyperV = 0;
+
+    if (dmiFd >= 0) {
+        ReadTextAt(dmiFd, "sys_vendor", scan->SysVendor, sizeof(scan->SysVendor));
+        ReadTextAt(dmiFd, "product_name", scan->ProductName, sizeof(scan->ProductName));
+        ReadTextAt(dmiFd, "bios_vendor", scan->BiosVendor, sizeof(scan->BiosVendor));
+        ReadTextAt(dmiFd, "bios_version", scan->BiosVersion, sizeof(scan->BiosVersion));
+        close(dmiFd);
+    }
+    if ((strcmp(scan->SysVendor, HV_BIOS_MANUFACTURER) == 0 && strcmp(scan->ProductName, HV_BIOS_PRODUCT) == 0) ||
+        strstr(scan->BiosVersion, "Hyper-V") != NULL) {
+        scan->Flags |= HYPERV_DETECTED_BIOS;
+    }
+
+    acpiFd = OpenDirAt(rootFd, "sys/firmware/acpi/tables");
+    if (acpiFd < 0) {
+        return;
+    }
+    dir = fdopendir(acpiFd);
+    if (dir == NULL) {
+        close(acpiFd);
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        char oemId[7];
+        const char* vmType;
+
+        /* FACS has no OEM ID; data/ and dynamic/ fail the read */
+        if (entry->d_name[0] == '.' || strcmp(entry->d_name, "FACS") == 0 ||
+            ReadRawAt(dirfd(dir), entry->d_name, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            continue;
+        }
+        HvParseCopyString(oemId, sizeof(oemId), (const char*)header + 10, 6);
+        if (scan->AcpiOemId[0] == '\0') {
+            snprintf(scan->AcpiOemId, sizeof(scan->AcpiOemId), "%s", oemId);
+        }
+        vmType = HvAcpiOemVmType(oemId, &isHyperV);
+        if (vmType != NULL && scan->AcpiVmType == NULL) {
+            scan->AcpiVmType = vmType;
+        }
+        if (isHyperV) {
+            scan->Flags |= HYPERV_DETECTED_BIOS;
+        }
+    }
+    closedir(dir);
+}
+
+/*
+ * The indicators of generation_checks.c as Linux sees them. Every Linux
+ * machine has ttyS0..3 whether or not a UART exists, so HasCOMPorts stays 0.
+ */
+static void ScanGeneration(int rootFd, PLINUX_SCAN scan)
+{
+    PHV_GENERATION_INDICATORS indicators = &scan->Indicators;
+    UINT8 secureBoot[5];
+    int efiFd = OpenDirAt(rootFd, "sys/firmware/efi");
+
+    if (efiFd >= 0) {
+        /* efivarfs: 4 bytes of attributes, then the value */
+        indicators->HasUEFI = 1;
+        indicators->HasSecureBoot = ReadRawAt(efiFd, LINUX_EFI_SECURE_BOOT, secureBoot, sizeof(secureBoot)) ==
+                                    (ssize_t)sizeof(secureBoot) && secureBoot[4] == 1;
+        close(efiFd);
+    }
+    indicators->HasTPM = ExistsAt(rootFd, "sys/class/tpm/tpm0");
+    indicators->HasIDEController = HasVmbusClass(scan, LINUX_CLASS_IDE);
+    indicators->HasSCSIBoot = !indicators->HasIDEController && HasVmbusClass(scan, LINUX_CLASS_SCSI);
+    indicators->HasFloppyController = ExistsAt(rootFd, "sys/block/fd0");
+    indicators->HasLegacyNIC = ExistsAt(rootFd, "sys/bus/pci/drivers/tulip");
+
+    scan->Generation = HvGenerationFromIndicators(indicators);
+}
+
+int LinuxScan(const char* root, HV_CPUID_SOURCE cpuid, void* cpuidContext, UINT32 options,
+              PLINUX_SCAN scan, char* msg, size_t msgSize)
+{
+    int rootFd;
+
+    memset(scan, 0, sizeof(*scan));
+    scan->VsockAvailable = -1;
+
+    rootFd = OpenDirAt(AT_FDCWD, root);
+    if (rootFd < 0) {
+        snprintf(msg, msgSize, "%s: %s", root, strerror(errno));
+        return -1;
+    }
+
+    if (cpuid != NULL) {
+        HvCpuidDecode(cpuid, cpuidContext, &scan->Cpuid);
+    }
+    if (scan->Cpuid.HypervisorPresent) {
+        scan->Flags |= HYPERV_DETECTED_CPUID;
+    }
+
+    ScanVmbus(rootFd, scan);
+    ScanModules(rootFd, scan);
+    ScanFirmware(rootFd, scan);
+    ReadTextAt(rootFd, "sys/hypervisor/type", scan->HypervisorType, sizeof(scan->HypervisorType));
+
+    /* ARM64 guests, or CPUID hidden from the guest: VMBus still says Hyper-V */
+    HvClassifyPartition(&scan->Cpuid, scan->Verdict, sizeof(scan->Verdict));
+    if (!scan->Cpuid.HypervisorPresent && scan->VmbusCount > 0) {
+        snprintf(scan->Verdict, sizeof(scan->Verdict), "HyperV-GuestVM");
+    }
+    if (scan->Cpuid.IsMicrosoftHv || scan->VmbusCount > 0) {
+        ScanGeneration(rootFd, scan);
+    }
+    close(rootFd);
+
+    if (options & LINUX_SCAN_PROBE_VSOCK) {
+        int fd = socket(AF_VSOCK, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        scan->VsockAvailable = (fd >= 0);
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+int LinuxReadCpuidFile(const char* root, HV_CPUID_LEAF* leaves, UINT32 maxLeaves, char* msg, size_t msgSize)
+{
+    FILE* file;
+    char path[512];
+    char line[256];
+    unsigned int lineNumber = 0;
+    unsigned int v[6];
+    UINT32 count = 0;
+    char* p;
+
+    snprintf(path, sizeof(path), "%s/cpuid.txt", root);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '#' || *p == '\r' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        if (sscanf(p, "%x %x %x %x %x %x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) {
+            snprintf(msg, msgSize, "%s:%u: expected 6 hex values", path, lineNumber);
+            fclose(file);
+            return -1;
+        }
+        if (count >= maxLeaves) {
+            snprintf(msg, msgSize, "%s: more than %u leaves", path, maxLeaves);
+            fclose(file);
+            return -1;
+        }
+
+        leaves[count].Leaf = v[0];
+        leaves[count].Subleaf = v[1];
+        leaves[count].Eax = v[2];
+        leaves[count].Ebx = v[3];
+        leaves[count].Ecx = v[4];
+        leaves[count].Edx = v[5];
+        count++;
+    }
+
+    fclose(file);
+    return (int)count;
+}
+
+void LinuxCpuidSource(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4])
+{
+    (void)context;
+#if defined(__i386__) || defined(__x86_64__)
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+    (void)leaf;
+    (void)subleaf;
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
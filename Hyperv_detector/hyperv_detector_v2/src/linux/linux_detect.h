@@ -0,0 +1,94 @@
+/**
+ * linux_detect.h - Hyper-V detection for Linux guests
+ *
+ * Reads what a Linux kernel publishes about the partition it runs in, below
+ * a root directory ("/" on a live system, a captured tree in the tests):
+ *
+ *   sys/bus/vmbus/devices/<id>   class_id, device_id, channels/ and the
+ *                                ring buffer counters          DEVICES
+ *   sys/module/<name>            loaded Hyper-V drivers        SERVICES
+ *   sys/class/dmi/id             sys_vendor, product_name,
+ *                                bios_vendor, bios_version     BIOS
+ *   sys/firmware/acpi/tables     OEM ID of each table header   BIOS
+ *   sys/firmware/efi             UEFI and the SecureBoot
+ *                                variable                      generation
+ *   sys/hypervisor/type          Xen-style hypervisor node     HypervisorType
+ *
+ * plus CPUID through an HV_CPUID_SOURCE (flag CPUID and the verdict, as in
+ * replay.c). The flags use the HYPERV_DETECTED_* values of the Windows
+ * detector, so results from both land in the same fleet store.
+ *
+ * Each directory is opened once and every file below it is opened relative
+ * to that descriptor with openat(), read once into a small stack buffer and
+ * closed. A Hyper-V guest with a dozen VMBus devices costs a few hundred
+ * system calls; files that are missing or unreadable without root (ACPI
+ * tables, efivars) leave their fields empty.
+ */
+
+#pragma once
+#ifndef LINUX_DETECT_H
+#define LINUX_DETECT_H
+
+#include "../common/detection_rules.h"
+
+#define LINUX_MAX_VMBUS_DEVICES     64
+#define LINUX_MAX_MODULES           32
+#define LINUX_NAME_LEN              64
+#define LINUX_GUID_LEN              40
+#define LINUX_MAX_CPUID_LEAVES      64
+
+/* LinuxScan options */
+#define LINUX_SCAN_PROBE_VSOCK      0x01    /* Create an AF_VSOCK socket (live systems only) */
+
+typedef struct _LINUX_VMBUS_DEVICE {
+    char ClassId[LINUX_GUID_LEN];   /* Lower case, without braces */
+    char DeviceId[LINUX_GUID_LEN];
+    const char* ClassName;          /* Kernel driver name, NULL for an unknown class */
+    UINT32 Channels;                /* Primary channel plus subchannels */
+    UINT32 InboundRingSize;         /* Data bytes of each ring, 0 if not readable */
+    UINT32 OutboundRingSize;
+} LINUX_VMBUS_DEVICE, *PLINUX_VMBUS_DEVICE;
+
+typedef struct _LINUX_SCAN {
+    UINT32 Flags;                   /* HYPERV_DETECTED_* */
+    char Verdict[LINUX_NAME_LEN];
+    int Generation;                 /* 0 = unknown or not a Hyper-V guest, 1, 2 */
+    HV_CPUID_INFO Cpuid;
+    HV_GENERATION_INDICATORS Indicators;
+
+    LINUX_VMBUS_DEVICE Vmbus[LINUX_MAX_VMBUS_DEVICES];
+    UINT32 VmbusCount;
+    char Modules[LINUX_MAX_MODULES][LINUX_NAME_LEN];
+    UINT32 ModuleCount;
+
+    char SysVendor[LINUX_NAME_LEN];
+    char ProductName[LINUX_NAME_LEN];
+    char BiosVendor[LINUX_NAME_LEN];
+    char BiosVersion[LINUX_NAME_LEN];
+    char AcpiOemId[8];              /* First table with a readable header */
+    const char* AcpiVmType;         /* HvAcpiOemVmType() of any table, or NULL */
+
+    char HypervisorType[16];        /* "" without sys/hypervisor */
+    const char* VsockTransport;     /* "hv_sock", "virtio", "vmci" or NULL, from sys/module */
+    int VsockAvailable;             /* -1 = not probed, 0, 1 */
+} LINUX_SCAN, *PLINUX_SCAN;
+
+/*
+ * Scan the tree below root. 0 on success, -1 if root cannot be opened (msg
+ * says why). cpuid may be NULL to skip CPUID, e.g. on ARM64, where the VMBus
+ * devices alone decide the verdict.
+ */
+int LinuxScan(const char* root, HV_CPUID_SOURCE cpuid, void* cpuidContext, UINT32 options,
+              PLINUX_SCAN scan, char* msg, size_t msgSize);
+
+/*
+ * Read the leaves captured with a tree from <root>/cpuid.txt, one
+ * "leaf subleaf eax ebx ecx edx" line each in hex as in the fixtures. Number
+ * of leaves read, 0 without the file, -1 on a malformed line (msg says why).
+ */
+int LinuxReadCpuidFile(const char* root, HV_CPUID_LEAF* leaves, UINT32 maxLeaves, char* msg, size_t msgSize);
+
+/* HV_CPUID_SOURCE for the running processor; zeros off x86 */
+void LinuxCpuidSource(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4]);
+
+#endif /* LINUX_DETECT_H */
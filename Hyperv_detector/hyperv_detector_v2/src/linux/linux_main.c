@@ -0,0 +1,231 @@
+/**
+ * linux_main.c - hyperv_detector_linux: Hyper-V detection from a Linux guest
+ *
+ * Runs LinuxScan (linux_detect.h) on the running system or on a captured
+ * tree and prints the result:
+ *
+ *   hyperv_detector_linux [--json] [--vsock] [--no-cpuid] [--root <dir>]
+ *
+ * --json prints the fields hyperv_fleet and hvdiff read from the Windows
+ * detector (detected, flags, verdict, hv_build, vbs, hvci), plus the VMBus
+ * devices. --root scans a copy of /sys, e.g. a fixture under
+ * src/tests/fixtures/linux_*, with CPUID from <root>/cpuid.txt rather than
+ * the processor; without that file CPUID is skipped. The scan time goes to
+ * stderr. Exit code 1 if any flag
+ * is set, 0 if none, 2 on error, as hyperv_detector. Builds on Linux with:
+ *
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=200809L -O2 -Wall -o hyperv_detector_linux \
+ *       src/linux/linux_main.c src/linux/linux_detect.c
+ */
+
+#include "linux_detect.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* GetDetectionFlagName() in main_new.c, indexed by bit */
+static const char* const g_methodNames[] = {
+    "CPUID", "Registry", "Files", "Services", "Devices", "BIOS", "Processes",
+    "Hypercalls", "Windows Objects", "Nested Virtualization", "Windows Sandbox",
+    "Docker", "Removed Hyper-V",
+    NULL
+};
+
+static double NowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+}
+
+static void PrintJsonString(const char* text)
+{
+    putchar('"');
+    for (; *text != '\0'; text++) {
+        unsigned char c = (unsigned char)*text;
+
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static void PrintJson(const LINUX_SCAN* scan, const char* host)
+{
+    UINT32 i;
+    int first = 1;
+
+    printf("{\n");
+    printf("  \"host\": ");
+    PrintJsonString(host);
+    printf(",\n");
+    printf("  \"platform\": \"linux\",\n");
+    printf("  \"detected\": %s,\n", (scan->Flags != 0) ? "true" : "false");
+    printf("  \"flags\": \"0x%08X\",\n", scan->Flags);
+    printf("  \"flags_decimal\": %u,\n", scan->Flags);
+    printf("  \"verdict\": \"%s\",\n", scan->Verdict);
+    if (scan->Cpuid.IsMicrosoftHv) {
+        printf("  \"hv_build\": \"%u\",\n", scan->Cpuid.BuildNumber);
+    }
+    printf("  \"generation\": %d,\n", scan->Generation);
+    printf("  \"vbs\": false,\n");
+    printf("  \"hvci\": false,\n");
+    printf("  \"detection_methods\": [");
+    for (i = 0; g_methodNames[i] != NULL; i++) {
+        if (scan->Flags & (1u << i)) {
+            printf("%s\"%s\"", first ? "" : ", ", g_methodNames[i]);
+            first = 0;
+        }
+    }
+    printf("],\n");
+    printf("  \"modules\": [");
+    for (i = 0; i < scan->ModuleCount; i++) {
+        printf("%s\"%s\"", (i == 0) ? "" : ", ", scan->Modules[i]);
+    }
+    printf("],\n");
+    printf("  \"vmbus\": [");
+    for (i = 0; i < scan->VmbusCount; i++) {
+        const LINUX_VMBUS_DEVICE* device = &scan->Vmbus[i];
+
+        printf("%s\n    {\"class\": \"%s\", \"class_id\": \"%s\", \"device_id\": \"%s\", "
+               "\"channels\": %u, \"in_ring\": %u, \"out_ring\": %u}",
+               (i == 0) ? "" : ",", device->ClassName ? device->ClassName : "unknown",
+               device->ClassId, device->DeviceId, device->Channels,
+               device->InboundRingSize, device->OutboundRingSize);
+    }
+    printf("%s]\n", (scan->VmbusCount > 0) ? "\n  " : "");
+    printf("}\n");
+}
+
+static void PrintText(const LINUX_SCAN* scan)
+{
+    UINT32 i;
+    int bit;
+
+    printf("Verdict:     %s\n", scan->Verdict);
+    printf("Flags:       0x%08X", scan->Flags);
+    for (bit = 0; g_methodNames[bit] != NULL; bit++) {
+        if (scan->Flags & (1u << bit)) {
+            printf(" %s", g_methodNames[bit]);
+        }
+    }
+    printf("\n");
+    if (scan->Cpuid.HypervisorPresent) {
+        printf("Hypervisor:  %s", scan->Cpuid.Vendor);
+        if (scan->Cpuid.IsMicrosoftHv) {
+            printf(", %u.%u build %u", scan->Cpuid.MajorVersion, scan->Cpuid.MinorVersion,
+                   scan->Cpuid.BuildNumber);
+        }
+        printf("\n");
+    }
+    if (scan->HypervisorType[0] != '\0') {
+        printf("sysfs type:  %s\n", scan->HypervisorType);
+    }
+    printf("Generation:  %d\n", scan->Generation);
+    printf("DMI:         %s / %s, BIOS %s %s\n",
+           scan->SysVendor[0] ? scan->SysVendor : "-", scan->ProductName[0] ? scan->ProductName : "-",
+           scan->BiosVendor[0] ? scan->BiosVendor : "-", scan->BiosVersion);
+    printf("ACPI OEM:    %s%s%s\n", scan->AcpiOemId[0] ? scan->AcpiOemId : "- (tables need root)",
+           scan->AcpiVmType ? " -> " : "", scan->AcpiVmType ? scan->AcpiVmType : "");
+    printf("vsock:       %s", scan->VsockTransport ? scan->VsockTransport : "no transport loaded");
+    if (scan->VsockAvailable >= 0) {
+        printf(", AF_VSOCK %s", scan->VsockAvailable ? "available" : "unavailable");
+    }
+    printf("\n");
+
+    printf("Modules:    ");
+    for (i = 0; i < scan->ModuleCount; i++) {
+        printf(" %s", scan->Modules[i]);
+    }
+    printf("%s\n", (scan->ModuleCount == 0) ? " none" : "");
+
+    printf("VMBus devices: %u\n", scan->VmbusCount);
+    for (i = 0; i < scan->VmbusCount; i++) {
+        const LINUX_VMBUS_DEVICE* device = &scan->Vmbus[i];
+
+        printf("  %-15s {%s}  %2u channel(s)  ring in %u / out %u\n",
+               device->ClassName ? device->ClassName : "unknown", device->ClassId,
+               device->Channels, device->InboundRingSize, device->OutboundRingSize);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    LINUX_SCAN* scan;
+    HV_CPUID_LEAF leaves[LINUX_MAX_CPUID_LEAVES];
+    HV_CPUID_TABLE table;
+    HV_CPUID_SOURCE cpuid = LinuxCpuidSource;
+    void* cpuidContext = NULL;
+    const char* root = "/";
+    int rootGiven = 0;
+    UINT32 options = 0;
+    int jsonOutput = 0;
+    int useCpuid = 1;
+    char host[256] = "";
+    char msg[512];
+    double start;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            jsonOutput = 1;
+        } else if (strcmp(argv[i], "--vsock") == 0) {
+            options |= LINUX_SCAN_PROBE_VSOCK;
+        } else if (strcmp(argv[i], "--no-cpuid") == 0) {
+            useCpuid = 0;
+        } else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+            root = argv[++i];
+            rootGiven = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--vsock] [--no-cpuid] [--root <dir>]\n", argv[0]);
+            return (strcmp(argv[i], "--help") == 0) ? 0 : 2;
+        }
+    }
+
+    /* A captured tree brings its own leaves; the processor here is not its */
+    if (!useCpuid) {
+        cpuid = NULL;
+    } else if (rootGiven) {
+        table.Leaves = leaves;
+        table.Count = 0;
+        i = LinuxReadCpuidFile(root, leaves, LINUX_MAX_CPUID_LEAVES, msg, sizeof(msg));
+        if (i < 0) {
+            fprintf(stderr, "%s\n", msg);
+            return 2;
+        }
+        table.Count = (UINT32)i;
+        cpuid = (i > 0) ? HvCpuidTableSource : NULL;
+        cpuidContext = &table;
+    }
+
+    scan = (LINUX_SCAN*)malloc(sizeof(*scan));
+    if (scan == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 2;
+    }
+    start = NowMs();
+    if (LinuxScan(root, cpuid, cpuidContext, options, scan, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "%s\n", msg);
+        free(scan);
+        return 2;
+    }
+    fprintf(stderr, "Scanned %s in %.3f ms\n", root, NowMs() - start);
+
+    if (jsonOutput) {
+        gethostname(host, sizeof(host) - 1);
+        PrintJson(scan, host);
+    } else {
+        PrintText(scan);
+    }
+
+    i = (scan->Flags != 0) ? 1 : 0;
+    free(scan);
+    return i;
+}
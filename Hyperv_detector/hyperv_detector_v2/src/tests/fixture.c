@@ -0,0 +1,547 @@
+/**
+ * fixture.c - Loader for captured detection inputs (see fixture.h)
+ *
+ * Plain stdio only, so the loader builds with the portable tests.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "fixture.h"
+#include "../common/detection_rules.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define FIXTURE_SEP "\\"
+#else
+#define FIXTURE_SEP "/"
+#endif
+
+/*
+ * Read a whole file. A missing file is not an error (empty input).
+ */
+static int ReadFixtureFile(const char* path, UINT8** data, size_t* size, char* msg, size_t msgSize)
+{
+    FILE* file;
+    long length;
+
+    *data = NULL;
+    *size = 0;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        snprintf(msg, msgSize, "Cannot size %s", path);
+        fclose(file);
+        return -1;
+    }
+
+    if (length > 0) {
+        *data = (UINT8*)malloc((size_t)length);
+        if (*data == NULL || fread(*data, 1, (size_t)length, file) != (size_t)length) {
+            snprintf(msg, msgSize, "Cannot read %s", path);
+            free(*data);
+            *data = NULL;
+            fclose(file);
+            return -1;
+        }
+        *size = (size_t)length;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/*
+ * Strip leading and trailing whitespace in place
+ */
+static char* TrimFixtureText(char* text)
+{
+    char* end;
+
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+/*
+ * Next non-empty line with the comment and surrounding whitespace removed.
+ * Returns NULL at end of file.
+ */
+static char* NextFixtureLine(FILE* file, char* line, size_t lineSize, unsigned int* lineNumber)
+{
+    char* comment;
+    char* text;
+
+    while (fgets(line, (int)lineSize, file) != NULL) {
+        (*lineNumber)++;
+        comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        text = TrimFixtureText(line);
+        if (*text != '\0') {
+            return text;
+        }
+    }
+    return NULL;
+}
+
+static int CopyFixtureField(char* dest, size_t destSize, const char* text)
+{
+    if (strlen(text) >= destSize) {
+        return -1;
+    }
+    memcpy(dest, text, strlen(text) + 1);
+    return 0;
+}
+
+/*
+ * Make room for one more element. The files are small, so growing one
+ * element at a time is fine.
+ */
+static void* GrowFixtureArray(void* array, UINT32 count, size_t elementSize)
+{
+    void* grown = realloc(array, ((size_t)count + 1) * elementSize);
+
+    if (grown != NULL) {
+        memset((UINT8*)grown + (size_t)count * elementSize, 0, elementSize);
+    }
+    return grown;
+}
+
+static int ReadCpuidFile(const char* path, PHV_FIXTURE fixture, char* msg, size_t msgSize)
+{
+    FILE* file;
+    char line[256];
+    unsigned int lineNumber = 0;
+    unsigned int v[6];
+    char* p;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    while ((p = NextFixtureLine(file, line, sizeof(line), &lineNumber)) != NULL) {
+        if (sscanf(p, "%x %x %x %x %x %x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) {
+            snprintf(msg, msgSize, "%s:%u: expected 6 hex values", path, lineNumber);
+            fclose(file);
+            return -1;
+        }
+        if (fixture->CpuidCount >= FIXTURE_MAX_CPUID) {
+            snprintf(msg, msgSize, "%s: more than %d leaves", path, FIXTURE_MAX_CPUID);
+            fclose(file);
+            return -1;
+        }
+
+        fixture->Cpuid[fixture->CpuidCount].Leaf = v[0];
+        fixture->Cpuid[fixture->CpuidCount].Subleaf = v[1];
+        fixture->Cpuid[fixture->CpuidCount].Eax = v[2];
+        fixture->Cpuid[fixture->CpuidCount].Ebx = v[3];
+        fixture->Cpuid[fixture->CpuidCount].Ecx = v[4];
+        fixture->Cpuid[fixture->CpuidCount].Edx = v[5];
+        fixture->CpuidCount++;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/*
+ * "<key>" or "<key> : <name> = <data>"
+ */
+static int ParseRegistryLine(char* text, PHV_FIXTURE_REG_VALUE value)
+{
+    char* colon = strchr(text, ':');
+    char* equals;
+    char* key = text;
+    char* name = "";
+    char* data = "";
+    char* end;
+
+    if (colon != NULL) {
+        *colon = '\0';
+        equals = strchr(colon + 1, '=');
+        if (equals == NULL) {
+            return -1;
+        }
+        *equals = '\0';
+        key = TrimFixtureText(text);
+        name = TrimFixtureText(colon + 1);
+        data = TrimFixtureText(equals + 1);
+        if (*name == '\0') {
+            return -1;
+        }
+    }
+    if (HvRuleStartsWithNoCase(key, "HKLM\\")) {
+        key += 5;
+    }
+    if (*key == '\0') {
+        return -1;
+    }
+
+    if (HvRuleStartsWithNoCase(data, "dword:")) {
+        value->IsDword = 1;
+        value->Dword = (UINT32)strtoul(data + 6, &end, 0);
+        if (end == data + 6 || *end != '\0') {
+            return -1;
+        }
+        data = "";
+    }
+
+    if (CopyFixtureField(value->Key, sizeof(value->Key), key) != 0 ||
+        CopyFixtureField(value->Name, sizeof(value->Name), name) != 0 ||
+        CopyFixtureField(value->Data, sizeof(value->Data), data) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * "<instance id> | <service> | <description>"
+ */
+static int ParseDeviceLine(char* text, PHV_FIXTURE_DEVICE device)
+{
+    char* first = strchr(text, '|');
+    char* second = (first != NULL) ? strchr(first + 1, '|') : NULL;
+
+    if (second == NULL || strchr(second + 1, '|') != NULL) {
+        return -1;
+    }
+    *first = '\0';
+    *second = '\0';
+
+    if (CopyFixtureField(device->InstanceId, sizeof(device->InstanceId), TrimFixtureText(text)) != 0 ||
+        CopyFixtureField(device->Service, sizeof(device->Service), TrimFixtureText(first + 1)) != 0 ||
+        CopyFixtureField(device->Description, sizeof(device->Description), TrimFixtureText(second + 1)) != 0 ||
+        device->InstanceId[0] == '\0') {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * expected.txt: "key=value" lines; verdict, flags, generation and vbs are
+ * all required so a fixture cannot silently skip an assertion
+ */
+static int ReadExpectedFile(const char* path, PHV_FIXTURE_EXPECTED expected, char* msg, size_t msgSize)
+{
+    static const char* const keys[] = { "verdict", "flags", "generation", "vbs" };
+    FILE* file;
+    char line[256];
+    unsigned int lineNumber = 0;
+    unsigned int seen = 0;
+    unsigned long number;
+    char* text;
+    char* equals;
+    char* key;
+    char* value;
+    char* end;
+    int i;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    while ((text = NextFixtureLine(file, line, sizeof(line), &lineNumber)) != NULL) {
+        equals = strchr(text, '=');
+        if (equals == NULL) {
+            goto malformed;
+        }
+        *equals = '\0';
+        key = TrimFixtureText(text);
+        value = TrimFixtureText(equals + 1);
+
+        for (i = 0; i < 4 && strcmp(key, keys[i]) != 0; i++) {
+        }
+        if (i == 4) {
+            goto malformed;
+        }
+        seen |= 1u << i;
+
+        if (i == 0) {
+            if (CopyFixtureField(expected->Verdict, sizeof(expected->Verdict), value) != 0) {
+                goto malformed;
+            }
+            continue;
+        }
+        number = strtoul(value, &end, 0);
+        if (end == value || *end != '\0') {
+            goto malformed;
+        }
+        if (i == 1) {
+            expected->Flags = (UINT32)number;
+        } else if (i == 2) {
+            expected->Generation = (int)number;
+        } else {
+            expected->Vbs = (int)number;
+        }
+    }
+    fclose(file);
+
+    for (i = 0; i < 4; i++) {
+        if ((seen & (1u << i)) == 0) {
+            snprintf(msg, msgSize, "%s: missing %s", path, keys[i]);
+            return -1;
+        }
+    }
+    expected->Present = 1;
+    return 0;
+
+malformed:
+    snprintf(msg, msgSize, "%s:%u: malformed line", path, lineNumber);
+    fclose(file);
+    return -1;
+}
+
+/*
+ * Read registry.txt, services.txt or devices.txt. A missing file is not an
+ * error.
+ */
+static int ReadListFile(const char* path, const char* file, PHV_FIXTURE fixture, char* msg, size_t msgSize)
+{
+    FILE* stream;
+    char line[1024];
+    unsigned int lineNumber = 0;
+    char* text;
+    void* grown;
+    int status = 0;
+
+    stream = fopen(path, "r");
+    if (stream == NULL) {
+        return 0;
+    }
+
+    while ((text = NextFixtureLine(stream, line, sizeof(line), &lineNumber)) != NULL) {
+        if (strcmp(file, "registry.txt") == 0) {
+            grown = GrowFixtureArray(fixture->Registry, fixture->RegistryCount, sizeof(HV_FIXTURE_REG_VALUE));
+            if (grown == NULL) {
+                break;
+            }
+            fixture->Registry = (PHV_FIXTURE_REG_VALUE)grown;
+            status = ParseRegistryLine(text, &fixture->Registry[fixture->RegistryCount]);
+            fixture->RegistryCount++;
+        } else if (strcmp(file, "services.txt") == 0) {
+            grown = GrowFixtureArray(fixture->Services, fixture->ServiceCount, sizeof(fixture->Services[0]));
+            if (grown == NULL) {
+                break;
+            }
+            fixture->Services = (char (*)[FIXTURE_NAME_LEN])grown;
+            status = CopyFixtureField(fixture->Services[fixture->ServiceCount], FIXTURE_NAME_LEN, text);
+            fixture->ServiceCount++;
+        } else {
+            grown = GrowFixtureArray(fixture->Devices, fixture->DeviceCount, sizeof(HV_FIXTURE_DEVICE));
+            if (grown == NULL) {
+                break;
+            }
+            fixture->Devices = (PHV_FIXTURE_DEVICE)grown;
+            status = ParseDeviceLine(text, &fixture->Devices[fixture->DeviceCount]);
+            fixture->DeviceCount++;
+        }
+        if (status != 0) {
+            snprintf(msg, msgSize, "%s:%u: malformed line", path, lineNumber);
+            fclose(stream);
+            return -1;
+        }
+    }
+
+    fclose(stream);
+    if (text != NULL) {
+        snprintf(msg, msgSize, "%s: out of memory", path);
+        return -1;
+    }
+    return 0;
+}
+
+int LoadFixture(const char* root, const char* name, PHV_FIXTURE fixture, char* msg, size_t msgSize)
+{
+    static const char* const listFiles[] = { "registry.txt", "services.txt", "devices.txt" };
+    char path[512];
+    size_t i;
+
+    memset(fixture, 0, sizeof(*fixture));
+    snprintf(fixture->Name, sizeof(fixture->Name), "%s", name);
+
+    snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "cpuid.txt", root, name);
+    if (ReadCpuidFile(path, fixture, msg, msgSize) != 0) {
+        goto fail;
+    }
+
+    snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "smbios.bin", root, name);
+    if (ReadFixtureFile(path, &fixture->Smbios, &fixture->SmbiosSize, msg, msgSize) != 0) {
+        goto fail;
+    }
+
+    snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "acpi.bin", root, name);
+    if (ReadFixtureFile(path, &fixture->Acpi, &fixture->AcpiSize, msg, msgSize) != 0) {
+        goto fail;
+    }
+
+    for (i = 0; i < sizeof(listFiles) / sizeof(listFiles[0]); i++) {
+        snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "%s", root, name, listFiles[i]);
+        if (ReadListFile(path, listFiles[i], fixture, msg, msgSize) != 0) {
+            goto fail;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "expected.txt", root, name);
+    if (ReadExpectedFile(path, &fixture->Expected, msg, msgSize) != 0) {
+        goto fail;
+    }
+
+    if (fixture->CpuidCount == 0 && fixture->SmbiosSize == 0 && fixture->AcpiSize == 0 &&
+        fixture->RegistryCount == 0 && fixture->ServiceCount == 0 && fixture->DeviceCount == 0) {
+        snprintf(msg, msgSize, "No fixture inputs in %s" FIXTURE_SEP "%s", root, name);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    FreeFixture(fixture);
+    return -1;
+}
+
+void FreeFixture(PHV_FIXTURE fixture)
+{
+    free(fixture->Smbios);
+    free(fixture->Acpi);
+    free(fixture->Registry);
+    free(fixture->Services);
+    free(fixture->Devices);
+    fixture->Smbios = NULL;
+    fixture->Acpi = NULL;
+    fixture->Registry = NULL;
+    fixture->Services = NULL;
+    fixture->Devices = NULL;
+    fixture->SmbiosSize = 0;
+    fixture->AcpiSize = 0;
+    fixture->RegistryCount = 0;
+    fixture->ServiceCount = 0;
+    fixture->DeviceCount = 0;
+}
+
+const char* FixtureRoot(void)
+{
+    const char* root = getenv("HV_FIXTURES_DIR");
+
+    return (root != NULL && root[0] != '\0') ? root : FIXTURE_DEFAULT_DIR;
+}
+
+int FixtureExists(const char* root, const char* name)
+{
+    char path[512];
+    FILE* file;
+
+    snprintf(path, sizeof(path), "%s" FIXTURE_SEP "%s" FIXTURE_SEP "expected.txt", root, name);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+/*
+ * Name of the immediate subkey of key that entryKey lies under, if any
+ */
+static int ChildKeyName(const char* entryKey, const char* key, char* child, size_t childSize)
+{
+    size_t keyLength = strlen(key);
+    const char* start;
+    const char* end;
+    size_t length;
+
+    if (!HvRuleStartsWithNoCase(entryKey, key) || entryKey[keyLength] != '\\') {
+        return 0;
+    }
+    start = entryKey + keyLength + 1;
+    end = strchr(start, '\\');
+    length = (end != NULL) ? (size_t)(end - start) : strlen(start);
+    if (length == 0 || length >= childSize) {
+        return 0;
+    }
+    memcpy(child, start, length);
+    child[length] = '\0';
+    return 1;
+}
+
+int FixtureRegKeyExists(const HV_FIXTURE* fixture, const char* key)
+{
+    size_t keyLength = strlen(key);
+    UINT32 i;
+
+    for (i = 0; i < fixture->RegistryCount; i++) {
+        const char* entryKey = fixture->Registry[i].Key;
+
+        if (HvRuleStartsWithNoCase(entryKey, key) && (entryKey[keyLength] == '\0' || entryKey[keyLength] == '\\')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const HV_FIXTURE_REG_VALUE* FixtureRegValue(const HV_FIXTURE* fixture, const char* key, const char* name)
+{
+    UINT32 i;
+
+    if (name == NULL) {
+        name = "@";
+    }
+    for (i = 0; i < fixture->RegistryCount; i++) {
+        if (HvRuleEqualsNoCase(fixture->Registry[i].Key, key) && HvRuleEqualsNoCase(fixture->Registry[i].Name, name)) {
+            return &fixture->Registry[i];
+        }
+    }
+    return NULL;
+}
+
+int FixtureRegEnumKey(const HV_FIXTURE* fixture, const char* key, UINT32 index, char* name, size_t nameSize)
+{
+    char child[FIXTURE_TEXT_LEN];
+    char earlier[FIXTURE_TEXT_LEN];
+    UINT32 found = 0;
+    UINT32 i;
+    UINT32 j;
+
+    /* Subkeys in order of first appearance, each once */
+    for (i = 0; i < fixture->RegistryCount; i++) {
+        if (!ChildKeyName(fixture->Registry[i].Key, key, child, sizeof(child))) {
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (ChildKeyName(fixture->Registry[j].Key, key, earlier, sizeof(earlier)) &&
+                HvRuleEqualsNoCase(child, earlier)) {
+                break;
+            }
+        }
+        if (j < i) {
+            continue;
+        }
+        if (found++ == index) {
+            snprintf(name, nameSize, "%s", child);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int FixtureHasService(const HV_FIXTURE* fixture, const char* name)
+{
+    UINT32 i;
+
+    for (i = 0; i < fixture->ServiceCount; i++) {
+        if (HvRuleEqualsNoCase(fixture->Services[i], name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
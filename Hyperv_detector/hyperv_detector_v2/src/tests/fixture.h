@@ -0,0 +1,97 @@
+/**
+ * fixture.h - Captured detection inputs
+ *
+ * A fixture is a directory holding the raw inputs the detectors see on a
+ * real machine:
+ *
+ *   cpuid.txt     One leaf per line: "leaf subleaf eax ebx ecx edx" (hex)
+ *   smbios.bin    GetSystemFirmwareTable('RSMB') output
+ *   acpi.bin      ACPI tables back to back, each with its full header
+ *   registry.txt  HKLM keys and values, one per line:
+ *                   <key>                         key with no values of interest
+ *                   <key> : <name> = <data>       "@" names the default value;
+ *                                                 data is "dword:<n>" or a string
+ *   services.txt  Installed service names, one per line
+ *   devices.txt   Present devices: "<instance id> | <service> | <description>"
+ *   expected.txt  What the detector must report, "key=value" per line:
+ *                   verdict, flags, generation and vbs, all required
+ *
+ * In the text files '#' starts a comment. Missing files load as empty inputs.
+ * Registry keys and service names compare case-insensitively, as on Windows,
+ * and a key exists if it or any of its subkeys is listed. Fixtures live under
+ * src/tests/fixtures.
+ */
+
+#pragma once
+#ifndef FIXTURE_H
+#define FIXTURE_H
+
+#include <stddef.h>
+#include "../common/cpuid_decode.h"
+
+#define FIXTURE_DEFAULT_DIR     "src/tests/fixtures"
+#define FIXTURE_MAX_CPUID       64
+#define FIXTURE_NAME_LEN        64
+#define FIXTURE_TEXT_LEN        256
+
+typedef struct _HV_FIXTURE_REG_VALUE {
+    char Key[FIXTURE_TEXT_LEN];     /* HKLM-relative, no leading "HKLM\" */
+    char Name[FIXTURE_NAME_LEN];    /* "" for a key-only line, "@" for the default value */
+    char Data[FIXTURE_TEXT_LEN];    /* String data ("" for a DWORD) */
+    int IsDword;
+    UINT32 Dword;
+} HV_FIXTURE_REG_VALUE, *PHV_FIXTURE_REG_VALUE;
+
+typedef struct _HV_FIXTURE_DEVICE {
+    char InstanceId[FIXTURE_TEXT_LEN];
+    char Service[FIXTURE_NAME_LEN];
+    char Description[FIXTURE_TEXT_LEN];
+} HV_FIXTURE_DEVICE, *PHV_FIXTURE_DEVICE;
+
+typedef struct _HV_FIXTURE_EXPECTED {
+    int Present;                    /* expected.txt was found */
+    char Verdict[FIXTURE_NAME_LEN];
+    UINT32 Flags;
+    int Generation;
+    int Vbs;
+} HV_FIXTURE_EXPECTED, *PHV_FIXTURE_EXPECTED;
+
+typedef struct _HV_FIXTURE {
+    char Name[FIXTURE_NAME_LEN];
+    HV_CPUID_LEAF Cpuid[FIXTURE_MAX_CPUID];
+    UINT32 CpuidCount;
+    UINT8* Smbios;
+    size_t SmbiosSize;
+    UINT8* Acpi;
+    size_t AcpiSize;
+    PHV_FIXTURE_REG_VALUE Registry;
+    UINT32 RegistryCount;
+    char (*Services)[FIXTURE_NAME_LEN];
+    UINT32 ServiceCount;
+    PHV_FIXTURE_DEVICE Devices;
+    UINT32 DeviceCount;
+    HV_FIXTURE_EXPECTED Expected;
+} HV_FIXTURE, *PHV_FIXTURE;
+
+/* 0 on success; on failure msg describes the first bad file or line */
+int LoadFixture(const char* root, const char* name, PHV_FIXTURE fixture, char* msg, size_t msgSize);
+void FreeFixture(PHV_FIXTURE fixture);
+
+/* Root from HV_FIXTURES_DIR, else FIXTURE_DEFAULT_DIR */
+const char* FixtureRoot(void);
+
+/* 1 if root/name holds a fixture with an expected.txt */
+int FixtureExists(const char* root, const char* name);
+
+/*
+ * Registry lookups, as RegOpenKeyEx / RegQueryValueEx / RegEnumKey see them.
+ * A NULL value name reads the default value; FixtureRegEnumKey returns -1
+ * past the last subkey.
+ */
+int FixtureRegKeyExists(const HV_FIXTURE* fixture, const char* key);
+const HV_FIXTURE_REG_VALUE* FixtureRegValue(const HV_FIXTURE* fixture, const char* key, const char* name);
+int FixtureRegEnumKey(const HV_FIXTURE* fixture, const char* key, UINT32 index, char* name, size_t nameSize);
+
+int FixtureHasService(const HV_FIXTURE* fixture, const char* name);
+
+#endif /* FIXTURE_H */
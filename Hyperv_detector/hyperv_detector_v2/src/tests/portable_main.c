@@ -0,0 +1,36 @@
+/**
+ * portable_main.c - Runner for the portable tests alone
+ *
+ * Builds without the Windows SDK, e.g. on Linux:
+ *
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=200809L -Wall -O2 -o portable_tests \
+ *       src/tests/portable_main.c src/tests/portable_tests.c \
+ *       src/tests/fixture.c src/tests/replay.c src/fleet/fleet_store.c \
+ *       src/diff/snapshot_diff.c src/linux/linux_detect.c
+ *
+ * Accepts the same runner options as hyperv_detector_tests.exe.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "portable_tests.h"
+
+int main(int argc, char* argv[])
+{
+    TEST_RUN_OPTIONS options;
+    int count = CountTestCases(g_portableTestCases);
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [--json] [--jobs <n>] [--isolate] [--retries <n>] [--timeout <s>] [--junit <file>]\n",
+                   argv[0]);
+            return 0;
+        }
+    }
+    if (ParseTestRunOptions(argc, argv, &options) != 0) {
+        return 2;
+    }
+
+    EnableConsoleColors();
+    return RunTestMain(g_portableTestCases, count, &options, "Portable", FALSE, FALSE);
+}
@@ -0,0 +1,1044 @@
+/**
+ * portable_tests.c - Tests that build on any platform
+ *
+ * Only the shared headers under src/common, the fixture replay, the fleet
+ * store and the snapshot diff are used here, so this file must not pull in
+ * Windows headers beyond what test_framework.h selects. The Linux backend
+ * tests are compiled on Linux only.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "portable_tests.h"
+#include "replay.h"
+#include "../fleet/fleet_store.h"
+#include "../diff/snapshot_diff.h"
+#include "../common/latency_histogram.h"
+#include "../common/detection_rules.h"
+#include "../common/firmware_parse.h"
+#include "../common/result_codec.h"
+#ifndef _WIN32
+#include "../linux/linux_detect.h"
+#endif
+
+/* ============================================================================
+ * Driver Protocol Tests
+ * ============================================================================ */
+
+static TEST_RESULT Test_Protocol_BatchCodec(char* msg, size_t msgSize)
+{
+    HV_BATCH_OP ops[3] = {
+        { HV_BATCH_OP_RDMSR, 0, { HV_X64_MSR_HYPERCALL, 0, 0 } },
+        { HV_BATCH_OP_CPUID, 0, { 0x40000003, 1, 0 } },
+        { HV_BATCH_OP_VP_INDEX, 0, { 0, 0, 0 } }
+    };
+    HV_BATCH_OP decodedOps[3] = {0};
+    HV_BATCH_RESULT results[2] = {0};
+    HV_BATCH_RESULT decodedResults[2] = {0};
+    UINT8 buffer[128] = {0};
+    int size = 0;
+    int i = 0;
+    
+    size = HvBatchEncodeRequest(buffer, sizeof(buffer), ops, 3);
+    if (size != (int)HvBatchRequestSize(3) ||
+        HvBatchDecodeRequest(buffer, (size_t)size, decodedOps, 3) != 3 ||
+        memcmp(ops, decodedOps, sizeof(ops)) != 0) {
+        snprintf(msg, msgSize, "Request round trip failed");
+        return TEST_FAIL;
+    }
+    
+    /* Every truncation and an array too small for the count must be rejected */
+    for (i = 0; i < size; i++) {
+        if (HvBatchDecodeRequest(buffer, (size_t)i, decodedOps, 3) >= 0) {
+            snprintf(msg, msgSize, "Truncated request (%d bytes) accepted", i);
+            return TEST_FAIL;
+        }
+    }
+    if (HvBatchDecodeRequest(buffer, (size_t)size, decodedOps, 2) != HV_BATCH_E_COUNT) {
+        snprintf(msg, msgSize, "Oversized count accepted");
+        return TEST_FAIL;
+    }
+    buffer[HV_BATCH_HEADER_SIZE] = 0x7F;
+    if (HvBatchDecodeRequest(buffer, (size_t)size, decodedOps, 3) != HV_BATCH_E_OP) {
+        snprintf(msg, msgSize, "Unknown op type accepted");
+        return TEST_FAIL;
+    }
+    
+    results[0].Type = HV_BATCH_OP_RDMSR;
+    results[0].Value[0] = 0x00001001;
+    results[0].Value[1] = 0x00000002;
+    results[1].Type = HV_BATCH_OP_HYPERCALL;
+    results[1].Status = HV_BATCH_STATUS_HV_ERROR;
+    results[1].Detail = 0xC0000001;
+    size = HvBatchEncodeResponse(buffer, sizeof(buffer), results, 2);
+    if (size != (int)HvBatchResponseSize(2) ||
+        HvBatchDecodeResponse(buffer, (size_t)size, decodedResults, 2) != 2 ||
+        HvBatchResultValue64(&decodedResults[0]) != 0x0000000200001001ULL ||
+        decodedResults[1].Status != HV_BATCH_STATUS_HV_ERROR ||
+        decodedResults[1].Detail != 0xC0000001) {
+        snprintf(msg, msgSize, "Response round trip failed");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Batch codec round trip and rejection: OK");
+    return TEST_PASS;
+}
+
+/*
+ * Simulated processor for the fan-out test: CPUID is the same everywhere,
+ * VP_INDEX returns the processor number and RDMSR faults on processor 2.
+ */
+static void SimulatedFanoutExecute(void* context, UINT32 processor, const HV_BATCH_OP* op, PHV_BATCH_RESULT result)
+{
+    (void)context;
+    memset(result, 0, sizeof(*result));
+    
+    if (op->Type == HV_BATCH_OP_CPUID) {
+        result->Value[1] = 0x7263694D;   /* "Micr" */
+    } else if (op->Type == HV_BATCH_OP_VP_INDEX) {
+        result->Value[0] = processor;
+    } else if (processor == 2) {
+        result->Status = HV_BATCH_STATUS_FAULT;
+        result->Detail = 0xC0000061;     /* STATUS_PRIVILEGE_NOT_HELD */
+    } else {
+        result->Value[0] = 0x1001;
+    }
+}
+
+static TEST_RESULT Test_Protocol_FanoutSimulated(char* msg, size_t msgSize)
+{
+    const UINT32 processors = 6;
+    HV_BATCH_OP ops[3] = {
+        { HV_BATCH_OP_CPUID, 0, { 0x40000000, 0, 0 } },
+        { HV_BATCH_OP_VP_INDEX, 0, { 0, 0, 0 } },
+        { HV_BATCH_OP_RDMSR, 0, { HV_X64_MSR_HYPERCALL, 0, 0 } }
+    };
+    HV_BATCH_OP hypercall = { HV_BATCH_OP_HYPERCALL, 0, { HVCALL_GET_PARTITION_ID, 0, 0 } };
+    HV_FANOUT_SUMMARY summary[3] = {0};
+    HV_BATCH_RESULT cell = {0};
+    size_t size = HvFanoutResponseSize(3, processors);
+    UINT8* matrix = NULL;
+    UINT32 opCount = 0;
+    UINT32 cpuCount = 0;
+    UINT32 cpu = 0;
+    TEST_RESULT res = TEST_PASS;
+    
+    if (HvFanoutValidateOps(&hypercall, 1) != HV_BATCH_E_OP) {
+        snprintf(msg, msgSize, "Hypercall accepted in a fan-out batch");
+        return TEST_FAIL;
+    }
+    
+    matrix = (UINT8*)malloc(size);
+    if (matrix == NULL) {
+        return TEST_ERROR;
+    }
+    
+    /* Processor 4 never runs, as if it went offline before its DPC */
+    HvFanoutBegin(matrix, ops, 3, processors);
+    for (cpu = 0; cpu < processors; cpu++) {
+        if (cpu != 4) {
+            HvFanoutRunProcessor(matrix, ops, 3, cpu, SimulatedFanoutExecute, NULL);
+        }
+    }
+    HvFanoutSummarize(matrix, 3, processors);
+    
+    if (HvFanoutParse(matrix, size, &opCount, &cpuCount) != 0 || opCount != 3 || cpuCount != processors ||
+        HvFanoutParse(matrix, size - 1, &opCount, &cpuCount) != HV_BATCH_E_SHORT) {
+        free(matrix);
+        snprintf(msg, msgSize, "Matrix header invalid");
+        return TEST_FAIL;
+    }
+    
+    HvFanoutGetSummary(matrix, 0, &summary[0]);
+    HvFanoutGetSummary(matrix, 1, &summary[1]);
+    HvFanoutGetSummary(matrix, 2, &summary[2]);
+    HvFanoutGetCell(matrix, opCount, 4, 1, &cell);
+    
+    if (!(summary[0].Flags & HV_FANOUT_UNIFORM) || summary[0].OkCount != 5 || summary[0].FirstFailed != 4 ||
+        (summary[1].Flags & HV_FANOUT_UNIFORM) || summary[1].Type != HV_BATCH_OP_VP_INDEX ||
+        !(summary[2].Flags & HV_FANOUT_UNIFORM) || summary[2].OkCount != 4 || summary[2].FailCount != 2 ||
+        summary[2].FirstFailed != 2 || cell.Status != HV_BATCH_STATUS_NOT_RUN) {
+        res = TEST_FAIL;
+    }
+    
+    free(matrix);
+    snprintf(msg, msgSize, "Fan-out over %u simulated processors: %s", processors,
+             res == TEST_PASS ? "OK" : "WRONG AGGREGATION");
+    return res;
+}
+
+static TEST_RESULT Test_Protocol_LatencyHistogram(char* msg, size_t msgSize)
+{
+    HV_LATENCY_HISTOGRAM merged;
+    PHV_LATENCY_HISTOGRAM cell = NULL;
+    size_t size = HvLatencyResponseSize(2);
+    UINT8* response = NULL;
+    UINT32 processors = 0;
+    UINT32 i = 0;
+    
+    if (HvHistogramBucket(0) != 0 || HvHistogramBucket(1) != 0 || HvHistogramBucket(2) != 1 ||
+        HvHistogramBucket(1023) != 9 || HvHistogramBucket(1024) != 10 || HvHistogramBucket(~0ULL) != 63) {
+        snprintf(msg, msgSize, "Bucket boundaries wrong");
+        return TEST_FAIL;
+    }
+    
+    response = (UINT8*)malloc(size);
+    if (response == NULL) {
+        return TEST_ERROR;
+    }
+    HvLatencyBegin(response, 2, 100);
+    
+    /* CPU 0: 90 exits of ~1500 ticks, 10 outliers of ~40000; CPU 1: 100 of ~1500 */
+    cell = HvLatencyGet(response, 0, HV_LATENCY_PROBE_CPUID_0);
+    for (i = 0; i < 100; i++) {
+        HvHistogramAdd(cell, i < 90 ? 1500 + i : 40000);
+    }
+    cell->Status = HV_BATCH_STATUS_OK;
+    cell = HvLatencyGet(response, 1, HV_LATENCY_PROBE_CPUID_0);
+    for (i = 0; i < 100; i++) {
+        HvHistogramAdd(cell, 1400 + i);
+    }
+    cell->Status = HV_BATCH_STATUS_OK;
+    HvLatencyGet(response, 1, HV_LATENCY_PROBE_FAST_HYPERCALL)->Status = HV_BATCH_STATUS_NOT_SUPPORTED;
+    
+    if (HvLatencyParse(response, size, &processors) != 0 || processors != 2 ||
+        HvLatencyParse(response, size - 1, &processors) != HV_BATCH_E_SHORT) {
+        free(response);
+        snprintf(msg, msgSize, "Response validation failed");
+        return TEST_FAIL;
+    }
+    
+    HvHistogramReset(&merged, HV_LATENCY_PROBE_CPUID_0);
+    HvHistogramMerge(&merged, HvLatencyGet(response, 0, HV_LATENCY_PROBE_CPUID_0));
+    HvHistogramMerge(&merged, HvLatencyGet(response, 1, HV_LATENCY_PROBE_CPUID_0));
+    
+    /* p50/p90 fall in [1024, 2047], p99 in the outlier bucket capped at Max */
+    if (merged.Count != 200 || merged.Min != 1400 || merged.Max != 40000 ||
+        HvHistogramPercentile(&merged, 50) != 2047 || HvHistogramPercentile(&merged, 90) != 2047 ||
+        HvHistogramPercentile(&merged, 99) != 40000 || merged.Status != HV_BATCH_STATUS_OK) {
+        free(response);
+        snprintf(msg, msgSize, "Merge/percentile wrong (p50=%llu p99=%llu)",
+                 (unsigned long long)HvHistogramPercentile(&merged, 50),
+                 (unsigned long long)HvHistogramPercentile(&merged, 99));
+        return TEST_FAIL;
+    }
+    
+    /* A bucket total that disagrees with Count is rejected */
+    HvLatencyGet(response, 1, HV_LATENCY_PROBE_BASELINE)->Buckets[3] = 1;
+    if (HvLatencyParse(response, size, &processors) != HV_BATCH_E_OP) {
+        free(response);
+        snprintf(msg, msgSize, "Corrupted histogram accepted");
+        return TEST_FAIL;
+    }
+    
+    free(response);
+    snprintf(msg, msgSize, "Log2 histogram bucket/merge/percentile: OK");
+    return TEST_PASS;
+}
+
+/* ============================================================================
+ * Fixture Replay Tests
+ * ============================================================================ */
+
+static TEST_RESULT ReplayNamedFixture(const char* name, char* msg, size_t msgSize)
+{
+    HV_FIXTURE fixture;
+    HV_REPLAY_RESULT result;
+    const char* root = FixtureRoot();
+    int status = 0;
+    
+    if (!FixtureExists(root, name)) {
+        snprintf(msg, msgSize, "Fixture %s not found under %s (set HV_FIXTURES_DIR)", name, root);
+        return TEST_SKIP;
+    }
+    if (LoadFixture(root, name, &fixture, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    
+    ReplayFixture(&fixture, &result);
+    status = ReplayCompare(&fixture, &result, msg, msgSize);
+    FreeFixture(&fixture);
+    if (status != 0) {
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "%s, flags 0x%08X, generation %d, VBS %d",
+             result.Verdict, result.Flags, result.Generation, result.Vbs);
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_Replay_Gen1Guest(char* msg, size_t msgSize)
+{
+    return ReplayNamedFixture("hyperv_gen1_guest", msg, msgSize);
+}
+
+static TEST_RESULT Test_Replay_Gen2Guest(char* msg, size_t msgSize)
+{
+    return ReplayNamedFixture("hyperv_gen2_guest", msg, msgSize);
+}
+
+static TEST_RESULT Test_Replay_RootVbs(char* msg, size_t msgSize)
+{
+    return ReplayNamedFixture("hyperv_root_vbs", msg, msgSize);
+}
+
+static TEST_RESULT Test_Replay_Nested(char* msg, size_t msgSize)
+{
+    return ReplayNamedFixture("hyperv_nested", msg, msgSize);
+}
+
+static TEST_RESULT Test_Replay_BareMetal(char* msg, size_t msgSize)
+{
+    return ReplayNamedFixture("bare_metal", msg, msgSize);
+}
+
+static TEST_RESULT Test_Replay_GenerationVote(char* msg, size_t msgSize)
+{
+    HV_GENERATION_INDICATORS indicators;
+    
+    /* No indicators at all still votes Gen1: a missing UEFI counts for it */
+    memset(&indicators, 0, sizeof(indicators));
+    if (HvGenerationFromIndicators(&indicators) != 1) {
+        snprintf(msg, msgSize, "Empty indicator set not Gen1");
+        return TEST_FAIL;
+    }
+    
+    /* UEFI alone ties with the legacy devices of a converted VM */
+    indicators.HasUEFI = 1;
+    indicators.HasIDEController = 1;
+    indicators.HasCOMPorts = 1;
+    if (HvGenerationFromIndicators(&indicators) != 0) {
+        snprintf(msg, msgSize, "UEFI vs IDE+COM tie not reported as unknown");
+        return TEST_FAIL;
+    }
+    
+    indicators.HasSecureBoot = 1;
+    if (HvGenerationFromIndicators(&indicators) != 2) {
+        snprintf(msg, msgSize, "UEFI+Secure Boot not Gen2");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Weighted Gen1/Gen2 vote: OK");
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_Replay_Gen1Devices(char* msg, size_t msgSize)
+{
+    /* PIIX4 binds to intelide; pciide is the generic fallback */
+    if (!HvGen1DeviceMatches(HvGen1IdeController(), "PCIIDE\\IDECHANNEL\\0", "IntelIde") ||
+        !HvGen1DeviceMatches(HvGen1IdeController(), NULL, "pciide")) {
+        snprintf(msg, msgSize, "IDE controller not matched by service");
+        return TEST_FAIL;
+    }
+    
+    /* A device without a driver still matches by hardware ID */
+    if (!HvGen1DeviceMatches(HvGen1IdeController(), "pci\\ven_8086&dev_7111&subsys_00000000&rev_01\\3&0&0", "") ||
+        !HvGen1DeviceMatches(HvGen1LegacyNic(), "PCI\\VEN_1011&DEV_0009&REV_20", NULL)) {
+        snprintf(msg, msgSize, "Emulated device not matched by hardware ID");
+        return TEST_FAIL;
+    }
+    
+    if (HvGen1DeviceMatches(HvGen1FloppyController(), "ACPI\\PNP0501\\1", "Serial") ||
+        HvGen1DeviceMatches(HvGen1IdeController(), "PCI\\VEN_8086&DEV_7110", "msisadrv")) {
+        snprintf(msg, msgSize, "Unrelated device matched");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Gen1 device matcher: OK");
+    return TEST_PASS;
+}
+
+/* ============================================================================
+ * Fleet Aggregator Tests
+ * ============================================================================ */
+
+static TEST_RESULT Test_Fleet_Scanner(char* msg, size_t msgSize)
+{
+    /* Detector banner with a GUID, a pretty-printed result, then NDJSON */
+    static const char input[] =
+        "Device {4D36E968-E325-11CE-BFC1-08002BE10318}\n"
+        "=== JSON OUTPUT ===\n"
+        "{\n"
+        "  \"host\": \"A\\\"{\",\n"
+        "  \"detected\": true,\n"
+        "  \"flags\": \"0x0000021B\",\n"
+        "  \"verdict\": \"HyperV-RootPartition\",\n"
+        "  \"hv_build\": \"10.0.26100\",\n"
+        "  \"vbs\": true,\n"
+        "  \"hvci\": false,\n"
+        "  \"details\": \"C:\\\\x \\u0041\"\n"
+        "}\n"
+        "{\"flags\": \"0x10 junk\", \"vbs\": true}\n"
+        "{\"flags\": 1, \"x\": {\"y\": [\"}\", {}]}, \"hv_build\": null, \"hvci\": 1}\n";
+    const char* cursor = input;
+    const char* end = input + sizeof(input) - 1;
+    FLEET_RECORD record;
+    
+    if (FleetScanRecord(&cursor, end, &record) != FLEET_SCAN_OK ||
+        record.Flags != 0x21B || !record.Detected || !record.Vbs || record.Hvci ||
+        strcmp(record.Verdict, "HyperV-RootPartition") != 0 || strcmp(record.Build, "10.0.26100") != 0) {
+        snprintf(msg, msgSize, "Detector output record not read");
+        return TEST_FAIL;
+    }
+    if (FleetScanRecord(&cursor, end, &record) != FLEET_SCAN_MALFORMED) {
+        snprintf(msg, msgSize, "Non-numeric flags accepted");
+        return TEST_FAIL;
+    }
+    
+    /* Nested values are skipped; detected defaults to flags != 0 */
+    if (FleetScanRecord(&cursor, end, &record) != FLEET_SCAN_OK ||
+        record.Flags != 1 || !record.Detected || record.Vbs || !record.Hvci || record.Build[0] != '\0') {
+        snprintf(msg, msgSize, "NDJSON record with nested values not read");
+        return TEST_FAIL;
+    }
+    if (FleetScanRecord(&cursor, end, &record) != FLEET_SCAN_END) {
+        snprintf(msg, msgSize, "Trailing input not reported as end");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Raw output, escapes, nesting and malformed records: OK");
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_Fleet_Query(char* msg, size_t msgSize)
+{
+    FLEET_STORE store;
+    FLEET_STORE part;
+    FLEET_FILTER filter;
+    FLEET_RECORD record;
+    UINT64 mask[4];
+    UINT32 groups[4] = {0};
+    UINT32 columns[FLEET_COLUMN_COUNT];
+    UINT32 matched;
+    int buildId;
+    TEST_RESULT result = TEST_FAIL;
+    int i;
+    
+    /* 100 rows in one store and 100 merged in at an unaligned row */
+    FleetStoreInit(&store);
+    FleetStoreInit(&part);
+    for (i = 0; i < 200; i++) {
+        memset(&record, 0, sizeof(record));
+        record.Flags = (i % 2) ? HYPERV_DETECTED_CPUID : 0;
+        record.Detected = (record.Flags != 0);
+        record.Vbs = (i % 4 != 0);
+        record.Hvci = (i % 4 == 1);
+        strcpy(record.Build, (i % 3) ? "10.0.26100" : "10.0.20348");
+        strcpy(record.Verdict, (i % 2) ? "HyperV-GuestVM" : "BareMetal");
+        if (FleetStoreAppend((i < 100) ? &store : &part, &record) != 0) {
+            snprintf(msg, msgSize, "Append failed");
+            goto cleanup;
+        }
+    }
+    if (FleetStoreMerge(&store, &part) != 0 || store.RowCount != 200 || store.Builds.Count != 3) {
+        snprintf(msg, msgSize, "Merge failed");
+        goto cleanup;
+    }
+    
+    /* VBS without HVCI is i % 4 == 2 or 3: 100 rows, 34 of them on the i % 3 == 0 build */
+    if (FleetFilterParse(&store, "build=10.0.20348", &filter, msg, msgSize) != 0 || filter.BuildId <= 0) {
+        snprintf(msg, msgSize, "Build not in dictionary");
+        goto cleanup;
+    }
+    buildId = filter.BuildId;
+    if (FleetFilterParse(&store, "vbs,!hvci", &filter, msg, msgSize) != 0) {
+        goto cleanup;
+    }
+    matched = FleetSelect(&store, &filter, mask);
+    FleetGroupCount(&store, mask, FLEET_GROUP_BUILD, groups);
+    if (matched != 100 || groups[0] != 0 || groups[buildId] != 34) {
+        snprintf(msg, msgSize, "vbs,!hvci matched %u rows, %u on the old build", matched, groups[buildId]);
+        goto cleanup;
+    }
+    
+    if (FleetFilterParse(&store, "cpuid,verdict=HyperV-GuestVM", &filter, msg, msgSize) != 0 ||
+        FleetSelect(&store, &filter, mask) != 100) {
+        snprintf(msg, msgSize, "Verdict filter wrong");
+        goto cleanup;
+    }
+    FleetColumnCounts(&store, mask, columns);
+    if (columns[FLEET_COL_DETECTED] != 100 || columns[FLEET_COL_HVCI] != 50 || columns[FLEET_COL_REGISTRY] != 0) {
+        snprintf(msg, msgSize, "Column counts wrong");
+        goto cleanup;
+    }
+    
+    if (FleetFilterParse(&store, "build=6.3.9600", &filter, msg, msgSize) != 0 ||
+        FleetSelect(&store, &filter, mask) != 0) {
+        snprintf(msg, msgSize, "Unknown build matched rows");
+        goto cleanup;
+    }
+    if (FleetFilterParse(&store, "vbs,bogus", &filter, msg, msgSize) == 0) {
+        snprintf(msg, msgSize, "Unknown column accepted");
+        goto cleanup;
+    }
+    
+    snprintf(msg, msgSize, "Bitmap filters, group-by and merge: OK");
+    result = TEST_PASS;
+    
+cleanup:
+    FleetStoreFree(&part);
+    FleetStoreFree(&store);
+    return result;
+}
+
+/* ============================================================================
+ * Snapshot Diff Tests
+ * ============================================================================ */
+
+/* Diff entries counted per section, with the first one kept for messages */
+typedef struct _DIFF_TALLY {
+    int Cpuid;
+    int Smbios;
+    int Acpi;
+    int Registry;
+    int Service;
+    int Device;
+    int Finding;
+    int AcpiBody;
+    int GenerationChanged;
+    HV_DIFF_ENTRY First;
+} DIFF_TALLY;
+
+static void TallyDiffEntry(void* context, const HV_DIFF_ENTRY* entry)
+{
+    DIFF_TALLY* tally = (DIFF_TALLY*)context;
+    
+    if (tally->Cpuid + tally->Smbios + tally->Acpi + tally->Registry +
+        tally->Service + tally->Device + tally->Finding == 0) {
+        tally->First = *entry;
+    }
+    if (strcmp(entry->Section, "cpuid") == 0) {
+        tally->Cpuid++;
+    } else if (strcmp(entry->Section, "smbios") == 0) {
+        tally->Smbios++;
+    } else if (strcmp(entry->Section, "acpi") == 0) {
+        tally->Acpi++;
+        tally->AcpiBody += (strstr(entry->Key, " body @") != NULL);
+    } else if (strcmp(entry->Section, "registry") == 0) {
+        tally->Registry++;
+    } else if (strcmp(entry->Section, "service") == 0) {
+        tally->Service++;
+    } else if (strcmp(entry->Section, "device") == 0) {
+        tally->Device++;
+    } else {
+        tally->Finding++;
+        tally->GenerationChanged |= (strcmp(entry->Key, "generation") == 0 &&
+                                     strcmp(entry->Old, "1") == 0 && strcmp(entry->New, "2") == 0);
+    }
+}
+
+static TEST_RESULT Test_Diff_Fixtures(char* msg, size_t msgSize)
+{
+    HV_FIXTURE gen1;
+    HV_FIXTURE gen2;
+    DIFF_TALLY tally;
+    const char* root = FixtureRoot();
+    TEST_RESULT result = TEST_FAIL;
+    int count = 0;
+    
+    if (!FixtureExists(root, "hyperv_gen1_guest") || !FixtureExists(root, "hyperv_gen2_guest")) {
+        snprintf(msg, msgSize, "Gen1/Gen2 fixtures not found under %s (set HV_FIXTURES_DIR)", root);
+        return TEST_SKIP;
+    }
+    if (LoadFixture(root, "hyperv_gen1_guest", &gen1, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    if (LoadFixture(root, "hyperv_gen2_guest", &gen2, msg, msgSize) != 0) {
+        FreeFixture(&gen1);
+        return TEST_FAIL;
+    }
+    
+    memset(&tally, 0, sizeof(tally));
+    count = SnapshotDiff(&gen1, &gen1, TallyDiffEntry, &tally);
+    if (count != 0) {
+        snprintf(msg, msgSize, "Snapshot differs from itself (%d): %s %s",
+                 count, tally.First.Section, tally.First.Key);
+        goto cleanup;
+    }
+    
+    /* Every section moves between a Gen1 and a Gen2 guest */
+    memset(&tally, 0, sizeof(tally));
+    count = SnapshotDiff(&gen1, &gen2, TallyDiffEntry, &tally);
+    if (count <= 0 || tally.Cpuid == 0 || tally.Smbios == 0 || tally.Acpi == 0 ||
+        tally.Registry == 0 || tally.Service == 0 || tally.Device == 0) {
+        snprintf(msg, msgSize, "Gen1 -> Gen2: %d differences, a section is missing", count);
+        goto cleanup;
+    }
+    if (!tally.GenerationChanged) {
+        snprintf(msg, msgSize, "Gen1 -> Gen2 generation finding not reported");
+        goto cleanup;
+    }
+    
+    snprintf(msg, msgSize, "Gen1 -> Gen2: %d keyed differences", count);
+    result = TEST_PASS;
+    
+cleanup:
+    FreeFixture(&gen2);
+    FreeFixture(&gen1);
+    return result;
+}
+
+/* Registry "(key)" entries: a key added or removed */
+typedef struct _DIFF_KEY_TALLY {
+    int SerialComm;
+    int Tpm;
+} DIFF_KEY_TALLY;
+
+static void TallyDiffKey(void* context, const HV_DIFF_ENTRY* entry)
+{
+    DIFF_KEY_TALLY* tally = (DIFF_KEY_TALLY*)context;
+    
+    if (strcmp(entry->Section, "registry") != 0 ||
+        (strcmp(entry->Old, "(key)") != 0 && strcmp(entry->New, "(key)") != 0)) {
+        return;
+    }
+    tally->SerialComm += (strcmp(entry->Key, "HARDWARE\\DEVICEMAP\\SERIALCOMM") == 0);
+    tally->Tpm += (strcmp(entry->Key, "SYSTEM\\CurrentControlSet\\Enum\\ACPI\\MSFT0101\\1") == 0);
+}
+
+static TEST_RESULT Test_Diff_RegistryKeyPresence(char* msg, size_t msgSize)
+{
+    HV_FIXTURE gen1;
+    HV_FIXTURE gen2;
+    DIFF_KEY_TALLY tally;
+    const char* root = FixtureRoot();
+    TEST_RESULT result = TEST_FAIL;
+    
+    if (!FixtureExists(root, "hyperv_gen1_guest") || !FixtureExists(root, "hyperv_gen2_guest")) {
+        snprintf(msg, msgSize, "Gen1/Gen2 fixtures not found under %s (set HV_FIXTURES_DIR)", root);
+        return TEST_SKIP;
+    }
+    if (LoadFixture(root, "hyperv_gen1_guest", &gen1, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    if (LoadFixture(root, "hyperv_gen2_guest", &gen2, msg, msgSize) != 0) {
+        FreeFixture(&gen1);
+        return TEST_FAIL;
+    }
+    
+    /* Gen2 lists SERIALCOMM as a bare key, Gen1 only through its COM values */
+    if (!FixtureRegKeyExists(&gen1, "HARDWARE\\DEVICEMAP\\SERIALCOMM") ||
+        FixtureRegValue(&gen2, "HARDWARE\\DEVICEMAP\\SERIALCOMM", "") == NULL) {
+        snprintf(msg, msgSize, "Gen1/Gen2 fixtures lack the SERIALCOMM key this test compares");
+        goto cleanup;
+    }
+    
+    /* SERIALCOMM is on both sides; only Gen2 has the TPM key */
+    memset(&tally, 0, sizeof(tally));
+    SnapshotDiff(&gen1, &gen2, TallyDiffKey, &tally);
+    SnapshotDiff(&gen2, &gen1, TallyDiffKey, &tally);
+    if (tally.SerialComm != 0 || tally.Tpm != 2) {
+        snprintf(msg, msgSize, "Expected 0 SERIALCOMM and 2 TPM key entries; got %d/%d",
+                 tally.SerialComm, tally.Tpm);
+        goto cleanup;
+    }
+    
+    snprintf(msg, msgSize, "Keys implied by their values are not reported: OK");
+    result = TEST_PASS;
+    
+cleanup:
+    FreeFixture(&gen2);
+    FreeFixture(&gen1);
+    return result;
+}
+
+static TEST_RESULT Test_Diff_SingleChanges(char* msg, size_t msgSize)
+{
+    HV_FIXTURE before;
+    HV_FIXTURE after;
+    HV_FIXTURE_REG_VALUE* value = NULL;
+    DIFF_TALLY tally;
+    const char* root = FixtureRoot();
+    TEST_RESULT result = TEST_FAIL;
+    int count = 0;
+    
+    if (!FixtureExists(root, "hyperv_gen2_guest")) {
+        snprintf(msg, msgSize, "Fixture hyperv_gen2_guest not found under %s (set HV_FIXTURES_DIR)", root);
+        return TEST_SKIP;
+    }
+    if (LoadFixture(root, "hyperv_gen2_guest", &before, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    if (LoadFixture(root, "hyperv_gen2_guest", &after, msg, msgSize) != 0) {
+        FreeFixture(&before);
+        return TEST_FAIL;
+    }
+    
+    /* One registry value, one service renamed, one byte past an ACPI header */
+    value = (HV_FIXTURE_REG_VALUE*)FixtureRegValue(&after,
+        "SOFTWARE\\Microsoft\\Virtual Machine\\Guest\\Parameters", "VirtualMachineName");
+    if (value == NULL || after.ServiceCount == 0 || after.AcpiSize <= HV_ACPI_HEADER_SIZE) {
+        snprintf(msg, msgSize, "Gen2 fixture lacks the values this test edits");
+        goto cleanup;
+    }
+    snprintf(value->Data, sizeof(value->Data), "W11-GEN2-RENAMED");
+    snprintf(after.Services[after.ServiceCount - 1], FIXTURE_NAME_LEN, "hvdiff_test");
+    after.Acpi[HV_ACPI_HEADER_SIZE] ^= 0x5A;
+    
+    memset(&tally, 0, sizeof(tally));
+    count = SnapshotDiff(&before, &after, TallyDiffEntry, &tally);
+    if (tally.Registry != 1 || tally.Service != 2 || tally.Acpi != 1 || tally.AcpiBody != 1 ||
+        tally.Cpuid + tally.Smbios + tally.Device != 0) {
+        snprintf(msg, msgSize, "Expected 1 registry, 2 service, 1 ACPI body entries; got %d/%d/%d (%d total)",
+                 tally.Registry, tally.Service, tally.Acpi, count);
+        goto cleanup;
+    }
+    
+    snprintf(msg, msgSize, "Registry, service and ACPI body edits keyed: OK");
+    result = TEST_PASS;
+    
+cleanup:
+    FreeFixture(&after);
+    FreeFixture(&before);
+    return result;
+}
+
+/* ============================================================================
+ * Binary Result Codec Tests
+ * ============================================================================ */
+
+/* Record used by both codec tests: every field type, details and timings */
+static int EncodeTestRecord(UINT8* buffer, size_t size)
+{
+    static HV_RESULT_WRITER writer;
+    
+    HvResultWriterInit(&writer, 0x00400207);
+    HvResultAddUint(&writer, HV_RESULT_KEY_TOOL_VERSION, 0x020000);
+    HvResultAddString(&writer, HV_RESULT_KEY_HOST, "HV-GUEST-01", 11);
+    HvResultAddUint(&writer, HV_RESULT_KEY_PROCESS_ID, 300000);
+    HvResultAddBool(&writer, HV_RESULT_KEY_VBS, 1);
+    HvResultAddBool(&writer, HV_RESULT_KEY_HVCI, 0);
+    HvResultAddNamed(&writer, "Registry", 8, "Found key A", 11);
+    HvResultAddNamed(&writer, "Registry", 8, "Found key B", 11);
+    HvResultAddTiming(&writer, "cpuid", 12);
+    HvResultAddTiming(&writer, "registry", 1u << 20);
+    return HvResultEncode(&writer, buffer, size);
+}
+
+static TEST_RESULT Test_ResultCodec_RoundTrip(char* msg, size_t msgSize)
+{
+    static HV_RESULT_VIEW view;
+    HV_RESULT_CURSOR cursor;
+    HV_RESULT_FIELD field;
+    HV_RESULT_TIMING timing;
+    UINT8 buffer[512];
+    UINT64 keySum = 0;
+    int size = 0;
+    int named = 0;
+    
+    size = EncodeTestRecord(buffer, sizeof(buffer));
+    if (size <= 0 || HvResultParse(buffer, (size_t)size, &view) != size) {
+        snprintf(msg, msgSize, "Encode/parse failed (%d)", size);
+        return TEST_FAIL;
+    }
+    if (view.DetectionFlags != 0x00400207 || view.FieldCount != 7 || view.TimingCount != 2 ||
+        view.StringCount != 6) {
+        snprintf(msg, msgSize, "Header counts wrong: %u fields, %u timings, %u strings",
+                 view.FieldCount, view.TimingCount, view.StringCount);
+        return TEST_FAIL;
+    }
+    
+    /* "Registry" is stored once and names both detail fields */
+    HvResultFields(&view, &cursor);
+    while (HvResultNextField(&view, &cursor, &field)) {
+        keySum += field.Key;
+        if (field.Key == HV_RESULT_KEY_PROCESS_ID && field.Value != 300000) {
+            snprintf(msg, msgSize, "process_id decoded as %llu", (unsigned long long)field.Value);
+            return TEST_FAIL;
+        }
+        if (field.Key == HV_RESULT_KEY_VBS && field.Value != 1) {
+            snprintf(msg, msgSize, "vbs not true");
+            return TEST_FAIL;
+        }
+        if (field.Key >= HV_RESULT_KEY_NAMED) {
+            if (field.Name.Length != 8 || memcmp(field.Name.Data, "Registry", 8) != 0 ||
+                field.Text.Length != 11 || field.Text.Data < (const char*)buffer ||
+                field.Text.Data >= (const char*)buffer + size) {
+                snprintf(msg, msgSize, "Named field not decoded in place");
+                return TEST_FAIL;
+            }
+            named++;
+        }
+    }
+    HvResultTimings(&view, &cursor);
+    if (!HvResultNextTiming(&view, &cursor, &timing) || timing.Microseconds != 12 ||
+        !HvResultNextTiming(&view, &cursor, &timing) || timing.Microseconds != (1u << 20) ||
+        timing.Name.Length != 8 || HvResultNextTiming(&view, &cursor, &timing)) {
+        snprintf(msg, msgSize, "Timings not decoded");
+        return TEST_FAIL;
+    }
+    if (named != 2 || keySum != 1 + 2 + 3 + 7 + 8 + 2 * (HV_RESULT_KEY_NAMED + 1)) {
+        snprintf(msg, msgSize, "Fields not decoded (%d named)", named);
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "%d-byte record with details and timings: OK", size);
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_ResultCodec_Rejects(char* msg, size_t msgSize)
+{
+    static HV_RESULT_VIEW view;
+    UINT8 buffer[512];
+    UINT8 copy[512];
+    int size = 0;
+    int status = 0;
+    int i = 0;
+    
+    size = EncodeTestRecord(buffer, sizeof(buffer));
+    if (size <= 0 || EncodeTestRecord(buffer, 16) != HV_RESULT_E_SHORT) {
+        snprintf(msg, msgSize, "Encoder did not report a short buffer");
+        return TEST_FAIL;
+    }
+    
+    for (i = 0; i < size; i++) {
+        if ((status = HvResultParse(buffer, (size_t)i, &view)) != HV_RESULT_E_SHORT) {
+            snprintf(msg, msgSize, "Truncated to %d bytes: %d, not HV_RESULT_E_SHORT", i, status);
+            return TEST_FAIL;
+        }
+    }
+    
+    memcpy(copy, buffer, (size_t)size);
+    copy[0] = 'X';
+    if (HvResultParse(copy, (size_t)size, &view) != HV_RESULT_E_MAGIC) {
+        snprintf(msg, msgSize, "Bad magic accepted");
+        return TEST_FAIL;
+    }
+    
+    /* Another version is rejected but can still be stepped over */
+    memcpy(copy, buffer, (size_t)size);
+    copy[2] = HV_RESULT_VERSION + 1;
+    if (HvResultParse(copy, (size_t)size, &view) != HV_RESULT_E_VERSION ||
+        HvResultRecordSize(copy, (size_t)size) != size) {
+        snprintf(msg, msgSize, "Future version not skippable");
+        return TEST_FAIL;
+    }
+    
+    /* The last timing names string 5 ("registry"); point it past the table */
+    memcpy(copy, buffer, (size_t)size);
+    for (i = size - 1; i > 0 && copy[i] != 5; i--) {
+    }
+    copy[i] = 6;
+    if (HvResultParse(copy, (size_t)size, &view) != HV_RESULT_E_CORRUPT) {
+        snprintf(msg, msgSize, "Out-of-range string index accepted");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Truncation, magic, version and index checks: OK");
+    return TEST_PASS;
+}
+
+/* tools/hvresult.py decodes the same file in its tests */
+static TEST_RESULT Test_ResultCodec_Golden(char* msg, size_t msgSize)
+{
+    UINT8 buffer[512];
+    UINT8 golden[512];
+    char path[512];
+    FILE* file;
+    size_t length = 0;
+    int size = 0;
+    
+    snprintf(path, sizeof(path), "%s/results/record_v1.bin", FixtureRoot());
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        snprintf(msg, msgSize, "%s not found (set HV_FIXTURES_DIR)", path);
+        return TEST_SKIP;
+    }
+    length = fread(golden, 1, sizeof(golden), file);
+    fclose(file);
+    
+    size = EncodeTestRecord(buffer, sizeof(buffer));
+    if (size <= 0 || (size_t)size != length || memcmp(buffer, golden, length) != 0) {
+        snprintf(msg, msgSize, "Encoder output (%d bytes) differs from %s (%u bytes)", size, path, (unsigned)length);
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "%u-byte record matches results/record_v1.bin: OK", (unsigned)length);
+    return TEST_PASS;
+}
+
+#ifndef _WIN32
+/* ============================================================================
+ * Linux Backend Tests
+ * ============================================================================ */
+
+/* The fixture directory doubles as the scanned root; cpuid.txt feeds CPUID as with --root */
+static TEST_RESULT LinuxScanFixture(const char* name, PLINUX_SCAN scan, char* msg, size_t msgSize)
+{
+    HV_FIXTURE fixture;
+    HV_CPUID_LEAF leaves[LINUX_MAX_CPUID_LEAVES];
+    HV_CPUID_TABLE table;
+    int leafCount = 0;
+    const char* root = FixtureRoot();
+    char path[512];
+    int status = 0;
+    
+    if (!FixtureExists(root, name)) {
+        snprintf(msg, msgSize, "Fixture %s not found under %s (set HV_FIXTURES_DIR)", name, root);
+        return TEST_SKIP;
+    }
+    if (LoadFixture(root, name, &fixture, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    leafCount = LinuxReadCpuidFile(path, leaves, LINUX_MAX_CPUID_LEAVES, msg, msgSize);
+    if (leafCount != (int)fixture.CpuidCount) {
+        if (leafCount >= 0) {
+            snprintf(msg, msgSize, "%s: %d CPUID leaves read, fixture has %u", name, leafCount,
+                     fixture.CpuidCount);
+        }
+        FreeFixture(&fixture);
+        return TEST_FAIL;
+    }
+    table.Leaves = leaves;
+    table.Count = (UINT32)leafCount;
+    status = LinuxScan(path, HvCpuidTableSource, &table, 0, scan, msg, msgSize);
+    if (status == 0 && strcmp(scan->Verdict, fixture.Expected.Verdict) != 0) {
+        snprintf(msg, msgSize, "%s: verdict %s, expected %s", name, scan->Verdict, fixture.Expected.Verdict);
+        status = -1;
+    } else if (status == 0 && scan->Flags != fixture.Expected.Flags) {
+        snprintf(msg, msgSize, "%s: flags 0x%08X, expected 0x%08X", name, scan->Flags, fixture.Expected.Flags);
+        status = -1;
+    } else if (status == 0 && scan->Generation != fixture.Expected.Generation) {
+        snprintf(msg, msgSize, "%s: generation %d, expected %d", name, scan->Generation,
+                 fixture.Expected.Generation);
+        status = -1;
+    }
+    FreeFixture(&fixture);
+    return (status == 0) ? TEST_PASS : TEST_FAIL;
+}
+
+static const LINUX_VMBUS_DEVICE* FindVmbusClass(const LINUX_SCAN* scan, const char* className)
+{
+    UINT32 i;
+    
+    for (i = 0; i < scan->VmbusCount; i++) {
+        if (scan->Vmbus[i].ClassName != NULL && strcmp(scan->Vmbus[i].ClassName, className) == 0) {
+            return &scan->Vmbus[i];
+        }
+    }
+    return NULL;
+}
+
+static TEST_RESULT Test_Linux_Fixtures(char* msg, size_t msgSize)
+{
+    static LINUX_SCAN scan;
+    const LINUX_VMBUS_DEVICE* network = NULL;
+    TEST_RESULT result;
+    
+    if ((result = LinuxScanFixture("linux_hyperv_gen1", &scan, msg, msgSize)) != TEST_PASS) {
+        return result;
+    }
+    if (FindVmbusClass(&scan, "ide") == NULL || !scan.Indicators.HasFloppyController ||
+        !scan.Indicators.HasLegacyNIC || scan.VsockTransport != NULL) {
+        snprintf(msg, msgSize, "Gen1 indicators not read");
+        return TEST_FAIL;
+    }
+    
+    if ((result = LinuxScanFixture("linux_hyperv_gen2", &scan, msg, msgSize)) != TEST_PASS) {
+        return result;
+    }
+    network = FindVmbusClass(&scan, "network");
+    if (scan.VmbusCount != 13 || network == NULL || network->Channels != 4 ||
+        network->InboundRingSize != 520192 || network->OutboundRingSize != 520192) {
+        snprintf(msg, msgSize, "Gen2 VMBus devices not read (%u)", scan.VmbusCount);
+        return TEST_FAIL;
+    }
+    if (!scan.Indicators.HasSecureBoot || !scan.Indicators.HasTPM || !scan.Indicators.HasSCSIBoot ||
+        scan.VsockTransport == NULL || strcmp(scan.VsockTransport, "hv_sock") != 0) {
+        snprintf(msg, msgSize, "Gen2 Secure Boot, TPM or hv_sock not read");
+        return TEST_FAIL;
+    }
+    /* hv_vmbus is built in there: it has parameters but no initstate */
+    if (scan.ModuleCount != 8 || strcmp(scan.Modules[0], "hv_netvsc") != 0) {
+        snprintf(msg, msgSize, "Gen2 modules: %u", scan.ModuleCount);
+        return TEST_FAIL;
+    }
+    
+    if ((result = LinuxScanFixture("linux_kvm_guest", &scan, msg, msgSize)) != TEST_PASS) {
+        return result;
+    }
+    if (scan.AcpiVmType == NULL || strcmp(scan.AcpiVmType, "Bochs") != 0 ||
+        scan.VsockTransport == NULL || strcmp(scan.VsockTransport, "virtio") != 0) {
+        snprintf(msg, msgSize, "KVM ACPI OEM or vsock transport not read");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Gen1, Gen2 and KVM sysfs trees: OK");
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_Linux_MissingInputs(char* msg, size_t msgSize)
+{
+    static LINUX_SCAN scan;
+    const char* root = FixtureRoot();
+    char path[512];
+    
+    /* A Windows fixture has no sys/ at all */
+    if (!FixtureExists(root, "bare_metal")) {
+        snprintf(msg, msgSize, "Fixture bare_metal not found under %s (set HV_FIXTURES_DIR)", root);
+        return TEST_SKIP;
+    }
+    snprintf(path, sizeof(path), "%s/bare_metal", root);
+    if (LinuxScan(path, NULL, NULL, 0, &scan, msg, msgSize) != 0) {
+        return TEST_FAIL;
+    }
+    if (scan.Flags != 0 || strcmp(scan.Verdict, "BareMetal") != 0 || scan.Generation != 0 ||
+        scan.SysVendor[0] != '\0' || scan.VsockAvailable != -1) {
+        snprintf(msg, msgSize, "Empty tree reported flags 0x%08X, %s", scan.Flags, scan.Verdict);
+        return TEST_FAIL;
+    }
+    
+    snprintf(path, sizeof(path), "%s/no_such_fixture", root);
+    if (LinuxScan(path, NULL, NULL, 0, &scan, msg, msgSize) == 0) {
+        snprintf(msg, msgSize, "Missing root accepted");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Empty tree and missing root: OK");
+    return TEST_PASS;
+}
+#endif
+
+/* ============================================================================
+ * Test Registration
+ * ============================================================================ */
+
+const TEST_CASE g_portableTestCases[] = {
+    /* Driver Protocol Tests */
+    {"Batch IOCTL Codec", "DriverProtocol", Test_Protocol_BatchCodec, FALSE, FALSE},
+    {"Per-Processor Fan-out", "DriverProtocol", Test_Protocol_FanoutSimulated, FALSE, FALSE},
+    {"Exit Latency Histogram", "DriverProtocol", Test_Protocol_LatencyHistogram, FALSE, FALSE},
+    
+    /* Fixture Replay Tests */
+    {"Replay Gen1 Guest", "Replay", Test_Replay_Gen1Guest, FALSE, FALSE},
+    {"Replay Gen2 Guest", "Replay", Test_Replay_Gen2Guest, FALSE, FALSE},
+    {"Replay Root Partition with VBS", "Replay", Test_Replay_RootVbs, FALSE, FALSE},
+    {"Replay Nested Hyper-V", "Replay", Test_Replay_Nested, FALSE, FALSE},
+    {"Replay Bare Metal", "Replay", Test_Replay_BareMetal, FALSE, FALSE},
+    {"Generation Vote", "Replay", Test_Replay_GenerationVote, FALSE, FALSE},
+    {"Gen1 Device Matcher", "Replay", Test_Replay_Gen1Devices, FALSE, FALSE},
+    
+    /* Fleet Aggregator Tests */
+    {"Fleet Result Scanner", "Fleet", Test_Fleet_Scanner, FALSE, FALSE},
+    {"Fleet Columnar Queries", "Fleet", Test_Fleet_Query, FALSE, FALSE},
+    
+    /* Snapshot Diff Tests */
+    {"Diff Gen1 vs Gen2 Snapshots", "Diff", Test_Diff_Fixtures, FALSE, FALSE},
+    {"Diff Single Edits", "Diff", Test_Diff_SingleChanges, FALSE, FALSE},
+    {"Diff Registry Key Presence", "Diff", Test_Diff_RegistryKeyPresence, FALSE, FALSE},
+    
+    /* Binary Result Codec Tests */
+    {"Binary Result Round Trip", "ResultCodec", Test_ResultCodec_RoundTrip, FALSE, FALSE},
+    {"Binary Result Rejects Corruption", "ResultCodec", Test_ResultCodec_Rejects, FALSE, FALSE},
+    {"Binary Result Golden File", "ResultCodec", Test_ResultCodec_Golden, FALSE, FALSE},
+    
+#ifndef _WIN32
+    /* Linux Backend Tests */
+    {"Linux sysfs Fixtures", "Linux", Test_Linux_Fixtures, FALSE, FALSE},
+    {"Linux Missing Inputs", "Linux", Test_Linux_MissingInputs, FALSE, FALSE},
+    
+#endif
+    /* End marker */
+    {NULL, NULL, NULL, FALSE, FALSE}
+};
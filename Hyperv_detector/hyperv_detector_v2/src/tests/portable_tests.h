@@ -0,0 +1,21 @@
+/**
+ * portable_tests.h - Tests that build on any platform
+ *
+ * These cover code shared with the driver (batch codec, fan-out matrix,
+ * latency histograms), the detection rules replayed over captured
+ * fixtures, the fleet result store, the snapshot diff and the binary result
+ * codec, and need neither Windows nor a hypervisor. The Windows test binary
+ * runs them after its own table; portable_main.c runs them alone so they can
+ * be built and run on Linux, where the Linux backend tests are added.
+ */
+
+#pragma once
+#ifndef PORTABLE_TESTS_H
+#define PORTABLE_TESTS_H
+
+#include "test_framework.h"
+
+/* NULL-terminated like g_testCases */
+extern const TEST_CASE g_portableTestCases[];
+
+#endif /* PORTABLE_TESTS_H */
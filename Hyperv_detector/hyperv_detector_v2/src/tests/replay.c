@@ -0,0 +1,266 @@
+/**
+ * replay.c - Detection replayed over a captured fixture (see replay.h)
+ *
+ * Each function mirrors the live check named in its comment: same inputs,
+ * same order of fallbacks, same rule from detection_rules.h.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "replay.h"
+#include "../common/detection_rules.h"
+
+static int ReadDword(const HV_FIXTURE* fixture, const char* key, const char* name, UINT32* value)
+{
+    const HV_FIXTURE_REG_VALUE* entry = FixtureRegValue(fixture, key, name);
+
+    if (entry == NULL || !entry->IsDword) {
+        return 0;
+    }
+    *value = entry->Dword;
+    return 1;
+}
+
+static const char* ReadString(const HV_FIXTURE* fixture, const char* key, const char* name)
+{
+    const HV_FIXTURE_REG_VALUE* entry = FixtureRegValue(fixture, key, name);
+
+    return (entry == NULL || entry->IsDword) ? NULL : entry->Data;
+}
+
+/*
+ * CheckRegistryHyperV
+ */
+static UINT32 ReplayRegistry(const HV_FIXTURE* fixture)
+{
+    const char* const* keys = HvRegistryKeys();
+    const char* const* valueKeys = HvRegistryValueKeys();
+    const char* data;
+    int i;
+
+    for (i = 0; keys[i] != NULL; i++) {
+        if (FixtureRegKeyExists(fixture, keys[i])) {
+            return HYPERV_DETECTED_REGISTRY;
+        }
+    }
+    for (i = 0; valueKeys[i] != NULL; i++) {
+        data = ReadString(fixture, valueKeys[i], NULL);
+        if (data != NULL && HvRegistryValueIsHyperV(data)) {
+            return HYPERV_DETECTED_REGISTRY;
+        }
+    }
+    if (FixtureRegKeyExists(fixture, HV_REG_KEY_VMMEM) || FixtureRegKeyExists(fixture, HV_REG_KEY_DOCKER_DESKTOP)) {
+        return HYPERV_DETECTED_REGISTRY;
+    }
+    return 0;
+}
+
+/*
+ * CheckServicesHyperV
+ */
+static UINT32 ReplayServices(const HV_FIXTURE* fixture)
+{
+    const char* const* services = HvServiceNames();
+    int i;
+
+    for (i = 0; services[i] != NULL; i++) {
+        if (FixtureHasService(fixture, services[i])) {
+            return HYPERV_DETECTED_SERVICES;
+        }
+    }
+    return 0;
+}
+
+/*
+ * CheckDevicesHyperV. \\.\vmbus opens only when the VMBus root device
+ * (ROOT\VMBUS) is present, which the ID table already covers.
+ */
+static UINT32 ReplayDevices(const HV_FIXTURE* fixture)
+{
+    const char* const* ids = HvDeviceIdPrefixes();
+    const HV_FIXTURE_DEVICE* device;
+    UINT32 i;
+    int j;
+
+    for (i = 0; i < fixture->DeviceCount; i++) {
+        device = &fixture->Devices[i];
+        for (j = 0; ids[j] != NULL; j++) {
+            if (HvRuleStartsWithNoCase(device->InstanceId, ids[j])) {
+                return HYPERV_DETECTED_DEVICES;
+            }
+        }
+        if (HvRuleMatch(device->Description, HvDeviceNames()) >= 0) {
+            return HYPERV_DETECTED_DEVICES;
+        }
+    }
+    return 0;
+}
+
+/*
+ * CheckBiosHyperV
+ */
+static UINT32 ReplayBios(const HV_FIXTURE* fixture)
+{
+    const char* data;
+    char name[FIXTURE_TEXT_LEN];
+    UINT32 index;
+
+    data = ReadString(fixture, HV_REG_KEY_BIOS, "BIOSVendor");
+    if (data != NULL && HvRuleMatch(data, HvBiosStrings()) >= 0) {
+        return HYPERV_DETECTED_BIOS;
+    }
+    data = ReadString(fixture, HV_REG_KEY_BIOS, "BIOSVersion");
+    if (data != NULL && HvRuleMatch(data, HvBiosStrings()) >= 0) {
+        return HYPERV_DETECTED_BIOS;
+    }
+    data = ReadString(fixture, HV_REG_KEY_BIOS, "SystemManufacturer");
+    if (data != NULL && strstr(data, HV_BIOS_MANUFACTURER) != NULL) {
+        return HYPERV_DETECTED_BIOS;
+    }
+    data = ReadString(fixture, HV_REG_KEY_BIOS, "SystemProductName");
+    if (data != NULL && strstr(data, HV_BIOS_PRODUCT) != NULL) {
+        return HYPERV_DETECTED_BIOS;
+    }
+
+    for (index = 0; FixtureRegEnumKey(fixture, HV_REG_KEY_ACPI_DSDT, index, name, sizeof(name)) == 0; index++) {
+        if (HvDsdtKeyIsHyperV(name)) {
+            return HYPERV_DETECTED_BIOS;
+        }
+    }
+    return 0;
+}
+
+/*
+ * CheckNestedHyperV
+ */
+static UINT32 ReplayNested(const HV_FIXTURE* fixture)
+{
+    UINT32 value;
+
+    if (ReadDword(fixture, HV_REG_KEY_DEVICEGUARD, HV_REG_VALUE_VBS, &value) && value != 0) {
+        return HYPERV_DETECTED_NESTED;
+    }
+    if (ReadDword(fixture, HV_REG_KEY_VIRTUALIZATION, HV_REG_VALUE_NESTED, &value) && value != 0) {
+        return HYPERV_DETECTED_NESTED;
+    }
+    return 0;
+}
+
+/*
+ * HasEmulatedDevice in generation_checks.c: -1 without a device list
+ */
+static int HasEmulatedDevice(const HV_FIXTURE* fixture, const HV_GEN1_DEVICE* device)
+{
+    UINT32 i;
+
+    if (fixture->DeviceCount == 0) {
+        return -1;
+    }
+    for (i = 0; i < fixture->DeviceCount; i++) {
+        if (HvGen1DeviceMatches(device, fixture->Devices[i].InstanceId, fixture->Devices[i].Service)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * GetVMGenerationInfo. GetFirmwareType() reports what the kernel stores as
+ * Control\PEFirmwareType (1 = BIOS, 2 = UEFI).
+ */
+static int ReplayGeneration(const HV_FIXTURE* fixture)
+{
+    HV_GENERATION_INDICATORS indicators;
+    UINT32 value;
+    int present;
+    char name[FIXTURE_TEXT_LEN];
+
+    memset(&indicators, 0, sizeof(indicators));
+
+    indicators.HasUEFI = ReadDword(fixture, "SYSTEM\\CurrentControlSet\\Control", "PEFirmwareType", &value) &&
+                         value == 2;
+    indicators.HasSecureBoot = ReadDword(fixture, HV_REG_KEY_SECUREBOOT_STATE, HV_REG_VALUE_SECUREBOOT, &value) &&
+                               value == 1;
+    indicators.HasTPM = FixtureRegKeyExists(fixture, "SYSTEM\\CurrentControlSet\\Services\\TPM") &&
+                        FixtureRegKeyExists(fixture, "SYSTEM\\CurrentControlSet\\Enum\\ACPI\\MSFT0101");
+    indicators.HasSCSIBoot = ReadDword(fixture, "SYSTEM\\CurrentControlSet\\Services\\storvsc", "BootFlags", &value) &&
+                             value != 0;
+
+    present = HasEmulatedDevice(fixture, HvGen1IdeController());
+    if (present >= 0) {
+        indicators.HasIDEController = present;
+    } else {
+        indicators.HasIDEController = ReadDword(fixture, "SYSTEM\\CurrentControlSet\\Services\\pciide", "Start", &value) &&
+                                      value != 4;
+    }
+
+    present = HasEmulatedDevice(fixture, HvGen1FloppyController());
+    indicators.HasFloppyController = (present >= 0) ? present :
+        FixtureRegKeyExists(fixture, "SYSTEM\\CurrentControlSet\\Services\\flpydisk");
+
+    if (FixtureRegKeyExists(fixture, "HARDWARE\\DEVICEMAP\\SERIALCOMM")) {
+        indicators.HasCOMPorts = FixtureRegEnumKey(fixture, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, name, sizeof(name)) == 0;
+    } else {
+        indicators.HasCOMPorts = FixtureRegKeyExists(fixture, "SYSTEM\\CurrentControlSet\\Services\\Serial");
+    }
+
+    present = HasEmulatedDevice(fixture, HvGen1LegacyNic());
+    indicators.HasLegacyNIC = (present >= 0) ? present :
+        FixtureRegKeyExists(fixture, "SYSTEM\\CurrentControlSet\\Services\\dc21x4");
+
+    return HvGenerationFromIndicators(&indicators);
+}
+
+void ReplayFixture(const HV_FIXTURE* fixture, PHV_REPLAY_RESULT result)
+{
+    HV_CPUID_TABLE table;
+    UINT32 value;
+
+    memset(result, 0, sizeof(*result));
+
+    table.Leaves = fixture->Cpuid;
+    table.Count = fixture->CpuidCount;
+    HvCpuidDecode(HvCpuidTableSource, &table, &result->Cpuid);
+    HvClassifyPartition(&result->Cpuid, result->Verdict, sizeof(result->Verdict));
+
+    if (result->Cpuid.HypervisorPresent) {
+        result->Flags |= HYPERV_DETECTED_CPUID;
+    }
+    result->Flags |= ReplayRegistry(fixture);
+    result->Flags |= ReplayServices(fixture);
+    result->Flags |= ReplayDevices(fixture);
+    result->Flags |= ReplayBios(fixture);
+    result->Flags |= ReplayNested(fixture);
+
+    /* CheckGenerationHyperV stops early outside a VM */
+    if (result->Cpuid.HypervisorPresent) {
+        result->Generation = ReplayGeneration(fixture);
+    }
+    result->Vbs = ReadDword(fixture, HV_REG_KEY_DEVICEGUARD, HV_REG_VALUE_VBS, &value) && value != 0;
+}
+
+int ReplayCompare(const HV_FIXTURE* fixture, const HV_REPLAY_RESULT* result, char* msg, size_t msgSize)
+{
+    const HV_FIXTURE_EXPECTED* expected = &fixture->Expected;
+
+    if (!expected->Present) {
+        snprintf(msg, msgSize, "%s has no expected.txt", fixture->Name);
+        return -1;
+    }
+    if (strcmp(result->Verdict, expected->Verdict) != 0) {
+        snprintf(msg, msgSize, "Verdict %s, expected %s", result->Verdict, expected->Verdict);
+        return -1;
+    }
+    if (result->Flags != expected->Flags) {
+        snprintf(msg, msgSize, "Flags 0x%08X, expected 0x%08X", result->Flags, expected->Flags);
+        return -1;
+    }
+    if (result->Generation != expected->Generation) {
+        snprintf(msg, msgSize, "Generation %d, expected %d", result->Generation, expected->Generation);
+        return -1;
+    }
+    if (result->Vbs != expected->Vbs) {
+        snprintf(msg, msgSize, "VBS %d, expected %d", result->Vbs, expected->Vbs);
+        return -1;
+    }
+    return 0;
+}
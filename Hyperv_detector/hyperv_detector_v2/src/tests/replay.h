@@ -0,0 +1,40 @@
+/**
+ * replay.h - Detection replayed over a captured fixture
+ *
+ * Runs the decisions of the live checks against a fixture (fixture.h)
+ * instead of the running machine, using the tables and rules in
+ * src/common/detection_rules.h:
+ *
+ *   CPUID      CheckCpuidHyperV       cpuid.txt
+ *   REGISTRY   CheckRegistryHyperV    registry.txt
+ *   SERVICES   CheckServicesHyperV    services.txt
+ *   DEVICES    CheckDevicesHyperV     devices.txt
+ *   BIOS       CheckBiosHyperV        registry.txt (BIOS and ACPI\DSDT keys)
+ *   NESTED     CheckNestedHyperV      registry.txt
+ *
+ * plus the verdict (HvClassifyPartition), the VM generation
+ * (CheckGenerationHyperV) and the VBS state (vsm_checks.c). Checks that look
+ * at files, processes or kernel objects are not captured and never set
+ * their flags here.
+ */
+
+#pragma once
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "fixture.h"
+
+typedef struct _HV_REPLAY_RESULT {
+    UINT32 Flags;               /* HYPERV_DETECTED_* */
+    char Verdict[FIXTURE_NAME_LEN];
+    int Generation;             /* 0 = unknown or not a VM, 1, 2 */
+    int Vbs;
+    HV_CPUID_INFO Cpuid;
+} HV_REPLAY_RESULT, *PHV_REPLAY_RESULT;
+
+void ReplayFixture(const HV_FIXTURE* fixture, PHV_REPLAY_RESULT result);
+
+/* 0 when result matches fixture->Expected; otherwise msg names the first difference */
+int ReplayCompare(const HV_FIXTURE* fixture, const HV_REPLAY_RESULT* result, char* msg, size_t msgSize);
+
+#endif /* REPLAY_H */
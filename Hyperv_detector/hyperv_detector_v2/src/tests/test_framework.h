@@ -1,15 +1,41 @@
 /*
  * Hyper-V Detector Test Framework
  * Simple test framework for running detection method tests
+ *
+ * Tests run in-process, one after another, by default. With --jobs N (or
+ * --isolate) every test runs in a worker process of its own, N at a time, so
+ * a crash or hang fails that test instead of the run. On Windows the test
+ * binary starts itself again with --run-test; elsewhere the worker is a
+ * fork(). Failed tests can be retried (--retries), results can be written as
+ * JUnit XML (--junit) and the JSON summary lists every test with its
+ * duration. Timing uses QueryPerformanceCounter / clock_gettime.
+ *
+ * The header builds on Linux as well, for the portable tests
+ * (portable_tests.c, portable_main.c).
  */
 #pragma once
 #ifndef TEST_FRAMEWORK_H
 #define TEST_FRAMEWORK_H
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+typedef int BOOL;
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+#endif
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 /* Test result codes */
@@ -29,6 +55,29 @@ typedef struct _TEST_CASE {
     BOOL requiresHypervisor;
 } TEST_CASE, *PTEST_CASE;
 
+/* Outcome of one test (last attempt) */
+typedef struct _TEST_RECORD {
+    TEST_RESULT result;
+    int attempts;
+    double durationMs;
+    char message[512];
+} TEST_RECORD, *PTEST_RECORD;
+
+/* Runner options (ParseTestRunOptions) */
+#define TEST_MAX_JOBS               64      /* WaitForMultipleObjects limit */
+#define TEST_DEFAULT_TIMEOUT_SEC    300
+
+typedef struct _TEST_RUN_OPTIONS {
+    int jobs;                   /* Concurrent worker processes */
+    int retries;                /* Extra attempts for FAIL/ERROR */
+    int timeoutSec;             /* Per attempt, worker processes only */
+    BOOL isolate;               /* Worker processes even with one job */
+    BOOL jsonOutput;
+    const char* junitPath;
+    int workerTest;             /* --run-test: index to run in this process, or -1 */
+    const char* resultFile;     /* --result-file: where a worker reports */
+} TEST_RUN_OPTIONS, *PTEST_RUN_OPTIONS;
+
 /* Test statistics */
 typedef struct _TEST_STATS {
     int total;
@@ -36,8 +85,9 @@ typedef struct _TEST_STATS {
     int failed;
     int skipped;
     int errors;
-    DWORD startTime;
-    DWORD endTime;
+    int flaky;                  /* Passed only after a retry */
+    double startTime;
+    double endTime;
 } TEST_STATS, *PTEST_STATS;
 
 /* Global test stats */
@@ -52,50 +102,77 @@ static TEST_STATS g_testStats = {0};
 #define COLOR_WHITE   "\033[37m"
 
 /* Enable ANSI colors on Windows */
-static void EnableConsoleColors(void)
+static __inline void EnableConsoleColors(void)
 {
+#ifdef _WIN32
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
     DWORD dwMode = 0;
     GetConsoleMode(hOut, &dwMode);
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     SetConsoleMode(hOut, dwMode);
+#endif
+}
+
+/* Monotonic time in milliseconds (sub-millisecond resolution) */
+static __inline double TestTimeMs(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+#endif
+}
+
+static __inline const char* TestResultName(TEST_RESULT result)
+{
+    switch (result) {
+        case TEST_PASS: return "PASS";
+        case TEST_FAIL: return "FAIL";
+        case TEST_SKIP: return "SKIP";
+        default:        return "ERROR";
+    }
+}
+
+/* Add a result to the statistics */
+static __inline void CountTestResult(TEST_RESULT result, int attempts)
+{
+    switch (result) {
+        case TEST_PASS: g_testStats.passed++;  break;
+        case TEST_FAIL: g_testStats.failed++;  break;
+        case TEST_SKIP: g_testStats.skipped++; break;
+        default:        g_testStats.errors++;  break;
+    }
+    if (result == TEST_PASS && attempts > 1) {
+        g_testStats.flaky++;
+    }
+    g_testStats.total++;
 }
 
 /* Print test result */
-static void PrintTestResult(const char* name, TEST_RESULT result, const char* message, DWORD elapsed)
+static __inline void PrintTestResult(const char* name, TEST_RESULT result, const char* message, double elapsed)
 {
-    const char* resultStr;
     const char* color;
-    
+
     switch (result) {
-        case TEST_PASS:
-            resultStr = "PASS";
-            color = COLOR_GREEN;
-            g_testStats.passed++;
-            break;
-        case TEST_FAIL:
-            resultStr = "FAIL";
-            color = COLOR_RED;
-            g_testStats.failed++;
-            break;
-        case TEST_SKIP:
-            resultStr = "SKIP";
-            color = COLOR_YELLOW;
-            g_testStats.skipped++;
-            break;
-        default:
-            resultStr = "ERROR";
-            color = COLOR_RED;
-            g_testStats.errors++;
-            break;
+        case TEST_PASS: color = COLOR_GREEN;  break;
+        case TEST_SKIP: color = COLOR_YELLOW; break;
+        default:        color = COLOR_RED;    break;
     }
-    
-    g_testStats.total++;
-    
-    printf("  [%s%s%s] %-45s (%3lu ms)", 
-        color, resultStr, COLOR_RESET, 
+
+    printf("  [%s%s%s] %-45s (%7.1f ms)",
+        color, TestResultName(result), COLOR_RESET,
         name, elapsed);
-    
+
     if (message && message[0]) {
         printf(" - %s", message);
     }
@@ -103,16 +180,16 @@ static void PrintTestResult(const char* name, TEST_RESULT result, const char* me
 }
 
 /* Print category header */
-static void PrintCategoryHeader(const char* category)
+static __inline void PrintCategoryHeader(const char* category)
 {
     printf("\n%s=== %s ===%s\n", COLOR_CYAN, category, COLOR_RESET);
 }
 
 /* Print test summary */
-static void PrintTestSummary(void)
+static __inline void PrintTestSummary(void)
 {
-    DWORD totalTime = g_testStats.endTime - g_testStats.startTime;
-    
+    double totalTime = g_testStats.endTime - g_testStats.startTime;
+
     printf("\n%s========================================%s\n", COLOR_WHITE, COLOR_RESET);
     printf("               TEST SUMMARY\n");
     printf("%s========================================%s\n", COLOR_WHITE, COLOR_RESET);
@@ -121,9 +198,12 @@ static void PrintTestSummary(void)
     printf("  %sFailed:  %d%s\n", g_testStats.failed > 0 ? COLOR_RED : COLOR_WHITE, g_testStats.failed, COLOR_RESET);
     printf("  %sSkipped: %d%s\n", COLOR_YELLOW, g_testStats.skipped, COLOR_RESET);
     printf("  %sErrors:  %d%s\n", g_testStats.errors > 0 ? COLOR_RED : COLOR_WHITE, g_testStats.errors, COLOR_RESET);
-    printf("  Time:    %lu ms\n", totalTime);
+    if (g_testStats.flaky > 0) {
+        printf("  %sFlaky:   %d (passed on retry)%s\n", COLOR_YELLOW, g_testStats.flaky, COLOR_RESET);
+    }
+    printf("  Time:    %.0f ms\n", totalTime);
     printf("%s========================================%s\n", COLOR_WHITE, COLOR_RESET);
-    
+
     if (g_testStats.failed == 0 && g_testStats.errors == 0) {
         printf("  %sAll tests passed!%s\n", COLOR_GREEN, COLOR_RESET);
     } else {
@@ -132,59 +212,731 @@ static void PrintTestSummary(void)
     printf("\n");
 }
 
-/* Run a single test */
-static void RunTest(PTEST_CASE test, BOOL isAdmin, BOOL hasHypervisor)
+/*
+ * Parse the runner options. Other arguments are left to the caller, so this
+ * only fails (-1) on a runner option with a bad value.
+ */
+static __inline int ParseTestRunOptions(int argc, char* argv[], PTEST_RUN_OPTIONS options)
+{
+    int i;
+
+    memset(options, 0, sizeof(*options));
+    options->jobs = 1;
+    options->timeoutSec = TEST_DEFAULT_TIMEOUT_SEC;
+    options->workerTest = -1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            options->jsonOutput = TRUE;
+        } else if (strcmp(argv[i], "--isolate") == 0) {
+            options->isolate = TRUE;
+        } else if (i + 1 >= argc) {
+            continue;
+        } else if (strcmp(argv[i], "--jobs") == 0) {
+            options->jobs = atoi(argv[++i]);
+            if (options->jobs < 1 || options->jobs > TEST_MAX_JOBS) {
+                fprintf(stderr, "--jobs must be 1-%d\n", TEST_MAX_JOBS);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--retries") == 0) {
+            options->retries = atoi(argv[++i]);
+            if (options->retries < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--timeout") == 0) {
+            options->timeoutSec = atoi(argv[++i]);
+            if (options->timeoutSec < 1) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--junit") == 0) {
+            options->junitPath = argv[++i];
+        } else if (strcmp(argv[i], "--run-test") == 0) {
+            options->workerTest = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--result-file") == 0) {
+            options->resultFile = argv[++i];
+        }
+    }
+
+    if (options->jobs > 1) {
+        options->isolate = TRUE;
+    }
+    return 0;
+}
+
+static __inline void PrintTestRunUsage(void)
+{
+    printf("  --jobs <n>       Run tests in n worker processes at a time\n");
+    printf("  --isolate        Run each test in its own worker process\n");
+    printf("  --retries <n>    Retry failed tests up to n times\n");
+    printf("  --timeout <s>    Per-test limit for worker processes (default %d)\n", TEST_DEFAULT_TIMEOUT_SEC);
+    printf("  --junit <file>   Also write JUnit XML results\n");
+}
+
+/* Prerequisites not met: SKIP with a reason (TRUE) */
+static __inline BOOL CheckTestPrerequisites(const TEST_CASE* test, BOOL isAdmin, BOOL hasHypervisor, PTEST_RECORD record)
 {
-    char message[512] = {0};
-    DWORD start, end;
-    TEST_RESULT result;
-    
-    /* Check prerequisites */
     if (test->requiresAdmin && !isAdmin) {
-        snprintf(message, sizeof(message), "Requires administrator privileges");
-        PrintTestResult(test->name, TEST_SKIP, message, 0);
-        return;
+        record->result = TEST_SKIP;
+        snprintf(record->message, sizeof(record->message), "Requires administrator privileges");
+        return TRUE;
     }
-    
+
     if (test->requiresHypervisor && !hasHypervisor) {
-        snprintf(message, sizeof(message), "Requires hypervisor presence");
-        PrintTestResult(test->name, TEST_SKIP, message, 0);
-        return;
+        record->result = TEST_SKIP;
+        snprintf(record->message, sizeof(record->message), "Requires hypervisor presence");
+        return TRUE;
     }
-    
-    /* Run the test */
-    start = GetTickCount();
+    return FALSE;
+}
+
+/* One attempt in the current process */
+static __inline void RunTestAttempt(const TEST_CASE* test, PTEST_RECORD record)
+{
+    TEST_RESULT result;
+    double start;
+
+    record->message[0] = '\0';
+    start = TestTimeMs();
+#ifdef _WIN32
     __try {
-        result = test->testFunc(message, sizeof(message));
+        result = test->testFunc(record->message, sizeof(record->message));
     }
     __except(EXCEPTION_EXECUTE_HANDLER) {
         result = TEST_ERROR;
-        snprintf(message, sizeof(message), "Exception 0x%08X", GetExceptionCode());
+        snprintf(record->message, sizeof(record->message), "Exception 0x%08X", GetExceptionCode());
+    }
+#else
+    result = test->testFunc(record->message, sizeof(record->message));
+#endif
+    record->durationMs = TestTimeMs() - start;
+    record->result = result;
+    record->attempts++;
+}
+
+/* Run a single test in-process, retrying failures */
+static __inline void RunTest(const TEST_CASE* test, BOOL isAdmin, BOOL hasHypervisor, int retries, PTEST_RECORD record)
+{
+    memset(record, 0, sizeof(*record));
+    if (CheckTestPrerequisites(test, isAdmin, hasHypervisor, record)) {
+        return;
+    }
+
+    do {
+        RunTestAttempt(test, record);
+    } while ((record->result == TEST_FAIL || record->result == TEST_ERROR) && record->attempts <= retries);
+}
+
+/* ============================================================================
+ * Worker processes
+ * ============================================================================ */
+
+/*
+ * Worker report: "<result> <duration ms> <message>" on one line
+ */
+static __inline BOOL WriteWorkerResult(const char* path, const TEST_RECORD* record)
+{
+    FILE* file = fopen(path, "w");
+    char* p;
+    char message[sizeof(record->message)];
+
+    if (file == NULL) {
+        return FALSE;
+    }
+
+    memcpy(message, record->message, sizeof(message));
+    message[sizeof(message) - 1] = '\0';
+    for (p = message; *p; p++) {
+        if (*p == '\r' || *p == '\n') {
+            *p = ' ';
+        }
+    }
+
+    fprintf(file, "%d %.3f %s\n", (int)record->result, record->durationMs, message);
+    fclose(file);
+    return TRUE;
+}
+
+static __inline BOOL ReadWorkerResult(const char* path, PTEST_RECORD record)
+{
+    FILE* file = fopen(path, "r");
+    char line[sizeof(record->message) + 64];
+    char* message = NULL;
+    size_t length;
+    int result;
+    double duration;
+    int consumed = 0;
+
+    if (file == NULL) {
+        return FALSE;
+    }
+    if (fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "%d %lf %n", &result, &duration, &consumed) != 2 ||
+        result < TEST_PASS || result > TEST_ERROR) {
+        fclose(file);
+        return FALSE;
+    }
+    fclose(file);
+
+    message = line + consumed;
+    length = strlen(message);
+    while (length > 0 && (message[length - 1] == '\n' || message[length - 1] == '\r')) {
+        message[--length] = '\0';
+    }
+
+    record->result = (TEST_RESULT)result;
+    record->durationMs = duration;
+    snprintf(record->message, sizeof(record->message), "%s", message);
+    return TRUE;
+}
+
+/*
+ * --run-test entry point: run one test and report through the result file.
+ * Returns the process exit code.
+ */
+static __inline int RunTestWorker(const TEST_CASE* tests, int count, const TEST_RUN_OPTIONS* options)
+{
+    TEST_RECORD record;
+
+    if (options->workerTest < 0 || options->workerTest >= count || options->resultFile == NULL) {
+        return 2;
+    }
+
+    memset(&record, 0, sizeof(record));
+    RunTestAttempt(&tests[options->workerTest], &record);
+    return WriteWorkerResult(options->resultFile, &record) ? 0 : 2;
+}
+
+typedef struct _TEST_WORKER {
+    BOOL active;
+    int test;
+    double startTime;
+    char resultPath[512];
+#ifdef _WIN32
+    HANDLE process;
+#else
+    pid_t pid;
+#endif
+} TEST_WORKER, *PTEST_WORKER;
+
+static __inline void TestWorkerResultPath(PTEST_WORKER worker, int attempt)
+{
+#ifdef _WIN32
+    char tempDir[MAX_PATH];
+
+    if (GetTempPathA(sizeof(tempDir), tempDir) == 0) {
+        strcpy(tempDir, ".\\");
+    }
+    snprintf(worker->resultPath, sizeof(worker->resultPath), "%shvtest_%lu_%d_%d.txt",
+             tempDir, GetCurrentProcessId(), worker->test, attempt);
+#else
+    const char* tempDir = getenv("TMPDIR");
+
+    snprintf(worker->resultPath, sizeof(worker->resultPath), "%s/hvtest_%ld_%d_%d.txt",
+             tempDir ? tempDir : "/tmp", (long)getpid(), worker->test, attempt);
+#endif
+    remove(worker->resultPath);
+}
+
+/*
+ * Start one attempt of a test in a new process. Worker output is discarded;
+ * only the result file is read back.
+ */
+static __inline BOOL StartTestWorker(PTEST_WORKER worker, const TEST_CASE* tests, int test, int attempt)
+{
+#ifdef _WIN32
+    char exePath[MAX_PATH];
+    char commandLine[MAX_PATH + 600];
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    HANDLE nul;
+    BOOL started;
+
+    (void)tests;
+    worker->test = test;
+    TestWorkerResultPath(worker, attempt);
+
+    if (GetModuleFileNameA(NULL, exePath, sizeof(exePath)) == 0) {
+        return FALSE;
+    }
+    snprintf(commandLine, sizeof(commandLine), "\"%s\" --run-test %d --result-file \"%s\"",
+             exePath, test, worker->resultPath);
+
+    nul = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = nul;
+    si.hStdError = nul;
+
+    started = CreateProcessA(exePath, commandLine, NULL, NULL, TRUE, CREATE_NO_WINDOW,
+                             NULL, NULL, &si, &pi);
+    if (nul != INVALID_HANDLE_VALUE) {
+        CloseHandle(nul);
+    }
+    if (!started) {
+        return FALSE;
+    }
+
+    CloseHandle(pi.hThread);
+    worker->process = pi.hProcess;
+#else
+    pid_t pid;
+
+    worker->test = test;
+    TestWorkerResultPath(worker, attempt);
+
+    /* Buffered output would otherwise be written twice */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+        return FALSE;
+    }
+    if (pid == 0) {
+        TEST_RECORD record;
+        int nul = open("/dev/null", O_WRONLY);
+
+        if (nul >= 0) {
+            dup2(nul, STDOUT_FILENO);
+            dup2(nul, STDERR_FILENO);
+            close(nul);
+        }
+        memset(&record, 0, sizeof(record));
+        RunTestAttempt(&tests[test], &record);
+        _exit(WriteWorkerResult(worker->resultPath, &record) ? 0 : 2);
+    }
+    worker->pid = pid;
+#endif
+
+    worker->active = TRUE;
+    worker->startTime = TestTimeMs();
+    return TRUE;
+}
+
+/*
+ * Wait up to waitMs for any worker to exit. Returns its slot and exit
+ * status (Windows exit code, or the raw waitpid status), or -1.
+ */
+static __inline int WaitForTestWorker(PTEST_WORKER workers, int jobs, int waitMs, unsigned long* exitStatus)
+{
+#ifdef _WIN32
+    HANDLE handles[TEST_MAX_JOBS];
+    int slots[TEST_MAX_JOBS];
+    int active = 0;
+    int i;
+    DWORD wait;
+    DWORD code = 0;
+
+    for (i = 0; i < jobs; i++) {
+        if (workers[i].active) {
+            handles[active] = workers[i].process;
+            slots[active++] = i;
+        }
+    }
+    if (active == 0) {
+        return -1;
+    }
+
+    wait = WaitForMultipleObjects((DWORD)active, handles, FALSE, (DWORD)waitMs);
+    if (wait >= WAIT_OBJECT_0 + (DWORD)active) {
+        return -1;
+    }
+
+    i = slots[wait - WAIT_OBJECT_0];
+    GetExitCodeProcess(workers[i].process, &code);
+    CloseHandle(workers[i].process);
+    workers[i].process = NULL;
+    workers[i].active = FALSE;
+    *exitStatus = code;
+    return i;
+#else
+    struct timespec pause = { 0, 5 * 1000000L };
+    double deadline = TestTimeMs() + waitMs;
+    int status = 0;
+    pid_t pid;
+    int i;
+
+    do {
+        pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            for (i = 0; i < jobs; i++) {
+                if (workers[i].active && workers[i].pid == pid) {
+                    workers[i].active = FALSE;
+                    *exitStatus = (unsigned long)status;
+                    return i;
+                }
+            }
+            continue;
+        }
+        if (pid < 0) {
+            return -1;
+        }
+        nanosleep(&pause, NULL);
+    } while (TestTimeMs() < deadline);
+
+    return -1;
+#endif
+}
+
+static __inline void KillTestWorker(PTEST_WORKER worker)
+{
+#ifdef _WIN32
+    TerminateProcess(worker->process, 1);
+    WaitForSingleObject(worker->process, INFINITE);
+    CloseHandle(worker->process);
+    worker->process = NULL;
+#else
+    int status;
+
+    kill(worker->pid, SIGKILL);
+    waitpid(worker->pid, &status, 0);
+#endif
+    worker->active = FALSE;
+    remove(worker->resultPath);
+}
+
+/*
+ * Turn a finished worker into a record. A worker that died before writing
+ * its result (crash, abort, stack overflow) is an ERROR with the exit status.
+ */
+static __inline void CollectTestWorker(PTEST_WORKER worker, unsigned long exitStatus, PTEST_RECORD record)
+{
+    double elapsed = TestTimeMs() - worker->startTime;
+
+    record->attempts++;
+    if (ReadWorkerResult(worker->resultPath, record)) {
+        remove(worker->resultPath);
+        return;
+    }
+
+    record->result = TEST_ERROR;
+    record->durationMs = elapsed;
+#ifdef _WIN32
+    snprintf(record->message, sizeof(record->message), "Worker exited with 0x%08lX", exitStatus);
+#else
+    if (WIFSIGNALED((int)exitStatus)) {
+        snprintf(record->message, sizeof(record->message), "Worker killed by signal %d",
+                 WTERMSIG((int)exitStatus));
+    } else {
+        snprintf(record->message, sizeof(record->message), "Worker exited with %d",
+                 WEXITSTATUS((int)exitStatus));
+    }
+#endif
+    remove(worker->resultPath);
+}
+
+/*
+ * Run every test in worker processes, options->jobs at a time. Tests are
+ * started in table order; records[] is indexed like tests[].
+ */
+static __inline void RunTestsIsolated(const TEST_CASE* tests, int count, const TEST_RUN_OPTIONS* options,
+                                      BOOL isAdmin, BOOL hasHypervisor, PTEST_RECORD records)
+{
+    TEST_WORKER workers[TEST_MAX_JOBS];
+    int jobs = options->jobs < 1 ? 1 : (options->jobs > TEST_MAX_JOBS ? TEST_MAX_JOBS : options->jobs);
+    int next = 0;
+    int running = 0;
+    int slot, i;
+    unsigned long exitStatus = 0;
+    double now;
+
+    memset(workers, 0, sizeof(workers));
+
+    for (;;) {
+        /* Fill free slots; tests whose prerequisites fail never start */
+        for (slot = 0; slot < jobs && next < count; slot++) {
+            if (workers[slot].active) {
+                continue;
+            }
+            while (next < count) {
+                i = next++;
+                memset(&records[i], 0, sizeof(records[i]));
+                if (CheckTestPrerequisites(&tests[i], isAdmin, hasHypervisor, &records[i])) {
+                    continue;
+                }
+                if (!StartTestWorker(&workers[slot], tests, i, 0)) {
+                    records[i].result = TEST_ERROR;
+                    snprintf(records[i].message, sizeof(records[i].message), "Could not start worker");
+                    continue;
+                }
+                running++;
+                break;
+            }
+        }
+
+        if (running == 0) {
+            break;
+        }
+
+        slot = WaitForTestWorker(workers, jobs, 50, &exitStatus);
+        if (slot >= 0) {
+            i = workers[slot].test;
+            CollectTestWorker(&workers[slot], exitStatus, &records[i]);
+        } else {
+            /* Nothing finished: enforce the per-test timeout */
+            now = TestTimeMs();
+            for (slot = 0; slot < jobs; slot++) {
+                if (workers[slot].active && now - workers[slot].startTime > options->timeoutSec * 1000.0) {
+                    break;
+                }
+            }
+            if (slot == jobs) {
+                continue;
+            }
+            i = workers[slot].test;
+            KillTestWorker(&workers[slot]);
+            records[i].attempts++;
+            records[i].result = TEST_ERROR;
+            records[i].durationMs = now - workers[slot].startTime;
+            snprintf(records[i].message, sizeof(records[i].message),
+                     "Timed out after %d s", options->timeoutSec);
+        }
+        running--;
+
+        /* Retry in the slot that just freed up */
+        if ((records[i].result == TEST_FAIL || records[i].result == TEST_ERROR) &&
+            records[i].attempts <= options->retries &&
+            StartTestWorker(&workers[slot], tests, i, records[i].attempts)) {
+            running++;
+        }
+    }
+}
+
+/*
+ * Run the whole table, in-process or isolated depending on the options.
+ * Serial in-process runs print each result as it completes; isolated runs
+ * print in table order once everything has finished.
+ */
+static __inline void RunTestSuite(const TEST_CASE* tests, int count, const TEST_RUN_OPTIONS* options,
+                                  BOOL isAdmin, BOOL hasHypervisor, PTEST_RECORD records)
+{
+    const char* currentCategory = NULL;
+    int i;
+
+    memset(&g_testStats, 0, sizeof(g_testStats));
+    g_testStats.startTime = TestTimeMs();
+
+    if (options->isolate) {
+        RunTestsIsolated(tests, count, options, isAdmin, hasHypervisor, records);
+    }
+
+    for (i = 0; i < count; i++) {
+        /* Print category header if changed */
+        if (!options->jsonOutput &&
+            (currentCategory == NULL || strcmp(currentCategory, tests[i].category) != 0)) {
+            currentCategory = tests[i].category;
+            PrintCategoryHeader(currentCategory);
+        }
+
+        if (!options->isolate) {
+            RunTest(&tests[i], isAdmin, hasHypervisor, options->retries, &records[i]);
+        }
+
+        CountTestResult(records[i].result, records[i].attempts);
+        if (!options->jsonOutput) {
+            PrintTestResult(tests[i].name, records[i].result, records[i].message, records[i].durationMs);
+        }
+    }
+
+    g_testStats.endTime = TestTimeMs();
+}
+
+/* ============================================================================
+ * Reports
+ * ============================================================================ */
+
+static __inline void PrintJsonString(FILE* out, const char* text)
+{
+    const unsigned char* p;
+
+    fputc('"', out);
+    for (p = (const unsigned char*)(text ? text : ""); *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static __inline void PrintXmlString(FILE* out, const char* text)
+{
+    const unsigned char* p;
+
+    for (p = (const unsigned char*)(text ? text : ""); *p; p++) {
+        switch (*p) {
+            case '&':  fputs("&amp;", out);  break;
+            case '<':  fputs("&lt;", out);   break;
+            case '>':  fputs("&gt;", out);   break;
+            case '"':  fputs("&quot;", out); break;
+            case '\'': fputs("&apos;", out); break;
+            default:
+                if (*p >= 0x20 || *p == '\t') {
+                    fputc(*p, out);
+                }
+                break;
+        }
     }
-    end = GetTickCount();
-    
-    PrintTestResult(test->name, result, message, end - start);
 }
 
 /* JSON output for automated processing */
-static void PrintJsonResult(const char* configName)
+static __inline void PrintJsonResult(const char* configName, const TEST_CASE* tests, const TEST_RECORD* records, int count)
 {
     time_t now = time(NULL);
     struct tm* tm_info = localtime(&now);
     char timeStr[64];
+    int i;
+
     strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%S", tm_info);
-    
+
     printf("\n{\n");
-    printf("  \"config\": \"%s\",\n", configName);
+    printf("  \"config\": ");
+    PrintJsonString(stdout, configName);
+    printf(",\n");
     printf("  \"timestamp\": \"%s\",\n", timeStr);
     printf("  \"total\": %d,\n", g_testStats.total);
     printf("  \"passed\": %d,\n", g_testStats.passed);
     printf("  \"failed\": %d,\n", g_testStats.failed);
     printf("  \"skipped\": %d,\n", g_testStats.skipped);
     printf("  \"errors\": %d,\n", g_testStats.errors);
-    printf("  \"duration_ms\": %lu,\n", g_testStats.endTime - g_testStats.startTime);
-    printf("  \"success\": %s\n", (g_testStats.failed == 0 && g_testStats.errors == 0) ? "true" : "false");
+    printf("  \"flaky\": %d,\n", g_testStats.flaky);
+    printf("  \"duration_ms\": %.0f,\n", g_testStats.endTime - g_testStats.startTime);
+    printf("  \"success\": %s,\n", (g_testStats.failed == 0 && g_testStats.errors == 0) ? "true" : "false");
+    printf("  \"tests\": [\n");
+    for (i = 0; i < count; i++) {
+        printf("    {\"name\": ");
+        PrintJsonString(stdout, tests[i].name);
+        printf(", \"category\": ");
+        PrintJsonString(stdout, tests[i].category);
+        printf(", \"result\": \"%s\", \"duration_ms\": %.3f, \"attempts\": %d, \"message\": ",
+               TestResultName(records[i].result), records[i].durationMs, records[i].attempts);
+        PrintJsonString(stdout, records[i].message);
+        printf("}%s\n", i + 1 < count ? "," : "");
+    }
+    printf("  ]\n");
     printf("}\n");
 }
 
+/*
+ * JUnit XML: one <testsuite> per category, classname = category
+ */
+static __inline BOOL WriteJUnitReport(const char* path, const char* configName,
+                                      const TEST_CASE* tests, const TEST_RECORD* records, int count)
+{
+    FILE* out = fopen(path, "w");
+    int first, last, i;
+    int failures, errors, skipped;
+    double seconds;
+
+    if (out == NULL) {
+        return FALSE;
+    }
+
+    fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(out, "<testsuites name=\"");
+    PrintXmlString(out, configName);
+    fprintf(out, "\" tests=\"%d\" failures=\"%d\" errors=\"%d\" skipped=\"%d\" time=\"%.3f\">\n",
+            g_testStats.total, g_testStats.failed, g_testStats.errors, g_testStats.skipped,
+            (g_testStats.endTime - g_testStats.startTime) / 1000.0);
+
+    for (first = 0; first < count; first = last) {
+        failures = errors = skipped = 0;
+        seconds = 0.0;
+        for (last = first; last < count && strcmp(tests[last].category, tests[first].category) == 0; last++) {
+            failures += records[last].result == TEST_FAIL;
+            errors += records[last].result == TEST_ERROR;
+            skipped += records[last].result == TEST_SKIP;
+            seconds += records[last].durationMs / 1000.0;
+        }
+
+        fprintf(out, "  <testsuite name=\"");
+        PrintXmlString(out, tests[first].category);
+        fprintf(out, "\" tests=\"%d\" failures=\"%d\" errors=\"%d\" skipped=\"%d\" time=\"%.3f\">\n",
+                last - first, failures, errors, skipped, seconds);
+
+        for (i = first; i < last; i++) {
+            fprintf(out, "    <testcase classname=\"");
+            PrintXmlString(out, tests[i].category);
+            fprintf(out, "\" name=\"");
+            PrintXmlString(out, tests[i].name);
+            fprintf(out, "\" time=\"%.3f\">\n", records[i].durationMs / 1000.0);
+
+            if (records[i].attempts > 1) {
+                fprintf(out, "      <properties><property name=\"attempts\" value=\"%d\"/></properties>\n",
+                        records[i].attempts);
+            }
+            if (records[i].result != TEST_PASS) {
+                fprintf(out, "      <%s message=\"",
+                        records[i].result == TEST_FAIL ? "failure" :
+                        records[i].result == TEST_SKIP ? "skipped" : "error");
+                PrintXmlString(out, records[i].message);
+                fprintf(out, "\"/>\n");
+            } else if (records[i].message[0]) {
+                fprintf(out, "      <system-out>");
+                PrintXmlString(out, records[i].message);
+                fprintf(out, "</system-out>\n");
+            }
+            fprintf(out, "    </testcase>\n");
+        }
+        fprintf(out, "  </testsuite>\n");
+    }
+
+    fprintf(out, "</testsuites>\n");
+    fclose(out);
+    return TRUE;
+}
+
+/*
+ * Run a test table end to end after the caller has handled its own options:
+ * worker dispatch, the run, the summary or JSON, and the JUnit file.
+ * Returns the process exit code.
+ */
+static __inline int RunTestMain(const TEST_CASE* tests, int count, const TEST_RUN_OPTIONS* options,
+                                const char* configName, BOOL isAdmin, BOOL hasHypervisor)
+{
+    PTEST_RECORD records;
+
+    if (options->workerTest >= 0) {
+        return RunTestWorker(tests, count, options);
+    }
+
+    records = (PTEST_RECORD)calloc(count > 0 ? (size_t)count : 1, sizeof(TEST_RECORD));
+    if (records == NULL) {
+        return 2;
+    }
+
+    RunTestSuite(tests, count, options, isAdmin, hasHypervisor, records);
+
+    if (options->jsonOutput) {
+        PrintJsonResult(configName, tests, records, count);
+    } else {
+        PrintTestSummary();
+    }
+
+    if (options->junitPath != NULL && !WriteJUnitReport(options->junitPath, configName, tests, records, count)) {
+        fprintf(stderr, "Cannot write %s\n", options->junitPath);
+    }
+
+    free(records);
+    return (g_testStats.failed > 0 || g_testStats.errors > 0) ? 1 : 0;
+}
+
+/* Number of entries before the {NULL} end marker */
+static __inline int CountTestCases(const TEST_CASE* tests)
+{
+    int count = 0;
+
+    while (tests[count].name != NULL) {
+        count++;
+    }
+    return count;
+}
+
 #endif /* TEST_FRAMEWORK_H */
@@ -2,12 +2,19 @@
  * Hyper-V Detector Tests
  * Tests for each detection method
  * 
- * Usage: hyperv_detector_tests.exe [--json] [--config <n>]
+ * Usage: hyperv_detector_tests.exe [--json] [--config <n>] [--jobs <n>] [--retries <n>] [--junit <file>]
  */
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "test_framework.h"
+#include "portable_tests.h"
 #include "../user_mode/hyperv_detector.h"
+#include "../user_mode/device_index.h"
+#include "../user_mode/driver_batch.h"
+#include "../user_mode/event_reader.h"
+#include "../user_mode/perf_session.h"
+#include "../user_mode/perf_series.h"
+#include "../user_mode/wmi_pool.h"
 /* intrin.h included conditionally via common.h */
 #include <tlhelp32.h>
 #include <pdh.h>
@@ -194,7 +201,6 @@ extern BOOL IsRootPartitionQuick(void);
 /* Global state */
 static BOOL g_isAdmin = FALSE;
 static BOOL g_hasHypervisor = FALSE;
-static BOOL g_jsonOutput = FALSE;
 static char g_configName[256] = "unknown";
 
 /*
@@ -399,6 +405,96 @@ static TEST_RESULT Test_Devices_HyperVDevices(char* msg, size_t msgSize)
     return TEST_PASS;
 }
 
+static TEST_RESULT Test_Devices_IndexBuild(char* msg, size_t msgSize)
+{
+    const DEVICE_INDEX* index = GetDeviceIndex();
+    
+    if (index == NULL || DeviceIndexCount(index) == 0) {
+        snprintf(msg, msgSize, "Device tree enumeration failed");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Devices=%u VMBus=%u",
+        (unsigned)DeviceIndexCount(index),
+        (unsigned)DeviceIndexCountById(index, "VMBUS\\"));
+    return TEST_PASS;
+}
+
+/*
+ * Helper: add a synthetic device to an index
+ */
+static void AddTestDevice(PDEVICE_INDEX index, const char* instanceId,
+                          const char* hardwareId, const char* classGuid, const char* service)
+{
+    DEVICE_INDEX_ENTRY entry = {0};
+    
+    strcpy_s(entry.instanceId, sizeof(entry.instanceId), instanceId);
+    strcpy_s(entry.hardwareIds, sizeof(entry.hardwareIds), hardwareId);
+    strcpy_s(entry.classGuid, sizeof(entry.classGuid), classGuid);
+    strcpy_s(entry.service, sizeof(entry.service), service);
+    DeviceIndexAdd(index, &entry);
+}
+
+static TEST_RESULT Test_Devices_IndexLookup(char* msg, size_t msgSize)
+{
+    PDEVICE_INDEX index = DeviceIndexCreate();
+    TEST_RESULT res = TEST_PASS;
+    
+    if (index == NULL) {
+        snprintf(msg, msgSize, "Allocation failed");
+        return TEST_ERROR;
+    }
+    
+    AddTestDevice(index, "ROOT\\VMBUS\\0000", "ROOT\\VMBUS", DEVICE_CLASS_SYSTEM, "vmbus");
+    AddTestDevice(index, "VMBUS\\{BA6163D9-04A1-4D29-B605-72E2FFB1DC7F}\\1",
+        "VMBUS\\{ba6163d9-04a1-4d29-b605-72e2ffb1dc7f}", DEVICE_CLASS_SCSIADAPTER, "storvsc");
+    AddTestDevice(index, "SCSI\\DISK&VEN_MSFT&PROD_VIRTUAL_DISK\\1",
+        "SCSI\\DiskMsft____Virtual_Disk____1.0", DEVICE_CLASS_DISKDRIVE, "disk");
+    
+    if (DeviceIndexCountById(index, "VMBUS\\") != 1 ||
+        DeviceIndexCountById(index, "ROOT\\VMBUS") != 1 ||
+        DeviceIndexCountById(index, "scsi\\diskmsft") != 1 ||
+        DeviceIndexFirstByClass(index, DEVICE_CLASS_SCSIADAPTER) == NULL ||
+        DeviceIndexFindService(index, "STORVSC") == NULL) {
+        res = TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Prefix/class/service lookups: %s", res == TEST_PASS ? "OK" : "MISMATCH");
+    DeviceIndexFree(index);
+    return res;
+}
+
+static TEST_RESULT Test_Devices_IndexSnapshot(char* msg, size_t msgSize)
+{
+    char tempDir[MAX_PATH] = {0};
+    char tempFile[MAX_PATH] = {0};
+    PDEVICE_INDEX loaded = NULL;
+    size_t expected = 0;
+    TEST_RESULT res = TEST_PASS;
+    
+    GetTempPathA(sizeof(tempDir), tempDir);
+    GetTempFileNameA(tempDir, "hvd", 0, tempFile);
+    
+    expected = DeviceIndexCount(GetDeviceIndex());
+    if (DeviceIndexSave(GetDeviceIndex(), tempFile) != 0) {
+        snprintf(msg, msgSize, "Save failed");
+        DeleteFileA(tempFile);
+        return TEST_FAIL;
+    }
+    
+    loaded = DeviceIndexLoad(tempFile);
+    if (loaded == NULL || DeviceIndexCount(loaded) != expected ||
+        DeviceIndexCountById(loaded, "VMBUS\\") != DeviceIndexCountById(GetDeviceIndex(), "VMBUS\\")) {
+        res = TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Round trip of %u devices: %s", (unsigned)expected,
+        res == TEST_PASS ? "OK" : "MISMATCH");
+    DeviceIndexFree(loaded);
+    DeleteFileA(tempFile);
+    return res;
+}
+
 /* ============================================================================
  * File Tests
  * ============================================================================ */
@@ -489,6 +585,38 @@ static TEST_RESULT Test_WMI_ComputerSystem(char* msg, size_t msgSize)
     return TEST_PASS;
 }
 
+static TEST_RESULT Test_WMI_PooledSession(char* msg, size_t msgSize)
+{
+    static const wchar_t* props[] = { L"Model", L"Manufacturer" };
+    WMI_VALUE values[2];
+    IWbemServices* first = NULL;
+    DWORD start = 0;
+    DWORD elapsed = 0;
+    
+    first = WmiPoolGetService(WMI_NS_CIMV2);
+    if (first == NULL) {
+        snprintf(msg, msgSize, "Cannot connect to ROOT\\CIMV2");
+        return TEST_ERROR;
+    }
+    
+    // The second lookup must reuse the pooled session, not reconnect
+    start = GetTickCount();
+    if (WmiPoolGetService(WMI_NS_CIMV2) != first) {
+        snprintf(msg, msgSize, "Session was not reused");
+        return TEST_FAIL;
+    }
+    
+    if (!WmiPoolSelectFirst(WMI_NS_CIMV2, L"Win32_ComputerSystem", NULL, props, 2, values) ||
+        !values[0].present) {
+        snprintf(msg, msgSize, "Win32_ComputerSystem query failed");
+        return TEST_FAIL;
+    }
+    elapsed = GetTickCount() - start;
+    
+    snprintf(msg, msgSize, "Model=%s (%lu ms on pooled session)", values[0].text, elapsed);
+    return TEST_PASS;
+}
+
 /* ============================================================================
  * MAC Address Tests
  * ============================================================================ */
@@ -576,6 +704,71 @@ static TEST_RESULT Test_PerfCounter_RootVP(char* msg, size_t msgSize)
     return TEST_PASS;
 }
 
+static TEST_RESULT Test_PerfCounter_Session(char* msg, size_t msgSize)
+{
+    PERF_COUNTER_SAMPLE sample = {0};
+    DWORD start = 0;
+    DWORD elapsed = 0;
+    BOOL found = FALSE;
+    
+    start = GetTickCount();
+    found = PerfSessionGet("\\Hyper-V Hypervisor Logical Processor(*)\\% Total Run Time", &sample);
+    
+    // Everything else is already collected, so these must not block again
+    PerfSessionHasCounter("\\Hyper-V Hypervisor Root Virtual Processor(_Total)\\% Total Run Time");
+    PerfSessionGet("\\Hyper-V Hypervisor\\Partitions", &sample);
+    elapsed = GetTickCount() - start;
+    
+    if (!found) {
+        snprintf(msg, msgSize, "Hypervisor LP counters not present (%lu ms)", elapsed);
+        return TEST_PASS;
+    }
+    
+    snprintf(msg, msgSize, "Shared session collected in %lu ms", elapsed);
+    return elapsed < 1000 ? TEST_PASS : TEST_FAIL;
+}
+
+static TEST_RESULT Test_PerfCounter_SeriesFile(char* msg, size_t msgSize)
+{
+    char tempDir[MAX_PATH] = {0};
+    char tempFile[MAX_PATH] = {0};
+    PERF_SERIES_WRITER writer;
+    PPERF_SERIES_READER reader = NULL;
+    PERF_SERIES_FRAME frame = {0};
+    uint32_t ids[2] = {0};
+    float values[2] = { 12.5f, 87.5f };
+    TEST_RESULT res = TEST_PASS;
+    
+    GetTempPathA(sizeof(tempDir), tempDir);
+    GetTempFileNameA(tempDir, "hvs", 0, tempFile);
+    
+    if (PerfSeriesCreate(&writer, tempFile, 100, 1000) != 0) {
+        snprintf(msg, msgSize, "Create failed");
+        DeleteFileA(tempFile);
+        return TEST_FAIL;
+    }
+    ids[0] = (uint32_t)PerfSeriesDefine(&writer, "LP(Hv LP 0)\\% Total Run Time");
+    ids[1] = (uint32_t)PerfSeriesDefine(&writer, "LP(Hv LP 1)\\% Total Run Time");
+    PerfSeriesWriteFrame(&writer, 1100, ids, values, 2);
+    PerfSeriesWriteFrame(&writer, 1205, &ids[1], &values[1], 1);
+    PerfSeriesFinish(&writer);
+    
+    reader = PerfSeriesOpen(tempFile);
+    if (reader == NULL ||
+        PerfSeriesNextFrame(reader, &frame) != 1 || frame.timeMs != 1100 || frame.count != 2 ||
+        frame.values[1] != 87.5f ||
+        PerfSeriesNextFrame(reader, &frame) != 1 || frame.timeMs != 1205 || frame.ids[0] != ids[1] ||
+        strcmp(PerfSeriesName(reader, ids[1]), "LP(Hv LP 1)\\% Total Run Time") != 0 ||
+        PerfSeriesNextFrame(reader, &frame) != 0) {
+        res = TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Time-series round trip: %s", res == TEST_PASS ? "OK" : "MISMATCH");
+    PerfSeriesClose(reader);
+    DeleteFileA(tempFile);
+    return res;
+}
+
 /* ============================================================================
  * Event Log Tests
  * ============================================================================ */
@@ -590,6 +783,117 @@ static TEST_RESULT Test_EventLog_HyperV(char* msg, size_t msgSize)
     return TEST_PASS;
 }
 
+static TEST_RESULT Test_EventLog_XPath(char* msg, size_t msgSize)
+{
+    static const DWORD ids[] = { 4624, 4656 };
+    EVENT_READER_QUERY query = {0};
+    wchar_t xpath[512] = {0};
+    
+    query.eventIds = ids;
+    query.eventIdCount = 2;
+    query.maxAgeSeconds = 60;
+    query.extraPredicate = L"EventData[Data[@Name='LogonType']='10']";
+    
+    if (!EventReaderBuildXPath(&query, xpath, sizeof(xpath) / sizeof(wchar_t)) ||
+        wcscmp(xpath, L"*[System[(EventID=4624 or EventID=4656) and "
+                      L"TimeCreated[timediff(@SystemTime) <= 60000]] and "
+                      L"EventData[Data[@Name='LogonType']='10']]") != 0) {
+        snprintf(msg, msgSize, "Unexpected XPath: %ls", xpath);
+        return TEST_FAIL;
+    }
+    
+    ZeroMemory(&query, sizeof(query));
+    if (!EventReaderBuildXPath(&query, xpath, sizeof(xpath) / sizeof(wchar_t)) || wcscmp(xpath, L"*") != 0) {
+        snprintf(msg, msgSize, "Empty query should match all events");
+        return TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "XPath filters OK");
+    return TEST_PASS;
+}
+
+static TEST_RESULT Test_EventLog_Bookmark(char* msg, size_t msgSize)
+{
+    wchar_t stateDir[MAX_PATH] = {0};
+    EVENT_READER reader;
+    EVENT_READER_QUERY query = {0};
+    EVENT_READER_RESULT first = {0};
+    EVENT_READER_RESULT second = {0};
+    TEST_RESULT res = TEST_PASS;
+    
+    GetTempPathW(MAX_PATH, stateDir);
+    wcscat_s(stateDir, MAX_PATH, L"hvd_bookmarks");
+    
+    if (!EventReaderOpen(&reader, stateDir)) {
+        snprintf(msg, msgSize, "Event log API unavailable");
+        return TEST_SKIP;
+    }
+    
+    query.channel = L"System";
+    query.bookmarkName = "test-system";
+    EventReaderResetBookmark(&reader, query.bookmarkName);
+    
+    if (!EventReaderRead(&reader, &query, &first) || first.eventCount == 0) {
+        snprintf(msg, msgSize, "System log empty or unreadable");
+        EventReaderClose(&reader);
+        return TEST_SKIP;
+    }
+    
+    // Second scan resumes from the bookmark and only sees new events
+    if (!EventReaderRead(&reader, &query, &second) || !second.fromBookmark ||
+        second.newEvents >= first.eventCount) {
+        res = TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Full scan %lu events, rescan %lu new: %s",
+        first.eventCount, second.newEvents, res == TEST_PASS ? "OK" : "NOT INCREMENTAL");
+    EventReaderResetBookmark(&reader, query.bookmarkName);
+    EventReaderClose(&reader);
+    RemoveDirectoryW(stateDir);
+    return res;
+}
+
+static TEST_RESULT Test_EventLog_WindowNotBookmarked(char* msg, size_t msgSize)
+{
+    wchar_t stateDir[MAX_PATH] = {0};
+    EVENT_READER reader;
+    EVENT_READER_QUERY query = {0};
+    EVENT_READER_RESULT first = {0};
+    EVENT_READER_RESULT second = {0};
+    TEST_RESULT res = TEST_PASS;
+    
+    GetTempPathW(MAX_PATH, stateDir);
+    wcscat_s(stateDir, MAX_PATH, L"hvd_bookmarks");
+    
+    if (!EventReaderOpen(&reader, stateDir)) {
+        snprintf(msg, msgSize, "Event log API unavailable");
+        return TEST_SKIP;
+    }
+    
+    query.channel = L"System";
+    query.maxAgeSeconds = 7 * 24 * 60 * 60;
+    query.bookmarkName = "test-system-window";
+    EventReaderResetBookmark(&reader, query.bookmarkName);
+    
+    if (!EventReaderRead(&reader, &query, &first) || first.eventCount == 0) {
+        snprintf(msg, msgSize, "No System events in the last week");
+        EventReaderClose(&reader);
+        return TEST_SKIP;
+    }
+    
+    // Every scan of a windowed query is a full one, so old events age out
+    if (!EventReaderRead(&reader, &query, &second) || second.fromBookmark ||
+        second.newEvents != second.eventCount) {
+        res = TEST_FAIL;
+    }
+    
+    snprintf(msg, msgSize, "Windowed scans %lu and %lu events: %s",
+        first.eventCount, second.eventCount, res == TEST_PASS ? "OK" : "BOOKMARKED");
+    EventReaderClose(&reader);
+    RemoveDirectoryW(stateDir);
+    return res;
+}
+
 /* ============================================================================
  * Security Features Tests
  * ============================================================================ */
@@ -1734,6 +2038,9 @@ static TEST_CASE g_testCases[] = {
     
     /* Device Tests */
     {"Hyper-V Devices", "Devices", Test_Devices_HyperVDevices, FALSE, FALSE},
+    {"Device Index Build", "Devices", Test_Devices_IndexBuild, FALSE, FALSE},
+    {"Device Index Lookup", "Devices", Test_Devices_IndexLookup, FALSE, FALSE},
+    {"Device Index Snapshot", "Devices", Test_Devices_IndexSnapshot, FALSE, FALSE},
     
     /* File Tests */
     {"vmbus.sys Driver", "Files", Test_Files_VmBusDriver, FALSE, FALSE},
@@ -1748,6 +2055,7 @@ static TEST_CASE g_testCases[] = {
     
     /* WMI Tests */
     {"WMI Computer System", "WMI", Test_WMI_ComputerSystem, FALSE, FALSE},
+    {"WMI Pooled Session", "WMI", Test_WMI_PooledSession, FALSE, FALSE},
     
     /* MAC Tests */
     {"MAC Address Range", "MAC", Test_MAC_HyperVRange, FALSE, FALSE},
@@ -1761,9 +2069,14 @@ static TEST_CASE g_testCases[] = {
     /* Performance Counter Tests */
     {"Hyper-V Counters", "PerfCounter", Test_PerfCounter_HyperV, FALSE, FALSE},
     {"Root VP Counters", "PerfCounter", Test_PerfCounter_RootVP, FALSE, FALSE},
+    {"Shared PDH Session", "PerfCounter", Test_PerfCounter_Session, FALSE, FALSE},
+    {"Counter Time-Series File", "PerfCounter", Test_PerfCounter_SeriesFile, FALSE, FALSE},
     
     /* Event Log Tests */
     {"Hyper-V Event Logs", "EventLog", Test_EventLog_HyperV, FALSE, FALSE},
+    {"Event Reader XPath", "EventLog", Test_EventLog_XPath, FALSE, FALSE},
+    {"Event Reader Bookmark", "EventLog", Test_EventLog_Bookmark, FALSE, FALSE},
+    {"Event Reader Window Not Bookmarked", "EventLog", Test_EventLog_WindowNotBookmarked, FALSE, FALSE},
     
     /* Security Tests */
     {"VBS/Security Features", "Security", Test_Security_VBS, FALSE, FALSE},
@@ -1990,71 +2303,99 @@ static void PrintUsage(const char* progName)
     printf("Options:\n");
     printf("  --json           Output results in JSON format\n");
     printf("  --config <n>  Configuration name for reporting\n");
+    PrintTestRunUsage();
     printf("  --help           Show this help\n");
     printf("\nExamples:\n");
     printf("  %s                           Run all tests\n", progName);
     printf("  %s --json --config \"VM-01\"   Run with JSON output\n", progName);
+    printf("  %s --jobs 8 --retries 1 --junit results.xml\n", progName);
 }
 
-static void DetectConfiguration(void)
+/*
+ * g_testCases followed by the portable tests. Worker processes build the
+ * same list, so --run-test indexes agree.
+ */
+static PTEST_CASE BuildTestList(int* count)
 {
-    int cpuInfo[4] = {0, 0, 0, 0};
-    char vendor[13] = {0};
+    int local = CountTestCases(g_testCases);
+    int portable = CountTestCases(g_portableTestCases);
+    PTEST_CASE tests = (PTEST_CASE)malloc((size_t)(local + portable) * sizeof(TEST_CASE));
     
-    /* Auto-detect configuration */
-    if (!g_hasHypervisor) {
-        strcpy_s(g_configName, sizeof(g_configName), "BareMetal");
-        return;
+    if (tests == NULL) {
+        return NULL;
     }
+    memcpy(tests, g_testCases, (size_t)local * sizeof(TEST_CASE));
+    memcpy(tests + local, g_portableTestCases, (size_t)portable * sizeof(TEST_CASE));
+    *count = local + portable;
+    return tests;
+}
+
+/*
+ * HV_CPUID_SOURCE over the executing processor
+ */
+static void LiveCpuidSource(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4])
+{
+    int cpuInfo[4] = {0, 0, 0, 0};
     
-    /* Check for Microsoft Hyper-V */
-    __cpuid(cpuInfo, 0x40000000);
-    memcpy(vendor, &cpuInfo[1], 4);
-    memcpy(vendor + 4, &cpuInfo[2], 4);
-    memcpy(vendor + 8, &cpuInfo[3], 4);
-    vendor[12] = '\0';
+    (void)context;
+    __cpuidex(cpuInfo, (int)leaf, (int)subleaf);
+    memcpy(regs, cpuInfo, sizeof(cpuInfo));
+}
+
+static void DetectConfiguration(void)
+{
+    HV_CPUID_INFO info;
     
-    if (strcmp(vendor, "Microsoft Hv") == 0) {
-        /* Check if root partition */
-        __cpuid(cpuInfo, 0x40000003);
-        if (cpuInfo[1] & 0x01) {
-            strcpy_s(g_configName, sizeof(g_configName), "HyperV-RootPartition");
-        } else {
-            strcpy_s(g_configName, sizeof(g_configName), "HyperV-GuestVM");
-        }
-    } else {
-        snprintf(g_configName, sizeof(g_configName), "OtherHypervisor-%s", vendor);
-    }
+    /* Same classification the Replay fixtures assert (detection_rules.h) */
+    HvCpuidDecode(LiveCpuidSource, NULL, &info);
+    HvClassifyPartition(&info, g_configName, sizeof(g_configName));
 }
 
 int main(int argc, char* argv[])
 {
-    const char* currentCategory = NULL;
+    TEST_RUN_OPTIONS options;
+    PTEST_CASE tests = NULL;
+    int count = 0;
+    int exitCode = 0;
     int i = 0;
     
     /* Parse arguments */
     for (i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "--json") == 0) {
-            g_jsonOutput = TRUE;
-        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
             strcpy_s(g_configName, sizeof(g_configName), argv[++i]);
         } else if (strcmp(argv[i], "--help") == 0) {
             PrintUsage(argv[0]);
             return 0;
         }
     }
+    if (ParseTestRunOptions(argc, argv, &options) != 0) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
     
     /* Initialize */
     EnableConsoleColors();
     g_isAdmin = CheckIsAdmin();
     g_hasHypervisor = CheckHypervisorPresent();
     
+    tests = BuildTestList(&count);
+    if (tests == NULL) {
+        return 2;
+    }
+    
+    /* Worker process: run one test and report, no console output */
+    if (options.workerTest >= 0) {
+        exitCode = RunTestWorker(tests, count, &options);
+        free(tests);
+        return exitCode;
+    }
+    
     if (strcmp(g_configName, "unknown") == 0) {
         DetectConfiguration();
     }
     
     /* Print header */
-    if (!g_jsonOutput) {
+    if (!options.jsonOutput) {
         printf("\n");
         printf("%s========================================%s\n", COLOR_CYAN, COLOR_RESET);
         printf("     HYPER-V DETECTOR TEST SUITE\n");
@@ -2062,31 +2403,15 @@ int main(int argc, char* argv[])
         printf("  Configuration: %s\n", g_configName);
         printf("  Administrator: %s\n", g_isAdmin ? "Yes" : "No");
         printf("  Hypervisor:    %s\n", g_hasHypervisor ? "Present" : "Not detected");
-        printf("%s========================================%s\n", COLOR_CYAN, COLOR_RESET);
-    }
-    
-    /* Run tests */
-    g_testStats.startTime = GetTickCount();
-    
-    for (i = 0; g_testCases[i].name != NULL; i++) {
-        /* Print category header if changed */
-        if (!g_jsonOutput && 
-            (currentCategory == NULL || strcmp(currentCategory, g_testCases[i].category) != 0)) {
-            currentCategory = g_testCases[i].category;
-            PrintCategoryHeader(currentCategory);
+        if (options.isolate) {
+            printf("  Workers:       %d process(es)\n", options.jobs);
         }
-        
-        RunTest(&g_testCases[i], g_isAdmin, g_hasHypervisor);
+        printf("%s========================================%s\n", COLOR_CYAN, COLOR_RESET);
     }
     
-    g_testStats.endTime = GetTickCount();
-    
-    /* Print summary */
-    if (g_jsonOutput) {
-        PrintJsonResult(g_configName);
-    } else {
-        PrintTestSummary();
-    }
+    /* Run tests, print summary / JSON / JUnit */
+    exitCode = RunTestMain(tests, count, &options, g_configName, g_isAdmin, g_hasHypervisor);
     
-    return (g_testStats.failed > 0 || g_testStats.errors > 0) ? 1 : 0;
+    free(tests);
+    return exitCode;
 }
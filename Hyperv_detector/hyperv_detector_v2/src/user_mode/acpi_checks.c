@@ -14,6 +14,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "../common/firmware_parse.h"
 #include <stdio.h>
 
 #define HYPERV_DETECTED_ACPI 0x02000000
@@ -40,49 +41,6 @@
 #define ACPI_WAET_RTC_GOOD       (1 << 0)  /* RTC device doesn't lose time */
 #define ACPI_WAET_PM_TIMER_GOOD  (1 << 1)  /* ACPI PM timer good for single read */
 
-/* ACPI table header structure */
-#pragma pack(push, 1)
-typedef struct _ACPI_TABLE_HEADER {
-    DWORD Signature;
-    DWORD Length;
-    BYTE  Revision;
-    BYTE  Checksum;
-    CHAR  OemId[6];
-    CHAR  OemTableId[8];
-    DWORD OemRevision;
-    CHAR  CreatorId[4];
-    DWORD CreatorRevision;
-} ACPI_TABLE_HEADER, *PACPI_TABLE_HEADER;
-
-/* WAET table structure */
-typedef struct _ACPI_TABLE_WAET {
-    ACPI_TABLE_HEADER Header;
-    DWORD EmulatedDeviceFlags;
-} ACPI_TABLE_WAET, *PACPI_TABLE_WAET;
-#pragma pack(pop)
-
-/* Known VM OEM IDs */
-typedef struct _OEM_ID_INFO {
-    const char* oemId;
-    const char* vmType;
-    BOOL isHyperV;
-} OEM_ID_INFO;
-
-static const OEM_ID_INFO g_KnownOemIds[] = {
-    {"VRTUAL", "Hyper-V", TRUE},
-    {"MSFT  ", "Hyper-V", TRUE},
-    {"Msft  ", "Hyper-V", TRUE},
-    {"MSHYPR", "Hyper-V", TRUE},
-    {"VMWARE", "VMware", FALSE},
-    {"VBOX  ", "VirtualBox", FALSE},
-    {"QEMU  ", "QEMU", FALSE},
-    {"BOCHS ", "Bochs", FALSE},
-    {"AMAZON", "AWS", FALSE},
-    {"Google", "GCP", FALSE},
-    {"INTEL ", "Intel", FALSE},  /* May appear in various VMs */
-    {NULL, NULL, FALSE}
-};
-
 /* ACPI detection results */
 typedef struct _ACPI_DETECTION_INFO {
     BOOL hasWAET;
@@ -170,25 +128,13 @@ static BOOL GetAcpiTable(DWORD signature, void** table, DWORD* size)
  */
 static const char* CheckOemIdForVM(const char* oemId, BOOL* isHyperV)
 {
-    int i;
-    char normalizedId[8] = {0};
-    
-    /* Normalize OEM ID (copy first 6 chars) */
-    memcpy(normalizedId, oemId, 6);
-    
-    for (i = 0; g_KnownOemIds[i].oemId != NULL; i++) {
-        if (strncmp(normalizedId, g_KnownOemIds[i].oemId, 6) == 0) {
-            if (isHyperV) {
-                *isHyperV = g_KnownOemIds[i].isHyperV;
-            }
-            return g_KnownOemIds[i].vmType;
-        }
-    }
+    int hyperV = 0;
+    const char* vmType = HvAcpiOemVmType(oemId, &hyperV);
     
     if (isHyperV) {
-        *isHyperV = FALSE;
+        *isHyperV = hyperV ? TRUE : FALSE;
     }
-    return NULL;
+    return vmType;
 }
 
 /*
@@ -196,24 +142,24 @@ static const char* CheckOemIdForVM(const char* oemId, BOOL* isHyperV)
  */
 static BOOL CheckWAETTable(PACPI_DETECTION_INFO info)
 {
-    PACPI_TABLE_WAET waet = NULL;
+    void* waet = NULL;
     DWORD size = 0;
+    HV_ACPI_TABLE_INFO header;
+    UINT32 flags = 0;
     
-    if (!GetAcpiTable(ACPI_SIG_WAET, (void**)&waet, &size)) {
+    if (!GetAcpiTable(ACPI_SIG_WAET, &waet, &size)) {
         return FALSE;
     }
     
-    if (size >= sizeof(ACPI_TABLE_WAET)) {
+    if (HvAcpiWaetFlags(waet, size, &flags) == 0 &&
+        HvAcpiParseHeader(waet, size, &header) == 0) {
         info->hasWAET = TRUE;
-        info->waetFlags = waet->EmulatedDeviceFlags;
+        info->waetFlags = flags;
         
         /* Copy OEM info */
-        memcpy(info->oemId, waet->Header.OemId, 6);
-        info->oemId[6] = '\0';
-        memcpy(info->oemTableId, waet->Header.OemTableId, 8);
-        info->oemTableId[8] = '\0';
-        memcpy(info->creatorId, waet->Header.CreatorId, 4);
-        info->creatorId[4] = '\0';
+        strcpy(info->oemId, header.OemId);
+        strcpy(info->oemTableId, header.OemTableId);
+        strcpy(info->creatorId, header.CreatorId);
         
         /* Check OEM ID for VM type */
         info->detectedVmType = CheckOemIdForVM(info->oemId, &info->isHyperV);
@@ -231,8 +177,9 @@ static void GatherAcpiInfo(PACPI_DETECTION_INFO info)
     DWORD* signatures = NULL;
     DWORD count = 0;
     DWORD i;
-    PACPI_TABLE_HEADER header = NULL;
+    void* table = NULL;
     DWORD size = 0;
+    HV_ACPI_TABLE_INFO header;
     
     if (info == NULL) {
         return;
@@ -273,13 +220,12 @@ static void GatherAcpiInfo(PACPI_DETECTION_INFO info)
     
     /* If no VM detected from WAET, try FACP */
     if (info->detectedVmType == NULL) {
-        if (GetAcpiTable(ACPI_SIG_FACP, (void**)&header, &size)) {
-            if (size >= sizeof(ACPI_TABLE_HEADER)) {
-                memcpy(info->oemId, header->OemId, 6);
-                info->oemId[6] = '\0';
+        if (GetAcpiTable(ACPI_SIG_FACP, &table, &size)) {
+            if (HvAcpiParseHeader(table, size, &header) == 0) {
+                strcpy(info->oemId, header.OemId);
                 info->detectedVmType = CheckOemIdForVM(info->oemId, &info->isHyperV);
             }
-            free(header);
+            free(table);
         }
     }
 }
@@ -356,21 +302,21 @@ BOOL HasWAETTable(void)
  */
 BOOL GetAcpiOemId(char* buffer, size_t bufferSize)
 {
-    PACPI_TABLE_HEADER header = NULL;
+    void* table = NULL;
     DWORD size = 0;
+    HV_ACPI_TABLE_INFO header;
     
     if (buffer == NULL || bufferSize < 7) {
         return FALSE;
     }
     
-    if (GetAcpiTable(ACPI_SIG_FACP, (void**)&header, &size)) {
-        if (size >= sizeof(ACPI_TABLE_HEADER)) {
-            memcpy(buffer, header->OemId, 6);
-            buffer[6] = '\0';
-            free(header);
+    if (GetAcpiTable(ACPI_SIG_FACP, &table, &size)) {
+        if (HvAcpiParseHeader(table, size, &header) == 0) {
+            strcpy(buffer, header.OemId);
+            free(table);
             return TRUE;
         }
-        free(header);
+        free(table);
     }
     
     return FALSE;
@@ -18,16 +18,6 @@ typedef struct _SMBIOS_SYSTEM_INFO {
     BYTE Family;
 } SMBIOS_SYSTEM_INFO, *PSMBIOS_SYSTEM_INFO;
 
-static const char* HYPERV_BIOS_STRINGS[] = {
-    "Microsoft Corporation",
-    "Hyper-V",
-    "Virtual Machine",
-    "VRTUAL",
-    "A M I",
-    "American Megatrends",
-    NULL
-};
-
 DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
     DWORD detected = 0;
     HKEY hKey;
@@ -36,17 +26,14 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
     DWORD type;
     
     // Check BIOS information from registry
-    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\BIOS", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_BIOS, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
         // Check BIOS Vendor
         bufferSize = sizeof(buffer);
         if (RegQueryValueExA(hKey, "BIOSVendor", NULL, &type, (LPBYTE)buffer, &bufferSize) == ERROR_SUCCESS) {
             AppendToDetails(result, "BIOS: Vendor: %s\n", buffer);
-            for (int i = 0; HYPERV_BIOS_STRINGS[i] != NULL; i++) {
-                if (strstr(buffer, HYPERV_BIOS_STRINGS[i])) {
-                    detected |= HYPERV_DETECTED_BIOS;
-                    AppendToDetails(result, "BIOS: Hyper-V BIOS vendor detected\n");
-                    break;
-                }
+            if (HvRuleMatch(buffer, HvBiosStrings()) >= 0) {
+                detected |= HYPERV_DETECTED_BIOS;
+                AppendToDetails(result, "BIOS: Hyper-V BIOS vendor detected\n");
             }
         }
         
@@ -54,12 +41,9 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
         bufferSize = sizeof(buffer);
         if (RegQueryValueExA(hKey, "BIOSVersion", NULL, &type, (LPBYTE)buffer, &bufferSize) == ERROR_SUCCESS) {
             AppendToDetails(result, "BIOS: Version: %s\n", buffer);
-            for (int i = 0; HYPERV_BIOS_STRINGS[i] != NULL; i++) {
-                if (strstr(buffer, HYPERV_BIOS_STRINGS[i])) {
-                    detected |= HYPERV_DETECTED_BIOS;
-                    AppendToDetails(result, "BIOS: Hyper-V BIOS version detected\n");
-                    break;
-                }
+            if (HvRuleMatch(buffer, HvBiosStrings()) >= 0) {
+                detected |= HYPERV_DETECTED_BIOS;
+                AppendToDetails(result, "BIOS: Hyper-V BIOS version detected\n");
             }
         }
         
@@ -67,7 +51,7 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
         bufferSize = sizeof(buffer);
         if (RegQueryValueExA(hKey, "SystemManufacturer", NULL, &type, (LPBYTE)buffer, &bufferSize) == ERROR_SUCCESS) {
             AppendToDetails(result, "BIOS: System Manufacturer: %s\n", buffer);
-            if (strstr(buffer, "Microsoft Corporation")) {
+            if (strstr(buffer, HV_BIOS_MANUFACTURER)) {
                 detected |= HYPERV_DETECTED_BIOS;
                 AppendToDetails(result, "BIOS: Microsoft system manufacturer detected\n");
             }
@@ -77,7 +61,7 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
         bufferSize = sizeof(buffer);
         if (RegQueryValueExA(hKey, "SystemProductName", NULL, &type, (LPBYTE)buffer, &bufferSize) == ERROR_SUCCESS) {
             AppendToDetails(result, "BIOS: System Product: %s\n", buffer);
-            if (strstr(buffer, "Virtual Machine")) {
+            if (strstr(buffer, HV_BIOS_PRODUCT)) {
                 detected |= HYPERV_DETECTED_BIOS;
                 AppendToDetails(result, "BIOS: Virtual Machine product detected\n");
             }
@@ -87,11 +71,11 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
     }
     
     // Check ACPI tables for Hyper-V signatures
-    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\ACPI\\DSDT", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_ACPI_DSDT, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
         DWORD index = 0;
         char keyName[256];
         while (RegEnumKeyA(hKey, index++, keyName, sizeof(keyName)) == ERROR_SUCCESS) {
-            if (strstr(keyName, "VRTUAL") || strstr(keyName, "MSFT")) {
+            if (HvDsdtKeyIsHyperV(keyName)) {
                 detected |= HYPERV_DETECTED_BIOS;
                 AppendToDetails(result, "ACPI: Found Hyper-V ACPI table: %s\n", keyName);
             }
@@ -100,10 +84,10 @@ DWORD CheckBiosHyperV(PDETECTION_RESULT result) {
     }
     
     // Check for UEFI variables
-    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "SYSTEM\\CurrentControlSet\\Control\\SecureBoot\\State", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_SECUREBOOT_STATE, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
         DWORD secureBootEnabled = 0;
         bufferSize = sizeof(secureBootEnabled);
-        if (RegQueryValueExA(hKey, "UEFISecureBootEnabled", NULL, &type, (LPBYTE)&secureBootEnabled, &bufferSize) == ERROR_SUCCESS) {
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_SECUREBOOT, NULL, &type, (LPBYTE)&secureBootEnabled, &bufferSize) == ERROR_SUCCESS) {
             AppendToDetails(result, "UEFI: Secure Boot %s\n", secureBootEnabled ? "Enabled" : "Disabled");
         }
         RegCloseKey(hKey);
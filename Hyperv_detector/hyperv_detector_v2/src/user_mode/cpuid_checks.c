@@ -1,4 +1,5 @@
 #include "hyperv_detector.h"
+#include "../common/cpuid_decode.h"
 
 void ExecuteCpuid(DWORD function, PCPUID_RESULT result) {
 #if ARCH_X86_OR_X64
@@ -13,8 +14,34 @@ void ExecuteCpuid(DWORD function, PCPUID_RESULT result) {
 #endif
 }
 
-DWORD CheckCpuidHyperV(PDETECTION_RESULT result) {
+/*
+ * HV_CPUID_SOURCE over the executing processor
+ */
+static void LiveCpuidSource(void* context, UINT32 leaf, UINT32 subleaf, UINT32 regs[4]) {
     CPUID_RESULT cpuid_result;
+
+    (void)context;
+    (void)subleaf;
+    ExecuteCpuid(leaf, &cpuid_result);
+    regs[0] = cpuid_result.eax;
+    regs[1] = cpuid_result.ebx;
+    regs[2] = cpuid_result.ecx;
+    regs[3] = cpuid_result.edx;
+}
+
+/*
+ * Decoded hypervisor leaves of the executing processor (zeroed on ARM64)
+ */
+void GetCpuidInfo(PHV_CPUID_INFO info) {
+#if ARCH_X86_OR_X64
+    HvCpuidDecode(LiveCpuidSource, NULL, info);
+#else
+    memset(info, 0, sizeof(*info));
+#endif
+}
+
+DWORD CheckCpuidHyperV(PDETECTION_RESULT result) {
+    HV_CPUID_INFO info;
     DWORD detected = 0;
 
 #if !ARCH_X86_OR_X64
@@ -22,57 +49,39 @@ DWORD CheckCpuidHyperV(PDETECTION_RESULT result) {
     return 0;
 #endif
 
+    GetCpuidInfo(&info);
+
     // Check for hypervisor presence
-    ExecuteCpuid(1, &cpuid_result);
-    if (cpuid_result.ecx & (1 << 31)) {
+    if (info.HypervisorPresent) {
         detected |= HYPERV_DETECTED_CPUID;
         AppendToDetails(result, "CPUID: Hypervisor present bit set\n");
+        AppendToDetails(result, "CPUID: Hypervisor vendor: %s\n", info.Vendor);
         
-        // Check hypervisor vendor
-        ExecuteCpuid(CPUID_HYPERVISOR_PRESENT, &cpuid_result);
-        char vendor[13] = {0};
-        memcpy(vendor, &cpuid_result.ebx, 4);
-        memcpy(vendor + 4, &cpuid_result.ecx, 4);
-        memcpy(vendor + 8, &cpuid_result.edx, 4);
-        
-        AppendToDetails(result, "CPUID: Hypervisor vendor: %s\n", vendor);
-        
-        if (strcmp(vendor, "Microsoft Hv") == 0) {
+        if (strcmp(info.Vendor, "Microsoft Hv") == 0) {
             AppendToDetails(result, "CPUID: Microsoft Hyper-V detected\n");
-            
-            // Check Hyper-V interface
-            ExecuteCpuid(CPUID_HYPERV_INTERFACE, &cpuid_result);
-            AppendToDetails(result, "CPUID: Hyper-V interface signature: %08X\n", cpuid_result.eax);
-            
-            // Check Hyper-V version
-            ExecuteCpuid(CPUID_HYPERV_VERSION, &cpuid_result);
-            AppendToDetails(result, "CPUID: Hyper-V version: %d.%d.%d\n", 
-                           cpuid_result.ebx >> 16, 
-                           cpuid_result.ebx & 0xFFFF, 
-                           cpuid_result.eax);
-            
-            // Check Hyper-V features
-            ExecuteCpuid(CPUID_HYPERV_FEATURES, &cpuid_result);
+            AppendToDetails(result, "CPUID: Hyper-V interface signature: %08X\n", info.Interface);
+            AppendToDetails(result, "CPUID: Hyper-V version: %u.%u.%u\n",
+                           info.MajorVersion, info.MinorVersion, info.BuildNumber);
             AppendToDetails(result, "CPUID: Hyper-V features: EAX=%08X, EBX=%08X, ECX=%08X, EDX=%08X\n",
-                           cpuid_result.eax, cpuid_result.ebx, cpuid_result.ecx, cpuid_result.edx);
+                           info.PartitionPrivileges, info.PartitionFlags, info.PowerFeatures, info.MiscFeatures);
             
             // Check for enlightenments
-            if (cpuid_result.eax & 0x01) {
+            if (info.PartitionPrivileges & 0x01) {
                 AppendToDetails(result, "CPUID: VP Runtime MSR available\n");
             }
-            if (cpuid_result.eax & 0x02) {
+            if (info.PartitionPrivileges & 0x02) {
                 AppendToDetails(result, "CPUID: Partition Reference Counter MSR available\n");
             }
-            if (cpuid_result.eax & 0x04) {
+            if (info.PartitionPrivileges & 0x04) {
                 AppendToDetails(result, "CPUID: Synthetic Interrupt Controller available\n");
             }
-            if (cpuid_result.eax & 0x08) {
+            if (info.PartitionPrivileges & 0x08) {
                 AppendToDetails(result, "CPUID: Synthetic Timers available\n");
             }
-            if (cpuid_result.eax & 0x10) {
+            if (info.PartitionPrivileges & 0x10) {
                 AppendToDetails(result, "CPUID: APIC Access MSRs available\n");
             }
-            if (cpuid_result.eax & 0x20) {
+            if (info.PartitionPrivileges & 0x20) {
                 AppendToDetails(result, "CPUID: Hypercall MSRs available\n");
             }
         }
@@ -0,0 +1,678 @@
+/**
+ * device_index.c - Single-pass device tree index
+ *
+ * Enumerates the present device tree once and serves the device checks from
+ * hash chains keyed by enumerator ("VMBUS", "SCSI", "ROOT", ...) and by setup
+ * class GUID. A device is linked into the chain of every distinct enumerator
+ * found in its instance ID and hardware IDs, so prefix lookups only have to
+ * walk devices that share the prefix's enumerator.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "device_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <setupapi.h>
+#pragma comment(lib, "setupapi.lib")
+#endif
+
+#define DEVICE_INDEX_BUCKETS     256   /* power of two */
+#define DEVICE_INDEX_MAX_KEYS    8     /* distinct enumerators per device */
+#define DEVICE_INDEX_MAX_DEVICES 65536 /* sanity limit for snapshot files */
+
+/* Chain node: one link of a device into a bucket */
+typedef struct _INDEX_NODE {
+    int entry;
+    int next;
+} INDEX_NODE;
+
+typedef struct _INDEX_CHAINS {
+    INDEX_NODE* nodes;
+    size_t count;
+    size_t capacity;
+    int head[DEVICE_INDEX_BUCKETS];
+    int tail[DEVICE_INDEX_BUCKETS];
+} INDEX_CHAINS;
+
+struct _DEVICE_INDEX {
+    DEVICE_INDEX_ENTRY* entries;
+    size_t count;
+    size_t capacity;
+    INDEX_CHAINS byId;
+    INDEX_CHAINS byClass;
+};
+
+/* Process-wide index */
+static PDEVICE_INDEX g_deviceIndex = NULL;
+
+/* ============================================================================
+ * String helpers
+ * ============================================================================ */
+
+static char ToUpperAscii(char c)
+{
+    return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+/*
+ * FNV-1a over the upper-cased characters of s[0..length)
+ */
+static unsigned int HashKey(const char* s, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+
+    for (i = 0; i < length && s[i] != '\0'; i++) {
+        hash ^= (unsigned char)ToUpperAscii(s[i]);
+        hash *= 16777619u;
+    }
+    return hash & (DEVICE_INDEX_BUCKETS - 1);
+}
+
+static int StartsWithNoCase(const char* s, const char* prefix)
+{
+    while (*prefix != '\0') {
+        if (ToUpperAscii(*s) != ToUpperAscii(*prefix)) {
+            return 0;
+        }
+        s++;
+        prefix++;
+    }
+    return 1;
+}
+
+static int EqualsNoCase(const char* a, const char* b)
+{
+    while (*a != '\0' && ToUpperAscii(*a) == ToUpperAscii(*b)) {
+        a++;
+        b++;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+/*
+ * Length of the enumerator part of an ID ("VMBUS" in "VMBUS\{...}").
+ * Returns 0 when the ID has no enumerator separator.
+ */
+static size_t EnumeratorLength(const char* id)
+{
+    const char* slash = strchr(id, '\\');
+    return (slash != NULL) ? (size_t)(slash - id) : 0;
+}
+
+static int PrefixEqualsNoCase(const char* a, const char* b, size_t length)
+{
+    size_t i = 0;
+
+    for (i = 0; i < length; i++) {
+        if (ToUpperAscii(a[i]) != ToUpperAscii(b[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Search a REG_MULTI_SZ list for an ID containing substring
+ */
+const char* DeviceIndexIdListFind(const char* idList, const char* substring)
+{
+    const char* id = idList;
+
+    if (idList == NULL || substring == NULL) {
+        return NULL;
+    }
+
+    while (*id != '\0') {
+        if (strstr(id, substring) != NULL) {
+            return id;
+        }
+        id += strlen(id) + 1;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Hash chains
+ * ============================================================================ */
+
+static void ChainsInit(INDEX_CHAINS* chains)
+{
+    int i = 0;
+
+    memset(chains, 0, sizeof(*chains));
+    for (i = 0; i < DEVICE_INDEX_BUCKETS; i++) {
+        chains->head[i] = -1;
+        chains->tail[i] = -1;
+    }
+}
+
+/*
+ * Make room for extra nodes, so the inserts that follow cannot fail
+ */
+static int ChainsReserve(INDEX_CHAINS* chains, size_t extra)
+{
+    size_t newCapacity = chains->capacity ? chains->capacity : 256;
+    INDEX_NODE* grown = NULL;
+
+    if (chains->count + extra <= chains->capacity) {
+        return 0;
+    }
+    while (newCapacity < chains->count + extra) {
+        newCapacity *= 2;
+    }
+    grown = (INDEX_NODE*)realloc(chains->nodes, newCapacity * sizeof(INDEX_NODE));
+    if (grown == NULL) {
+        return -1;
+    }
+    chains->nodes = grown;
+    chains->capacity = newCapacity;
+    return 0;
+}
+
+static int ChainsInsert(INDEX_CHAINS* chains, unsigned int bucket, int entry)
+{
+    INDEX_NODE* node = NULL;
+    int position = 0;
+
+    if (ChainsReserve(chains, 1) != 0) {
+        return -1;
+    }
+
+    position = (int)chains->count++;
+    node = &chains->nodes[position];
+    node->entry = entry;
+    node->next = -1;
+
+    /* Append so chains stay in enumeration order */
+    if (chains->tail[bucket] < 0) {
+        chains->head[bucket] = position;
+    } else {
+        chains->nodes[chains->tail[bucket]].next = position;
+    }
+    chains->tail[bucket] = position;
+    return 0;
+}
+
+/*
+ * Does entry match an ID prefix (instance ID or any hardware ID)?
+ */
+static int EntryMatchesId(const DEVICE_INDEX_ENTRY* entry, const char* prefix)
+{
+    const char* id = entry->hardwareIds;
+
+    if (StartsWithNoCase(entry->instanceId, prefix)) {
+        return 1;
+    }
+    while (*id != '\0') {
+        if (StartsWithNoCase(id, prefix)) {
+            return 1;
+        }
+        id += strlen(id) + 1;
+    }
+    return 0;
+}
+
+/*
+ * Next matching entry in the prefix's chain with position > after
+ */
+static const DEVICE_INDEX_ENTRY* FindById(const DEVICE_INDEX* index, const char* prefix, int after)
+{
+    size_t enumLength = 0;
+    int node = 0;
+    size_t i = 0;
+
+    if (index == NULL || prefix == NULL) {
+        return NULL;
+    }
+
+    enumLength = EnumeratorLength(prefix);
+    if (enumLength == 0) {
+        /* No enumerator in the prefix - nothing to hash on */
+        for (i = (size_t)(after + 1); i < index->count; i++) {
+            if (EntryMatchesId(&index->entries[i], prefix)) {
+                return &index->entries[i];
+            }
+        }
+        return NULL;
+    }
+
+    for (node = index->byId.head[HashKey(prefix, enumLength)]; node >= 0;
+         node = index->byId.nodes[node].next) {
+        int entry = index->byId.nodes[node].entry;
+        if (entry > after && EntryMatchesId(&index->entries[entry], prefix)) {
+            return &index->entries[entry];
+        }
+    }
+    return NULL;
+}
+
+static const DEVICE_INDEX_ENTRY* FindByClass(const DEVICE_INDEX* index, const char* classGuid, int after)
+{
+    int node = 0;
+
+    if (index == NULL || classGuid == NULL) {
+        return NULL;
+    }
+
+    for (node = index->byClass.head[HashKey(classGuid, DEVICE_INDEX_CLASS_GUID_LEN)]; node >= 0;
+         node = index->byClass.nodes[node].next) {
+        int entry = index->byClass.nodes[node].entry;
+        if (entry > after && EqualsNoCase(index->entries[entry].classGuid, classGuid)) {
+            return &index->entries[entry];
+        }
+    }
+    return NULL;
+}
+
+static int EntryPosition(const DEVICE_INDEX* index, const DEVICE_INDEX_ENTRY* entry)
+{
+    if (entry == NULL) {
+        return -1;
+    }
+    return (int)(entry - index->entries);
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+PDEVICE_INDEX DeviceIndexCreate(void)
+{
+    PDEVICE_INDEX index = (PDEVICE_INDEX)calloc(1, sizeof(DEVICE_INDEX));
+
+    if (index == NULL) {
+        return NULL;
+    }
+    ChainsInit(&index->byId);
+    ChainsInit(&index->byClass);
+    return index;
+}
+
+void DeviceIndexFree(PDEVICE_INDEX index)
+{
+    if (index == NULL) {
+        return;
+    }
+    free(index->entries);
+    free(index->byId.nodes);
+    free(index->byClass.nodes);
+    free(index);
+}
+
+int DeviceIndexAdd(PDEVICE_INDEX index, const DEVICE_INDEX_ENTRY* entry)
+{
+    const char* keys[DEVICE_INDEX_MAX_KEYS];
+    size_t keyLengths[DEVICE_INDEX_MAX_KEYS];
+    int keyCount = 0;
+    DEVICE_INDEX_ENTRY* stored = NULL;
+    const char* id = NULL;
+    int position = 0;
+    int i = 0;
+    int j = 0;
+
+    if (index == NULL || entry == NULL) {
+        return -1;
+    }
+
+    if (index->count == index->capacity) {
+        size_t newCapacity = index->capacity ? index->capacity * 2 : 128;
+        DEVICE_INDEX_ENTRY* grown = (DEVICE_INDEX_ENTRY*)realloc(index->entries,
+                                        newCapacity * sizeof(DEVICE_INDEX_ENTRY));
+        if (grown == NULL) {
+            return -1;
+        }
+        index->entries = grown;
+        index->capacity = newCapacity;
+    }
+
+    position = (int)index->count;
+    stored = &index->entries[position];
+    memcpy(stored, entry, sizeof(*stored));
+
+    /* Guarantee termination of every field, including the double-NUL lists */
+    stored->instanceId[DEVICE_INDEX_INSTANCE_ID_LEN - 1] = '\0';
+    stored->hardwareIds[DEVICE_INDEX_ID_LIST_LEN - 2] = '\0';
+    stored->hardwareIds[DEVICE_INDEX_ID_LIST_LEN - 1] = '\0';
+    stored->compatibleIds[DEVICE_INDEX_ID_LIST_LEN - 2] = '\0';
+    stored->compatibleIds[DEVICE_INDEX_ID_LIST_LEN - 1] = '\0';
+    stored->description[DEVICE_INDEX_DESCRIPTION_LEN - 1] = '\0';
+    stored->classGuid[DEVICE_INDEX_CLASS_GUID_LEN - 1] = '\0';
+    stored->service[DEVICE_INDEX_SERVICE_LEN - 1] = '\0';
+    stored->location[DEVICE_INDEX_LOCATION_LEN - 1] = '\0';
+
+    /* Collect distinct enumerators from the instance ID and hardware IDs */
+    id = stored->instanceId;
+    for (;;) {
+        size_t length = EnumeratorLength(id);
+        if (length > 0 && keyCount < DEVICE_INDEX_MAX_KEYS) {
+            int duplicate = 0;
+            for (j = 0; j < keyCount && !duplicate; j++) {
+                duplicate = (keyLengths[j] == length && PrefixEqualsNoCase(keys[j], id, length));
+            }
+            if (!duplicate) {
+                keys[keyCount] = id;
+                keyLengths[keyCount] = length;
+                keyCount++;
+            }
+        }
+
+        id = (id == stored->instanceId) ? stored->hardwareIds : id + strlen(id) + 1;
+        if (*id == '\0') {
+            break;
+        }
+    }
+
+    /*
+     * Reserve every node first: a failure after the first insert would leave
+     * a chain pointing at this slot, which the next add reuses.
+     */
+    if (ChainsReserve(&index->byId, (size_t)keyCount) != 0 ||
+        ChainsReserve(&index->byClass, 1) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < keyCount; i++) {
+        if (ChainsInsert(&index->byId, HashKey(keys[i], keyLengths[i]), position) != 0) {
+            return -1;
+        }
+    }
+    if (stored->classGuid[0] != '\0') {
+        if (ChainsInsert(&index->byClass,
+                         HashKey(stored->classGuid, DEVICE_INDEX_CLASS_GUID_LEN), position) != 0) {
+            return -1;
+        }
+    }
+
+    index->count++;
+    return 0;
+}
+
+size_t DeviceIndexCount(const DEVICE_INDEX* index)
+{
+    return (index != NULL) ? index->count : 0;
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexAt(const DEVICE_INDEX* index, size_t position)
+{
+    if (index == NULL || position >= index->count) {
+        return NULL;
+    }
+    return &index->entries[position];
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexFirstById(const DEVICE_INDEX* index, const char* prefix)
+{
+    return FindById(index, prefix, -1);
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexNextById(const DEVICE_INDEX* index, const char* prefix,
+                                              const DEVICE_INDEX_ENTRY* previous)
+{
+    if (index == NULL || previous == NULL) {
+        return NULL;
+    }
+    return FindById(index, prefix, EntryPosition(index, previous));
+}
+
+size_t DeviceIndexCountById(const DEVICE_INDEX* index, const char* prefix)
+{
+    const DEVICE_INDEX_ENTRY* entry = NULL;
+    size_t count = 0;
+
+    for (entry = DeviceIndexFirstById(index, prefix); entry != NULL;
+         entry = DeviceIndexNextById(index, prefix, entry)) {
+        count++;
+    }
+    return count;
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexFirstByClass(const DEVICE_INDEX* index, const char* classGuid)
+{
+    return FindByClass(index, classGuid, -1);
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexNextByClass(const DEVICE_INDEX* index, const char* classGuid,
+                                                 const DEVICE_INDEX_ENTRY* previous)
+{
+    if (index == NULL || previous == NULL) {
+        return NULL;
+    }
+    return FindByClass(index, classGuid, EntryPosition(index, previous));
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexFindDescription(const DEVICE_INDEX* index, const char* substring)
+{
+    size_t i = 0;
+
+    if (index == NULL || substring == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < index->count; i++) {
+        if (strstr(index->entries[i].description, substring) != NULL) {
+            return &index->entries[i];
+        }
+    }
+    return NULL;
+}
+
+const DEVICE_INDEX_ENTRY* DeviceIndexFindService(const DEVICE_INDEX* index, const char* service)
+{
+    size_t i = 0;
+
+    if (index == NULL || service == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < index->count; i++) {
+        if (EqualsNoCase(index->entries[i].service, service)) {
+            return &index->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Snapshot persistence
+ *
+ * Layout (little-endian):
+ *   UINT32 magic, UINT32 version, UINT32 entrySize, UINT32 count
+ *   count * DEVICE_INDEX_ENTRY
+ * ============================================================================ */
+
+static int WriteU32(FILE* file, unsigned int value)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char)(value);
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)(value >> 16);
+    bytes[3] = (unsigned char)(value >> 24);
+    return (fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes)) ? 0 : -1;
+}
+
+static int ReadU32(FILE* file, unsigned int* value)
+{
+    unsigned char bytes[4];
+
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+        return -1;
+    }
+    *value = (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+             ((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+    return 0;
+}
+
+int DeviceIndexSave(const DEVICE_INDEX* index, const char* path)
+{
+    FILE* file = NULL;
+    int status = 0;
+
+    if (index == NULL || path == NULL) {
+        return -1;
+    }
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    if (WriteU32(file, DEVICE_INDEX_FILE_MAGIC) != 0 ||
+        WriteU32(file, DEVICE_INDEX_FILE_VERSION) != 0 ||
+        WriteU32(file, (unsigned int)sizeof(DEVICE_INDEX_ENTRY)) != 0 ||
+        WriteU32(file, (unsigned int)index->count) != 0) {
+        status = -1;
+    } else if (index->count > 0 &&
+               fwrite(index->entries, sizeof(DEVICE_INDEX_ENTRY), index->count, file) != index->count) {
+        status = -1;
+    }
+
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+PDEVICE_INDEX DeviceIndexLoad(const char* path)
+{
+    FILE* file = NULL;
+    PDEVICE_INDEX index = NULL;
+    DEVICE_INDEX_ENTRY entry;
+    unsigned int magic = 0;
+    unsigned int version = 0;
+    unsigned int entrySize = 0;
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+    if (path == NULL) {
+        return NULL;
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    if (ReadU32(file, &magic) != 0 || ReadU32(file, &version) != 0 ||
+        ReadU32(file, &entrySize) != 0 || ReadU32(file, &count) != 0 ||
+        magic != DEVICE_INDEX_FILE_MAGIC || version != DEVICE_INDEX_FILE_VERSION ||
+        entrySize != sizeof(DEVICE_INDEX_ENTRY) || count > DEVICE_INDEX_MAX_DEVICES) {
+        fclose(file);
+        return NULL;
+    }
+
+    index = DeviceIndexCreate();
+    if (index == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    /* Re-adding rebuilds the hash chains */
+    for (i = 0; i < count; i++) {
+        if (fread(&entry, sizeof(entry), 1, file) != 1 || DeviceIndexAdd(index, &entry) != 0) {
+            DeviceIndexFree(index);
+            fclose(file);
+            return NULL;
+        }
+    }
+
+    fclose(file);
+    return index;
+}
+
+/* ============================================================================
+ * Enumeration
+ * ============================================================================ */
+
+#ifdef _WIN32
+/*
+ * Read a string property; multi-string buffers keep room for the final NUL
+ */
+static void ReadDeviceProperty(HDEVINFO hDevInfo, PSP_DEVINFO_DATA devInfoData,
+                               DWORD property, char* buffer, DWORD bufferSize)
+{
+    if (!SetupDiGetDeviceRegistryPropertyA(hDevInfo, devInfoData, property, NULL,
+                                           (PBYTE)buffer, bufferSize - 2, NULL)) {
+        buffer[0] = '\0';
+        buffer[1] = '\0';
+    }
+}
+
+PDEVICE_INDEX DeviceIndexBuild(void)
+{
+    HDEVINFO hDevInfo = INVALID_HANDLE_VALUE;
+    SP_DEVINFO_DATA devInfoData;
+    DEVICE_INDEX_ENTRY entry;
+    PDEVICE_INDEX index = NULL;
+    DWORD i = 0;
+
+    hDevInfo = SetupDiGetClassDevsA(NULL, NULL, NULL, DIGCF_ALLCLASSES | DIGCF_PRESENT);
+    if (hDevInfo == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    index = DeviceIndexCreate();
+    if (index == NULL) {
+        SetupDiDestroyDeviceInfoList(hDevInfo);
+        return NULL;
+    }
+
+    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    for (i = 0; SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
+        memset(&entry, 0, sizeof(entry));
+
+        if (!SetupDiGetDeviceInstanceIdA(hDevInfo, &devInfoData, entry.instanceId,
+                                         sizeof(entry.instanceId), NULL)) {
+            continue;
+        }
+
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_HARDWAREID,
+                           entry.hardwareIds, sizeof(entry.hardwareIds));
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_COMPATIBLEIDS,
+                           entry.compatibleIds, sizeof(entry.compatibleIds));
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_DEVICEDESC,
+                           entry.description, sizeof(entry.description));
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_CLASSGUID,
+                           entry.classGuid, sizeof(entry.classGuid));
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_SERVICE,
+                           entry.service, sizeof(entry.service));
+        ReadDeviceProperty(hDevInfo, &devInfoData, SPDRP_LOCATION_INFORMATION,
+                           entry.location, sizeof(entry.location));
+
+        if (DeviceIndexAdd(index, &entry) != 0) {
+            break;
+        }
+    }
+
+    SetupDiDestroyDeviceInfoList(hDevInfo);
+    return index;
+}
+#endif
+
+const DEVICE_INDEX* GetDeviceIndex(void)
+{
+    if (g_deviceIndex == NULL) {
+#ifdef _WIN32
+        g_deviceIndex = DeviceIndexBuild();
+#endif
+        if (g_deviceIndex == NULL) {
+            g_deviceIndex = DeviceIndexCreate();
+        }
+    }
+    return g_deviceIndex;
+}
+
+void SetDeviceIndex(PDEVICE_INDEX index)
+{
+    if (g_deviceIndex != NULL && g_deviceIndex != index) {
+        DeviceIndexFree(g_deviceIndex);
+    }
+    g_deviceIndex = index;
+}
@@ -0,0 +1,128 @@
+/**
+ * device_index.h - Single-pass device tree index
+ *
+ * The whole present device tree is enumerated once with SetupDi and the
+ * properties the checks care about (hardware IDs, compatible IDs, class GUID,
+ * service, location) are prefetched into an in-memory index. Device checks
+ * then become hash lookups against the index instead of running their own
+ * SetupDiGetClassDevs walk.
+ *
+ * Lookups are keyed by hardware-ID prefix ("VMBUS\\", "SCSI\\DiskMsft", ...)
+ * and by setup class GUID. The index can be saved to and loaded from a file
+ * so a captured device tree can be replayed offline.
+ *
+ * The index itself is plain C and builds on any platform; only
+ * DeviceIndexBuild() needs SetupAPI.
+ */
+
+#pragma once
+#ifndef DEVICE_INDEX_H
+#define DEVICE_INDEX_H
+
+#include <stddef.h>
+
+/* Field sizes (all fields are NUL-terminated, ID lists are double-NUL) */
+#define DEVICE_INDEX_INSTANCE_ID_LEN   260
+#define DEVICE_INDEX_ID_LIST_LEN       512
+#define DEVICE_INDEX_DESCRIPTION_LEN   256
+#define DEVICE_INDEX_CLASS_GUID_LEN    40
+#define DEVICE_INDEX_SERVICE_LEN       64
+#define DEVICE_INDEX_LOCATION_LEN      128
+
+/* Snapshot file format */
+#define DEVICE_INDEX_FILE_MAGIC        0x49445648  /* "HVDI" */
+#define DEVICE_INDEX_FILE_VERSION      1
+
+/*
+ * One present device. Only character data, so the layout is identical on
+ * every compiler and the record can be written to a snapshot file as-is.
+ */
+typedef struct _DEVICE_INDEX_ENTRY {
+    char instanceId[DEVICE_INDEX_INSTANCE_ID_LEN];
+    char hardwareIds[DEVICE_INDEX_ID_LIST_LEN];      /* REG_MULTI_SZ */
+    char compatibleIds[DEVICE_INDEX_ID_LIST_LEN];    /* REG_MULTI_SZ */
+    char description[DEVICE_INDEX_DESCRIPTION_LEN];
+    char classGuid[DEVICE_INDEX_CLASS_GUID_LEN];     /* "{4d36e968-...}" */
+    char service[DEVICE_INDEX_SERVICE_LEN];
+    char location[DEVICE_INDEX_LOCATION_LEN];
+} DEVICE_INDEX_ENTRY, *PDEVICE_INDEX_ENTRY;
+
+typedef struct _DEVICE_INDEX DEVICE_INDEX, *PDEVICE_INDEX;
+
+/* Well-known setup class GUIDs (devguid.h) */
+#define DEVICE_CLASS_DISPLAY       "{4d36e968-e325-11ce-bfc1-08002be10318}"
+#define DEVICE_CLASS_SCSIADAPTER   "{4d36e97b-e325-11ce-bfc1-08002be10318}"
+#define DEVICE_CLASS_DISKDRIVE     "{4d36e967-e325-11ce-bfc1-08002be10318}"
+#define DEVICE_CLASS_NET           "{4d36e972-e325-11ce-bfc1-08002be10318}"
+#define DEVICE_CLASS_SYSTEM        "{4d36e97d-e325-11ce-bfc1-08002be10318}"
+
+/*
+ * Lifetime
+ */
+PDEVICE_INDEX DeviceIndexCreate(void);
+void DeviceIndexFree(PDEVICE_INDEX index);
+
+/*
+ * Add a device. The entry is copied; returns 0 on success, -1 on allocation failure.
+ */
+int DeviceIndexAdd(PDEVICE_INDEX index, const DEVICE_INDEX_ENTRY* entry);
+
+size_t DeviceIndexCount(const DEVICE_INDEX* index);
+const DEVICE_INDEX_ENTRY* DeviceIndexAt(const DEVICE_INDEX* index, size_t position);
+
+/*
+ * Hardware-ID prefix lookups (case-insensitive). A device matches when its
+ * instance ID or any of its hardware IDs starts with the prefix. Iterate with
+ * First/Next; Next takes the previously returned entry.
+ */
+const DEVICE_INDEX_ENTRY* DeviceIndexFirstById(const DEVICE_INDEX* index, const char* prefix);
+const DEVICE_INDEX_ENTRY* DeviceIndexNextById(const DEVICE_INDEX* index, const char* prefix,
+                                              const DEVICE_INDEX_ENTRY* previous);
+size_t DeviceIndexCountById(const DEVICE_INDEX* index, const char* prefix);
+
+/*
+ * Setup class lookups by class GUID string (case-insensitive)
+ */
+const DEVICE_INDEX_ENTRY* DeviceIndexFirstByClass(const DEVICE_INDEX* index, const char* classGuid);
+const DEVICE_INDEX_ENTRY* DeviceIndexNextByClass(const DEVICE_INDEX* index, const char* classGuid,
+                                                 const DEVICE_INDEX_ENTRY* previous);
+
+/*
+ * Scans over the prefetched data (no SetupDi calls)
+ */
+const DEVICE_INDEX_ENTRY* DeviceIndexFindDescription(const DEVICE_INDEX* index, const char* substring);
+const DEVICE_INDEX_ENTRY* DeviceIndexFindService(const DEVICE_INDEX* index, const char* service);
+
+/*
+ * Helpers for REG_MULTI_SZ ID lists
+ */
+const char* DeviceIndexIdListFind(const char* idList, const char* substring);
+
+/*
+ * Snapshot persistence for offline replay. Return 0 on success, -1 on error.
+ */
+int DeviceIndexSave(const DEVICE_INDEX* index, const char* path);
+PDEVICE_INDEX DeviceIndexLoad(const char* path);
+
+#ifdef _WIN32
+/*
+ * Enumerate all present devices with one SetupDiGetClassDevs call
+ */
+PDEVICE_INDEX DeviceIndexBuild(void);
+#endif
+
+/*
+ * Process-wide index used by the device checks. Built on first use (empty on
+ * platforms without SetupAPI) unless one was installed with SetDeviceIndex().
+ * Not thread-safe: call once from the main thread before running checks in
+ * parallel.
+ */
+const DEVICE_INDEX* GetDeviceIndex(void);
+
+/*
+ * Replace the process-wide index (takes ownership; NULL drops it so the next
+ * GetDeviceIndex() call re-enumerates)
+ */
+void SetDeviceIndex(PDEVICE_INDEX index);
+
+#endif /* DEVICE_INDEX_H */
@@ -0,0 +1,118 @@
+/**
+ * driver_batch.c - IOCTL_HYPERV_BATCH client
+ *
+ * See driver_batch.h and the protocol description in shared_structs.h.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "driver_batch.h"
+#include <stdlib.h>
+
+HANDLE DriverBatchOpen(void)
+{
+    return CreateFileA("\\\\.\\HyperVDetector", GENERIC_READ | GENERIC_WRITE,
+                       0, NULL, OPEN_EXISTING, 0, NULL);
+}
+
+int DriverBatchExecute(HANDLE device, const HV_BATCH_OP* ops, UINT32 count, PHV_BATCH_RESULT results)
+{
+    size_t requestSize = HvBatchRequestSize(count);
+    size_t responseSize = HvBatchResponseSize(count);
+    size_t bufferSize = responseSize > requestSize ? responseSize : requestSize;
+    UINT8* buffer = NULL;
+    DWORD bytesReturned = 0;
+    int decoded = -1;
+
+    if (device == INVALID_HANDLE_VALUE || count == 0 || count > HV_BATCH_MAX_OPS) {
+        return -1;
+    }
+
+    /* One buffer for both directions, like the driver's SystemBuffer */
+    buffer = (UINT8*)malloc(bufferSize);
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    if (HvBatchEncodeRequest(buffer, bufferSize, ops, count) > 0 &&
+        DeviceIoControl(device, IOCTL_HYPERV_BATCH,
+                        buffer, (DWORD)requestSize,
+                        buffer, (DWORD)responseSize,
+                        &bytesReturned, NULL)) {
+        decoded = HvBatchDecodeResponse(buffer, bytesReturned, results, count);
+        if (decoded != (int)count) {
+            decoded = -1;
+        }
+    }
+
+    free(buffer);
+    return decoded;
+}
+
+UINT8* DriverBatchExecuteAllProcessors(HANDLE device, const HV_BATCH_OP* ops, UINT32 count,
+                                       UINT32* processorCount)
+{
+    DWORD maxProcessors = GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+    size_t requestSize = HvBatchRequestSize(count);
+    size_t responseSize = 0;
+    size_t bufferSize = 0;
+    UINT8* buffer = NULL;
+    DWORD bytesReturned = 0;
+    UINT32 opCount = 0;
+
+    if (device == INVALID_HANDLE_VALUE || HvFanoutValidateOps(ops, count) != 0 ||
+        maxProcessors == 0 || maxProcessors > HV_FANOUT_MAX_PROCESSORS) {
+        return NULL;
+    }
+
+    /* Size for every possible processor; the driver fills the active ones */
+    responseSize = HvFanoutResponseSize(count, maxProcessors);
+    bufferSize = responseSize > requestSize ? responseSize : requestSize;
+    buffer = (UINT8*)malloc(bufferSize);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    if (HvBatchEncodeRequest(buffer, bufferSize, ops, count) > 0 &&
+        DeviceIoControl(device, IOCTL_HYPERV_BATCH_ALL_CPUS,
+                        buffer, (DWORD)requestSize,
+                        buffer, (DWORD)responseSize,
+                        &bytesReturned, NULL) &&
+        HvFanoutParse(buffer, bytesReturned, &opCount, processorCount) == 0 &&
+        opCount == count) {
+        return buffer;
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+UINT8* DriverMeasureExitLatency(HANDLE device, UINT32 samplesPerProbe, UINT32* processorCount)
+{
+    DWORD maxProcessors = GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+    HV_LATENCY_REQUEST request = {0};
+    size_t responseSize = 0;
+    UINT8* buffer = NULL;
+    DWORD bytesReturned = 0;
+
+    if (device == INVALID_HANDLE_VALUE || maxProcessors == 0 || maxProcessors > HV_FANOUT_MAX_PROCESSORS) {
+        return NULL;
+    }
+
+    responseSize = HvLatencyResponseSize(maxProcessors);
+    buffer = (UINT8*)malloc(responseSize);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    request.SamplesPerProbe = samplesPerProbe;
+    if (DeviceIoControl(device, IOCTL_HYPERV_EXIT_LATENCY,
+                        &request, sizeof(request),
+                        buffer, (DWORD)responseSize,
+                        &bytesReturned, NULL) &&
+        HvLatencyParse(buffer, bytesReturned, processorCount) == 0) {
+        return buffer;
+    }
+
+    free(buffer);
+    return NULL;
+}
@@ -0,0 +1,48 @@
+/**
+ * driver_batch.h - IOCTL_HYPERV_BATCH client
+ *
+ * Sends a list of rdmsr / cpuid / hypercall / VP-index operations to the
+ * kernel driver in a single DeviceIoControl call, either on the current
+ * processor or on all of them. The wire format and codec live in
+ * shared_structs.h and batch_fanout.h.
+ */
+
+#pragma once
+#ifndef DRIVER_BATCH_H
+#define DRIVER_BATCH_H
+
+#include <windows.h>
+#include "../common/shared_structs.h"
+#include "../common/batch_fanout.h"
+#include "../common/latency_histogram.h"
+
+/*
+ * Open \\.\HyperVDetector. INVALID_HANDLE_VALUE if the driver is not running.
+ */
+HANDLE DriverBatchOpen(void);
+
+/*
+ * Execute count operations (1..HV_BATCH_MAX_OPS) and fill results[count].
+ * Returns the number of results, or -1 if the request could not be sent or
+ * the response was malformed.
+ */
+int DriverBatchExecute(HANDLE device, const HV_BATCH_OP* ops, UINT32 count, PHV_BATCH_RESULT results);
+
+/*
+ * Execute RDMSR/CPUID/VP_INDEX operations on every active processor
+ * (IOCTL_HYPERV_BATCH_ALL_CPUS). Returns a malloc'ed batch_fanout.h matrix
+ * that passed HvFanoutParse, or NULL. Read it with HvFanoutGetSummary and
+ * HvFanoutGetCell, then free() it.
+ */
+UINT8* DriverBatchExecuteAllProcessors(HANDLE device, const HV_BATCH_OP* ops, UINT32 count,
+                                       UINT32* processorCount);
+
+/*
+ * Run the driver's VM-exit latency battery (IOCTL_HYPERV_EXIT_LATENCY) with
+ * samplesPerProbe samples per probe and processor (0 = driver default).
+ * Returns a malloc'ed latency_histogram.h response that passed
+ * HvLatencyParse, or NULL. Read it with HvLatencyGet, then free() it.
+ */
+UINT8* DriverMeasureExitLatency(HANDLE device, UINT32 samplesPerProbe, UINT32* processorCount);
+
+#endif /* DRIVER_BATCH_H */
@@ -0,0 +1,439 @@
+/**
+ * event_reader.c - Batched, bookmarked Windows Event Log reader
+ *
+ * A full scan reads the channel newest-first in batches of
+ * EVENT_READER_BATCH_SIZE handles and renders only the first (newest) event.
+ * When a bookmark name is given, the newest event is bookmarked and the
+ * bookmark is saved together with the running count and latest timestamp.
+ * The next scan seeks just past the bookmark and reads forward, so only new
+ * events are touched. If the bookmark no longer resolves (log cleared or
+ * wrapped) the reader falls back to a full scan.
+ *
+ * Sources: https://learn.microsoft.com/en-us/windows/win32/wes/bookmarking-events
+ *          https://learn.microsoft.com/en-us/windows/win32/wes/consuming-events
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "event_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#pragma comment(lib, "wevtapi.lib")
+
+/* Upper bound of events read forward from a bookmark in one scan */
+#define EVENT_READER_MAX_FORWARD       65536
+
+/* Upper bound of a saved bookmark XML (characters) */
+#define EVENT_READER_MAX_BOOKMARK_XML  4096
+
+typedef struct _EVENT_READER_STATE {
+    DWORD magic;
+    DWORD version;
+    DWORD eventCount;
+    DWORD hasLatest;
+    ULONGLONG latestFileTime;
+    DWORD xmlChars;                  /* Bookmark XML length including NUL */
+    DWORD reserved;
+} EVENT_READER_STATE;
+
+/*
+ * Append formatted text to a wide buffer, FALSE on truncation
+ */
+static BOOL AppendXPath(wchar_t* buffer, size_t count, size_t* length, const wchar_t* format, ...) {
+    va_list args;
+    int written = 0;
+
+    if (*length >= count) {
+        return FALSE;
+    }
+
+    va_start(args, format);
+    written = _vsnwprintf_s(buffer + *length, count - *length, _TRUNCATE, format, args);
+    va_end(args);
+
+    if (written < 0) {
+        return FALSE;
+    }
+    *length += (size_t)written;
+    return TRUE;
+}
+
+BOOL EventReaderBuildXPath(const EVENT_READER_QUERY* query, wchar_t* buffer, size_t count) {
+    size_t length = 0;
+    DWORD parts = 0;
+    DWORD i = 0;
+    BOOL hasSystem = FALSE;
+    BOOL ok = TRUE;
+
+    if (buffer == NULL || count == 0) {
+        return FALSE;
+    }
+    buffer[0] = L'\0';
+
+    hasSystem = query->eventIdCount > 0 || query->systemPredicate != NULL || query->maxAgeSeconds > 0;
+    if (!hasSystem && query->extraPredicate == NULL) {
+        return AppendXPath(buffer, count, &length, L"*");
+    }
+
+    ok = AppendXPath(buffer, count, &length, L"*[");
+
+    if (hasSystem) {
+        ok = ok && AppendXPath(buffer, count, &length, L"System[");
+
+        if (query->eventIdCount > 0) {
+            ok = ok && AppendXPath(buffer, count, &length, L"(");
+            for (i = 0; i < query->eventIdCount; i++) {
+                ok = ok && AppendXPath(buffer, count, &length, L"%lsEventID=%lu",
+                                       i ? L" or " : L"", query->eventIds[i]);
+            }
+            ok = ok && AppendXPath(buffer, count, &length, L")");
+            parts++;
+        }
+
+        if (query->systemPredicate != NULL) {
+            ok = ok && AppendXPath(buffer, count, &length, L"%ls%ls",
+                                   parts ? L" and " : L"", query->systemPredicate);
+            parts++;
+        }
+
+        if (query->maxAgeSeconds > 0) {
+            ok = ok && AppendXPath(buffer, count, &length,
+                                   L"%lsTimeCreated[timediff(@SystemTime) <= %llu]",
+                                   parts ? L" and " : L"",
+                                   (unsigned long long)query->maxAgeSeconds * 1000ULL);
+        }
+
+        ok = ok && AppendXPath(buffer, count, &length, L"]");
+    }
+
+    if (query->extraPredicate != NULL) {
+        ok = ok && AppendXPath(buffer, count, &length, L"%ls%ls",
+                               hasSystem ? L" and " : L"", query->extraPredicate);
+    }
+
+    ok = ok && AppendXPath(buffer, count, &length, L"]");
+    return ok;
+}
+
+BOOL EventReaderOpen(PEVENT_READER reader, const wchar_t* stateDir) {
+    LPCWSTR timePath[] = { L"Event/System/TimeCreated/@SystemTime" };
+    wchar_t base[MAX_PATH] = {0};
+    DWORD length = 0;
+
+    ZeroMemory(reader, sizeof(*reader));
+
+    // Only TimeCreated is ever rendered, so select just that value
+    reader->renderContext = EvtCreateRenderContext(1, timePath, EvtRenderContextValues);
+    if (reader->renderContext == NULL) {
+        return FALSE;
+    }
+
+    if (stateDir != NULL) {
+        wcsncpy_s(reader->stateDir, MAX_PATH, stateDir, _TRUNCATE);
+        CreateDirectoryW(reader->stateDir, NULL);
+        return TRUE;
+    }
+
+    // Default: %LOCALAPPDATA%\HyperVDetector\EventBookmarks (bookmarks off if unavailable)
+    length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return TRUE;
+    }
+
+    wcsncat_s(base, MAX_PATH, L"\\HyperVDetector", _TRUNCATE);
+    CreateDirectoryW(base, NULL);
+    wcsncat_s(base, MAX_PATH, L"\\EventBookmarks", _TRUNCATE);
+    CreateDirectoryW(base, NULL);
+
+    if (GetFileAttributesW(base) != INVALID_FILE_ATTRIBUTES) {
+        wcsncpy_s(reader->stateDir, MAX_PATH, base, _TRUNCATE);
+    }
+    return TRUE;
+}
+
+void EventReaderClose(PEVENT_READER reader) {
+    if (reader->renderContext != NULL) {
+        EvtClose(reader->renderContext);
+        reader->renderContext = NULL;
+    }
+    free(reader->values);
+    reader->values = NULL;
+    reader->valuesSize = 0;
+}
+
+/*
+ * Render TimeCreated through the shared context, growing the shared buffer as needed
+ */
+static BOOL RenderTimeCreated(PEVENT_READER reader, EVT_HANDLE hEvent, ULONGLONG* fileTime) {
+    DWORD used = 0;
+    DWORD propertyCount = 0;
+
+    if (!EvtRender(reader->renderContext, hEvent, EvtRenderEventValues, reader->valuesSize,
+                   reader->values, &used, &propertyCount)) {
+        PEVT_VARIANT grown = NULL;
+
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+            return FALSE;
+        }
+        grown = (PEVT_VARIANT)realloc(reader->values, used);
+        if (grown == NULL) {
+            return FALSE;
+        }
+        reader->values = grown;
+        reader->valuesSize = used;
+
+        if (!EvtRender(reader->renderContext, hEvent, EvtRenderEventValues, reader->valuesSize,
+                       reader->values, &used, &propertyCount)) {
+            return FALSE;
+        }
+    }
+
+    if (propertyCount < 1 || reader->values[0].Type != EvtVarTypeFileTime) {
+        return FALSE;
+    }
+    *fileTime = reader->values[0].FileTimeVal;
+    return TRUE;
+}
+
+/*
+ * <stateDir>\<name>.bin, with anything but [A-Za-z0-9_-] replaced by '_'
+ */
+static BOOL GetStatePath(PEVENT_READER reader, const char* name, wchar_t* path, size_t count) {
+    char safeName[128] = {0};
+    wchar_t wideName[128] = {0};
+    size_t i = 0;
+
+    if (reader->stateDir[0] == L'\0' || name == NULL || name[0] == '\0') {
+        return FALSE;
+    }
+
+    for (i = 0; name[i] != '\0' && i < sizeof(safeName) - 1; i++) {
+        char c = name[i];
+        BOOL keep = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '-' || c == '_';
+        safeName[i] = keep ? c : '_';
+    }
+
+    MultiByteToWideChar(CP_ACP, 0, safeName, -1, wideName, (int)(sizeof(wideName) / sizeof(wchar_t)));
+    return _snwprintf_s(path, count, _TRUNCATE, L"%ls\\%ls.bin", reader->stateDir, wideName) > 0;
+}
+
+static BOOL LoadState(const wchar_t* path, EVENT_READER_STATE* state, wchar_t* xml, DWORD xmlCount) {
+    FILE* file = NULL;
+    BOOL ok = FALSE;
+
+    if (_wfopen_s(&file, path, L"rb") != 0 || file == NULL) {
+        return FALSE;
+    }
+
+    if (fread(state, sizeof(*state), 1, file) == 1 &&
+        state->magic == EVENT_READER_STATE_MAGIC &&
+        state->version == EVENT_READER_STATE_VERSION &&
+        state->xmlChars > 1 && state->xmlChars <= xmlCount &&
+        fread(xml, sizeof(wchar_t), state->xmlChars, file) == state->xmlChars) {
+        xml[state->xmlChars - 1] = L'\0';
+        ok = TRUE;
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static BOOL SaveState(const wchar_t* path, EVT_HANDLE hBookmark, DWORD eventCount,
+                      BOOL hasLatest, ULONGLONG latestFileTime) {
+    EVENT_READER_STATE state = {0};
+    wchar_t xml[EVENT_READER_MAX_BOOKMARK_XML];
+    DWORD used = 0;
+    DWORD propertyCount = 0;
+    FILE* file = NULL;
+    BOOL ok = FALSE;
+
+    if (!EvtRender(NULL, hBookmark, EvtRenderBookmark, sizeof(xml), xml, &used, &propertyCount)) {
+        return FALSE;
+    }
+
+    state.magic = EVENT_READER_STATE_MAGIC;
+    state.version = EVENT_READER_STATE_VERSION;
+    state.eventCount = eventCount;
+    state.hasLatest = hasLatest ? 1 : 0;
+    state.latestFileTime = latestFileTime;
+    state.xmlChars = used / sizeof(wchar_t);
+
+    if (_wfopen_s(&file, path, L"wb") != 0 || file == NULL) {
+        return FALSE;
+    }
+    ok = fwrite(&state, sizeof(state), 1, file) == 1 &&
+         fwrite(xml, sizeof(wchar_t), state.xmlChars, file) == state.xmlChars;
+    fclose(file);
+
+    if (!ok) {
+        DeleteFileW(path);
+    }
+    return ok;
+}
+
+static void CloseBatch(PEVENT_READER reader, DWORD returned) {
+    DWORD i = 0;
+
+    for (i = 0; i < returned; i++) {
+        EvtClose(reader->batch[i]);
+        reader->batch[i] = NULL;
+    }
+}
+
+/*
+ * Read forward from a saved bookmark. FALSE if the bookmark could not be resumed.
+ */
+static BOOL ReadFromBookmark(PEVENT_READER reader, const wchar_t* channel, const wchar_t* xpath,
+                             EVT_HANDLE hBookmark, DWORD* newEvents, BOOL* truncated,
+                             BOOL* hasLatest, ULONGLONG* latestFileTime) {
+    EVT_HANDLE hResults = NULL;
+    DWORD returned = 0;
+
+    hResults = EvtQuery(NULL, channel, xpath, EvtQueryChannelPath | EvtQueryForwardDirection);
+    if (hResults == NULL) {
+        return FALSE;
+    }
+
+    // Strict seek fails if the bookmarked event is gone (log cleared or overwritten)
+    if (!EvtSeek(hResults, 1, hBookmark, 0, EvtSeekRelativeToBookmark | EvtSeekStrict)) {
+        EvtClose(hResults);
+        return FALSE;
+    }
+
+    while (*newEvents < EVENT_READER_MAX_FORWARD &&
+           EvtNext(hResults, EVENT_READER_BATCH_SIZE, reader->batch, INFINITE, 0, &returned) &&
+           returned > 0) {
+        EVT_HANDLE hLast = reader->batch[returned - 1];
+
+        *newEvents += returned;
+        EvtUpdateBookmark(hBookmark, hLast);
+        if (RenderTimeCreated(reader, hLast, latestFileTime)) {
+            *hasLatest = TRUE;
+        }
+        CloseBatch(reader, returned);
+    }
+
+    *truncated = *newEvents >= EVENT_READER_MAX_FORWARD;
+    EvtClose(hResults);
+    return TRUE;
+}
+
+BOOL EventReaderRead(PEVENT_READER reader, const EVENT_READER_QUERY* query,
+                     PEVENT_READER_RESULT out) {
+    wchar_t xpath[1024];
+    wchar_t statePath[MAX_PATH] = {0};
+    wchar_t bookmarkXml[EVENT_READER_MAX_BOOKMARK_XML];
+    EVENT_READER_STATE state = {0};
+    EVT_HANDLE hResults = NULL;
+    EVT_HANDLE hBookmark = NULL;
+    DWORD maxEvents = query->maxEvents ? query->maxEvents : EVENT_READER_DEFAULT_MAX;
+    DWORD returned = 0;
+    ULONGLONG latestFileTime = 0;
+    BOOL hasLatest = FALSE;
+    BOOL persist = FALSE;
+
+    ZeroMemory(out, sizeof(*out));
+
+    if (!EventReaderBuildXPath(query, xpath, sizeof(xpath) / sizeof(wchar_t))) {
+        return FALSE;
+    }
+
+    // A windowed count has to drop old events, which a saved total cannot do
+    persist = query->maxAgeSeconds == 0 &&
+              GetStatePath(reader, query->bookmarkName, statePath, MAX_PATH);
+
+    // Incremental scan: only events after the saved bookmark
+    if (persist && LoadState(statePath, &state, bookmarkXml, EVENT_READER_MAX_BOOKMARK_XML)) {
+        hBookmark = EvtCreateBookmark(bookmarkXml);
+        if (hBookmark != NULL) {
+            DWORD newEvents = 0;
+            BOOL truncated = FALSE;
+
+            hasLatest = state.hasLatest != 0;
+            latestFileTime = state.latestFileTime;
+
+            if (ReadFromBookmark(reader, query->channel, xpath, hBookmark, &newEvents,
+                                 &truncated, &hasLatest, &latestFileTime)) {
+                ULONGLONG total = (ULONGLONG)state.eventCount + newEvents;
+
+                out->fromBookmark = TRUE;
+                out->newEvents = newEvents;
+                out->eventCount = total > maxEvents ? maxEvents : (DWORD)total;
+                out->truncated = truncated || total >= maxEvents;
+
+                if (newEvents > 0) {
+                    SaveState(statePath, hBookmark, out->eventCount, hasLatest, latestFileTime);
+                }
+                goto done;
+            }
+            EvtClose(hBookmark);
+            hBookmark = NULL;
+            hasLatest = FALSE;
+            latestFileTime = 0;
+        }
+        DeleteFileW(statePath);
+    }
+
+    // Full scan, newest first, capped at maxEvents
+    hResults = EvtQuery(NULL, query->channel, xpath, EvtQueryChannelPath | EvtQueryReverseDirection);
+    if (hResults == NULL) {
+        return FALSE;
+    }
+
+    while (out->eventCount < maxEvents) {
+        DWORD wanted = maxEvents - out->eventCount;
+
+        if (wanted > EVENT_READER_BATCH_SIZE) {
+            wanted = EVENT_READER_BATCH_SIZE;
+        }
+        if (!EvtNext(hResults, wanted, reader->batch, INFINITE, 0, &returned) || returned == 0) {
+            break;
+        }
+
+        // The first event of a reverse query is the newest one
+        if (out->eventCount == 0) {
+            hasLatest = RenderTimeCreated(reader, reader->batch[0], &latestFileTime);
+            if (persist) {
+                hBookmark = EvtCreateBookmark(NULL);
+                if (hBookmark != NULL && !EvtUpdateBookmark(hBookmark, reader->batch[0])) {
+                    EvtClose(hBookmark);
+                    hBookmark = NULL;
+                }
+            }
+        }
+
+        out->eventCount += returned;
+        CloseBatch(reader, returned);
+    }
+
+    out->newEvents = out->eventCount;
+    out->truncated = out->eventCount >= maxEvents;
+    EvtClose(hResults);
+
+    if (hBookmark != NULL) {
+        SaveState(statePath, hBookmark, out->eventCount, hasLatest, latestFileTime);
+    }
+
+done:
+    if (hBookmark != NULL) {
+        EvtClose(hBookmark);
+    }
+
+    if (hasLatest) {
+        FILETIME ft;
+        ft.dwLowDateTime = (DWORD)(latestFileTime & 0xFFFFFFFF);
+        ft.dwHighDateTime = (DWORD)(latestFileTime >> 32);
+        out->hasLatest = FileTimeToSystemTime(&ft, &out->latestTime);
+    }
+    return TRUE;
+}
+
+void EventReaderResetBookmark(PEVENT_READER reader, const char* bookmarkName) {
+    wchar_t statePath[MAX_PATH] = {0};
+
+    if (GetStatePath(reader, bookmarkName, statePath, MAX_PATH)) {
+        DeleteFileW(statePath);
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * event_reader.h - Batched, bookmarked Windows Event Log reader
+ *
+ * Reads a channel with batched EvtNext calls, pushes event ID and time window
+ * filters into the XPath query, renders System properties through one render
+ * context shared by all queries, and optionally persists a bookmark per
+ * query so that a repeated scan only reads events written since the last one.
+ *
+ * Bookmarks are stored under %LOCALAPPDATA%\HyperVDetector\EventBookmarks.
+ */
+
+#pragma once
+#ifndef EVENT_READER_H
+#define EVENT_READER_H
+
+#include <windows.h>
+#include <winevt.h>
+
+/* Handles requested per EvtNext call */
+#define EVENT_READER_BATCH_SIZE        128
+
+/* Bookmark state file format */
+#define EVENT_READER_STATE_MAGIC       0x42455648  /* "HVEB" */
+#define EVENT_READER_STATE_VERSION     1
+
+/* Query description. Unused fields may be left zero / NULL. */
+typedef struct _EVENT_READER_QUERY {
+    const wchar_t* channel;          /* Channel path, e.g. L"System" */
+    const wchar_t* systemPredicate;  /* Extra System[] predicate, e.g. L"Level<=3" */
+    const wchar_t* extraPredicate;   /* Predicate outside System[], e.g. EventData[...] */
+    const DWORD* eventIds;           /* EventID filter (OR-ed) */
+    DWORD eventIdCount;
+    DWORD maxAgeSeconds;             /* Time window; 0 = whole log */
+    DWORD maxEvents;                 /* Count cap; 0 = EVENT_READER_DEFAULT_MAX */
+    const char* bookmarkName;        /* Persist a bookmark under this name; NULL = full scan.
+                                        Ignored with maxAgeSeconds: a saved count cannot age out */
+} EVENT_READER_QUERY, *PEVENT_READER_QUERY;
+
+#define EVENT_READER_DEFAULT_MAX       100
+
+typedef struct _EVENT_READER_RESULT {
+    DWORD eventCount;                /* Matching events (capped at maxEvents) */
+    DWORD newEvents;                 /* Events read by this scan */
+    BOOL truncated;                  /* eventCount hit the cap */
+    BOOL fromBookmark;               /* Scan resumed from a saved bookmark */
+    BOOL hasLatest;
+    SYSTEMTIME latestTime;           /* TimeCreated of the newest matching event */
+} EVENT_READER_RESULT, *PEVENT_READER_RESULT;
+
+typedef struct _EVENT_READER {
+    EVT_HANDLE renderContext;
+    PEVT_VARIANT values;
+    DWORD valuesSize;
+    EVT_HANDLE batch[EVENT_READER_BATCH_SIZE];
+    wchar_t stateDir[MAX_PATH];
+} EVENT_READER, *PEVENT_READER;
+
+/*
+ * Lifetime. stateDir overrides the bookmark directory (NULL = default).
+ */
+BOOL EventReaderOpen(PEVENT_READER reader, const wchar_t* stateDir);
+void EventReaderClose(PEVENT_READER reader);
+
+/*
+ * Build the XPath for a query. Returns FALSE if the buffer is too small.
+ */
+BOOL EventReaderBuildXPath(const EVENT_READER_QUERY* query, wchar_t* buffer, size_t count);
+
+/*
+ * Run a query. Returns FALSE if the channel could not be queried.
+ */
+BOOL EventReaderRead(PEVENT_READER reader, const EVENT_READER_QUERY* query,
+                     PEVENT_READER_RESULT out);
+
+/*
+ * Drop the saved bookmark for a query name
+ */
+void EventReaderResetBookmark(PEVENT_READER reader, const char* bookmarkName);
+
+#endif /* EVENT_READER_H */
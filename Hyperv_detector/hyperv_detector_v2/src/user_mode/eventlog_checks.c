@@ -2,16 +2,20 @@
  * eventlog_checks.c - Windows Event Log based Hyper-V detection
  * 
  * Searches Windows Event Logs for Hyper-V related events and providers.
+ * Channel reads go through event_reader.c (batched, bookmarked).
  */
 
 #include "hyperv_detector.h"
-#include <winevt.h>
+#include "event_reader.h"
 
 #pragma comment(lib, "wevtapi.lib")
 
 // Detection flag for event logs
 #define HYPERV_DETECTED_EVENTLOG 0x00040000
 
+// Security events of interest (logon, handle request)
+static const DWORD SECURITY_EVENT_IDS[] = { 4624, 4656 };
+
 // Hyper-V Event Log channels
 static const wchar_t* HYPERV_EVENT_CHANNELS[] = {
     L"Microsoft-Windows-Hyper-V-Compute-Admin",
@@ -63,77 +67,6 @@ static BOOL CheckEventChannelExists(const wchar_t* channelPath) {
     return TRUE;
 }
 
-static DWORD GetEventCount(const wchar_t* channelPath) {
-    EVT_HANDLE hResults = NULL;
-    EVT_HANDLE hEvent = NULL;
-    DWORD eventCount = 0;
-    DWORD returned = 0;
-    
-    // Simple query to count events
-    wchar_t query[512];
-    swprintf(query, sizeof(query)/sizeof(wchar_t), L"*");
-    
-    hResults = EvtQuery(NULL, channelPath, query, EvtQueryChannelPath | EvtQueryReverseDirection);
-    if (hResults == NULL) {
-        return 0;
-    }
-    
-    // Count up to 100 events
-    while (eventCount < 100) {
-        if (!EvtNext(hResults, 1, &hEvent, INFINITE, 0, &returned)) {
-            break;
-        }
-        eventCount++;
-        EvtClose(hEvent);
-    }
-    
-    EvtClose(hResults);
-    return eventCount;
-}
-
-static BOOL GetLatestEventTime(const wchar_t* channelPath, SYSTEMTIME* pTime) {
-    EVT_HANDLE hResults = NULL;
-    EVT_HANDLE hEvent = NULL;
-    DWORD returned = 0;
-    BOOL success = FALSE;
-    
-    hResults = EvtQuery(NULL, channelPath, L"*", EvtQueryChannelPath | EvtQueryReverseDirection);
-    if (hResults == NULL) {
-        return FALSE;
-    }
-    
-    if (EvtNext(hResults, 1, &hEvent, INFINITE, 0, &returned) && returned > 0) {
-        EVT_HANDLE hContext = EvtCreateRenderContext(0, NULL, EvtRenderContextSystem);
-        if (hContext) {
-            DWORD bufferSize = 0;
-            DWORD propertyCount = 0;
-            
-            EvtRender(hContext, hEvent, EvtRenderEventValues, 0, NULL, &bufferSize, &propertyCount);
-            
-            PEVT_VARIANT pRenderedValues = (PEVT_VARIANT)malloc(bufferSize);
-            if (pRenderedValues) {
-                if (EvtRender(hContext, hEvent, EvtRenderEventValues, bufferSize, 
-                             pRenderedValues, &bufferSize, &propertyCount)) {
-                    // TimeCreated is at index EvtSystemTimeCreated (17)
-                    if (propertyCount > 17 && pRenderedValues[17].Type == EvtVarTypeFileTime) {
-                        FILETIME ft;
-                        ft.dwLowDateTime = pRenderedValues[17].FileTimeVal & 0xFFFFFFFF;
-                        ft.dwHighDateTime = (pRenderedValues[17].FileTimeVal >> 32) & 0xFFFFFFFF;
-                        FileTimeToSystemTime(&ft, pTime);
-                        success = TRUE;
-                    }
-                }
-                free(pRenderedValues);
-            }
-            EvtClose(hContext);
-        }
-        EvtClose(hEvent);
-    }
-    
-    EvtClose(hResults);
-    return success;
-}
-
 static BOOL CheckEventProviderRegistered(const wchar_t* providerName) {
     EVT_HANDLE hPublisher = EvtOpenPublisherMetadata(NULL, providerName, NULL, 0, 0);
     if (hPublisher == NULL) {
@@ -146,6 +79,10 @@ static BOOL CheckEventProviderRegistered(const wchar_t* providerName) {
 DWORD CheckEventLogsHyperV(PDETECTION_RESULT result) {
     DWORD detected = 0;
     char channelNameA[256];
+    EVENT_READER reader;
+    EVENT_READER_QUERY query;
+    EVENT_READER_RESULT events;
+    BOOL readerOpen = EventReaderOpen(&reader, NULL);
     
     AppendToDetails(result, "EventLog: Checking Hyper-V event log channels...\n");
     
@@ -157,18 +94,29 @@ DWORD CheckEventLogsHyperV(PDETECTION_RESULT result) {
             WideCharToMultiByte(CP_UTF8, 0, HYPERV_EVENT_CHANNELS[i], -1, 
                                channelNameA, sizeof(channelNameA), NULL, NULL);
             
-            DWORD eventCount = GetEventCount(HYPERV_EVENT_CHANNELS[i]);
-            AppendToDetails(result, "EventLog: Found channel: %s (%d events)\n", 
-                           channelNameA, eventCount);
+            if (!readerOpen) {
+                AppendToDetails(result, "EventLog: Found channel: %s\n", channelNameA);
+                continue;
+            }
+            
+            // Count up to 100 events; the bookmark makes repeated scans incremental
+            ZeroMemory(&query, sizeof(query));
+            query.channel = HYPERV_EVENT_CHANNELS[i];
+            query.bookmarkName = channelNameA;
+            
+            if (!EventReaderRead(&reader, &query, &events)) {
+                AppendToDetails(result, "EventLog: Found channel: %s\n", channelNameA);
+                continue;
+            }
+            
+            AppendToDetails(result, "EventLog: Found channel: %s (%lu%s events, %lu new)\n", 
+                           channelNameA, events.eventCount, events.truncated ? "+" : "",
+                           events.newEvents);
             
-            // Get latest event time if any events exist
-            if (eventCount > 0) {
-                SYSTEMTIME latestTime;
-                if (GetLatestEventTime(HYPERV_EVENT_CHANNELS[i], &latestTime)) {
-                    AppendToDetails(result, "EventLog: Latest event: %04d-%02d-%02d %02d:%02d:%02d\n",
-                                   latestTime.wYear, latestTime.wMonth, latestTime.wDay,
-                                   latestTime.wHour, latestTime.wMinute, latestTime.wSecond);
-                }
+            if (events.eventCount > 0 && events.hasLatest) {
+                AppendToDetails(result, "EventLog: Latest event: %04d-%02d-%02d %02d:%02d:%02d\n",
+                               events.latestTime.wYear, events.latestTime.wMonth, events.latestTime.wDay,
+                               events.latestTime.wHour, events.latestTime.wMinute, events.latestTime.wSecond);
             }
         }
     }
@@ -186,86 +134,65 @@ DWORD CheckEventLogsHyperV(PDETECTION_RESULT result) {
         }
     }
     
-    // Check System event log for Hyper-V related events
-    EVT_HANDLE hResults = EvtQuery(NULL, L"System", 
-        L"*[System[Provider[@Name='Microsoft-Windows-Hyper-V-Hypervisor' or "
-        L"@Name='Microsoft-Windows-Hyper-V-VID' or "
-        L"@Name='Microsoft-Windows-Kernel-HvSocket']]]",
-        EvtQueryChannelPath | EvtQueryReverseDirection);
-    
-    if (hResults != NULL) {
-        EVT_HANDLE hEvent;
-        DWORD returned;
-        DWORD systemEventCount = 0;
-        
-        while (systemEventCount < 10 && EvtNext(hResults, 1, &hEvent, INFINITE, 0, &returned)) {
-            systemEventCount++;
-            EvtClose(hEvent);
-        }
-        
-        if (systemEventCount > 0) {
-            detected |= HYPERV_DETECTED_EVENTLOG;
-            AppendToDetails(result, "EventLog: Found %d Hyper-V events in System log\n", systemEventCount);
-        }
-        
-        EvtClose(hResults);
+    if (!readerOpen) {
+        return detected;
     }
     
-    // Check for recent Hyper-V related application events
-    hResults = EvtQuery(NULL, L"Application", 
-        L"*[System[(Level=1 or Level=2 or Level=3) and "
-        L"(Provider[@Name='Hyper-V-VmSwitch'] or "
-        L"Provider[@Name='vmms'] or "
-        L"Provider[@Name='vmcompute'])]]",
-        EvtQueryChannelPath | EvtQueryReverseDirection);
+    // Check System event log for Hyper-V related events
+    ZeroMemory(&query, sizeof(query));
+    query.channel = L"System";
+    query.systemPredicate = L"Provider[@Name='Microsoft-Windows-Hyper-V-Hypervisor' or "
+                            L"@Name='Microsoft-Windows-Hyper-V-VID' or "
+                            L"@Name='Microsoft-Windows-Kernel-HvSocket']";
+    query.maxEvents = 10;
+    query.bookmarkName = "System-HyperV";
+    
+    if (EventReaderRead(&reader, &query, &events) && events.eventCount > 0) {
+        detected |= HYPERV_DETECTED_EVENTLOG;
+        AppendToDetails(result, "EventLog: Found %lu Hyper-V events in System log\n", events.eventCount);
+    }
     
-    if (hResults != NULL) {
-        EVT_HANDLE hEvent;
-        DWORD returned;
-        DWORD appEventCount = 0;
-        
-        while (appEventCount < 10 && EvtNext(hResults, 1, &hEvent, INFINITE, 0, &returned)) {
-            appEventCount++;
-            EvtClose(hEvent);
-        }
-        
-        if (appEventCount > 0) {
-            detected |= HYPERV_DETECTED_EVENTLOG;
-            AppendToDetails(result, "EventLog: Found %d Hyper-V events in Application log\n", appEventCount);
-        }
-        
-        EvtClose(hResults);
+    // Check for Hyper-V related application events (errors and warnings)
+    ZeroMemory(&query, sizeof(query));
+    query.channel = L"Application";
+    query.systemPredicate = L"(Level=1 or Level=2 or Level=3) and "
+                            L"(Provider[@Name='Hyper-V-VmSwitch'] or "
+                            L"Provider[@Name='vmms'] or "
+                            L"Provider[@Name='vmcompute'])";
+    query.maxEvents = 10;
+    
+    if (EventReaderRead(&reader, &query, &events) && events.eventCount > 0) {
+        detected |= HYPERV_DETECTED_EVENTLOG;
+        AppendToDetails(result, "EventLog: Found %lu Hyper-V events in Application log\n", events.eventCount);
     }
     
+    EventReaderClose(&reader);
     return detected;
 }
 
 // Additional check: Security event log for Hyper-V related security events
 DWORD CheckSecurityEventsHyperV(PDETECTION_RESULT result) {
     DWORD detected = 0;
+    EVENT_READER reader;
+    EVENT_READER_QUERY query;
+    EVENT_READER_RESULT events;
     
-    // Check for Hyper-V VM connect/disconnect events (Event ID 4656, 4624 with HvSocket)
-    EVT_HANDLE hResults = EvtQuery(NULL, L"Security",
-        L"*[System[(EventID=4624 or EventID=4656)] and "
-        L"EventData[Data[@Name='LogonType']='10']]",
-        EvtQueryChannelPath | EvtQueryReverseDirection);
+    if (!EventReaderOpen(&reader, NULL)) {
+        return detected;
+    }
     
-    if (hResults != NULL) {
-        EVT_HANDLE hEvent;
-        DWORD returned;
-        DWORD secEventCount = 0;
-        
-        while (secEventCount < 5 && EvtNext(hResults, 1, &hEvent, INFINITE, 0, &returned)) {
-            secEventCount++;
-            EvtClose(hEvent);
-        }
-        
-        if (secEventCount > 0) {
-            AppendToDetails(result, "EventLog: Found %d potential Hyper-V security events\n", secEventCount);
-        }
-        
-        EvtClose(hResults);
+    // Check for Hyper-V VM connect/disconnect events (Event ID 4656, 4624 with HvSocket)
+    ZeroMemory(&query, sizeof(query));
+    query.channel = L"Security";
+    query.eventIds = SECURITY_EVENT_IDS;
+    query.eventIdCount = sizeof(SECURITY_EVENT_IDS) / sizeof(SECURITY_EVENT_IDS[0]);
+    query.extraPredicate = L"EventData[Data[@Name='LogonType']='10']";
+    query.maxEvents = 5;
+    
+    if (EventReaderRead(&reader, &query, &events) && events.eventCount > 0) {
+        AppendToDetails(result, "EventLog: Found %lu potential Hyper-V security events\n", events.eventCount);
     }
     
+    EventReaderClose(&reader);
     return detected;
 }
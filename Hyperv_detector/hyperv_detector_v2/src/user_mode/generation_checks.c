@@ -11,6 +11,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "device_index.h"
 #include <stdio.h>
 /* intrin.h included conditionally via common.h */
 
@@ -56,11 +57,11 @@ static BOOL IsSecureBootEnabled(void)
     BOOL enabled = FALSE;
     
     res = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
-        "SYSTEM\\CurrentControlSet\\Control\\SecureBoot\\State",
+        HV_REG_KEY_SECUREBOOT_STATE,
         0, KEY_READ, &hKey);
     
     if (res == ERROR_SUCCESS) {
-        res = RegQueryValueExA(hKey, "UEFISecureBootEnabled", NULL, NULL,
+        res = RegQueryValueExA(hKey, HV_REG_VALUE_SECUREBOOT, NULL, NULL,
                               (LPBYTE)&value, &size);
         if (res == ERROR_SUCCESS && value == 1) {
             enabled = TRUE;
@@ -102,6 +103,30 @@ static BOOL HasVirtualTPM(void)
     return hasTPM;
 }
 
+/*
+ * Look up an emulated Gen1 device (detection_rules.h) by hardware ID or by
+ * one of its services. Returns -1 when the device tree could not be enumerated.
+ */
+static int HasEmulatedDevice(const HV_GEN1_DEVICE* device)
+{
+    const DEVICE_INDEX* index = GetDeviceIndex();
+    int i;
+    
+    if (DeviceIndexCount(index) == 0) {
+        return -1;
+    }
+    
+    if (DeviceIndexFirstById(index, device->HardwareId) != NULL) {
+        return 1;
+    }
+    for (i = 0; device->Services[i] != NULL; i++) {
+        if (DeviceIndexFindService(index, device->Services[i]) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /*
  * Check for IDE controller (Gen1 indicator)
  */
@@ -109,6 +134,12 @@ static BOOL HasIDEController(void)
 {
     HKEY hKey = NULL;
     LONG res = 0;
+    int present = HasEmulatedDevice(HvGen1IdeController());
+    
+    /* Emulated PIIX4 IDE controller */
+    if (present >= 0) {
+        return present == 1;
+    }
     
     /* Check for IDE controller in registry */
     res = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
@@ -137,6 +168,11 @@ static BOOL HasFloppyController(void)
 {
     HKEY hKey = NULL;
     LONG res = 0;
+    int present = HasEmulatedDevice(HvGen1FloppyController());
+    
+    if (present >= 0) {
+        return present == 1;
+    }
     
     res = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
         "SYSTEM\\CurrentControlSet\\Services\\flpydisk",
@@ -191,6 +227,11 @@ static BOOL HasLegacyNetworkAdapter(void)
     /* Legacy adapters use DEC 21140 chipset emulation */
     HKEY hKey = NULL;
     LONG res = 0;
+    int present = HasEmulatedDevice(HvGen1LegacyNic());
+    
+    if (present >= 0) {
+        return present == 1;
+    }
     
     res = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
         "SYSTEM\\CurrentControlSet\\Services\\dc21x4",
@@ -249,29 +290,19 @@ static BOOL IsSCSIBoot(void)
  */
 static int DetermineGeneration(PVM_GENERATION_INFO info)
 {
-    int gen1Score = 0;
-    int gen2Score = 0;
-    
-    /* Gen2 indicators */
-    if (info->hasUEFI) gen2Score += 3;
-    if (info->hasSecureBoot) gen2Score += 2;
-    if (info->hasTPM) gen2Score += 2;
-    if (info->hasSCSIBoot) gen2Score += 2;
-    
-    /* Gen1 indicators */
-    if (info->hasIDEController) gen1Score += 2;
-    if (info->hasFloppyController) gen1Score += 2;
-    if (info->hasCOMPorts) gen1Score += 1;
-    if (info->hasLegacyNIC) gen1Score += 2;
-    if (!info->hasUEFI) gen1Score += 3;
-    
-    if (gen2Score > gen1Score) {
-        return 2;
-    } else if (gen1Score > gen2Score) {
-        return 1;
-    }
-    
-    return 0;  /* Unknown */
+    HV_GENERATION_INDICATORS indicators;
+    
+    indicators.HasUEFI = info->hasUEFI;
+    indicators.HasSecureBoot = info->hasSecureBoot;
+    indicators.HasTPM = info->hasTPM;
+    indicators.HasSCSIBoot = info->hasSCSIBoot;
+    indicators.HasIDEController = info->hasIDEController;
+    indicators.HasFloppyController = info->hasFloppyController;
+    indicators.HasCOMPorts = info->hasCOMPorts;
+    indicators.HasLegacyNIC = info->hasLegacyNIC;
+    
+    /* Weighted vote, shared with the fixture replay (detection_rules.h) */
+    return HvGenerationFromIndicators(&indicators);
 }
 
 /*
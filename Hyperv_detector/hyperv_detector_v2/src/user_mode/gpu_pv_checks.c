@@ -13,18 +13,14 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "device_index.h"
 #include <stdio.h>
-#include <setupapi.h>
-
-#pragma comment(lib, "setupapi.lib")
 
 /* Detection flag for this module */
 #define HYPERV_DETECTED_GPU_PV 0x00001000
 
-/* GPU-PV device class GUID */
 /* Microsoft Hyper-V Video: 5B45201D-F2F2-4F3B-85BB-30FF1F953599 */
-static const GUID GUID_DEVCLASS_DISPLAY = 
-    {0x4d36e968, 0xe325, 0x11ce, {0xbf, 0xc1, 0x08, 0x00, 0x2b, 0xe1, 0x03, 0x18}};
+/* Display adapters are looked up by DEVICE_CLASS_DISPLAY in the device index */
 
 /* GPU-PV detection info */
 typedef struct _GPU_PV_INFO {
@@ -46,66 +42,44 @@ typedef struct _GPU_PV_INFO {
  */
 static void CheckHyperVVideoAdapter(PGPU_PV_INFO info)
 {
-    HDEVINFO hDevInfo;
-    SP_DEVINFO_DATA devInfoData;
-    DWORD i;
-    char buffer[256];
-    DWORD bufferSize;
+    const DEVICE_INDEX* index;
+    const DEVICE_INDEX_ENTRY* device;
     
     if (info == NULL) {
         return;
     }
     
-    hDevInfo = SetupDiGetClassDevsA(&GUID_DEVCLASS_DISPLAY, NULL, NULL, 
-                                    DIGCF_PRESENT);
-    
-    if (hDevInfo == INVALID_HANDLE_VALUE) {
-        return;
-    }
+    index = GetDeviceIndex();
     
-    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-    
-    for (i = 0; SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
-        bufferSize = sizeof(buffer);
+    for (device = DeviceIndexFirstByClass(index, DEVICE_CLASS_DISPLAY); device != NULL;
+         device = DeviceIndexNextByClass(index, DEVICE_CLASS_DISPLAY, device)) {
         
-        if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData,
-            SPDRP_DEVICEDESC, NULL, (PBYTE)buffer, bufferSize, NULL)) {
-            
-            /* Check for Hyper-V Video */
-            if (strstr(buffer, "Hyper-V") != NULL ||
-                strstr(buffer, "Microsoft Hyper-V Video") != NULL) {
-                info->hyperVVideoFound = TRUE;
-                strncpy(info->adapterName, buffer, sizeof(info->adapterName) - 1);
-            }
-            
-            /* Check for Basic Display (no GPU-PV) */
-            if (strstr(buffer, "Microsoft Basic Display") != NULL ||
-                strstr(buffer, "Basic Display Adapter") != NULL) {
-                info->basicDisplayFound = TRUE;
-            }
-            
-            /* Check for GPU-PV indicators */
-            if (strstr(buffer, "GPU-PV") != NULL ||
-                strstr(buffer, "GPU Partitioning") != NULL ||
-                strstr(buffer, "RemoteFX") != NULL) {
-                info->gpuPvEnabled = TRUE;
-            }
+        /* Check for Hyper-V Video */
+        if (strstr(device->description, "Hyper-V") != NULL ||
+            strstr(device->description, "Microsoft Hyper-V Video") != NULL) {
+            info->hyperVVideoFound = TRUE;
+            strncpy(info->adapterName, device->description, sizeof(info->adapterName) - 1);
         }
         
-        /* Get hardware ID */
-        bufferSize = sizeof(buffer);
-        if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData,
-            SPDRP_HARDWAREID, NULL, (PBYTE)buffer, bufferSize, NULL)) {
-            
-            /* Check for VMBus GPU device */
-            if (strstr(buffer, "VMBUS") != NULL ||
-                strstr(buffer, "{da0a7802-e377-4aac-8e77-0558eb1073f8}") != NULL) {
-                info->vmbusDxDeviceCount++;
-            }
+        /* Check for Basic Display (no GPU-PV) */
+        if (strstr(device->description, "Microsoft Basic Display") != NULL ||
+            strstr(device->description, "Basic Display Adapter") != NULL) {
+            info->basicDisplayFound = TRUE;
+        }
+        
+        /* Check for GPU-PV indicators */
+        if (strstr(device->description, "GPU-PV") != NULL ||
+            strstr(device->description, "GPU Partitioning") != NULL ||
+            strstr(device->description, "RemoteFX") != NULL) {
+            info->gpuPvEnabled = TRUE;
+        }
+        
+        /* Check for VMBus GPU device */
+        if (DeviceIndexIdListFind(device->hardwareIds, "VMBUS") != NULL ||
+            DeviceIndexIdListFind(device->hardwareIds, "{da0a7802-e377-4aac-8e77-0558eb1073f8}") != NULL) {
+            info->vmbusDxDeviceCount++;
         }
     }
-    
-    SetupDiDestroyDeviceInfoList(hDevInfo);
 }
 
 /*
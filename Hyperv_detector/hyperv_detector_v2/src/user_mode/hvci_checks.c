@@ -13,6 +13,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "wmi_pool.h"
 #include <stdio.h>
 
 /* Detection flag for this module */
@@ -146,16 +147,24 @@ static void CheckKcfg(PHVCI_INFO info)
 }
 
 /*
- * Check WMI for VBS status
+ * Check WMI for VBS status (Win32_DeviceGuard), falling back to the policy
+ * value when the DeviceGuard namespace is unavailable
  */
 static BOOL CheckVbsWmi(void)
 {
-    /* WMI query would go here, simplified to registry check */
+    static const wchar_t* VBS_PROPS[] = { L"VirtualizationBasedSecurityStatus" };
+    WMI_VALUE status;
     HKEY hKey;
     LONG result;
     DWORD value = 0;
     DWORD size = sizeof(DWORD);
     
+    /* 0 = disabled, 1 = enabled but not running, 2 = running */
+    if (WmiPoolSelectFirst(WMI_NS_DEVICEGUARD, L"Win32_DeviceGuard", NULL, VBS_PROPS, 1, &status) &&
+        status.present) {
+        return atoi(status.text) != 0;
+    }
+    
     result = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
         "SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Policies\\System",
         0, KEY_READ, &hKey);
@@ -22,6 +22,7 @@ DWORD CheckRemovedHyperV(PDETECTION_RESULT result);
 
 // Helper functions
 void ExecuteCpuid(DWORD function, PCPUID_RESULT result);
+void GetCpuidInfo(PHV_CPUID_INFO info);
 BOOL IsRunningAsAdmin();
 void AppendToDetails(PDETECTION_RESULT result, const char* format, ...);
 
@@ -70,8 +70,8 @@ DWORD CheckNestedHyperV(PDETECTION_RESULT result) {
     DWORD size = sizeof(value);
     
     // Check for nested virtualization capability
-    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "SYSTEM\\CurrentControlSet\\Control\\DeviceGuard", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        if (RegQueryValueExA(hKey, "EnableVirtualizationBasedSecurity", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_DEVICEGUARD, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_VBS, NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
             if (value) {
                 detected |= HYPERV_DETECTED_NESTED;
                 AppendToDetails(result, "Nested: Virtualization-based security enabled\n");
@@ -81,8 +81,8 @@ DWORD CheckNestedHyperV(PDETECTION_RESULT result) {
     }
     
     // Check for Hyper-V running with nested support
-    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Virtualization", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        if (RegQueryValueExA(hKey, "NestedVirtualization", NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_VIRTUALIZATION, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_NESTED, NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
             if (value) {
                 detected |= HYPERV_DETECTED_NESTED;
                 AppendToDetails(result, "Nested: Nested virtualization support detected\n");
@@ -199,6 +199,44 @@ DWORD CheckRemovedHyperV(PDETECTION_RESULT result) {
     return detected;
 }
 
+// Print s as a JSON string literal (quotes, backslashes and control characters escaped)
+static void PrintJsonString(const char* s) {
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c == '\n') {
+            printf("\\n");
+        } else if (c == '\r') {
+            printf("\\r");
+        } else if (c == '\t') {
+            printf("\\t");
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+// DeviceGuard DWORD value, 0 when absent
+static DWORD ReadDeviceGuardValue(const char* name) {
+    HKEY hKey;
+    DWORD value = 0;
+    DWORD size = sizeof(value);
+    
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, HV_REG_KEY_DEVICEGUARD, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+        if (RegQueryValueExA(hKey, name, NULL, NULL, (LPBYTE)&value, &size) != ERROR_SUCCESS) {
+            value = 0;
+        }
+        RegCloseKey(hKey);
+    }
+    return value;
+}
+
 int main(int argc, char* argv[]) {
     DETECTION_RESULT result = {0};
     DWORD totalFlags = 0;
@@ -321,14 +359,41 @@ int main(int argc, char* argv[]) {
     
     if (argc > 1 && strcmp(argv[1], "--json") == 0) {
         // Output JSON format for automated processing
+        // flags, verdict, hv_build, vbs and hvci are what hyperv_fleet (src/fleet) aggregates
+        HV_CPUID_INFO cpuidInfo;
+        char verdict[64];
+        char host[MAX_COMPUTERNAME_LENGTH + 1] = "";
+        DWORD hostSize = sizeof(host);
+        
+        GetCpuidInfo(&cpuidInfo);
+        HvClassifyPartition(&cpuidInfo, verdict, sizeof(verdict));
+        GetComputerNameA(host, &hostSize);
+        
         printf("\n=== JSON OUTPUT ===\n");
         printf("{\n");
+        printf("  \"host\": ");
+        PrintJsonString(host);
+        printf(",\n");
         printf("  \"detected\": %s,\n", (totalFlags != 0) ? "true" : "false");
         printf("  \"flags\": \"0x%08X\",\n", totalFlags);
+        printf("  \"verdict\": ");
+        PrintJsonString(verdict);
+        printf(",\n");
+        if (cpuidInfo.IsMicrosoftHv) {
+            printf("  \"hv_build\": \"%u.%u.%u\",\n",
+                   cpuidInfo.MajorVersion, cpuidInfo.MinorVersion, cpuidInfo.BuildNumber);
+        } else {
+            printf("  \"hv_build\": null,\n");
+        }
+        printf("  \"vbs\": %s,\n", ReadDeviceGuardValue(HV_REG_VALUE_VBS) ? "true" : "false");
+        printf("  \"hvci\": %s,\n", ReadDeviceGuardValue(HV_REG_VALUE_HVCI) ? "true" : "false");
         printf("  \"process_id\": %d,\n", result.ProcessId);
-        printf("  \"process_name\": \"%s\",\n", result.ProcessName);
-        printf("  \"details\": \"%s\"\n", result.Details);
-        printf("}\n");
+        printf("  \"process_name\": ");
+        PrintJsonString(result.ProcessName);
+        printf(",\n");
+        printf("  \"details\": ");
+        PrintJsonString(result.Details);
+        printf("\n}\n");
     }
     
     return (totalFlags != 0) ? 1 : 0;
@@ -15,6 +15,10 @@
  */
 
 #include "hyperv_detector.h"
+#include "device_index.h"
+#include "perf_session.h"
+#include "wmi_pool.h"
+#include "../common/result_codec.h"
 #include <stdio.h>
 #include <time.h>
 
@@ -278,88 +282,180 @@ DWORD CheckRemovedHyperV(PDETECTION_RESULT result) {
     return detected;
 }
 
+// Wall time of each check, in RunDetection order, for --binary
+typedef struct _CHECK_TIMING {
+    const char* Name;
+    UINT64 Microseconds;
+} CHECK_TIMING;
+
+static CHECK_TIMING g_checkTimings[HV_RESULT_MAX_TIMINGS];
+static UINT32 g_checkTimingCount = 0;
+
+static DWORD TimedCheck(const char* name, DWORD (*check)(PDETECTION_RESULT), PDETECTION_RESULT result) {
+    LARGE_INTEGER frequency, start, end;
+    DWORD flags;
+    
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    flags = check(result);
+    QueryPerformanceCounter(&end);
+    
+    if (g_checkTimingCount < HV_RESULT_MAX_TIMINGS) {
+        g_checkTimings[g_checkTimingCount].Name = name;
+        g_checkTimings[g_checkTimingCount].Microseconds =
+            (UINT64)(end.QuadPart - start.QuadPart) * 1000000 / (UINT64)frequency.QuadPart;
+        g_checkTimingCount++;
+    }
+    return flags;
+}
+
 DWORD RunDetection(PDETECTION_RESULT result, DETECTION_LEVEL level) {
     DWORD totalFlags = 0;
     
     // Fast checks (always run)
     printf("[*] Running CPUID checks...\n");
-    totalFlags |= CheckCpuidHyperV(result);
+    totalFlags |= TimedCheck("cpuid", CheckCpuidHyperV, result);
     
     printf("[*] Running registry checks...\n");
-    totalFlags |= CheckRegistryHyperV(result);
+    totalFlags |= TimedCheck("registry", CheckRegistryHyperV, result);
     
     printf("[*] Running file system checks...\n");
-    totalFlags |= CheckFilesHyperV(result);
+    totalFlags |= TimedCheck("files", CheckFilesHyperV, result);
     
     if (level >= DETECTION_LEVEL_NORMAL) {
         printf("[*] Running service checks...\n");
-        totalFlags |= CheckServicesHyperV(result);
+        totalFlags |= TimedCheck("services", CheckServicesHyperV, result);
         
         printf("[*] Running device checks...\n");
-        totalFlags |= CheckDevicesHyperV(result);
+        totalFlags |= TimedCheck("devices", CheckDevicesHyperV, result);
         
         printf("[*] Running BIOS checks...\n");
-        totalFlags |= CheckBiosHyperV(result);
+        totalFlags |= TimedCheck("bios", CheckBiosHyperV, result);
         
         printf("[*] Running process checks...\n");
-        totalFlags |= CheckProcessesHyperV(result);
+        totalFlags |= TimedCheck("processes", CheckProcessesHyperV, result);
         
         printf("[*] Running Windows object checks...\n");
-        totalFlags |= CheckWindowsObjectsHyperV(result);
+        totalFlags |= TimedCheck("objects", CheckWindowsObjectsHyperV, result);
     }
     
     if (level >= DETECTION_LEVEL_THOROUGH) {
         printf("[*] Running nested virtualization checks...\n");
-        totalFlags |= CheckNestedHyperV(result);
+        totalFlags |= TimedCheck("nested", CheckNestedHyperV, result);
         
         printf("[*] Running Windows Sandbox checks...\n");
-        totalFlags |= CheckWindowsSandbox(result);
+        totalFlags |= TimedCheck("sandbox", CheckWindowsSandbox, result);
         
         printf("[*] Running Docker checks...\n");
-        totalFlags |= CheckDockerHyperV(result);
+        totalFlags |= TimedCheck("docker", CheckDockerHyperV, result);
         
         printf("[*] Running removed Hyper-V checks...\n");
-        totalFlags |= CheckRemovedHyperV(result);
+        totalFlags |= TimedCheck("removed", CheckRemovedHyperV, result);
         
         // New detection methods
         printf("[*] Running WMI checks...\n");
-        totalFlags |= CheckWMIHyperV(result);
+        totalFlags |= TimedCheck("wmi", CheckWMIHyperV, result);
         
         printf("[*] Running MAC address checks...\n");
-        totalFlags |= CheckMACAddressHyperV(result);
+        totalFlags |= TimedCheck("mac", CheckMACAddressHyperV, result);
         
         printf("[*] Running firmware/SMBIOS checks...\n");
-        totalFlags |= CheckFirmwareHyperV(result);
+        totalFlags |= TimedCheck("firmware", CheckFirmwareHyperV, result);
         
         printf("[*] Running performance counter checks...\n");
-        totalFlags |= CheckPerfCountersHyperV(result);
-        totalFlags |= CheckETWProvidersHyperV(result);
+        totalFlags |= TimedCheck("perfcounters", CheckPerfCountersHyperV, result);
+        totalFlags |= TimedCheck("etw", CheckETWProvidersHyperV, result);
         
         printf("[*] Running event log checks...\n");
-        totalFlags |= CheckEventLogsHyperV(result);
+        totalFlags |= TimedCheck("eventlog", CheckEventLogsHyperV, result);
         
         printf("[*] Running security features checks...\n");
-        totalFlags |= CheckSecurityFeaturesHyperV(result);
+        totalFlags |= TimedCheck("security", CheckSecurityFeaturesHyperV, result);
         
         printf("[*] Running Windows features checks...\n");
-        totalFlags |= CheckWindowsFeaturesHyperV(result);
+        totalFlags |= TimedCheck("features", CheckWindowsFeaturesHyperV, result);
         
         printf("[*] Running storage checks...\n");
-        totalFlags |= CheckStorageHyperV(result);
+        totalFlags |= TimedCheck("storage", CheckStorageHyperV, result);
     }
     
     if (level >= DETECTION_LEVEL_FULL) {
         printf("[*] Running timing analysis...\n");
-        totalFlags |= CheckTimingHyperV(result);
+        totalFlags |= TimedCheck("timing", CheckTimingHyperV, result);
         
         printf("[*] Running descriptor table checks...\n");
-        totalFlags |= CheckDescriptorTablesHyperV(result);
+        totalFlags |= TimedCheck("descriptors", CheckDescriptorTablesHyperV, result);
     }
     
     result->DetectionFlags = totalFlags;
     return totalFlags;
 }
 
+// Append one result_codec.h record to path. Detail lines become named
+// fields ("Registry: Found key X" -> Registry = "Found key X") with --details.
+static int WriteBinaryResult(const char* path, PDETECTION_RESULT result, DETECTION_LEVEL level, BOOL withDetails) {
+    static HV_RESULT_WRITER writer;
+    static UINT8 record[8192];
+    char host[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD hostSize = sizeof(host);
+    FILE* file;
+    int size;
+    
+    HvResultWriterInit(&writer, result->DetectionFlags);
+    HvResultAddUint(&writer, HV_RESULT_KEY_TOOL_VERSION,
+                    (VERSION_MAJOR << 16) | (VERSION_MINOR << 8) | VERSION_PATCH);
+    if (GetComputerNameA(host, &hostSize)) {
+        HvResultAddString(&writer, HV_RESULT_KEY_HOST, host, hostSize);
+    }
+    HvResultAddUint(&writer, HV_RESULT_KEY_PROCESS_ID, result->ProcessId);
+    HvResultAddString(&writer, HV_RESULT_KEY_PROCESS_NAME, result->ProcessName, strlen(result->ProcessName));
+    HvResultAddUint(&writer, HV_RESULT_KEY_LEVEL, (UINT64)level);
+    
+    for (UINT32 i = 0; i < g_checkTimingCount; i++) {
+        HvResultAddTiming(&writer, g_checkTimings[i].Name, g_checkTimings[i].Microseconds);
+    }
+    
+    // Details are already capped at sizeof(result->Details); lines past the
+    // record limits are dropped the same way
+    const char* line = result->Details;
+    while (withDetails && *line != '\0') {
+        const char* end = strchr(line, '\n');
+        size_t length = (end != NULL) ? (size_t)(end - line) : strlen(line);
+        const char* separator = NULL;
+        
+        if (writer.FieldCount == HV_RESULT_MAX_FIELDS || writer.StringCount + 2 > HV_RESULT_MAX_STRINGS) {
+            break;
+        }
+        for (size_t j = 0; j + 1 < length; j++) {
+            if (line[j] == ':' && line[j + 1] == ' ') {
+                separator = line + j;
+                break;
+            }
+        }
+        if (separator != NULL) {
+            HvResultAddNamed(&writer, line, (size_t)(separator - line),
+                             separator + 2, length - (size_t)(separator + 2 - line));
+        } else if (length > 0) {
+            HvResultAddNamed(&writer, "Details", 7, line, length);
+        }
+        line += length + (end != NULL ? 1 : 0);
+    }
+    
+    size = HvResultEncode(&writer, record, sizeof(record));
+    if (size < 0) {
+        return -1;
+    }
+    file = fopen(path, "ab");
+    if (file == NULL) {
+        return -1;
+    }
+    if (fwrite(record, 1, (size_t)size, file) != (size_t)size) {
+        fclose(file);
+        return -1;
+    }
+    return (fclose(file) == 0) ? 0 : -1;
+}
+
 void PrintUsage(const char* programName) {
     printf("\nUsage: %s [options]\n\n", programName);
     printf("Options:\n");
@@ -368,8 +464,14 @@ void PrintUsage(const char* programName) {
     printf("  --thorough   Run all non-invasive detection methods\n");
     printf("  --full       Run all detection methods including timing analysis\n");
     printf("  --json       Output results in JSON format\n");
+    printf("  --binary <file>  Append a compact binary result record (see result_codec.h)\n");
     printf("  --quiet      Suppress progress output\n");
     printf("  --details    Show detailed detection output\n");
+    printf("  --save-devices <file>  Save the enumerated device tree for offline replay\n");
+    printf("  --load-devices <file>  Replay a saved device tree instead of enumerating\n");
+    printf("  --sample-counters <file>  Record hypervisor LP/VP counters to a time-series file\n");
+    printf("  --sample-interval <ms>    Sampling interval (default 1000)\n");
+    printf("  --sample-duration <s>     Sampling duration, 0 = until Ctrl+C (default 0)\n");
     printf("  --help       Show this help message\n");
     printf("\n");
 }
@@ -380,6 +482,12 @@ int main(int argc, char* argv[]) {
     BOOL jsonOutput = FALSE;
     BOOL quietMode = FALSE;
     BOOL showDetails = FALSE;
+    const char* saveDevicesPath = NULL;
+    const char* loadDevicesPath = NULL;
+    const char* samplePath = NULL;
+    const char* binaryPath = NULL;
+    DWORD sampleIntervalMs = 1000;
+    DWORD sampleDurationSeconds = 0;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -393,16 +501,46 @@ int main(int argc, char* argv[]) {
             level = DETECTION_LEVEL_FULL;
         } else if (strcmp(argv[i], "--json") == 0) {
             jsonOutput = TRUE;
+        } else if (strcmp(argv[i], "--binary") == 0 && i + 1 < argc) {
+            binaryPath = argv[++i];
         } else if (strcmp(argv[i], "--quiet") == 0) {
             quietMode = TRUE;
         } else if (strcmp(argv[i], "--details") == 0) {
             showDetails = TRUE;
+        } else if (strcmp(argv[i], "--save-devices") == 0 && i + 1 < argc) {
+            saveDevicesPath = argv[++i];
+        } else if (strcmp(argv[i], "--load-devices") == 0 && i + 1 < argc) {
+            loadDevicesPath = argv[++i];
+        } else if (strcmp(argv[i], "--sample-counters") == 0 && i + 1 < argc) {
+            samplePath = argv[++i];
+        } else if (strcmp(argv[i], "--sample-interval") == 0 && i + 1 < argc) {
+            sampleIntervalMs = (DWORD)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--sample-duration") == 0 && i + 1 < argc) {
+            sampleDurationSeconds = (DWORD)strtoul(argv[++i], NULL, 10);
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             PrintUsage(argv[0]);
             return 0;
         }
     }
     
+    // Sampling mode: record counters and exit, no detection pass
+    if (samplePath != NULL) {
+        int frames = 0;
+        
+        if (!quietMode) {
+            printf("Sampling hypervisor counters to %s every %lu ms...\n", samplePath, sampleIntervalMs);
+        }
+        frames = PerfSampleHypervisorCounters(samplePath, sampleIntervalMs, sampleDurationSeconds);
+        if (frames < 0) {
+            fprintf(stderr, "[!] Failed to start counter sampling: %s\n", samplePath);
+            return 2;
+        }
+        if (!quietMode) {
+            printf("Recorded %d sample(s)\n", frames);
+        }
+        return 0;
+    }
+    
     if (!quietMode && !jsonOutput) {
         printf("\n");
         printf("================================================================================\n");
@@ -434,9 +572,31 @@ int main(int argc, char* argv[]) {
     result.ProcessId = GetCurrentProcessId();
     GetModuleFileNameA(NULL, result.ProcessName, sizeof(result.ProcessName));
     
+    // Device tree replay / capture
+    if (loadDevicesPath != NULL) {
+        PDEVICE_INDEX replay = DeviceIndexLoad(loadDevicesPath);
+        if (replay == NULL) {
+            fprintf(stderr, "[!] Failed to load device snapshot: %s\n", loadDevicesPath);
+            return 2;
+        }
+        SetDeviceIndex(replay);
+    }
+    
+    if (saveDevicesPath != NULL && DeviceIndexSave(GetDeviceIndex(), saveDevicesPath) != 0) {
+        fprintf(stderr, "[!] Failed to save device snapshot: %s\n", saveDevicesPath);
+    }
+    
     // Run detection
     DWORD totalFlags = RunDetection(&result, level);
     
+    // No WMI or counter lookups past this point: release the pooled sessions and the PDH query
+    WmiPoolShutdown();
+    PerfSessionClose();
+    
+    if (binaryPath != NULL && WriteBinaryResult(binaryPath, &result, level, showDetails) != 0) {
+        fprintf(stderr, "[!] Failed to write binary result: %s\n", binaryPath);
+    }
+    
     // Output results
     if (jsonOutput) {
         // JSON output
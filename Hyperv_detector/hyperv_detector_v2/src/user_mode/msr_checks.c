@@ -12,6 +12,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "driver_batch.h"
 #include <stdio.h>
 /* intrin.h included conditionally via common.h */
 
@@ -163,6 +164,125 @@ static int CountMSRPermissions(void)
     return count;
 }
 
+/*
+ * Read every MSR in g_HyperVMSRs plus the VP index through the kernel driver
+ * in one IOCTL_HYPERV_BATCH call. Returns the number of MSRs that could be
+ * read, or -1 if the driver is not available.
+ */
+static int SweepMSRsViaDriver(PDETECTION_RESULT result)
+{
+    HV_BATCH_OP ops[sizeof(g_HyperVMSRs) / sizeof(g_HyperVMSRs[0])] = {0};
+    HV_BATCH_RESULT results[sizeof(g_HyperVMSRs) / sizeof(g_HyperVMSRs[0])] = {0};
+    HANDLE device = INVALID_HANDLE_VALUE;
+    UINT32 count = 0;
+    UINT32 i = 0;
+    int readable = 0;
+
+    device = DriverBatchOpen();
+    if (device == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    /* The table's terminator slot carries the VP index query */
+    for (i = 0; g_HyperVMSRs[i].name != NULL; i++) {
+        ops[count].Type = HV_BATCH_OP_RDMSR;
+        ops[count].Arg[0] = g_HyperVMSRs[i].msrAddress;
+        count++;
+    }
+    ops[count++].Type = HV_BATCH_OP_VP_INDEX;
+
+    if (DriverBatchExecute(device, ops, count, results) != (int)count) {
+        CloseHandle(device);
+        return -1;
+    }
+    CloseHandle(device);
+
+    AppendToDetails(result, "  Driver MSR sweep (%u ops, 1 IOCTL):\n", count);
+    for (i = 0; i + 1 < count; i++) {
+        if (results[i].Status == HV_BATCH_STATUS_OK) {
+            AppendToDetails(result, "    %-28s 0x%016llX\n", g_HyperVMSRs[i].name,
+                           (unsigned long long)HvBatchResultValue64(&results[i]));
+            readable++;
+        } else {
+            AppendToDetails(result, "    %-28s not readable (0x%08X)\n", g_HyperVMSRs[i].name,
+                           results[i].Detail);
+        }
+    }
+    if (results[count - 1].Status == HV_BATCH_STATUS_OK) {
+        AppendToDetails(result, "    Current VP index: %u\n", results[count - 1].Value[0]);
+    }
+
+    return readable;
+}
+
+/*
+ * Compare the hypervisor CPUID leaves, the hypercall MSR and the VP index
+ * across all processors with one IOCTL_HYPERV_BATCH_ALL_CPUS call. Leaves
+ * and the partition-wide MSR should match everywhere; VP indexes should not
+ * repeat. Returns the number of inconsistencies, or -1 without the driver.
+ */
+static int CheckPerProcessorConsistency(PDETECTION_RESULT result)
+{
+    static const HV_BATCH_OP ops[] = {
+        { HV_BATCH_OP_CPUID, 0, { 0x40000000, 0, 0 } },
+        { HV_BATCH_OP_CPUID, 0, { 0x40000001, 0, 0 } },
+        { HV_BATCH_OP_CPUID, 0, { 0x40000003, 0, 0 } },
+        { HV_BATCH_OP_CPUID, 0, { 0x40000004, 0, 0 } },
+        { HV_BATCH_OP_RDMSR, 0, { HV_X64_MSR_HYPERCALL, 0, 0 } },
+        { HV_BATCH_OP_VP_INDEX, 0, { 0, 0, 0 } }
+    };
+    const UINT32 opCount = sizeof(ops) / sizeof(ops[0]);
+    const UINT32 vpIndexOp = opCount - 1;
+    HV_FANOUT_SUMMARY summary = {0};
+    HV_BATCH_RESULT a = {0};
+    HV_BATCH_RESULT b = {0};
+    HANDLE device = INVALID_HANDLE_VALUE;
+    UINT8* matrix = NULL;
+    UINT32 processors = 0;
+    UINT32 i = 0;
+    UINT32 j = 0;
+    int inconsistent = 0;
+
+    device = DriverBatchOpen();
+    if (device == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    matrix = DriverBatchExecuteAllProcessors(device, ops, opCount, &processors);
+    CloseHandle(device);
+    if (matrix == NULL) {
+        return -1;
+    }
+
+    AppendToDetails(result, "  Per-processor consistency (%u processors, 1 IOCTL):\n", processors);
+    for (i = 0; i < vpIndexOp; i++) {
+        HvFanoutGetSummary(matrix, i, &summary);
+        AppendToDetails(result, "    %s 0x%08X: %u ok, %u failed, %s\n",
+                       ops[i].Type == HV_BATCH_OP_CPUID ? "CPUID" : "MSR  ", ops[i].Arg[0],
+                       summary.OkCount, summary.FailCount,
+                       (summary.Flags & HV_FANOUT_UNIFORM) ? "uniform" : "DIFFERS");
+        if (summary.OkCount > 0 && !(summary.Flags & HV_FANOUT_UNIFORM)) {
+            inconsistent++;
+        }
+    }
+
+    /* VP indexes must be unique (O(n^2) is fine for processor counts) */
+    for (i = 0; i < processors; i++) {
+        if (HvFanoutGetCell(matrix, opCount, i, vpIndexOp, &a) != 0 || a.Status != HV_BATCH_STATUS_OK) {
+            continue;
+        }
+        for (j = i + 1; j < processors; j++) {
+            if (HvFanoutGetCell(matrix, opCount, j, vpIndexOp, &b) == 0 && b.Status == HV_BATCH_STATUS_OK &&
+                a.Value[0] == b.Value[0]) {
+                AppendToDetails(result, "    VP index %u reported by processors %u and %u\n", a.Value[0], i, j);
+                inconsistent++;
+            }
+        }
+    }
+
+    free(matrix);
+    return inconsistent;
+}
+
 /*
  * Main MSR check function
  */
@@ -222,6 +342,12 @@ DWORD CheckMSRHyperV(PDETECTION_RESULT result)
         AppendToDetails(result, "  - Reference TSC: YES\n");
     }
     
+    /* Actual MSR values need ring 0 */
+    if (SweepMSRsViaDriver(result) > 0) {
+        detected = HYPERV_DETECTED_MSR;
+        CheckPerProcessorConsistency(result);
+    }
+    
     return detected;
 }
 
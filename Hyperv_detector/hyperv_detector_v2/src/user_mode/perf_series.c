@@ -0,0 +1,369 @@
+/**
+ * perf_series.c - Compact binary time-series file for counter sampling
+ *
+ * See perf_series.h for the file layout.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "perf_series.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct _PERF_SERIES_READER {
+    FILE* file;
+    uint32_t intervalMs;
+    uint64_t startMs;
+    uint64_t lastFrameMs;
+    char** names;
+    uint32_t nameCount;
+    uint32_t nameCapacity;
+    uint32_t* ids;
+    float* values;
+    uint32_t frameCapacity;
+};
+
+/*
+ * Little-endian and varint primitives
+ */
+static int WriteBytes(FILE* file, const void* data, size_t size)
+{
+    return fwrite(data, 1, size, file) == size ? 0 : -1;
+}
+
+static int WriteLe(FILE* file, uint64_t value, int size)
+{
+    unsigned char bytes[8];
+    int i = 0;
+
+    for (i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    return WriteBytes(file, bytes, (size_t)size);
+}
+
+static int WriteVarint(FILE* file, uint64_t value)
+{
+    unsigned char bytes[10];
+    int length = 0;
+
+    do {
+        unsigned char byte = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        bytes[length++] = value ? (unsigned char)(byte | 0x80) : byte;
+    } while (value);
+
+    return WriteBytes(file, bytes, (size_t)length);
+}
+
+static int WriteFloat(FILE* file, float value)
+{
+    uint32_t bits = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return WriteLe(file, bits, 4);
+}
+
+static int ReadLe(FILE* file, uint64_t* value, int size)
+{
+    unsigned char bytes[8];
+    int i = 0;
+
+    if (fread(bytes, 1, (size_t)size, file) != (size_t)size) {
+        return -1;
+    }
+    *value = 0;
+    for (i = 0; i < size; i++) {
+        *value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return 0;
+}
+
+static int ReadVarint(FILE* file, uint64_t* value)
+{
+    int shift = 0;
+    int c = 0;
+
+    *value = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+        c = fgetc(file);
+        if (c == EOF) {
+            return -1;
+        }
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int PerfSeriesCreate(PPERF_SERIES_WRITER writer, const char* path, uint32_t intervalMs, uint64_t startMs)
+{
+    memset(writer, 0, sizeof(*writer));
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return -1;
+    }
+
+    writer->lastFrameMs = startMs;
+    if (WriteLe(writer->file, PERF_SERIES_MAGIC, 4) != 0 ||
+        WriteLe(writer->file, PERF_SERIES_VERSION, 4) != 0 ||
+        WriteLe(writer->file, intervalMs, 4) != 0 ||
+        WriteLe(writer->file, 0, 4) != 0 ||
+        WriteLe(writer->file, startMs, 8) != 0) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int PerfSeriesDefine(PPERF_SERIES_WRITER writer, const char* name)
+{
+    size_t length = strlen(name);
+    uint32_t id = writer->seriesCount;
+
+    if (writer->file == NULL || length >= PERF_SERIES_MAX_NAME || id >= PERF_SERIES_MAX_SERIES) {
+        return -1;
+    }
+
+    if (fputc(PERF_SERIES_TAG_DEFINE, writer->file) == EOF ||
+        WriteVarint(writer->file, id) != 0 ||
+        WriteVarint(writer->file, length) != 0 ||
+        WriteBytes(writer->file, name, length) != 0) {
+        return -1;
+    }
+
+    writer->seriesCount++;
+    return (int)id;
+}
+
+int PerfSeriesWriteFrame(PPERF_SERIES_WRITER writer, uint64_t timeMs,
+                         const uint32_t* ids, const float* values, uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t previous = 0;
+
+    if (writer->file == NULL || timeMs < writer->lastFrameMs) {
+        return -1;
+    }
+
+    /* Validate first so a rejected frame leaves nothing behind in the file */
+    for (i = 0; i < count; i++) {
+        if (ids[i] >= writer->seriesCount || (i > 0 && ids[i] <= ids[i - 1])) {
+            return -1;
+        }
+    }
+
+    if (fputc(PERF_SERIES_TAG_FRAME, writer->file) == EOF ||
+        WriteVarint(writer->file, timeMs - writer->lastFrameMs) != 0 ||
+        WriteVarint(writer->file, count) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (WriteVarint(writer->file, i == 0 ? ids[i] : ids[i] - previous) != 0 ||
+            WriteFloat(writer->file, values[i]) != 0) {
+            return -1;
+        }
+        previous = ids[i];
+    }
+
+    writer->lastFrameMs = timeMs;
+    return 0;
+}
+
+int PerfSeriesFinish(PPERF_SERIES_WRITER writer)
+{
+    int status = 0;
+
+    if (writer->file != NULL) {
+        status = fclose(writer->file) == 0 ? 0 : -1;
+        writer->file = NULL;
+    }
+    return status;
+}
+
+PPERF_SERIES_READER PerfSeriesOpen(const char* path)
+{
+    PPERF_SERIES_READER reader = NULL;
+    uint64_t magic = 0;
+    uint64_t version = 0;
+    uint64_t interval = 0;
+    uint64_t reserved = 0;
+
+    reader = (PPERF_SERIES_READER)calloc(1, sizeof(*reader));
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL ||
+        ReadLe(reader->file, &magic, 4) != 0 || magic != PERF_SERIES_MAGIC ||
+        ReadLe(reader->file, &version, 4) != 0 || version != PERF_SERIES_VERSION ||
+        ReadLe(reader->file, &interval, 4) != 0 ||
+        ReadLe(reader->file, &reserved, 4) != 0 ||
+        ReadLe(reader->file, &reader->startMs, 8) != 0) {
+        PerfSeriesClose(reader);
+        return NULL;
+    }
+
+    reader->intervalMs = (uint32_t)interval;
+    reader->lastFrameMs = reader->startMs;
+    return reader;
+}
+
+void PerfSeriesClose(PPERF_SERIES_READER reader)
+{
+    uint32_t i = 0;
+
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+    for (i = 0; i < reader->nameCount; i++) {
+        free(reader->names[i]);
+    }
+    free(reader->names);
+    free(reader->ids);
+    free(reader->values);
+    free(reader);
+}
+
+uint32_t PerfSeriesInterval(const PERF_SERIES_READER* reader)
+{
+    return reader->intervalMs;
+}
+
+uint64_t PerfSeriesStart(const PERF_SERIES_READER* reader)
+{
+    return reader->startMs;
+}
+
+/*
+ * Consume one definition record (tag already read)
+ */
+static int ReadDefinition(PPERF_SERIES_READER reader)
+{
+    uint64_t id = 0;
+    uint64_t length = 0;
+    char* name = NULL;
+
+    if (ReadVarint(reader->file, &id) != 0 || ReadVarint(reader->file, &length) != 0 ||
+        id != reader->nameCount || length >= PERF_SERIES_MAX_NAME || id >= PERF_SERIES_MAX_SERIES) {
+        return -1;
+    }
+
+    if (reader->nameCount == reader->nameCapacity) {
+        uint32_t capacity = reader->nameCapacity ? reader->nameCapacity * 2 : 64;
+        char** grown = (char**)realloc(reader->names, capacity * sizeof(char*));
+        if (grown == NULL) {
+            return -1;
+        }
+        reader->names = grown;
+        reader->nameCapacity = capacity;
+    }
+
+    name = (char*)malloc((size_t)length + 1);
+    if (name == NULL) {
+        return -1;
+    }
+    if (fread(name, 1, (size_t)length, reader->file) != (size_t)length) {
+        free(name);
+        return -1;
+    }
+    name[length] = '\0';
+
+    reader->names[reader->nameCount++] = name;
+    return 0;
+}
+
+int PerfSeriesNextFrame(PPERF_SERIES_READER reader, PPERF_SERIES_FRAME frame)
+{
+    uint64_t delta = 0;
+    uint64_t count = 0;
+    uint64_t idDelta = 0;
+    uint64_t bits = 0;
+    uint64_t id = 0;
+    uint32_t i = 0;
+    int tag = 0;
+
+    for (;;) {
+        tag = fgetc(reader->file);
+        if (tag == EOF) {
+            return 0;
+        }
+        if (tag == PERF_SERIES_TAG_DEFINE) {
+            if (ReadDefinition(reader) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (tag != PERF_SERIES_TAG_FRAME) {
+            return -1;
+        }
+        break;
+    }
+
+    if (ReadVarint(reader->file, &delta) != 0 || ReadVarint(reader->file, &count) != 0 ||
+        count > reader->nameCount) {
+        return -1;
+    }
+
+    if (count > reader->frameCapacity) {
+        uint32_t* ids = (uint32_t*)realloc(reader->ids, (size_t)count * sizeof(uint32_t));
+        float* values = NULL;
+
+        if (ids == NULL) {
+            return -1;
+        }
+        reader->ids = ids;
+        values = (float*)realloc(reader->values, (size_t)count * sizeof(float));
+        if (values == NULL) {
+            return -1;
+        }
+        reader->values = values;
+        reader->frameCapacity = (uint32_t)count;
+    }
+
+    for (i = 0; i < count; i++) {
+        float value = 0.0f;
+        uint32_t valueBits = 0;
+
+        if (ReadVarint(reader->file, &idDelta) != 0 || ReadLe(reader->file, &bits, 4) != 0) {
+            return -1;
+        }
+        if (i > 0 && idDelta == 0) {
+            return -1;
+        }
+        id = (i == 0) ? idDelta : id + idDelta;
+        if (id >= reader->nameCount) {
+            return -1;
+        }
+
+        valueBits = (uint32_t)bits;
+        memcpy(&value, &valueBits, sizeof(value));
+        reader->ids[i] = (uint32_t)id;
+        reader->values[i] = value;
+    }
+
+    reader->lastFrameMs += delta;
+    frame->timeMs = reader->lastFrameMs;
+    frame->count = (uint32_t)count;
+    frame->ids = reader->ids;
+    frame->values = reader->values;
+    return 1;
+}
+
+const char* PerfSeriesName(const PERF_SERIES_READER* reader, uint32_t id)
+{
+    return id < reader->nameCount ? reader->names[id] : NULL;
+}
+
+uint32_t PerfSeriesCount(const PERF_SERIES_READER* reader)
+{
+    return reader->nameCount;
+}
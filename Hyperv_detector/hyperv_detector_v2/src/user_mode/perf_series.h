@@ -0,0 +1,93 @@
+/**
+ * perf_series.h - Compact binary time-series file for counter sampling
+ *
+ * File layout (little-endian):
+ *
+ *   header   u32 magic "HVTS", u32 version, u32 intervalMs, u32 reserved,
+ *            u64 startMs (milliseconds since the Unix epoch)
+ *   records  u8 tag followed by the record body
+ *
+ *   PERF_SERIES_TAG_DEFINE  varint id, varint nameLength, name bytes (UTF-8)
+ *   PERF_SERIES_TAG_FRAME   varint msSincePreviousFrame, varint count,
+ *                           count x { varint idDelta, f32 value }
+ *
+ * Series are defined once, the first time they appear, so counter instances
+ * that come and go (virtual processors of starting VMs) just get new ids.
+ * Inside a frame ids are strictly ascending and stored as deltas, which keeps
+ * a sample of one series at ~5 bytes.
+ *
+ * Plain C; builds on any platform.
+ */
+
+#pragma once
+#ifndef PERF_SERIES_H
+#define PERF_SERIES_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PERF_SERIES_MAGIC          0x53545648  /* "HVTS" */
+#define PERF_SERIES_VERSION        1
+
+#define PERF_SERIES_TAG_DEFINE     0x01
+#define PERF_SERIES_TAG_FRAME      0x02
+
+#define PERF_SERIES_MAX_NAME       512
+#define PERF_SERIES_MAX_SERIES     65536
+
+typedef struct _PERF_SERIES_WRITER {
+    FILE* file;
+    uint32_t seriesCount;
+    uint64_t lastFrameMs;
+} PERF_SERIES_WRITER, *PPERF_SERIES_WRITER;
+
+typedef struct _PERF_SERIES_FRAME {
+    uint64_t timeMs;            /* Absolute, milliseconds since the Unix epoch */
+    uint32_t count;
+    const uint32_t* ids;        /* Owned by the reader, valid until the next call */
+    const float* values;
+} PERF_SERIES_FRAME, *PPERF_SERIES_FRAME;
+
+typedef struct _PERF_SERIES_READER PERF_SERIES_READER, *PPERF_SERIES_READER;
+
+/*
+ * Writer. All functions return 0 on success, -1 on error.
+ */
+int PerfSeriesCreate(PPERF_SERIES_WRITER writer, const char* path, uint32_t intervalMs, uint64_t startMs);
+
+/*
+ * Define a new series; returns its id or -1
+ */
+int PerfSeriesDefine(PPERF_SERIES_WRITER writer, const char* name);
+
+/*
+ * Append one frame. ids must be strictly ascending.
+ */
+int PerfSeriesWriteFrame(PPERF_SERIES_WRITER writer, uint64_t timeMs,
+                         const uint32_t* ids, const float* values, uint32_t count);
+
+int PerfSeriesFinish(PPERF_SERIES_WRITER writer);
+
+/*
+ * Reader
+ */
+PPERF_SERIES_READER PerfSeriesOpen(const char* path);
+void PerfSeriesClose(PPERF_SERIES_READER reader);
+
+uint32_t PerfSeriesInterval(const PERF_SERIES_READER* reader);
+uint64_t PerfSeriesStart(const PERF_SERIES_READER* reader);
+
+/*
+ * Next frame: 1 = frame returned, 0 = end of file, -1 = corrupt file.
+ * Definition records are consumed transparently.
+ */
+int PerfSeriesNextFrame(PPERF_SERIES_READER reader, PPERF_SERIES_FRAME frame);
+
+/*
+ * Name of a series defined so far, NULL if unknown
+ */
+const char* PerfSeriesName(const PERF_SERIES_READER* reader, uint32_t id);
+uint32_t PerfSeriesCount(const PERF_SERIES_READER* reader);
+
+#endif /* PERF_SERIES_H */
@@ -0,0 +1,478 @@
+/**
+ * perf_session.c - Shared PDH session and Hyper-V counter sampler
+ *
+ * Before: every counter check opened its own PDH query, collected it twice
+ * with a 100 ms sleep in between and closed it again, so a full counter pass
+ * cost roughly 100 ms per counter. Now all counters live in one query that is
+ * collected once per run.
+ *
+ * Sources: https://learn.microsoft.com/en-us/windows/win32/perfctrs/using-the-pdh-functions-to-consume-counter-data
+ *          https://learn.microsoft.com/en-us/windows/win32/api/pdh/nf-pdh-pdhgetformattedcounterarraya
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "perf_session.h"
+#include "perf_series.h"
+#include <pdh.h>
+#include <pdhmsg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma comment(lib, "pdh.lib")
+
+#define PERF_SESSION_MAX_COUNTERS      64
+#define PERF_SESSION_SAMPLE_GAP_MS     100
+#define PERF_SAMPLER_MIN_INTERVAL_MS   10
+#define PERF_SAMPLER_FLUSH_MS          1000
+
+/* 100ns ticks between 1601-01-01 and 1970-01-01 */
+#define FILETIME_UNIX_EPOCH            116444736000000000ULL
+
+/*
+ * Counters CheckPerfCountersHyperV reports (PerfSessionHyperVCounters), added
+ * up front with PERF_SESSION_EXTRA so the first lookup collects every counter
+ * the checks ask for in one pass
+ */
+static const char* HYPERV_PERF_COUNTERS[] = {
+    "\\Hyper-V Hypervisor\\Logical Processors",
+    "\\Hyper-V Hypervisor\\Virtual Processors",
+    "\\Hyper-V Hypervisor\\Partitions",
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Guest Run Time",
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Hypervisor Run Time",
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Total Run Time",
+    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Guest Run Time",
+    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Hypervisor Run Time",
+    "\\Hyper-V Hypervisor Root Virtual Processor(*)\\% Guest Run Time",
+    "\\Hyper-V Virtual Machine Health Summary\\Health Ok",
+    "\\Hyper-V Virtual Machine Bus Provider Pipes(*)\\Bytes Read/sec",
+    "\\Hyper-V Virtual Storage Device(*)\\Read Bytes/sec",
+    "\\Hyper-V Virtual Network Adapter(*)\\Bytes Received/sec",
+    "\\Hyper-V Virtual IDE Controller (Emulated)(*)\\Read Bytes/sec",
+    "\\Hyper-V Virtual Switch(*)\\Bytes/sec",
+    "\\Hyper-V VM Vid Driver(*)\\Remote Physical Pages",
+    "\\Hyper-V VM Vid Partition(*)\\Physical Pages Allocated",
+    NULL
+};
+
+/* Looked up by the root partition check only */
+static const char* PERF_SESSION_EXTRA[] = {
+    "\\Hyper-V Hypervisor Root Virtual Processor(_Total)\\% Total Run Time",
+    NULL
+};
+
+/* Counters recorded by the sampler */
+static const char* PERF_SAMPLER_COUNTERS[] = {
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Total Run Time",
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Hypervisor Run Time",
+    "\\Hyper-V Hypervisor Logical Processor(*)\\% Guest Run Time",
+    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Total Run Time",
+    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Hypervisor Run Time",
+    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Guest Run Time",
+    NULL
+};
+
+typedef struct _PERF_SESSION_COUNTER {
+    char path[256];
+    PDH_HCOUNTER counter;
+    BOOL present;
+} PERF_SESSION_COUNTER;
+
+static struct {
+    BOOL opened;
+    BOOL stale;              /* Counters added since the last collection */
+    PDH_HQUERY query;
+    PERF_SESSION_COUNTER counters[PERF_SESSION_MAX_COUNTERS];
+    DWORD count;
+    PDH_FMT_COUNTERVALUE_ITEM_A* items;
+    DWORD itemsSize;
+} g_perfSession;
+
+/*
+ * Fetch all instances of a counter into an items buffer, growing it as needed
+ */
+static BOOL GetCounterArray(PDH_HCOUNTER counter, PDH_FMT_COUNTERVALUE_ITEM_A** items,
+                            DWORD* itemsSize, DWORD* itemCount) {
+    PDH_STATUS status;
+    DWORD size = *itemsSize;
+
+    status = PdhGetFormattedCounterArrayA(counter, PDH_FMT_DOUBLE | PDH_FMT_NOCAP100,
+                                          &size, itemCount, *items);
+    if (status == PDH_MORE_DATA) {
+        PDH_FMT_COUNTERVALUE_ITEM_A* grown = (PDH_FMT_COUNTERVALUE_ITEM_A*)realloc(*items, size);
+        if (grown == NULL) {
+            return FALSE;
+        }
+        *items = grown;
+        *itemsSize = size;
+        status = PdhGetFormattedCounterArrayA(counter, PDH_FMT_DOUBLE | PDH_FMT_NOCAP100,
+                                              &size, itemCount, *items);
+    }
+
+    return status == ERROR_SUCCESS;
+}
+
+static PERF_SESSION_COUNTER* AddSessionCounter(const char* counterPath) {
+    PERF_SESSION_COUNTER* entry = NULL;
+
+    if (g_perfSession.count >= PERF_SESSION_MAX_COUNTERS) {
+        return NULL;
+    }
+
+    // Missing counters are remembered too so they are not probed again
+    entry = &g_perfSession.counters[g_perfSession.count++];
+    strncpy(entry->path, counterPath, sizeof(entry->path) - 1);
+    entry->path[sizeof(entry->path) - 1] = '\0';
+    entry->present = PdhAddEnglishCounterA(g_perfSession.query, counterPath, 0,
+                                           &entry->counter) == ERROR_SUCCESS;
+    if (entry->present) {
+        g_perfSession.stale = TRUE;
+    }
+    return entry;
+}
+
+static BOOL OpenSession(void) {
+    if (g_perfSession.opened) {
+        return g_perfSession.query != NULL;
+    }
+
+    g_perfSession.opened = TRUE;
+    if (PdhOpenQueryA(NULL, 0, &g_perfSession.query) != ERROR_SUCCESS) {
+        g_perfSession.query = NULL;
+        return FALSE;
+    }
+
+    for (int i = 0; HYPERV_PERF_COUNTERS[i] != NULL; i++) {
+        AddSessionCounter(HYPERV_PERF_COUNTERS[i]);
+    }
+    for (int i = 0; PERF_SESSION_EXTRA[i] != NULL; i++) {
+        AddSessionCounter(PERF_SESSION_EXTRA[i]);
+    }
+    return TRUE;
+}
+
+const char* const* PerfSessionHyperVCounters(void) {
+    return HYPERV_PERF_COUNTERS;
+}
+
+static PERF_SESSION_COUNTER* FindSessionCounter(const char* counterPath) {
+    for (DWORD i = 0; i < g_perfSession.count; i++) {
+        if (_stricmp(g_perfSession.counters[i].path, counterPath) == 0) {
+            return &g_perfSession.counters[i];
+        }
+    }
+    return AddSessionCounter(counterPath);
+}
+
+BOOL PerfSessionGet(const char* counterPath, PPERF_COUNTER_SAMPLE sample) {
+    PERF_SESSION_COUNTER* entry = NULL;
+    DWORD itemCount = 0;
+
+    ZeroMemory(sample, sizeof(*sample));
+
+    if (!OpenSession()) {
+        return FALSE;
+    }
+
+    entry = FindSessionCounter(counterPath);
+    if (entry == NULL || !entry->present) {
+        return FALSE;
+    }
+
+    // One collection pair covers every counter added so far
+    if (g_perfSession.stale) {
+        PdhCollectQueryData(g_perfSession.query);
+        Sleep(PERF_SESSION_SAMPLE_GAP_MS);
+        PdhCollectQueryData(g_perfSession.query);
+        g_perfSession.stale = FALSE;
+    }
+
+    if (!GetCounterArray(entry->counter, &g_perfSession.items, &g_perfSession.itemsSize, &itemCount)) {
+        return TRUE;
+    }
+
+    sample->instanceCount = itemCount;
+    for (DWORD i = 0; i < itemCount; i++) {
+        PDH_FMT_COUNTERVALUE_ITEM_A* item = &g_perfSession.items[i];
+
+        if (item->FmtValue.CStatus != PDH_CSTATUS_VALID_DATA &&
+            item->FmtValue.CStatus != PDH_CSTATUS_NEW_DATA) {
+            continue;
+        }
+        if (!sample->hasValue || (item->szName && _stricmp(item->szName, "_Total") == 0)) {
+            sample->value = item->FmtValue.doubleValue;
+            sample->hasValue = TRUE;
+        }
+    }
+    return TRUE;
+}
+
+BOOL PerfSessionHasCounter(const char* counterPath) {
+    PERF_SESSION_COUNTER* entry = NULL;
+
+    if (!OpenSession()) {
+        return FALSE;
+    }
+    entry = FindSessionCounter(counterPath);
+    return entry != NULL && entry->present;
+}
+
+void PerfSessionClose(void) {
+    if (g_perfSession.query != NULL) {
+        PdhCloseQuery(g_perfSession.query);
+    }
+    free(g_perfSession.items);
+    ZeroMemory(&g_perfSession, sizeof(g_perfSession));
+}
+
+/*
+ * Sampler
+ */
+
+typedef struct _SAMPLER_SERIES {
+    char instance[128];
+    uint32_t id;
+} SAMPLER_SERIES;
+
+typedef struct _SAMPLER_COUNTER {
+    const char* path;
+    PDH_HCOUNTER counter;
+    SAMPLER_SERIES* series;
+    DWORD seriesCount;
+    DWORD seriesCapacity;
+} SAMPLER_COUNTER;
+
+typedef struct _SAMPLER_POINT {
+    uint32_t id;
+    float value;
+} SAMPLER_POINT;
+
+static volatile LONG g_stopSampling = 0;
+
+static BOOL WINAPI SamplerCtrlHandler(DWORD ctrlType) {
+    UNREFERENCED_PARAMETER(ctrlType);
+    InterlockedExchange(&g_stopSampling, 1);
+    return TRUE;
+}
+
+static int CompareSamplerPoints(const void* a, const void* b) {
+    uint32_t left = ((const SAMPLER_POINT*)a)->id;
+    uint32_t right = ((const SAMPLER_POINT*)b)->id;
+    return (left > right) - (left < right);
+}
+
+static uint64_t CurrentUnixMs(void) {
+    FILETIME ft;
+    ULARGE_INTEGER ticks;
+
+    GetSystemTimeAsFileTime(&ft);
+    ticks.LowPart = ft.dwLowDateTime;
+    ticks.HighPart = ft.dwHighDateTime;
+    return (ticks.QuadPart - FILETIME_UNIX_EPOCH) / 10000ULL;
+}
+
+/*
+ * Series id for an instance of a counter; defines a new series on first sight.
+ * Instance order is usually stable between samples, so try the hinted slot first.
+ */
+static int GetSeriesId(PPERF_SERIES_WRITER writer, SAMPLER_COUNTER* sc, const char* instance, DWORD hint) {
+    char name[PERF_SERIES_MAX_NAME];
+    const char* wildcard = NULL;
+    SAMPLER_SERIES* entry = NULL;
+    int id = 0;
+
+    if (hint < sc->seriesCount && strcmp(sc->series[hint].instance, instance) == 0) {
+        return (int)sc->series[hint].id;
+    }
+    for (DWORD i = 0; i < sc->seriesCount; i++) {
+        if (strcmp(sc->series[i].instance, instance) == 0) {
+            return (int)sc->series[i].id;
+        }
+    }
+
+    if (sc->seriesCount == sc->seriesCapacity) {
+        DWORD capacity = sc->seriesCapacity ? sc->seriesCapacity * 2 : 64;
+        SAMPLER_SERIES* grown = (SAMPLER_SERIES*)realloc(sc->series, capacity * sizeof(SAMPLER_SERIES));
+        if (grown == NULL) {
+            return -1;
+        }
+        sc->series = grown;
+        sc->seriesCapacity = capacity;
+    }
+
+    // Series name is the counter path with "(*)" replaced by the instance
+    wildcard = strstr(sc->path, "(*)");
+    if (wildcard != NULL) {
+        snprintf(name, sizeof(name), "%.*s(%s)%s", (int)(wildcard - sc->path), sc->path,
+                 instance, wildcard + 3);
+    } else {
+        snprintf(name, sizeof(name), "%s", sc->path);
+    }
+
+    id = PerfSeriesDefine(writer, name);
+    if (id < 0) {
+        return -1;
+    }
+
+    entry = &sc->series[sc->seriesCount++];
+    strncpy(entry->instance, instance, sizeof(entry->instance) - 1);
+    entry->instance[sizeof(entry->instance) - 1] = '\0';
+    entry->id = (uint32_t)id;
+    return id;
+}
+
+int PerfSampleHypervisorCounters(const char* path, DWORD intervalMs, DWORD durationSeconds) {
+    SAMPLER_COUNTER counters[sizeof(PERF_SAMPLER_COUNTERS) / sizeof(PERF_SAMPLER_COUNTERS[0])];
+    PERF_SERIES_WRITER writer;
+    PDH_HQUERY query = NULL;
+    PDH_FMT_COUNTERVALUE_ITEM_A* items = NULL;
+    DWORD itemsSize = 0;
+    SAMPLER_POINT* points = NULL;
+    uint32_t* ids = NULL;
+    float* values = NULL;
+    DWORD pointCapacity = 0;
+    DWORD counterCount = 0;
+    ULONGLONG startTick = 0;
+    ULONGLONG nextTick = 0;
+    ULONGLONG lastFlush = 0;
+    uint64_t startMs = 0;
+    int frames = 0;
+    BOOL primed = FALSE;
+
+    if (intervalMs < PERF_SAMPLER_MIN_INTERVAL_MS) {
+        intervalMs = PERF_SAMPLER_MIN_INTERVAL_MS;
+    }
+
+    ZeroMemory(counters, sizeof(counters));
+    if (PdhOpenQueryA(NULL, 0, &query) != ERROR_SUCCESS) {
+        return -1;
+    }
+
+    for (int i = 0; PERF_SAMPLER_COUNTERS[i] != NULL; i++) {
+        PDH_HCOUNTER counter = NULL;
+        if (PdhAddEnglishCounterA(query, PERF_SAMPLER_COUNTERS[i], 0, &counter) == ERROR_SUCCESS) {
+            counters[counterCount].path = PERF_SAMPLER_COUNTERS[i];
+            counters[counterCount].counter = counter;
+            counterCount++;
+        }
+    }
+
+    startMs = CurrentUnixMs();
+    if (counterCount == 0 || PerfSeriesCreate(&writer, path, intervalMs, startMs) != 0) {
+        PdhCloseQuery(query);
+        return -1;
+    }
+
+    InterlockedExchange(&g_stopSampling, 0);
+    SetConsoleCtrlHandler(SamplerCtrlHandler, TRUE);
+
+    startTick = GetTickCount64();
+    nextTick = startTick;
+    lastFlush = startTick;
+
+    while (!g_stopSampling) {
+        ULONGLONG now = GetTickCount64();
+        DWORD pointCount = 0;
+
+        if (durationSeconds > 0 && now - startTick >= (ULONGLONG)durationSeconds * 1000) {
+            break;
+        }
+
+        if (PdhCollectQueryData(query) == ERROR_SUCCESS) {
+            // The first collection only primes the rate counters
+            if (primed) {
+                for (DWORD c = 0; c < counterCount; c++) {
+                    DWORD itemCount = 0;
+
+                    if (!GetCounterArray(counters[c].counter, &items, &itemsSize, &itemCount)) {
+                        continue;
+                    }
+
+                    for (DWORD i = 0; i < itemCount; i++) {
+                        int id = 0;
+
+                        if (items[i].FmtValue.CStatus != PDH_CSTATUS_VALID_DATA &&
+                            items[i].FmtValue.CStatus != PDH_CSTATUS_NEW_DATA) {
+                            continue;
+                        }
+                        id = GetSeriesId(&writer, &counters[c], items[i].szName ? items[i].szName : "", i);
+                        if (id < 0) {
+                            continue;
+                        }
+
+                        if (pointCount == pointCapacity) {
+                            DWORD capacity = pointCapacity ? pointCapacity * 2 : 256;
+                            SAMPLER_POINT* grownPoints = (SAMPLER_POINT*)realloc(points, capacity * sizeof(SAMPLER_POINT));
+                            uint32_t* grownIds = NULL;
+                            float* grownValues = NULL;
+
+                            if (grownPoints == NULL) {
+                                break;
+                            }
+                            points = grownPoints;
+                            grownIds = (uint32_t*)realloc(ids, capacity * sizeof(uint32_t));
+                            if (grownIds == NULL) {
+                                break;
+                            }
+                            ids = grownIds;
+                            grownValues = (float*)realloc(values, capacity * sizeof(float));
+                            if (grownValues == NULL) {
+                                break;
+                            }
+                            values = grownValues;
+                            pointCapacity = capacity;
+                        }
+
+                        points[pointCount].id = (uint32_t)id;
+                        points[pointCount].value = (float)items[i].FmtValue.doubleValue;
+                        pointCount++;
+                    }
+                }
+
+                // Frames need strictly ascending ids; duplicate instance names collapse
+                qsort(points, pointCount, sizeof(SAMPLER_POINT), CompareSamplerPoints);
+                DWORD frameCount = 0;
+                for (DWORD i = 0; i < pointCount; i++) {
+                    if (frameCount > 0 && ids[frameCount - 1] == points[i].id) {
+                        continue;
+                    }
+                    ids[frameCount] = points[i].id;
+                    values[frameCount] = points[i].value;
+                    frameCount++;
+                }
+
+                if (PerfSeriesWriteFrame(&writer, startMs + (GetTickCount64() - startTick),
+                                         ids, values, frameCount) == 0) {
+                    frames++;
+                }
+            }
+            primed = TRUE;
+        }
+
+        if (now - lastFlush >= PERF_SAMPLER_FLUSH_MS) {
+            fflush(writer.file);
+            lastFlush = now;
+        }
+
+        // Fixed-rate schedule; skip missed ticks instead of bursting
+        nextTick += intervalMs;
+        now = GetTickCount64();
+        if (nextTick <= now) {
+            nextTick = now + intervalMs;
+        }
+        Sleep((DWORD)(nextTick - now));
+    }
+
+    SetConsoleCtrlHandler(SamplerCtrlHandler, FALSE);
+    PerfSeriesFinish(&writer);
+    PdhCloseQuery(query);
+
+    for (DWORD c = 0; c < counterCount; c++) {
+        free(counters[c].series);
+    }
+    free(items);
+    free(points);
+    free(ids);
+    free(values);
+    return frames;
+}
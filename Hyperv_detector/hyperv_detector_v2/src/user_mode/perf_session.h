@@ -0,0 +1,53 @@
+/**
+ * perf_session.h - Shared PDH session and Hyper-V counter sampler
+ *
+ * All Hyper-V performance counters used by the checks are added to a single
+ * PDH query the first time any of them is requested, and the query is
+ * collected once (two samples, so rate counters are valid) for the whole run.
+ * Wildcard instances ("(*)") are kept as one PDH counter and expanded with
+ * PdhGetFormattedCounterArray.
+ *
+ * The sampler records the Hyper-V Hypervisor Logical/Virtual Processor
+ * counters at a fixed rate into a perf_series.h time-series file.
+ */
+
+#pragma once
+#ifndef PERF_SESSION_H
+#define PERF_SESSION_H
+
+#include <windows.h>
+
+typedef struct _PERF_COUNTER_SAMPLE {
+    double value;           /* _Total instance if present, otherwise the first instance */
+    DWORD instanceCount;    /* Instances a wildcard expanded to (1 for plain counters) */
+    BOOL hasValue;          /* FALSE if the counter exists but produced no valid data */
+} PERF_COUNTER_SAMPLE, *PPERF_COUNTER_SAMPLE;
+
+/*
+ * Look up a counter in the shared session (English counter path). Counters
+ * not in the built-in list are added on demand. Returns FALSE if the counter
+ * does not exist on this system.
+ */
+BOOL PerfSessionGet(const char* counterPath, PPERF_COUNTER_SAMPLE sample);
+BOOL PerfSessionHasCounter(const char* counterPath);
+
+/*
+ * Hyper-V counters the performance counter check reports (NULL-terminated).
+ * The session adds all of them when it opens.
+ */
+const char* const* PerfSessionHyperVCounters(void);
+
+/*
+ * Release the shared query; the next lookup opens a new one. Not thread-safe,
+ * like the session itself.
+ */
+void PerfSessionClose(void);
+
+/*
+ * Sampling mode: write LP/VP run-time counters every intervalMs to path for
+ * durationSeconds (0 = until Ctrl+C). Returns the number of frames written,
+ * or -1 if the file or the PDH query could not be created.
+ */
+int PerfSampleHypervisorCounters(const char* path, DWORD intervalMs, DWORD durationSeconds);
+
+#endif /* PERF_SESSION_H */
@@ -2,10 +2,12 @@
  * perfcounter_checks.c - Performance Counter based Hyper-V detection
  * 
  * Detects Hyper-V through Windows Performance Counters that are
- * specific to Hyper-V virtualization.
+ * specific to Hyper-V virtualization. Counter values come from the shared
+ * PDH session in perf_session.c (one query, collected once per run).
  */
 
 #include "hyperv_detector.h"
+#include "perf_session.h"
 #include <pdh.h>
 #include <pdhmsg.h>
 
@@ -14,28 +16,6 @@
 // Detection flag for performance counters
 #define HYPERV_DETECTED_PERFCOUNTER 0x00020000
 
-// Hyper-V specific performance counter paths
-static const char* HYPERV_PERF_COUNTERS[] = {
-    "\\Hyper-V Hypervisor\\Logical Processors",
-    "\\Hyper-V Hypervisor\\Virtual Processors",
-    "\\Hyper-V Hypervisor\\Partitions",
-    "\\Hyper-V Hypervisor Logical Processor(*)\\% Guest Run Time",
-    "\\Hyper-V Hypervisor Logical Processor(*)\\% Hypervisor Run Time",
-    "\\Hyper-V Hypervisor Logical Processor(*)\\% Total Run Time",
-    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Guest Run Time",
-    "\\Hyper-V Hypervisor Virtual Processor(*)\\% Hypervisor Run Time",
-    "\\Hyper-V Hypervisor Root Virtual Processor(*)\\% Guest Run Time",
-    "\\Hyper-V Virtual Machine Health Summary\\Health Ok",
-    "\\Hyper-V Virtual Machine Bus Provider Pipes(*)\\Bytes Read/sec",
-    "\\Hyper-V Virtual Storage Device(*)\\Read Bytes/sec",
-    "\\Hyper-V Virtual Network Adapter(*)\\Bytes Received/sec",
-    "\\Hyper-V Virtual IDE Controller (Emulated)(*)\\Read Bytes/sec",
-    "\\Hyper-V Virtual Switch(*)\\Bytes/sec",
-    "\\Hyper-V VM Vid Driver(*)\\Remote Physical Pages",
-    "\\Hyper-V VM Vid Partition(*)\\Physical Pages Allocated",
-    NULL
-};
-
 // Counter object names to enumerate
 static const char* HYPERV_COUNTER_OBJECTS[] = {
     "Hyper-V Hypervisor",
@@ -56,64 +36,6 @@ static const char* HYPERV_COUNTER_OBJECTS[] = {
     NULL
 };
 
-static BOOL CheckPerfCounterExists(const char* counterPath) {
-    PDH_HQUERY hQuery;
-    PDH_HCOUNTER hCounter;
-    PDH_STATUS status;
-    
-    status = PdhOpenQuery(NULL, 0, &hQuery);
-    if (status != ERROR_SUCCESS) {
-        return FALSE;
-    }
-    
-    status = PdhAddCounterA(hQuery, counterPath, 0, &hCounter);
-    PdhCloseQuery(hQuery);
-    
-    return (status == ERROR_SUCCESS);
-}
-
-static BOOL GetPerfCounterValue(const char* counterPath, double* value) {
-    PDH_HQUERY hQuery;
-    PDH_HCOUNTER hCounter;
-    PDH_STATUS status;
-    PDH_FMT_COUNTERVALUE counterValue;
-    
-    *value = 0.0;
-    
-    status = PdhOpenQuery(NULL, 0, &hQuery);
-    if (status != ERROR_SUCCESS) {
-        return FALSE;
-    }
-    
-    status = PdhAddCounterA(hQuery, counterPath, 0, &hCounter);
-    if (status != ERROR_SUCCESS) {
-        PdhCloseQuery(hQuery);
-        return FALSE;
-    }
-    
-    status = PdhCollectQueryData(hQuery);
-    if (status != ERROR_SUCCESS) {
-        PdhCloseQuery(hQuery);
-        return FALSE;
-    }
-    
-    Sleep(100);  // Wait for second sample
-    
-    status = PdhCollectQueryData(hQuery);
-    if (status != ERROR_SUCCESS) {
-        PdhCloseQuery(hQuery);
-        return FALSE;
-    }
-    
-    status = PdhGetFormattedCounterValue(hCounter, PDH_FMT_DOUBLE, NULL, &counterValue);
-    if (status == ERROR_SUCCESS) {
-        *value = counterValue.doubleValue;
-    }
-    
-    PdhCloseQuery(hQuery);
-    return (status == ERROR_SUCCESS);
-}
-
 static BOOL EnumeratePerfCounterObject(const char* objectName, PDETECTION_RESULT result) {
     DWORD counterListSize = 0;
     DWORD instanceListSize = 0;
@@ -175,7 +97,8 @@ static BOOL EnumeratePerfCounterObject(const char* objectName, PDETECTION_RESULT
 
 DWORD CheckPerfCountersHyperV(PDETECTION_RESULT result) {
     DWORD detected = 0;
-    double value;
+    PERF_COUNTER_SAMPLE sample;
+    const char* const* counters = PerfSessionHyperVCounters();
     
     AppendToDetails(result, "PerfCounter: Checking Hyper-V performance counters...\n");
     
@@ -187,29 +110,32 @@ DWORD CheckPerfCountersHyperV(PDETECTION_RESULT result) {
         }
     }
     
-    // Check specific counters and get values
-    for (int i = 0; HYPERV_PERF_COUNTERS[i] != NULL; i++) {
-        if (CheckPerfCounterExists(HYPERV_PERF_COUNTERS[i])) {
+    // Check specific counters and get values (wildcards expand to all instances)
+    for (int i = 0; counters[i] != NULL; i++) {
+        if (PerfSessionGet(counters[i], &sample)) {
             detected |= HYPERV_DETECTED_PERFCOUNTER;
             
-            if (GetPerfCounterValue(HYPERV_PERF_COUNTERS[i], &value)) {
+            if (sample.hasValue && sample.instanceCount > 1) {
+                AppendToDetails(result, "PerfCounter: %s = %.2f (%lu instances)\n", 
+                               counters[i], sample.value, sample.instanceCount);
+            } else if (sample.hasValue) {
                 AppendToDetails(result, "PerfCounter: %s = %.2f\n", 
-                               HYPERV_PERF_COUNTERS[i], value);
+                               counters[i], sample.value);
             } else {
-                AppendToDetails(result, "PerfCounter: Found: %s\n", HYPERV_PERF_COUNTERS[i]);
+                AppendToDetails(result, "PerfCounter: Found: %s\n", counters[i]);
             }
         }
     }
     
     // Check for VM-specific counters
-    if (CheckPerfCounterExists("\\Hyper-V VM Vid Partition(*)\\Physical Pages Allocated")) {
+    if (PerfSessionHasCounter("\\Hyper-V VM Vid Partition(*)\\Physical Pages Allocated")) {
         detected |= HYPERV_DETECTED_PERFCOUNTER;
         AppendToDetails(result, "PerfCounter: Running as Hyper-V guest (VID partition detected)\n");
     }
     
     // Check hypervisor partition counter
-    if (GetPerfCounterValue("\\Hyper-V Hypervisor\\Partitions", &value) && value > 0) {
-        AppendToDetails(result, "PerfCounter: Hypervisor managing %.0f partition(s)\n", value);
+    if (PerfSessionGet("\\Hyper-V Hypervisor\\Partitions", &sample) && sample.hasValue && sample.value > 0) {
+        AppendToDetails(result, "PerfCounter: Hypervisor managing %.0f partition(s)\n", sample.value);
         detected |= HYPERV_DETECTED_PERFCOUNTER;
     }
     
@@ -14,13 +14,8 @@
  */
 
 #include "../common/common.h"
-#include <pdh.h>
-#include <wbemidl.h>
-
-#pragma comment(lib, "pdh.lib")
-#pragma comment(lib, "ole32.lib")
-#pragma comment(lib, "oleaut32.lib")
-#pragma comment(lib, "wbemuuid.lib")
+#include "perf_session.h"
+#include "wmi_pool.h"
 
 /* Detection flag for root partition */
 #define HYPERV_DETECTED_ROOT_PARTITION  0x04000000
@@ -264,27 +259,9 @@ static BOOL CheckCpuManagementFeatures(PROOT_PARTITION_INFO info, UINT32 maxLeaf
  */
 static BOOL CheckRootVpPerformanceCounters(PROOT_PARTITION_INFO info)
 {
-    PDH_STATUS status;
-    PDH_HQUERY query = NULL;
-    PDH_HCOUNTER counter = NULL;
-    BOOL hasRootVpCounters = FALSE;
-    
-    status = PdhOpenQuery(NULL, 0, &query);
-    if (status != ERROR_SUCCESS) {
-        return FALSE;
-    }
-    
-    /* Try to add Root Virtual Processor counter - only exists on root partition */
-    status = PdhAddEnglishCounterA(query, 
-        "\\Hyper-V Hypervisor Root Virtual Processor(_Total)\\% Total Run Time",
-        0, &counter);
-    
-    if (status == ERROR_SUCCESS) {
-        hasRootVpCounters = TRUE;
-        PdhRemoveCounter(counter);
-    }
-    
-    PdhCloseQuery(query);
+    /* Root Virtual Processor counter - only exists on root partition */
+    BOOL hasRootVpCounters = PerfSessionHasCounter(
+        "\\Hyper-V Hypervisor Root Virtual Processor(_Total)\\% Total Run Time");
     
     if (info) {
         info->hasRootVpCounters = hasRootVpCounters;
@@ -300,35 +277,13 @@ static BOOL CheckRootVpPerformanceCounters(PROOT_PARTITION_INFO info)
  */
 static DWORD GetHypervisorPartitionCount(void)
 {
-    PDH_STATUS status;
-    PDH_HQUERY query = NULL;
-    PDH_HCOUNTER counter = NULL;
-    PDH_FMT_COUNTERVALUE value;
-    DWORD partitionCount = 0;
-    
-    status = PdhOpenQuery(NULL, 0, &query);
-    if (status != ERROR_SUCCESS) {
-        return 0;
-    }
-    
-    status = PdhAddEnglishCounterA(query, 
-        "\\Hyper-V Hypervisor\\Partitions",
-        0, &counter);
+    PERF_COUNTER_SAMPLE sample;
     
-    if (status == ERROR_SUCCESS) {
-        status = PdhCollectQueryData(query);
-        if (status == ERROR_SUCCESS) {
-            status = PdhGetFormattedCounterValue(counter, PDH_FMT_LONG, NULL, &value);
-            if (status == ERROR_SUCCESS) {
-                partitionCount = value.longValue;
-            }
-        }
-        PdhRemoveCounter(counter);
+    if (!PerfSessionGet("\\Hyper-V Hypervisor\\Partitions", &sample) || !sample.hasValue) {
+        return 0;
     }
     
-    PdhCloseQuery(query);
-    
-    return partitionCount;
+    return (DWORD)sample.value;
 }
 
 /*
@@ -338,76 +293,22 @@ static DWORD GetHypervisorPartitionCount(void)
  */
 static BOOL CheckSystemModelWMI(PROOT_PARTITION_INFO info)
 {
-    HRESULT hr;
-    IWbemLocator *pLoc = NULL;
-    IWbemServices *pSvc = NULL;
-    IEnumWbemClassObject *pEnumerator = NULL;
-    IWbemClassObject *pObj = NULL;
-    ULONG returned = 0;
+    static const wchar_t* MODEL_PROPS[] = { L"Model" };
+    WMI_VALUE model;
     BOOL isVirtualMachine = FALSE;
     
-    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-        return FALSE;
-    }
-    
-    hr = CoInitializeSecurity(NULL, -1, NULL, NULL,
-        RPC_C_AUTHN_LEVEL_DEFAULT, RPC_C_IMP_LEVEL_IMPERSONATE,
-        NULL, EOAC_NONE, NULL);
-    
-    hr = CoCreateInstance(&CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
-        &IID_IWbemLocator, (void**)&pLoc);
-    if (FAILED(hr)) {
-        goto cleanup;
-    }
-    
-    hr = pLoc->lpVtbl->ConnectServer(pLoc, L"ROOT\\CIMV2", NULL, NULL,
-        NULL, 0, NULL, NULL, &pSvc);
-    if (FAILED(hr)) {
-        goto cleanup;
-    }
-    
-    hr = CoSetProxyBlanket((IUnknown*)pSvc, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE,
-        NULL, RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
-    
-    hr = pSvc->lpVtbl->ExecQuery(pSvc, L"WQL",
-        L"SELECT Model FROM Win32_ComputerSystem",
-        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-        NULL, &pEnumerator);
-    if (FAILED(hr)) {
-        goto cleanup;
-    }
-    
-    hr = pEnumerator->lpVtbl->Next(pEnumerator, WBEM_INFINITE, 1, &pObj, &returned);
-    if (SUCCEEDED(hr) && returned > 0) {
-        VARIANT vtModel;
-        VariantInit(&vtModel);
+    if (WmiPoolSelectFirst(WMI_NS_CIMV2, L"Win32_ComputerSystem", NULL, MODEL_PROPS, 1, &model) &&
+        model.present) {
+        if (info) {
+            strncpy_s(info->systemModel, sizeof(info->systemModel), model.text, _TRUNCATE);
+        }
         
-        hr = pObj->lpVtbl->Get(pObj, L"Model", 0, &vtModel, NULL, NULL);
-        if (SUCCEEDED(hr) && vtModel.vt == VT_BSTR) {
-            char modelStr[256] = {0};
-            WideCharToMultiByte(CP_ACP, 0, vtModel.bstrVal, -1,
-                modelStr, sizeof(modelStr) - 1, NULL, NULL);
-            
-            if (info) {
-                strncpy_s(info->systemModel, sizeof(info->systemModel), modelStr, _TRUNCATE);
-            }
-            
-            /* Check if it's "Virtual Machine" */
-            if (strstr(modelStr, "Virtual Machine") != NULL) {
-                isVirtualMachine = TRUE;
-            }
+        /* Check if it's "Virtual Machine" */
+        if (strstr(model.text, "Virtual Machine") != NULL) {
+            isVirtualMachine = TRUE;
         }
-        VariantClear(&vtModel);
-        pObj->lpVtbl->Release(pObj);
     }
     
-cleanup:
-    if (pEnumerator) pEnumerator->lpVtbl->Release(pEnumerator);
-    if (pSvc) pSvc->lpVtbl->Release(pSvc);
-    if (pLoc) pLoc->lpVtbl->Release(pLoc);
-    CoUninitialize();
-    
     if (info) {
         info->systemModelIsVirtualMachine = isVirtualMachine;
     }
@@ -1,37 +1,12 @@
 #include "hyperv_detector.h"
 
-static const char* HYPERV_SERVICES[] = {
-    "vmms",           // Hyper-V Virtual Machine Management Service
-    "vmcompute",      // Hyper-V Host Compute Service
-    "vmickvpexchange", // Hyper-V Data Exchange Service
-    "vmicheartbeat",  // Hyper-V Heartbeat Service
-    "vmicshutdown",   // Hyper-V Guest Shutdown Service
-    "vmictimesync",   // Hyper-V Time Synchronization Service
-    "vmicvss",        // Hyper-V Volume Shadow Copy Requestor
-    "vmicrdv",        // Hyper-V Remote Desktop Virtualization Service
-    "vmicguestinterface", // Hyper-V Guest Service Interface
-    "vmicvmsession",  // Hyper-V PowerShell Direct Service
-    "HvHost",         // HvHost Service
-    "vmbus",          // Hyper-V Virtual Machine Bus Provider
-    "hyperkbd",       // Hyper-V Keyboard Filter Driver
-    "hypermouse",     // Hyper-V Mouse Filter Driver
-    "hvsocket",       // Hyper-V Socket
-    "storvsc",        // Hyper-V Virtual Storage
-    "netvsc",         // Hyper-V Virtual Network
-    "Vmmem",          // Virtual Machine Memory
-    "WslService",     // Windows Subsystem for Linux Service
-    "LxssManager",    // LxssManager
-    "docker",         // Docker Engine
-    "com.docker.service", // Docker Desktop Service
-    NULL
-};
-
 DWORD CheckServicesHyperV(PDETECTION_RESULT result) {
     SC_HANDLE scManager;
     SC_HANDLE scService;
     DWORD detected = 0;
     SERVICE_STATUS_PROCESS serviceStatus;
     DWORD bytesNeeded;
+    const char* const* services = HvServiceNames();
     
     scManager = OpenSCManagerA(NULL, NULL, SC_MANAGER_ENUMERATE_SERVICE);
     if (scManager == NULL) {
@@ -39,8 +14,8 @@ DWORD CheckServicesHyperV(PDETECTION_RESULT result) {
         return 0;
     }
     
-    for (int i = 0; HYPERV_SERVICES[i] != NULL; i++) {
-        scService = OpenServiceA(scManager, HYPERV_SERVICES[i], SERVICE_QUERY_STATUS | SERVICE_QUERY_CONFIG);
+    for (int i = 0; services[i] != NULL; i++) {
+        scService = OpenServiceA(scManager, services[i], SERVICE_QUERY_STATUS | SERVICE_QUERY_CONFIG);
         if (scService != NULL) {
             detected |= HYPERV_DETECTED_SERVICES;
             
@@ -59,17 +34,17 @@ DWORD CheckServicesHyperV(PDETECTION_RESULT result) {
                 }
                 
                 AppendToDetails(result, "Service: %s - %s (PID: %d)\n", 
-                               HYPERV_SERVICES[i], stateStr, serviceStatus.dwProcessId);
+                               services[i], stateStr, serviceStatus.dwProcessId);
                 
                 if (serviceStatus.dwCurrentState == SERVICE_RUNNING) {
-                    if (strcmp(HYPERV_SERVICES[i], "vmms") == 0) {
+                    if (strcmp(services[i], "vmms") == 0) {
                         AppendToDetails(result, "Service: Hyper-V is actively running\n");
                     }
-                    if (strcmp(HYPERV_SERVICES[i], "Vmmem") == 0) {
+                    if (strcmp(services[i], "Vmmem") == 0) {
                         AppendToDetails(result, "Service: WSL2/Windows Sandbox is running\n");
                     }
-                    if (strcmp(HYPERV_SERVICES[i], "docker") == 0 || 
-                        strcmp(HYPERV_SERVICES[i], "com.docker.service") == 0) {
+                    if (strcmp(services[i], "docker") == 0 || 
+                        strcmp(services[i], "com.docker.service") == 0) {
                         AppendToDetails(result, "Service: Docker with Hyper-V backend is running\n");
                     }
                 }
@@ -8,13 +8,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "hyperv_detector.h"
-#include <setupapi.h>
-#include <devguid.h>
+#include "device_index.h"
 #include <winioctl.h>
 #include <ntddscsi.h>
 
-#pragma comment(lib, "setupapi.lib")
-
 // Detection flag for storage
 #define HYPERV_DETECTED_STORAGE 0x00400000
 
@@ -200,94 +197,71 @@ static DWORD CheckPhysicalDrives(PDETECTION_RESULT result) {
 
 static DWORD CheckSCSIControllers(PDETECTION_RESULT result) {
     DWORD detected = 0;
-    HDEVINFO hDevInfo;
-    SP_DEVINFO_DATA devInfoData;
-    char deviceId[MAX_PATH];
-    char deviceDesc[MAX_PATH];
-    DWORD requiredSize;
+    const DEVICE_INDEX* index = GetDeviceIndex();
+    const DEVICE_INDEX_ENTRY* device;
     
     // Enumerate SCSI controllers
-    hDevInfo = SetupDiGetClassDevsA(&GUID_DEVCLASS_SCSIADAPTER, NULL, NULL, DIGCF_PRESENT);
-    if (hDevInfo == INVALID_HANDLE_VALUE) {
-        return 0;
-    }
-    
-    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-    
-    for (DWORD i = 0; SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
-        // Get device instance ID
-        if (SetupDiGetDeviceInstanceIdA(hDevInfo, &devInfoData, deviceId, sizeof(deviceId), &requiredSize)) {
-            // Get device description
-            if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData, SPDRP_DEVICEDESC,
-                                                 NULL, (PBYTE)deviceDesc, sizeof(deviceDesc), &requiredSize)) {
-                
-                AppendToDetails(result, "Storage: SCSI Controller: %s\n", deviceDesc);
-                
-                // Check for Hyper-V SCSI controller
-                if (strstr(deviceId, "VMBUS") || strstr(deviceDesc, "Hyper-V") ||
-                    strstr(deviceDesc, "Virtual") || strstr(deviceDesc, "Synthetic")) {
-                    detected |= HYPERV_DETECTED_STORAGE;
-                    AppendToDetails(result, "Storage: Hyper-V SCSI controller detected: %s\n", deviceDesc);
-                }
-            }
+    for (device = DeviceIndexFirstByClass(index, DEVICE_CLASS_SCSIADAPTER); device != NULL;
+         device = DeviceIndexNextByClass(index, DEVICE_CLASS_SCSIADAPTER, device)) {
+        if (device->description[0] == '\0') {
+            continue;
+        }
+        
+        AppendToDetails(result, "Storage: SCSI Controller: %s\n", device->description);
+        
+        // Check for Hyper-V SCSI controller
+        if (strstr(device->instanceId, "VMBUS") || strstr(device->description, "Hyper-V") ||
+            strstr(device->description, "Virtual") || strstr(device->description, "Synthetic")) {
+            detected |= HYPERV_DETECTED_STORAGE;
+            AppendToDetails(result, "Storage: Hyper-V SCSI controller detected: %s\n", device->description);
         }
     }
     
-    SetupDiDestroyDeviceInfoList(hDevInfo);
     return detected;
 }
 
 static DWORD CheckStorageControllers(PDETECTION_RESULT result) {
     DWORD detected = 0;
-    HDEVINFO hDevInfo;
-    SP_DEVINFO_DATA devInfoData;
-    char deviceId[MAX_PATH];
-    char deviceDesc[MAX_PATH];
-    char hardwareIds[1024];
-    DWORD requiredSize;
-    
-    // Enumerate all storage controllers
-    static const GUID GUID_DEVCLASS_HIDSTORAGE = 
-        {0x6bdd1fc5, 0x810f, 0x11d0, {0xbe, 0xc7, 0x08, 0x00, 0x2b, 0xe2, 0x09, 0x2f}};
-    
-    hDevInfo = SetupDiGetClassDevsA(NULL, NULL, NULL, DIGCF_ALLCLASSES | DIGCF_PRESENT);
-    if (hDevInfo == INVALID_HANDLE_VALUE) {
-        return 0;
-    }
+    const DEVICE_INDEX* index = GetDeviceIndex();
+    const DEVICE_INDEX_ENTRY* device;
     
-    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+    // Only check storage-related devices: the instance ID contains one of
+    // these anywhere, not only as its enumerator
+    static const char* storageIds[] = {
+        "STORAGE",
+        "DISK",
+        "SCSI",
+        "VMBUS",
+        NULL
+    };
     
-    for (DWORD i = 0; SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
-        if (SetupDiGetDeviceInstanceIdA(hDevInfo, &devInfoData, deviceId, sizeof(deviceId), &requiredSize)) {
-            // Only check storage-related devices
-            if (strstr(deviceId, "STORAGE") || strstr(deviceId, "DISK") || 
-                strstr(deviceId, "SCSI") || strstr(deviceId, "VMBUS")) {
+    for (size_t position = 0; position < DeviceIndexCount(index); position++) {
+        int storage = 0;
+        
+        device = DeviceIndexAt(index, position);
+        for (int i = 0; storageIds[i] != NULL && !storage; i++) {
+            storage = strstr(device->instanceId, storageIds[i]) != NULL;
+        }
+        if (!storage) {
+            continue;
+        }
+        
+        // Check each hardware ID in the multi-string
+        const char* hwId = device->hardwareIds;
+        while (*hwId) {
+            if (strstr(hwId, "Hyper") || strstr(hwId, "VRTUAL") ||
+                strstr(hwId, "Msft") || strstr(hwId, "Virtual")) {
+                detected |= HYPERV_DETECTED_STORAGE;
                 
-                // Get hardware IDs
-                if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData, SPDRP_HARDWAREID,
-                                                     NULL, (PBYTE)hardwareIds, sizeof(hardwareIds), &requiredSize)) {
-                    
-                    // Check each hardware ID in the multi-string
-                    char* hwId = hardwareIds;
-                    while (*hwId) {
-                        if (strstr(hwId, "Hyper") || strstr(hwId, "VRTUAL") ||
-                            strstr(hwId, "Msft") || strstr(hwId, "Virtual")) {
-                            detected |= HYPERV_DETECTED_STORAGE;
-                            
-                            if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData, SPDRP_DEVICEDESC,
-                                                                 NULL, (PBYTE)deviceDesc, sizeof(deviceDesc), &requiredSize)) {
-                                AppendToDetails(result, "Storage: Found Hyper-V storage device: %s (HwID: %s)\n",
-                                               deviceDesc, hwId);
-                            }
-                        }
-                        hwId += strlen(hwId) + 1;
-                    }
+                if (device->description[0] != '\0') {
+                    AppendToDetails(result, "Storage: Found Hyper-V storage device: %s (HwID: %s)\n",
+                                   device->description, hwId);
                 }
             }
+            hwId += strlen(hwId) + 1;
         }
     }
     
-    SetupDiDestroyDeviceInfoList(hDevInfo);
     return detected;
 }
 
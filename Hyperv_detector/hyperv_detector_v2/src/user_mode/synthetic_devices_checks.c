@@ -12,13 +12,10 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "device_index.h"
 #include <stdio.h>
-#include <setupapi.h>
-#include <devguid.h>
 #include <initguid.h>
 
-#pragma comment(lib, "setupapi.lib")
-
 #define HYPERV_DETECTED_SYNTHETIC 0x04000000
 
 /* VMBus Device GUIDs (from Linux kernel and Windows headers) */
@@ -127,12 +124,11 @@ static const char* g_SyntheticDeviceNames[] = {
     NULL
 };
 
-/* Hardware IDs for VMBus devices */
+/* Hardware ID prefixes for VMBus devices (matched case-insensitively) */
 static const char* g_VmBusHardwareIds[] = {
     "VMBUS\\",
     "ROOT\\VMBUS",
     "ACPI\\VMBUS",
-    "ACPI\\VMBus",
     NULL
 };
 
@@ -141,34 +137,7 @@ static const char* g_VmBusHardwareIds[] = {
  */
 static BOOL CheckDeviceByName(const char* deviceName)
 {
-    HDEVINFO deviceInfoSet = INVALID_HANDLE_VALUE;
-    SP_DEVINFO_DATA deviceInfoData = {0};
-    DWORD i = 0;
-    char buffer[256] = {0};
-    DWORD bufferSize = 0;
-    BOOL found = FALSE;
-    
-    deviceInfoSet = SetupDiGetClassDevsA(NULL, NULL, NULL, 
-                                         DIGCF_ALLCLASSES | DIGCF_PRESENT);
-    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
-        return FALSE;
-    }
-    
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-    
-    for (i = 0; SetupDiEnumDeviceInfo(deviceInfoSet, i, &deviceInfoData); i++) {
-        bufferSize = sizeof(buffer);
-        if (SetupDiGetDeviceRegistryPropertyA(deviceInfoSet, &deviceInfoData,
-                SPDRP_DEVICEDESC, NULL, (PBYTE)buffer, bufferSize, NULL)) {
-            if (strstr(buffer, deviceName) != NULL) {
-                found = TRUE;
-                break;
-            }
-        }
-    }
-    
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
-    return found;
+    return DeviceIndexFindDescription(GetDeviceIndex(), deviceName) != NULL;
 }
 
 /*
@@ -176,27 +145,8 @@ static BOOL CheckDeviceByName(const char* deviceName)
  */
 static int CountVmBusDevices(void)
 {
-    HDEVINFO deviceInfoSet = INVALID_HANDLE_VALUE;
-    SP_DEVINFO_DATA deviceInfoData = {0};
-    DWORD i = 0;
-    char buffer[512] = {0};
-    int count = 0;
-    
-    /* Get devices on VMBus */
-    deviceInfoSet = SetupDiGetClassDevsA(NULL, "VMBUS", NULL, 
-                                         DIGCF_ALLCLASSES | DIGCF_PRESENT);
-    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
-        return 0;
-    }
-    
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-    
-    for (i = 0; SetupDiEnumDeviceInfo(deviceInfoSet, i, &deviceInfoData); i++) {
-        count++;
-    }
-    
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
-    return count;
+    /* Devices enumerated by VMBus */
+    return (int)DeviceIndexCountById(GetDeviceIndex(), "VMBUS\\");
 }
 
 /*
@@ -204,38 +154,16 @@ static int CountVmBusDevices(void)
  */
 static BOOL CheckVmBusRoot(void)
 {
-    HDEVINFO deviceInfoSet = INVALID_HANDLE_VALUE;
-    SP_DEVINFO_DATA deviceInfoData = {0};
-    DWORD i = 0;
-    char hardwareId[512] = {0};
-    BOOL found = FALSE;
+    const DEVICE_INDEX* index = GetDeviceIndex();
     int j = 0;
     
-    deviceInfoSet = SetupDiGetClassDevsA(NULL, NULL, NULL, 
-                                         DIGCF_ALLCLASSES | DIGCF_PRESENT);
-    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
-        return FALSE;
-    }
-    
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-    
-    for (i = 0; SetupDiEnumDeviceInfo(deviceInfoSet, i, &deviceInfoData); i++) {
-        if (SetupDiGetDeviceRegistryPropertyA(deviceInfoSet, &deviceInfoData,
-                SPDRP_HARDWAREID, NULL, (PBYTE)hardwareId, sizeof(hardwareId), NULL)) {
-            
-            for (j = 0; g_VmBusHardwareIds[j] != NULL; j++) {
-                if (strstr(hardwareId, g_VmBusHardwareIds[j]) != NULL) {
-                    found = TRUE;
-                    break;
-                }
-            }
-            
-            if (found) break;
+    for (j = 0; g_VmBusHardwareIds[j] != NULL; j++) {
+        if (DeviceIndexFirstById(index, g_VmBusHardwareIds[j]) != NULL) {
+            return TRUE;
         }
     }
     
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
-    return found;
+    return FALSE;
 }
 
 /*
@@ -9,6 +9,7 @@
  */
 
 #include "hyperv_detector.h"
+#include "driver_batch.h"
 
 // Detection flag for timing
 #define HYPERV_DETECTED_TIMING 0x00010000
@@ -17,6 +18,7 @@
 #define TIMING_SAMPLES 1000
 #define TIMING_THRESHOLD_RDTSC 500      // Cycles threshold for RDTSC
 #define TIMING_THRESHOLD_CPUID 10000    // Cycles threshold for CPUID
+#define TIMING_THRESHOLD_KERNEL_CPUID 500   // Median CPUID cost above baseline, interrupts off
 
 #if ARCH_X86_OR_X64
 // Read Time-Stamp Counter
@@ -263,6 +265,61 @@ static DWORD TestInterruptTiming(PDETECTION_RESULT result) {
     
     return detected;
 }
+
+// Test 5: Exit latency measured by the driver with interrupts disabled
+static DWORD TestKernelExitLatency(PDETECTION_RESULT result) {
+    static const char* probeNames[HV_LATENCY_PROBE_COUNT] = {
+        "Baseline", "CPUID(0)", "CPUID(0x40000000)", "CPUID(0x40000003)",
+        "RDMSR VP_INDEX", "RDMSR TIME_REF_COUNT", "Fast hypercall"
+    };
+    HV_LATENCY_HISTOGRAM merged[HV_LATENCY_PROBE_COUNT];
+    DWORD detected = 0;
+    UINT32 processors = 0;
+    UINT64 baseline = 0;
+    UINT8* response = NULL;
+    HANDLE device = DriverBatchOpen();
+    
+    if (device == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    response = DriverMeasureExitLatency(device, 0, &processors);
+    CloseHandle(device);
+    if (response == NULL) {
+        AppendToDetails(result, "Timing: Kernel exit latency battery failed\n");
+        return 0;
+    }
+    
+    for (UINT32 probe = 0; probe < HV_LATENCY_PROBE_COUNT; probe++) {
+        HvHistogramReset(&merged[probe], probe);
+        for (UINT32 cpu = 0; cpu < processors; cpu++) {
+            HvHistogramMerge(&merged[probe], HvLatencyGet(response, cpu, probe));
+        }
+    }
+    free(response);
+    
+    AppendToDetails(result, "Timing: Kernel exit latency, interrupts off, %u processors (TSC ticks):\n", processors);
+    for (UINT32 probe = 0; probe < HV_LATENCY_PROBE_COUNT; probe++) {
+        if (merged[probe].Status != HV_BATCH_STATUS_OK) {
+            AppendToDetails(result, "  %-22s not available\n", probeNames[probe]);
+            continue;
+        }
+        AppendToDetails(result, "  %-22s min %llu  p50 %llu  p90 %llu  p99 %llu  max %llu  mean %llu\n",
+                       probeNames[probe], merged[probe].Min,
+                       HvHistogramPercentile(&merged[probe], 50), HvHistogramPercentile(&merged[probe], 90),
+                       HvHistogramPercentile(&merged[probe], 99), merged[probe].Max,
+                       HvHistogramMean(&merged[probe]));
+    }
+    
+    // Medians are bucket bounds, which is plenty to tell an exit from a native CPUID
+    baseline = HvHistogramPercentile(&merged[HV_LATENCY_PROBE_BASELINE], 50);
+    if (merged[HV_LATENCY_PROBE_CPUID_0].Status == HV_BATCH_STATUS_OK &&
+        HvHistogramPercentile(&merged[HV_LATENCY_PROBE_CPUID_0], 50) > baseline + TIMING_THRESHOLD_KERNEL_CPUID) {
+        detected |= HYPERV_DETECTED_TIMING;
+        AppendToDetails(result, "Timing: CPUID exits to a hypervisor (kernel measurement)\n");
+    }
+    
+    return detected;
+}
 #endif /* ARCH_X86_OR_X64 - timing test functions */
 
 // Main timing check function
@@ -287,6 +344,7 @@ DWORD CheckTimingHyperV(PDETECTION_RESULT result) {
     detected |= TestCPUIDTiming(result);
     detected |= TestVMExitTiming(result);
     detected |= TestInterruptTiming(result);
+    detected |= TestKernelExitLatency(result);
 
     // Restore thread settings
     SetThreadAffinityMask(hThread, oldAffinity);
@@ -14,10 +14,8 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "device_index.h"
 #include <stdio.h>
-#include <setupapi.h>
-
-#pragma comment(lib, "setupapi.lib")
 
 /* Detection flag for this module */
 #define HYPERV_DETECTED_VMBUS_CHANNEL 0x00000004
@@ -89,61 +87,48 @@ static void CheckVmbusDrivers(PVMBUS_CHANNEL_INFO info)
  */
 static void CheckVmbusDevices(PVMBUS_CHANNEL_INFO info)
 {
-    HDEVINFO hDevInfo;
-    SP_DEVINFO_DATA devInfoData;
-    DWORD i;
-    char buffer[512];
-    DWORD bufferSize;
+    const DEVICE_INDEX* index;
+    const DEVICE_INDEX_ENTRY* device;
+    const char* desc;
     
     if (info == NULL) {
         return;
     }
     
-    /* Get all present devices */
-    hDevInfo = SetupDiGetClassDevsA(NULL, "VMBUS", NULL, 
-                                    DIGCF_ALLCLASSES | DIGCF_PRESENT);
-    
-    if (hDevInfo == INVALID_HANDLE_VALUE) {
-        return;
-    }
-    
-    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+    /* Devices enumerated by VMBus */
+    index = GetDeviceIndex();
     
-    for (i = 0; SetupDiEnumDeviceInfo(hDevInfo, i, &devInfoData); i++) {
+    for (device = DeviceIndexFirstById(index, "VMBUS\\"); device != NULL;
+         device = DeviceIndexNextById(index, "VMBUS\\", device)) {
         info->vmbusDeviceFound = TRUE;
         info->channelCount++;
         
-        bufferSize = sizeof(buffer);
-        if (SetupDiGetDeviceRegistryPropertyA(hDevInfo, &devInfoData,
-            SPDRP_DEVICEDESC, NULL, (PBYTE)buffer, bufferSize, NULL)) {
-            
-            /* Check for specific channels */
-            if (strstr(buffer, "Data Exchange") != NULL ||
-                strstr(buffer, "KVP") != NULL) {
-                info->kvpChannelFound = TRUE;
-            }
-            
-            if (strstr(buffer, "Shutdown") != NULL) {
-                info->shutdownChannelFound = TRUE;
-            }
-            
-            if (strstr(buffer, "Heartbeat") != NULL) {
-                info->heartbeatChannelFound = TRUE;
-            }
-            
-            if (strstr(buffer, "VSS") != NULL ||
-                strstr(buffer, "Volume Shadow Copy") != NULL) {
-                info->vssChannelFound = TRUE;
-            }
-            
-            if (strstr(buffer, "Remote Desktop") != NULL ||
-                strstr(buffer, "Video") != NULL) {
-                info->rdvChannelFound = TRUE;
-            }
+        desc = device->description;
+        
+        /* Check for specific channels */
+        if (strstr(desc, "Data Exchange") != NULL ||
+            strstr(desc, "KVP") != NULL) {
+            info->kvpChannelFound = TRUE;
+        }
+        
+        if (strstr(desc, "Shutdown") != NULL) {
+            info->shutdownChannelFound = TRUE;
+        }
+        
+        if (strstr(desc, "Heartbeat") != NULL) {
+            info->heartbeatChannelFound = TRUE;
+        }
+        
+        if (strstr(desc, "VSS") != NULL ||
+            strstr(desc, "Volume Shadow Copy") != NULL) {
+            info->vssChannelFound = TRUE;
+        }
+        
+        if (strstr(desc, "Remote Desktop") != NULL ||
+            strstr(desc, "Video") != NULL) {
+            info->rdvChannelFound = TRUE;
         }
     }
-    
-    SetupDiDestroyDeviceInfoList(hDevInfo);
 }
 
 /*
@@ -124,18 +124,18 @@ static void CheckVsmRegistry(PVSM_INFO info)
     
     /* Check Device Guard / HVCI status */
     result = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
-        "SYSTEM\\CurrentControlSet\\Control\\DeviceGuard",
+        HV_REG_KEY_DEVICEGUARD,
         0, KEY_READ, &hKey);
     
     if (result == ERROR_SUCCESS) {
         size = sizeof(DWORD);
-        if (RegQueryValueExA(hKey, "EnableVirtualizationBasedSecurity", 
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_VBS,
             NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
             info->vsmEnabled = (value != 0);
         }
         
         size = sizeof(DWORD);
-        if (RegQueryValueExA(hKey, "HypervisorEnforcedCodeIntegrity",
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_HVCI,
             NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
             info->hasHvci = (value != 0);
         }
@@ -159,12 +159,12 @@ static void CheckVsmRegistry(PVSM_INFO info)
     
     /* Check Secure Boot */
     result = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
-        "SYSTEM\\CurrentControlSet\\Control\\SecureBoot\\State",
+        HV_REG_KEY_SECUREBOOT_STATE,
         0, KEY_READ, &hKey);
     
     if (result == ERROR_SUCCESS) {
         size = sizeof(DWORD);
-        if (RegQueryValueExA(hKey, "UEFISecureBootEnabled",
+        if (RegQueryValueExA(hKey, HV_REG_VALUE_SECUREBOOT,
             NULL, NULL, (LPBYTE)&value, &size) == ERROR_SUCCESS) {
             info->hasSecureBoot = (value != 0);
         }
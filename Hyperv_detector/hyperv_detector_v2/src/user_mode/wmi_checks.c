@@ -2,244 +2,195 @@
  * wmi_checks.c - WMI-based Hyper-V detection
  * 
  * Uses Windows Management Instrumentation to detect Hyper-V presence
- * through various WMI classes and namespaces.
+ * through various WMI classes and namespaces. Sessions come from the
+ * shared pool in wmi_pool.c.
  */
 
 #include "hyperv_detector.h"
-#include <wbemidl.h>
-
-#pragma comment(lib, "wbemuuid.lib")
-#pragma comment(lib, "ole32.lib")
-#pragma comment(lib, "oleaut32.lib")
+#include "wmi_pool.h"
 
 // Detection flag for WMI
 #define HYPERV_DETECTED_WMI 0x00002000
 
-static BOOL InitializeCOM(void) {
-    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-        return FALSE;
-    }
-    
-    hr = CoInitializeSecurity(
-        NULL, -1, NULL, NULL,
-        RPC_C_AUTHN_LEVEL_DEFAULT,
-        RPC_C_IMP_LEVEL_IMPERSONATE,
-        NULL, EOAC_NONE, NULL
-    );
-    
-    return SUCCEEDED(hr) || hr == RPC_E_TOO_LATE;
-}
+// Namespaces this check touches, connected in parallel up front
+static const wchar_t* WMI_CHECK_NAMESPACES[] = {
+    WMI_NS_CIMV2,
+    WMI_NS_VIRTUALIZATION_V2,
+    WMI_NS_VIRTUALIZATION,
+    NULL
+};
 
-static IWbemServices* ConnectToWMI(const wchar_t* namespace_path) {
-    IWbemLocator* pLocator = NULL;
-    IWbemServices* pServices = NULL;
-    HRESULT hr;
-    
-    hr = CoCreateInstance(
-        &CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
-        &IID_IWbemLocator, (LPVOID*)&pLocator
-    );
-    
-    if (FAILED(hr)) {
-        return NULL;
-    }
-    
-    BSTR bstrNamespace = SysAllocString(namespace_path);
-    hr = pLocator->lpVtbl->ConnectServer(
-        pLocator, bstrNamespace, NULL, NULL, NULL, 0, NULL, NULL, &pServices
-    );
-    SysFreeString(bstrNamespace);
-    
-    pLocator->lpVtbl->Release(pLocator);
-    
-    if (FAILED(hr)) {
-        return NULL;
-    }
-    
-    CoSetProxyBlanket(
-        (IUnknown*)pServices, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL,
-        RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE
-    );
-    
-    return pServices;
-}
+// Queries of CheckWMIHyperV; the CIMV2 ones come first, then those of the v2 namespace
+enum {
+    SELECT_COMPUTER_SYSTEM,
+    SELECT_BIOS,
+    SELECT_BASEBOARD,
+    SELECT_DISK_DRIVE,
+    SELECT_VIDEO_CONTROLLER,
+    SELECT_VM,
+    SELECT_SWITCH,
+    WMI_SELECT_COUNT
+};
 
-static BOOL QueryWMIProperty(IWbemServices* pServices, const wchar_t* query, 
-                            const wchar_t* property, char* outBuffer, size_t bufSize) {
-    IEnumWbemClassObject* pEnumerator = NULL;
-    IWbemClassObject* pClassObject = NULL;
-    ULONG returned = 0;
-    HRESULT hr;
-    BOOL found = FALSE;
-    
-    BSTR bstrQuery = SysAllocString(query);
-    BSTR bstrWQL = SysAllocString(L"WQL");
-    
-    hr = pServices->lpVtbl->ExecQuery(
-        pServices, bstrWQL, bstrQuery,
-        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-        NULL, &pEnumerator
-    );
-    
-    SysFreeString(bstrQuery);
-    SysFreeString(bstrWQL);
-    
-    if (FAILED(hr)) {
-        return FALSE;
-    }
-    
-    while (pEnumerator->lpVtbl->Next(pEnumerator, WBEM_INFINITE, 1, &pClassObject, &returned) == S_OK) {
-        VARIANT vtProp;
-        VariantInit(&vtProp);
-        
-        hr = pClassObject->lpVtbl->Get(pClassObject, property, 0, &vtProp, NULL, NULL);
-        if (SUCCEEDED(hr) && vtProp.vt == VT_BSTR && vtProp.bstrVal != NULL) {
-            WideCharToMultiByte(CP_UTF8, 0, vtProp.bstrVal, -1, outBuffer, (int)bufSize, NULL, NULL);
-            found = TRUE;
-        }
-        
-        VariantClear(&vtProp);
-        pClassObject->lpVtbl->Release(pClassObject);
-        
-        if (found) break;
-    }
-    
-    pEnumerator->lpVtbl->Release(pEnumerator);
-    return found;
+static void SetSelect(PWMI_SELECT select, const wchar_t* namespacePath, const wchar_t* className,
+                      const wchar_t* const* properties, DWORD propertyCount) {
+    select->namespacePath = namespacePath;
+    select->className = className;
+    select->properties = properties;
+    select->propertyCount = propertyCount;
 }
 
 DWORD CheckWMIHyperV(PDETECTION_RESULT result) {
     DWORD detected = 0;
-    char buffer[1024];
-    IWbemServices* pServices = NULL;
-    
-    if (!InitializeCOM()) {
-        AppendToDetails(result, "WMI: Failed to initialize COM\n");
-        return 0;
+    WMI_SELECT selects[WMI_SELECT_COUNT];
+    WMI_VALUE* values;
+    BOOL haveCimv2, haveV2;
+    DWORD first, last;
+    
+    static const wchar_t* COMPUTER_SYSTEM_PROPS[] = { L"Model", L"Manufacturer", L"HypervisorPresent" };
+    static const wchar_t* BIOS_PROPS[] = { L"SerialNumber", L"SMBIOSBIOSVersion" };
+    static const wchar_t* BASEBOARD_PROPS[] = { L"Manufacturer", L"Product" };
+    static const wchar_t* MODEL_PROPS[] = { L"Model" };
+    static const wchar_t* NAME_PROPS[] = { L"Name" };
+    static const wchar_t* ELEMENT_NAME_PROPS[] = { L"ElementName" };
+    
+    WmiPoolPrefetch(WMI_CHECK_NAMESPACES);
+    haveCimv2 = WmiPoolNamespaceExists(WMI_NS_CIMV2);
+    haveV2 = WmiPoolNamespaceExists(WMI_NS_VIRTUALIZATION_V2);
+    
+    // Issue every query at once; the results are evaluated below in the usual order
+    memset(selects, 0, sizeof(selects));
+    if (haveCimv2) {
+        SetSelect(&selects[SELECT_COMPUTER_SYSTEM], WMI_NS_CIMV2, L"Win32_ComputerSystem", COMPUTER_SYSTEM_PROPS, 3);
+        SetSelect(&selects[SELECT_BIOS], WMI_NS_CIMV2, L"Win32_BIOS", BIOS_PROPS, 2);
+        SetSelect(&selects[SELECT_BASEBOARD], WMI_NS_CIMV2, L"Win32_BaseBoard", BASEBOARD_PROPS, 2);
+        SetSelect(&selects[SELECT_DISK_DRIVE], WMI_NS_CIMV2, L"Win32_DiskDrive", MODEL_PROPS, 1);
+        SetSelect(&selects[SELECT_VIDEO_CONTROLLER], WMI_NS_CIMV2, L"Win32_VideoController", NAME_PROPS, 1);
+    }
+    if (haveV2) {
+        SetSelect(&selects[SELECT_VM], WMI_NS_VIRTUALIZATION_V2, L"Msvm_ComputerSystem", ELEMENT_NAME_PROPS, 1);
+        SetSelect(&selects[SELECT_SWITCH], WMI_NS_VIRTUALIZATION_V2, L"Msvm_VirtualEthernetSwitch", ELEMENT_NAME_PROPS, 1);
+    }
+    first = haveCimv2 ? 0 : SELECT_VM;
+    last = haveV2 ? WMI_SELECT_COUNT : SELECT_VM;
+    if (last > first) {
+        WmiPoolSelectMany(&selects[first], last - first);
     }
     
     // Check Win32_ComputerSystem for virtual machine model
-    pServices = ConnectToWMI(L"ROOT\\CIMV2");
-    if (pServices) {
-        // Check Model
-        if (QueryWMIProperty(pServices, L"SELECT Model FROM Win32_ComputerSystem", 
-                            L"Model", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: ComputerSystem Model: %s\n", buffer);
-            if (strstr(buffer, "Virtual Machine") || strstr(buffer, "Hyper-V")) {
-                detected |= HYPERV_DETECTED_WMI;
-                AppendToDetails(result, "WMI: Hyper-V Virtual Machine detected via ComputerSystem\n");
+    if (haveCimv2) {
+        values = selects[SELECT_COMPUTER_SYSTEM].values;
+        if (selects[SELECT_COMPUTER_SYSTEM].found) {
+            // Check Model
+            if (values[0].present) {
+                AppendToDetails(result, "WMI: ComputerSystem Model: %s\n", values[0].text);
+                if (strstr(values[0].text, "Virtual Machine") || strstr(values[0].text, "Hyper-V")) {
+                    detected |= HYPERV_DETECTED_WMI;
+                    AppendToDetails(result, "WMI: Hyper-V Virtual Machine detected via ComputerSystem\n");
+                }
             }
-        }
-        
-        // Check Manufacturer
-        if (QueryWMIProperty(pServices, L"SELECT Manufacturer FROM Win32_ComputerSystem", 
-                            L"Manufacturer", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: ComputerSystem Manufacturer: %s\n", buffer);
-            if (strstr(buffer, "Microsoft Corporation")) {
-                detected |= HYPERV_DETECTED_WMI;
+            
+            // Check Manufacturer
+            if (values[1].present) {
+                AppendToDetails(result, "WMI: ComputerSystem Manufacturer: %s\n", values[1].text);
+                if (strstr(values[1].text, "Microsoft Corporation")) {
+                    detected |= HYPERV_DETECTED_WMI;
+                }
             }
-        }
-        
-        // Check HypervisorPresent property (Windows 8+)
-        if (QueryWMIProperty(pServices, L"SELECT HypervisorPresent FROM Win32_ComputerSystem", 
-                            L"HypervisorPresent", buffer, sizeof(buffer))) {
-            if (strcmp(buffer, "True") == 0 || strcmp(buffer, "1") == 0) {
+            
+            // Check HypervisorPresent property (Windows 8+)
+            if (values[2].present && (strcmp(values[2].text, "True") == 0 || strcmp(values[2].text, "1") == 0)) {
                 detected |= HYPERV_DETECTED_WMI;
                 AppendToDetails(result, "WMI: HypervisorPresent = True\n");
             }
         }
         
         // Check Win32_BIOS
-        if (QueryWMIProperty(pServices, L"SELECT SerialNumber FROM Win32_BIOS", 
-                            L"SerialNumber", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: BIOS SerialNumber: %s\n", buffer);
-            // Hyper-V VMs often have specific serial number patterns
-            if (strstr(buffer, "-") && strlen(buffer) > 30) {
-                detected |= HYPERV_DETECTED_WMI;
-                AppendToDetails(result, "WMI: Potential Hyper-V BIOS serial detected\n");
+        values = selects[SELECT_BIOS].values;
+        if (selects[SELECT_BIOS].found) {
+            if (values[0].present) {
+                AppendToDetails(result, "WMI: BIOS SerialNumber: %s\n", values[0].text);
+                // Hyper-V VMs often have specific serial number patterns
+                if (strstr(values[0].text, "-") && strlen(values[0].text) > 30) {
+                    detected |= HYPERV_DETECTED_WMI;
+                    AppendToDetails(result, "WMI: Potential Hyper-V BIOS serial detected\n");
+                }
             }
-        }
-        
-        if (QueryWMIProperty(pServices, L"SELECT SMBIOSBIOSVersion FROM Win32_BIOS", 
-                            L"SMBIOSBIOSVersion", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: SMBIOS BIOS Version: %s\n", buffer);
-            if (strstr(buffer, "Hyper-V") || strstr(buffer, "VRTUAL") || strstr(buffer, "090008")) {
-                detected |= HYPERV_DETECTED_WMI;
-                AppendToDetails(result, "WMI: Hyper-V BIOS version detected\n");
+            
+            if (values[1].present) {
+                AppendToDetails(result, "WMI: SMBIOS BIOS Version: %s\n", values[1].text);
+                if (strstr(values[1].text, "Hyper-V") || strstr(values[1].text, "VRTUAL") || strstr(values[1].text, "090008")) {
+                    detected |= HYPERV_DETECTED_WMI;
+                    AppendToDetails(result, "WMI: Hyper-V BIOS version detected\n");
+                }
             }
         }
         
         // Check Win32_BaseBoard
-        if (QueryWMIProperty(pServices, L"SELECT Manufacturer FROM Win32_BaseBoard", 
-                            L"Manufacturer", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: BaseBoard Manufacturer: %s\n", buffer);
-            if (strstr(buffer, "Microsoft Corporation")) {
-                detected |= HYPERV_DETECTED_WMI;
+        values = selects[SELECT_BASEBOARD].values;
+        if (selects[SELECT_BASEBOARD].found) {
+            if (values[0].present) {
+                AppendToDetails(result, "WMI: BaseBoard Manufacturer: %s\n", values[0].text);
+                if (strstr(values[0].text, "Microsoft Corporation")) {
+                    detected |= HYPERV_DETECTED_WMI;
+                }
             }
-        }
-        
-        if (QueryWMIProperty(pServices, L"SELECT Product FROM Win32_BaseBoard", 
-                            L"Product", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: BaseBoard Product: %s\n", buffer);
-            if (strstr(buffer, "Virtual Machine")) {
-                detected |= HYPERV_DETECTED_WMI;
-                AppendToDetails(result, "WMI: Hyper-V baseboard detected\n");
+            
+            if (values[1].present) {
+                AppendToDetails(result, "WMI: BaseBoard Product: %s\n", values[1].text);
+                if (strstr(values[1].text, "Virtual Machine")) {
+                    detected |= HYPERV_DETECTED_WMI;
+                    AppendToDetails(result, "WMI: Hyper-V baseboard detected\n");
+                }
             }
         }
         
         // Check Win32_DiskDrive for virtual disks
-        if (QueryWMIProperty(pServices, L"SELECT Model FROM Win32_DiskDrive", 
-                            L"Model", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: DiskDrive Model: %s\n", buffer);
-            if (strstr(buffer, "Virtual") || strstr(buffer, "Msft Virtual Disk")) {
+        values = selects[SELECT_DISK_DRIVE].values;
+        if (selects[SELECT_DISK_DRIVE].found && values[0].present) {
+            AppendToDetails(result, "WMI: DiskDrive Model: %s\n", values[0].text);
+            if (strstr(values[0].text, "Virtual") || strstr(values[0].text, "Msft Virtual Disk")) {
                 detected |= HYPERV_DETECTED_WMI;
                 AppendToDetails(result, "WMI: Hyper-V virtual disk detected\n");
             }
         }
         
         // Check Win32_VideoController
-        if (QueryWMIProperty(pServices, L"SELECT Name FROM Win32_VideoController", 
-                            L"Name", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: VideoController: %s\n", buffer);
-            if (strstr(buffer, "Hyper-V") || strstr(buffer, "Microsoft Hyper-V Video")) {
+        values = selects[SELECT_VIDEO_CONTROLLER].values;
+        if (selects[SELECT_VIDEO_CONTROLLER].found && values[0].present) {
+            AppendToDetails(result, "WMI: VideoController: %s\n", values[0].text);
+            if (strstr(values[0].text, "Hyper-V") || strstr(values[0].text, "Microsoft Hyper-V Video")) {
                 detected |= HYPERV_DETECTED_WMI;
                 AppendToDetails(result, "WMI: Hyper-V video adapter detected\n");
             }
         }
-        
-        pServices->lpVtbl->Release(pServices);
+    } else {
+        AppendToDetails(result, "WMI: Failed to connect to ROOT\\CIMV2\n");
     }
     
     // Check Hyper-V specific WMI namespace
-    pServices = ConnectToWMI(L"ROOT\\virtualization\\v2");
-    if (pServices) {
+    if (haveV2) {
         detected |= HYPERV_DETECTED_WMI;
         AppendToDetails(result, "WMI: Hyper-V virtualization namespace (v2) accessible\n");
         
         // Query Msvm_ComputerSystem for VMs
-        if (QueryWMIProperty(pServices, L"SELECT ElementName FROM Msvm_ComputerSystem", 
-                            L"ElementName", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: Found Hyper-V VM: %s\n", buffer);
+        values = selects[SELECT_VM].values;
+        if (selects[SELECT_VM].found && values[0].present) {
+            AppendToDetails(result, "WMI: Found Hyper-V VM: %s\n", values[0].text);
         }
         
         // Check for virtual switches
-        if (QueryWMIProperty(pServices, L"SELECT ElementName FROM Msvm_VirtualEthernetSwitch", 
-                            L"ElementName", buffer, sizeof(buffer))) {
-            AppendToDetails(result, "WMI: Found Hyper-V virtual switch: %s\n", buffer);
+        values = selects[SELECT_SWITCH].values;
+        if (selects[SELECT_SWITCH].found && values[0].present) {
+            AppendToDetails(result, "WMI: Found Hyper-V virtual switch: %s\n", values[0].text);
         }
-        
-        pServices->lpVtbl->Release(pServices);
     }
     
     // Check legacy Hyper-V namespace
-    pServices = ConnectToWMI(L"ROOT\\virtualization");
-    if (pServices) {
+    if (WmiPoolNamespaceExists(WMI_NS_VIRTUALIZATION)) {
         detected |= HYPERV_DETECTED_WMI;
         AppendToDetails(result, "WMI: Hyper-V virtualization namespace (legacy) accessible\n");
-        pServices->lpVtbl->Release(pServices);
     }
     
-    CoUninitialize();
     return detected;
 }
@@ -12,12 +12,8 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "hyperv_detector.h"
+#include "wmi_pool.h"
 #include <stdio.h>
-#include <wbemidl.h>
-
-#pragma comment(lib, "wbemuuid.lib")
-#pragma comment(lib, "ole32.lib")
-#pragma comment(lib, "oleaut32.lib")
 
 #define HYPERV_DETECTED_WMI_NAMESPACE 0x10000000
 
@@ -55,46 +51,7 @@ typedef struct _WMI_NAMESPACE_INFO {
  */
 static BOOL CheckWmiNamespaceExists(const wchar_t* namespacePath)
 {
-    HRESULT hr = S_OK;
-    IWbemLocator* pLocator = NULL;
-    IWbemServices* pServices = NULL;
-    BOOL exists = FALSE;
-    
-    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-        return FALSE;
-    }
-    
-    hr = CoInitializeSecurity(
-        NULL, -1, NULL, NULL,
-        RPC_C_AUTHN_LEVEL_DEFAULT,
-        RPC_C_IMP_LEVEL_IMPERSONATE,
-        NULL, EOAC_NONE, NULL);
-    
-    /* Create WMI locator */
-    hr = CoCreateInstance(
-        &CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
-        &IID_IWbemLocator, (void**)&pLocator);
-    
-    if (FAILED(hr)) {
-        CoUninitialize();
-        return FALSE;
-    }
-    
-    /* Try to connect to namespace */
-    hr = pLocator->lpVtbl->ConnectServer(
-        pLocator, (BSTR)namespacePath,
-        NULL, NULL, NULL, 0, NULL, NULL, &pServices);
-    
-    if (SUCCEEDED(hr)) {
-        exists = TRUE;
-        pServices->lpVtbl->Release(pServices);
-    }
-    
-    pLocator->lpVtbl->Release(pLocator);
-    CoUninitialize();
-    
-    return exists;
+    return WmiPoolNamespaceExists(namespacePath);
 }
 
 /*
@@ -102,73 +59,15 @@ static BOOL CheckWmiNamespaceExists(const wchar_t* namespacePath)
  */
 static int CountVirtualMachines(void)
 {
-    HRESULT hr = S_OK;
-    IWbemLocator* pLocator = NULL;
-    IWbemServices* pServices = NULL;
-    IEnumWbemClassObject* pEnumerator = NULL;
-    IWbemClassObject* pClassObj = NULL;
-    ULONG uReturn = 0;
-    int vmCount = 0;
-    
-    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-        return 0;
-    }
-    
-    hr = CoCreateInstance(
-        &CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
-        &IID_IWbemLocator, (void**)&pLocator);
+    /* Query for VMs (exclude host entry), v2 namespace first, then legacy */
+    const wchar_t* query = L"SELECT Name FROM Msvm_ComputerSystem WHERE Caption = 'Virtual Machine'";
+    int vmCount = WmiPoolCount(WMI_NS_VIRTUALIZATION_V2, query);
     
-    if (FAILED(hr)) {
-        CoUninitialize();
-        return 0;
+    if (vmCount < 0) {
+        vmCount = WmiPoolCount(WMI_NS_VIRTUALIZATION, query);
     }
     
-    /* Connect to v2 namespace first */
-    hr = pLocator->lpVtbl->ConnectServer(
-        pLocator, L"ROOT\\virtualization\\v2",
-        NULL, NULL, NULL, 0, NULL, NULL, &pServices);
-    
-    if (FAILED(hr)) {
-        /* Try legacy namespace */
-        hr = pLocator->lpVtbl->ConnectServer(
-            pLocator, L"ROOT\\virtualization",
-            NULL, NULL, NULL, 0, NULL, NULL, &pServices);
-    }
-    
-    if (FAILED(hr)) {
-        pLocator->lpVtbl->Release(pLocator);
-        CoUninitialize();
-        return 0;
-    }
-    
-    /* Set security on proxy */
-    hr = CoSetProxyBlanket(
-        (IUnknown*)pServices, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL,
-        RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
-    
-    /* Query for VMs (exclude host entry) */
-    hr = pServices->lpVtbl->ExecQuery(
-        pServices, L"WQL",
-        L"SELECT * FROM Msvm_ComputerSystem WHERE Caption = 'Virtual Machine'",
-        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-        NULL, &pEnumerator);
-    
-    if (SUCCEEDED(hr)) {
-        while (pEnumerator) {
-            hr = pEnumerator->lpVtbl->Next(pEnumerator, WBEM_INFINITE, 1, &pClassObj, &uReturn);
-            if (uReturn == 0) break;
-            vmCount++;
-            pClassObj->lpVtbl->Release(pClassObj);
-        }
-        pEnumerator->lpVtbl->Release(pEnumerator);
-    }
-    
-    pServices->lpVtbl->Release(pServices);
-    pLocator->lpVtbl->Release(pLocator);
-    CoUninitialize();
-    
-    return vmCount;
+    return vmCount < 0 ? 0 : vmCount;
 }
 
 /*
@@ -176,62 +75,8 @@ static int CountVirtualMachines(void)
  */
 static BOOL CheckVSMSExists(void)
 {
-    HRESULT hr = S_OK;
-    IWbemLocator* pLocator = NULL;
-    IWbemServices* pServices = NULL;
-    IEnumWbemClassObject* pEnumerator = NULL;
-    IWbemClassObject* pClassObj = NULL;
-    ULONG uReturn = 0;
-    BOOL exists = FALSE;
-    
-    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-        return FALSE;
-    }
-    
-    hr = CoCreateInstance(
-        &CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
-        &IID_IWbemLocator, (void**)&pLocator);
-    
-    if (FAILED(hr)) {
-        CoUninitialize();
-        return FALSE;
-    }
-    
-    hr = pLocator->lpVtbl->ConnectServer(
-        pLocator, L"ROOT\\virtualization\\v2",
-        NULL, NULL, NULL, 0, NULL, NULL, &pServices);
-    
-    if (FAILED(hr)) {
-        pLocator->lpVtbl->Release(pLocator);
-        CoUninitialize();
-        return FALSE;
-    }
-    
-    hr = CoSetProxyBlanket(
-        (IUnknown*)pServices, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL,
-        RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
-    
-    hr = pServices->lpVtbl->ExecQuery(
-        pServices, L"WQL",
-        L"SELECT * FROM Msvm_VirtualSystemManagementService",
-        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-        NULL, &pEnumerator);
-    
-    if (SUCCEEDED(hr)) {
-        hr = pEnumerator->lpVtbl->Next(pEnumerator, WBEM_INFINITE, 1, &pClassObj, &uReturn);
-        if (uReturn > 0) {
-            exists = TRUE;
-            pClassObj->lpVtbl->Release(pClassObj);
-        }
-        pEnumerator->lpVtbl->Release(pEnumerator);
-    }
-    
-    pServices->lpVtbl->Release(pServices);
-    pLocator->lpVtbl->Release(pLocator);
-    CoUninitialize();
-    
-    return exists;
+    return WmiPoolCount(WMI_NS_VIRTUALIZATION_V2,
+        L"SELECT Name FROM Msvm_VirtualSystemManagementService") > 0;
 }
 
 /*
@@ -245,11 +90,14 @@ static void GatherWmiNamespaceInfo(PWMI_NAMESPACE_INFO info)
     
     memset(info, 0, sizeof(WMI_NAMESPACE_INFO));
     
+    /* Connect both namespaces in parallel; the checks below reuse the sessions */
+    WmiPoolPrefetch(g_HyperVNamespaces);
+    
     /* Check for v2 namespace (Windows 8 / Server 2012+) */
-    info->hasVirtualizationV2 = CheckWmiNamespaceExists(L"ROOT\\virtualization\\v2");
+    info->hasVirtualizationV2 = CheckWmiNamespaceExists(WMI_NS_VIRTUALIZATION_V2);
     
     /* Check for v1 namespace (legacy) */
-    info->hasVirtualizationV1 = CheckWmiNamespaceExists(L"ROOT\\virtualization");
+    info->hasVirtualizationV1 = CheckWmiNamespaceExists(WMI_NS_VIRTUALIZATION);
     
     /* If v2 exists, check for management service */
     if (info->hasVirtualizationV2) {
@@ -316,7 +164,7 @@ DWORD CheckWmiNamespaceHyperV(PDETECTION_RESULT result)
  */
 BOOL HasHyperVWmiNamespace(void)
 {
-    return CheckWmiNamespaceExists(L"ROOT\\virtualization\\v2");
+    return CheckWmiNamespaceExists(WMI_NS_VIRTUALIZATION_V2);
 }
 
 /*
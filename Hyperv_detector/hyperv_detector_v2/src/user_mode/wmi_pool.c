@@ -0,0 +1,459 @@
+/**
+ * wmi_pool.c - Pooled WMI sessions
+ *
+ * Before: every WMI check ran CoInitializeEx, created a locator, connected
+ * to its namespace and tore everything down again, often several times per
+ * check. Connection setup dominated the WMI cost of a scan. Sessions are now
+ * connected once per namespace and shared by all checks.
+ *
+ * Sources: https://learn.microsoft.com/en-us/windows/win32/wmisdk/making-a-semisynchronous-call
+ *          https://learn.microsoft.com/en-us/windows/win32/wmisdk/improving-enumeration-performance
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "wmi_pool.h"
+#include <stdio.h>
+#include <string.h>
+
+#pragma comment(lib, "wbemuuid.lib")
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "oleaut32.lib")
+
+typedef struct _WMI_POOL_SESSION {
+    wchar_t namespacePath[128];
+    IWbemServices* services;
+    BOOL claimed;                   /* A thread is connecting or has connected */
+    BOOL done;                      /* Connection attempt finished */
+} WMI_POOL_SESSION, *PWMI_POOL_SESSION;
+
+static struct {
+    BOOL initialized;
+    BOOL multithreaded;             /* Pool lives in the MTA, so sessions can be shared across threads */
+    IWbemLocator* locator;
+    WMI_POOL_SESSION sessions[WMI_POOL_MAX_SESSIONS];
+    DWORD sessionCount;
+} g_wmiPool;
+
+static SRWLOCK g_wmiPoolLock = SRWLOCK_INIT;
+static CONDITION_VARIABLE g_wmiPoolConnected = CONDITION_VARIABLE_INIT;
+static __declspec(thread) BOOL t_comInitialized = FALSE;
+
+/*
+ * Join the MTA on the calling thread (once per thread)
+ */
+static BOOL EnsureThreadCom(BOOL* multithreaded) {
+    HRESULT hr;
+
+    if (t_comInitialized) {
+        if (multithreaded) *multithreaded = TRUE;
+        return TRUE;
+    }
+
+    hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    if (SUCCEEDED(hr)) {
+        t_comInitialized = TRUE;
+        if (multithreaded) *multithreaded = TRUE;
+        return TRUE;
+    }
+
+    // Caller already runs in an STA; usable, but sessions stay on this thread
+    if (hr == RPC_E_CHANGED_MODE) {
+        if (multithreaded) *multithreaded = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * COM security and the shared locator. Caller holds the lock exclusively.
+ */
+static BOOL InitializePoolLocked(void) {
+    HRESULT hr;
+
+    if (g_wmiPool.initialized) {
+        return g_wmiPool.locator != NULL;
+    }
+    g_wmiPool.initialized = TRUE;
+
+    if (!EnsureThreadCom(&g_wmiPool.multithreaded)) {
+        return FALSE;
+    }
+
+    // RPC_E_TOO_LATE: the process already set its security, which is fine
+    CoInitializeSecurity(
+        NULL, -1, NULL, NULL,
+        RPC_C_AUTHN_LEVEL_DEFAULT,
+        RPC_C_IMP_LEVEL_IMPERSONATE,
+        NULL, EOAC_NONE, NULL
+    );
+
+    hr = CoCreateInstance(
+        &CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
+        &IID_IWbemLocator, (LPVOID*)&g_wmiPool.locator
+    );
+    if (FAILED(hr)) {
+        g_wmiPool.locator = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Find or add the slot for a namespace. Caller holds the lock exclusively.
+ */
+static PWMI_POOL_SESSION GetSlotLocked(const wchar_t* namespacePath) {
+    PWMI_POOL_SESSION slot = NULL;
+
+    for (DWORD i = 0; i < g_wmiPool.sessionCount; i++) {
+        if (_wcsicmp(g_wmiPool.sessions[i].namespacePath, namespacePath) == 0) {
+            return &g_wmiPool.sessions[i];
+        }
+    }
+
+    if (g_wmiPool.sessionCount >= WMI_POOL_MAX_SESSIONS) {
+        return NULL;
+    }
+
+    slot = &g_wmiPool.sessions[g_wmiPool.sessionCount++];
+    ZeroMemory(slot, sizeof(*slot));
+    wcsncpy_s(slot->namespacePath, sizeof(slot->namespacePath) / sizeof(wchar_t),
+              namespacePath, _TRUNCATE);
+    return slot;
+}
+
+static IWbemServices* ConnectNamespace(IWbemLocator* locator, const wchar_t* namespacePath) {
+    IWbemServices* services = NULL;
+    BSTR bstrNamespace = NULL;
+    HRESULT hr;
+
+    bstrNamespace = SysAllocString(namespacePath);
+    if (bstrNamespace == NULL) {
+        return NULL;
+    }
+
+    hr = locator->lpVtbl->ConnectServer(
+        locator, bstrNamespace, NULL, NULL, NULL, 0, NULL, NULL, &services
+    );
+    SysFreeString(bstrNamespace);
+
+    if (FAILED(hr)) {
+        return NULL;
+    }
+
+    CoSetProxyBlanket(
+        (IUnknown*)services, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL,
+        RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE
+    );
+    return services;
+}
+
+static void CompleteSlot(PWMI_POOL_SESSION slot, IWbemServices* services) {
+    AcquireSRWLockExclusive(&g_wmiPoolLock);
+    slot->services = services;
+    slot->done = TRUE;
+    ReleaseSRWLockExclusive(&g_wmiPoolLock);
+    WakeAllConditionVariable(&g_wmiPoolConnected);
+}
+
+IWbemServices* WmiPoolGetService(const wchar_t* namespacePath) {
+    PWMI_POOL_SESSION slot = NULL;
+    IWbemServices* services = NULL;
+    IWbemLocator* locator = NULL;
+
+    if (!EnsureThreadCom(NULL)) {
+        return NULL;
+    }
+
+    AcquireSRWLockExclusive(&g_wmiPoolLock);
+
+    if (!InitializePoolLocked() || (slot = GetSlotLocked(namespacePath)) == NULL) {
+        ReleaseSRWLockExclusive(&g_wmiPoolLock);
+        return NULL;
+    }
+
+    // Another thread (usually a prefetch) is connecting this namespace
+    while (slot->claimed && !slot->done) {
+        SleepConditionVariableSRW(&g_wmiPoolConnected, &g_wmiPoolLock, INFINITE, 0);
+    }
+
+    if (slot->done) {
+        services = slot->services;
+        ReleaseSRWLockExclusive(&g_wmiPoolLock);
+        return services;
+    }
+
+    slot->claimed = TRUE;
+    locator = g_wmiPool.locator;
+    ReleaseSRWLockExclusive(&g_wmiPoolLock);
+
+    services = ConnectNamespace(locator, namespacePath);
+    CompleteSlot(slot, services);
+    return services;
+}
+
+BOOL WmiPoolNamespaceExists(const wchar_t* namespacePath) {
+    return WmiPoolGetService(namespacePath) != NULL;
+}
+
+typedef struct _WMI_PREFETCH_WORK {
+    PWMI_POOL_SESSION slot;
+    IWbemLocator* locator;
+} WMI_PREFETCH_WORK;
+
+static DWORD WINAPI PrefetchWorker(LPVOID parameter) {
+    WMI_PREFETCH_WORK* work = (WMI_PREFETCH_WORK*)parameter;
+    IWbemServices* services = NULL;
+
+    if (SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED))) {
+        services = ConnectNamespace(work->locator, work->slot->namespacePath);
+        CoUninitialize();
+    }
+    CompleteSlot(work->slot, services);
+    return 0;
+}
+
+void WmiPoolPrefetch(const wchar_t* const* namespaces) {
+    WMI_PREFETCH_WORK work[WMI_POOL_MAX_SESSIONS];
+    HANDLE threads[WMI_POOL_MAX_SESSIONS];
+    DWORD threadCount = 0;
+    BOOL multithreaded = FALSE;
+
+    if (namespaces == NULL || !EnsureThreadCom(NULL)) {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&g_wmiPoolLock);
+    if (!InitializePoolLocked()) {
+        ReleaseSRWLockExclusive(&g_wmiPoolLock);
+        return;
+    }
+    multithreaded = g_wmiPool.multithreaded;
+
+    // Claim every namespace nobody has connected yet
+    for (int i = 0; namespaces[i] != NULL && threadCount < WMI_POOL_MAX_SESSIONS; i++) {
+        PWMI_POOL_SESSION slot = GetSlotLocked(namespaces[i]);
+        if (slot == NULL || slot->claimed) {
+            continue;
+        }
+        slot->claimed = TRUE;
+        work[threadCount].slot = slot;
+        work[threadCount].locator = g_wmiPool.locator;
+        threadCount++;
+    }
+    ReleaseSRWLockExclusive(&g_wmiPoolLock);
+
+    for (DWORD i = 0; i < threadCount; i++) {
+        threads[i] = multithreaded ? CreateThread(NULL, 0, PrefetchWorker, &work[i], 0, NULL) : NULL;
+        if (threads[i] == NULL) {
+            // STA caller or no thread: connect inline
+            CompleteSlot(work[i].slot, ConnectNamespace(work[i].locator, work[i].slot->namespacePath));
+        }
+    }
+
+    for (DWORD i = 0; i < threadCount; i++) {
+        if (threads[i] != NULL) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+}
+
+/*
+ * Render a property as text; empty/NULL/array values are "not present"
+ */
+static void VariantToValue(VARIANT* variant, PWMI_VALUE value) {
+    VARIANT text;
+
+    ZeroMemory(value, sizeof(*value));
+    if (variant->vt == VT_EMPTY || variant->vt == VT_NULL || (variant->vt & VT_ARRAY)) {
+        return;
+    }
+
+    VariantInit(&text);
+    if (SUCCEEDED(VariantChangeType(&text, variant, VARIANT_ALPHABOOL, VT_BSTR)) && text.bstrVal != NULL) {
+        WideCharToMultiByte(CP_UTF8, 0, text.bstrVal, -1, value->text, WMI_VALUE_LEN, NULL, NULL);
+        value->text[WMI_VALUE_LEN - 1] = '\0';
+        value->present = TRUE;
+    }
+    VariantClear(&text);
+}
+
+int WmiPoolQuery(const wchar_t* namespacePath, const wchar_t* wql,
+                 const wchar_t* const* properties, DWORD propertyCount,
+                 WMI_ROW_CALLBACK callback, void* context) {
+    IWbemServices* services = NULL;
+    IEnumWbemClassObject* enumerator = NULL;
+    IWbemClassObject* objects[WMI_POOL_BATCH_SIZE];
+    WMI_VALUE values[WMI_POOL_MAX_PROPERTIES];
+    BSTR bstrQuery = NULL;
+    BSTR bstrWQL = NULL;
+    HRESULT hr;
+    BOOL stop = FALSE;
+    int visited = 0;
+
+    if (propertyCount > WMI_POOL_MAX_PROPERTIES) {
+        return -1;
+    }
+
+    services = WmiPoolGetService(namespacePath);
+    if (services == NULL) {
+        return -1;
+    }
+
+    bstrQuery = SysAllocString(wql);
+    bstrWQL = SysAllocString(L"WQL");
+    hr = services->lpVtbl->ExecQuery(
+        services, bstrWQL, bstrQuery,
+        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+        NULL, &enumerator
+    );
+    SysFreeString(bstrQuery);
+    SysFreeString(bstrWQL);
+
+    if (FAILED(hr)) {
+        return -1;
+    }
+
+    while (!stop) {
+        ULONG returned = 0;
+
+        hr = enumerator->lpVtbl->Next(enumerator, WBEM_INFINITE, WMI_POOL_BATCH_SIZE, objects, &returned);
+        if (FAILED(hr) || returned == 0) {
+            break;
+        }
+
+        for (ULONG i = 0; i < returned; i++) {
+            if (!stop) {
+                visited++;
+                if (callback != NULL) {
+                    for (DWORD p = 0; p < propertyCount; p++) {
+                        VARIANT variant;
+                        VariantInit(&variant);
+                        ZeroMemory(&values[p], sizeof(values[p]));
+                        if (SUCCEEDED(objects[i]->lpVtbl->Get(objects[i], properties[p], 0, &variant, NULL, NULL))) {
+                            VariantToValue(&variant, &values[p]);
+                        }
+                        VariantClear(&variant);
+                    }
+                    stop = !callback(context, values, propertyCount);
+                }
+            }
+            objects[i]->lpVtbl->Release(objects[i]);
+        }
+
+        // WBEM_S_FALSE: fewer objects than requested, enumeration is finished
+        if (hr == WBEM_S_FALSE) {
+            break;
+        }
+    }
+
+    enumerator->lpVtbl->Release(enumerator);
+    return visited;
+}
+
+typedef struct _WMI_FIRST_ROW {
+    PWMI_VALUE values;
+    BOOL found;
+} WMI_FIRST_ROW;
+
+static BOOL CopyFirstRow(void* context, const WMI_VALUE* values, DWORD count) {
+    WMI_FIRST_ROW* first = (WMI_FIRST_ROW*)context;
+    memcpy(first->values, values, count * sizeof(WMI_VALUE));
+    first->found = TRUE;
+    return FALSE;
+}
+
+BOOL WmiPoolSelectFirst(const wchar_t* namespacePath, const wchar_t* className,
+                        const wchar_t* where, const wchar_t* const* properties,
+                        DWORD propertyCount, PWMI_VALUE values) {
+    wchar_t wql[1024] = L"SELECT ";
+    WMI_FIRST_ROW first = { values, FALSE };
+
+    ZeroMemory(values, propertyCount * sizeof(WMI_VALUE));
+
+    // Select only the properties the caller reads
+    for (DWORD i = 0; i < propertyCount; i++) {
+        if (i > 0) {
+            wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), L", ");
+        }
+        wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), properties[i]);
+    }
+    wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), L" FROM ");
+    wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), className);
+    if (where != NULL) {
+        wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), L" WHERE ");
+        wcscat_s(wql, sizeof(wql) / sizeof(wchar_t), where);
+    }
+
+    WmiPoolQuery(namespacePath, wql, properties, propertyCount, CopyFirstRow, &first);
+    return first.found;
+}
+
+static DWORD WINAPI SelectWorker(LPVOID parameter) {
+    PWMI_SELECT select = (PWMI_SELECT)parameter;
+
+    select->found = WmiPoolSelectFirst(select->namespacePath, select->className, select->where,
+                                       select->properties, select->propertyCount, select->values);
+
+    // WmiPoolGetService joined the MTA on this thread; leave it before the thread ends
+    if (t_comInitialized) {
+        t_comInitialized = FALSE;
+        CoUninitialize();
+    }
+    return 0;
+}
+
+void WmiPoolSelectMany(PWMI_SELECT selects, DWORD count) {
+    HANDLE threads[WMI_POOL_MAX_SESSIONS];
+    BOOL multithreaded = FALSE;
+
+    if (selects == NULL || count == 0 || !EnsureThreadCom(&multithreaded)) {
+        return;
+    }
+
+    for (DWORD start = 0; start < count; start += WMI_POOL_MAX_SESSIONS) {
+        DWORD wave = min(count - start, WMI_POOL_MAX_SESSIONS);
+
+        for (DWORD i = 0; i < wave; i++) {
+            // Sessions of an STA caller cannot be used from other threads
+            threads[i] = multithreaded ? CreateThread(NULL, 0, SelectWorker, &selects[start + i], 0, NULL) : NULL;
+            if (threads[i] == NULL) {
+                PWMI_SELECT select = &selects[start + i];
+                select->found = WmiPoolSelectFirst(select->namespacePath, select->className, select->where,
+                                                   select->properties, select->propertyCount, select->values);
+            }
+        }
+
+        for (DWORD i = 0; i < wave; i++) {
+            if (threads[i] != NULL) {
+                WaitForSingleObject(threads[i], INFINITE);
+                CloseHandle(threads[i]);
+            }
+        }
+    }
+}
+
+int WmiPoolCount(const wchar_t* namespacePath, const wchar_t* wql) {
+    return WmiPoolQuery(namespacePath, wql, NULL, 0, NULL, NULL);
+}
+
+void WmiPoolShutdown(void) {
+    AcquireSRWLockExclusive(&g_wmiPoolLock);
+
+    for (DWORD i = 0; i < g_wmiPool.sessionCount; i++) {
+        if (g_wmiPool.sessions[i].services != NULL) {
+            g_wmiPool.sessions[i].services->lpVtbl->Release(g_wmiPool.sessions[i].services);
+        }
+    }
+    if (g_wmiPool.locator != NULL) {
+        g_wmiPool.locator->lpVtbl->Release(g_wmiPool.locator);
+    }
+    ZeroMemory(&g_wmiPool, sizeof(g_wmiPool));
+
+    ReleaseSRWLockExclusive(&g_wmiPoolLock);
+
+    if (t_comInitialized) {
+        t_comInitialized = FALSE;
+        CoUninitialize();
+    }
+}
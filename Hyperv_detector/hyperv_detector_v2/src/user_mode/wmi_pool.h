@@ -0,0 +1,103 @@
+/**
+ * wmi_pool.h - Pooled WMI sessions
+ *
+ * COM is initialized once, one IWbemLocator is shared, and each namespace is
+ * connected at most once per process (failed connections are remembered as
+ * well). Queries run semi-synchronously (WBEM_FLAG_FORWARD_ONLY |
+ * WBEM_FLAG_RETURN_IMMEDIATELY) and fetch objects in batches, reading only the
+ * properties the caller asks for.
+ *
+ * WmiPoolPrefetch() connects several namespaces in parallel so their
+ * connection setup overlaps, and WmiPoolSelectMany() runs several queries
+ * at once on the shared sessions.
+ */
+
+#pragma once
+#ifndef WMI_POOL_H
+#define WMI_POOL_H
+
+#include <windows.h>
+#include <wbemidl.h>
+
+/* Objects requested per IEnumWbemClassObject::Next call */
+#define WMI_POOL_BATCH_SIZE        32
+
+#define WMI_POOL_MAX_SESSIONS      16
+#define WMI_POOL_MAX_PROPERTIES    16
+#define WMI_VALUE_LEN              256
+
+/* Well-known namespaces */
+#define WMI_NS_CIMV2               L"ROOT\\CIMV2"
+#define WMI_NS_VIRTUALIZATION_V2   L"ROOT\\virtualization\\v2"
+#define WMI_NS_VIRTUALIZATION      L"ROOT\\virtualization"
+#define WMI_NS_DEVICEGUARD         L"ROOT\\Microsoft\\Windows\\DeviceGuard"
+
+/* A property rendered as text (UTF-8). BOOLs become "True"/"False". */
+typedef struct _WMI_VALUE {
+    BOOL present;
+    char text[WMI_VALUE_LEN];
+} WMI_VALUE, *PWMI_VALUE;
+
+/*
+ * Row callback: values[i] holds properties[i] of the current object.
+ * Return FALSE to stop the enumeration.
+ */
+typedef BOOL (*WMI_ROW_CALLBACK)(void* context, const WMI_VALUE* values, DWORD count);
+
+/*
+ * Session for a namespace, connected on first use. The pool owns the
+ * reference; do not Release it. NULL if the namespace is unavailable.
+ */
+IWbemServices* WmiPoolGetService(const wchar_t* namespacePath);
+BOOL WmiPoolNamespaceExists(const wchar_t* namespacePath);
+
+/*
+ * Connect a NULL-terminated list of namespaces concurrently
+ */
+void WmiPoolPrefetch(const wchar_t* const* namespaces);
+
+/*
+ * Run a WQL query and hand each object's properties to the callback.
+ * Returns the number of objects visited, or -1 if the query failed.
+ */
+int WmiPoolQuery(const wchar_t* namespacePath, const wchar_t* wql,
+                 const wchar_t* const* properties, DWORD propertyCount,
+                 WMI_ROW_CALLBACK callback, void* context);
+
+/*
+ * "SELECT <properties> FROM <className> [WHERE <where>]" and return the first
+ * object's values. FALSE if there is no such object.
+ */
+BOOL WmiPoolSelectFirst(const wchar_t* namespacePath, const wchar_t* className,
+                        const wchar_t* where, const wchar_t* const* properties,
+                        DWORD propertyCount, PWMI_VALUE values);
+
+/* One query of WmiPoolSelectMany: the arguments of WmiPoolSelectFirst and its results */
+typedef struct _WMI_SELECT {
+    const wchar_t* namespacePath;
+    const wchar_t* className;
+    const wchar_t* where;
+    const wchar_t* const* properties;
+    DWORD propertyCount;
+    BOOL found;                                 /* Out */
+    WMI_VALUE values[WMI_POOL_MAX_PROPERTIES];  /* Out */
+} WMI_SELECT, *PWMI_SELECT;
+
+/*
+ * Run WmiPoolSelectFirst for every entry concurrently, one worker thread per
+ * query (at most WMI_POOL_MAX_SESSIONS at a time), and wait for all of them.
+ * From an STA caller the queries run one after another on the calling thread.
+ */
+void WmiPoolSelectMany(PWMI_SELECT selects, DWORD count);
+
+/*
+ * Number of objects a query returns (-1 on failure)
+ */
+int WmiPoolCount(const wchar_t* namespacePath, const wchar_t* wql);
+
+/*
+ * Release all sessions and COM (end of process)
+ */
+void WmiPoolShutdown(void);
+
+#endif /* WMI_POOL_H */
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""
+hvresult.py - Decoder for binary detection results (src/common/result_codec.h)
+
+Reads a stream of records written by `hyperv_detector --binary <file>` and
+prints one JSON object per record, with the field names of the --json output:
+
+    python3 hvresult.py results.bin > results.ndjson
+    python3 hvresult.py --summary results.bin
+
+As a module, iter_records(data) yields one dict per record. Records of an
+unknown version are skipped using their length; corrupt data stops the
+stream with ValueError.
+"""
+
+import argparse
+import json
+import sys
+
+MAGIC = b"HR"
+VERSION = 1
+HEADER_SIZE = 4
+HAS_TIMINGS = 0x01
+
+TYPE_UINT = 0
+TYPE_STRING = 1
+TYPE_FALSE = 2
+TYPE_TRUE = 3
+
+KEY_NAMED = 64
+KEY_NAMES = {
+    1: "tool_version",
+    2: "host",
+    3: "process_id",
+    4: "process_name",
+    5: "verdict",
+    6: "hv_build",
+    7: "vbs",
+    8: "hvci",
+    9: "level",
+}
+
+# HYPERV_DETECTED_* bits, named as GetDetectionFlagName() in main_new.c
+METHOD_NAMES = {
+    0x00000001: "CPUID",
+    0x00000002: "Registry",
+    0x00000004: "Files",
+    0x00000008: "Services",
+    0x00000010: "Devices",
+    0x00000020: "BIOS",
+    0x00000040: "Processes",
+    0x00000080: "Hypercalls",
+    0x00000100: "Windows Objects",
+    0x00000200: "Nested Virtualization",
+    0x00000400: "Windows Sandbox",
+    0x00000800: "Docker",
+    0x00001000: "Removed Hyper-V",
+    0x00002000: "WMI",
+    0x00004000: "MAC Address",
+    0x00008000: "Firmware/SMBIOS",
+    0x00010000: "Timing Analysis",
+    0x00020000: "Performance Counters",
+    0x00040000: "Event Logs",
+    0x00080000: "Security Features",
+    0x00100000: "Descriptor Tables",
+    0x00200000: "Windows Features",
+    0x00400000: "Storage",
+}
+
+LEVEL_NAMES = ["fast", "normal", "thorough", "full"]
+
+
+def _varint(data, pos, end):
+    result = 0
+    shift = 0
+    while pos < end and shift < 64:
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            if result >> 64:
+                break
+            return result, pos
+        shift += 7
+    raise ValueError("bad varint at offset %d" % pos)
+
+
+def _text(raw):
+    return bytes(raw).decode("utf-8", "replace")
+
+
+def _string(strings, index, pos):
+    if index >= len(strings):
+        raise ValueError("string index %d out of range at offset %d" % (index, pos))
+    return strings[index]
+
+
+def decode_record(data, pos=0):
+    """Decode the record at data[pos:]; returns (dict or None, next position).
+
+    None means a record of another version that was skipped.
+    """
+    if len(data) - pos < HEADER_SIZE + 1:
+        raise ValueError("truncated header at offset %d" % pos)
+    if bytes(data[pos:pos + 2]) != MAGIC:
+        raise ValueError("bad magic at offset %d" % pos)
+    version = data[pos + 2]
+    header_flags = data[pos + 3]
+    body, body_pos = _varint(data, pos + HEADER_SIZE, len(data))
+    end = body_pos + body
+    if end > len(data):
+        raise ValueError("truncated record at offset %d" % pos)
+    if version != VERSION:
+        return None, end
+
+    flags, p = _varint(data, body_pos, end)
+    count, p = _varint(data, p, end)
+    strings = []
+    for _ in range(count):
+        length, p = _varint(data, p, end)
+        if p + length > end:
+            raise ValueError("string past record end at offset %d" % p)
+        strings.append(_text(data[p:p + length]))
+        p += length
+
+    record = {
+        "detected": flags != 0,
+        "flags": "0x%08X" % flags,
+        "flags_decimal": flags,
+        "detection_methods": [name for bit, name in sorted(METHOD_NAMES.items()) if flags & bit],
+    }
+    findings = []
+    count, p = _varint(data, p, end)
+    for _ in range(count):
+        field_pos = p
+        tag, p = _varint(data, p, end)
+        key, kind = tag >> 3, tag & 7
+        if kind in (TYPE_UINT, TYPE_STRING):
+            value, p = _varint(data, p, end)
+            if kind == TYPE_STRING:
+                value = _string(strings, value, field_pos)
+        elif kind in (TYPE_FALSE, TYPE_TRUE):
+            value = kind == TYPE_TRUE
+        else:
+            raise ValueError("unknown field type %d" % kind)
+
+        if key >= KEY_NAMED:
+            findings.append({"method": _string(strings, key - KEY_NAMED, field_pos), "text": value})
+        elif key == 1:
+            record["version"] = "%d.%d.%d" % (value >> 16, (value >> 8) & 0xFF, value & 0xFF)
+        elif key == 9 and value < len(LEVEL_NAMES):
+            record["level"] = LEVEL_NAMES[value]
+        else:
+            record[KEY_NAMES.get(key, "key_%d" % key)] = value
+    if findings:
+        record["findings"] = findings
+
+    if header_flags & HAS_TIMINGS:
+        timings = {}
+        count, p = _varint(data, p, end)
+        for _ in range(count):
+            timing_pos = p
+            name, p = _varint(data, p, end)
+            microseconds, p = _varint(data, p, end)
+            timings[_string(strings, name, timing_pos)] = microseconds
+        record["timings_us"] = timings
+    return record, end
+
+
+def iter_records(data):
+    """Yield every record of a concatenated stream."""
+    view = memoryview(data)
+    pos = 0
+    while pos < len(view):
+        record, pos = decode_record(view, pos)
+        if record is not None:
+            yield record
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode binary hyperv_detector results")
+    parser.add_argument("files", nargs="+", help="Files written with --binary")
+    parser.add_argument("--summary", action="store_true",
+                        help="Print record count and method totals instead of records")
+    args = parser.parse_args()
+
+    records = 0
+    methods = {}
+    for path in args.files:
+        with open(path, "rb") as f:
+            data = f.read()
+        try:
+            for record in iter_records(data):
+                records += 1
+                if args.summary:
+                    for name in record["detection_methods"]:
+                        methods[name] = methods.get(name, 0) + 1
+                else:
+                    sys.stdout.write(json.dumps(record) + "\n")
+        except ValueError as e:
+            sys.stderr.write("%s: %s\n" % (path, e))
+            return 2
+
+    if args.summary:
+        print("%d record(s)" % records)
+        for name, count in sorted(methods.items(), key=lambda item: -item[1]):
+            print("  %-24s %d" % (name, count))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,122 @@
+#
+#  Tests for hvresult.py
+#
+#  python3 -m unittest discover -s tools -v
+#
+#  results/record_v1.bin under src/tests/fixtures is written by the C encoder
+#  (result_codec.h); the portable tests check that the encoder still
+#  produces it byte for byte.
+#
+
+import os
+import sys
+import unittest
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, TOOLS)
+
+import hvresult
+
+GOLDEN = os.path.join(TOOLS, "..", "src", "tests", "fixtures", "results", "record_v1.bin")
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def encode(flags, strings, fields, timings=None, version=hvresult.VERSION):
+    """Record in the result_codec.h layout; fields are (key, type, value or None)."""
+    body = varint(flags) + varint(len(strings))
+    for text in strings:
+        body += varint(len(text)) + text
+    body += varint(len(fields))
+    for key, kind, value in fields:
+        body += varint(key << 3 | kind) + (varint(value) if value is not None else b"")
+    if timings is not None:
+        body += varint(len(timings))
+        for name, microseconds in timings:
+            body += varint(name) + varint(microseconds)
+    header_flags = hvresult.HAS_TIMINGS if timings is not None else 0
+    return hvresult.MAGIC + bytes([version, header_flags]) + varint(len(body)) + body
+
+
+class GoldenRecordTest(unittest.TestCase):
+
+    def setUp(self):
+        with open(GOLDEN, "rb") as f:
+            self.data = f.read()
+
+    def test_decode_c_record(self):
+        records = list(hvresult.iter_records(self.data))
+        self.assertEqual(len(records), 1)
+        record = records[0]
+        self.assertEqual(record["flags"], "0x00400207")
+        self.assertEqual(record["detection_methods"],
+                         ["CPUID", "Registry", "Files", "Nested Virtualization", "Storage"])
+        self.assertEqual(record["version"], "2.0.0")
+        self.assertEqual(record["host"], "HV-GUEST-01")
+        self.assertEqual(record["process_id"], 300000)
+        self.assertIs(record["vbs"], True)
+        self.assertIs(record["hvci"], False)
+        self.assertEqual(record["findings"], [{"method": "Registry", "text": "Found key A"},
+                                              {"method": "Registry", "text": "Found key B"}])
+        self.assertEqual(record["timings_us"], {"cpuid": 12, "registry": 1 << 20})
+
+    def test_python_encoding_matches_c(self):
+        strings = [b"HV-GUEST-01", b"Registry", b"Found key A", b"Found key B", b"cpuid", b"registry"]
+        fields = [(1, hvresult.TYPE_UINT, 0x020000), (2, hvresult.TYPE_STRING, 0),
+                  (3, hvresult.TYPE_UINT, 300000), (7, hvresult.TYPE_TRUE, None),
+                  (8, hvresult.TYPE_FALSE, None), (hvresult.KEY_NAMED + 1, hvresult.TYPE_STRING, 2),
+                  (hvresult.KEY_NAMED + 1, hvresult.TYPE_STRING, 3)]
+        self.assertEqual(encode(0x00400207, strings, fields, [(4, 12), (5, 1 << 20)]), self.data)
+
+    def test_stream_skips_other_versions(self):
+        other = encode(1, [], [], version=hvresult.VERSION + 1)
+        records = list(hvresult.iter_records(self.data + other + self.data))
+        self.assertEqual(len(records), 2)
+        self.assertEqual(records[0], records[1])
+
+
+class CorruptRecordTest(unittest.TestCase):
+
+    def assertRejected(self, data):
+        with self.assertRaises(ValueError):
+            list(hvresult.iter_records(data))
+
+    def test_truncated(self):
+        with open(GOLDEN, "rb") as f:
+            data = f.read()
+        for length in range(1, len(data)):
+            self.assertRejected(data[:length])
+
+    def test_bad_magic(self):
+        self.assertRejected(b"XR" + encode(0, [], [])[2:])
+
+    def test_string_value_out_of_range(self):
+        self.assertRejected(encode(1, [b"host"], [(2, hvresult.TYPE_STRING, 1)]))
+
+    def test_named_key_out_of_range(self):
+        self.assertRejected(encode(1, [b"text"], [(hvresult.KEY_NAMED + 1, hvresult.TYPE_STRING, 0)]))
+
+    def test_timing_name_out_of_range(self):
+        self.assertRejected(encode(1, [b"cpuid"], [], [(1, 12)]))
+
+    def test_unknown_field_type(self):
+        self.assertRejected(encode(1, [], [(1, 5, None)]))
+
+    def test_string_past_record_end(self):
+        data = bytearray(encode(1, [b"host"], []))
+        data[7] = 0x7F
+        self.assertRejected(bytes(data))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,260 @@
+#
+#  Block cache for hvlib physical memory reads
+#  GPL3 License
+#
+#  Volatility scanners issue millions of small reads against the same pages;
+#  every one of them is a ctypes call and a driver round trip. BlockCache
+#  keeps aligned blocks of guest physical memory in memory and reads ahead
+#  when the misses follow a stride.
+#
+
+import threading
+from collections import OrderedDict
+from concurrent.futures import ThreadPoolExecutor
+
+MIN_BLOCK_SIZE = 0x1000
+MAX_BLOCK_SIZE = 0x200000
+
+# Misses further apart than this many blocks are jumps, not a scan
+MAX_STRIDE = 16
+
+
+class BlockCache:
+    """Sharded LRU cache of aligned memory blocks with stride read-ahead.
+
+    read_block(offset, size) returns the block as bytes, or None if it cannot
+    be read in full. read() then returns None and the caller reads the range
+    directly, so a block that straddles unbacked memory never hides a smaller
+    read that would have succeeded.
+
+    Blocks are spread over shards by block number, each shard with its own
+    lock and LRU order. When two misses in a row have the same stride, the
+    next `readahead` blocks along it are fetched on a background thread.
+    Calls to read_block are serialized with `lock`, which the owner shares
+    with its own uncached calls into the driver.
+    """
+
+    def __init__(self, read_block, block_size=0x10000, capacity=256 * 0x100000, shards=16,
+                 readahead=4, limit=None, lock=None):
+
+        if block_size & (block_size - 1) or not MIN_BLOCK_SIZE <= block_size <= MAX_BLOCK_SIZE:
+            raise ValueError(f"Block size must be a power of two from 4 KB to 2 MB: 0x{block_size:X}")
+
+        self.block_size = block_size
+        self._read_block = read_block
+        self._shift = block_size.bit_length() - 1
+        self._limit = limit
+        self._io_lock = lock if lock is not None else threading.Lock()
+
+        self._shards = [OrderedDict() for _ in range(shards)]
+        self._shard_locks = [threading.Lock() for _ in range(shards)]
+        self._shard_capacity = max(1, capacity // block_size // shards)
+        self._generation = 0
+
+        self._readahead = readahead
+        self._executor = None
+        self._pending = {}
+        self._pending_lock = threading.Lock()
+        self._prefetched = set()
+        self._last_block = None
+        self._stride = 0
+
+        self.hits = 0
+        self.misses = 0
+        self.evictions = 0
+        self.readahead_issued = 0
+        self.readahead_hits = 0
+
+    def read(self, offset, length):
+        """Bytes at [offset, offset + length), or None if a block is unreadable."""
+
+        if length <= 0 or (self._limit is not None and offset + length > self._limit):
+            return None
+
+        first = offset >> self._shift
+        last = (offset + length - 1) >> self._shift
+        start = offset - (first << self._shift)
+
+        if first == last:
+            block = self._get(first)
+            return None if block is None else block[start:start + length]
+
+        parts = []
+        for number in range(first, last + 1):
+            block = self._get(number)
+            if block is None:
+                return None
+            parts.append(memoryview(block))
+        parts[0] = parts[0][start:]
+        parts[-1] = parts[-1][:(offset + length) - (last << self._shift)]
+        return b"".join(parts)
+
+    def missing(self, ranges):
+        """Sorted (offset, size) of the blocks the (offset, length) ranges need
+        that are not cached, sizes clipped to the limit."""
+
+        shift = self._shift
+        shards = self._shards
+        count = len(shards)
+        numbers = set()
+        for offset, length in ranges:
+            for number in range(offset >> shift, ((offset + length - 1) >> shift) + 1):
+                if number not in shards[number % count]:
+                    numbers.add(number)
+
+        result = []
+        for number in sorted(numbers):
+            start = number << shift
+            size = self.block_size if self._limit is None else min(self.block_size, self._limit - start)
+            result.append((start, size))
+        return result
+
+    def insert(self, offset, block):
+        """Add a block read elsewhere (e.g. by a batched read); offset must be block aligned."""
+
+        self.misses += 1
+        self._insert(offset >> self._shift, bytes(block), False)
+
+    def invalidate(self, offset, length):
+        """Drop the blocks overlapping a range, e.g. after a write."""
+
+        self._generation += 1
+        for number in range(offset >> self._shift, ((offset + length - 1) >> self._shift) + 1):
+            shard = number % len(self._shards)
+            with self._shard_locks[shard]:
+                self._shards[shard].pop(number, None)
+
+    def stats(self):
+        blocks = sum(len(shard) for shard in self._shards)
+        lookups = self.hits + self.misses
+        return {
+            "hits": self.hits,
+            "misses": self.misses,
+            "hit_rate": self.hits / lookups if lookups else 0.0,
+            "evictions": self.evictions,
+            "readahead_issued": self.readahead_issued,
+            "readahead_hits": self.readahead_hits,
+            "blocks": blocks,
+            "bytes": blocks * self.block_size,
+        }
+
+    def close(self):
+        if self._executor is not None:
+            self._executor.shutdown(wait=True, cancel_futures=True)
+            self._executor = None
+
+    def _get(self, number):
+
+        shard = number % len(self._shards)
+        with self._shard_locks[shard]:
+            block = self._shards[shard].get(number)
+            if block is not None:
+                self._shards[shard].move_to_end(number)
+                prefetched = number in self._prefetched
+                self._prefetched.discard(number)
+        if block is not None:
+            self.hits += 1
+            if prefetched:
+                self.readahead_hits += 1
+                self._follow_stride(number)
+            return block
+
+        with self._pending_lock:
+            future = self._pending.get(number)
+        if future is not None:
+            block = future.result()
+            if block is not None:
+                self.hits += 1
+                self.readahead_hits += 1
+                self._prefetched.discard(number)
+                self._follow_stride(number)
+                return block
+
+        self.misses += 1
+        self._follow_stride(number)
+        return self._fetch(number)
+
+    def _fetch(self, number, prefetch=False):
+
+        offset = number << self._shift
+        size = self.block_size
+        if self._limit is not None:
+            size = min(size, self._limit - offset)
+
+        generation = self._generation
+        with self._io_lock:
+            block = self._read_block(offset, size)
+        if block is None or len(block) < size:
+            return None
+
+        # A write during the read may have made the block stale
+        if generation != self._generation:
+            return None if prefetch else block
+        self._insert(number, block, prefetch)
+        return block
+
+    def _insert(self, number, block, prefetched):
+
+        shard = number % len(self._shards)
+        with self._shard_locks[shard]:
+            blocks = self._shards[shard]
+            if prefetched:
+                self._prefetched.add(number)
+            blocks[number] = block
+            blocks.move_to_end(number)
+            while len(blocks) > self._shard_capacity:
+                evicted, _ = blocks.popitem(last=False)
+                self._prefetched.discard(evicted)
+                self.evictions += 1
+
+    def _cached(self, number):
+
+        shard = number % len(self._shards)
+        with self._shard_locks[shard]:
+            return number in self._shards[shard]
+
+    def _follow_stride(self, number):
+        """Track the distance between consecutive misses (and read-ahead hits)
+        and read ahead along it once it repeats."""
+
+        if not self._readahead:
+            return
+
+        last = self._last_block
+        self._last_block = number
+        if last is None:
+            return
+
+        stride = number - last
+        if stride == 0 or abs(stride) > MAX_STRIDE:
+            self._stride = 0
+            return
+        if stride != self._stride:
+            self._stride = stride
+            return
+
+        with self._pending_lock:
+            if self._executor is None:
+                self._executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="hv-readahead")
+
+        for step in range(1, self._readahead + 1):
+            ahead = number + stride * step
+            if ahead < 0 or (self._limit is not None and (ahead << self._shift) >= self._limit):
+                break
+            if self._cached(ahead):
+                continue
+            with self._pending_lock:
+                if ahead in self._pending:
+                    continue
+                self._pending[ahead] = self._executor.submit(self._prefetch, ahead)
+            self.readahead_issued += 1
+
+    def _prefetch(self, number):
+
+        try:
+            return self._fetch(number, prefetch=True)
+        except Exception:
+            return None
+        finally:
+            with self._pending_lock:
+                self._pending.pop(number, None)
@@ -0,0 +1,52 @@
+#
+#  Reusable page-aligned read buffers for hvlib
+#  GPL3 License
+#
+#  hvlib.ReadPhysicalInto fills a buffer the caller owns. BufferPool keeps
+#  those buffers between reads: ctypes arrays over anonymous mmaps (page
+#  aligned, as the driver prefers) in power of two size classes, so a read
+#  of any size up to max_size takes a buffer from a free list instead of
+#  allocating and zeroing a new one.
+#
+
+import ctypes
+import mmap
+
+PAGE_SIZE = 0x1000
+
+
+class BufferPool:
+    """Free lists of page-aligned c_char arrays in power of two sizes.
+
+    acquire(size) returns an array of at least `size` bytes; pass it and the
+    size to ReadPhysicalInto, take the data with buffer[:size] (bytes) and
+    give the array back with release(). Arrays larger than max_size are made
+    for the call and not kept. The free lists are plain lists (pop and append
+    are atomic), so threads can share a pool; each size class keeps at most
+    `keep` arrays.
+    """
+
+    def __init__(self, max_size=0x200000, keep=8):
+
+        self.max_size = max_size
+        self._keep = keep
+        self._free = {}
+        self.allocated = 0
+
+    def acquire(self, size):
+
+        size_class = max(PAGE_SIZE, 1 << (size - 1).bit_length())
+        try:
+            return self._free[size_class].pop()
+        except (KeyError, IndexError):
+            self.allocated += 1
+            return (ctypes.c_char * size_class).from_buffer(mmap.mmap(-1, size_class))
+
+    def release(self, buffer):
+
+        size_class = len(buffer)
+        if size_class > self.max_size:
+            return
+        free = self._free.setdefault(size_class, [])
+        if len(free) < self._keep:
+            free.append(buffer)
@@ -0,0 +1,434 @@
+#
+#  Full physical memory acquisition of a Hyper-V VM through hvlib
+#  GPL3 License
+#
+#  hvdump streams the guest physical memory of a partition to a file:
+#
+#      python -m hvlib.hvdump <VM GUID or index> memory.dmp --format dmp
+#      python -m hvlib.hvdump <VM GUID or index> memory.raw --threads 8 --compress
+#      python -m hvlib.hvdump --image vm.elf 0 memory.raw      (hvfile, any OS)
+#      python -m hvlib.hvdump expand memory.raw.hvdz memory.raw
+#
+#  The memory runs (hvlib.GetMemoryRuns) are cut into chunks that reader
+#  threads fetch with ReadPhysicalInto (ctypes releases the GIL in the driver
+#  call), while the main thread writes them in run order. A chunk that fails
+#  is read again page by page and unreadable pages are left zero. All-zero
+#  pages are not written: the file is extended over them (sparse where the
+#  file system allows).
+#
+#  Formats (the layout of the output file):
+#
+#      raw       the runs back to back
+#      padded    file offset = physical address, gaps zero
+#      dmp       64-bit full crash dump (PAGEDU64): header and the runs,
+#                readable by volatility, WinDbg and hvfile
+#
+#  --compress stores the chosen layout as an .hvdz container instead:
+#
+#      header   "HVDZ", u16 version, u16 codec (1 - zlib), u64 size of the layout
+#      block    u64 offset in the layout, u32 size, u32 stored size, data
+#               (stored size == size: not compressed)
+#
+#  and `expand` turns it back into the layout. Blocks are non-zero page spans,
+#  so zero pages cost nothing there either.
+#
+#  While running, <output>.checkpoint holds the position reached (JSON);
+#  --resume continues from it after an interruption and removes it at the end.
+#
+
+import argparse
+import contextlib
+import ctypes
+import json
+import os
+import struct
+import sys
+import threading
+import time
+import zlib
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+
+from .bufferpool import BufferPool
+from .hvlib import hvlib, HvmmInformationClass
+
+PAGE_SIZE = 0x1000
+ZERO_PAGE = bytes(PAGE_SIZE)
+
+FORMATS = ("raw", "padded", "dmp")
+
+# DUMP_HEADER64 of a full dump: 0x2000 bytes, unused fields filled with "PAGE"
+DMP_HEADER_SIZE = 0x2000
+DMP_CONTEXT_RECORD = 0x348
+# PhysicalMemoryBlockBuffer is 700 (decimal) bytes at 0x88, up to ContextRecord at 0x348:
+# the 0x10-byte descriptor header, then one 0x10-byte run each
+DMP_MAX_RUNS = (700 - 0x10) // 0x10
+DMP_TYPE_FULL = 1
+IMAGE_FILE_MACHINE_AMD64 = 0x8664
+
+HVDZ_MAGIC = b"HVDZ"
+HVDZ_VERSION = 1
+HVDZ_ZLIB = 1
+HVDZ_HEADER = struct.Struct("<4sHHQ")
+HVDZ_BLOCK = struct.Struct("<QII")
+
+CHECKPOINT_VERSION = 1
+
+
+def _merge_runs(runs, limit):
+    """Merge the runs across their smallest gaps until at most `limit` are left (dmp header)."""
+
+    runs = [list(run) for run in runs]
+    while len(runs) > limit:
+        index = min(range(len(runs) - 1), key=lambda i: runs[i + 1][0] - runs[i][0] - runs[i][1])
+        runs[index][1] = runs[index + 1][0] + runs[index + 1][1] - runs[index][0]
+        del runs[index + 1]
+    return [tuple(run) for run in runs]
+
+
+def dmp_header(lib, vm_handle, runs, size):
+    """DUMP_HEADER64 of a full dump with `runs` (address, size) and the kernel data hvlib knows."""
+
+    header = bytearray(b"PAGE" * (DMP_HEADER_SIZE // 4))
+
+    def info(info_class):
+        return lib.GetData(vm_handle, info_class) or 0
+
+    header[0x04:0x08] = b"DU64"
+    struct.pack_into("<II", header, 0x08, 0xF, info(HvmmInformationClass.InfoNtBuildNumber) & 0xFFFF)
+    struct.pack_into("<QQQQ", header, 0x10,
+                     info(HvmmInformationClass.InfoDirectoryTableBase),
+                     info(HvmmInformationClass.InfoMmPfnDatabase),
+                     info(HvmmInformationClass.InfoPsLoadedModuleList),
+                     info(HvmmInformationClass.InfoPsActiveProcessHead))
+    struct.pack_into("<III", header, 0x30, IMAGE_FILE_MACHINE_AMD64,
+                     info(HvmmInformationClass.InfoNumberOfCPU) or 1, 0)
+    struct.pack_into("<QQQQ", header, 0x40, 0, 0, 0, 0)
+
+    # _PHYSICAL_MEMORY_DESCRIPTOR: NumberOfRuns, NumberOfPages, Run[] (BasePage, PageCount)
+    if len(runs) > DMP_MAX_RUNS:
+        raise ValueError(f"{len(runs)} runs, a dump header holds {DMP_MAX_RUNS}")
+    struct.pack_into("<IIQ", header, 0x88, len(runs), 0, sum(length for _, length in runs) // PAGE_SIZE)
+    for index, (address, length) in enumerate(runs):
+        struct.pack_into("<QQ", header, 0x98 + index * 0x10, address // PAGE_SIZE, length // PAGE_SIZE)
+
+    struct.pack_into("<I", header, 0xF98, DMP_TYPE_FULL)
+    struct.pack_into("<Q", header, 0xFA0, size)
+    return bytes(header)
+
+
+def plan(runs, layout, chunk_size):
+    """Chunks (physical address, size, layout offset) in run order, and the layout size."""
+
+    chunks = []
+    position = DMP_HEADER_SIZE if layout == "dmp" else 0
+    for address, length in runs:
+        if layout == "padded":
+            position = address
+        for offset in range(0, length, chunk_size):
+            chunks.append((address + offset, min(chunk_size, length - offset), position + offset))
+        position += length
+    return chunks, position
+
+
+def read_chunk(lib, vm_handle, buffers, address, size):
+    """(data, unreadable pages) of one chunk. A failed read is retried page by page, the
+    pages that still fail are zero. buffers is a BufferPool shared by the reader threads."""
+
+    buffer = buffers.acquire(size)
+    try:
+        failed = 0
+        if not lib.ReadPhysicalInto(vm_handle, address, buffer, size):
+            for offset in range(0, size, PAGE_SIZE):
+                page = (ctypes.c_char * PAGE_SIZE).from_buffer(buffer, offset)
+                if not lib.ReadPhysicalInto(vm_handle, address + offset, page, PAGE_SIZE):
+                    ctypes.memset(page, 0, PAGE_SIZE)
+                    failed += 1
+        return buffer[:size], failed
+    finally:
+        buffers.release(buffer)
+
+
+def read_chunks(chunks, work, threads=4):
+    """Yield work(chunk) for every chunk, in order, with `work` running on reader threads.
+
+    Twice as many chunks are in flight as there are readers: the consumer never waits on
+    one slow chunk while the readers are idle, and memory stays bounded.
+    """
+
+    pending = deque()
+    todo = iter(chunks)
+    with ThreadPoolExecutor(max_workers=max(1, threads), thread_name_prefix="hvdump") as pool:
+        try:
+            for chunk in todo:
+                pending.append(pool.submit(work, chunk))
+                if len(pending) >= threads * 2:
+                    break
+            while pending:
+                result = pending.popleft().result()
+                chunk = next(todo, None)
+                if chunk is not None:
+                    pending.append(pool.submit(work, chunk))
+                yield result
+        finally:
+            for future in pending:
+                future.cancel()
+
+
+class Dump:
+    """One acquisition: the plan, the reader threads and the output file.
+
+    lib is an hvlib (or hvfile) instance and vm_handle a selected partition.
+    run() may be called once; stats holds the counters afterwards.
+    """
+
+    def __init__(self, lib, vm_handle, path, layout="raw", threads=4, chunk_size=0x200000,
+                 compress=False, resume=False, checkpoint_interval=5.0, progress=None):
+
+        if layout not in FORMATS:
+            raise ValueError(f"Unknown format {layout}, one of {', '.join(FORMATS)}")
+        if chunk_size % PAGE_SIZE:
+            raise ValueError("Chunk size must be a multiple of the page size")
+
+        self.lib = lib
+        self.vm_handle = vm_handle
+        self.path = path
+        self.layout = layout
+        self.threads = max(1, threads)
+        self.chunk_size = chunk_size
+        self.compress = compress
+        self.checkpoint_path = path + ".checkpoint"
+        self.checkpoint_interval = checkpoint_interval
+        self.progress = progress
+
+        runs = lib.GetMemoryRuns(vm_handle) if hasattr(lib, "GetMemoryRuns") else None
+        if not runs:
+            runs = [(0, lib.GetData(vm_handle, HvmmInformationClass.InfoMmMaximumPhysicalPage) * PAGE_SIZE)]
+        if layout == "dmp":
+            runs = _merge_runs(runs, DMP_MAX_RUNS)
+        self.runs = runs
+        self.guid = str(lib.GetData(vm_handle, HvmmInformationClass.InfoVmGuidString)).lower()
+        self.chunks, self.size = plan(runs, layout, chunk_size)
+
+        self.stats = {"bytes": 0, "written": 0, "zero_pages": 0, "failed_pages": 0, "seconds": 0.0}
+        self._stats_lock = threading.Lock()
+        self._buffers = BufferPool(max_size=chunk_size, keep=self.threads * 2)
+
+        self.next = 0
+        self.length = HVDZ_HEADER.size if compress else 0
+        if resume:
+            self._load_checkpoint()
+
+    def _identity(self):
+        return {"version": CHECKPOINT_VERSION, "guid": self.guid, "format": self.layout,
+                "compress": self.compress, "chunk_size": self.chunk_size, "runs": self.runs}
+
+    def _load_checkpoint(self):
+
+        try:
+            with open(self.checkpoint_path) as f:
+                state = json.load(f)
+        except FileNotFoundError:
+            return
+        state["runs"] = [tuple(run) for run in state["runs"]]
+        if {key: state.get(key) for key in self._identity()} != self._identity():
+            raise ValueError(f"{self.checkpoint_path} belongs to another acquisition (VM, format or runs differ)")
+        self.next = state["next"]
+        self.length = state["length"]
+
+    def _save_checkpoint(self, out):
+
+        out.flush()
+        os.fsync(out.fileno())
+        state = dict(self._identity(), next=self.next, length=self.length)
+        temporary = self.checkpoint_path + ".tmp"
+        with open(temporary, "w") as f:
+            json.dump(state, f)
+        os.replace(temporary, self.checkpoint_path)
+
+    def _read(self, chunk):
+        """Reader thread: the layout offset and the encoded non-zero page spans of a chunk."""
+
+        address, size, position = chunk
+        data, failed = read_chunk(self.lib, self.vm_handle, self._buffers, address, size)
+
+        spans = []
+        zero = 0
+        start = None
+        for offset in range(0, size, PAGE_SIZE):
+            if data.startswith(ZERO_PAGE, offset):
+                zero += 1
+                if start is not None:
+                    spans.append((start, data[start:offset]))
+                    start = None
+            elif start is None:
+                start = offset
+        if start is not None:
+            spans.append((start, data[start:] if start else data))
+
+        spans = self._encode(spans)
+        with self._stats_lock:
+            self.stats["bytes"] += size
+            self.stats["zero_pages"] += zero
+            self.stats["failed_pages"] += failed
+        return position, spans
+
+    def _encode(self, spans):
+        """(offset, size, stored data): zlib level 1 (it releases the GIL too) when compressing,
+        incompressible spans are stored as they are."""
+
+        encoded = []
+        for offset, span in spans:
+            stored = zlib.compress(span, 1) if self.compress else span
+            encoded.append((offset, len(span), stored if len(stored) < len(span) else span))
+        return encoded
+
+    def _write(self, out, position, spans):
+
+        if self.compress:
+            records = bytearray()
+            for offset, size, stored in spans:
+                records += HVDZ_BLOCK.pack(position + offset, size, len(stored))
+                records += stored
+            out.seek(self.length)
+            out.write(records)
+            self.length += len(records)
+            self.stats["written"] += len(records)
+        else:
+            for offset, _, span in spans:
+                out.seek(position + offset)
+                out.write(span)
+                self.stats["written"] += len(span)
+
+    def run(self):
+
+        start = time.perf_counter()
+        if self.next and not os.path.exists(self.path):
+            raise FileNotFoundError(f"{self.path} is gone, cannot resume from {self.checkpoint_path}")
+        with open(self.path, "r+b" if self.next else "w+b") as out:
+            if self.compress:
+                if not self.next:
+                    out.write(HVDZ_HEADER.pack(HVDZ_MAGIC, HVDZ_VERSION, HVDZ_ZLIB, self.size))
+                # Blocks past the checkpoint may be half written
+                out.truncate(self.length)
+            if self.layout == "dmp" and not self.next:
+                self._write(out, 0, self._encode([(0, dmp_header(self.lib, self.vm_handle, self.runs, self.size))]))
+            self._save_checkpoint(out)
+
+            saved = time.monotonic()
+            try:
+                with contextlib.closing(read_chunks(self.chunks[self.next:], self._read, self.threads)) as chunks:
+                    for position, spans in chunks:
+                        self._write(out, position, spans)
+                        self.next += 1
+                        if self.progress is not None:
+                            self.progress(self.next, len(self.chunks))
+                        if time.monotonic() - saved >= self.checkpoint_interval:
+                            self._save_checkpoint(out)
+                            saved = time.monotonic()
+            except BaseException:
+                self._save_checkpoint(out)
+                raise
+
+            if self.compress:
+                out.truncate(self.length)
+            else:
+                out.truncate(self.size)
+
+        os.remove(self.checkpoint_path)
+        self.stats["seconds"] = time.perf_counter() - start
+        return self.stats
+
+
+def expand(path, out_path):
+    """Write the layout stored in an .hvdz container to out_path."""
+
+    with open(path, "rb") as f, open(out_path, "wb") as out:
+        magic, version, codec, size = HVDZ_HEADER.unpack(f.read(HVDZ_HEADER.size))
+        if magic != HVDZ_MAGIC or version != HVDZ_VERSION or codec != HVDZ_ZLIB:
+            raise ValueError(f"{path}: not a version {HVDZ_VERSION} hvdump container")
+        while True:
+            record = f.read(HVDZ_BLOCK.size)
+            if len(record) < HVDZ_BLOCK.size:
+                break
+            offset, length, stored = HVDZ_BLOCK.unpack(record)
+            data = f.read(stored)
+            out.seek(offset)
+            out.write(data if stored == length else zlib.decompress(data))
+        out.truncate(size)
+
+
+def open_vm(vm, images=None, latency=0.0):
+    """(hvlib, partition handle) of a VM given by GUID or by its index in the list; with
+    images, of a memory image served by hvfile. The caller calls cleanup() on the hvlib."""
+
+    if images:
+        from .hvfile import hvfile
+        lib = hvfile(images, latency=latency)
+    else:
+        lib = hvlib("")
+    lib.EnumPartitions(lib.vm_ops)
+
+    guids = [str(lib.GetData(partition, HvmmInformationClass.InfoVmGuidString)).lower()
+             for partition in lib.PartitionArray]
+    if vm.lower() in guids:
+        return lib, lib.SelectPartition(guids.index(vm.lower()))
+    if vm.isdigit() and int(vm) < len(guids):
+        return lib, lib.SelectPartition(int(vm))
+    lib.cleanup()
+    raise SystemExit(f"VM {vm} is not running")
+
+
+def progress_printer():
+    """progress(done, total) callback printing a percentage to stderr about once a second."""
+
+    last = [0.0]
+
+    def progress(done, total):
+        now = time.monotonic()
+        if now - last[0] >= 1 or done == total:
+            last[0] = now
+            print(f"\r{done * 100 // total}% ({done}/{total} chunks)", end="", file=sys.stderr, flush=True)
+
+    return progress
+
+
+def main(argv=None):
+
+    argv = sys.argv[1:] if argv is None else argv
+    if argv and argv[0] == "expand":
+        if len(argv) != 3:
+            raise SystemExit("usage: python -m hvlib.hvdump expand <dump.hvdz> <output>")
+        expand(argv[1], argv[2])
+        return 0
+
+    parser = argparse.ArgumentParser(prog="python -m hvlib.hvdump",
+                                     description="Dump the physical memory of a Hyper-V VM")
+    parser.add_argument("vm", help="VM GUID or index in the partition list")
+    parser.add_argument("output")
+    parser.add_argument("--format", choices=FORMATS, default="raw")
+    parser.add_argument("--threads", type=int, default=4)
+    parser.add_argument("--chunk", type=lambda value: int(value, 0), default=0x200000, help="bytes per read")
+    parser.add_argument("--compress", action="store_true", help="write an .hvdz container (zlib)")
+    parser.add_argument("--resume", action="store_true", help="continue from <output>.checkpoint")
+    parser.add_argument("--image", action="append", help="memory image to read instead of a VM (hvfile)")
+    parser.add_argument("--latency-us", type=float, default=0, help="simulated driver latency with --image")
+    args = parser.parse_args(argv)
+
+    lib, vm_handle = open_vm(args.vm, args.image, args.latency_us / 1000000)
+    try:
+        dump = Dump(lib, vm_handle, args.output, args.format, args.threads, args.chunk,
+                    args.compress, args.resume, progress=progress_printer())
+        stats = dump.run()
+        print(file=sys.stderr)
+        print(f"{args.output}: {stats['bytes'] / 0x100000:.0f} MB read in {stats['seconds']:.1f} s "
+              f"({stats['bytes'] / 0x100000 / max(stats['seconds'], 1e-9):.0f} MB/s), "
+              f"{stats['written'] / 0x100000:.0f} MB written, {stats['zero_pages']} zero pages skipped, "
+              f"{stats['failed_pages']} unreadable pages")
+        return 0
+    finally:
+        lib.cleanup()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,367 @@
+#
+#  File-backed stand-in for hvlib.dll
+#  GPL3 License
+#
+#  hvfile is the hvlib class with the Sdk* exports of hvlib.dll served from
+#  memory images instead of running partitions, so the wrapper, the read
+#  cache and the volatility layer run on any OS:
+#
+#      raw images        flat guest physical memory from offset 0
+#      ELF cores         PT_LOAD segments at their physical addresses
+#                        (QEMU dump-guest-memory, VirtualBox .elf dumps)
+#      crash dumps       64-bit Windows full and bitmap dumps (PAGEDU64),
+#                        e.g. saved by LiveCloudKd
+#
+#  Every image is one partition. Files are mapped copy-on-write, so writes
+#  change the mapping and never the file. Each read or write call sleeps
+#  latency + size / bandwidth seconds, like a round trip through hvmm.sys.
+#  The runs of an image are reported as the guest's MmPhysicalMemoryBlock
+#  (InfoNumberOfRuns, InfoRun), so the gaps between them read as holes.
+#  Virtual addresses are translated with the image's directory table base
+#  (crash dumps) by hvlib/pagewalk.py; without one the virtual calls fail.
+#  Snapshots of a snapshot store (hvlib/snapshot.py) open the same way.
+#
+
+import ctypes
+import mmap
+import os
+import struct
+import threading
+import time
+import uuid
+
+from .hvlib import hvlib, CfgParameters, HvmmInformationClass, ReadMemoryMethod, WriteMemoryMethod
+from .pagewalk import PageWalker
+
+PAGE_SIZE = 0x1000
+
+DMP_SIGNATURE = b"PAGEDU64"
+DMP_HEADER_SIZE = 0x2000
+DMP_DIRECTORY_TABLE_BASE = 0x10
+DMP_PHYSICAL_MEMORY_BLOCK = 0x88
+DMP_DUMP_TYPE = 0xF98
+DMP_TYPE_FULL = 1
+DMP_TYPE_BITMAP = (5, 6)
+
+ELF_MAGIC = b"\x7fELF"
+PT_LOAD = 1
+
+
+class MemoryImage:
+    """A memory image as runs of guest physical memory: (address, file offset, size)."""
+
+    def __init__(self, path):
+
+        self.path = os.path.abspath(path)
+        self.name = os.path.basename(path)
+        self.guid = str(uuid.uuid5(uuid.NAMESPACE_URL, "file:" + self.path))
+        self.directory_table_base = 0
+
+        with open(path, "rb") as f:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_COPY)
+        self._base = ctypes.addressof(ctypes.c_char.from_buffer(self._map))
+
+        header = self._map[:DMP_HEADER_SIZE]
+        if header[:8] == DMP_SIGNATURE:
+            self.kind = "Crash dump"
+            self.runs = self._dump_runs(header)
+        elif header[:4] == ELF_MAGIC:
+            self.kind = "ELF core"
+            self.runs = self._elf_runs(header)
+        else:
+            self.kind = "Raw image"
+            self.runs = [(0, 0, len(self._map))]
+
+        self.runs.sort()
+        self._starts = [address for address, _, _ in self.runs]
+        self.maximum_address = max((address + size for address, _, size in self.runs), default=0)
+        self.page_runs = self._page_runs()
+
+    def _elf_runs(self, header):
+
+        if header[4] != 2 or header[5] != 1:
+            raise ValueError(f"{self.path}: only 64-bit little endian ELF cores are supported")
+        phoff, = struct.unpack_from("<Q", header, 0x20)
+        phentsize, phnum = struct.unpack_from("<HH", header, 0x36)
+
+        segments = []
+        for index in range(phnum):
+            p_type, _, p_offset, p_vaddr, p_paddr, p_filesz = struct.unpack_from(
+                "<IIQQQQ", self._map, phoff + index * phentsize)
+            if p_type == PT_LOAD and p_filesz:
+                segments.append((p_paddr, p_vaddr, p_offset, p_filesz))
+
+        # Some tools leave p_paddr zero and put the physical address in p_vaddr
+        if len(segments) > 1 and all(paddr == 0 for paddr, _, _, _ in segments):
+            return [(vaddr, offset, size) for _, vaddr, offset, size in segments]
+        return [(paddr, offset, size) for paddr, _, offset, size in segments]
+
+    def _dump_runs(self, header):
+
+        self.directory_table_base, = struct.unpack_from("<Q", header, DMP_DIRECTORY_TABLE_BASE)
+        dump_type, = struct.unpack_from("<I", header, DMP_DUMP_TYPE)
+
+        if dump_type == DMP_TYPE_FULL:
+            count, = struct.unpack_from("<I", header, DMP_PHYSICAL_MEMORY_BLOCK)
+            runs = []
+            offset = DMP_HEADER_SIZE
+            for index in range(count):
+                page, pages = struct.unpack_from("<QQ", header, DMP_PHYSICAL_MEMORY_BLOCK + 0x10 + index * 0x10)
+                runs.append((page * PAGE_SIZE, offset, pages * PAGE_SIZE))
+                offset += pages * PAGE_SIZE
+            return runs
+
+        if dump_type in DMP_TYPE_BITMAP:
+            # _BMP_HEADER64 at 0x2000: "SDMP"/"FDMP", FirstPage at 0x20, bit count at 0x30, bitmap at 0x38
+            offset, _, bits = struct.unpack_from("<QQQ", self._map, DMP_HEADER_SIZE + 0x20)
+            bitmap = self._map[DMP_HEADER_SIZE + 0x38:DMP_HEADER_SIZE + 0x38 + (bits + 7) // 8]
+            runs = []
+            start = None
+            for byte_index, byte in enumerate(bitmap):
+                if byte in (0, 0xFF) and (start is None) == (byte == 0):
+                    continue        # whole byte continues the current state
+                for bit in range(8):
+                    page = byte_index * 8 + bit
+                    present = (byte >> bit) & 1 and page < bits
+                    if present and start is None:
+                        start = page
+                    elif not present and start is not None:
+                        runs.append((start * PAGE_SIZE, offset, (page - start) * PAGE_SIZE))
+                        offset += (page - start) * PAGE_SIZE
+                        start = None
+            if start is not None:
+                runs.append((start * PAGE_SIZE, offset, (bits - start) * PAGE_SIZE))
+            return runs
+
+        raise ValueError(f"{self.path}: dump type {dump_type} is not supported (full and bitmap dumps are)")
+
+    def _page_runs(self):
+        """The runs as a guest would list them in MmPhysicalMemoryBlock: (first page, pages)."""
+
+        runs = []
+        for address, _, size in self.runs:
+            page, end = address // PAGE_SIZE, (address + size) // PAGE_SIZE
+            if end <= page:
+                continue
+            if runs and page <= runs[-1][0] + runs[-1][1]:
+                runs[-1] = (runs[-1][0], max(runs[-1][1], end - runs[-1][0]))
+            else:
+                runs.append((page, end - page))
+        return runs
+
+    def _locate(self, address, size):
+        """(pointer into the mapping, size) pieces of a range, None if any part is unbacked."""
+
+        pieces = []
+        index = max(0, self._find(address))
+        while size > 0:
+            if index >= len(self.runs):
+                return None
+            start, offset, length = self.runs[index]
+            if not start <= address < start + length:
+                return None
+            chunk = min(size, start + length - address)
+            pieces.append((self._base + offset + address - start, chunk))
+            address += chunk
+            size -= chunk
+            index += 1
+        return pieces
+
+    def _find(self, address):
+
+        low, high = 0, len(self._starts)
+        while low < high:
+            middle = (low + high) // 2
+            if self._starts[middle] <= address:
+                low = middle + 1
+            else:
+                high = middle
+        return low - 1
+
+    def read(self, address, size, buffer):
+
+        pieces = self._locate(address, size)
+        if pieces is None:
+            return False
+        target = ctypes.addressof(buffer) if isinstance(buffer, ctypes.Array) else buffer
+        for source, chunk in pieces:
+            ctypes.memmove(target, source, chunk)
+            target += chunk
+        return True
+
+    def write(self, address, size, buffer):
+
+        pieces = self._locate(address, size)
+        if pieces is None:
+            return False
+        data = bytes(buffer[:size]) if not isinstance(buffer, ctypes.Array) else buffer.raw[:size]
+        position = 0
+        for target, chunk in pieces:
+            ctypes.memmove(target, data[position:position + chunk], chunk)
+            position += chunk
+        return True
+
+
+def open_image(path):
+    """MemoryImage, or SnapshotImage for a snapshot manifest (hvlib/snapshot.py)."""
+
+    with open(path, "rb") as f:
+        magic = f.read(4)
+    if magic == b"HVSN":
+        from .snapshot import SnapshotImage
+        return SnapshotImage(path)
+    return MemoryImage(path)
+
+
+class FileSdk:
+    """The Sdk* exports of hvlib.dll over MemoryImage partitions."""
+
+    HANDLE_BASE = 0x10000
+
+    def __init__(self, images, latency=0.0, bandwidth=0):
+
+        self.images = images
+        self.latency = latency
+        self.bandwidth = bandwidth
+        self.calls = 0
+        self.bytes_read = 0
+        self._stats_lock = threading.Lock()
+        self._strings = {}
+        self._table = None
+        self._walkers = {}
+
+    def _image(self, handle):
+        index = handle - self.HANDLE_BASE
+        return self.images[index] if 0 <= index < len(self.images) else None
+
+    def _delay(self, size):
+        with self._stats_lock:
+            self.calls += 1
+            self.bytes_read += size
+        delay = self.latency + (size / self.bandwidth if self.bandwidth else 0)
+        if delay > 0:
+            time.sleep(delay)
+
+    def _string(self, key, text):
+        # The caller gets a pointer; the buffer has to outlive the call
+        buffer = self._strings.get(key)
+        if buffer is None or buffer.value != text:
+            buffer = self._strings[key] = ctypes.create_unicode_buffer(text)
+        return ctypes.addressof(buffer)
+
+    def SdkGetDefaultConfig(self, config):
+        config = config.contents
+        config.ReadMethod = ReadMemoryMethod.ReadInterfaceHvmmDrvInternal
+        config.WriteMethod = WriteMemoryMethod.WriteInterfaceHvmmDrvInternal
+        return True
+
+    def SdkEnumPartitions(self, count, config):
+        self._table = (ctypes.c_uint64 * max(1, len(self.images)))(
+            *[self.HANDLE_BASE + index for index in range(len(self.images))])
+        count.contents.value = len(self.images)
+        return ctypes.cast(self._table, ctypes.POINTER(ctypes.c_uint64))
+
+    def SdkSelectPartition(self, handle):
+        return self._image(handle) is not None
+
+    def SdkCloseAllPartitions(self):
+        return True
+
+    def SdkGetData(self, handle, info_class, target):
+        image = self._image(handle)
+        if image is None:
+            return False
+        strings = {
+            HvmmInformationClass.InfoPartitionFriendlyName: image.name,
+            HvmmInformationClass.InfoVmtypeString: image.kind,
+            HvmmInformationClass.InfoVmGuidString: image.guid,
+        }
+        numbers = {
+            HvmmInformationClass.InfoPartitionId: handle - self.HANDLE_BASE + 1,
+            HvmmInformationClass.InfoMmMaximumPhysicalPage: (image.maximum_address + PAGE_SIZE - 1) // PAGE_SIZE,
+            HvmmInformationClass.InfoKernelBase: 0,
+            HvmmInformationClass.InfoDirectoryTableBase: image.directory_table_base,
+            HvmmInformationClass.InfoNumberOfRuns: len(image.page_runs),
+        }
+        pointer = ctypes.cast(target, ctypes.POINTER(ctypes.c_uint64))
+        if info_class == HvmmInformationClass.InfoRun:
+            # Array of (BasePage, PageCount), as many as InfoNumberOfRuns returned
+            for index, (page, count) in enumerate(image.page_runs):
+                pointer[index * 2], pointer[index * 2 + 1] = page, count
+        elif info_class in strings:
+            pointer[0] = self._string((handle, info_class), strings[info_class])
+        elif info_class in numbers:
+            pointer[0] = numbers[info_class]
+        else:
+            return False
+        return True
+
+    def SdkReadPhysicalMemory(self, handle, start, count, buffer, method):
+        self._delay(count)
+        image = self._image(handle)
+        return image is not None and image.read(start, count, buffer)
+
+    def SdkWritePhysicalMemory(self, handle, start, count, buffer, method):
+        self._delay(count)
+        image = self._image(handle)
+        return image is not None and image.write(start, count, buffer)
+
+    def _walker(self, image):
+        # Walks read the image directly, without the simulated latency per table read
+        walker = self._walkers.get(image)
+        if walker is None:
+            walker = self._walkers[image] = PageWalker(
+                lambda address, buffer: image.read(address, len(buffer), (ctypes.c_char * len(buffer)).from_buffer(buffer)))
+        return walker
+
+    def SdkReadVirtualMemory(self, handle, address, buffer, size):
+        # All or nothing, as hvlib.dll
+        self._delay(size)
+        image = self._image(handle)
+        if image is None or not image.directory_table_base:
+            return False
+        done = self._walker(image).read(image.directory_table_base, address, memoryview(buffer)[:size], size)
+        return done == [(0, size)]
+
+    def SdkWriteVirtualMemory(self, handle, address, buffer, size):
+        self._delay(size)
+        image = self._image(handle)
+        if image is None or not image.directory_table_base:
+            return False
+        pieces = self._walker(image).runs(image.directory_table_base, address, size)
+        if any(physical is None for _, physical, _ in pieces):
+            return False
+        data = bytes(buffer[:size]) if not isinstance(buffer, ctypes.Array) else buffer.raw[:size]
+        return all(image.write(physical, length, data[offset:offset + length]) for offset, physical, length in pieces)
+
+    def SdkControlVmState(self, handle, action, method, manage_worker_process):
+        return self._image(handle) is not None
+
+
+class hvfile(hvlib):
+    """hvlib over memory image files: same methods, no hvlib.dll or hvmm.sys.
+
+    paths is one path or a list (one partition each). latency is seconds per
+    call and bandwidth bytes per second (0: unlimited) for the simulated
+    driver; sdk.calls and sdk.bytes_read count what reached it.
+    """
+
+    def __init__(self, paths, latency=0.0, bandwidth=0):
+
+        if isinstance(paths, (str, os.PathLike)):
+            paths = [paths]
+        self.images = [open_image(path) for path in paths]
+        self.sdk = FileSdk(self.images, latency, bandwidth)
+        self.hvlib = self.sdk
+        self.PartitionArray = []
+        self.CurrentPartition = 0
+        self.PartitionCount = 0
+        self.ArrayOfNames = []
+
+        vm_ops = CfgParameters(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+        self.hvlib.SdkGetDefaultConfig(ctypes.pointer(vm_ops))
+        self.vm_ops = vm_ops
+
+    def cleanup(self):
+        self.cleanup_scatter()
+        self.hvlib.SdkCloseAllPartitions()
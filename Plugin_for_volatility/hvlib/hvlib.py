@@ -11,12 +11,15 @@ import ctypes
 import os
 from enum import IntEnum
 import sys
-import msvcrt
 import atexit
 import binascii
+from concurrent.futures import ThreadPoolExecutor
 
 # problem with python 3 wprintf additional spaces between each letter
-msvcrt.setmode(sys.stdout.fileno(), os.O_TEXT)
+# (only on Windows; elsewhere the package is imported for its pure Python parts)
+if sys.platform == "win32":
+    import msvcrt
+    msvcrt.setmode(sys.stdout.fileno(), os.O_TEXT)
 
 #
 # https://gist.github.com/christoph2/9c390e5c094796903097 - python 3 enums fix
@@ -85,9 +88,24 @@ class HvmmInformationClass(IntEnum):
     InfoPartitionId = 2
     InfoVmtypeString = 3
     InfoMmMaximumPhysicalPage = 6
+    InfoNumberOfCPU = 8
+    InfoNumberOfRuns = 10
     InfoKernelBase = 11
+    InfoMmPfnDatabase = 12
+    InfoPsLoadedModuleList = 13
+    InfoPsActiveProcessHead = 14
+    InfoNtBuildNumber = 15
+    InfoDirectoryTableBase = 17
+    InfoRun = 18
     InfoVmGuidString = 20
 
+class PhysicalMemoryRun(ctypes.Structure):
+    # _PHYSICAL_MEMORY_RUN of the guest's MmPhysicalMemoryBlock
+    _fields_ = [
+        ("BasePage", ctypes.c_uint64),
+        ("PageCount", ctypes.c_uint64),
+    ]
+
 class VmStateAction(IntEnum):
     SuspendVm = 0
     ResumeVm = 1
@@ -308,6 +326,33 @@ class hvlib:
                                            ctypes.pointer(int_var))
             return int_var.value
 
+    def GetMemoryRuns(self, vm_handle):
+        """Backed guest physical memory as sorted (address, size) runs, adjacent runs merged.
+
+        The runs are the guest's MmPhysicalMemoryBlock (InfoNumberOfRuns, InfoRun): everything
+        between them is MMIO or not mapped. None if hvlib does not report them.
+        """
+
+        count = ctypes.c_uint64(0)
+        if not self.hvlib.SdkGetData(vm_handle, HvmmInformationClass.InfoNumberOfRuns, ctypes.pointer(count)):
+            return None
+        if not 0 < count.value <= 0x10000:
+            return None
+        array = (PhysicalMemoryRun * count.value)()
+        if not self.hvlib.SdkGetData(vm_handle, HvmmInformationClass.InfoRun, array):
+            return None
+
+        runs = []
+        for run in sorted(array, key=lambda run: run.BasePage):
+            if run.PageCount == 0:
+                continue
+            address, size = run.BasePage * 0x1000, run.PageCount * 0x1000
+            if runs and address <= runs[-1][0] + runs[-1][1]:
+                runs[-1] = (runs[-1][0], max(runs[-1][1], address + size - runs[-1][0]))
+            else:
+                runs.append((address, size))
+        return runs or None
+
     def ReadPhysicalMemoryBlock(self, vm_handle, address, block_size):
 
         buffer = ctypes.create_string_buffer(block_size)
@@ -330,6 +375,143 @@ class hvlib:
 
         return buffer
 
+    # ReadPhysicalInto / ReadVirtualInto fill a caller-owned buffer in place: a writable bytes-like
+    # object (bytearray, memoryview, mmap) or a ctypes array over one, e.g. from BufferPool, which
+    # skips the from_buffer per call. size defaults to the whole buffer; a larger size raises
+    # ValueError instead of letting the driver write past it. Failures are not printed,
+    # the caller gets False and decides (volatility layers read holes all the time).
+
+    @staticmethod
+    def _into_buffer(buffer, size):
+
+        if not isinstance(buffer, ctypes.Array):
+            buffer = (ctypes.c_char * memoryview(buffer).nbytes).from_buffer(buffer)
+        if size is None:
+            size = ctypes.sizeof(buffer)
+        elif not 0 <= size <= ctypes.sizeof(buffer):
+            raise ValueError(f"Read of 0x{size:X} bytes into a 0x{ctypes.sizeof(buffer):X}-byte buffer")
+        return buffer, size
+
+    def ReadPhysicalInto(self, vm_handle, address, buffer, size=None):
+
+        buffer, size = self._into_buffer(buffer, size)
+        return bool(self.hvlib.SdkReadPhysicalMemory(vm_handle, address, size, buffer,
+                                                     self.vm_ops.ReadMethod))
+
+    def ReadVirtualInto(self, vm_handle, address, buffer, size=None):
+
+        buffer, size = self._into_buffer(buffer, size)
+        return bool(self.hvlib.SdkReadVirtualMemory(vm_handle, address, buffer, size))
+
+    def ReadPhysicalScatter(self, vm_handle, ranges, out, gap=0x1000, max_run=0x100000, workers=1):
+        """Read many (address, size) ranges of guest physical memory into one buffer.
+
+        The ranges land back to back in `out` (writable, at least the sum of the sizes)
+        in the order given. They are sorted and ranges closer than `gap` are merged into
+        runs of up to max_run bytes, one driver call per run; a run that fails is read
+        again range by range, so a hole only costs the ranges inside it. With workers > 1
+        the runs are spread over a small thread pool (ctypes drops the GIL in the call).
+        Returns a list of booleans, one per range; unreadable ranges are zero filled.
+        """
+
+        ranges = [(int(address), int(size)) for address, size in ranges]
+        view = memoryview(out).cast("B")
+        offsets = []
+        total = 0
+        for _, size in ranges:
+            offsets.append(total)
+            total += max(size, 0)
+        if view.nbytes < total:
+            raise ValueError(f"Output buffer holds 0x{view.nbytes:X} bytes, ranges need 0x{total:X}")
+
+        runs = []
+        for index in sorted(range(len(ranges)), key=lambda i: ranges[i][0]):
+            address, size = ranges[index]
+            if size <= 0:
+                continue
+            if runs:
+                run = runs[-1]
+                end = max(run[1], address + size)
+                if address <= run[1] + gap and end - run[0] <= max_run:
+                    run[1] = end
+                    run[2].append(index)
+                    continue
+            runs.append([address, address + size, [index]])
+
+        results = [size <= 0 for _, size in ranges]
+
+        def read_one(index):
+            address, size = ranges[index]
+            results[index] = self.ReadPhysicalInto(vm_handle, address, view[offsets[index]:offsets[index] + size])
+
+        def read_run(run):
+            start, end, members = run
+            if len(members) > 1:
+                buffer = bytearray(end - start)
+                if self.ReadPhysicalInto(vm_handle, start, buffer):
+                    source = memoryview(buffer)
+                    for index in members:
+                        address, size = ranges[index]
+                        view[offsets[index]:offsets[index] + size] = source[address - start:address - start + size]
+                        results[index] = True
+                    return
+            for index in members:
+                read_one(index)
+
+        if workers > 1 and len(runs) > 1:
+            if getattr(self, "_scatter_workers", 0) != workers:
+                self.cleanup_scatter()
+                self._scatter_pool = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="hvlib-scatter")
+                self._scatter_workers = workers
+            list(self._scatter_pool.map(read_run, runs))
+        else:
+            for run in runs:
+                read_run(run)
+
+        for index, ok in enumerate(results):
+            if not ok:
+                view[offsets[index]:offsets[index] + ranges[index][1]] = bytes(ranges[index][1])
+        return results
+
+    # Client-side translation (hvlib/pagewalk.py): page tables are read with physical reads and
+    # kept, translations are cached per CR3, and a read that meets unmapped pages fills what it
+    # can instead of failing. directory_table_base defaults to the partition's (InfoDirectoryTableBase).
+    # Call FlushTranslations after the guest may have changed its page tables.
+
+    def GetPageWalker(self, vm_handle, levels=4):
+
+        walkers = self.__dict__.setdefault("_walkers", {})
+        walker = walkers.get(vm_handle)
+        if walker is None or walker.levels != levels:
+            from .pagewalk import PageWalker
+            walker = walkers[vm_handle] = PageWalker(
+                lambda address, buffer: self.ReadPhysicalInto(vm_handle, address, buffer), levels)
+        return walker
+
+    def TranslateVirtualAddress(self, vm_handle, address, directory_table_base=None):
+
+        if directory_table_base is None:
+            directory_table_base = self.GetData(vm_handle, HvmmInformationClass.InfoDirectoryTableBase)
+        mapping = self.GetPageWalker(vm_handle).translate(directory_table_base, address)
+        if mapping is None:
+            return None
+        base, page_size = mapping
+        return base + address % page_size
+
+    def ReadVirtualPartial(self, vm_handle, address, buffer, size=None, directory_table_base=None):
+        """Read virtual memory into a writable buffer; returns the (offset, length) parts that
+        were read, the rest of the buffer is zero."""
+
+        if directory_table_base is None:
+            directory_table_base = self.GetData(vm_handle, HvmmInformationClass.InfoDirectoryTableBase)
+        return self.GetPageWalker(vm_handle).read(directory_table_base, address, buffer, size)
+
+    def FlushTranslations(self, vm_handle=None):
+
+        for handle, walker in self.__dict__.get("_walkers", {}).items():
+            if vm_handle is None or handle == vm_handle:
+                walker.flush()
+
     def WritePhysicalMemoryBlock(self, vm_handle, address, buffer):
 
         block_size = len(buffer)
@@ -351,6 +533,13 @@ class hvlib:
 
         return True
 
+    def cleanup_scatter(self):
+        if getattr(self, "_scatter_pool", None) is not None:
+            self._scatter_pool.shutdown()
+        self._scatter_pool = None
+        self._scatter_workers = 0
+
     def cleanup(self):
+        self.cleanup_scatter()
         self.hvlib.SdkCloseAllPartitions()
         print("hvlib.dll unloaded")
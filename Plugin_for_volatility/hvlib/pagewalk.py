@@ -0,0 +1,198 @@
+#
+#  x64 page table walker over guest physical reads
+#  GPL3 License
+#
+#  SdkReadVirtualMemory translates every call again inside hvlib.dll and
+#  fails the whole read on one unmapped page. PageWalker translates on the
+#  client side: it reads page table pages (4 or 5 levels, 1 GB and 2 MB
+#  pages) with physical reads and keeps them, so walking the neighbours of
+#  an address costs no further reads, and keeps the translations per CR3.
+#  A virtual read is split into pages, physically contiguous pages are read
+#  in one call and the result says which parts of the buffer were filled.
+#
+#  Only hardware-valid entries are followed: Windows transition, prototype
+#  and paged out PTEs are not present here.
+#
+#  The guest changes its page tables while it runs; flush() drops what was
+#  cached (for one CR3 or all of them).
+#
+
+import struct
+import threading
+from collections import OrderedDict
+
+PAGE_SIZE = 0x1000
+LARGE_PAGE_SIZE = 0x200000
+HUGE_PAGE_SIZE = 0x40000000
+
+ENTRY_PRESENT = 1
+ENTRY_LARGE = 1 << 7
+ENTRY_ADDRESS = 0x000FFFFFFFFFF000
+
+ENTRY = struct.Struct("<Q")
+
+
+class PageWalker:
+    """Virtual to physical translation for x64 guests.
+
+    read_physical(address, buffer) fills a writable buffer (a memoryview)
+    from guest physical memory and returns True, or False if it cannot.
+    levels is 4, or 5 for LA57 guests. At most `tables` page table pages and
+    `translations` translations per CR3 are kept.
+    """
+
+    def __init__(self, read_physical, levels=4, tables=4096, translations=0x10000):
+
+        if levels not in (4, 5):
+            raise ValueError("levels must be 4 or 5")
+        self._read_physical = read_physical
+        self.levels = levels
+        self._address_bits = 12 + 9 * levels
+        self._max_tables = tables
+        self._max_translations = translations
+        self._tables = OrderedDict()
+        self._translations = {}
+        self._lock = threading.Lock()
+        self.hits = 0
+        self.walks = 0
+        self.table_reads = 0
+
+    def stats(self):
+        return {"hits": self.hits, "walks": self.walks, "table_reads": self.table_reads,
+                "tables": len(self._tables)}
+
+    def flush(self, cr3=None):
+        """Forget the translations of cr3 (all of them when None) and the cached tables."""
+
+        with self._lock:
+            if cr3 is None:
+                self._translations.clear()
+            else:
+                self._translations.pop(cr3 & ENTRY_ADDRESS, None)
+            self._tables.clear()
+
+    def _table(self, address):
+        """The 512 entries of the table page at a physical address, None if unreadable."""
+
+        with self._lock:
+            table = self._tables.get(address)
+            if table is not None:
+                self._tables.move_to_end(address)
+                return table
+        buffer = bytearray(PAGE_SIZE)
+        self.table_reads += 1
+        if not self._read_physical(address, memoryview(buffer)):
+            return None
+        table = bytes(buffer)
+        with self._lock:
+            self._tables[address] = table
+            if len(self._tables) > self._max_tables:
+                self._tables.popitem(last=False)
+        return table
+
+    def _canonical(self, address):
+        top = address >> (self._address_bits - 1)
+        return top == 0 or top == (1 << (65 - self._address_bits)) - 1
+
+    def translate(self, cr3, address):
+        """(physical address of the page, page size) mapping `address`, None if not present."""
+
+        cr3 &= ENTRY_ADDRESS
+        cache = self._translations.get(cr3)
+        if cache is not None:
+            for size in (PAGE_SIZE, LARGE_PAGE_SIZE, HUGE_PAGE_SIZE):
+                physical = cache.get((address & ~(size - 1), size))
+                if physical is not None:
+                    self.hits += 1
+                    return physical, size
+
+        if not self._canonical(address):
+            return None
+        self.walks += 1
+        table = cr3
+        for level in range(self.levels, 0, -1):
+            entries = self._table(table)
+            if entries is None:
+                return None
+            index = (address >> (12 + 9 * (level - 1))) & 0x1FF
+            entry, = ENTRY.unpack_from(entries, index * 8)
+            if not entry & ENTRY_PRESENT:
+                return None
+            if level in (2, 3) and entry & ENTRY_LARGE:
+                size = LARGE_PAGE_SIZE if level == 2 else HUGE_PAGE_SIZE
+                physical = entry & ENTRY_ADDRESS & ~(size - 1)
+                break
+            table = entry & ENTRY_ADDRESS
+        else:
+            size = PAGE_SIZE
+            physical = table
+
+        with self._lock:
+            cache = self._translations.setdefault(cr3, {})
+            if len(cache) >= self._max_translations:
+                cache.clear()
+            cache[(address & ~(size - 1), size)] = physical
+        return physical, size
+
+    def runs(self, cr3, address, size):
+        """Split [address, address + size) into (offset, physical address or None, length)
+        pieces, merging pages that are contiguous in physical memory too."""
+
+        pieces = []
+        offset = 0
+        while offset < size:
+            virtual = address + offset
+            mapping = self.translate(cr3, virtual)
+            if mapping is None:
+                length = min(size - offset, PAGE_SIZE - virtual % PAGE_SIZE)
+                physical = None
+            else:
+                base, page_size = mapping
+                length = min(size - offset, page_size - virtual % page_size)
+                physical = base + virtual % page_size
+            if pieces:
+                last_offset, last_physical, last_length = pieces[-1]
+                if (physical is None and last_physical is None) or (
+                        physical is not None and last_physical is not None and last_physical + last_length == physical):
+                    pieces[-1] = (last_offset, last_physical, last_length + length)
+                    offset += length
+                    continue
+            pieces.append((offset, physical, length))
+            offset += length
+        return pieces
+
+    def read(self, cr3, address, buffer, size=None):
+        """Fill `buffer` from virtual memory; returns the (offset, length) ranges that were read.
+
+        Unmapped and unreadable parts are zero. A physical run that fails is read again
+        page by page, so one bad page does not cost its neighbours.
+        """
+
+        view = memoryview(buffer).cast("B")
+        if size is None:
+            size = view.nbytes
+        elif not 0 <= size <= view.nbytes:
+            raise ValueError(f"Read of 0x{size:X} bytes into a 0x{view.nbytes:X}-byte buffer")
+        done = []
+
+        def mark(offset, length):
+            if done and done[-1][0] + done[-1][1] == offset:
+                done[-1] = (done[-1][0], done[-1][1] + length)
+            else:
+                done.append((offset, length))
+
+        for offset, physical, length in self.runs(cr3, address, size):
+            target = view[offset:offset + length]
+            if physical is not None and self._read_physical(physical, target):
+                mark(offset, length)
+                continue
+            target[:] = bytes(length)
+            if physical is None or length <= PAGE_SIZE - physical % PAGE_SIZE:
+                continue
+            position = 0
+            while position < length:
+                step = min(length - position, PAGE_SIZE - (physical + position) % PAGE_SIZE)
+                if self._read_physical(physical + position, target[position:position + step]):
+                    mark(offset + position, step)
+                position += step
+        return done
@@ -0,0 +1,219 @@
+#
+#  Binary read log for the hyperv volatility layer
+#  GPL3 License
+#
+#  The layer used to format a CSV line and flush the file under a lock on
+#  every physical read. ReadLog.log() only appends a tuple to a deque; a
+#  background thread packs the queued reads into fixed size binary records
+#  and writes them in batches. Convert a log back to the old CSV with
+#
+#      python -m hvlib.readlog hyperv_reads.hvrl [hyperv_reads.csv]
+#
+#  File layout (little endian):
+#
+#      header   "HVRL", u16 version, u16 sample, u64 start time (ns since epoch)
+#      status   u8 1, u16 id, u16 size, utf-8 text         first use of a status;
+#                                                          0xFFFF "OTHER" follows the
+#                                                          header, for any status once
+#                                                          the other ids are used up
+#      read     u8 0, u16 status id, u64 offset, u32 length,
+#               u32 returned, u64 ns since start
+#
+
+import atexit
+import csv
+import itertools
+import os
+import struct
+import sys
+import threading
+import time
+from collections import deque
+
+MAGIC = b"HVRL"
+VERSION = 1
+
+HEADER = struct.Struct("<4sHHQ")
+READ = struct.Struct("<BHQIIQ")
+STATUS = struct.Struct("<BHH")
+
+RECORD_READ = 0
+RECORD_STATUS = 1
+
+# Status ids are u16: the last one stands for every status after the table fills up
+STATUS_OVERFLOW = 0xFFFF
+STATUS_OVERFLOW_TEXT = "OTHER"
+
+# Records packed per turn of the writer thread
+BATCH = 64
+
+CSV_HEADER = ["action", "offset_hex", "length_hex", "length_dec", "returned_hex", "returned_dec", "status", "time_us"]
+
+
+class ReadLog:
+    """Queue of read records drained into `path` by a writer thread.
+
+    log() is safe to call from any thread without a lock: deque.append is
+    atomic. With sample=N (at most 65535) only every Nth complete read is
+    kept; reads that returned less than requested are always kept. The queue
+    holds at most `backlog` records, older ones are dropped if the writer
+    falls behind. If a write fails the error is reported on stderr and kept
+    in `error`, and nothing more is written.
+    """
+
+    def __init__(self, path, sample=1, interval=0.2, backlog=1 << 20):
+
+        self.path = path
+        self.sample = min(max(1, sample), 0xFFFF)
+        # Unbuffered: the writer hands whole batches to write(), and a forked child that
+        # drops its copy of the file has no buffered bytes to flush into the parent's log
+        self._file = open(path, "wb", buffering=0)
+        self._pid = os.getpid()
+        self._start = time.perf_counter_ns()
+        self._file.write(HEADER.pack(MAGIC, VERSION, self.sample, time.time_ns()) +
+                         STATUS.pack(RECORD_STATUS, STATUS_OVERFLOW, len(STATUS_OVERFLOW_TEXT)) +
+                         STATUS_OVERFLOW_TEXT.encode())
+
+        self._queue = deque(maxlen=backlog)
+        self._counter = itertools.count()
+        self._statuses = {}
+        self._interval = interval
+        self._stop = threading.Event()
+        self.records = 0
+        self.error = None
+
+        # log() is the hot path: a closure over locals, no attribute lookups
+        append = self._queue.append
+        counter = self._counter
+        sample = self.sample
+        clock = time.perf_counter_ns
+
+        def log(offset, length, returned, status):
+            append((offset, length, returned, status, clock()))
+
+        def log_sampled(offset, length, returned, status):
+            if returned == length and next(counter) % sample:
+                return
+            append((offset, length, returned, status, clock()))
+
+        self.log = log if sample == 1 else log_sampled
+
+        self._writer = threading.Thread(target=self._run, name="hv-readlog", daemon=True)
+        self._writer.start()
+        atexit.register(self.close)
+
+    def close(self):
+
+        if self._file is None:
+            return
+        if self._pid != os.getpid():
+            # Inherited through fork: the writer thread and the log belong to the parent,
+            # only this process's copy of the descriptor is closed
+            self._file.close()
+            self._file = None
+            return
+        self._stop.set()
+        self._writer.join()
+        if self.error is None:
+            self._write()
+        self._file.close()
+        self._file = None
+        atexit.unregister(self.close)
+
+    def _run(self):
+
+        while not self._stop.wait(self._interval):
+            if not self._write():
+                return
+
+    def _write(self):
+
+        try:
+            self._drain()
+        except Exception as e:
+            self.error = e
+            print(f"hv-readlog: {self.path}: {type(e).__name__}: {e}; read logging stopped", file=sys.stderr)
+            return False
+        return True
+
+    def _drain(self):
+
+        queue = self._queue
+        statuses = self._statuses
+        start = self._start
+        pack = READ.pack
+        pop = queue.popleft
+
+        while queue:
+            # Small batches: sleep(0) hands the GIL back between them, so the
+            # packing fits into the time the reader spends inside the driver
+            out = bytearray()
+            count = min(len(queue), BATCH)
+            for _ in range(count):
+                offset, length, returned, status, stamp = pop()
+                number = statuses.get(status)
+                if number is None:
+                    if len(statuses) < STATUS_OVERFLOW:
+                        number = statuses[status] = len(statuses)
+                        text = status.encode("utf-8")[:0xFFFF]
+                        out += STATUS.pack(RECORD_STATUS, number, len(text)) + text
+                    else:
+                        number = STATUS_OVERFLOW
+                out += pack(RECORD_READ, number, offset, length & 0xFFFFFFFF, returned & 0xFFFFFFFF,
+                            max(0, stamp - start))
+            self._file.write(out)
+            self.records += count
+            time.sleep(0)
+        self._file.flush()
+
+
+def read_records(path):
+    """Yield (offset, length, returned, status, ns since start) from a log."""
+
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if len(data) < HEADER.size:
+        raise ValueError(f"{path}: too short for a read log")
+    magic, version, _, _ = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(f"{path}: not a version {VERSION} read log")
+
+    statuses = {}
+    position = HEADER.size
+    while position < len(data):
+        kind = data[position]
+        if kind == RECORD_STATUS and position + STATUS.size <= len(data):
+            _, number, size = STATUS.unpack_from(data, position)
+            position += STATUS.size
+            statuses[number] = data[position:position + size].decode("utf-8", "replace")
+            position += size
+        elif kind == RECORD_READ and position + READ.size <= len(data):
+            _, number, offset, length, returned, stamp = READ.unpack_from(data, position)
+            position += READ.size
+            yield offset, length, returned, statuses.get(number, "?"), stamp
+        else:
+            break       # truncated by a crash, keep what was complete
+
+
+def to_csv(path, out):
+    """Write a log as the CSV that hyperv.py used to produce (plus time_us)."""
+
+    writer = csv.writer(out, lineterminator="\n")
+    writer.writerow(CSV_HEADER)
+    for offset, length, returned, status, stamp in read_records(path):
+        writer.writerow(["read", f"0x{offset:X}", f"0x{length:X}", length, f"0x{returned:X}", returned,
+                         status, stamp // 1000])
+
+
+if __name__ == "__main__":
+
+    if len(sys.argv) not in (2, 3):
+        print("usage: python -m hvlib.readlog <log.hvrl> [out.csv]", file=sys.stderr)
+        sys.exit(2)
+
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w", newline="") as out:
+            to_csv(sys.argv[1], out)
+    else:
+        to_csv(sys.argv[1], sys.stdout)
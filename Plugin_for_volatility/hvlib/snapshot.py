@@ -0,0 +1,320 @@
+#
+#  Incremental memory snapshots of a Hyper-V VM
+#  GPL3 License
+#
+#  A snapshot store is a directory of repeated acquisitions of the same VMs:
+#
+#      python -m hvlib.snapshot take C:\snapshots <VM GUID or index>
+#      python -m hvlib.snapshot list C:\snapshots
+#
+#  Every page read is hashed (crc32 and adler32 side by side, 64 bits). A
+#  snapshot stores only the pages whose hash differs from the previous
+#  snapshot of the same VM; the others point at the page already in the
+#  store, zero pages at nothing. Any snapshot opens alone as a memory image:
+#
+#      HYPERV_IMAGE=C:\snapshots\000003.hvsnap  python vol.py ... (hyperv layer)
+#      python -m hvlib.hvdump --image C:\snapshots\000003.hvsnap 0 vm.dmp --format dmp
+#
+#  Store layout:
+#
+#      pages.bin        page data, appended by every snapshot
+#      NNNNNN.hvsnap    "HVSN", u16 version, u16 0, u32 metadata size, u64 pages,
+#                       metadata (JSON: VM, time, runs, counters),
+#                       u64 slot per page (0: zero or unbacked, n: page n-1 of pages.bin),
+#                       u64 hash per page (the index the next snapshot compares with)
+#
+#  The manifest is written last, so an interrupted snapshot leaves unused
+#  pages at the end of pages.bin and no snapshot. One process writes to a
+#  store at a time.
+#
+
+import argparse
+import bisect
+import contextlib
+import ctypes
+import json
+import mmap
+import os
+import struct
+import sys
+import time
+import uuid
+import zlib
+from array import array
+
+from .bufferpool import BufferPool
+from .hvdump import PAGE_SIZE, ZERO_PAGE, open_vm, plan, progress_printer, read_chunk, read_chunks
+from .hvlib import HvmmInformationClass
+
+MAGIC = b"HVSN"
+VERSION = 1
+HEADER = struct.Struct("<4sHHIQ")
+PAGES_FILE = "pages.bin"
+SUFFIX = ".hvsnap"
+
+
+def page_hash(page):
+    """64-bit hash of a page: crc32 in the low half, adler32 in the high half."""
+    return zlib.crc32(page) | zlib.adler32(page) << 32
+
+
+ZERO_HASH = page_hash(ZERO_PAGE)
+
+
+def read_manifest(path):
+    """(metadata, slots, hashes) of a snapshot manifest."""
+
+    with open(path, "rb") as f:
+        magic, version, _, size, pages = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not a version {VERSION} snapshot")
+        metadata = json.loads(f.read(size).decode("utf-8"))
+        slots = array("Q")
+        slots.frombytes(f.read(pages * 8))
+        hashes = array("Q")
+        hashes.frombytes(f.read(pages * 8))
+    if len(slots) != pages or len(hashes) != pages:
+        raise ValueError(f"{path}: truncated snapshot")
+    metadata["runs"] = [tuple(run) for run in metadata["runs"]]
+    return metadata, slots, hashes
+
+
+class SnapshotStore:
+    """The snapshots in `directory`, oldest first, and take() to add one."""
+
+    def __init__(self, directory):
+
+        self.directory = directory
+        os.makedirs(directory, exist_ok=True)
+
+    def path(self, number):
+        return os.path.join(self.directory, f"{number:06d}{SUFFIX}")
+
+    def snapshots(self):
+        """Metadata of every snapshot, oldest first."""
+
+        result = []
+        for name in sorted(os.listdir(self.directory)):
+            if name.endswith(SUFFIX) and name[:-len(SUFFIX)].isdigit():
+                result.append(read_manifest(os.path.join(self.directory, name))[0])
+        return result
+
+    def take(self, lib, vm_handle, threads=4, chunk_size=0x200000, progress=None):
+        """Acquire a snapshot of the VM; returns its metadata with the page counters."""
+
+        start = time.perf_counter()
+        runs = lib.GetMemoryRuns(vm_handle) if hasattr(lib, "GetMemoryRuns") else None
+        if not runs:
+            runs = [(0, lib.GetData(vm_handle, HvmmInformationClass.InfoMmMaximumPhysicalPage) * PAGE_SIZE)]
+        runs = [tuple(run) for run in runs]
+        pages = (runs[-1][0] + runs[-1][1]) // PAGE_SIZE
+        guid = str(lib.GetData(vm_handle, HvmmInformationClass.InfoVmGuidString)).lower()
+
+        snapshots = self.snapshots()
+        number = snapshots[-1]["id"] + 1 if snapshots else 1
+        parent = next((snapshot for snapshot in reversed(snapshots) if snapshot["vm_guid"] == guid), None)
+        if parent is not None:
+            _, parent_slots, parent_hashes = read_manifest(self.path(parent["id"]))
+        else:
+            parent_slots = parent_hashes = array("Q")
+        known = min(pages, len(parent_hashes))
+
+        slots = array("Q", bytes(pages * 8))
+        hashes = array("Q", bytes(pages * 8))
+        counters = {"changed": 0, "unchanged": 0, "zero": 0, "unreadable": 0}
+        buffers = BufferPool(max_size=chunk_size, keep=max(1, threads) * 2)
+
+        def work(chunk):
+            # Reader thread: hash the pages, keep the data of the changed ones
+            address, size, _ = chunk
+            data, failed = read_chunk(lib, vm_handle, buffers, address, size)
+            view = memoryview(data)
+            first = address // PAGE_SIZE
+            chunk_hashes = []
+            changed = []
+            zero = []
+            for index in range(size // PAGE_SIZE):
+                page = first + index
+                value = page_hash(view[index * PAGE_SIZE:(index + 1) * PAGE_SIZE])
+                chunk_hashes.append(value)
+                if page < known and parent_hashes[page] == value:
+                    continue
+                if value == ZERO_HASH and data.startswith(ZERO_PAGE, index * PAGE_SIZE):
+                    zero.append(page)
+                else:
+                    changed.append((page, view[index * PAGE_SIZE:(index + 1) * PAGE_SIZE]))
+            return first, chunk_hashes, changed, zero, failed
+
+        pages_path = os.path.join(self.directory, PAGES_FILE)
+        with open(pages_path, "ab") as store:
+            slot = store.tell() // PAGE_SIZE + 1
+            if store.tell() % PAGE_SIZE:
+                raise ValueError(f"{pages_path} is not a whole number of pages")
+            chunks = plan(runs, "padded", chunk_size)[0]
+            with contextlib.closing(read_chunks(chunks, work, threads)) as results:
+                for done, (first, chunk_hashes, changed, zero, failed) in enumerate(results, 1):
+                    end = first + len(chunk_hashes)
+                    hashes[first:end] = array("Q", chunk_hashes)
+                    # Unchanged pages keep the parent's slot, zero pages have none
+                    if first < known:
+                        slots[first:min(end, known)] = parent_slots[first:min(end, known)]
+                    for page in zero:
+                        slots[page] = 0
+                    for page, _ in changed:
+                        slots[page] = slot
+                        slot += 1
+                    store.write(b"".join(data for _, data in changed))
+                    counters["changed"] += len(changed)
+                    counters["zero"] += len(zero)
+                    counters["unchanged"] += len(chunk_hashes) - len(changed) - len(zero)
+                    counters["unreadable"] += failed
+                    if progress is not None:
+                        progress(done, len(chunks))
+            store.flush()
+            os.fsync(store.fileno())
+
+        metadata = {
+            "id": number,
+            "parent": parent["id"] if parent else None,
+            "time": time.time(),
+            "vm_guid": guid,
+            "name": str(lib.GetData(vm_handle, HvmmInformationClass.InfoPartitionFriendlyName)),
+            "directory_table_base": lib.GetData(vm_handle, HvmmInformationClass.InfoDirectoryTableBase) or 0,
+            "runs": runs,
+            "pages": pages,
+            **counters,
+            "bytes_written": counters["changed"] * PAGE_SIZE,
+            "seconds": time.perf_counter() - start,
+        }
+        text = json.dumps(metadata).encode("utf-8")
+        temporary = self.path(number) + ".tmp"
+        with open(temporary, "wb") as f:
+            f.write(HEADER.pack(MAGIC, VERSION, 0, len(text), pages) + text)
+            slots.tofile(f)
+            hashes.tofile(f)
+        os.replace(temporary, self.path(number))
+        return metadata
+
+
+class SnapshotImage:
+    """A snapshot as a memory image for hvfile: the MemoryImage attributes and read/write.
+
+    Writes go to a private copy of the pages, never to the store.
+    """
+
+    def __init__(self, path):
+
+        self.path = os.path.abspath(path)
+        self.name = os.path.basename(path)
+        self.guid = str(uuid.uuid5(uuid.NAMESPACE_URL, "file:" + self.path))
+        self.kind = "Snapshot"
+
+        self.metadata, self._slots, _ = read_manifest(path)
+        self.directory_table_base = self.metadata.get("directory_table_base", 0)
+        self.runs = [(address, None, size) for address, size in self.metadata["runs"]]
+        self._starts = [address for address, _, _ in self.runs]
+        self.maximum_address = self.metadata["pages"] * PAGE_SIZE
+        self.page_runs = [(address // PAGE_SIZE, size // PAGE_SIZE) for address, _, size in self.runs]
+        self._written = {}
+
+        self._map = None
+        self._base = 0
+        pages_path = os.path.join(os.path.dirname(self.path), PAGES_FILE)
+        if os.path.getsize(pages_path):
+            # Copy-on-write like MemoryImage, only so ctypes can take its address
+            with open(pages_path, "rb") as f:
+                self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_COPY)
+            self._base = ctypes.addressof(ctypes.c_char.from_buffer(self._map))
+
+    def _backed(self, address, size):
+
+        index = bisect.bisect_right(self._starts, address) - 1
+        if index < 0:
+            return False
+        start, _, length = self.runs[index]
+        return address + size <= start + length
+
+    def _page(self, page):
+        """Address of the page's data (an int, or the written copy), None for a zero page."""
+
+        written = self._written.get(page)
+        if written is not None:
+            return written
+        slot = self._slots[page]
+        return self._base + (slot - 1) * PAGE_SIZE if slot else None
+
+    def read(self, address, size, buffer):
+
+        if not self._backed(address, size):
+            return False
+        target = ctypes.addressof(buffer) if isinstance(buffer, ctypes.Array) else buffer
+        while size > 0:
+            offset = address % PAGE_SIZE
+            chunk = min(size, PAGE_SIZE - offset)
+            source = self._page(address // PAGE_SIZE)
+            if source is None:
+                ctypes.memset(target, 0, chunk)
+            elif isinstance(source, int):
+                ctypes.memmove(target, source + offset, chunk)
+            else:
+                ctypes.memmove(target, bytes(source[offset:offset + chunk]), chunk)
+            address += chunk
+            target += chunk
+            size -= chunk
+        return True
+
+    def write(self, address, size, buffer):
+
+        if not self._backed(address, size):
+            return False
+        data = bytes(buffer[:size]) if not isinstance(buffer, ctypes.Array) else buffer.raw[:size]
+        position = 0
+        while position < size:
+            page = (address + position) // PAGE_SIZE
+            offset = (address + position) % PAGE_SIZE
+            chunk = min(size - position, PAGE_SIZE - offset)
+            if page not in self._written:
+                current = self._page(page)
+                self._written[page] = bytearray(ctypes.string_at(current, PAGE_SIZE) if current else ZERO_PAGE)
+            self._written[page][offset:offset + chunk] = data[position:position + chunk]
+            position += chunk
+        return True
+
+
+def main(argv=None):
+
+    parser = argparse.ArgumentParser(prog="python -m hvlib.snapshot",
+                                     description="Incremental memory snapshots of Hyper-V VMs")
+    commands = parser.add_subparsers(dest="command", required=True)
+    take = commands.add_parser("take", help="add a snapshot of a VM to the store")
+    take.add_argument("store")
+    take.add_argument("vm", help="VM GUID or index in the partition list")
+    take.add_argument("--threads", type=int, default=4)
+    take.add_argument("--image", action="append", help="memory image to read instead of a VM (hvfile)")
+    take.add_argument("--latency-us", type=float, default=0, help="simulated driver latency with --image")
+    listing = commands.add_parser("list", help="list the snapshots of a store")
+    listing.add_argument("store")
+    args = parser.parse_args(sys.argv[1:] if argv is None else argv)
+
+    store = SnapshotStore(args.store)
+    if args.command == "list":
+        for snapshot in store.snapshots():
+            print(f"{store.path(snapshot['id'])}  {time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(snapshot['time']))}  "
+                  f"{snapshot['name']} {snapshot['vm_guid']}  {snapshot['changed']} pages stored, "
+                  f"{snapshot['unchanged']} unchanged, {snapshot['zero']} zero")
+        return 0
+
+    lib, vm_handle = open_vm(args.vm, args.image, args.latency_us / 1000000)
+    try:
+        snapshot = store.take(lib, vm_handle, args.threads, progress=progress_printer())
+    finally:
+        lib.cleanup()
+    print(file=sys.stderr)
+    print(f"{store.path(snapshot['id'])}: {snapshot['changed']} pages stored "
+          f"({snapshot['bytes_written'] / 0x100000:.0f} MB), {snapshot['unchanged']} unchanged, "
+          f"{snapshot['zero']} zero, {snapshot['unreadable']} unreadable, {snapshot['seconds']:.1f} s")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
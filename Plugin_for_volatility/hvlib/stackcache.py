@@ -0,0 +1,110 @@
+#
+#  Stacking results kept between volatility runs
+#  GPL3 License
+#
+#  LayerStacker finds the layers of a VM by scanning guest memory (DTB,
+#  kernel base) on every run. StackCache keeps what it found, the layer
+#  configuration volatility builds from it, in one JSON file:
+#
+#      {"version": 1,
+#       "vms": {"<VM GUID>": {"identity": {...},
+#                             "requirement": "<requirement path under the plugin>",
+#                             "config": {"<dotted path>": value, ...},
+#                             "saved": <time>}}}
+#
+#  An entry is used only while the VM is in the same boot. The identity is
+#  made of values hvlib already knows (kernel base, directory table base,
+#  build number, memory size) and a hash of one guest page: the kernel
+#  image header, or the DTB page when hvlib has no kernel base. A reboot
+#  or a restored checkpoint changes it and the VM is stacked again. The
+#  caller may add its own keys (the stackers it runs) to the identity.
+#
+#  The file is replaced, never written in place, so a run that is killed
+#  leaves the previous cache.
+#
+
+import json
+import os
+import time
+
+from .hvlib import HvmmInformationClass
+from .snapshot import page_hash
+
+PAGE_SIZE = 0x1000
+
+CACHE_VERSION = 1
+
+
+def boot_identity(lib, vm_handle):
+    """Values that stay the same while the VM runs and change when it boots again."""
+
+    identity = {
+        "kernel_base": lib.GetData(vm_handle, HvmmInformationClass.InfoKernelBase),
+        "directory_table_base": lib.GetData(vm_handle, HvmmInformationClass.InfoDirectoryTableBase),
+        "build": lib.GetData(vm_handle, HvmmInformationClass.InfoNtBuildNumber),
+        "pages": lib.GetData(vm_handle, HvmmInformationClass.InfoMmMaximumPhysicalPage),
+    }
+    page = bytearray(PAGE_SIZE)
+    if identity["kernel_base"] and identity["directory_table_base"] and hasattr(lib, "ReadVirtualPartial"):
+        done = lib.ReadVirtualPartial(vm_handle, identity["kernel_base"], page,
+                                      directory_table_base = identity["directory_table_base"])
+        read = done == [(0, PAGE_SIZE)]
+    elif identity["directory_table_base"]:
+        read = lib.ReadPhysicalInto(vm_handle, identity["directory_table_base"] & ~(PAGE_SIZE - 1), page)
+    else:
+        read = False
+    identity["page_hash"] = page_hash(page) if read else None
+    return identity
+
+
+class StackCache:
+    """Layer configurations per VM GUID in the JSON file at `path`."""
+
+    def __init__(self, path):
+
+        self.path = path
+
+    def _load(self):
+        try:
+            with open(self.path, "r") as f:
+                cache = json.load(f)
+        except (OSError, ValueError):
+            return {}
+        if not isinstance(cache, dict) or cache.get("version") != CACHE_VERSION:
+            return {}
+        vms = cache.get("vms")
+        return vms if isinstance(vms, dict) else {}
+
+    def _store(self, vms):
+        temporary = self.path + ".tmp"
+        with open(temporary, "w") as f:
+            json.dump({"version": CACHE_VERSION, "vms": vms}, f, indent = 1, sort_keys = True)
+        os.replace(temporary, self.path)
+
+    def load(self, vm_guid, identity):
+        """(requirement path, flat configuration) saved for this boot of the VM, or None."""
+
+        entry = self._load().get(vm_guid.lower())
+        if not entry or entry.get("identity") != identity:
+            return None
+        if not isinstance(entry.get("requirement"), str) or not isinstance(entry.get("config"), dict):
+            return None
+        return entry["requirement"], entry["config"]
+
+    def save(self, vm_guid, identity, requirement, config):
+        """Keep the configuration of a VM, replacing what was saved for its previous boot."""
+
+        vms = self._load()
+        vms[vm_guid.lower()] = {"identity": identity, "requirement": requirement, "config": dict(config),
+                                "saved": int(time.time())}
+        self._store(vms)
+
+    def forget(self, vm_guid=None):
+        """Drop one VM (all of them when None)."""
+
+        vms = self._load()
+        if vm_guid is None:
+            vms = {}
+        elif vms.pop(vm_guid.lower(), None) is None:
+            return
+        self._store(vms)
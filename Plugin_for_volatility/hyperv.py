@@ -3,49 +3,154 @@
 # Modified version for Hyper-V memory access plugin integration
 #
 
+import bisect
 import logging
 import os
 import sys
 import threading
-from typing import Any, Dict, List, Optional, Union
+from typing import Any, Dict, Iterable, List, Optional, Tuple, Union
 
 from hvlib import *
+from hvlib.blockcache import BlockCache
+from hvlib.bufferpool import BufferPool
+from hvlib.hvfile import hvfile
+from hvlib.readlog import ReadLog
 from volatility3.framework import exceptions, interfaces, constants
 from volatility3.framework.configuration import requirements
 
-g_lkd_handle = 0
-g_vm_handle = 0
-
 vollog = logging.getLogger(__name__)
 
-# --- Diagnostic read logger for Volatility scan analysis ---
-_HVLOG_PATH = os.path.join(os.environ.get("TEMP", "."), "hyperv_reads.log")
+# --- hvlib sessions ---
+# One hvlib instance per process and one partition handle per VM GUID. Layers pickle
+# only the GUID and read method; a worker process opens its own session on first use.
+_hvlib_instance = None
+_hvlib_pid = 0
+_partitions: Dict[str, int] = {}
+_default_guid: Optional[str] = None
+
+
+def _load_hvlib():
+    # HYPERV_IMAGE=<image>[<os.pathsep><image>...] serves memory images through the hvlib
+    # API instead of hvlib.dll (hvlib/hvfile.py), with HYPERV_IMAGE_LATENCY_US per call
+    images = os.environ.get("HYPERV_IMAGE")
+    if images:
+        latency = float(os.environ.get("HYPERV_IMAGE_LATENCY_US", "0")) / 1000000
+        return hvfile(images.split(os.pathsep), latency = latency)
+    dll_path = os.path.join(sys.exec_prefix, "Lib", "site-packages", "hvlib", "hvlib.dll")
+    return hvlib(dll_path)
+
+
+def _open_partition(vm_guid: Optional[str] = None, read_method: Optional[int] = None):
+    """(hvlib, partition handle, VM GUID) of this process for a VM.
+
+    Without vm_guid: the VM already opened, else HYPERV_VM_GUID, else the user picks
+    one from the list as before. Returns (None, 0, None) if no partition is found.
+    """
+    global _hvlib_instance, _hvlib_pid, _partitions, _default_guid
+
+    if _hvlib_pid != os.getpid():
+        # First call in this process (or a forked child): nothing is open here yet
+        _hvlib_instance, _hvlib_pid, _partitions, _default_guid = None, os.getpid(), {}, None
+
+    if vm_guid is None:
+        vm_guid = _default_guid or os.environ.get("HYPERV_VM_GUID") or None
+    if vm_guid is not None and vm_guid.lower() in _partitions:
+        return _hvlib_instance, _partitions[vm_guid.lower()], vm_guid.lower()
+
+    if _hvlib_instance is None:
+        _hvlib_instance = _load_hvlib()
+    lkd_handle = _hvlib_instance
+
+    vm_ops = lkd_handle.vm_ops
+    vm_ops.LogLevel = 1
+    if read_method is not None:
+        vm_ops.ReadMethod = read_method
+
+    b_result = lkd_handle.EnumPartitions(vm_ops)
+
+    if b_result == False:
+        print("EnumPartitions false")
+        return None, 0, None
+
+    if vm_guid is None:
+        print("Select virtual machine ID:")
+        vm_id = int(input('').split(" ")[0])
+        #vm_id = 0
+    else:
+        guids = [str(lkd_handle.GetData(partition, HvmmInformationClass.InfoVmGuidString)).lower()
+                 for partition in lkd_handle.PartitionArray]
+        if vm_guid.lower() not in guids:
+            print(f"VM {vm_guid} is not running")
+            return None, 0, None
+        vm_id = guids.index(vm_guid.lower())
+
+    vm_handle = lkd_handle.SelectPartition(vm_id)
+    if not vm_handle:
+        return None, 0, None
+
+    vm_guid = str(lkd_handle.GetData(vm_handle, HvmmInformationClass.InfoVmGuidString)).lower()
+    _partitions[vm_guid] = vm_handle
+    if _default_guid is None:
+        _default_guid = vm_guid
+    return lkd_handle, vm_handle, vm_guid
+
+
+def _close_partitions():
+    """Close every partition of this process and unload hvlib (cleanup())."""
+    global _hvlib_instance, _partitions, _default_guid
+    if _hvlib_instance is not None and _hvlib_pid == os.getpid():
+        _hvlib_instance.cleanup()
+    _hvlib_instance, _partitions, _default_guid = None, {}, None
+
+# --- Diagnostic read log (hvlib/readlog.py) ---
+# Binary records written by a background thread, convert them with
+#   python -m hvlib.readlog hyperv_reads.hvrl > hyperv_reads.csv
+# HYPERV_READLOG=0 turns the log off, HYPERV_READLOG_SAMPLE=N keeps 1 of N complete reads.
+# Worker processes log to hyperv_reads.<pid>.hvrl next to it, never to the file of the parent.
+_HVLOG_PATH = os.environ.get("HYPERV_READLOG", os.path.join(os.environ.get("TEMP", "."), "hyperv_reads.hvrl"))
+_HVLOG_SAMPLE = int(os.environ.get("HYPERV_READLOG_SAMPLE", "1"), 0)
 _hvlog_file = None
-_hvlog_lock = threading.Lock()
+_hvlog_pid = 0
+
+
+def _hvlog_path(worker: bool) -> str:
+    if not worker:
+        return _HVLOG_PATH
+    root, extension = os.path.splitext(_HVLOG_PATH)
+    return f"{root}.{os.getpid()}{extension}"
 
 
-def _hvlog_init():
-    global _hvlog_file
+def _hvlog_init(worker: bool = False):
+    """ReadLog.log of this process, or None if logging is off.
+
+    worker: the caller is an unpickled layer. A forked child is a worker too; the
+    log it inherits has no writer thread and shares the parent's file, so it is dropped.
+    """
+    global _hvlog_file, _hvlog_pid
+    if _hvlog_pid != os.getpid():
+        worker = worker or _hvlog_pid != 0
+        _hvlog_file, _hvlog_pid = None, os.getpid()
     if _hvlog_file is None:
-        try:
-            _hvlog_file = open(_HVLOG_PATH, "w")
-            _hvlog_file.write("action,offset_hex,length_hex,length_dec,returned_hex,returned_dec,status\n")
-            _hvlog_file.flush()
-            print(f"[hyperv] Read log: {_HVLOG_PATH}", file=sys.stderr)
-        except Exception:
-            _hvlog_file = False  # Disable on error
-
-
-def _hvlog(offset: int, length: int, returned: int, status: str):
-    global _hvlog_file
-    with _hvlog_lock:
-        if _hvlog_file is None:
-            _hvlog_init()
-        if _hvlog_file and _hvlog_file is not False:
-            _hvlog_file.write(
-                f"read,0x{offset:X},0x{length:X},{length},0x{returned:X},{returned},{status}\n"
-            )
-            _hvlog_file.flush()
+        _hvlog_file = False
+        if _HVLOG_PATH not in ("", "0", "off"):
+            path = _hvlog_path(worker)
+            try:
+                _hvlog_file = ReadLog(path, sample = _HVLOG_SAMPLE)
+                print(f"[hyperv] Read log: {path}", file=sys.stderr)
+            except Exception:
+                _hvlog_file = False  # Disable on error
+    return _hvlog_file.log if _hvlog_file else None
+
+
+# --- Physical read cache (hvlib/blockcache.py) ---
+# HYPERV_CACHE_MB=0 turns it off; HYPERV_READAHEAD=0 keeps the cache without read-ahead.
+_CACHE_BLOCK_SIZE = int(os.environ.get("HYPERV_CACHE_BLOCK", "0x10000"), 0)
+_CACHE_SIZE = int(os.environ.get("HYPERV_CACHE_MB", "256"), 0) * 0x100000
+_CACHE_READAHEAD = int(os.environ.get("HYPERV_READAHEAD", "4"), 0)
+
+# --- Batched reads (FileLayer.read_ranges -> hvlib.ReadPhysicalScatter) ---
+# Threads issuing the merged runs of one batch; 1 keeps the driver calls sequential.
+_SCATTER_WORKERS = int(os.environ.get("HYPERV_SCATTER_WORKERS", "1"), 0)
 
 
 class BufferDataLayer(interfaces.layers.DataLayerInterface):
@@ -119,49 +224,50 @@ class FileLayer(interfaces.layers.DataLayerInterface):
                  metadata: Optional[Dict[str, Any]] = None) -> None:
         super().__init__(context = context, config_path = config_path, name = name, metadata = metadata)
 
-        global g_lkd_handle
-        global g_vm_handle
-
-        if g_lkd_handle == 0:
-
-            dll_path = os.path.join(sys.exec_prefix, "Lib", "site-packages", "hvlib", "hvlib.dll")
-            lkd_handle = hvlib(dll_path)
-            g_lkd_handle = lkd_handle
-
-            vm_ops = lkd_handle.vm_ops
-            vm_ops.LogLevel = 1
-
-            b_result = lkd_handle.EnumPartitions(vm_ops)
-
-            if b_result == False:
-                print("EnumPartitions false")
-                return None
-
-            print("Select virtual machine ID:")
-            vm_id = int(input('').split(" ")[0])
-            #vm_id = 0
-
-            vm_handle = lkd_handle.SelectPartition(vm_id)
-            g_vm_handle = vm_handle
-            self._lkd_handle = lkd_handle
-            self._vm_handle = vm_handle
-        else:
-            self._lkd_handle = g_lkd_handle
-            self._vm_handle = g_vm_handle
-            lkd_handle = g_lkd_handle
-            vm_handle = g_vm_handle
+        self._lkd_handle, self._vm_handle, self._vm_guid = _open_partition()
+        if self._lkd_handle is None:
+            return None
+        self._read_method = int(self._lkd_handle.vm_ops.ReadMethod)
 
         self._location = self.config["location"]
         # NOTE: Do NOT open the file via ResourceAccessor/urllib here.
         # After hvlib.dll loads hvmm.sys driver, urllib's importlib._path_stat
         # triggers an access violation (segfault).  The hyperv layer reads
         # live VM memory through hvlib, so the file handle is unnecessary.
-        self._maximum_address: int = lkd_handle.GetData(vm_handle, HvmmInformationClass.InfoMmMaximumPhysicalPage) * 0x1000
+        self._maximum_address: int = self._lkd_handle.GetData(self._vm_handle, HvmmInformationClass.InfoMmMaximumPhysicalPage) * 0x1000
+
+        # Backed guest memory (MmPhysicalMemoryBlock runs). Reads in the gaps (MMIO, unmapped)
+        # fail here without a driver call and scans skip them. An hvlib.py without GetMemoryRuns
+        # or a partition that does not report runs leaves _runs empty: one range as before.
+        get_runs = getattr(self._lkd_handle, "GetMemoryRuns", None)
+        self._runs: List[Tuple[int, int]] = (get_runs(self._vm_handle) if get_runs else None) or []
+        self._run_starts = [address for address, _ in self._runs]
+        self._setup_process_state()
+
+    def _setup_process_state(self, worker: bool = False) -> None:
+        """Lock, buffers, cache and log: the parts of the layer that stay in their process."""
+
+        self._hvlog = _hvlog_init(worker)
         # Construct the lock now (shared if made before threading) in case we ever need it
         self._lock: Union[DummyLock, threading.Lock] = DummyLock()
         if constants.PARALLELISM == constants.Parallelism.Threading:
             self._lock = threading.Lock()
 
+        # Reads go straight into a page-aligned buffer from the pool; an hvlib.py
+        # older than ReadPhysicalInto gets a new ctypes buffer per read as before.
+        self._read_into = getattr(self._lkd_handle, "ReadPhysicalInto", None)
+        self._buffers = BufferPool()
+        self._scratch = self._buffers.acquire(0x1000)
+
+        # Guest memory is read in aligned blocks and kept; a read-ahead thread
+        # also calls into hvlib, so the lock is always a real one then.
+        self._cache: Optional[BlockCache] = None
+        if _CACHE_SIZE > 0:
+            self._lock = threading.Lock()
+            self._cache = BlockCache(self._read_block, _CACHE_BLOCK_SIZE, _CACHE_SIZE,
+                                     readahead = _CACHE_READAHEAD, limit = self._maximum_address,
+                                     lock = self._lock)
+
     @property
     def location(self) -> str:
         """Returns the location on which this Layer abstracts."""
@@ -177,11 +283,84 @@ class FileLayer(interfaces.layers.DataLayerInterface):
         """Returns the smallest available address in the space."""
         return 0
 
+    @property
+    def runs(self) -> List[Tuple[int, int]]:
+        """(address, size) runs of backed guest physical memory; the gaps are MMIO or unmapped."""
+        return list(self._runs) if self._runs else [(self.minimum_address, self.maximum_address)]
+
+    def _unbacked(self, offset: int, length: int) -> Optional[int]:
+        """First address of [offset, offset + length) outside the runs, None if it is all backed."""
+        index = bisect.bisect_right(self._run_starts, offset) - 1
+        if index < 0:
+            return offset
+        start, size = self._runs[index]
+        if offset >= start + size:
+            return offset
+        # Adjacent runs are merged, so the next one starts after a gap
+        return None if offset + length <= start + size else start + size
+
+    def _backed(self, offset: int, length: int) -> List[Tuple[int, int]]:
+        """The parts of [offset, offset + length) inside the runs."""
+        end = offset + length
+        pieces = []
+        for start, size in self._runs[max(0, bisect.bisect_right(self._run_starts, offset) - 1):]:
+            if start >= end:
+                break
+            low, high = max(start, offset), min(start + size, end)
+            if low < high:
+                pieces.append((low, high - low))
+        return pieces
+
+    @property
+    def cache_stats(self) -> Dict[str, Any]:
+        """Hit, miss, eviction and read-ahead counters of the block cache."""
+        return self._cache.stats() if self._cache else {}
+
+    def _connect(self) -> None:
+        """Open the partition in this process (after unpickling in a worker)."""
+        self._lkd_handle, self._vm_handle, _ = _open_partition(self._vm_guid, self._read_method)
+        if self._lkd_handle is None:
+            raise exceptions.LayerException(self.name, f"Cannot open VM {self._vm_guid} in process {os.getpid()}")
+        self._read_into = getattr(self._lkd_handle, "ReadPhysicalInto", None)
+
+    def _read_physical(self, offset: int, length: int) -> Optional[bytes]:
+        """One driver read (and the cache fill): the bytes, or None if hvlib fails."""
+        if self._lkd_handle is None:
+            self._connect()
+        if self._read_into is None:
+            data = self._lkd_handle.ReadPhysicalMemoryBlock(self._vm_handle, offset, length)
+            return data.raw if data else None
+        # Callers hold self._lock (the cache takes it for its fills too), so one
+        # scratch buffer from the pool serves every read up to the pool's max_size
+        buffer = self._scratch
+        if len(buffer) < length:
+            if length > self._buffers.max_size:
+                buffer = self._buffers.acquire(length)
+            else:
+                self._buffers.release(buffer)
+                buffer = self._scratch = self._buffers.acquire(length)
+        return buffer[:length] if self._read_into(self._vm_handle, offset, buffer, length) else None
+
+    def _read_block(self, offset: int, length: int) -> Optional[bytes]:
+        """Cache fill: a block reaching into a gap reads its backed parts, the rest stays zero
+        (never served: read() rejects unbacked ranges before the cache)."""
+        if not self._runs or self._unbacked(offset, length) is None:
+            return self._read_physical(offset, length)
+        block = bytearray(length)
+        for start, size in self._backed(offset, length):
+            data = self._read_physical(start, size)
+            if data is None:
+                return None
+            block[start - offset:start - offset + size] = data
+        return bytes(block)
+
     def is_valid(self, offset: int, length: int = 1) -> bool:
         """Returns whether the offset is valid or not."""
         if length <= 0:
             raise ValueError("Length must be positive")
 
+        if self._runs:
+            return offset >= self.minimum_address and self._unbacked(offset, length) is None
         return bool(self.minimum_address <= offset <= (self.maximum_address + 0x2000) # 0x2000 size of DUMP_HEADER64
                     and self.minimum_address <= offset + length - 1 <= self.maximum_address + 0x2000)
 
@@ -189,40 +368,143 @@ class FileLayer(interfaces.layers.DataLayerInterface):
         """Reads from the file at offset for length."""
 
         if not self.is_valid(offset, length):
-            _hvlog(offset, length, 0, "INVALID_RANGE")
+            if self._runs and offset >= self.minimum_address:
+                if pad:
+                    # Backed parts from the VM, gaps as zeros
+                    data = bytearray(length)
+                    for start, size in self._backed(offset, length):
+                        data[start - offset:start - offset + size] = self.read(start, size, pad)
+                    return bytes(data)
+                if self._hvlog is not None:
+                    self._hvlog(offset, length, 0, "NOT_BACKED")
+                raise exceptions.InvalidAddressException(self.name, self._unbacked(offset, length),
+                                                         "Address is not backed by guest memory")
+            if self._hvlog is not None:
+                self._hvlog(offset, length, 0, "INVALID_RANGE")
             invalid_address = offset
             if self.minimum_address < offset <= self.maximum_address:
                 invalid_address = self.maximum_address + 1
             raise exceptions.InvalidAddressException(self.name, invalid_address,
                                                      "Offset outside of the buffer boundaries")
 
+        if self._cache is not None:
+            data = self._cache.read(offset, length)
+            if data is not None:
+                if self._hvlog is not None:
+                    self._hvlog(offset, length, length, "CACHED")
+                return data
+
         with self._lock:
             try:
-                data = self._lkd_handle.ReadPhysicalMemoryBlock(self._vm_handle, offset, length)
+                data = self._read_physical(offset, length)
             except Exception as e:
-                _hvlog(offset, length, 0, f"EXCEPTION:{type(e).__name__}:{e}")
+                if self._hvlog is not None:
+                    # The type only: the message is re-raised below, and one status per
+                    # distinct message would grow the log's status table without bound
+                    self._hvlog(offset, length, 0, f"EXCEPTION:{type(e).__name__}")
                 raise
 
-        if data == 0:
-            # ReadPhysicalMemoryBlock returns 0 on failure
-            _hvlog(offset, length, 0, "SDK_READ_FAILED")
+        if data is None:
+            # hvlib reads all or nothing
+            if self._hvlog is not None:
+                self._hvlog(offset, length, 0, "SDK_READ_FAILED")
             if pad:
                 return b"\x00" * length
             raise exceptions.InvalidAddressException(
                 self.name, offset, "ReadPhysicalMemoryBlock returned 0")
 
-        returned = len(data) if data else 0
-        if returned < length:
-            _hvlog(offset, length, returned, f"SHORT_READ(pad={pad})")
-            if pad:
-                data += (b"\x00" * (length - returned))
-            else:
-                raise exceptions.InvalidAddressException(
-                    self.name, offset + returned, "Could not read sufficient bytes from the " + self.name + " file")
-        else:
-            _hvlog(offset, length, returned, "OK")
+        if self._hvlog is not None:
+            self._hvlog(offset, length, length, "OK")
         return data
 
+    def read_ranges(self, ranges: List[Tuple[int, int]], pad: bool = False) -> List[bytes]:
+        """Reads a batch of (offset, length) ranges, e.g. page table entries or pool headers.
+
+        The ranges go to hvlib as one ReadPhysicalScatter call (sorted, with nearby ranges
+        merged into single driver reads) instead of one round trip each; with the block
+        cache on, the batch reads the missing cache blocks and the ranges come from there.
+        Unreadable ranges are zero padded with pad, otherwise the first one raises
+        InvalidAddressException, as read() does.
+        """
+
+        results: List[Optional[bytes]] = [None] * len(ranges)
+        missing = []
+        for index, (offset, length) in enumerate(ranges):
+            if not self.is_valid(offset, length):
+                if pad:
+                    results[index] = b"\x00" * length
+                    continue
+                raise exceptions.InvalidAddressException(self.name, offset, "Offset outside of the buffer boundaries")
+            missing.append(index)
+
+        if self._lkd_handle is None:
+            self._connect()
+        scatter = getattr(self._lkd_handle, "ReadPhysicalScatter", None)
+        if scatter is None:
+            for index in missing:
+                results[index] = self.read(ranges[index][0], ranges[index][1], pad)
+            return results
+
+        if self._cache is not None:
+            # Fill the uncached blocks in one batch, then serve the ranges from the cache
+            blocks = self._cache.missing([ranges[index] for index in missing])
+            if blocks:
+                out = bytearray(sum(size for _, size in blocks))
+                with self._lock:
+                    # Whole blocks: one driver read each, straight into out
+                    done = scatter(self._vm_handle, blocks, out, gap = 0, max_run = self._cache.block_size,
+                                   workers = _SCATTER_WORKERS)
+                view = memoryview(out)
+                position = 0
+                for (offset, size), ok in zip(blocks, done):
+                    if ok:
+                        self._cache.insert(offset, view[position:position + size])
+                    position += size
+            uncached = []
+            for index in missing:
+                offset, length = ranges[index]
+                results[index] = self._cache.read(offset, length)
+                if results[index] is None:
+                    uncached.append(index)
+                elif self._hvlog is not None:
+                    self._hvlog(offset, length, length, "CACHED")
+            missing = uncached
+
+        if not missing:
+            return results
+
+        batch = [ranges[index] for index in missing]
+        out = bytearray(sum(length for _, length in batch))
+        with self._lock:
+            done = scatter(self._vm_handle, batch, out, workers = _SCATTER_WORKERS)
+
+        view = memoryview(out)
+        position = 0
+        for index, (offset, length), ok in zip(missing, batch, done):
+            if not ok and not pad:
+                if self._hvlog is not None:
+                    self._hvlog(offset, length, 0, "SDK_READ_FAILED")
+                raise exceptions.InvalidAddressException(self.name, offset, "ReadPhysicalScatter failed")
+            if self._hvlog is not None:
+                self._hvlog(offset, length, length if ok else 0, "SCATTER" if ok else "SDK_READ_FAILED")
+            results[index] = bytes(view[position:position + length])
+            position += length
+        return results
+
+    def scan(self,
+             context: interfaces.context.ContextInterface,
+             scanner: interfaces.layers.ScannerInterface,
+             progress_callback: constants.ProgressCallback = None,
+             sections: Iterable[Tuple[int, int]] = None) -> Iterable[Any]:
+        """Scans the runs only: sections (the whole layer by default) are clipped to backed memory."""
+        if self._runs:
+            if sections is None:
+                sections = [(self.minimum_address, self.maximum_address - self.minimum_address)]
+            sections = [piece for offset, length in sections for piece in self._backed(offset, length)]
+            if not sections:
+                return iter(())
+        return super().scan(context, scanner, progress_callback, sections)
+
     def write(self, offset: int, data: bytes) -> None:
         """Writes to the VM physical memory via hvlib."""
         if not self.is_valid(offset, len(data)):
@@ -231,19 +513,36 @@ class FileLayer(interfaces.layers.DataLayerInterface):
                 invalid_address = self.maximum_address + 1
             raise exceptions.InvalidAddressException(self.name, invalid_address,
                                                      "Data segment outside of the " + self.name + " file boundaries")
+        if self._lkd_handle is None:
+            self._connect()
         with self._lock:
             self._lkd_handle.WritePhysicalMemoryBlock(self._vm_handle, offset, data)
+        if self._cache is not None:
+            self._cache.invalidate(offset, len(data))
+
+    # Per-process members, rebuilt by _setup_process_state and _connect after unpickling
+    _PROCESS_STATE = ("_lkd_handle", "_vm_handle", "_read_into", "_hvlog", "_lock", "_buffers", "_scratch", "_cache")
 
     def __getstate__(self) -> Dict[str, Any]:
-        """Prepare state for pickling (multi-processing support)."""
-        return self.__dict__
+        """Prepare state for pickling (multi-processing support): the VM GUID and read
+        method identify the partition, handles and buffers stay in this process."""
+        return {key: value for key, value in self.__dict__.items() if key not in self._PROCESS_STATE}
+
+    def __setstate__(self, state: Dict[str, Any]) -> None:
+        self.__dict__.update(state)
+        self._lkd_handle = None
+        self._vm_handle = 0
+        self._read_into = None
+        self._setup_process_state(worker = True)
 
     def destroy(self) -> None:
-        """Closes the file handle."""
-        global g_lkd_handle
-        self._lkd_handle.cleanup()
-        g_lkd_handle = 0
-        g_vm_handle = 0
+        """Closes the partition and unloads hvlib in this process."""
+        if self._cache is not None:
+            self._cache.close()
+            vollog.info("Physical read cache: {hits} hits, {misses} misses, {readahead_hits}/{readahead_issued} "
+                        "read-ahead blocks used, {evictions} evictions".format(**self._cache.stats()))
+        _close_partitions()
+        self._lkd_handle = None
 
     def __exit__(self, type, value, traceback) -> None:
         self.destroy()
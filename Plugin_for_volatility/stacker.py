@@ -17,6 +17,7 @@ from typing import List, Optional, Tuple, Type
 
 import os
 from volatility3.framework.layers import hyperv  
+from hvlib.stackcache import StackCache, boot_identity
 
 from volatility3 import framework
 from volatility3.framework import interfaces, constants
@@ -26,6 +27,11 @@ from volatility3.framework.layers import physical
 
 vollog = logging.getLogger(__name__)
 
+# --- Stacking cache (hvlib/stackcache.py) ---
+# The layers stacked on a VM are kept per VM GUID and boot, so the next run skips the scans.
+# HYPERV_STACK_CACHE=<file> moves the cache, HYPERV_STACK_CACHE=0 turns it off.
+_STACK_CACHE_PATH = os.environ.get("HYPERV_STACK_CACHE", os.path.join(os.environ.get("TEMP", "."), "hyperv_stack.json"))
+
 
 class LayerStacker(interfaces.automagic.AutomagicInterface):
     """Builds up layers in a single stack.
@@ -134,8 +140,13 @@ class LayerStacker(interfaces.automagic.AutomagicInterface):
         dir_win = dir_win.replace('\\', '/').lower()
 
         hvlib_fn = "file:///" + dir_win + "/hvmm.dmp"
+        saved_stack = None
         if location.lower() == hvlib_fn:
             print("Hyper-V layer is active")
+            saved_stack = self._saved_stack()
+            if saved_stack and self._stack_from_saved(context, config_path, requirement, saved_stack):
+                print("Hyper-V layers restored from the stacking cache")
+                return None
             physical_layer = hyperv.FileLayer(new_context, current_config_path, current_layer_name)
         else:
             print("Standard physical_layer is active. hvmm.dmp file is not presented")
@@ -176,11 +187,102 @@ class LayerStacker(interfaces.automagic.AutomagicInterface):
                     context.config.get(path, None),
                     context.config.branch(path),
                 )
+                if saved_stack:
+                    self._save_stack(saved_stack, config_path, requirement, path)
         vollog.debug(
             f"physical_layer maximum_address: {physical_layer.maximum_address}"
         )
         vollog.debug(f"Stacked layers: {stacked_layers}")
 
+    def _saved_stack(self) -> Optional[Tuple[StackCache, str, dict]]:
+        """The stacking cache, GUID and identity of the VM the Hyper-V layer opens, None if off."""
+        if _STACK_CACHE_PATH in ("", "0", "off"):
+            return None
+        # Opens the partition the FileLayer is going to use (it asks for the VM here, once)
+        lkd_handle, vm_handle, vm_guid = hyperv._open_partition()
+        if lkd_handle is None:
+            return None
+        try:
+            identity = boot_identity(lkd_handle, vm_handle)
+        except Exception as excp:
+            vollog.debug(f"No boot identity for VM {vm_guid}: {excp}")
+            return None
+        # Stackers differ between OS plugin families, so they are part of what has to match
+        identity["stackers"] = sorted(self.config.get("stackers", None) or [])
+        return StackCache(_STACK_CACHE_PATH), vm_guid, identity
+
+    def _stack_from_saved(
+        self,
+        context: interfaces.context.ContextInterface,
+        config_path: str,
+        requirement: interfaces.configuration.RequirementInterface,
+        saved_stack: Tuple[StackCache, str, dict],
+    ) -> bool:
+        """Constructs the layers saved for this boot of the VM; False if there are none
+        or they do not construct any more."""
+        stack_cache, vm_guid, identity = saved_stack
+        saved = stack_cache.load(vm_guid, identity)
+        if not saved:
+            return False
+        relative_path, saved_config = saved
+        path = interfaces.configuration.path_join(
+            config_path, requirement.name, relative_path
+        )
+        if not self.find_layer_requirement(config_path, requirement, path):
+            return False
+
+        # Construct in a copy first, so a stale entry leaves the context as it was
+        new_context = context.clone()
+        try:
+            new_context.config.merge(
+                path, interfaces.configuration.HierarchicalDict(saved_config)
+            )
+            construct_layers.ConstructionMagic(
+                new_context,
+                interfaces.configuration.path_join(self.config_path, "ConstructionMagic"),
+            )(new_context, config_path, requirement)
+        except Exception as excp:
+            vollog.debug(f"Saved layers of VM {vm_guid} do not construct: {excp}")
+            return False
+        layer = new_context.config.get(path, None)
+        if layer not in new_context.layers:
+            vollog.debug(f"Saved layers of VM {vm_guid} do not construct")
+            return False
+
+        context.config.merge(path, new_context.layers[layer].build_configuration())
+        constructor = construct_layers.ConstructionMagic(
+            context,
+            interfaces.configuration.path_join(self.config_path, "ConstructionMagic"),
+        )
+        constructor(context, config_path, requirement)
+        self._cached = (context.config.get(path, None), context.config.branch(path))
+        vollog.debug(f"Stacked layers of VM {vm_guid} taken from {stack_cache.path}")
+        return True
+
+    def _save_stack(
+        self,
+        saved_stack: Tuple[StackCache, str, dict],
+        config_path: str,
+        requirement: interfaces.configuration.RequirementInterface,
+        path: str,
+    ) -> None:
+        """Keeps the configuration stacked at path for the next run against this boot of the VM."""
+        stack_cache, vm_guid, identity = saved_stack
+        # Relative to the plugin, so other plugins with the same requirement find it too
+        root = (
+            interfaces.configuration.path_join(config_path, requirement.name)
+            + interfaces.configuration.CONFIG_SEPARATOR
+        )
+        if not path.startswith(root):
+            return None
+        relative_path = path[len(root) :]
+        try:
+            stack_cache.save(
+                vm_guid, identity, relative_path, dict(self._cached[1])
+            )
+        except (OSError, TypeError, ValueError) as excp:
+            vollog.debug(f"Stacking cache {stack_cache.path} not written: {excp}")
+
     @classmethod
     def stack_layer(
         cls,
@@ -320,6 +422,25 @@ class LayerStacker(interfaces.automagic.AutomagicInterface):
                 return result
         return None
 
+    @classmethod
+    def find_layer_requirement(
+        cls,
+        config_path: str,
+        requirement: interfaces.configuration.RequirementInterface,
+        target_path: str,
+    ) -> bool:
+        """Whether a translation layer requirement of the tree has the configuration path target_path."""
+        child_config_path = interfaces.configuration.path_join(
+            config_path, requirement.name
+        )
+        if isinstance(requirement, requirements.TranslationLayerRequirement):
+            if child_config_path == target_path:
+                return True
+        return any(
+            cls.find_layer_requirement(child_config_path, req, target_path)
+            for req in requirement.requirements.values()
+        )
+
     @classmethod
     def get_requirements(cls) -> List[interfaces.configuration.RequirementInterface]:
         # This is not optional for the stacker to run, so optional must be marked as False
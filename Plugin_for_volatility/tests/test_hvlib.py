@@ -0,0 +1,813 @@
+#
+#  Tests for the pure Python parts of the hvlib package (no hvlib.dll needed)
+#
+#  python3 -m unittest discover -s Plugin_for_volatility/tests -v
+#
+
+import os
+import contextlib
+import ctypes
+import io
+import random
+import struct
+import sys
+import tempfile
+import threading
+import time
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+from hvlib.blockcache import BlockCache
+from hvlib.bufferpool import BufferPool
+from hvlib.hvdump import DMP_CONTEXT_RECORD, DMP_MAX_RUNS, Dump, dmp_header, expand
+from hvlib.hvfile import MemoryImage, hvfile
+from hvlib.hvlib import HvmmInformationClass
+from hvlib.hvlib import hvlib as HvLib
+from hvlib.readlog import ReadLog, read_records, to_csv
+from hvlib.snapshot import SnapshotStore
+from hvlib.stackcache import StackCache, boot_identity
+
+
+class MemoryReader:
+    """read_block over a bytearray: counts calls, fails inside `holes`."""
+
+    def __init__(self, size, holes=(), latency=0.0):
+        rng = random.Random(size)
+        self.memory = bytearray(rng.getrandbits(8) for _ in range(size))
+        self.holes = holes
+        self.latency = latency
+        self.calls = 0
+        self.lock = threading.Lock()
+
+    def __call__(self, offset, length):
+        with self.lock:
+            self.calls += 1
+        if self.latency:
+            time.sleep(self.latency)
+        for start, end in self.holes:
+            if offset < end and offset + length > start:
+                return None
+        return bytes(self.memory[offset:offset + length])
+
+
+class BlockCacheTest(unittest.TestCase):
+
+    def test_reads_match_source(self):
+        reader = MemoryReader(0x40000)
+        cache = BlockCache(reader, block_size=0x1000, capacity=0x100000, readahead=0, limit=0x40000)
+        rng = random.Random(1)
+        for _ in range(2000):
+            offset = rng.randrange(0, 0x40000 - 0x3000)
+            length = rng.choice((1, 8, 0x100, 0x1000, 0x2345))
+            self.assertEqual(cache.read(offset, length), bytes(reader.memory[offset:offset + length]))
+        stats = cache.stats()
+        self.assertEqual(stats["misses"], reader.calls)
+        self.assertGreater(stats["hits"], 10 * stats["misses"])
+
+    def test_unreadable_block_falls_back(self):
+        reader = MemoryReader(0x10000, holes=((0x5000, 0x6000),))
+        cache = BlockCache(reader, block_size=0x4000, readahead=0, limit=0x10000)
+        self.assertIsNone(cache.read(0x4ff0, 0x10))
+        self.assertEqual(cache.read(0x100, 0x10), bytes(reader.memory[0x100:0x110]))
+        self.assertIsNone(cache.read(0xfff0, 0x20))     # past the limit
+
+    def test_lru_is_bounded(self):
+        reader = MemoryReader(0x100000)
+        cache = BlockCache(reader, block_size=0x1000, capacity=0x8000, shards=2, readahead=0)
+        for offset in range(0, 0x100000, 0x1000):
+            cache.read(offset, 8)
+        stats = cache.stats()
+        self.assertLessEqual(stats["blocks"], 8)
+        self.assertEqual(stats["evictions"], 0x100 - stats["blocks"])
+
+    def test_stride_read_ahead(self):
+        reader = MemoryReader(0x200000, latency=0.0005)
+        cache = BlockCache(reader, block_size=0x1000, readahead=8, limit=0x200000)
+        for offset in range(0, 0x200000, 0x2000):       # every other page
+            self.assertEqual(cache.read(offset, 16), bytes(reader.memory[offset:offset + 16]))
+        cache.close()
+        stats = cache.stats()
+        self.assertGreater(stats["readahead_hits"], 0x100 * 3 // 4)
+        self.assertLess(stats["misses"], 0x100 // 4)
+
+    def test_invalidate_after_write(self):
+        reader = MemoryReader(0x10000)
+        cache = BlockCache(reader, block_size=0x1000, readahead=0)
+        self.assertEqual(cache.read(0x2000, 4), bytes(reader.memory[0x2000:0x2004]))
+        reader.memory[0x2000:0x2004] = b"\xde\xad\xbe\xef"
+        cache.invalidate(0x2000, 4)
+        self.assertEqual(cache.read(0x2000, 4), b"\xde\xad\xbe\xef")
+
+    def test_missing_and_insert(self):
+        reader = MemoryReader(0x10000)
+        cache = BlockCache(reader, block_size=0x1000, readahead=0, limit=0xF800)
+        cache.read(0x2000, 8)
+        self.assertEqual(cache.missing([(0x1FF8, 0x10), (0x2100, 8), (0xF000, 8)]),
+                         [(0x1000, 0x1000), (0xF000, 0x800)])
+        cache.insert(0x1000, reader.memory[0x1000:0x2000])
+        calls = reader.calls
+        self.assertEqual(cache.read(0x1FF8, 0x10), bytes(reader.memory[0x1FF8:0x2008]))
+        self.assertEqual(reader.calls, calls)
+
+    def test_block_size_checked(self):
+        for size in (0x800, 0x3000, 0x400000):
+            with self.assertRaises(ValueError):
+                BlockCache(MemoryReader(0x1000), block_size=size)
+
+
+class ReadLogTest(unittest.TestCase):
+
+    def setUp(self):
+        handle, self.path = tempfile.mkstemp(suffix=".hvrl")
+        os.close(handle)
+
+    def tearDown(self):
+        os.remove(self.path)
+
+    def test_records_round_trip(self):
+        log = ReadLog(self.path, interval=0.01)
+        threads = [threading.Thread(target=lambda base=base: [log.log(base + i * 0x1000, 0x1000, 0x1000, "OK")
+                                                              for i in range(500)])
+                   for base in range(0, 0x4000000, 0x1000000)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        log.log(0x7000, 8, 0, "SDK_READ_FAILED")
+        log.close()
+        records = list(read_records(self.path))
+        self.assertEqual(len(records), 2001)
+        self.assertEqual(sorted(r[0] for r in records[:-1]),
+                         sorted(base + i * 0x1000 for base in range(0, 0x4000000, 0x1000000) for i in range(500)))
+        self.assertEqual(records[-1][:4], (0x7000, 8, 0, "SDK_READ_FAILED"))
+
+    def test_sampling_keeps_failures(self):
+        log = ReadLog(self.path, sample=10)
+        for i in range(1000):
+            log.log(i, 16, 16, "CACHED")
+            if i % 100 == 0:
+                log.log(i, 16, 4, "SHORT_READ(pad=False)")
+        log.close()
+        statuses = [r[3] for r in read_records(self.path)]
+        self.assertEqual(statuses.count("CACHED"), 100)
+        self.assertEqual(statuses.count("SHORT_READ(pad=False)"), 10)
+
+    def test_csv_and_truncated_log(self):
+        log = ReadLog(self.path)
+        log.log(0x1000, 0x20, 0x20, "OK")
+        log.log(0x2000, 0x20, 0, "INVALID_RANGE")
+        log.close()
+        with open(self.path, "ab") as f:
+            f.write(b"\x00\x01")                       # half a record
+        out = io.StringIO()
+        to_csv(self.path, out)
+        lines = out.getvalue().splitlines()
+        self.assertEqual(len(lines), 3)
+        self.assertTrue(lines[1].startswith("read,0x1000,0x20,32,0x20,32,OK,"))
+        self.assertTrue(lines[2].startswith("read,0x2000,0x20,32,0x0,0,INVALID_RANGE,"))
+
+    def test_status_ids_run_out(self):
+        log = ReadLog(self.path, sample=1 << 20)
+        self.assertEqual(log.sample, 0xFFFF)
+        for i in range(0x10010):
+            log.log(i, 1, 0, f"EXCEPTION:{i}")
+        log.close()
+        self.assertIsNone(log.error)
+        statuses = [r[3] for r in read_records(self.path)]
+        self.assertEqual(len(statuses), 0x10010)
+        self.assertEqual(statuses[0xFFFE], "EXCEPTION:65534")
+        self.assertEqual(set(statuses[0xFFFF:]), {"OTHER"})
+
+    def test_write_error_reported(self):
+        class BrokenFile(io.RawIOBase):
+            def write(self, data):
+                raise OSError(28, "No space left on device")
+
+        log = ReadLog(self.path, interval=0.01)
+        real, log._file = log._file, BrokenFile()
+        real.close()
+        log.log(0x1000, 0x20, 0x20, "OK")
+        stderr = io.StringIO()
+        with contextlib.redirect_stderr(stderr):
+            log._writer.join(5)
+            log.close()
+        self.assertFalse(log._writer.is_alive())
+        self.assertIsInstance(log.error, OSError)
+        self.assertIn("No space left on device", stderr.getvalue())
+
+
+class FakeSdk:
+    """The two Sdk*Read* exports over a bytearray, with the DLL's signatures."""
+
+    def __init__(self, memory, holes=()):
+        self.memory = memory
+        self.holes = holes
+        self.calls = 0
+
+    def SdkReadPhysicalMemory(self, handle, address, size, buffer, method):
+        self.calls += 1
+        if address + size > len(self.memory):
+            return False
+        for start, end in self.holes:
+            if address < end and address + size > start:
+                return False
+        ctypes.memmove(buffer, bytes(self.memory[address:address + size]), size)
+        return True
+
+    def SdkReadVirtualMemory(self, handle, address, buffer, size):
+        return self.SdkReadPhysicalMemory(handle, address - 0xFFFF800000000000, size, buffer, 0)
+
+
+class ReadIntoTest(unittest.TestCase):
+
+    def setUp(self):
+        self.memory = MemoryReader(0x10000).memory
+        self.lib = HvLib.__new__(HvLib)
+        self.lib.hvlib = FakeSdk(self.memory)
+        self.lib.vm_ops = type("VmOps", (), {"ReadMethod": 0})()
+
+    def test_reads_into_caller_buffer(self):
+        buffer = bytearray(0x3000)
+        view = memoryview(buffer)
+        self.assertTrue(self.lib.ReadPhysicalInto(1, 0x2000, view[0x1000:0x1100]))
+        self.assertEqual(buffer[0x1000:0x1100], self.memory[0x2000:0x2100])
+        self.assertEqual(buffer[:0x1000], bytes(0x1000))
+        self.assertTrue(self.lib.ReadVirtualInto(1, 0xFFFF800000000010, buffer))
+        self.assertEqual(buffer, self.memory[0x10:0x3010])
+        self.assertFalse(self.lib.ReadPhysicalInto(1, 0xF000, bytearray(0x2000)))
+
+    def test_read_only_buffer_rejected(self):
+        with self.assertRaises(TypeError):
+            self.lib.ReadPhysicalInto(1, 0, b"\x00" * 16)
+
+    def test_size_past_buffer_rejected(self):
+        buffer = bytearray(0x200)
+        view = memoryview(buffer)
+        with self.assertRaises(ValueError):
+            self.lib.ReadPhysicalInto(1, 0, view[0x100:], 0x101)
+        with self.assertRaises(ValueError):
+            self.lib.ReadVirtualInto(1, 0xFFFF800000000000, (ctypes.c_char * 0x100).from_buffer(buffer), 0x200)
+        self.assertEqual(buffer, bytes(0x200))
+        self.assertTrue(self.lib.ReadPhysicalInto(1, 0x2000, view[0x100:], 0x100))
+        self.assertEqual(buffer[0x100:], self.memory[0x2000:0x2100])
+
+
+class ScatterTest(unittest.TestCase):
+
+    def setUp(self):
+        self.memory = MemoryReader(0x100000).memory
+        self.sdk = FakeSdk(self.memory, holes=((0x40000, 0x41000),))
+        self.lib = HvLib.__new__(HvLib)
+        self.lib.hvlib = self.sdk
+        self.lib.vm_ops = type("VmOps", (), {"ReadMethod": 0})()
+
+    def expected(self, ranges, done):
+        return b"".join(bytes(self.memory[a:a + n]) if ok else bytes(n) for (a, n), ok in zip(ranges, done))
+
+    def test_ranges_merged_and_in_order(self):
+        rng = random.Random(2)
+        ranges = [(page * 0x1000 + rng.randrange(0, 0xF00), 8) for page in rng.sample(range(0x20, 0x30), 16)]
+        ranges += [(0x20000, 0x100), (0x20080, 0x100), (0x7000, 0x3000)]      # overlap, larger than a page
+        out = bytearray(sum(n for _, n in ranges))
+        done = self.lib.ReadPhysicalScatter(1, ranges, out, gap=0x2000)
+        self.assertTrue(all(done))
+        self.assertEqual(bytes(out), self.expected(ranges, done))
+        self.assertEqual(self.sdk.calls, 2)          # 0x7000 run, then 0x20000..0x2FFFF
+
+    def test_hole_costs_only_its_ranges(self):
+        ranges = [(0x3F000 + i * 0x400, 0x10) for i in range(12)]          # pages 0x3F..0x41
+        out = bytearray(0x10 * 12)
+        done = self.lib.ReadPhysicalScatter(1, ranges, out)
+        self.assertEqual(done, [True] * 4 + [False] * 4 + [True] * 4)
+        self.assertEqual(bytes(out), self.expected(ranges, done))
+
+    def test_workers_and_short_buffer(self):
+        ranges = [(i * 0x8000, 0x200) for i in range(32)]
+        out = bytearray(0x200 * 32)
+        done = self.lib.ReadPhysicalScatter(1, ranges, out, workers=4)
+        self.lib.cleanup_scatter()
+        self.assertEqual(done, [i != 8 for i in range(32)])          # 0x40000 is the hole
+        self.assertEqual(bytes(out), self.expected(ranges, done))
+        with self.assertRaises(ValueError):
+            self.lib.ReadPhysicalScatter(1, ranges, bytearray(0x10))
+
+
+def write_elf(path, segments, data):
+    """ELF64 core: one PT_LOAD per (physical address, size), contents from data."""
+    header = bytearray(0x40)
+    header[:6] = b"\x7fELF\x02\x01"
+    struct.pack_into("<QHH", header, 0x20, 0x40, 0, 0)
+    struct.pack_into("<HH", header, 0x36, 0x38, len(segments))
+    offset = 0x40 + 0x38 * len(segments)
+    phdrs = bytearray()
+    body = bytearray()
+    for address, size in segments:
+        phdrs += struct.pack("<IIQQQQQQ", 1, 4, offset + len(body), 0, address, size, size, 0x1000)
+        body += data[address:address + size]
+    with open(path, "wb") as f:
+        f.write(header + phdrs + body)
+
+
+def write_dump(path, runs, data, bitmap=False):
+    """64-bit crash dump with the pages of runs (page, count): full or bitmap."""
+    header = bytearray(0x2000)
+    header[:8] = b"PAGEDU64"
+    struct.pack_into("<Q", header, 0x10, 0x1AD000)
+    body = b"".join(data[page * 0x1000:(page + count) * 0x1000] for page, count in runs)
+    if not bitmap:
+        struct.pack_into("<I", header, 0xF98, 1)
+        struct.pack_into("<IQ", header, 0x88, len(runs), sum(count for _, count in runs))
+        for index, (page, count) in enumerate(runs):
+            struct.pack_into("<QQ", header, 0x98 + index * 0x10, page, count)
+        contents = header + body
+    else:
+        struct.pack_into("<I", header, 0xF98, 5)
+        pages = len(data) // 0x1000
+        bits = bytearray((pages + 7) // 8)
+        for page, count in runs:
+            for number in range(page, page + count):
+                bits[number // 8] |= 1 << (number % 8)
+        bmp = bytearray(b"SDMP" + b"DUMP" + bytes(0x18))
+        first = 0x2000 + 0x38 + len(bits)
+        first = (first + 0xFFF) & ~0xFFF
+        bmp += struct.pack("<QQQ", first, sum(count for _, count in runs), pages) + bits
+        contents = header + bmp + bytes(first - 0x2000 - len(bmp)) + body
+    with open(path, "wb") as f:
+        f.write(contents)
+
+
+class HvFileTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.memory = bytes(MemoryReader(0x40000).memory)
+        self.runs = [(0, 3), (0x10, 0x11), (0x3E, 2)]          # pages
+        self.paths = [os.path.join(self.directory.name, name) for name in ("raw.bin", "core.elf", "full.dmp", "bitmap.dmp")]
+        with open(self.paths[0], "wb") as f:
+            f.write(self.memory)
+        write_elf(self.paths[1], [(page * 0x1000, count * 0x1000) for page, count in self.runs], self.memory)
+        write_dump(self.paths[2], self.runs, self.memory)
+        write_dump(self.paths[3], self.runs, self.memory, bitmap=True)
+
+    def tearDown(self):
+        for image in self.lib.images:
+            image._map.close()
+        self.directory.cleanup()
+
+    def open(self, latency=0.0):
+        self.lib = hvfile(self.paths, latency=latency)
+        with contextlib.redirect_stdout(io.StringIO()):
+            self.lib.EnumPartitions(self.lib.vm_ops)
+            handles = [self.lib.SelectPartition(index) for index in range(4)]
+        return handles
+
+    def test_partitions_and_runs(self):
+        handles = self.open()
+        self.assertEqual(self.lib.ArrayOfNames, ["raw.bin", "core.elf", "full.dmp", "bitmap.dmp"])
+        expected = [(page * 0x1000, count * 0x1000) for page, count in self.runs]
+        for image in self.lib.images[1:]:
+            self.assertEqual([(address, size) for address, _, size in image.runs], expected)
+        self.assertEqual(self.lib.images[2].directory_table_base, 0x1AD000)
+        for handle in handles:
+            self.assertEqual(self.lib.GetData(handle, HvmmInformationClass.InfoMmMaximumPhysicalPage), 0x40)
+        guids = {self.lib.GetData(handle, HvmmInformationClass.InfoVmGuidString) for handle in handles}
+        self.assertEqual(len(guids), 4)
+
+    def test_memory_runs(self):
+        handles = self.open()
+        self.assertEqual(self.lib.GetMemoryRuns(handles[0]), [(0, 0x40000)])
+        expected = [(page * 0x1000, count * 0x1000) for page, count in self.runs]
+        for handle in handles[1:]:
+            self.assertEqual(self.lib.GetMemoryRuns(handle), expected)
+        self.lib.sdk.SdkGetData = lambda handle, info_class, target: False      # hvlib without runs
+        self.assertIsNone(self.lib.GetMemoryRuns(handles[1]))
+
+    def test_reads_match_memory(self):
+        handles = self.open()
+        for handle in handles:
+            for address, size in ((0, 0x3000), (0x10FF0, 0x20), (0x3E800, 0x1800)):
+                data = self.lib.ReadPhysicalMemoryBlock(handle, address, size)
+                self.assertEqual(data.raw, self.memory[address:address + size])
+        for handle in handles[1:]:
+            with contextlib.redirect_stdout(io.StringIO()):
+                self.assertEqual(self.lib.ReadPhysicalMemoryBlock(handle, 0x2F00, 0x200), 0)   # run end to hole
+            buffer = bytearray(0x40)
+            self.assertTrue(self.lib.ReadPhysicalInto(handle, 0x20FC0, buffer))
+            self.assertEqual(buffer, self.memory[0x20FC0:0x21000])
+            out = bytearray(0x30)
+            done = self.lib.ReadPhysicalScatter(handle, [(0x1000, 0x10), (0x5000, 0x10), (0x3F000, 0x10)], out)
+            self.assertEqual(done, [True, False, True])
+
+    def test_writes_stay_in_memory(self):
+        handles = self.open()
+        self.assertTrue(self.lib.WritePhysicalMemoryBlock(handles[3], 0x11000, b"\xAA" * 4))
+        self.assertEqual(self.lib.ReadPhysicalMemoryBlock(handles[3], 0x11000, 4).raw, b"\xAA" * 4)
+        with open(self.paths[3], "rb") as f:
+            self.assertNotIn(b"\xAA" * 4, f.read())
+
+    def test_latency_and_counters(self):
+        handles = self.open(latency=0.002)
+        start = time.perf_counter()
+        for address in range(0, 0x3000, 0x1000):
+            self.lib.ReadPhysicalMemoryBlock(handles[0], address, 0x1000)
+        self.assertGreaterEqual(time.perf_counter() - start, 0.006)
+        self.assertEqual((self.lib.sdk.calls, self.lib.sdk.bytes_read), (3, 0x3000))
+
+
+class HvDumpTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        memory = MemoryReader(0x80000).memory
+        memory[0x20000:0x30000] = bytes(0x10000)                   # zero pages
+        self.memory = bytes(memory)
+        self.segments = [(0, 0x9000), (0x10000, 0x40000), (0x70000, 0x10000)]
+        write_elf(self.path("vm.elf"), self.segments, self.memory)
+        self.lib = hvfile(self.path("vm.elf"))
+        with contextlib.redirect_stdout(io.StringIO()):
+            self.lib.EnumPartitions(self.lib.vm_ops)
+            self.handle = self.lib.SelectPartition(0)
+
+    def tearDown(self):
+        for image in self.lib.images:
+            image._map.close()
+        self.directory.cleanup()
+
+    def path(self, name):
+        return os.path.join(self.directory.name, name)
+
+    def dump(self, name, layout, **options):
+        options.setdefault("chunk_size", 0x8000)
+        return Dump(self.lib, self.handle, self.path(name), layout, **options).run()
+
+    def test_layouts(self):
+        stats = self.dump("vm.raw", "raw", threads=3)
+        self.assertEqual(stats["zero_pages"], 0x10)
+        self.assertEqual(stats["written"], sum(size for _, size in self.segments) - 0x10000)
+        with open(self.path("vm.raw"), "rb") as f:
+            self.assertEqual(f.read(), b"".join(self.memory[a:a + size] for a, size in self.segments))
+
+        self.dump("vm.padded", "padded")
+        with open(self.path("vm.padded"), "rb") as f:
+            padded = f.read()
+        self.assertEqual(len(padded), 0x80000)
+        for address, size in self.segments:
+            self.assertEqual(padded[address:address + size], self.memory[address:address + size])
+
+        self.dump("vm.dmp", "dmp")
+        image = MemoryImage(self.path("vm.dmp"))
+        self.assertEqual([(address, size) for address, _, size in image.runs], self.segments)
+        for address, offset, size in image.runs:
+            self.assertEqual(image._map[offset:offset + size], self.memory[address:address + size])
+        image._map.close()
+
+    def test_dmp_runs_stop_before_context_record(self):
+        self.assertEqual(DMP_MAX_RUNS, 42)
+        segments = [(index * 0x2000, 0x1000) for index in range(50)]
+        write_elf(self.path("many.elf"), segments, self.memory)
+        lib = hvfile(self.path("many.elf"))
+        with contextlib.redirect_stdout(io.StringIO()):
+            lib.EnumPartitions(lib.vm_ops)
+            handle = lib.SelectPartition(0)
+        Dump(lib, handle, self.path("many.dmp"), "dmp", chunk_size=0x8000).run()
+        lib.images[0]._map.close()
+
+        with open(self.path("many.dmp"), "rb") as f:
+            header = f.read(0x2000)
+        self.assertEqual(struct.unpack_from("<I", header, 0x88)[0], DMP_MAX_RUNS)
+        self.assertEqual(0x98 + DMP_MAX_RUNS * 0x10, 0x338)
+        self.assertEqual(header[0x338:DMP_CONTEXT_RECORD + 0x4D0], b"PAGE" * ((DMP_CONTEXT_RECORD + 0x4D0 - 0x338) // 4))
+        image = MemoryImage(self.path("many.dmp"))
+        self.assertEqual(len(image.runs), DMP_MAX_RUNS)
+        for address, size in segments:
+            data = ctypes.create_string_buffer(size)
+            self.assertTrue(image.read(address, size, data))
+            self.assertEqual(data.raw, self.memory[address:address + size])
+        image._map.close()
+
+        with self.assertRaises(ValueError):
+            dmp_header(self.lib, self.handle, segments, 0)
+
+    def test_compressed_container_expands_to_layout(self):
+        self.dump("vm.dmp", "dmp")
+        self.dump("vm.dmp.hvdz", "dmp", compress=True, threads=2)
+        expand(self.path("vm.dmp.hvdz"), self.path("vm.expanded"))
+        with open(self.path("vm.dmp"), "rb") as plain, open(self.path("vm.expanded"), "rb") as expanded:
+            self.assertEqual(plain.read(), expanded.read())
+
+    def test_unreadable_pages_are_zero(self):
+        read_into = self.lib.ReadPhysicalInto
+
+        def failing(handle, address, buffer, size=None):
+            if address <= 0x12000 < address + (size or len(buffer)):
+                return False
+            return read_into(handle, address, buffer, size)
+
+        self.lib.ReadPhysicalInto = failing
+        stats = self.dump("vm.padded", "padded")
+        self.assertEqual(stats["failed_pages"], 1)
+        with open(self.path("vm.padded"), "rb") as f:
+            padded = f.read()
+        self.assertEqual(padded[0x12000:0x13000], bytes(0x1000))
+        self.assertEqual(padded[0x11000:0x12000], self.memory[0x11000:0x12000])
+
+    def test_resume_after_interruption(self):
+        for compress in (False, True):
+            name = "vm.hvdz" if compress else "vm.raw"
+
+            def interrupt(done, total):
+                if done == 3:
+                    raise KeyboardInterrupt
+
+            with self.assertRaises(KeyboardInterrupt):
+                self.dump(name, "raw", compress=compress, progress=interrupt)
+            self.assertTrue(os.path.exists(self.path(name + ".checkpoint")))
+            stats = self.dump(name, "raw", compress=compress, resume=True)
+            self.assertEqual(stats["bytes"], sum(size for _, size in self.segments) - 0x11000)  # 0x8000, 0x1000, 0x8000 done
+            self.assertFalse(os.path.exists(self.path(name + ".checkpoint")))
+
+            if compress:
+                expand(self.path(name), self.path("vm.expanded"))
+                name = "vm.expanded"
+            with open(self.path(name), "rb") as f:
+                self.assertEqual(f.read(), b"".join(self.memory[a:a + size] for a, size in self.segments))
+
+
+class SnapshotTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.memory = MemoryReader(0x60000).memory
+        self.memory[0x30000:0x38000] = bytes(0x8000)
+        self.segments = [(0, 0x9000), (0x10000, 0x50000)]
+        self.store = SnapshotStore(os.path.join(self.directory.name, "store"))
+        self.images = []
+
+    def tearDown(self):
+        for image in self.images:
+            image._map.close()
+        self.directory.cleanup()
+
+    def open(self, path):
+        lib = hvfile(path)
+        self.images += lib.images
+        with contextlib.redirect_stdout(io.StringIO()):
+            lib.EnumPartitions(lib.vm_ops)
+            return lib, lib.SelectPartition(0)
+
+    def take(self):
+        path = os.path.join(self.directory.name, "vm.elf")
+        write_elf(path, self.segments, self.memory)
+        return self.store.take(*self.open(path), threads=2, chunk_size=0x8000)
+
+    def test_only_changed_pages_are_stored(self):
+        first = self.take()
+        self.assertEqual((first["changed"], first["zero"], first["parent"]), (0x59 - 8, 8, None))
+        versions = [bytes(self.memory)]
+
+        self.memory[0x12345:0x12349] = b"\xAA" * 4
+        self.memory[0x30000] = 1                                    # zero page gets data
+        self.memory[0x4000:0x5000] = bytes(0x1000)                  # page becomes zero
+        second = self.take()
+        self.assertEqual((second["changed"], second["zero"], second["parent"]), (2, 1, first["id"]))
+        self.assertEqual(second["bytes_written"], 2 * 0x1000)
+        versions.append(bytes(self.memory))
+
+        third = self.take()
+        self.assertEqual(third["changed"], 0)
+        self.assertEqual([snapshot["id"] for snapshot in self.store.snapshots()], [1, 2, 3])
+
+        # Every snapshot reads back as it was, through hvfile
+        for number, memory in zip((1, 2, 3), versions + versions[-1:]):
+            lib, handle = self.open(self.store.path(number))
+            self.assertEqual(lib.GetMemoryRuns(handle), self.segments)
+            for address, size in self.segments:
+                self.assertEqual(lib.ReadPhysicalMemoryBlock(handle, address, size).raw, memory[address:address + size])
+            with contextlib.redirect_stdout(io.StringIO()):
+                self.assertEqual(lib.ReadPhysicalMemoryBlock(handle, 0x9000, 0x10), 0)
+
+    def test_snapshot_writes_stay_private(self):
+        self.take()
+        lib, handle = self.open(self.store.path(1))
+        self.assertTrue(lib.WritePhysicalMemoryBlock(handle, 0x30FFE, b"\x55" * 4))    # zero page and next
+        self.assertEqual(lib.ReadPhysicalMemoryBlock(handle, 0x30FFC, 8).raw, b"\0\0" + b"\x55" * 4 + b"\0\0")
+        lib, handle = self.open(self.store.path(1))
+        self.assertEqual(lib.ReadPhysicalMemoryBlock(handle, 0x30FFC, 8).raw, bytes(8))
+
+
+def map_pages(memory, cr3, mappings, tables, levels=4):
+    """Page tables at cr3 for (virtual, physical, page size) mappings; new tables are taken from `tables`."""
+    for virtual, physical, size in mappings:
+        leaf = {0x1000: 1, 0x200000: 2, 0x40000000: 3}[size]
+        table = cr3
+        for level in range(levels, leaf, -1):
+            slot = table + ((virtual >> (12 + 9 * (level - 1))) & 0x1FF) * 8
+            entry, = struct.unpack_from("<Q", memory, slot)
+            if not entry & 1:
+                entry = tables.pop(0) | 3
+                struct.pack_into("<Q", memory, slot, entry)
+            table = entry & 0x000FFFFFFFFFF000
+        slot = table + ((virtual >> (12 + 9 * (leaf - 1))) & 0x1FF) * 8
+        struct.pack_into("<Q", memory, slot, physical | 3 | (0x80 if leaf > 1 else 0))
+
+
+class PageWalkTest(unittest.TestCase):
+
+    KERNEL = 0xFFFFF80000000000
+    CR3 = 0x1AD000
+
+    def setUp(self):
+        self.memory = bytearray(0x400000)
+        self.memory[0x5000:0xA000] = random.Random(1).randbytes(0x5000)
+        self.memory[0x200000:0x400000] = random.Random(2).randbytes(0x200000)
+        self.mappings = [(self.KERNEL, 0x5000, 0x1000), (self.KERNEL + 0x1000, 0x6000, 0x1000),
+                         (self.KERNEL + 0x3000, 0x9000, 0x1000),           # KERNEL + 0x2000 is not mapped
+                         (self.KERNEL + 0x200000, 0x200000, 0x200000),
+                         (0x7FF000000000, 0x40000000, 0x40000000)]
+        self.sdk = FakeSdk(self.memory)
+        self.lib = HvLib.__new__(HvLib)
+        self.lib.hvlib = self.sdk
+        self.lib.vm_ops = type("VmOps", (), {"ReadMethod": 0})()
+
+    def test_translate(self):
+        map_pages(self.memory, self.CR3, self.mappings, list(range(0x1B0000, 0x1C0000, 0x1000)))
+        for virtual, physical, size in self.mappings:
+            self.assertEqual(self.lib.TranslateVirtualAddress(1, virtual + 0x123, self.CR3), physical + 0x123)
+        self.assertEqual(self.lib.TranslateVirtualAddress(1, self.KERNEL + 0x3FF0A8, self.CR3), 0x3FF0A8)
+        self.assertIsNone(self.lib.TranslateVirtualAddress(1, self.KERNEL + 0x2000, self.CR3))
+        self.assertIsNone(self.lib.TranslateVirtualAddress(1, 0x0000900000000000, self.CR3))   # not canonical
+
+    def test_partial_read_and_caches(self):
+        map_pages(self.memory, self.CR3, self.mappings, list(range(0x1B0000, 0x1C0000, 0x1000)))
+        buffer = bytearray(0x4000)
+        done = self.lib.ReadVirtualPartial(1, self.KERNEL, buffer, directory_table_base=self.CR3)
+        self.assertEqual(done, [(0, 0x2000), (0x3000, 0x1000)])
+        self.assertEqual(buffer, self.memory[0x5000:0x7000] + bytes(0x1000) + self.memory[0x9000:0xA000])
+
+        # Tables and translations are kept: again, only the two data runs reach the driver
+        calls = self.sdk.calls
+        self.lib.ReadVirtualPartial(1, self.KERNEL, buffer, directory_table_base=self.CR3)
+        self.assertEqual(self.sdk.calls - calls, 2)
+
+        # A read across the 2 MB page is one physical read
+        calls = self.sdk.calls
+        buffer = bytearray(0x10000)
+        self.assertEqual(self.lib.ReadVirtualPartial(1, self.KERNEL + 0x2F8000, buffer, directory_table_base=self.CR3),
+                         [(0, 0x10000)])
+        self.assertEqual(buffer, self.memory[0x2F8000:0x308000])
+        self.assertEqual(self.sdk.calls - calls, 1)
+
+        self.lib.FlushTranslations()
+        calls = self.sdk.calls
+        self.lib.ReadVirtualPartial(1, self.KERNEL, bytearray(0x10), directory_table_base=self.CR3)
+        self.assertEqual(self.sdk.calls - calls, 5)                # four tables and the data
+
+    def test_size_past_buffer_rejected(self):
+        map_pages(self.memory, self.CR3, self.mappings, list(range(0x1B0000, 0x1C0000, 0x1000)))
+        buffer = bytearray(0x2000)
+        for size in (0x2001, -1):
+            with self.assertRaises(ValueError):
+                self.lib.ReadVirtualPartial(1, self.KERNEL, buffer, size, directory_table_base=self.CR3)
+        self.assertEqual(buffer, bytes(0x2000))
+        self.assertEqual(self.lib.ReadVirtualPartial(1, self.KERNEL, buffer, 0x1000, directory_table_base=self.CR3),
+                         [(0, 0x1000)])
+        self.assertEqual(buffer, self.memory[0x5000:0x6000] + bytes(0x1000))
+
+    def test_five_levels(self):
+        virtual = 0xFF01000000000000                                 # canonical with 57 bits only
+        map_pages(self.memory, self.CR3, [(virtual, 0x5000, 0x1000)], list(range(0x1B0000, 0x1C0000, 0x1000)), levels=5)
+        walker = self.lib.GetPageWalker(1, levels=5)
+        self.assertEqual(walker.translate(self.CR3, virtual + 0x10), (0x5000, 0x1000))
+        self.assertIsNone(walker.translate(self.CR3, self.KERNEL))
+        self.assertIsNone(self.lib.GetPageWalker(1).translate(self.CR3, virtual))
+
+    def test_hvfile_virtual_reads(self):
+        map_pages(self.memory, self.CR3, self.mappings, list(range(0x1B0000, 0x1C0000, 0x1000)))
+        directory = tempfile.TemporaryDirectory()
+        self.addCleanup(directory.cleanup)
+        path = os.path.join(directory.name, "vm.dmp")
+        write_dump(path, [(0, 0x400)], bytes(self.memory))           # DTB 0x1AD000
+        lib = hvfile(path)
+        self.addCleanup(lib.images[0]._map.close)
+        with contextlib.redirect_stdout(io.StringIO()):
+            lib.EnumPartitions(lib.vm_ops)
+            handle = lib.SelectPartition(0)
+            self.assertEqual(lib.ReadVirtualMemoryBlock(handle, self.KERNEL, 0x2000).raw, self.memory[0x5000:0x7000])
+            self.assertEqual(lib.ReadVirtualMemoryBlock(handle, self.KERNEL, 0x3000), 0)   # all or nothing
+        self.assertTrue(lib.WriteVirtualMemoryBlock(handle, self.KERNEL + 0xFFE, b"\x11" * 4))
+        self.assertEqual(lib.ReadPhysicalMemoryBlock(handle, 0x5FFE, 2).raw + lib.ReadPhysicalMemoryBlock(handle, 0x6000, 2).raw,
+                         b"\x11" * 4)
+
+
+class StackCacheTest(unittest.TestCase):
+
+    KERNEL = 0xFFFFF80000000000
+    CR3 = 0x1AD000
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.memory = bytearray(0x200000)
+        self.memory[0x5000:0x6000] = random.Random(3).randbytes(0x1000)
+        map_pages(self.memory, self.CR3, [(self.KERNEL, 0x5000, 0x1000)], list(range(0x1B0000, 0x1C0000, 0x1000)))
+        self.lib = HvLib.__new__(HvLib)
+        self.lib.hvlib = FakeSdk(self.memory)
+        self.lib.vm_ops = type("VmOps", (), {"ReadMethod": 0})()
+        self.data = {HvmmInformationClass.InfoKernelBase: self.KERNEL,
+                     HvmmInformationClass.InfoDirectoryTableBase: self.CR3,
+                     HvmmInformationClass.InfoNtBuildNumber: 26100,
+                     HvmmInformationClass.InfoMmMaximumPhysicalPage: 0x200}
+        self.lib.GetData = lambda handle, info_class: self.data.get(info_class, 0)
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def test_identity_changes_with_boot(self):
+        identity = boot_identity(self.lib, 1)
+        self.assertIsNotNone(identity["page_hash"])
+        self.assertEqual(boot_identity(self.lib, 1), identity)
+
+        # Another kernel image at the same address (a reboot without KASLR)
+        self.memory[0x5010] ^= 0xFF
+        self.lib.FlushTranslations()
+        self.assertNotEqual(boot_identity(self.lib, 1), identity)
+
+        # Kernel base not mapped: no page hash, still an identity
+        self.data[HvmmInformationClass.InfoKernelBase] = self.KERNEL + 0x1000
+        self.assertIsNone(boot_identity(self.lib, 1)["page_hash"])
+
+        # Memory images have no kernel base: the DTB page is hashed
+        path = os.path.join(self.directory.name, "vm.dmp")
+        write_dump(path, [(0, 0x200)], bytes(self.memory))
+        lib = hvfile(path)
+        self.addCleanup(lib.images[0]._map.close)
+        with contextlib.redirect_stdout(io.StringIO()):
+            lib.EnumPartitions(lib.vm_ops)
+            handle = lib.SelectPartition(0)
+        identity = boot_identity(lib, handle)
+        self.assertEqual((identity["kernel_base"], identity["directory_table_base"]), (0, self.CR3))
+        self.assertIsNotNone(identity["page_hash"])
+
+    def test_entries_per_vm_and_boot(self):
+        cache = StackCache(os.path.join(self.directory.name, "stack.json"))
+        self.assertIsNone(cache.load("VM-A", {"boot": 1}))                  # no file yet
+
+        config = {"class": "volatility3.framework.layers.intel.WindowsIntel32e",
+                  "page_map_offset": self.CR3, "memory_layer.class": "volatility3.framework.layers.hyperv.FileLayer"}
+        cache.save("VM-A", {"boot": 1}, "kernel.layer_name", config)
+        cache.save("vm-b", {"boot": 7}, "kernel.layer_name", {"page_map_offset": 0x1000})
+        self.assertEqual(cache.load("vm-a", {"boot": 1}), ("kernel.layer_name", config))
+        self.assertIsNone(cache.load("vm-a", {"boot": 2}))
+
+        # A new boot replaces the entry, the other VM keeps its own
+        cache.save("vm-a", {"boot": 2}, "kernel.layer_name", {"page_map_offset": 0x2000})
+        self.assertIsNone(cache.load("vm-a", {"boot": 1}))
+        self.assertEqual(cache.load("vm-b", {"boot": 7})[1], {"page_map_offset": 0x1000})
+        cache.forget("vm-b")
+        self.assertIsNone(cache.load("vm-b", {"boot": 7}))
+        self.assertFalse(os.path.exists(cache.path + ".tmp"))
+
+        with open(cache.path, "w") as f:
+            f.write('{"version": 1, "vms": ')                               # cut short
+        self.assertIsNone(cache.load("vm-a", {"boot": 2}))
+        cache.save("vm-a", {"boot": 2}, "kernel.layer_name", {})
+        self.assertEqual(cache.load("vm-a", {"boot": 2}), ("kernel.layer_name", {}))
+
+
+class BufferPoolTest(unittest.TestCase):
+
+    def test_buffers_aligned_and_reused(self):
+        pool = BufferPool(max_size=0x10000, keep=2)
+        for size in (1, 0x10, 0x1000, 0x1001, 0x8000):
+            buffer = pool.acquire(size)
+            self.assertGreaterEqual(len(buffer), size)
+            self.assertEqual(ctypes.addressof(buffer) % 0x1000, 0)
+            pool.release(buffer)
+        allocated = pool.allocated
+        for _ in range(100):
+            buffer = pool.acquire(0x800)
+            pool.release(buffer)
+        self.assertEqual(pool.allocated, allocated)
+
+    def test_pooled_buffer_read(self):
+        memory = MemoryReader(0x10000).memory
+        lib = HvLib.__new__(HvLib)
+        lib.hvlib = FakeSdk(memory)
+        lib.vm_ops = type("VmOps", (), {"ReadMethod": 0})()
+        pool = BufferPool()
+        buffer = pool.acquire(0x123)
+        self.assertTrue(lib.ReadPhysicalInto(1, 0x4567, buffer, 0x123))
+        self.assertEqual(buffer[:0x123], bytes(memory[0x4567:0x468A]))
+        pool.release(buffer)
+
+    def test_large_and_surplus_buffers_not_kept(self):
+        pool = BufferPool(max_size=0x4000, keep=1)
+        buffers = [pool.acquire(0x4000) for _ in range(3)]
+        for buffer in buffers:
+            pool.release(buffer)
+        self.assertEqual(len(pool._free[0x4000]), 1)
+        pool.release(pool.acquire(0x10000))
+        self.assertNotIn(0x10000, pool._free)
+
+if __name__ == "__main__":
+    unittest.main()
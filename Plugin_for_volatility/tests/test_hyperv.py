@@ -0,0 +1,186 @@
+#
+#  Tests for the hyperv volatility layer (hyperv.py) over memory images
+#
+#  volatility3 is replaced by tests/volatility_stub.py and hvlib.dll by
+#  hvlib/hvfile.py (HYPERV_IMAGE), so they run on any OS.
+#
+
+import contextlib
+import io
+import os
+import pickle
+import sys
+import tempfile
+import types
+import unittest
+from unittest import mock
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import volatility_stub
+
+volatility_stub.install()
+
+import hyperv
+from hvlib.hvfile import open_image
+from hvlib.readlog import read_records
+from test_hvlib import MemoryReader, write_elf
+
+PAGE = 0x1000
+
+
+class LayerTestCase(unittest.TestCase):
+    """A FileLayer over an ELF core whose runs are given in pages."""
+
+    runs = [(0, 0x40)]
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.memory = bytes(MemoryReader(0x40 * PAGE).memory)
+        self.image = os.path.join(self.directory.name, "guest.elf")
+        write_elf(self.image, [(page * PAGE, count * PAGE) for page, count in self.runs], self.memory)
+        image = open_image(self.image)
+        guid = image.guid
+        image._map.close()
+
+        self.log_path = os.path.join(self.directory.name, "hyperv_reads.hvrl")
+        patches = [mock.patch.dict(os.environ, {"HYPERV_IMAGE": self.image, "HYPERV_VM_GUID": guid}),
+                   mock.patch.object(hyperv, "_HVLOG_PATH", self.log_path),
+                   mock.patch.object(hyperv, "_hvlog_file", None),
+                   mock.patch.object(hyperv, "_hvlog_pid", 0)]
+        for patch in patches:
+            patch.start()
+            self.addCleanup(patch.stop)
+        self.layers = []
+
+    def tearDown(self):
+        instance = hyperv._hvlib_instance
+        for layer in self.layers:
+            layer.destroy()
+        if instance is not None:
+            for image in instance.images:
+                image._map.close()
+        if hyperv._hvlog_file:
+            hyperv._hvlog_file.close()
+        self.directory.cleanup()
+
+    def layer(self):
+        context = types.SimpleNamespace(config = {"location": "hyperv://"})
+        with contextlib.redirect_stdout(io.StringIO()):
+            layer = hyperv.FileLayer(context, "layer", "hyperv")
+        self.layers.append(layer)
+        return layer
+
+    def unpickle(self, layer):
+        copy = pickle.loads(pickle.dumps(layer))
+        self.layers.append(copy)
+        return copy
+
+
+class PickleTest(LayerTestCase):
+
+    def test_unpickled_layer_reconnects(self):
+        layer = self.layer()
+        self.assertEqual(layer.read(0x1000, 0x100), self.memory[0x1000:0x1100])
+        copy = self.unpickle(layer)
+        self.assertIsNone(copy._lkd_handle)
+        self.assertIs(copy._hvlog, layer._hvlog)                  # same process, same log
+        self.assertEqual(copy.read(0x2000, 0x100), self.memory[0x2000:0x2100])
+        self.assertIsNotNone(copy._lkd_handle)
+        hyperv._hvlog_file.close()
+        self.assertEqual([record[0] for record in read_records(self.log_path)], [0x1000, 0x2000])
+
+    def test_worker_logs_to_its_own_file(self):
+        layer = self.layer()
+        layer.read(0x1000, 0x100)
+        data = pickle.dumps(layer)
+        hyperv._hvlog_file.close()
+
+        # A spawned worker imports hyperv afresh: nothing open, no log yet
+        with mock.patch.object(hyperv, "_hvlog_file", None), mock.patch.object(hyperv, "_hvlog_pid", 0):
+            copy = pickle.loads(data)
+            self.layers.append(copy)
+            self.assertEqual(copy.read(0x3000, 0x10), self.memory[0x3000:0x3010])
+            worker_log = hyperv._hvlog_file
+            worker_log.close()
+
+        self.assertEqual(worker_log.path, os.path.join(self.directory.name, f"hyperv_reads.{os.getpid()}.hvrl"))
+        self.assertEqual([record[0] for record in read_records(worker_log.path)], [0x3000])
+        self.assertEqual([record[0] for record in read_records(self.log_path)], [0x1000])
+
+    @unittest.skipUnless(hasattr(os, "fork"), "needs fork")
+    def test_forked_child_drops_inherited_log(self):
+        layer = self.layer()
+        layer.read(0x1000, 0x100)
+        parent_log = hyperv._hvlog_file
+        data = pickle.dumps(layer)
+
+        pid = os.fork()
+        if pid == 0:
+            status = 1
+            try:
+                copy = pickle.loads(data)
+                ok = copy.read(0x4000, 0x10) == self.memory[0x4000:0x4010]
+                child_log = hyperv._hvlog_file
+                parent_log.close()                                  # must leave the parent's file alone
+                child_log.close()
+                if ok and child_log is not parent_log and child_log.path.endswith(f".{os.getpid()}.hvrl"):
+                    status = 0
+            finally:
+                os._exit(status)
+        _, status = os.waitpid(pid, 0)
+        self.assertEqual(status, 0)
+
+        layer.read(0x2000, 0x100)
+        parent_log.close()
+        self.assertEqual([record[0] for record in read_records(self.log_path)], [0x1000, 0x2000])
+        child_path = os.path.join(self.directory.name, f"hyperv_reads.{pid}.hvrl")
+        self.assertEqual([record[0] for record in read_records(child_path)], [0x4000])
+
+
+class RunMapTest(LayerTestCase):
+
+    # Backed 0x0-0x10000 and 0x20000-0x30000, a hole (MMIO) in between
+    runs = [(0, 0x10), (0x20, 0x10)]
+
+    def test_runs(self):
+        layer = self.layer()
+        self.assertEqual(layer.runs, [(0, 0x10000), (0x20000, 0x10000)])
+        self.assertEqual(layer.maximum_address, 0x30000)
+
+    def test_is_valid_inside_hole(self):
+        layer = self.layer()
+        self.assertTrue(layer.is_valid(0xF000, 0x1000))
+        self.assertTrue(layer.is_valid(0x20000, 0x10000))
+        self.assertFalse(layer.is_valid(0x10000))
+        self.assertFalse(layer.is_valid(0x18000, 0x100))
+        self.assertFalse(layer.is_valid(0x1FFFF, 2))
+        self.assertFalse(layer.is_valid(0xFFFF, 2))
+        self.assertFalse(layer.is_valid(0x30000))
+
+    def test_read_across_hole(self):
+        layer = self.layer()
+        data = layer.read(0xF000, 0x12000, pad = True)
+        self.assertEqual(data, self.memory[0xF000:0x10000] + bytes(0x10000) + self.memory[0x20000:0x21000])
+        self.assertEqual(layer.read(0x18000, 0x10, pad = True), bytes(0x10))
+        with self.assertRaises(volatility_stub.InvalidAddressException) as caught:
+            layer.read(0xF000, 0x12000)
+        self.assertEqual(caught.exception.invalid_address, 0x10000)
+        with self.assertRaises(volatility_stub.InvalidAddressException):
+            layer.read(0x18000, 0x10)
+
+    def test_read_ranges_pads_hole(self):
+        layer = self.layer()
+        data = layer.read_ranges([(0x1000, 0x10), (0x18000, 0x10), (0x2F000, 0x10)], pad = True)
+        self.assertEqual(data, [self.memory[0x1000:0x1010], bytes(0x10), self.memory[0x2F000:0x2F010]])
+
+    def test_scan_skips_hole(self):
+        layer = self.layer()
+        self.assertEqual(layer.scan(None, None), [(0, 0x10000), (0x20000, 0x10000)])
+        self.assertEqual(layer.scan(None, None, sections = [(0x8000, 0x20000)]), [(0x8000, 0x8000), (0x20000, 0x8000)])
+        self.assertEqual(list(layer.scan(None, None, sections = [(0x10000, 0x10000)])), [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,82 @@
+#
+#  The parts of volatility3 that hyperv.py uses, so its layer can be tested
+#  without volatility installed
+#
+#  install() puts the modules into sys.modules; import hyperv after it.
+#  DataLayerInterface.scan returns the sections it was given instead of
+#  running a scanner.
+#
+
+import enum
+import sys
+import types
+
+
+class LayerException(Exception):
+
+    def __init__(self, layer_name, *args):
+        super().__init__(layer_name, *args)
+        self.layer_name = layer_name
+
+
+class InvalidAddressException(LayerException):
+
+    def __init__(self, layer_name, invalid_address, *args):
+        super().__init__(layer_name, invalid_address, *args)
+        self.invalid_address = invalid_address
+
+
+class DataLayerInterface:
+
+    def __init__(self, context, config_path, name, metadata=None):
+        self.context = context
+        self.config_path = config_path
+        self._name = name
+        self.config = context.config
+
+    @property
+    def name(self):
+        return self._name
+
+    def scan(self, context, scanner, progress_callback=None, sections=None):
+        return list(sections)
+
+
+class Requirement:
+
+    def __init__(self, name, description=None, default=None, optional=False):
+        self.name = name
+        self.optional = optional
+
+
+class Parallelism(enum.IntEnum):
+    Off = 0
+    Threading = 1
+    Multiprocessing = 2
+
+
+def _module(name, **members):
+    module = types.ModuleType(name)
+    module.__dict__.update(members)
+    sys.modules[name] = module
+    return module
+
+
+def install():
+
+    layers = _module("volatility3.framework.interfaces.layers", DataLayerInterface=DataLayerInterface,
+                     ScannerInterface=object)
+    context = _module("volatility3.framework.interfaces.context", ContextInterface=object)
+    configuration = _module("volatility3.framework.interfaces.configuration", RequirementInterface=Requirement)
+    interfaces = _module("volatility3.framework.interfaces", layers=layers, context=context,
+                         configuration=configuration)
+    exceptions = _module("volatility3.framework.exceptions", LayerException=LayerException,
+                         InvalidAddressException=InvalidAddressException)
+    constants = _module("volatility3.framework.constants", PARALLELISM=Parallelism.Off, Parallelism=Parallelism,
+                        ProgressCallback=None)
+    requirements = _module("volatility3.framework.configuration.requirements", StringRequirement=Requirement,
+                           BytesRequirement=Requirement)
+    config = _module("volatility3.framework.configuration", requirements=requirements)
+    framework = _module("volatility3.framework", interfaces=interfaces, exceptions=exceptions,
+                        constants=constants, configuration=config)
+    _module("volatility3", framework=framework)